@@ -19,6 +19,9 @@
  * part of the project and are adopted by the project author(s).
  */
 
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include "defines.h"
@@ -28,6 +31,26 @@
 #include "logging.h"
 #include "mirage.h"
 
+#define ARMOR_TABLE_MASK   (ARMOR_TABLE_SIZE - 1)
+
+typedef struct {
+   uint32_t hash;
+   const char *device;           /* Interned mqtt_device. NULL marks an empty slot. */
+   element *component;
+   atomic_long last_seen;        /* time() of the last message from this device. */
+   atomic_int online;            /* 1 between connect and deregister. */
+} armor_entry;
+
+typedef struct {
+   armor_entry entries[ARMOR_TABLE_SIZE];
+   int count;
+   int notice_timeout;           /* From the armor_display element, cached at rebuild. */
+} armor_table;
+
+/* Two tables so a rebuild never touches the one other threads are reading. */
+static armor_table armor_tables[2];
+static atomic_int active_table = -1;
+
 static int armor_enabled = 1;    /* Variable to turn on/off displaying armor. */
 
 void setArmorEnabled(int enabled) {
@@ -38,56 +61,191 @@ void setArmorEnabled(int enabled) {
    }
 }
 
-/* Register armor component when MQTT message received */
-void registerArmor(char *mqtt_device_in)
+/* FNV-1a, 32 bit. */
+static uint32_t armor_hash(const char *str)
+{
+   uint32_t hash = 2166136261u;
+
+   while (*str) {
+      hash ^= (unsigned char) *str++;
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+static armor_table *armor_current_table(void)
+{
+   int index = atomic_load_explicit(&active_table, memory_order_acquire);
+
+   return (index < 0) ? NULL : &armor_tables[index];
+}
+
+static armor_entry *armor_find_entry(armor_table *table, const char *device)
+{
+   uint32_t hash = 0;
+   uint32_t slot = 0;
+
+   if ((table == NULL) || (device == NULL)) {
+      return NULL;
+   }
+
+   hash = armor_hash(device);
+   slot = hash & ARMOR_TABLE_MASK;
+   for (int probe = 0; probe < ARMOR_TABLE_SIZE; probe++) {
+      armor_entry *entry = &table->entries[slot];
+
+      if (entry->device == NULL) {
+         return NULL;
+      }
+      if ((entry->hash == hash) && (strcmp(entry->device, device) == 0)) {
+         return entry;
+      }
+      slot = (slot + 1) & ARMOR_TABLE_MASK;
+   }
+
+   return NULL;
+}
+
+void armor_registry_rebuild(void)
 {
-   char text[2048] = "";
    armor_settings *this_as = get_armor_settings();
-   element *this_element = this_as->armor_elements;
-   element *armor_display = NULL;
    element *curr_element = get_first_element();
-   time_t current_time = time(NULL);
+   int next = (atomic_load(&active_table) == 0) ? 1 : 0;
+   armor_table *table = &armor_tables[next];
 
-   if (this_as->armor_elements == NULL) {
-      return;
-   }
+   memset(table, 0, sizeof(*table));
+   table->notice_timeout = DEFAULT_ARMOR_NOTICE_TIMEOUT;
 
    /* Find the armor_display element to get timeout value */
    while (curr_element != NULL) {
       if (curr_element->type == SPECIAL && strcmp(curr_element->name, "armor_display") == 0) {
-         armor_display = curr_element;
+         if (curr_element->notice_timeout > 0) {
+            table->notice_timeout = curr_element->notice_timeout;
+         }
          break;
       }
       curr_element = curr_element->next;
    }
 
-   /* Find the armor component by mqtt_device */
-   while (this_element != NULL) {
-      if (strcmp(this_element->mqtt_device, mqtt_device_in) == 0) {
-         if (!this_element->mqtt_registered) {
-            /* New registration */
-            this_element->mqtt_registered = 1;
-            this_element->mqtt_last_time = current_time;
-            this_element->texture = this_element->texture_online;
-
-            /* Trigger notification timeout */
-            int notice_timeout = (armor_display != NULL && armor_display->notice_timeout > 0) ?
-                                 armor_display->notice_timeout : 5;
-            trigger_armor_notification_timeout(notice_timeout);
-
-            /* TTS for connection */
-            snprintf(text, 2048, "%s connected.", this_element->name);
-            mqttTextToSpeech(text);
-
-            LOG_INFO("Armor element connected: %s", this_element->name);
-         } else {
-            /* Update existing registration timestamp */
-            this_element->mqtt_last_time = current_time;
-         }
+   for (curr_element = this_as->armor_elements; curr_element != NULL;
+        curr_element = curr_element->next) {
+      uint32_t hash = 0;
+      uint32_t slot = 0;
+
+      if (curr_element->mqtt_device == NULL) {
+         continue;
+      }
+      if (armor_find_entry(table, curr_element->mqtt_device) != NULL) {
+         LOG_WARNING("Armor device \"%s\" is used by more than one component, keeping the first.",
+                     curr_element->mqtt_device);
+         continue;
+      }
+      if (table->count >= ARMOR_TABLE_SIZE / 2) {
+         LOG_WARNING("More than %d armor components, \"%s\" will not register.",
+                     ARMOR_TABLE_SIZE / 2, curr_element->name);
+         continue;
+      }
+
+      hash = armor_hash(curr_element->mqtt_device);
+      slot = hash & ARMOR_TABLE_MASK;
+      while (table->entries[slot].device != NULL) {
+         slot = (slot + 1) & ARMOR_TABLE_MASK;
+      }
 
-         return;
+      /* Carry over live state, a diff reload keeps the same components. */
+      table->entries[slot].hash = hash;
+      table->entries[slot].device = curr_element->mqtt_device;
+      table->entries[slot].component = curr_element;
+      atomic_init(&table->entries[slot].last_seen, (long) curr_element->mqtt_last_time);
+      atomic_init(&table->entries[slot].online, curr_element->mqtt_registered ? 1 : 0);
+      table->count++;
+   }
+
+   atomic_store_explicit(&active_table, next, memory_order_release);
+}
+
+element *armor_find_component(const char *device)
+{
+   armor_entry *entry = armor_find_entry(armor_current_table(), device);
+
+   return (entry != NULL) ? entry->component : NULL;
+}
+
+/* Register armor component when MQTT message received */
+void registerArmor(const char *mqtt_device_in)
+{
+   char text[2048] = "";
+   armor_table *table = armor_current_table();
+   armor_entry *entry = armor_find_entry(table, mqtt_device_in);
+   element *this_element = NULL;
+   time_t current_time = 0;
+
+   if (entry == NULL) {
+      return;
+   }
+
+   this_element = entry->component;
+   current_time = time(NULL);
+   atomic_store_explicit(&entry->last_seen, (long) current_time, memory_order_relaxed);
+   this_element->mqtt_last_time = current_time;
+
+   /* Only the first message after a disconnect does the connect work. */
+   if (atomic_exchange(&entry->online, 1) == 0) {
+      this_element->mqtt_registered = 1;
+      this_element->texture = this_element->texture_online;
+
+      trigger_armor_notification_timeout(table->notice_timeout);
+
+      /* TTS for connection */
+      snprintf(text, 2048, "%s connected.", this_element->name);
+      mqttTextToSpeech(text);
+
+      LOG_INFO("Armor element connected: %s", this_element->name);
+   }
+}
+
+void armor_check_timeouts(void)
+{
+   char text[2048] = "";
+   armor_settings *this_as = get_armor_settings();
+   armor_table *table = armor_current_table();
+   time_t current_time = time(NULL);
+
+   if ((table == NULL) || (table->count == 0)) {
+      return;
+   }
+
+   for (int i = 0; i < ARMOR_TABLE_SIZE; i++) {
+      armor_entry *entry = &table->entries[i];
+      element *this_element = entry->component;
+      long last_seen = 0;
+      int expected = 1;
+
+      if ((entry->device == NULL) || !atomic_load_explicit(&entry->online, memory_order_relaxed)) {
+         continue;
       }
 
-      this_element = this_element->next;
+      last_seen = atomic_load_explicit(&entry->last_seen, memory_order_relaxed);
+      if ((last_seen == 0) || ((current_time - this_as->armor_deregister) <= last_seen)) {
+         continue;
+      }
+
+      /* Only one caller gets to do the disconnect work. */
+      if (!atomic_compare_exchange_strong(&entry->online, &expected, 0)) {
+         continue;
+      }
+
+      this_element->mqtt_registered = 0;
+      this_element->last_temp = this_element->last_voltage = -1.0;
+      this_element->warn_state = WARN_NORMAL;
+      this_element->texture = this_element->texture_offline;
+
+      trigger_armor_notification_timeout(table->notice_timeout);
+
+      snprintf(text, 2048, "%s disconnected.", this_element->name);
+      mqttTextToSpeech(text);
+
+      LOG_INFO("Armor element disconnected: %s", this_element->name);
    }
 }
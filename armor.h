@@ -22,8 +22,48 @@
 #ifndef ARMOR_H
 #define ARMOR_H
 
+#include "config_parser.h"
+
+/* Armor components are looked up by their MQTT device through a small open
+ * addressed hash table built once per config load. Message handlers only stamp
+ * the last-seen time; armor_check_timeouts() decides when a component is gone.
+ */
+
+#define ARMOR_TABLE_SIZE         64     /* Power of two, at least twice the component count. */
+#define ARMOR_CHECK_INTERVAL_MS  1000   /* How often the main loop looks for stale components. */
+
 void setArmorEnabled(int enabled);
-void registerArmor(char *mqtt_device_in);
 
-#endif // ARMOR_H
+/**
+ * @brief Marks the component for this device as seen, connecting it if needed.
+ *
+ * Safe to call from the MQTT, serial and socket threads.
+ *
+ * @param mqtt_device_in The topic or device name the message arrived on.
+ */
+void registerArmor(const char *mqtt_device_in);
+
+/**
+ * @brief Rebuilds the component table from the current armor element list.
+ *
+ * Call on the render thread after the armor list or the armor_display element
+ * has changed. Lookups on other threads keep using the previous table until
+ * the new one is published.
+ */
+void armor_registry_rebuild(void);
+
+/**
+ * @brief Finds the armor component for a device.
+ *
+ * @return The component element, or NULL if no component uses that device.
+ */
+element *armor_find_component(const char *device);
 
+/**
+ * @brief Disconnects components that haven't been seen within armor_deregister.
+ *
+ * Call periodically from the main loop, every ARMOR_CHECK_INTERVAL_MS.
+ */
+void armor_check_timeouts(void);
+
+#endif // ARMOR_H
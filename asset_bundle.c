@@ -0,0 +1,236 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asset_bundle.h"
+#include "defines.h"
+#include "logging.h"
+
+static const unsigned char *bundle_map = NULL;
+static size_t bundle_size = 0;
+static const asset_bundle_header *bundle_header = NULL;
+static const asset_bundle_entry *bundle_entries = NULL;
+static const char *bundle_strings = NULL;
+static char bundle_dir[MAX_FILENAME_LENGTH] = "";
+
+static int bundle_string_valid(uint32_t offset)
+{
+   return (offset < bundle_header->strings_size) &&
+          (memchr(bundle_strings + offset, '\0', bundle_header->strings_size - offset) != NULL);
+}
+
+/* Check every offset up front so lookups can trust the mapping. */
+static int bundle_validate(void)
+{
+   const asset_bundle_header *hdr = (const asset_bundle_header *) bundle_map;
+   uint64_t entries_end = 0;
+
+   if ((bundle_size < sizeof(asset_bundle_header)) ||
+       (memcmp(hdr->magic, ASSET_BUNDLE_MAGIC, sizeof(hdr->magic)) != 0)) {
+      LOG_WARNING("Asset bundle has a bad header, ignoring it.");
+      return FAILURE;
+   }
+   if (hdr->version != ASSET_BUNDLE_VERSION) {
+      LOG_WARNING("Asset bundle is version %u, expected %d. Rebake it.", hdr->version,
+                  ASSET_BUNDLE_VERSION);
+      return FAILURE;
+   }
+
+   entries_end = hdr->entries_offset + (uint64_t) hdr->entry_count * sizeof(asset_bundle_entry);
+   if ((hdr->entries_offset % 8 != 0) || (entries_end > bundle_size) ||
+       (hdr->strings_offset + hdr->strings_size > bundle_size) || (hdr->strings_size == 0)) {
+      LOG_WARNING("Asset bundle is truncated, ignoring it.");
+      return FAILURE;
+   }
+
+   bundle_header = hdr;
+   bundle_entries = (const asset_bundle_entry *) (bundle_map + hdr->entries_offset);
+   bundle_strings = (const char *) (bundle_map + hdr->strings_offset);
+
+   for (uint32_t i = 0; i < hdr->entry_count; i++) {
+      const asset_bundle_entry *entry = &bundle_entries[i];
+      uint64_t expected = 0;
+
+      if (entry->type == ASSET_BUNDLE_IMAGE) {
+         expected = (uint64_t) entry->width * entry->height * 4;
+      } else if (entry->type == ASSET_BUNDLE_FRAMES) {
+         expected = (uint64_t) entry->width * sizeof(asset_bundle_frame);
+         if (!bundle_string_valid(entry->image) || !bundle_string_valid(entry->format)) {
+            expected = UINT64_MAX;
+         }
+      } else {
+         expected = UINT64_MAX;
+      }
+
+      if (!bundle_string_valid(entry->key) || (entry->data_size != expected) ||
+          (entry->data_offset % ASSET_BUNDLE_ALIGN != 0) ||
+          (entry->data_offset + entry->data_size > bundle_size)) {
+         LOG_WARNING("Asset bundle entry %u is corrupt, ignoring the bundle.", i);
+         bundle_header = NULL;
+         return FAILURE;
+      }
+   }
+
+   return SUCCESS;
+}
+
+int asset_bundle_open(const char *image_dir)
+{
+   char path[MAX_FILENAME_LENGTH * 2];
+   struct stat st;
+   void *map = NULL;
+   int fd = -1;
+
+   if (strcmp(image_dir, bundle_dir) == 0) {
+      return (bundle_header != NULL) ? SUCCESS : FAILURE;
+   }
+
+   asset_bundle_close();
+   snprintf(bundle_dir, sizeof(bundle_dir), "%s", image_dir);
+   snprintf(path, sizeof(path), "%s/%s", image_dir, ASSET_BUNDLE_FILENAME);
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      return FAILURE;
+   }
+
+   if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+      close(fd);
+      return FAILURE;
+   }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      LOG_WARNING("Unable to map asset bundle %s.", path);
+      return FAILURE;
+   }
+
+   bundle_map = map;
+   bundle_size = st.st_size;
+   if (bundle_validate() != SUCCESS) {
+      munmap(map, st.st_size);
+      bundle_map = NULL;
+      bundle_size = 0;
+      return FAILURE;
+   }
+
+   LOG_INFO("Asset bundle loaded: %s, %u entries.", path, bundle_header->entry_count);
+
+   return SUCCESS;
+}
+
+void asset_bundle_close(void)
+{
+   if (bundle_map != NULL) {
+      munmap((void *) bundle_map, bundle_size);
+   }
+
+   bundle_map = NULL;
+   bundle_size = 0;
+   bundle_header = NULL;
+   bundle_entries = NULL;
+   bundle_strings = NULL;
+   bundle_dir[0] = '\0';
+}
+
+/* Find an entry by full path, only if its source file hasn't changed. */
+static const asset_bundle_entry *bundle_find(const char *path, uint32_t type)
+{
+   size_t dir_len = strlen(bundle_dir);
+   const char *key = path;
+   int lo = 0;
+   int hi = 0;
+
+   if ((bundle_header == NULL) || (strncmp(path, bundle_dir, dir_len) != 0)) {
+      return NULL;
+   }
+
+   /* Config paths are "dir/file", and dir may already end in a slash. */
+   key += dir_len;
+   while (*key == '/') {
+      key++;
+   }
+
+   hi = (int) bundle_header->entry_count - 1;
+   while (lo <= hi) {
+      int mid = lo + (hi - lo) / 2;
+      const asset_bundle_entry *entry = &bundle_entries[mid];
+      int cmp = strcmp(key, bundle_strings + entry->key);
+
+      if (cmp == 0) {
+         struct stat st;
+
+         if (entry->type != type) {
+            return NULL;
+         }
+         if ((stat(path, &st) != 0) || ((int64_t) st.st_mtime != entry->mtime) ||
+             ((uint64_t) st.st_size != entry->source_size)) {
+            LOG_INFO("Asset bundle entry is stale, loading from source: %s", path);
+            return NULL;
+         }
+         return entry;
+      } else if (cmp < 0) {
+         hi = mid - 1;
+      } else {
+         lo = mid + 1;
+      }
+   }
+
+   return NULL;
+}
+
+const void *asset_bundle_find_image(const char *path, int *width, int *height)
+{
+   const asset_bundle_entry *entry = bundle_find(path, ASSET_BUNDLE_IMAGE);
+
+   if (entry == NULL) {
+      return NULL;
+   }
+
+   *width = entry->width;
+   *height = entry->height;
+
+   return bundle_map + entry->data_offset;
+}
+
+const asset_bundle_frame *asset_bundle_find_frames(const char *path, int *count,
+                                                   const char **image, const char **format)
+{
+   const asset_bundle_entry *entry = bundle_find(path, ASSET_BUNDLE_FRAMES);
+
+   if (entry == NULL) {
+      return NULL;
+   }
+
+   *count = entry->width;
+   *image = bundle_strings + entry->image;
+   *format = bundle_strings + entry->format;
+
+   return (const asset_bundle_frame *) (bundle_map + entry->data_offset);
+}
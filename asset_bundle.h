@@ -0,0 +1,129 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include <stdint.h>
+
+/* Prebaked asset bundle.
+ *
+ * tools/bake_assets.py decodes every image a config references to raw RGBA
+ * and parses every animation JSON into a frame table, then writes them to one
+ * file in the image directory. At startup the bundle is mapped read-only and
+ * assets are served straight out of the mapping: no PNG inflate and no JSON
+ * parse. Entries record the source file's mtime and size and are ignored once
+ * the source changes, so a stale bundle only costs speed.
+ *
+ * Layout, all little endian: an asset_bundle_header, entry_count
+ * asset_bundle_entry records sorted by key (strcmp order), a string table of
+ * NUL terminated strings, then the payloads, each ASSET_BUNDLE_ALIGN aligned.
+ * Keys and strings are paths relative to the image directory, exactly as they
+ * appear in the config.
+ */
+
+#define ASSET_BUNDLE_MAGIC     "MIRBUNDL"
+#define ASSET_BUNDLE_VERSION   1
+#define ASSET_BUNDLE_ALIGN     16
+
+typedef enum {
+   ASSET_BUNDLE_IMAGE = 1,     /* Payload is width * height RGBA32 pixels. */
+   ASSET_BUNDLE_FRAMES = 2     /* Payload is width asset_bundle_frame records. */
+} asset_bundle_type_t;
+
+typedef struct {
+   char magic[8];
+   uint32_t version;
+   uint32_t entry_count;
+   uint64_t entries_offset;
+   uint64_t strings_offset;
+   uint64_t strings_size;
+} asset_bundle_header;
+
+typedef struct {
+   uint32_t type;              /* asset_bundle_type_t */
+   uint32_t key;               /* String table offset of the source path. */
+   int64_t mtime;              /* Source file mtime, seconds. */
+   uint64_t source_size;       /* Source file size in bytes. */
+   uint64_t data_offset;       /* From the start of the file. */
+   uint64_t data_size;
+   uint32_t width;             /* Image width, or frame count for a frame table. */
+   uint32_t height;            /* Image height, unused for a frame table. */
+   uint32_t image;             /* Frame table: string offset of meta "image". */
+   uint32_t format;            /* Frame table: string offset of meta "format". */
+} asset_bundle_entry;
+
+/* One frame of a frame table, the fields of frame in config_parser.h. */
+typedef struct {
+   int16_t source_x;
+   int16_t source_y;
+   int16_t source_w;
+   int16_t source_h;
+   int16_t dest_x;
+   int16_t dest_y;
+   int16_t source_size_w;
+   int16_t source_size_h;
+   uint8_t rotated;
+   uint8_t trimmed;
+   uint16_t reserved;
+} asset_bundle_frame;
+
+/**
+ * @brief Maps ASSET_BUNDLE_FILENAME from an image directory.
+ *
+ * Does nothing if that directory's bundle is already open. Opening another
+ * directory closes the previous bundle. A missing bundle isn't an error,
+ * assets are simply loaded from their source files.
+ *
+ * @param image_dir The image directory, as returned by get_image_path().
+ * @return SUCCESS if a bundle is open, FAILURE otherwise.
+ */
+int asset_bundle_open(const char *image_dir);
+
+/**
+ * @brief Unmaps the bundle. Pointers returned by lookups become invalid.
+ */
+void asset_bundle_close(void);
+
+/**
+ * @brief Looks up a baked image. Safe from any thread while the bundle is open.
+ *
+ * @param path   Full path of the source image, "image_dir/file".
+ * @param width  Set to the image width.
+ * @param height Set to the image height.
+ * @return Pointer to the RGBA32 pixels in the mapping, or NULL if the image
+ *         isn't baked or its source changed since.
+ */
+const void *asset_bundle_find_image(const char *path, int *width, int *height);
+
+/**
+ * @brief Looks up a baked animation frame table.
+ *
+ * @param path   Full path of the animation JSON.
+ * @param count  Set to the number of frames.
+ * @param image  Set to the sheet image, relative to the image directory.
+ * @param format Set to the sheet's meta "format", may be "".
+ * @return Pointer to the frames in the mapping, or NULL if not baked or stale.
+ */
+const asset_bundle_frame *asset_bundle_find_frames(const char *path, int *count,
+                                                   const char **image, const char **format);
+
+#endif /* ASSET_BUNDLE_H */
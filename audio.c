@@ -19,6 +19,9 @@
  * part of the project and are adopted by the project author(s).
  */
 
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -26,289 +29,459 @@
 #include <vorbis/vorbisfile.h>
 #include <alsa/asoundlib.h>
 
-/* POSIX Message Queue */
-#include <fcntl.h>
-#include <sys/stat.h>
-
 #include "defines.h"
 #include "audio.h"
 #include "config_manager.h"
 #include "logging.h"
 #include "mirage.h"
 
-thread_info audio_threads[NUM_AUDIO_THREADS];
-mqd_t qd_clients[NUM_AUDIO_THREADS];
-
-/* This is my old audio threading code. This is a single instance. We start multiple of them.
- * TODO: Read this and see if it's still good.
- */
-void *audio_thread(void *arg)
+#define AUDIO_CHANNELS 2
+#define AUDIO_DECODE_CHUNK 4096       /* Bytes asked of ov_read() at a time. */
+#define AUDIO_PATH_LENGTH  (MAX_FILENAME_LENGTH * 2)
+
+/* One decoded sound, AUDIO_MIX_RATE interleaved stereo. Never freed while the mixer runs. */
+typedef struct _audio_clip {
+   char path[AUDIO_PATH_LENGTH];    /* Sound path and file name, so a path change misses. */
+   int16_t *samples;
+   size_t frames;
+   struct _audio_clip *next;
+} audio_clip;
+
+typedef struct {
+   const audio_clip *clip;    /* NULL when the voice is free. */
+   size_t position;           /* Next frame to mix. */
+} audio_voice;
+
+static audio_clip *clip_list = NULL;
+static pthread_mutex_t clip_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static audio_voice voices[AUDIO_MAX_VOICES];
+static int active_voices = 0;
+static pthread_mutex_t voice_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t voice_cond = PTHREAD_COND_INITIALIZER;
+
+static snd_pcm_t *pcm_handle = NULL;
+static snd_pcm_uframes_t period_frames = 0;
+static pthread_t mixer_thread;
+static int mixer_running = 0;
+
+/* Decode a whole Ogg file and convert it to the mix format. */
+static audio_clip *audio_decode(const char *path)
 {
-   /* PCM output */
-   unsigned int pcm, tmp, rate;
-   snd_pcm_uframes_t frames;
-   snd_pcm_t *pcm_handle = NULL;
-   snd_pcm_hw_params_t *params;
-   char *buff = NULL;
-   int buff_size = 0;
-   int err = 0;
-
-   /* Vorbis */
-   FILE *input_file = NULL;
    OggVorbis_File vf;
-   char **ptr;
-   vorbis_info *vi;
-   int eof = 0;
-   int current_section = 0;
-   ogg_int64_t pcm_length;
-
-   thread_info *this_thread = (thread_info *) arg;
-
-   char in_buffer[MSG_BUFFER_SIZE];
-   audio_msg *in_data;
-   in_data = (audio_msg *) in_buffer;
-   int in_size = 0;
-
-   struct timespec queue_timeout = { .tv_sec = 0, .tv_nsec = 0};
-
-   //char out_buffer [MSG_BUFFER_SIZE];
-   //audio_msg *out_data;
-   //out_data = (audio_msg *)out_buffer;
-
-   while (!checkShutdown()) {
-      this_thread->stop = 1;
-      //printf("Thread %d waiting on msg...\n", this_thread->thread_id);
-      clock_gettime(CLOCK_REALTIME, &queue_timeout);
-      queue_timeout.tv_sec++;
-      if ((in_size = mq_timedreceive(this_thread->qd_client, in_buffer, MSG_BUFFER_SIZE, NULL, &queue_timeout)) == -1) {
-         //perror("Client: mq_receive");
-         continue;
-      } else if (in_size > 0) {
-#ifdef AUDIO_DEBUG
-         LOG_INFO("Thread %d Msg received.", this_thread->thread_id);
-         LOG_INFO("\tcommand: %d", in_data->command);
-         LOG_INFO("\tfilename: \"%s\"", in_data->filename);
-         LOG_INFO("\tstart_percent: %f", in_data->start_percent);
-#endif
-         strcpy(this_thread->filename, in_data->filename);
-         this_thread->start_percent = in_data->start_percent;
-      } else {
-         //printf("Empty msg received.\n");
-         continue;
+   vorbis_info *vi = NULL;
+   int16_t *decoded = NULL;
+   size_t decoded_bytes = 0, capacity = 0;
+   size_t in_frames = 0, out_frames = 0;
+   int channels = 0, current_section = 0;
+   long rate = 0;
+   audio_clip *clip = NULL;
+
+   if (ov_fopen(path, &vf) < 0) {
+      LOG_ERROR("Unable to open Ogg file: %s", path);
+      return NULL;
+   }
+
+   vi = ov_info(&vf, -1);
+   channels = vi->channels;
+   rate = vi->rate;
+
+   for (;;) {
+      long ret = 0;
+
+      if (capacity - decoded_bytes < AUDIO_DECODE_CHUNK) {
+         int16_t *grown = NULL;
+
+         capacity = capacity ? capacity * 2 : 256 * 1024;
+         grown = realloc(decoded, capacity);
+         if (grown == NULL) {
+            LOG_ERROR("Out of memory decoding %s.", path);
+            free(decoded);
+            ov_clear(&vf);
+            return NULL;
+         }
+         decoded = grown;
       }
-      this_thread->stop = 0;
 
-      /* Process Input */
-      input_file = fopen(this_thread->filename, "r");
-      if (input_file == NULL) {
-         LOG_ERROR("[%d] Unable to open file: %s\n",
-                   this_thread->thread_id, this_thread->filename);
+      ret = ov_read(&vf, (char *) decoded + decoded_bytes, AUDIO_DECODE_CHUNK, 0, 2, 1,
+                    &current_section);
+      if (ret == 0) {
+         break;
+      } else if (ret == OV_HOLE) {
+         /* A hole in the stream. Skip it, like playback did. */
+         LOG_WARNING("Error reading %s, continuing.", path);
+         continue;
+      } else if (ret < 0) {
+         /* Anything else won't clear up by reading again. */
+         LOG_ERROR("Unable to decode %s: %ld", path, ret);
+         free(decoded);
+         ov_clear(&vf);
          return NULL;
       }
+      decoded_bytes += ret;
+   }
+   ov_clear(&vf);
 
-      if (ov_open(input_file, &vf, NULL, 0) < 0) {
-         LOG_ERROR("[%d] Input does not appear to be an Ogg bitstream.\n", this_thread->thread_id);
-         return NULL;
+   if ((channels < 1) || (rate <= 0)) {
+      free(decoded);
+      return NULL;
+   }
+   in_frames = decoded_bytes / (sizeof(int16_t) * channels);
+   out_frames = (size_t) ((double) in_frames * AUDIO_MIX_RATE / rate);
+
+   clip = calloc(1, sizeof(audio_clip));
+   if (clip != NULL) {
+      clip->samples = malloc(out_frames * AUDIO_CHANNELS * sizeof(int16_t) + 1);
+   }
+   if ((clip == NULL) || (clip->samples == NULL)) {
+      LOG_ERROR("Out of memory caching %s.", path);
+      free(clip);
+      free(decoded);
+      return NULL;
+   }
+
+   /* Linear interpolation to the mix rate. Mono is duplicated, extra channels dropped. */
+   for (size_t i = 0; i < out_frames; i++) {
+      double src = (double) i * rate / AUDIO_MIX_RATE;
+      size_t i0 = (size_t) src;
+      size_t i1 = (i0 + 1 < in_frames) ? i0 + 1 : i0;
+      double frac = src - i0;
+
+      for (int ch = 0; ch < AUDIO_CHANNELS; ch++) {
+         int sch = (ch < channels) ? ch : 0;
+         double s0 = decoded[i0 * channels + sch];
+         double s1 = decoded[i1 * channels + sch];
+
+         clip->samples[i * AUDIO_CHANNELS + ch] = (int16_t) (s0 + (s1 - s0) * frac);
+      }
+   }
+   free(decoded);
+
+   snprintf(clip->path, sizeof(clip->path), "%s", path);
+   clip->frames = out_frames;
+
+   return clip;
+}
+
+/* Find a cached clip by full path. Called with clip_mutex held. */
+static audio_clip *audio_find_clip(const char *path)
+{
+   audio_clip *clip = NULL;
+
+   for (clip = clip_list; clip != NULL; clip = clip->next) {
+      if (strncmp(clip->path, path, AUDIO_PATH_LENGTH) == 0) {
+         break;
       }
+   }
+
+   return clip;
+}
 
-      /* Setup Output Device */
-      /* Open the PCM device in playback mode */
-      if ((pcm = snd_pcm_open(&pcm_handle, PCM_DEVICE, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-         printf("[%d] ERROR: Can't open \"%s\" PCM device. %s",
-                this_thread->thread_id, PCM_DEVICE, snd_strerror(pcm));
+/* Find a cached clip, decoding it now if it wasn't preloaded. */
+static const audio_clip *audio_get_clip(const char *name)
+{
+   char path[AUDIO_PATH_LENGTH];
+   audio_clip *clip = NULL;
+
+   snprintf(path, sizeof(path), "%s%s", get_sound_path(), name);
+
+   pthread_mutex_lock(&clip_mutex);
+   clip = audio_find_clip(path);
+   if (clip == NULL) {
+      clip = audio_decode(path);
+      if (clip != NULL) {
+         LOG_WARNING("Sound %s wasn't preloaded, decoded on first use.", name);
+         clip->next = clip_list;
+         clip_list = clip;
       }
+   }
+   pthread_mutex_unlock(&clip_mutex);
 
-      /* Allocate parameters object and fill it with default values */
-      snd_pcm_hw_params_alloca(&params);
+   return clip;
+}
 
-      snd_pcm_hw_params_any(pcm_handle, params);
+void audio_preload(void)
+{
+   DIR *dir = opendir(get_sound_path());
+   struct dirent *entry = NULL;
+   int count = 0;
+   size_t bytes = 0;
+
+   if (dir == NULL) {
+      LOG_WARNING("Unable to open sound path: %s", get_sound_path());
+      return;
+   }
+
+   while ((entry = readdir(dir)) != NULL) {
+      char path[AUDIO_PATH_LENGTH];
+      size_t len = strlen(entry->d_name);
+      audio_clip *clip = NULL;
+      int cached = 0;
 
-      ptr = ov_comment(&vf, -1)->user_comments;
-      vi = ov_info(&vf, -1);
-      while (*ptr) {
-         ++ptr;
+      if ((len < 5) || (strcmp(entry->d_name + len - 4, ".ogg") != 0)) {
+         continue;
       }
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] Bitstream is %d channel, %ldHz",
-              this_thread->thread_id, vi->channels, vi->rate);
-      LOG_INFO("[%d] Decoded length: %ld samples",
-              this_thread->thread_id, (long)ov_pcm_total(&vf, -1));
-      LOG_INFO("[%d] Encoded by: %s",
-              this_thread->thread_id, ov_comment(&vf, -1)->vendor);
-#endif
-      pcm_length = ov_pcm_total(&vf, -1);
 
-      /* Setup sound output based on input. */
-      if ((pcm = snd_pcm_hw_params_set_access(pcm_handle, params, SND_PCM_ACCESS_RW_INTERLEAVED))
-          < 0) {
-         LOG_ERROR("[%d] ERROR: Can't set interleaved mode. %s",
-                this_thread->thread_id, snd_strerror(pcm));
+      /* Something may already have played it. */
+      snprintf(path, sizeof(path), "%s%s", get_sound_path(), entry->d_name);
+      pthread_mutex_lock(&clip_mutex);
+      cached = (audio_find_clip(path) != NULL);
+      pthread_mutex_unlock(&clip_mutex);
+      if (cached) {
+         continue;
       }
 
-      if ((pcm = snd_pcm_hw_params_set_format(pcm_handle, params, SND_PCM_FORMAT_S16_LE))
-          < 0) {
-         LOG_ERROR("[%d] ERROR: Can't set format. %s", this_thread->thread_id, snd_strerror(pcm));
+      clip = audio_decode(path);
+      if (clip != NULL) {
+         pthread_mutex_lock(&clip_mutex);
+         clip->next = clip_list;
+         clip_list = clip;
+         pthread_mutex_unlock(&clip_mutex);
+
+         count++;
+         bytes += clip->frames * AUDIO_CHANNELS * sizeof(int16_t);
       }
+   }
+   closedir(dir);
 
-      if ((pcm = snd_pcm_hw_params_set_channels(pcm_handle, params, vi->channels)) < 0) {
-         LOG_ERROR("[%d] ERROR: Can't set channels number. %s",
-                this_thread->thread_id, snd_strerror(pcm));
+   LOG_INFO("Cached %d sounds, %zu KB of PCM.", count, bytes / 1024);
+}
+
+static int audio_open_output(void)
+{
+   snd_pcm_uframes_t buffer_frames = 0;
+   int err = 0;
+
+   if ((err = snd_pcm_open(&pcm_handle, PCM_DEVICE, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+      LOG_ERROR("Can't open \"%s\" PCM device. %s", PCM_DEVICE, snd_strerror(err));
+      pcm_handle = NULL;
+      return FAILURE;
+   }
+
+   /* Let ALSA convert if the device can't do the mix format natively. */
+   if ((err = snd_pcm_set_params(pcm_handle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                 AUDIO_CHANNELS, AUDIO_MIX_RATE, 1, AUDIO_LATENCY_US)) < 0) {
+      LOG_ERROR("Can't configure PCM device. %s", snd_strerror(err));
+      snd_pcm_close(pcm_handle);
+      pcm_handle = NULL;
+      return FAILURE;
+   }
+
+   if ((snd_pcm_get_params(pcm_handle, &buffer_frames, &period_frames) < 0) ||
+       (period_frames == 0)) {
+      period_frames = AUDIO_MIX_RATE / 200;
+   }
+
+   LOG_INFO("Audio output %s: %d Hz, %lu frame periods.", snd_pcm_name(pcm_handle),
+            AUDIO_MIX_RATE, (unsigned long) period_frames);
+
+   return SUCCESS;
+}
+
+/* Sum every active voice into one period. Called with voice_mutex held. */
+static void audio_mix_period(int16_t *out, int32_t *accum, snd_pcm_uframes_t frames)
+{
+   memset(accum, 0, frames * AUDIO_CHANNELS * sizeof(int32_t));
+
+   for (int v = 0; v < AUDIO_MAX_VOICES; v++) {
+      audio_voice *voice = &voices[v];
+      size_t count = 0;
+      const int16_t *src = NULL;
+
+      if (voice->clip == NULL) {
+         continue;
       }
 
-      rate = vi->rate;
-      if ((pcm = snd_pcm_hw_params_set_rate_near(pcm_handle, params, &rate, 0)) < 0) {
-         LOG_ERROR("[%d] ERROR: Can't set rate. %s", this_thread->thread_id, snd_strerror(pcm));
+      count = voice->clip->frames - voice->position;
+      if (count > frames) {
+         count = frames;
+      }
+      src = voice->clip->samples + voice->position * AUDIO_CHANNELS;
+      for (size_t i = 0; i < count * AUDIO_CHANNELS; i++) {
+         accum[i] += src[i];
       }
 
-      /* Write parameters */
-      if ((pcm = snd_pcm_hw_params(pcm_handle, params)) < 0) {
-         LOG_ERROR("[%d] ERROR: Can't set harware parameters. %s",
-                this_thread->thread_id, snd_strerror(pcm));
+      voice->position += count;
+      if (voice->position >= voice->clip->frames) {
+         voice->clip = NULL;
+         active_voices--;
       }
+   }
 
-      /* Resume information */
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] PCM name: '%s'", this_thread->thread_id, snd_pcm_name(pcm_handle));
+   for (size_t i = 0; i < frames * AUDIO_CHANNELS; i++) {
+      int32_t s = accum[i];
 
-      LOG_INFO("[%d] PCM state: %s", this_thread->thread_id,
-             snd_pcm_state_name(snd_pcm_state(pcm_handle)));
-#endif
-      snd_pcm_hw_params_get_rate(params, &tmp, 0);
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] rate: %d bps", this_thread->thread_id, tmp);
-#endif
+      out[i] = (int16_t) (s > INT16_MAX ? INT16_MAX : (s < INT16_MIN ? INT16_MIN : s));
+   }
+}
 
-      /* Allocate buffer to hold single period */
-      snd_pcm_hw_params_get_period_size(params, &frames, 0);
+static void *audio_mixer_thread(void *arg)
+{
+   int16_t *out = malloc(period_frames * AUDIO_CHANNELS * sizeof(int16_t));
+   int32_t *accum = malloc(period_frames * AUDIO_CHANNELS * sizeof(int32_t));
+   int idle = 1;
+
+   if ((out == NULL) || (accum == NULL)) {
+      LOG_ERROR("Unable to allocate mix buffers.");
+      free(out);
+      free(accum);
+      return NULL;
+   }
 
-      buff_size = frames * vi->channels * 2 /* 2 -> sample size */ ;
-      buff = (char *)malloc(buff_size);
+   pthread_mutex_lock(&voice_mutex);
+   while (mixer_running && !checkShutdown()) {
+      snd_pcm_sframes_t written = 0;
 
-      snd_pcm_hw_params_get_period_time(params, &tmp, NULL);
+      if (active_voices == 0) {
+         struct timespec wake;
 
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] Buffer size: %d", this_thread->thread_id, buff_size);
-#endif
+         /* Nothing to play. Let the stream stop instead of feeding it silence. */
+         if (!idle) {
+            pthread_mutex_unlock(&voice_mutex);
+            snd_pcm_drain(pcm_handle);
+            pthread_mutex_lock(&voice_mutex);
+            idle = 1;
+         }
 
-      if ((err = snd_pcm_prepare(pcm_handle)) < 0) {
-         LOG_ERROR("[%d] Cannot prepare audio interface for use (%s)",
-                 this_thread->thread_id, snd_strerror(err));
-         exit(1);
+         clock_gettime(CLOCK_REALTIME, &wake);
+         wake.tv_sec++;
+         pthread_cond_timedwait(&voice_cond, &voice_mutex, &wake);
+         continue;
       }
 
-      if (this_thread->start_percent > 0) {
-         int ret = 0;
-#ifdef AUDIO_DEBUG
-         LOG_INFO("Seeking to %ld", (long)((long double)pcm_length * this_thread->start_percent));
-#endif
-         ret = ov_pcm_seek(&vf, (long)((long double)pcm_length * this_thread->start_percent));
-         if (ret != 0) {
-            LOG_ERROR("Seek failed.");
-         }
+      if (idle) {
+         snd_pcm_prepare(pcm_handle);
+         idle = 0;
       }
 
-      while (!eof) {
-         long ret = ov_read(&vf, buff, buff_size, 0, 2, 1,
-                            &current_section);
-         if (this_thread->stop) {
-#ifdef AUDIO_DEBUG
-            LOG_INFO("Thread %d received stop.", this_thread->thread_id);
-#endif
-            break;
-         }
-         if (ret == 0) {
-            /* EOF */
-            eof = 1;
-         } else if (ret < 0) {
-            /* error in the stream.  Not a problem, just reporting it in
-               case we (the app) cares.  In this case, we don't. */
-            LOG_ERROR("[%d] Error reading OV file.", this_thread->thread_id);
-         } else {
-            /* we don't bother dealing with sample rate changes, etc, but
-               you'll have to */
-            if ((pcm = snd_pcm_writei(pcm_handle, buff, ret / vi->channels / 2)) == -EPIPE) {
-               snd_pcm_prepare(pcm_handle);
-            } else if (pcm < 0) {
-               LOG_ERROR("[%d] ERROR. Can't write to PCM device. %s",
-                    this_thread->thread_id, snd_strerror(pcm));
-            }
+      audio_mix_period(out, accum, period_frames);
+      pthread_mutex_unlock(&voice_mutex);
+
+      /* Blocks until ALSA has room, which paces the mixer. */
+      written = snd_pcm_writei(pcm_handle, out, period_frames);
+      if (written < 0) {
+         written = snd_pcm_recover(pcm_handle, (int) written, 1);
+         if (written < 0) {
+            LOG_ERROR("Can't write to PCM device. %s", snd_strerror((int) written));
          }
       }
 
-      eof = 0;
-      current_section = 0;
-      free(buff);
-      buff = NULL;
-      ov_clear(&vf);
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] PCM state: %s", this_thread->thread_id,
-             snd_pcm_state_name(snd_pcm_state(pcm_handle)));
-#endif
-      snd_pcm_drain(pcm_handle);
-#ifdef AUDIO_DEBUG
-      LOG_INFO("[%d] PCM state: %s", this_thread->thread_id,
-             snd_pcm_state_name(snd_pcm_state(pcm_handle)));
-#endif
+      pthread_mutex_lock(&voice_mutex);
+   }
+   pthread_mutex_unlock(&voice_mutex);
+
+   snd_pcm_drop(pcm_handle);
+   free(out);
+   free(accum);
+
+   return NULL;
+}
+
+int audio_init(void)
+{
+   if (audio_open_output() != SUCCESS) {
+      /* Keep going without sound. Play requests are dropped below. */
+      return SUCCESS;
+   }
+
+   mixer_running = 1;
+   if (pthread_create(&mixer_thread, NULL, audio_mixer_thread, NULL)) {
+      LOG_ERROR("Error creating audio mixer thread.");
+      mixer_running = 0;
       snd_pcm_close(pcm_handle);
       pcm_handle = NULL;
+      return FAILURE;
+   }
+
+   return SUCCESS;
+}
 
-      this_thread->filename[0] = '\0';
+void audio_cleanup(void)
+{
+   audio_clip *clip = NULL;
+
+   if (mixer_running) {
+      pthread_mutex_lock(&voice_mutex);
+      mixer_running = 0;
+      pthread_cond_signal(&voice_cond);
+      pthread_mutex_unlock(&voice_mutex);
+      pthread_join(mixer_thread, NULL);
    }
 
-   return NULL;
+   if (pcm_handle != NULL) {
+      snd_pcm_close(pcm_handle);
+      pcm_handle = NULL;
+   }
+
+   pthread_mutex_lock(&clip_mutex);
+   clip = clip_list;
+   while (clip != NULL) {
+      audio_clip *next = clip->next;
+      free(clip->samples);
+      free(clip);
+      clip = next;
+   }
+   clip_list = NULL;
+   pthread_mutex_unlock(&clip_mutex);
 }
 
 int process_audio_command(int command, char *file, double start_percent)
 {
-   int current_thread = 0;
-
-   /* Audio Command Parsing */
-   char out_buffer[MSG_BUFFER_SIZE];
-   audio_msg *out_data;
-   out_data = (audio_msg *) out_buffer;
+   char path[AUDIO_PATH_LENGTH];
+   const audio_clip *clip = NULL;
+   int ret = FAILURE;
 
    switch (command) {
       case SOUND_PLAY:
-         /* Find open thread. */
-         while (current_thread < NUM_AUDIO_THREADS)
-         {
-            if (audio_threads[++current_thread].stop == 1)
-            {
-               break;
-            }
+         if (!mixer_running) {
+            return FAILURE;
+         }
 
-            current_thread++;
+         clip = audio_get_clip(file);
+         if (clip == NULL) {
+            return FAILURE;
          }
 
-         if (current_thread < NUM_AUDIO_THREADS)
-         {
-            out_data->command = SOUND_PLAY;
-            snprintf(out_data->filename, MAX_FILENAME_LENGTH, "%s%s", get_sound_path(), file);
-            out_data->start_percent = 0;
-            LOG_INFO("Submitting sound to thread %d", current_thread);
-            if (mq_send(qd_clients[current_thread], out_buffer, sizeof(audio_msg), 0) == -1) {
-               perror("Client: Not able to send message to server");
+         pthread_mutex_lock(&voice_mutex);
+         for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+            if (voices[i].clip == NULL) {
+               voices[i].clip = clip;
+               voices[i].position = 0;
+               if ((start_percent > 0.0) && (start_percent < 1.0)) {
+                  voices[i].position = (size_t) (clip->frames * start_percent);
+               }
+               active_voices++;
+#ifdef AUDIO_DEBUG
+               LOG_INFO("Playing %s on voice %d.", file, i);
+#endif
+               ret = SUCCESS;
+               break;
             }
-         } else {
-            LOG_ERROR("No audio threads available.");
+         }
+         pthread_cond_signal(&voice_cond);
+         pthread_mutex_unlock(&voice_mutex);
+
+         if (ret != SUCCESS) {
+            LOG_ERROR("No audio voices available.");
          }
          break;
       case SOUND_STOP:
-         for (int i = 0; i < NUM_AUDIO_THREADS; i++) {
-            if (strncmp(audio_threads[i].filename, file, MAX_FILENAME_LENGTH) == 0) {
-               LOG_INFO("Stopping thread %d.", i);
-               audio_threads[i].stop = 1;
-               //pthread_join( thread_handles[i], NULL );
-               LOG_INFO("Thread [%d] stop.", i);
-               break;
+         snprintf(path, sizeof(path), "%s%s", get_sound_path(), file);
+         pthread_mutex_lock(&voice_mutex);
+         for (int i = 0; i < AUDIO_MAX_VOICES; i++) {
+            if ((voices[i].clip != NULL) &&
+                (strncmp(voices[i].clip->path, path, AUDIO_PATH_LENGTH) == 0)) {
+               LOG_INFO("Stopping voice %d.", i);
+               voices[i].clip = NULL;
+               active_voices--;
+               ret = SUCCESS;
             }
          }
+         pthread_mutex_unlock(&voice_mutex);
          break;
       default:
          break;
    }
 
-   return SUCCESS;
+   return ret;
 }
-
-
@@ -22,8 +22,6 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
-#include <mqueue.h>
-
 /* Audio playback commands. */
 /* TODO: Replace text strings with JSON. */
 enum commands { SOUND_PLAY, SOUND_STOP };
@@ -45,27 +43,43 @@ enum commands { SOUND_PLAY, SOUND_STOP };
  *    remote shutdown command
  */
 
-/* Audio thread type and local threads. */
-typedef struct _thread_info {
-   int thread_id;
-   char filename[MAX_FILENAME_LENGTH];
-   double start_percent;
-   int stop;
+/* Sound playback.
+ *
+ * Every .ogg in the sound path is decoded once, after the config has set that
+ * path, and converted to AUDIO_MIX_RATE stereo S16 in memory. Clips are keyed
+ * by full path, so a sound played from another path is decoded on first use. A single mixer thread owns one ALSA
+ * stream for the life of the program and sums up to AUDIO_MAX_VOICES cached
+ * clips into it, so starting or stopping a sound is a table update.
+ */
 
-   char client_queue_name[MAX_FILENAME_LENGTH];
-   mqd_t qd_server, qd_client;
-} thread_info;
+/**
+ * @brief Opens the output stream and starts the mixer.
+ *
+ * @return SUCCESS, or FAILURE if the mixer thread couldn't start. A missing or
+ *         unusable ALSA device is logged and sounds are then silently dropped.
+ */
+int audio_init(void);
 
-/* MQUEUE messages for audio commands handed to threads. */
-typedef struct _audio_msg {
-   int command;
-   char filename[MAX_FILENAME_LENGTH];
-   double start_percent;
-} audio_msg;
+/**
+ * @brief Decodes every .ogg in the current sound path that isn't cached yet.
+ *
+ * Call once the config has set the sound path. Safe while the mixer runs.
+ */
+void audio_preload(void);
 
+/**
+ * @brief Stops the mixer, closes the output stream and frees the sound cache.
+ */
+void audio_cleanup(void);
 
-void *audio_thread(void *arg);
+/**
+ * @brief Starts or stops a sound.
+ *
+ * @param command       SOUND_PLAY or SOUND_STOP.
+ * @param file          File name relative to the sound path.
+ * @param start_percent Where to start playing, 0.0 to 1.0. Ignored for stop.
+ * @return SUCCESS, or FAILURE if the sound couldn't be loaded or no voice was free.
+ */
 int process_audio_command(int command, char *file, double start_percent);
 
 #endif // AUDIO_H
-
@@ -0,0 +1,214 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+/* Checks that the asynchronous log ring loses nothing on the way out.
+ *
+ * Several threads log numbered records to a file, then the ring is drained
+ * by close_logging(), a few rounds over, and once by the atexit() handler in
+ * a child that simply exits. Each time every record must reach the file, in
+ * order per thread. Links logging.c only.
+ *
+ *   log_ring_check [scratch_dir]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+#define CHECK_THREADS      4       /* Plus the main thread, which logs last. */
+#define CHECK_RECORDS      50      /* Per thread. All of them fit in the ring at once. */
+#define CHECK_ERROR_EVERY  10      /* Every Nth record is an error, to hit the flush path. */
+#define CHECK_ROUNDS       8       /* close_logging() passes. A lost tail only shows up sometimes. */
+#define CHECK_LINE_STRIDE  1000    /* Call site lines per round, so no site hits the rate limit. */
+
+typedef struct {
+   int thread;
+   int line_base;
+} check_thread_arg;
+
+static void *log_records(void *arg)
+{
+   const check_thread_arg *this_arg = arg;
+
+   /* A call site per record, the rate limit would otherwise drop most of them. */
+   for (int i = 0; i < CHECK_RECORDS; i++) {
+      log_message((i % CHECK_ERROR_EVERY) == 0 ? LOG_ERROR : LOG_INFO, __FILE__,
+                  this_arg->line_base + this_arg->thread * CHECK_RECORDS + i, __func__,
+                  "thread %d record %d", this_arg->thread, i);
+   }
+
+   return NULL;
+}
+
+/* The main thread's records go in right before the caller closes, so most
+ * of them are still queued when the writer is told to stop. */
+static int log_from_threads(int line_base)
+{
+   pthread_t threads[CHECK_THREADS];
+   check_thread_arg args[CHECK_THREADS + 1];
+
+   for (int t = 0; t < CHECK_THREADS; t++) {
+      args[t].thread = t;
+      args[t].line_base = line_base;
+      if (pthread_create(&threads[t], NULL, log_records, &args[t]) != 0) {
+         fprintf(stderr, "Unable to start logging thread %d.\n", t);
+         return EXIT_FAILURE;
+      }
+   }
+   for (int t = 0; t < CHECK_THREADS; t++) {
+      pthread_join(threads[t], NULL);
+   }
+
+   args[CHECK_THREADS].thread = CHECK_THREADS;
+   args[CHECK_THREADS].line_base = line_base;
+   log_records(&args[CHECK_THREADS]);
+
+   return EXIT_SUCCESS;
+}
+
+/* Every record of every thread, once, in the order that thread logged them. */
+static int verify_log(const char *path, const char *pass)
+{
+   int next[CHECK_THREADS + 1] = { 0 };
+   char line[2048];
+   FILE *log = fopen(path, "r");
+   int ret = EXIT_SUCCESS;
+
+   if (log == NULL) {
+      fprintf(stderr, "%s: unable to open %s.\n", pass, path);
+      return EXIT_FAILURE;
+   }
+
+   while (fgets(line, sizeof(line), log) != NULL) {
+      const char *record = strstr(line, "thread ");
+      int thread = 0, index = 0;
+
+      if ((record == NULL) || (sscanf(record, "thread %d record %d", &thread, &index) != 2) ||
+          (thread < 0) || (thread > CHECK_THREADS)) {
+         continue;
+      }
+      if (index != next[thread]) {
+         fprintf(stderr, "%s: thread %d wrote record %d, expected %d.\n", pass, thread, index,
+                 next[thread]);
+         ret = EXIT_FAILURE;
+      }
+      next[thread] = index + 1;
+   }
+   fclose(log);
+
+   for (int t = 0; t <= CHECK_THREADS; t++) {
+      if (next[t] != CHECK_RECORDS) {
+         fprintf(stderr, "%s: thread %d stopped at record %d of %d.\n", pass, t, next[t],
+                 CHECK_RECORDS);
+         ret = EXIT_FAILURE;
+      }
+   }
+
+   printf("%s: %s\n", pass, ret == EXIT_SUCCESS ? "ok" : "FAILED");
+
+   return ret;
+}
+
+/* Queue everything, then let close_logging() stop the writer and drain. */
+static int check_close(const char *path, int round)
+{
+   log_stats before, after;
+
+   log_get_stats(&before);
+   if (init_logging(path, LOG_TO_FILE) != 0) {
+      return EXIT_FAILURE;
+   }
+   if (log_from_threads(round * CHECK_LINE_STRIDE) != EXIT_SUCCESS) {
+      close_logging();
+      return EXIT_FAILURE;
+   }
+   close_logging();
+   log_get_stats(&after);
+
+   if ((after.dropped_full != before.dropped_full) || (after.dropped_rate != before.dropped_rate)) {
+      fprintf(stderr, "close: %lu records dropped, ring full, %lu rate limited.\n",
+              after.dropped_full - before.dropped_full, after.dropped_rate - before.dropped_rate);
+      return EXIT_FAILURE;
+   }
+
+   return verify_log(path, "close");
+}
+
+/* Same again in a child that exits without closing, leaving it to atexit(). */
+static int check_exit(const char *path)
+{
+   int status = 0;
+   pid_t child;
+
+   /* The child would print whatever is still buffered a second time. */
+   fflush(stdout);
+   child = fork();
+
+   if (child < 0) {
+      perror("fork");
+      return EXIT_FAILURE;
+   }
+
+   if (child == 0) {
+      if (init_logging(path, LOG_TO_FILE) != 0) {
+         _exit(EXIT_FAILURE);
+      }
+      exit(log_from_threads(CHECK_ROUNDS * CHECK_LINE_STRIDE));
+   }
+
+   if ((waitpid(child, &status, 0) != child) || !WIFEXITED(status) ||
+       (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+      fprintf(stderr, "exit: child failed.\n");
+      return EXIT_FAILURE;
+   }
+
+   return verify_log(path, "exit");
+}
+
+int main(int argc, char *argv[])
+{
+   const char *dir = (argc > 1) ? argv[1] : "/tmp";
+   char close_path[1024];
+   char exit_path[1024];
+   int ret = EXIT_SUCCESS;
+
+   snprintf(close_path, sizeof(close_path), "%s/log_ring_check_close.%d.log", dir, (int) getpid());
+   snprintf(exit_path, sizeof(exit_path), "%s/log_ring_check_exit.%d.log", dir, (int) getpid());
+
+   for (int round = 0; (round < CHECK_ROUNDS) && (ret == EXIT_SUCCESS); round++) {
+      ret = check_close(close_path, round);
+   }
+   if (check_exit(exit_path) != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+   }
+
+   if (ret == EXIT_SUCCESS) {
+      unlink(close_path);
+      unlink(exit_path);
+   }
+
+   return ret;
+}
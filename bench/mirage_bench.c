@@ -0,0 +1,693 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+/* Micro-benchmarks for the hot paths.
+ *
+ * Links the same sources as mirage (mirage.c with MIRAGE_BENCH, which drops
+ * its main()) and runs each kernel with a fixed seed across representative
+ * sizes, so runs on the same machine can be compared. Needs a display and an
+ * OpenGL renderer, the readback benchmarks are skipped without one.
+ *
+ *   mirage_bench [-c config.json] [-f filter] [-n iterations] [-o report.txt]
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
+
+#include "defines.h"
+#include "command_processing.h"
+#include "config_manager.h"
+#include "config_parser.h"
+#include "element_renderer.h"
+#include "hud_manager.h"
+#include "image_utils.h"
+#include "latency_stats.h"
+#include "logging.h"
+#include "mirage.h"
+#include "screenshot.h"
+#include "texture_atlas.h"
+#include "texture_cache.h"
+
+extern detect this_detect[2][MAX_DETECT];
+
+#define BENCH_DEFAULT_ITERATIONS 200
+#define BENCH_WARMUP             5
+#define BENCH_MAX_SAMPLES        10000
+#define BENCH_SEED               12345
+
+typedef struct {
+   const char *name;
+   int width;           /* Per eye. */
+   int height;
+} bench_size;
+
+static const bench_size bench_sizes[] = {
+   { "720p", 1280, 720 },
+   { "1080p", 1920, 1080 },
+   { "1440p", 2560, 1440 }
+};
+#define BENCH_SIZE_COUNT (int) (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static const int bench_element_counts[] = { 10, 100, 1000 };
+#define BENCH_COUNT_COUNT (int) (sizeof(bench_element_counts) / sizeof(bench_element_counts[0]))
+
+/* Payloads captured from the helmet and MQTT, one per common device. */
+static const struct {
+   const char *topic;
+   const char *payload;
+} bench_commands[] = {
+   { "helmet", "{ \"device\": \"Motion\", \"format\": \"Orientation\", \"heading\": 271.5, "
+               "\"pitch\": -3.25, \"roll\": 1.75 }" },
+   { "helmet", "{ \"device\": \"Enviro\", \"temp\": 31.2, \"humidity\": 48.0, "
+               "\"air_quality\": 92.0, \"air_quality_description\": \"Good\", "
+               "\"tvoc_ppb\": 87.0, \"eco2_ppm\": 612.0, \"co2_ppm\": 540.0, "
+               "\"co2_quality_description\": \"Normal\", \"heat_index_c\": 32.1, "
+               "\"dew_point\": 18.4 }" },
+   { "helmet", "{ \"device\": \"GPS\", \"time\": \"19:24:07\", \"date\": \"2024-06-14\", "
+               "\"fix\": 1, \"quality\": 2, \"latitude\": 39.6034, \"longitude\": -119.6822, "
+               "\"speed\": 1.2, \"altitude\": 1372.0, \"satellites\": 9 }" },
+   { "stat", "{ \"device\": \"SystemMetrics\", \"cpu_usage\": 37.5, "
+             "\"memory_usage\": 61.2, \"system_temp\": 54.0 }" },
+   { "stat", "{ \"device\": \"Battery\", \"battery_level\": 74.0, \"voltage\": 15.8, "
+             "\"current\": 1.9, \"power\": 30.0, \"time_remaining_min\": 212, "
+             "\"time_remaining_fmt\": \"3h 32m\" }" },
+   { "helmet", "{ \"device\": \"unknown\", \"action\": \"noop\" }" }
+};
+#define BENCH_COMMAND_COUNT (int) (sizeof(bench_commands) / sizeof(bench_commands[0]))
+
+typedef struct {
+   unsigned long samples[BENCH_MAX_SAMPLES];
+   int count;
+} bench_run;
+
+static FILE *report = NULL;
+static const char *filter = NULL;
+static int iterations = BENCH_DEFAULT_ITERATIONS;
+static unsigned int rand_state = BENCH_SEED;
+static SDL_Renderer *bench_renderer = NULL;
+static int have_gl = 0;
+
+/* Same sequence every run, independent of libc. */
+static int bench_rand(int range)
+{
+   rand_state = rand_state * 1103515245u + 12345u;
+
+   return (int) ((rand_state >> 8) % (unsigned int) range);
+}
+
+static int bench_enabled(const char *name)
+{
+   return (filter == NULL) || (strstr(name, filter) != NULL);
+}
+
+static int compare_ulong(const void *a, const void *b)
+{
+   unsigned long x = *(const unsigned long *) a;
+   unsigned long y = *(const unsigned long *) b;
+
+   return (x > y) - (x < y);
+}
+
+/* Report per-operation times. Each sample timed ops operations. */
+static void bench_report(const char *name, const char *size, bench_run *run, int ops)
+{
+   double total = 0.0;
+
+   if (run->count == 0) {
+      return;
+   }
+
+   qsort(run->samples, run->count, sizeof(unsigned long), compare_ulong);
+   for (int i = 0; i < run->count; i++) {
+      total += run->samples[i];
+   }
+
+#define BENCH_US(ns) ((double) (ns) / 1000.0 / ops)
+   fprintf(report, "%-28s %-10s %8d %12.3f %12.3f %12.3f %12.3f\n", name, size,
+           run->count * ops, BENCH_US(run->samples[0]), BENCH_US(run->samples[run->count / 2]),
+           BENCH_US(run->samples[(run->count * 95) / 100]), BENCH_US(total / run->count));
+#undef BENCH_US
+   fflush(report);
+}
+
+static void bench_sample(bench_run *run, unsigned long start_ns)
+{
+   if (run->count < BENCH_MAX_SAMPLES) {
+      run->samples[run->count++] = latency_now_ns() - start_ns;
+   }
+}
+
+static void set_eye_size(const bench_size *size)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+
+   this_hds->eye_output_width = size->width;
+   this_hds->eye_output_height = size->height;
+   this_hds->cam_frame_width = size->width;
+}
+
+/* A render target the size of the stereo output, made current. */
+static SDL_Texture *make_target(const bench_size *size)
+{
+   SDL_Texture *target = SDL_CreateTexture(bench_renderer, SDL_PIXELFORMAT_ABGR8888,
+                                           SDL_TEXTUREACCESS_TARGET, size->width * 2,
+                                           size->height);
+
+   if (target != NULL) {
+      SDL_SetRenderTarget(bench_renderer, target);
+      SDL_RenderClear(bench_renderer);
+      SDL_RenderFlush(bench_renderer);
+   }
+
+   return target;
+}
+
+/* renderStereo(): clip math plus the draw submit. A quarter of the rects
+ * cross an eye edge and a few are rotated, like a busy HUD. */
+static void bench_render_stereo(void)
+{
+   SDL_Texture *tex = SDL_CreateTexture(bench_renderer, SDL_PIXELFORMAT_ABGR8888,
+                                        SDL_TEXTUREACCESS_STATIC, 256, 256);
+
+   if (!bench_enabled("renderStereo") || (tex == NULL)) {
+      SDL_DestroyTexture(tex);
+      return;
+   }
+
+   for (int s = 0; s < BENCH_SIZE_COUNT; s++) {
+      SDL_Texture *target = make_target(&bench_sizes[s]);
+
+      set_eye_size(&bench_sizes[s]);
+      for (int c = 0; c < BENCH_COUNT_COUNT; c++) {
+         int count = bench_element_counts[c];
+         SDL_Rect *rects = calloc(count, sizeof(SDL_Rect));
+         double *angles = calloc(count, sizeof(double));
+         bench_run run = { .count = 0 };
+         char label[32];
+
+         if ((rects == NULL) || (angles == NULL)) {
+            free(rects);
+            free(angles);
+            continue;
+         }
+
+         rand_state = BENCH_SEED;
+         for (int i = 0; i < count; i++) {
+            rects[i].w = 32 + bench_rand(256);
+            rects[i].h = 32 + bench_rand(256);
+            if (bench_rand(4) == 0) {
+               rects[i].x = bench_sizes[s].width - rects[i].w / 2;
+               rects[i].y = -rects[i].h / 2;
+            } else {
+               rects[i].x = bench_rand(bench_sizes[s].width - rects[i].w);
+               rects[i].y = bench_rand(bench_sizes[s].height - rects[i].h);
+            }
+            angles[i] = (bench_rand(10) == 0) ? (double) bench_rand(360) : 0.0;
+         }
+
+         for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+            unsigned long start = latency_now_ns();
+
+            for (int i = 0; i < count; i++) {
+               renderStereo(tex, NULL, &rects[i], NULL, angles[i]);
+            }
+            texture_atlas_flush();
+            SDL_RenderFlush(bench_renderer);
+
+            if (it >= BENCH_WARMUP) {
+               bench_sample(&run, start);
+            }
+         }
+
+         snprintf(label, sizeof(label), "%s/%d", bench_sizes[s].name, count);
+         bench_report("renderStereo", label, &run, count);
+         free(rects);
+         free(angles);
+      }
+
+      SDL_SetRenderTarget(bench_renderer, NULL);
+      SDL_DestroyTexture(target);
+   }
+
+   SDL_DestroyTexture(tex);
+}
+
+/* validate_detection(): pairing n detections per eye. */
+static void bench_validate_detection(void)
+{
+   static const int detect_counts[] = { 4, 16, MAX_DETECT };
+
+   if (!bench_enabled("validate_detection")) {
+      return;
+   }
+
+   for (int s = 0; s < BENCH_SIZE_COUNT; s++) {
+      set_eye_size(&bench_sizes[s]);
+
+      for (size_t c = 0; c < sizeof(detect_counts) / sizeof(detect_counts[0]); c++) {
+         int count = detect_counts[c] > MAX_DETECT ? MAX_DETECT : detect_counts[c];
+         bench_run run = { .count = 0 };
+         char label[32];
+
+         rand_state = BENCH_SEED;
+         memset(this_detect, 0, sizeof(this_detect));
+         for (int i = 0; i < count; i++) {
+            detect *l = &this_detect[0][i];
+            detect *r = &this_detect[1][i];
+
+            l->active = r->active = 1;
+            l->class_id = r->class_id = bench_rand(8);
+            l->confidence = r->confidence = 0.5f + bench_rand(50) / 100.0f;
+            l->width = 40 + bench_rand(200);
+            l->height = 40 + bench_rand(200);
+            l->left = bench_rand(bench_sizes[s].width - 240);
+            l->top = bench_rand(bench_sizes[s].height - 240);
+            *r = *l;
+            r->left -= bench_rand(40);
+            r->top += bench_rand(5);
+         }
+
+         for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+            unsigned long start = latency_now_ns();
+
+            for (int rep = 0; rep < 100; rep++) {
+               validate_detection();
+            }
+
+            if (it >= BENCH_WARMUP) {
+               bench_sample(&run, start);
+            }
+         }
+
+         snprintf(label, sizeof(label), "%s/%d", bench_sizes[s].name, count);
+         bench_report("validate_detection", label, &run, 100);
+      }
+   }
+}
+
+/* render_text_element(): token resolution and the cached text path, over
+ * every text element in the loaded config. */
+static void bench_render_text(void)
+{
+   element *text_elements[1024];
+   int count = 0;
+
+   if (!bench_enabled("render_text_element")) {
+      return;
+   }
+
+   for (element *curr = get_first_element(); (curr != NULL) && (count < 1024);
+        curr = curr->next) {
+      if (curr->type == TEXT) {
+         text_elements[count++] = curr;
+      }
+   }
+   if (count == 0) {
+      fprintf(report, "%-28s skipped, the config has no text elements\n", "render_text_element");
+      return;
+   }
+
+   for (int s = 0; s < BENCH_SIZE_COUNT; s++) {
+      SDL_Texture *target = make_target(&bench_sizes[s]);
+      bench_run run = { .count = 0 };
+      char label[32];
+
+      set_eye_size(&bench_sizes[s]);
+      for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+         unsigned long start = latency_now_ns();
+
+         for (int i = 0; i < count; i++) {
+            render_text_element(text_elements[i]);
+         }
+         texture_atlas_flush();
+         SDL_RenderFlush(bench_renderer);
+
+         if (it >= BENCH_WARMUP) {
+            bench_sample(&run, start);
+         }
+      }
+
+      snprintf(label, sizeof(label), "%s/%d", bench_sizes[s].name, count);
+      bench_report("render_text_element", label, &run, count);
+      SDL_SetRenderTarget(bench_renderer, NULL);
+      SDL_DestroyTexture(target);
+   }
+}
+
+/* parse_json_command(): parse and dispatch of captured payloads. */
+static void bench_parse_json_command(void)
+{
+   char buffer[1024];
+
+   if (!bench_enabled("parse_json_command")) {
+      return;
+   }
+
+   for (int c = 0; c < BENCH_COMMAND_COUNT; c++) {
+      bench_run run = { .count = 0 };
+      char label[32];
+
+      for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+         unsigned long start = latency_now_ns();
+
+         for (int rep = 0; rep < 100; rep++) {
+            /* Handlers may edit the string in place, give each call a fresh copy. */
+            snprintf(buffer, sizeof(buffer), "%s", bench_commands[c].payload);
+            parse_json_command(buffer, (char *) bench_commands[c].topic);
+         }
+
+         if (it >= BENCH_WARMUP) {
+            bench_sample(&run, start);
+         }
+      }
+
+      snprintf(label, sizeof(label), "payload%d", c);
+      bench_report("parse_json_command", label, &run, 100);
+   }
+}
+
+/* process_and_save_image(): crop, scale and encode one frame of each size. */
+static void bench_process_and_save_image(void)
+{
+   static const char *formats[] = { "jpg", "png" };
+
+   if (!bench_enabled("process_and_save_image")) {
+      return;
+   }
+
+   for (int s = 0; s < BENCH_SIZE_COUNT; s++) {
+      int width = bench_sizes[s].width * 2;
+      int height = bench_sizes[s].height;
+      unsigned char *rgba = malloc((size_t) width * height * 4);
+
+      if (rgba == NULL) {
+         continue;
+      }
+
+      /* Smooth gradients with a little noise, closer to a camera frame than random bytes. */
+      rand_state = BENCH_SEED;
+      for (int y = 0; y < height; y++) {
+         for (int x = 0; x < width; x++) {
+            unsigned char *p = rgba + ((size_t) y * width + x) * 4;
+
+            p[0] = (x * 255 / width) ^ bench_rand(8);
+            p[1] = (y * 255 / height) ^ bench_rand(8);
+            p[2] = ((x + y) & 0xff);
+            p[3] = 255;
+         }
+      }
+
+      for (int f = 0; f < 2; f++) {
+         bench_run run = { .count = 0 };
+         char filename[64];
+         ImageProcessParams params;
+         /* Encoding a frame is slow, keep the run to a few seconds. */
+         int runs = iterations / 20 > 3 ? iterations / 20 : 3;
+
+         snprintf(filename, sizeof(filename), "/tmp/mirage_bench.%s", formats[f]);
+         memset(&params, 0, sizeof(params));
+         params.rgba_buffer = rgba;
+         params.orig_width = width;
+         params.orig_height = height;
+         params.filename = filename;
+         params.new_width = bench_sizes[s].width;
+         params.new_height = bench_sizes[s].height / 2;
+         if (f == 0) {
+            params.format_params.quality = 90;
+         } else {
+            params.format_params.compression = 6;
+         }
+
+         for (int it = 0; it < 1 + runs; it++) {
+            unsigned long start = latency_now_ns();
+
+            if (process_and_save_image(&params) != IMG_SUCCESS) {
+               fprintf(report, "%-28s process_and_save_image failed for %s\n", "", filename);
+               break;
+            }
+
+            if (it >= 1) {
+               bench_sample(&run, start);
+            }
+         }
+         remove(filename);
+
+         char label[32];
+         snprintf(label, sizeof(label), "%s/%s", bench_sizes[s].name, formats[f]);
+         bench_report("process_and_save_image", label, &run, 1);
+      }
+
+      free(rgba);
+   }
+}
+
+/* OpenGL_RenderReadPixels*(): full stereo frame readback. */
+static void bench_readback(void)
+{
+   if (!bench_enabled("ReadPixels")) {
+      return;
+   }
+
+   if (!have_gl) {
+      fprintf(report, "%-28s skipped, not an OpenGL renderer\n", "OpenGL_RenderReadPixels");
+      return;
+   }
+
+   for (int s = 0; s < BENCH_SIZE_COUNT; s++) {
+      SDL_Texture *target = make_target(&bench_sizes[s]);
+      SDL_Rect rect = { 0, 0, bench_sizes[s].width * 2, bench_sizes[s].height };
+      int pitch = rect.w * 4;
+      unsigned char *pixels = malloc((size_t) pitch * rect.h);
+
+      if ((target == NULL) || (pixels == NULL)) {
+         free(pixels);
+         SDL_DestroyTexture(target);
+         continue;
+      }
+
+      for (int mode = 0; mode < 2; mode++) {
+         bench_run run = { .count = 0 };
+
+         for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+            unsigned long start = 0;
+
+            /* Dirty the target so the driver can't skip the read. */
+            SDL_SetRenderDrawColor(bench_renderer, it & 0xff, 0x40, 0x80, 0xff);
+            SDL_RenderClear(bench_renderer);
+            SDL_RenderFlush(bench_renderer);
+
+            start = latency_now_ns();
+            if (mode == 0) {
+               OpenGL_RenderReadPixelsSync(bench_renderer, &rect, SDL_PIXELFORMAT_ABGR8888,
+                                           pixels, pitch);
+            } else {
+               OpenGL_RenderReadPixelsAsync(bench_renderer, &rect, SDL_PIXELFORMAT_ABGR8888,
+                                            pixels, pitch);
+            }
+
+            if (it >= BENCH_WARMUP) {
+               bench_sample(&run, start);
+            }
+         }
+
+         bench_report(mode == 0 ? "OpenGL_RenderReadPixelsSync" : "OpenGL_RenderReadPixelsAsync",
+                      bench_sizes[s].name, &run, 1);
+      }
+
+      free(pixels);
+      SDL_SetRenderTarget(bench_renderer, NULL);
+      SDL_DestroyTexture(target);
+   }
+}
+
+/* get_cached_texture(): hit lookups over every element texture path, plus the
+ * release that goes with each. */
+static void bench_texture_lookup(void)
+{
+   const char *paths[1024];
+   int count = 0;
+
+   if (!bench_enabled("get_cached_texture")) {
+      return;
+   }
+
+   for (element *curr = get_first_element(); (curr != NULL) && (count < 1024);
+        curr = curr->next) {
+      if ((curr->texture != NULL) && (curr->filename != NULL) && (curr->filename[0] != '\0')) {
+         paths[count++] = curr->filename;
+      }
+   }
+   if (count == 0) {
+      fprintf(report, "%-28s skipped, no cached textures\n", "get_cached_texture");
+      return;
+   }
+
+   for (int c = 0; c < BENCH_COUNT_COUNT; c++) {
+      int lookups = bench_element_counts[c];
+      bench_run run = { .count = 0 };
+      char label[32];
+
+      rand_state = BENCH_SEED;
+      for (int it = 0; it < BENCH_WARMUP + iterations; it++) {
+         unsigned long start = latency_now_ns();
+
+         for (int i = 0; i < lookups; i++) {
+            const char *path = paths[bench_rand(count)];
+
+            if (get_cached_texture(path) != NULL) {
+               release_cached_texture(path);
+            }
+         }
+
+         if (it >= BENCH_WARMUP) {
+            bench_sample(&run, start);
+         }
+      }
+
+      snprintf(label, sizeof(label), "%d/%d", count, lookups);
+      bench_report("get_cached_texture", label, &run, lookups);
+   }
+}
+
+static void usage(const char *name)
+{
+   printf("Usage: %s [-c config.json] [-f filter] [-n iterations] [-o report.txt]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+   const char *config_file = "config.json";
+   const char *output = NULL;
+   SDL_Window *window = NULL;
+   SDL_GLContext context = NULL;
+   SDL_RendererInfo info;
+   int opt = 0;
+
+   while ((opt = getopt(argc, argv, "c:f:n:o:h")) != -1) {
+      switch (opt) {
+         case 'c':
+            config_file = optarg;
+            break;
+         case 'f':
+            filter = optarg;
+            break;
+         case 'n':
+            iterations = atoi(optarg);
+            if ((iterations < 1) || (iterations > BENCH_MAX_SAMPLES)) {
+               iterations = BENCH_DEFAULT_ITERATIONS;
+            }
+            break;
+         case 'o':
+            output = optarg;
+            break;
+         default:
+            usage(argv[0]);
+            return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   report = stdout;
+   if ((output != NULL) && ((report = fopen(output, "w")) == NULL)) {
+      fprintf(stderr, "Unable to open report file: %s\n", output);
+      return EXIT_FAILURE;
+   }
+
+   /* Keep the log off the console so it doesn't mix with the report. */
+   init_logging("mirage_bench.log", 1);
+
+   if ((SDL_Init(SDL_INIT_VIDEO) < 0) || (IMG_Init(IMG_INIT_PNG) < 0) || (TTF_Init() < 0)) {
+      fprintf(stderr, "SDL init failed: %s\n", SDL_GetError());
+      return EXIT_FAILURE;
+   }
+
+   SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+   window = SDL_CreateWindow("mirage_bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                             640, 360, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+   if (window == NULL) {
+      fprintf(stderr, "SDL_CreateWindow() failed: %s\n", SDL_GetError());
+      return EXIT_FAILURE;
+   }
+
+   context = SDL_GL_CreateContext(window);
+   if ((context != NULL) && (SDL_GL_MakeCurrent(window, context) == 0) &&
+       (glewInit() == GLEW_OK)) {
+      have_gl = 1;
+   }
+
+   bench_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+   if (bench_renderer == NULL) {
+      fprintf(stderr, "SDL_CreateRenderer() failed: %s\n", SDL_GetError());
+      return EXIT_FAILURE;
+   }
+   SDL_GetRendererInfo(bench_renderer, &info);
+   have_gl = have_gl && (strncmp(info.name, "opengl", 6) == 0);
+   mirage_bench_set_renderer(bench_renderer);
+
+   if (have_gl) {
+      init_pbo_system();
+   }
+
+   init_hud_manager();
+   command_processing_init();
+   if (parse_json_config(config_file) != SUCCESS) {
+      fprintf(stderr, "Unable to load config: %s\n", config_file);
+      return EXIT_FAILURE;
+   }
+
+   fprintf(report, "mirage_bench %s, renderer %s, %d iterations. Times in microseconds per op.\n",
+           GIT_SHA, info.name, iterations);
+   fprintf(report, "%-28s %-10s %8s %12s %12s %12s %12s\n", "benchmark", "size", "ops",
+           "min", "median", "p95", "mean");
+
+   bench_render_stereo();
+   bench_validate_detection();
+   bench_render_text();
+   bench_parse_json_command();
+   bench_process_and_save_image();
+   bench_readback();
+   bench_texture_lookup();
+
+   if (have_gl) {
+      cleanup_pbo_system();
+   }
+   SDL_DestroyRenderer(bench_renderer);
+   if (context != NULL) {
+      SDL_GL_DeleteContext(context);
+   }
+   SDL_DestroyWindow(window);
+   TTF_Quit();
+   IMG_Quit();
+   SDL_Quit();
+   close_logging();
+
+   if (report != stdout) {
+      fclose(report);
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,356 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "camera_governor.h"
+#include "defines.h"
+#include "latency_stats.h"
+#include "logging.h"
+#include "mirage.h"
+#include "system_metrics.h"
+
+typedef struct {
+   char name[CAMERA_PROFILE_NAME_LENGTH];
+   int width;
+   int height;
+   int fps;
+} camera_profile;
+
+static camera_profile profiles[MAX_CAMERA_PROFILES];
+static int profile_count = 0;
+
+/* Profile indices. -1 is the startup camera mode, whether or not it came from a profile. */
+static int base_profile = -1;       /* Chosen by config or by hand. The governor steps from here. */
+static int active_profile = -1;     /* What the pipeline runs. */
+static int pending_profile = -1;
+static int pending = 0;
+static int camera_stopped = 0;      /* Camera thread has torn its pipeline down for the switch. */
+static int initialized = 0;         /* Profiles are read once, like the rest of the camera setup. */
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t applied_cond = PTHREAD_COND_INITIALIZER;
+
+/* The startup mode. Crops are scaled from it for other input sizes. */
+static camera_profile startup_mode;
+static int startup_crop_x = 0;
+static int startup_crop_width = 0;
+
+static atomic_int governor_level = 0;
+static unsigned long last_sample_ms = 0;
+static unsigned long cool_since_ms = 0;
+
+/* Caller holds profile_mutex. */
+static int find_profile(const char *name)
+{
+   for (int i = 0; (name != NULL) && (i < profile_count); i++) {
+      if (strcmp(profiles[i].name, name) == 0) {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+static const camera_profile *profile_mode(int index)
+{
+   return (index < 0) ? &startup_mode : &profiles[index];
+}
+
+static long pixel_rate(const camera_profile *mode)
+{
+   return (long) mode->width * mode->height * mode->fps;
+}
+
+/* Caller holds profile_mutex. Where the base and the level land in the list. */
+static int target_profile(int level)
+{
+   int target = base_profile + level;
+
+   /* Not started from a profile: the first step is the first profile that's cheaper. */
+   if (base_profile < 0) {
+      target = profile_count;
+      for (int i = 0; i < profile_count; i++) {
+         if (pixel_rate(&profiles[i]) < pixel_rate(&startup_mode)) {
+            target = i;
+            break;
+         }
+      }
+      if (target == profile_count) {
+         return -1;
+      }
+      target += level - 1;
+   }
+
+   if (target > profile_count - 1) {
+      target = profile_count - 1;
+   }
+
+   return (level == 0) ? base_profile : target;
+}
+
+/* Caller holds profile_mutex. */
+static void request_profile(int index)
+{
+   pending_profile = index;
+   pending = (index != active_profile);
+}
+
+static void apply_mode(hud_display_settings *hds, const camera_profile *mode)
+{
+   hds->cam_input_width = mode->width;
+   hds->cam_input_height = mode->height;
+   hds->cam_input_fps = mode->fps;
+   hds->cam_frame_duration = (long) 1000000000 / mode->fps + 1;
+
+   /* Same part of the sensor, scaled to the new width. */
+   if (startup_mode.width > 0) {
+      hds->cam_crop_x = startup_crop_x * mode->width / startup_mode.width;
+      hds->cam_crop_width = startup_crop_width * mode->width / startup_mode.width;
+   }
+}
+
+void camera_profiles_clear(void)
+{
+   pthread_mutex_lock(&profile_mutex);
+   if (!initialized) {
+      profile_count = 0;
+   }
+   pthread_mutex_unlock(&profile_mutex);
+}
+
+int camera_profile_add(const char *name, int width, int height, int fps)
+{
+   int result = FAILURE;
+
+   if ((name == NULL) || (name[0] == '\0') || (width <= 0) || (height <= 0) || (fps <= 0)) {
+      LOG_WARNING("Ignoring invalid camera profile \"%s\".", name ? name : "");
+      return FAILURE;
+   }
+
+   pthread_mutex_lock(&profile_mutex);
+   if (initialized) {
+      result = SUCCESS;
+   } else if (profile_count < MAX_CAMERA_PROFILES) {
+      camera_profile *profile = &profiles[profile_count++];
+
+      snprintf(profile->name, sizeof(profile->name), "%s", name);
+      profile->width = width;
+      profile->height = height;
+      profile->fps = fps;
+      result = SUCCESS;
+   } else {
+      LOG_WARNING("Too many camera profiles, ignoring \"%s\".", name);
+   }
+   pthread_mutex_unlock(&profile_mutex);
+
+   return result;
+}
+
+void camera_governor_init(hud_display_settings *hds)
+{
+   pthread_mutex_lock(&profile_mutex);
+
+   if (hds->cam_profile[0] != '\0') {
+      int index = find_profile(hds->cam_profile);
+
+      if (index >= 0) {
+         hds->cam_input_width = profiles[index].width;
+         hds->cam_input_height = profiles[index].height;
+         hds->cam_input_fps = profiles[index].fps;
+         hds->cam_frame_duration = (long) 1000000000 / profiles[index].fps + 1;
+         base_profile = active_profile = index;
+         LOG_INFO("Camera profile: %s (%dx%d at %d fps).", profiles[index].name,
+                  profiles[index].width, profiles[index].height, profiles[index].fps);
+      } else {
+         LOG_WARNING("Camera profile \"%s\" not found, using the configured camera mode.",
+                     hds->cam_profile);
+      }
+   }
+
+   snprintf(startup_mode.name, sizeof(startup_mode.name), "startup");
+   startup_mode.width = hds->cam_input_width;
+   startup_mode.height = hds->cam_input_height;
+   startup_mode.fps = hds->cam_input_fps;
+   startup_crop_x = hds->cam_crop_x;
+   startup_crop_width = hds->cam_crop_width;
+   initialized = 1;
+
+   pthread_mutex_unlock(&profile_mutex);
+}
+
+int camera_profile_select(const char *name)
+{
+   int index = -1;
+
+   pthread_mutex_lock(&profile_mutex);
+   index = find_profile(name);
+   if (index >= 0) {
+      base_profile = index;
+      request_profile(target_profile(atomic_load(&governor_level)));
+   }
+   pthread_mutex_unlock(&profile_mutex);
+
+   if (index < 0) {
+      LOG_WARNING("Unknown camera profile \"%s\".", name);
+      return FAILURE;
+   }
+
+   LOG_INFO("Camera profile \"%s\" selected.", name);
+
+   return SUCCESS;
+}
+
+int camera_profile_pending(void)
+{
+   int result = 0;
+
+   pthread_mutex_lock(&profile_mutex);
+   result = pending;
+   pthread_mutex_unlock(&profile_mutex);
+
+   return result;
+}
+
+void camera_profile_wait_applied(void)
+{
+   struct timespec deadline;
+
+   pthread_mutex_lock(&profile_mutex);
+   camera_stopped = 1;
+   while (pending && !checkShutdown()) {
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += CAMERA_PROFILE_WAIT_NS;
+      if (deadline.tv_nsec >= 1000000000L) {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&applied_cond, &profile_mutex, &deadline);
+   }
+   camera_stopped = 0;
+   pthread_mutex_unlock(&profile_mutex);
+}
+
+int camera_profile_apply_pending(hud_display_settings *hds)
+{
+   const camera_profile *mode = NULL;
+
+   pthread_mutex_lock(&profile_mutex);
+   /* The camera thread reads these settings while its pipeline runs. */
+   if (!pending || !camera_stopped) {
+      pthread_mutex_unlock(&profile_mutex);
+      return FAILURE;
+   }
+
+   mode = profile_mode(pending_profile);
+   apply_mode(hds, mode);
+   active_profile = pending_profile;
+   pending = 0;
+   pthread_cond_broadcast(&applied_cond);
+
+   LOG_INFO("Camera switched to %s: %dx%d at %d fps.", mode->name, mode->width, mode->height,
+            mode->fps);
+   pthread_mutex_unlock(&profile_mutex);
+
+   return SUCCESS;
+}
+
+static void set_level(int level, const char *reason)
+{
+   int old_level = atomic_exchange(&governor_level, level);
+
+   if (old_level == level) {
+      return;
+   }
+
+   pthread_mutex_lock(&profile_mutex);
+   request_profile(target_profile(level));
+   pthread_mutex_unlock(&profile_mutex);
+
+   LOG_WARNING("Performance governor level %d (%s).", level, reason);
+   if (level > old_level) {
+      mqttTextToSpeech("Reducing camera and recording quality to manage load.");
+   } else if (level == 0) {
+      mqttTextToSpeech("Camera and recording quality restored.");
+   }
+}
+
+void camera_governor_update(void)
+{
+   hud_display_settings *hds = get_hud_display_settings();
+   unsigned long now = latency_now_ns() / 1000000UL;
+   int level = atomic_load(&governor_level);
+   int temp_ok = 0, battery_ok = 0;
+   int hot = 0, low_battery = 0, cool = 0;
+
+   if (!hds->governor) {
+      if (level != 0) {
+         set_level(0, "governor disabled");
+      }
+      return;
+   }
+
+   if (now - last_sample_ms < GOVERNOR_INTERVAL_MS) {
+      return;
+   }
+   last_sample_ms = now;
+
+   temp_ok = system_metrics.system_temp_available &&
+             !is_metric_stale(system_metrics.system_temp_update_time, GOVERNOR_METRIC_TIMEOUT_S);
+   battery_ok = system_metrics.power_available &&
+                !is_metric_stale(system_metrics.power_update_time, GOVERNOR_METRIC_TIMEOUT_S) &&
+                (system_metrics.charge_state != CHARGE_STATE_CHARGING);
+
+   hot = temp_ok && (system_metrics.system_temperature >= hds->governor_temp_high);
+   low_battery = battery_ok && (system_metrics.battery_level <= hds->governor_battery_low);
+   cool = (!temp_ok || (system_metrics.system_temperature <= hds->governor_temp_low)) &&
+          (!battery_ok ||
+           (system_metrics.battery_level >= hds->governor_battery_low + GOVERNOR_BATTERY_HYSTERESIS));
+
+   if (hot || low_battery) {
+      cool_since_ms = 0;
+      if (level < GOVERNOR_MAX_LEVEL) {
+         set_level(level + 1, hot ? "temperature" : "battery");
+      }
+   } else if (cool && (level > 0)) {
+      if (cool_since_ms == 0) {
+         cool_since_ms = now;
+      } else if (now - cool_since_ms >= GOVERNOR_RECOVER_MS) {
+         set_level(level - 1, "recovered");
+         cool_since_ms = now;
+      }
+   } else {
+      cool_since_ms = 0;
+   }
+}
+
+int camera_governor_detect_divisor(int base)
+{
+   return base << atomic_load(&governor_level);
+}
+
+int camera_governor_record_divisor(void)
+{
+   return (atomic_load(&governor_level) >= GOVERNOR_RECORD_LEVEL) ? 2 : 1;
+}
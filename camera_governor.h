@@ -0,0 +1,123 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef CAMERA_GOVERNOR_H
+#define CAMERA_GOVERNOR_H
+
+#include "config_manager.h"
+
+/* Camera profiles and the thermal governor.
+ *
+ * A profile is a named camera mode (input size and frame rate) from the
+ * "Camera Profiles" list in the config. The startup profile fixes the frame
+ * geometry the rest of the HUD sees. A switch at runtime only changes what
+ * the sensor captures; the camera pipeline is rebuilt and scales to the same
+ * frame size, so textures and detection are untouched.
+ *
+ * The governor watches system temperature and battery level. Each level
+ * down moves one profile down the list, halves the detection rate, and from
+ * GOVERNOR_RECORD_LEVEL on halves the recording resolution. Recovery steps
+ * back up once things have stayed cool for GOVERNOR_RECOVER_MS.
+ */
+
+#define MAX_CAMERA_PROFILES        8
+#define GOVERNOR_INTERVAL_MS       5000    /* How often the governor may step down. */
+#define GOVERNOR_RECOVER_MS        30000   /* Time below the thresholds before stepping up. */
+#define GOVERNOR_MAX_LEVEL         3
+#define GOVERNOR_RECORD_LEVEL      2       /* First level that reduces the recording size. */
+#define GOVERNOR_BATTERY_HYSTERESIS 5.0    /* Percent above the low mark to count as recovered. */
+#define GOVERNOR_METRIC_TIMEOUT_S  30      /* Older metrics are ignored. */
+#define CAMERA_PROFILE_WAIT_NS     100000000   /* Camera thread rechecks for shutdown this often. */
+
+/**
+ * @brief Empties the profile list. The config parser calls this before adding profiles.
+ *
+ * Like the rest of the camera setup, profiles are only read before
+ * camera_governor_init(). Later config reloads leave them alone.
+ */
+void camera_profiles_clear(void);
+
+/**
+ * @brief Adds a profile. Profiles should be listed best first.
+ *
+ * @return SUCCESS, or FAILURE if the list is full or the profile is invalid.
+ */
+int camera_profile_add(const char *name, int width, int height, int fps);
+
+/**
+ * @brief Applies the configured startup profile and records the base settings.
+ *
+ * Call once after the config is loaded and before update_cam_frame_geometry().
+ */
+void camera_governor_init(hud_display_settings *hds);
+
+/**
+ * @brief Requests a switch to a named profile. Safe from any thread.
+ *
+ * The governor's own steps are taken from this profile from then on.
+ *
+ * @return SUCCESS if the profile exists, FAILURE otherwise.
+ */
+int camera_profile_select(const char *name);
+
+/**
+ * @brief Returns 1 if the camera pipeline should be rebuilt for a new profile.
+ */
+int camera_profile_pending(void);
+
+/**
+ * @brief Waits for the render thread to apply a pending profile.
+ *
+ * Camera thread only, with the pipeline stopped. Returns right away if
+ * nothing is pending, or once the process is shutting down.
+ */
+void camera_profile_wait_applied(void);
+
+/**
+ * @brief Applies a pending profile to the camera input settings.
+ *
+ * Render thread, once per frame. Does nothing until the camera thread is
+ * stopped in camera_profile_wait_applied(), so the settings never change
+ * under a running pipeline. Input size, frame rate and crop change; the
+ * delivered frame geometry does not.
+ *
+ * @return SUCCESS if the settings changed, FAILURE otherwise.
+ */
+int camera_profile_apply_pending(hud_display_settings *hds);
+
+/**
+ * @brief Samples temperature and battery and steps the level if needed. Main loop.
+ */
+void camera_governor_update(void);
+
+/**
+ * @brief Detection frame divisor for the current level.
+ *
+ * @param base The configured "Detect Frame Divisor".
+ */
+int camera_governor_detect_divisor(int base);
+
+/**
+ * @brief Divisor for the recording size at the current level. 1 is full size.
+ */
+int camera_governor_record_divisor(void);
+
+#endif /* CAMERA_GOVERNOR_H */
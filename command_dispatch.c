@@ -0,0 +1,172 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "command_dispatch.h"
+#include "defines.h"
+#include "logging.h"
+
+typedef struct {
+   char device[COMMAND_KEY_LENGTH];   /* Empty matches any device. */
+   char action[COMMAND_KEY_LENGTH];   /* Empty is the device's default. */
+   command_handler handler;
+} command_entry;
+
+static command_entry command_table[COMMAND_TABLE_SIZE];
+static int command_count = 0;
+
+static pthread_key_t tokener_key;
+static pthread_once_t tokener_once = PTHREAD_ONCE_INIT;
+
+/* FNV-1a over both keys, with a separator so ("ab", "c") and ("a", "bc") differ. */
+static uint32_t command_hash(const char *device, const char *action)
+{
+   uint32_t hash = 2166136261u;
+
+   for (const char *c = device; *c != '\0'; c++) {
+      hash = (hash ^ (unsigned char) *c) * 16777619u;
+   }
+   hash = (hash ^ 0xff) * 16777619u;
+   for (const char *c = action; *c != '\0'; c++) {
+      hash = (hash ^ (unsigned char) *c) * 16777619u;
+   }
+
+   return hash;
+}
+
+int command_register(const char *device, const char *action, command_handler handler)
+{
+   const char *dev = (device != NULL) ? device : "";
+   const char *act = (action != NULL) ? action : "";
+   uint32_t slot = 0;
+
+   if ((handler == NULL) || (strlen(dev) >= COMMAND_KEY_LENGTH) ||
+       (strlen(act) >= COMMAND_KEY_LENGTH)) {
+      LOG_ERROR("Invalid command registration: %s/%s", dev, act);
+      return FAILURE;
+   }
+
+   /* Keep the load factor low so probes stay short. */
+   if (command_count >= COMMAND_TABLE_SIZE / 2) {
+      LOG_ERROR("Command table full, can't register %s/%s.", dev, act);
+      return FAILURE;
+   }
+
+   slot = command_hash(dev, act) & (COMMAND_TABLE_SIZE - 1);
+   while (command_table[slot].handler != NULL) {
+      if ((strcmp(command_table[slot].device, dev) == 0) &&
+          (strcmp(command_table[slot].action, act) == 0)) {
+         LOG_WARNING("Replacing command handler for %s/%s.", dev, act);
+         command_table[slot].handler = handler;
+         return SUCCESS;
+      }
+      slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+   }
+
+   snprintf(command_table[slot].device, COMMAND_KEY_LENGTH, "%s", dev);
+   snprintf(command_table[slot].action, COMMAND_KEY_LENGTH, "%s", act);
+   command_table[slot].handler = handler;
+   command_count++;
+
+   return SUCCESS;
+}
+
+static command_handler command_find(const char *device, const char *action)
+{
+   uint32_t slot = command_hash(device, action) & (COMMAND_TABLE_SIZE - 1);
+
+   while (command_table[slot].handler != NULL) {
+      if ((strcmp(command_table[slot].device, device) == 0) &&
+          (strcmp(command_table[slot].action, action) == 0)) {
+         return command_table[slot].handler;
+      }
+      slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+   }
+
+   return NULL;
+}
+
+command_handler command_lookup(const char *device, const char *action)
+{
+   command_handler handler = NULL;
+
+   if (device == NULL) {
+      return NULL;
+   }
+
+   if (action != NULL) {
+      handler = command_find(device, action);
+      if (handler == NULL) {
+         handler = command_find("", action);
+      }
+   }
+   if (handler == NULL) {
+      handler = command_find(device, "");
+   }
+
+   return handler;
+}
+
+static void tokener_free(void *tok)
+{
+   json_tokener_free((struct json_tokener *) tok);
+}
+
+static void tokener_key_create(void)
+{
+   pthread_key_create(&tokener_key, tokener_free);
+}
+
+struct json_object *command_json_parse(const char *text)
+{
+   struct json_tokener *tok = NULL;
+   struct json_object *obj = NULL;
+
+   if (text == NULL) {
+      return NULL;
+   }
+
+   pthread_once(&tokener_once, tokener_key_create);
+   tok = pthread_getspecific(tokener_key);
+   if (tok == NULL) {
+      tok = json_tokener_new();
+      if (tok == NULL) {
+         return NULL;
+      }
+      pthread_setspecific(tokener_key, tok);
+   }
+
+   /* One complete message per call. A partial one is an error, not a continuation. */
+   json_tokener_reset(tok);
+   obj = json_tokener_parse_ex(tok, text, (int) strlen(text));
+   if (json_tokener_get_error(tok) != json_tokener_success) {
+      if (obj != NULL) {
+         json_object_put(obj);
+      }
+      return NULL;
+   }
+
+   return obj;
+}
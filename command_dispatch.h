@@ -0,0 +1,77 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef COMMAND_DISPATCH_H
+#define COMMAND_DISPATCH_H
+
+#include <json-c/json.h>
+
+/* Table driven command dispatch.
+ *
+ * Handlers are registered once at startup against a device name and an
+ * optional action, and found again by hashing those two keys. The table is
+ * written only during registration, so lookups from the MQTT, serial and
+ * socket threads need no locking.
+ *
+ * Lookup order for a message is the exact (device, action) pair, then an
+ * action registered for any device, then the device's default handler.
+ */
+
+#define COMMAND_TABLE_SIZE  128    /* Power of two, well above the registered count. */
+#define COMMAND_KEY_LENGTH  32
+
+/**
+ * @brief A command handler.
+ *
+ * @param msg    The parsed message. Handlers read only the fields they need.
+ * @param device The "device" field.
+ * @param action The "action" field, or NULL if there isn't one.
+ * @param topic  The MQTT topic, or the equivalent for serial and socket input.
+ * @return SUCCESS or FAILURE.
+ */
+typedef int (*command_handler)(struct json_object *msg, const char *device,
+                               const char *action, const char *topic);
+
+/**
+ * @brief Registers a handler. Not thread safe; call before any input threads start.
+ *
+ * @param device The device name, or NULL to match any device.
+ * @param action The action, or NULL for the device's default handler.
+ * @param handler The handler.
+ * @return SUCCESS, or FAILURE if the table is full or the keys are too long.
+ */
+int command_register(const char *device, const char *action, command_handler handler);
+
+/**
+ * @brief Finds the handler for a device and action.
+ *
+ * @return The handler, or NULL if nothing matches.
+ */
+command_handler command_lookup(const char *device, const char *action);
+
+/**
+ * @brief Parses a JSON message with the calling thread's reusable tokener.
+ *
+ * @return A new json_object the caller must put, or NULL on a parse error.
+ */
+struct json_object *command_json_parse(const char *text);
+
+#endif /* COMMAND_DISPATCH_H */
@@ -19,11 +19,19 @@
  * part of the project and are adopted by the project author(s).
  */
 
+#define _GNU_SOURCE
+
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <json-c/json.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <time.h>
@@ -37,15 +45,26 @@
 #include "defines.h"
 #include "armor.h"
 #include "audio.h"
+#include "camera_governor.h"
+#include "command_dispatch.h"
 #include "command_processing.h"
 #include "config_manager.h"
+#include "frame_pacer.h"
 #include "hud_manager.h"
+#include "input_trace.h"
 #include "logging.h"
 #include "mirage.h"
+#include "render_profiler.h"
 #include "screenshot.h"
+#include "sensor_store.h"
+#include "serial_framer.h"
 #include "system_metrics.h"
+#include "system_sampler.h"
 
 #define SERVER_TIMEOUT 10
+#define HELMET_MAX_CLIENTS 8
+#define HELMET_CLIENT_BUFFER_LENGTH MAX_SERIAL_BUFFER_LENGTH
+#define HELMET_POLL_MS 1000                  /* Wakeup interval for shutdown and idle checks. */
 
 static char raw_log[LOG_ROWS][LOG_LINE_LENGTH];
 static int next_log_row = 0;
@@ -144,7 +163,7 @@ void serial_get_port(char *buffer, size_t size) {
 int parse_stat_command(char *command_string)
 {
    /* Parse JSON message */
-   struct json_object *parsed_json = json_tokener_parse(command_string);
+   struct json_object *parsed_json = command_json_parse(command_string);
    if (parsed_json == NULL) {
       LOG_ERROR("Failed to parse JSON message from STAT");
       return FAILURE;
@@ -164,25 +183,28 @@ int parse_stat_command(char *command_string)
    /* Check if this is a system metrics message */
    if (strcmp(device_type, "SystemMetrics") == 0) {
       struct json_object *usage_obj = NULL;
-      if (json_object_object_get_ex(parsed_json, "cpu_usage", &usage_obj)) {
+      if (!system_sampler_owns(SAMPLE_CPU) &&
+          json_object_object_get_ex(parsed_json, "cpu_usage", &usage_obj)) {
          system_metrics.cpu_usage = (float)json_object_get_double(usage_obj);
          system_metrics.cpu_update_time = current_time;
          system_metrics.cpu_available = true;
       }
 
-      if (json_object_object_get_ex(parsed_json, "system_temp", &usage_obj)) {
+      if (!system_sampler_owns(SAMPLE_THERMAL) &&
+          json_object_object_get_ex(parsed_json, "system_temp", &usage_obj)) {
          system_metrics.system_temperature = (float)json_object_get_double(usage_obj);
          system_metrics.system_temp_update_time = current_time;
          system_metrics.system_temp_available = true;
       }
 
-      if (json_object_object_get_ex(parsed_json, "memory_usage", &usage_obj)) {
+      if (!system_sampler_owns(SAMPLE_MEMORY) &&
+          json_object_object_get_ex(parsed_json, "memory_usage", &usage_obj)) {
          system_metrics.memory_usage = json_object_get_double(usage_obj);
          system_metrics.memory_update_time = current_time;
          system_metrics.memory_available = true;
       }
    }
-   else if (strcmp(device_type, "Fan") == 0) {
+   else if ((strcmp(device_type, "Fan") == 0) && !system_sampler_owns(SAMPLE_FAN)) {
       struct json_object *rpm_obj = NULL;
       struct json_object *load_obj = NULL;
 
@@ -389,545 +411,661 @@ int parse_stat_command(char *command_string)
    return SUCCESS;
 }
 
-/* Parse the JSON "commands" that come over serial/USB or MQTT. */
-int parse_json_command(char *command_string, char *topic)
+/* Copy a string field into a fixed buffer. Leaves dst alone if the field is missing. */
+static void msg_copy_string(struct json_object *msg, const char *key, char *dst, size_t size)
 {
-   if (command_string == NULL || topic == NULL) {
-      LOG_ERROR("Invalid parameters: command_string or topic is NULL");
+   struct json_object *tmpobj = NULL;
+   const char *tmpstr = NULL;
+
+   if (json_object_object_get_ex(msg, key, &tmpobj)) {
+      tmpstr = json_object_get_string(tmpobj);
+      if (tmpstr != NULL) {
+         strncpy(dst, tmpstr, size - 1);
+         dst[size - 1] = '\0';
+      }
+   }
+}
+
+static const char *msg_string(struct json_object *msg, const char *key)
+{
+   struct json_object *tmpobj = NULL;
+
+   if (!json_object_object_get_ex(msg, key, &tmpobj)) {
+      return NULL;
+   }
+
+   return json_object_get_string(tmpobj);
+}
+
+/* Sensor heading to HUD heading, shared by the JSON and binary motion paths. */
+static double orientation_heading(double raw_heading)
+{
+   // If we get a negative value, convert from -180 to +180 range to 0 to 360 range
+   if (raw_heading < 0) {
+      raw_heading += 360.0;
+   }
+
+   // Apply inversion if needed
+   if (get_inv_compass()) {
+      return 360.0 - raw_heading;
+   }
+
+   return raw_heading;
+}
+
+static int handle_motion(struct json_object *msg, const char *device, const char *action,
+                         const char *topic)
+{
+   motion *this_motion = NULL;
+   motion sample;
+   struct json_object *tmpobj = NULL;
+   const char *format = msg_string(msg, "format");
+
+   if (format == NULL) {
+      LOG_WARNING("Motion device missing format field");
       return FAILURE;
    }
 
-   armor_settings *this_as = get_armor_settings();
-   element *armor_element = this_as ? this_as->armor_elements : NULL;
-   element *this_element = get_first_element();
+   /* Only look for "Orientation" style for now. */
+   if (strcmp("Orientation", format) != 0) {
+      return SUCCESS;
+   }
 
-   struct json_object *parsed_json = NULL;
+   if (!json_object_object_get_ex(msg, "heading", &tmpobj)) {
+      LOG_WARNING("Orientation format missing heading field");
+      return FAILURE;
+   }
+
+   this_motion = sensor_store_write_begin(SENSOR_MOTION);
+   this_motion->heading = orientation_heading(json_object_get_double(tmpobj));
+
+   /* Get pitch value */
+   if (json_object_object_get_ex(msg, "pitch", &tmpobj)) {
+      this_motion->pitch = json_object_get_double(tmpobj);
+   }
+
+   /* Get roll value */
+   if (json_object_object_get_ex(msg, "roll", &tmpobj)) {
+      this_motion->roll = json_object_get_double(tmpobj);
+   }
+
+   sample = *this_motion;
+   sensor_store_write_end(SENSOR_MOTION);
+
+   /* Timestamped copy for the render thread's per-frame latch. */
+   pose_record_sample(&sample);
+
+   return SUCCESS;
+}
+
+static int handle_enviro(struct json_object *msg, const char *device, const char *action,
+                         const char *topic)
+{
+   enviro *this_enviro = sensor_store_write_begin(SENSOR_ENVIRO);
    struct json_object *tmpobj = NULL;
-   struct json_object *tmpobj2 = NULL;
-   const char *tmpstr = NULL;
-   const char *tmpstr2 = NULL;
 
-   int enabled = -1;
-   int result = SUCCESS;
+   /* Enviro - Basic data */
+   if (json_object_object_get_ex(msg, "temp", &tmpobj)) {
+      this_enviro->temp = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "humidity", &tmpobj)) {
+      this_enviro->humidity = json_object_get_double(tmpobj);
+   } else {
+      this_enviro->humidity = 0.0;
+   }
+
+   /* Air Quality */
+   if (json_object_object_get_ex(msg, "air_quality", &tmpobj)) {
+      this_enviro->air_quality = json_object_get_double(tmpobj);
+   }
+
+   msg_copy_string(msg, "air_quality_description", this_enviro->air_quality_description,
+                   sizeof(this_enviro->air_quality_description));
+
+   /* VOC and CO2 Data */
+   if (json_object_object_get_ex(msg, "tvoc_ppb", &tmpobj)) {
+      this_enviro->tvoc_ppb = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "eco2_ppm", &tmpobj)) {
+      this_enviro->eco2_ppm = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "co2_ppm", &tmpobj)) {
+      this_enviro->co2_ppm = json_object_get_double(tmpobj);
+   }
+
+   msg_copy_string(msg, "co2_quality", this_enviro->co2_quality_description,
+                   sizeof(this_enviro->co2_quality_description));
+
+   if (json_object_object_get_ex(msg, "co2_eco2_diff", &tmpobj)) {
+      this_enviro->co2_eco2_diff = json_object_get_int(tmpobj);
+   }
+
+   msg_copy_string(msg, "co2_source_analysis", this_enviro->co2_source_analysis,
+                   sizeof(this_enviro->co2_source_analysis));
+
+   /* Calculated Indices */
+   if (json_object_object_get_ex(msg, "heat_index_c", &tmpobj)) {
+      this_enviro->heat_index_c = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "dew_point", &tmpobj)) {
+      this_enviro->dew_point = json_object_get_double(tmpobj);
+   }
+
+   sensor_store_write_end(SENSOR_ENVIRO);
+
+   return SUCCESS;
+}
+
+/* Position fields, only read while there's a fix. */
+static void update_gps_fix(struct json_object *msg, gps *this_gps)
+{
+   struct json_object *tmpobj = NULL;
+
+   if (json_object_object_get_ex(msg, "quality", &tmpobj)) {
+      this_gps->quality = json_object_get_int(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "latitude", &tmpobj)) {
+      this_gps->latitude = json_object_get_double(tmpobj);
+   }
+
+   msg_copy_string(msg, "lat", this_gps->lat, sizeof(this_gps->lat));
+
+   if (json_object_object_get_ex(msg, "latitudeDegrees", &tmpobj)) {
+      this_gps->latitudeDegrees = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "longitude", &tmpobj)) {
+      this_gps->longitude = json_object_get_double(tmpobj);
+   }
+
+   msg_copy_string(msg, "lon", this_gps->lon, sizeof(this_gps->lon));
+
+   if (json_object_object_get_ex(msg, "longitudeDegrees", &tmpobj)) {
+      this_gps->longitudeDegrees = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "speed", &tmpobj)) {
+      this_gps->speed = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "angle", &tmpobj)) {
+      this_gps->angle = json_object_get_double(tmpobj);
+   }
 
-   char text[2048] = "";
-   int alreadySpoke = 0;
+   if (json_object_object_get_ex(msg, "altitude", &tmpobj)) {
+      this_gps->altitude = json_object_get_double(tmpobj);
+   }
 
-   /* For audio processing. */
-   int command = 0;
+   if (json_object_object_get_ex(msg, "satellites", &tmpobj)) {
+      this_gps->satellites = json_object_get_int(tmpobj);
+   }
+}
+
+static int handle_gps(struct json_object *msg, const char *device, const char *action,
+                      const char *topic)
+{
+   gps *this_gps = sensor_store_write_begin(SENSOR_GPS);
+   struct json_object *tmpobj = NULL;
+
+   msg_copy_string(msg, "time", this_gps->time, sizeof(this_gps->time));
+   msg_copy_string(msg, "date", this_gps->date, sizeof(this_gps->date));
+
+   if (json_object_object_get_ex(msg, "fix", &tmpobj)) {
+      this_gps->fix = json_object_get_int(tmpobj);
+      if (this_gps->fix) {
+         update_gps_fix(msg, this_gps);
+      }
+   }
+
+   sensor_store_write_end(SENSOR_GPS);
+
+   return SUCCESS;
+}
+
+static int handle_audio(struct json_object *msg, const char *device, const char *action,
+                        const char *topic)
+{
+   struct json_object *tmpobj = NULL;
+   const char *command = msg_string(msg, "command");
    char filename[MAX_FILENAME_LENGTH] = "";
    double start_percent = 0.0;
 
-   motion *this_motion = get_motion_dev();
-   enviro *this_enviro = get_enviro_dev();
-   gps *this_gps = get_gps_dev();
-
-   if (!this_motion || !this_enviro || !this_gps) {
-      LOG_ERROR("Failed to get device structures");
+   if (command == NULL) {
+      LOG_WARNING("Audio command missing 'command' field");
       return FAILURE;
    }
 
-   /* This function is getting too long. let's try something new. */
-   if (strcmp(topic, "stat") == 0) {
-      return parse_stat_command(command_string);
+   msg_copy_string(msg, "arg1", filename, sizeof(filename));
+
+   if (strcmp(command, "play") == 0) {
+      if (json_object_object_get_ex(msg, "arg2", &tmpobj)) {
+         start_percent = json_object_get_double(tmpobj);
+      }
+      process_audio_command(SOUND_PLAY, filename, start_percent);
+   } else if (strcmp(command, "stop") == 0) {
+      process_audio_command(SOUND_STOP, filename, start_percent);
+   } else {
+      LOG_WARNING("Unrecognized audio command: %s", command);
+      return FAILURE;
    }
 
-   /* If not "stat" topic, continue. */
+   return SUCCESS;
+}
 
-   /* Check if command_string starts with '{' to validate it's JSON */
-   if (command_string[0] != '{') {
-      LOG_INFO("Non-JSON debug message received: %s", command_string);
-      return SUCCESS;  /* Exit gracefully for debug messages */
+static int handle_viewing(struct json_object *msg, const char *device, const char *action,
+                          const char *topic)
+{
+   time_t r_time;
+   struct tm *l_time = NULL;
+   char datetime[16];
+
+   time(&r_time);
+   l_time = localtime(&r_time);
+   if (l_time == NULL) {
+      LOG_ERROR("Failed to get local time for snapshot");
+      return FAILURE;
    }
 
-   parsed_json = json_tokener_parse(command_string);
-   if (!parsed_json) {
-      LOG_ERROR("Failed to parse JSON command: %s", command_string);
+   strftime(datetime, sizeof(datetime), "%Y%m%d_%H%M%S", l_time);
+   trigger_snapshot(datetime);
+
+   return SUCCESS;
+}
+
+static int handle_ai(struct json_object *msg, const char *device, const char *action,
+                     const char *topic)
+{
+   const char *aiName = msg_string(msg, "name");
+   const char *aiState = msg_string(msg, "state");
+
+   if (aiName == NULL || aiState == NULL) {
+      LOG_WARNING("AI command missing name or state");
       return FAILURE;
    }
 
-   /* Check for "device" key */
-   if (!json_object_object_get_ex(parsed_json, "device", &tmpobj)) {
-      /* No "device" field found, this might be valid for some commands */
-      LOG_INFO("No device field found in JSON command");
-   } else if (tmpobj != NULL) {
-      tmpstr = json_object_get_string(tmpobj);
-      if (tmpstr == NULL) {
-         LOG_WARNING("Device field exists but is not a string");
-      } else {
-         if (strcmp("Motion", tmpstr) == 0) {
-            /* Motion */
-            if (!json_object_object_get_ex(parsed_json, "format", &tmpobj)) {
-               LOG_WARNING("Motion device missing format field");
-            } else {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr == NULL) {
-                  LOG_WARNING("Format field exists but is not a string");
-               } else if (strcmp("Orientation", tmpstr) == 0) {
-                  /* Only look for "Orientation" style for now. */
-                  if (!json_object_object_get_ex(parsed_json, "heading", &tmpobj)) {
-                     LOG_WARNING("Orientation format missing heading field");
-                  } else {
-                     // Get the sensor heading value
-                     double raw_heading = json_object_get_double(tmpobj);
-
-                     // If we get a negative value, convert from -180 to +180 range to 0 to 360 range
-                     if (raw_heading < 0) {
-                        raw_heading += 360.0;
-                     }
-
-                     // Apply inversion if needed
-                     if (get_inv_compass()) {
-                        this_motion->heading = 360.0 - raw_heading;
-                     } else {
-                        this_motion->heading = raw_heading;
-                     }
-
-                     /* Get pitch value */
-                     if (json_object_object_get_ex(parsed_json, "pitch", &tmpobj)) {
-                        this_motion->pitch = json_object_get_double(tmpobj);
-                     }
-
-                     /* Get roll value */
-                     if (json_object_object_get_ex(parsed_json, "roll", &tmpobj)) {
-                        this_motion->roll = json_object_get_double(tmpobj);
-                     }
-                  }
-               }
-            }
-         } else if (strcmp("Enviro", tmpstr) == 0) {
-            /* Enviro - Basic data */
-            if (json_object_object_get_ex(parsed_json, "temp", &tmpobj)) {
-               this_enviro->temp = json_object_get_double(tmpobj);
-            }
+   process_ai_state(aiName, aiState);
 
-            if (json_object_object_get_ex(parsed_json, "humidity", &tmpobj)) {
-               this_enviro->humidity = json_object_get_double(tmpobj);
-            } else {
-               this_enviro->humidity = 0.0;
-            }
+   return SUCCESS;
+}
 
-            /* Air Quality */
-            if (json_object_object_get_ex(parsed_json, "air_quality", &tmpobj)) {
-               this_enviro->air_quality = json_object_get_double(tmpobj);
-            }
+static int handle_map_zoom(struct json_object *msg, const char *device, const char *action,
+                           const char *topic)
+{
+   struct json_object *tmpobj = NULL;
 
-            if (json_object_object_get_ex(parsed_json, "air_quality_description", &tmpobj)) {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr != NULL) {
-                  strncpy(this_enviro->air_quality_description, tmpstr, sizeof(this_enviro->air_quality_description) - 1);
-                  this_enviro->air_quality_description[sizeof(this_enviro->air_quality_description) - 1] = '\0'; /* Ensure null termination */
-               }
-            }
+   if (json_object_object_get_ex(msg, "value", &tmpobj)) {
+      float zoom_value = json_object_get_int(tmpobj);
+      element* map_elem = find_map_element();
+      if (map_elem && zoom_value > 0) {
+         map_elem->map_zoom = zoom_value;
+         map_elem->force_refresh = 1;
+      }
+   }
 
-            /* VOC and CO2 Data */
-            if (json_object_object_get_ex(parsed_json, "tvoc_ppb", &tmpobj)) {
-               this_enviro->tvoc_ppb = json_object_get_double(tmpobj);
-            }
+   return SUCCESS;
+}
 
-            if (json_object_object_get_ex(parsed_json, "eco2_ppm", &tmpobj)) {
-               this_enviro->eco2_ppm = json_object_get_double(tmpobj);
-            }
+static int handle_map_type(struct json_object *msg, const char *device, const char *action,
+                           const char *topic)
+{
+   const char *maptype_str = msg_string(msg, "value");
+   element* map_elem = find_map_element();
 
-            if (json_object_object_get_ex(parsed_json, "co2_ppm", &tmpobj)) {
-               this_enviro->co2_ppm = json_object_get_double(tmpobj);
-            }
+   if ((maptype_str == NULL) || (map_elem == NULL)) {
+      return SUCCESS;
+   }
 
-            if (json_object_object_get_ex(parsed_json, "co2_quality", &tmpobj)) {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr != NULL) {
-                  strncpy(this_enviro->co2_quality_description, tmpstr, sizeof(this_enviro->co2_quality_description) - 1);
-                  this_enviro->co2_quality_description[sizeof(this_enviro->co2_quality_description) - 1] = '\0';
-               }
-            }
+   // Convert string to enum
+   for (int i = 0; i < MAP_TYPE_COUNT; i++) {
+      if (strcmp(maptype_str, MAP_TYPE_STRINGS[i]) == 0) {
+         map_elem->map_type = (map_type_t)i;
+         map_elem->force_refresh = 1;
+         break;
+      }
+   }
 
-            if (json_object_object_get_ex(parsed_json, "co2_eco2_diff", &tmpobj)) {
-               this_enviro->co2_eco2_diff = json_object_get_int(tmpobj);
-            }
+   return SUCCESS;
+}
 
-            if (json_object_object_get_ex(parsed_json, "co2_source_analysis", &tmpobj)) {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr != NULL) {
-                  strncpy(this_enviro->co2_source_analysis, tmpstr, sizeof(this_enviro->co2_source_analysis) - 1);
-                  this_enviro->co2_source_analysis[sizeof(this_enviro->co2_source_analysis) - 1] = '\0';
-               }
-            }
+static int handle_map_refresh(struct json_object *msg, const char *device, const char *action,
+                              const char *topic)
+{
+   trigger_map_refresh();
 
-            /* Calculated Indices */
-            if (json_object_object_get_ex(parsed_json, "heat_index_c", &tmpobj)) {
-               this_enviro->heat_index_c = json_object_get_double(tmpobj);
-            }
+   return SUCCESS;
+}
 
-            if (json_object_object_get_ex(parsed_json, "dew_point", &tmpobj)) {
-               this_enviro->dew_point = json_object_get_double(tmpobj);
-            }
-         } else if (strcmp("GPS", tmpstr) == 0) {
-            /* GPS */
-            if (json_object_object_get_ex(parsed_json, "time", &tmpobj)) {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr != NULL) {
-                  strncpy(this_gps->time, tmpstr, sizeof(this_gps->time) - 1);
-                  this_gps->time[sizeof(this_gps->time) - 1] = '\0';
-               }
-            }
+static int handle_replay_save(struct json_object *msg, const char *device, const char *action,
+                              const char *topic)
+{
+   if (save_replay() != SUCCESS) {
+      mqttTextToSpeech("Replay unavailable.");
+      return FAILURE;
+   }
 
-            if (json_object_object_get_ex(parsed_json, "date", &tmpobj)) {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr != NULL) {
-                  strncpy(this_gps->date, tmpstr, sizeof(this_gps->date) - 1);
-                  this_gps->date[sizeof(this_gps->date) - 1] = '\0';
-               }
-            }
+   mqttTextToSpeech("Saving replay.");
 
-            if (json_object_object_get_ex(parsed_json, "fix", &tmpobj)) {
-               this_gps->fix = json_object_get_int(tmpobj);
-
-               if (this_gps->fix) {
-                  if (json_object_object_get_ex(parsed_json, "quality", &tmpobj)) {
-                     this_gps->quality = json_object_get_int(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "latitude", &tmpobj)) {
-                     this_gps->latitude = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "lat", &tmpobj)) {
-                     tmpstr = json_object_get_string(tmpobj);
-                     if (tmpstr != NULL) {
-                        strncpy(this_gps->lat, tmpstr, sizeof(this_gps->lat) - 1);
-                        this_gps->lat[sizeof(this_gps->lat) - 1] = '\0';
-                     }
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "latitudeDegrees", &tmpobj)) {
-                     this_gps->latitudeDegrees = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "longitude", &tmpobj)) {
-                     this_gps->longitude = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "lon", &tmpobj)) {
-                     tmpstr = json_object_get_string(tmpobj);
-                     if (tmpstr != NULL) {
-                        strncpy(this_gps->lon, tmpstr, sizeof(this_gps->lon) - 1);
-                        this_gps->lon[sizeof(this_gps->lon) - 1] = '\0';
-                     }
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "longitudeDegrees", &tmpobj)) {
-                     this_gps->longitudeDegrees = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "speed", &tmpobj)) {
-                     this_gps->speed = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "angle", &tmpobj)) {
-                     this_gps->angle = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "altitude", &tmpobj)) {
-                     this_gps->altitude = json_object_get_double(tmpobj);
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "satellites", &tmpobj)) {
-                     this_gps->satellites = json_object_get_int(tmpobj);
-                  }
-               }
-            }
-         } else if (strcmp("audio", tmpstr) == 0) {
-            /* Audio */
-            command = 0;
-            filename[0] = '\0';
-            start_percent = 0.0;
-
-            if (!json_object_object_get_ex(parsed_json, "command", &tmpobj)) {
-               LOG_WARNING("Audio command missing 'command' field");
-            } else {
-               tmpstr = json_object_get_string(tmpobj);
-               if (tmpstr == NULL) {
-                  LOG_WARNING("Audio command field is not a string");
-               } else if (strcmp(tmpstr, "play") == 0) {
-                  command = SOUND_PLAY;
-                  if (json_object_object_get_ex(parsed_json, "arg1", &tmpobj)) {
-                     tmpstr = json_object_get_string(tmpobj);
-                     if (tmpstr != NULL) {
-                        strncpy(filename, tmpstr, MAX_FILENAME_LENGTH - 1);
-                        filename[MAX_FILENAME_LENGTH - 1] = '\0';
-                     }
-                  }
-
-                  if (json_object_object_get_ex(parsed_json, "arg2", &tmpobj)) {
-                     start_percent = json_object_get_double(tmpobj);
-                  }
-
-                  process_audio_command(command, filename, start_percent);
-               } else if (strcmp(tmpstr, "stop") == 0) {
-                  command = SOUND_STOP;
-                  if (json_object_object_get_ex(parsed_json, "arg1", &tmpobj)) {
-                     tmpstr = json_object_get_string(tmpobj);
-                     if (tmpstr != NULL) {
-                        strncpy(filename, tmpstr, MAX_FILENAME_LENGTH - 1);
-                        filename[MAX_FILENAME_LENGTH - 1] = '\0';
-                     }
-                  }
-
-                  process_audio_command(command, filename, start_percent);
-               } else {
-                  LOG_WARNING("Unrecognized audio command: %s", tmpstr);
-               }
-            }
-         } else if (strcmp("viewing", tmpstr) == 0) {
-            time_t r_time;
-            struct tm *l_time = NULL;
-            char datetime[16];
-
-            time(&r_time);
-            l_time = localtime(&r_time);
-            if (l_time != NULL) {
-               strftime(datetime, sizeof(datetime), "%Y%m%d_%H%M%S", l_time);
-               trigger_snapshot(datetime);
-            } else {
-               LOG_ERROR("Failed to get local time for snapshot");
-            }
-         } else if (strcmp("ai", tmpstr) == 0) {
-            const char *aiName = NULL;
-            const char *aiState = NULL;
+   return SUCCESS;
+}
 
-            if (json_object_object_get_ex(parsed_json, "name", &tmpobj)) {
-               aiName = json_object_get_string(tmpobj);
-            }
+/* { "device": "camera", "action": "profile", "value": "720p30" } */
+static int handle_camera_profile(struct json_object *msg, const char *device, const char *action,
+                                 const char *topic)
+{
+   const char *profile = msg_string(msg, "value");
+   char text[128];
 
-            if (json_object_object_get_ex(parsed_json, "state", &tmpobj)) {
-               aiState = json_object_get_string(tmpobj);
-            }
+   if (camera_profile_select(profile) != SUCCESS) {
+      mqttTextToSpeech("Unknown camera profile.");
+      return FAILURE;
+   }
 
-            if (aiName != NULL && aiState != NULL) {
-               process_ai_state(aiName, aiState);
-            } else {
-               LOG_WARNING("AI command missing name or state");
-            }
-         } else if (strcmp("map", tmpstr) == 0) {
-            if (json_object_object_get_ex(parsed_json, "action", &tmpobj)) {
-               const char *action = json_object_get_string(tmpobj);
-
-               if (action != NULL) {
-                  if (strcmp(action, "zoom") == 0) {
-                     // Get zoom value
-                     if (json_object_object_get_ex(parsed_json, "value", &tmpobj)) {
-                        float zoom_value = json_object_get_int(tmpobj);
-                        element* map_elem = find_map_element();
-                        if (map_elem && zoom_value > 0) {
-                           map_elem->map_zoom = zoom_value;
-                           map_elem->force_refresh = 1;
-                        }
-                     }
-                  } else if (strcmp(action, "maptype") == 0) {
-                     // Get map type
-                     if (json_object_object_get_ex(parsed_json, "value", &tmpobj)) {
-                        const char *maptype_str = json_object_get_string(tmpobj);
-                        element* map_elem = find_map_element();
-
-                        if (map_elem) {
-                           // Convert string to enum
-                           for (int i = 0; i < MAP_TYPE_COUNT; i++) {
-                              if (strcmp(maptype_str, MAP_TYPE_STRINGS[i]) == 0) {
-                                 map_elem->map_type = (map_type_t)i;
-                                 map_elem->force_refresh = 1;
-                                 break;
-                              }
-                           }
-                        }
-                     }
-                  } else if (strcmp(action, "refresh") == 0) {
-                     // Force map refresh
-                     trigger_map_refresh();
-                  }
-               }
-            }
-         }
+   snprintf(text, sizeof(text) - 1, "Switching camera to %s.", profile);
+   text[sizeof(text) - 1] = '\0';
+   mqttTextToSpeech(text);
 
-         /* Check for action field */
-         if (json_object_object_get_ex(parsed_json, "action", &tmpobj2)) {
-            if (tmpobj2 != NULL) {
-               tmpstr2 = json_object_get_string(tmpobj2);
-               if (tmpstr2 != NULL) {
-                  if (strcmp(tmpstr2, "enable") == 0) {
-                     enabled = 1;
-                  } else if (strcmp(tmpstr2, "disable") == 0) {
-                     enabled = 0;
-                  }
-
-                  if (enabled > -1) {
-                     LOG_INFO("Going to enable or disable %s.", tmpstr);
-
-                     /* Recording/Streaming */
-                     if (!strcmp(tmpstr, "record")) {
-                        if (enabled) {
-                           set_recording_state(RECORD);
-                        } else {
-                           set_recording_state(DISABLED);
-                        }
-                     } else if (!strcmp(tmpstr, "stream")) {
-                        if (enabled) {
-                           set_recording_state(STREAM);
-                        } else {
-                           set_recording_state(DISABLED);
-                        }
-                     } else if (!strcmp(tmpstr, "record and stream")) {
-                        if (enabled) {
-                           set_recording_state(RECORD_STREAM);
-                        } else {
-                           set_recording_state(DISABLED);
-                        }
-                     }
-
-                     /* Armor is a special case. */
-                     if (!strcmp(tmpstr, "armor")) {
-                        if (!alreadySpoke) {
-                           snprintf(text, sizeof(text) - 1, "%s armor display.",
-                                    enabled ? "Enabling" : "Disabling");
-                           text[sizeof(text) - 1] = '\0';
-                           mqttTextToSpeech(text);
-                           alreadySpoke++;
-                        }
-                        setArmorEnabled(enabled);
-                     }
-
-                     /* Let's find this device(s). */
-                     element *current_element = this_element;
-                     while (current_element != NULL) {
-                        if (!strcmp(current_element->name, tmpstr)) {
-                           if (!alreadySpoke) {
-                              snprintf(text, sizeof(text) - 1, "%s %s display.",
-                                       enabled ? "Enabling" : "Disabling",
-                                       current_element->name);
-                              text[sizeof(text) - 1] = '\0';
-                              mqttTextToSpeech(text);
-                              alreadySpoke++;
-                           }
-                           current_element->enabled = enabled;
-                        }
-                        current_element = current_element->next;
-                     }
-                  }
-               }
-            }
-         }
+   return SUCCESS;
+}
 
-         if (strcmp(tmpstr, "hud") == 0) {
-            if (json_object_object_get_ex(parsed_json, "action", &tmpobj2)) {
-               if (tmpobj2 != NULL) {
-                  tmpstr2 = json_object_get_string(tmpobj2);
-                  if (tmpstr2 != NULL) {
-                     // This is the basic form of this command
-                     if (strcmp(tmpstr2, "set") == 0) {
-                        if (json_object_object_get_ex(parsed_json, "value", &tmpobj)) {
-                           if (tmpobj != NULL) {
-                              const char *hudName = json_object_get_string(tmpobj);
-                              if (hudName != NULL) {
-                                 if (strcmp(hudName, "next") == 0) {
-                                    switch_to_next_hud();
-                                 } else {
-                                    hud_screen *target = find_hud_by_name(hudName);
-                                    char temp_msg[128];
-                                    if (target != NULL) {
-                                       switch_to_hud(target, target->transition_type);
-
-                                       snprintf(temp_msg, sizeof(temp_msg) - 1, "Switched to %s hud.", hudName);
-                                       temp_msg[sizeof(temp_msg) - 1] = '\0';
-                                       mqttTextToSpeech(temp_msg);
-                                    } else {
-                                       snprintf(temp_msg, sizeof(temp_msg) - 1, "Requested HUD, \"%s\", not found.",
-                                                hudName);
-                                       temp_msg[sizeof(temp_msg) - 1] = '\0';
-                                       mqttTextToSpeech(temp_msg);
-                                       LOG_ERROR(temp_msg);
-                                    }
-                                 }
-                              }
-                           }
-                        }
-                     }
-
-                     // This is a more complete version of this command
-                     if (strcmp(tmpstr2, "switchHUD") == 0) {
-                        if (json_object_object_get_ex(parsed_json, "hudName", &tmpobj)) {
-                           if (tmpobj != NULL) {
-                              const char *hudName = json_object_get_string(tmpobj);
-                              if (hudName != NULL) {
-                                 hud_screen *target = find_hud_by_name(hudName);
-                                 if (target != NULL) {
-                                    /* Get transition type */
-                                    int transition_type = target->transition_type; /* Default */
-                                    if (json_object_object_get_ex(parsed_json, "transitionType", &tmpobj)) {
-                                       if (tmpobj != NULL) {
-                                          if (json_object_get_type(tmpobj) == json_type_string) {
-                                             const char *transition_name = json_object_get_string(tmpobj);
-                                             if (transition_name != NULL) {
-                                                transition_type = find_transition_by_name(transition_name);
-                                             }
-                                          } else {
-                                             transition_type = json_object_get_int(tmpobj);
-                                             if (transition_type < 0 || transition_type >= TRANSITION_MAX) {
-                                                LOG_WARNING("Invalid transition type %d in JSON command, using default",
-                                                            transition_type);
-                                                transition_type = target->transition_type; // Fall back to default
-                                             }
-                                          }
-                                       }
-                                    }
-
-                                    /* Switch with the specified parameters */
-                                    switch_to_hud(target, transition_type);
-                                 }
-                              }
-                           }
-                        }
-                     }
-                  }
-               }
-            }
+/* Enable or disable every element with this name. Announces the first one unless
+ * the caller already has. */
+static void toggle_elements(const char *name, int enabled, int announced)
+{
+   element *current_element = get_first_element();
+   char text[256];
+
+   while (current_element != NULL) {
+      if (!strcmp(current_element->name, name)) {
+         if (!announced) {
+            snprintf(text, sizeof(text) - 1, "%s %s display.",
+                     enabled ? "Enabling" : "Disabling",
+                     current_element->name);
+            text[sizeof(text) - 1] = '\0';
+            mqttTextToSpeech(text);
+            announced = 1;
          }
+         current_element->enabled = enabled;
       }
+      current_element = current_element->next;
    }
+}
 
-   /* Check for armor device match in topic */
-   if (topic != NULL) {
-      element *current_armor_element = armor_element;
-      while (current_armor_element != NULL) {
-         if (!strcmp(current_armor_element->mqtt_device, topic)) {
-            /* Found matching armor element, process temp and voltage if available */
-            if (json_object_object_get_ex(parsed_json, "temp", &tmpobj)) {
-               if (tmpobj != NULL) {
-                  current_armor_element->last_temp = json_object_get_double(tmpobj);
-               }
-            }
+/* Any device: "enable"/"disable" toggles the elements with that name. */
+static int handle_element_toggle(struct json_object *msg, const char *device, const char *action,
+                                 const char *topic)
+{
+   LOG_INFO("Going to enable or disable %s.", device);
+   toggle_elements(device, strcmp(action, "enable") == 0, 0);
 
-            if (json_object_object_get_ex(parsed_json, "voltage", &tmpobj)) {
-               if (tmpobj != NULL) {
-                  current_armor_element->last_voltage = json_object_get_double(tmpobj);
-               }
-            }
-            break;
+   return SUCCESS;
+}
+
+/* Recording/Streaming */
+static int handle_recording_toggle(struct json_object *msg, const char *device,
+                                   const char *action, const char *topic)
+{
+   int enabled = (strcmp(action, "enable") == 0);
+   DestinationType state = DISABLED;
+
+   if (!strcmp(device, "record")) {
+      state = RECORD;
+   } else if (!strcmp(device, "stream")) {
+      state = STREAM;
+   } else if (!strcmp(device, "record and stream")) {
+      state = RECORD_STREAM;
+   } else if (!strcmp(device, "replay")) {
+      state = REPLAY;
+   }
+
+   set_recording_state(enabled ? state : DISABLED);
+
+   return handle_element_toggle(msg, device, action, topic);
+}
+
+/* Armor is a special case. */
+static int handle_armor_toggle(struct json_object *msg, const char *device, const char *action,
+                               const char *topic)
+{
+   int enabled = (strcmp(action, "enable") == 0);
+   char text[64];
+
+   LOG_INFO("Going to enable or disable %s.", device);
+   snprintf(text, sizeof(text) - 1, "%s armor display.", enabled ? "Enabling" : "Disabling");
+   text[sizeof(text) - 1] = '\0';
+   mqttTextToSpeech(text);
+   setArmorEnabled(enabled);
+
+   toggle_elements(device, enabled, 1);
+
+   return SUCCESS;
+}
+
+/* Render profiler. Elements named "perf" follow it so a *PERF_TOP* readout comes and goes with it. */
+static int handle_perf_toggle(struct json_object *msg, const char *device, const char *action,
+                              const char *topic)
+{
+   int enabled = (strcmp(action, "enable") == 0);
+
+   LOG_INFO("%s the render profiler.", enabled ? "Enabling" : "Disabling");
+   render_profiler_set_enabled(enabled);
+
+   toggle_elements(device, enabled, 1);
+
+   return SUCCESS;
+}
+
+// This is the basic form of this command
+static int handle_hud_set(struct json_object *msg, const char *device, const char *action,
+                          const char *topic)
+{
+   const char *hudName = msg_string(msg, "value");
+   hud_screen *target = NULL;
+   char temp_msg[128];
+
+   if (hudName == NULL) {
+      return SUCCESS;
+   }
+
+   if (strcmp(hudName, "next") == 0) {
+      switch_to_next_hud();
+      return SUCCESS;
+   }
+
+   target = find_hud_by_name(hudName);
+   if (target != NULL) {
+      switch_to_hud(target, target->transition_type);
+
+      snprintf(temp_msg, sizeof(temp_msg) - 1, "Switched to %s hud.", hudName);
+      temp_msg[sizeof(temp_msg) - 1] = '\0';
+      mqttTextToSpeech(temp_msg);
+   } else {
+      snprintf(temp_msg, sizeof(temp_msg) - 1, "Requested HUD, \"%s\", not found.",
+               hudName);
+      temp_msg[sizeof(temp_msg) - 1] = '\0';
+      mqttTextToSpeech(temp_msg);
+      LOG_ERROR(temp_msg);
+      return FAILURE;
+   }
+
+   return SUCCESS;
+}
+
+// This is a more complete version of this command
+static int handle_hud_switch(struct json_object *msg, const char *device, const char *action,
+                             const char *topic)
+{
+   struct json_object *tmpobj = NULL;
+   const char *hudName = msg_string(msg, "hudName");
+   hud_screen *target = NULL;
+
+   if (hudName == NULL) {
+      return SUCCESS;
+   }
+
+   target = find_hud_by_name(hudName);
+   if (target == NULL) {
+      return FAILURE;
+   }
+
+   /* Get transition type */
+   int transition_type = target->transition_type; /* Default */
+   if (json_object_object_get_ex(msg, "transitionType", &tmpobj) && (tmpobj != NULL)) {
+      if (json_object_get_type(tmpobj) == json_type_string) {
+         const char *transition_name = json_object_get_string(tmpobj);
+         if (transition_name != NULL) {
+            transition_type = find_transition_by_name(transition_name);
+         }
+      } else {
+         transition_type = json_object_get_int(tmpobj);
+         if (transition_type < 0 || transition_type >= TRANSITION_MAX) {
+            LOG_WARNING("Invalid transition type %d in JSON command, using default",
+                        transition_type);
+            transition_type = target->transition_type; // Fall back to default
          }
-         current_armor_element = current_armor_element->next;
       }
    }
 
-   /* Clean up */
-   if (parsed_json != NULL) {
-      json_object_put(parsed_json);
+   /* Switch with the specified parameters */
+   switch_to_hud(target, transition_type);
+
+   return SUCCESS;
+}
+
+static void register_command_handlers(void)
+{
+   static const char *recording_devices[] = { "record", "stream", "record and stream", "replay" };
+
+   command_register("Motion", NULL, handle_motion);
+   command_register("Enviro", NULL, handle_enviro);
+   command_register("GPS", NULL, handle_gps);
+   command_register("audio", NULL, handle_audio);
+   command_register("viewing", NULL, handle_viewing);
+   command_register("ai", NULL, handle_ai);
+   command_register("map", "zoom", handle_map_zoom);
+   command_register("map", "maptype", handle_map_type);
+   command_register("map", "refresh", handle_map_refresh);
+   command_register("replay", "save", handle_replay_save);
+   command_register("camera", "profile", handle_camera_profile);
+   command_register("hud", "set", handle_hud_set);
+   command_register("hud", "switchHUD", handle_hud_switch);
+
+   command_register(NULL, "enable", handle_element_toggle);
+   command_register(NULL, "disable", handle_element_toggle);
+   for (size_t i = 0; i < sizeof(recording_devices) / sizeof(recording_devices[0]); i++) {
+      command_register(recording_devices[i], "enable", handle_recording_toggle);
+      command_register(recording_devices[i], "disable", handle_recording_toggle);
+   }
+   command_register("armor", "enable", handle_armor_toggle);
+   command_register("armor", "disable", handle_armor_toggle);
+   command_register("perf", "enable", handle_perf_toggle);
+   command_register("perf", "disable", handle_perf_toggle);
+}
+
+void command_processing_init(void)
+{
+   static pthread_once_t handlers_once = PTHREAD_ONCE_INIT;
+
+   pthread_once(&handlers_once, register_command_handlers);
+}
+
+/* Armor components report on their own topic. */
+static void update_armor_from_topic(struct json_object *msg, const char *topic)
+{
+   element *current_armor_element = armor_find_component(topic);
+   struct json_object *tmpobj = NULL;
+
+   if (current_armor_element == NULL) {
+      return;
+   }
+
+   /* Found matching armor element, process temp and voltage if available */
+   if (json_object_object_get_ex(msg, "temp", &tmpobj)) {
+      current_armor_element->last_temp = json_object_get_double(tmpobj);
+   }
+
+   if (json_object_object_get_ex(msg, "voltage", &tmpobj)) {
+      current_armor_element->last_voltage = json_object_get_double(tmpobj);
+   }
+}
+
+/* Route an already parsed message to its handler. */
+static int dispatch_json_command(struct json_object *msg, const char *topic)
+{
+   command_handler handler = NULL;
+   const char *device = NULL;
+   const char *action = NULL;
+   int result = SUCCESS;
+
+   /* Any command or sensor update may change what's displayed. */
+   hud_mark_damaged();
+
+   device = msg_string(msg, "device");
+   if (device != NULL) {
+      action = msg_string(msg, "action");
+      handler = command_lookup(device, action);
+      if (handler != NULL) {
+         result = handler(msg, device, action, topic);
+      }
+   } else {
+      /* No "device" field found, this might be valid for some commands */
+      LOG_INFO("No device field found in JSON command");
+   }
+
+   if (topic != NULL) {
+      update_armor_from_topic(msg, topic);
+   }
+
+   return result;
+}
+
+/* Parse the JSON "commands" that come over serial/USB or MQTT. */
+int parse_json_command(char *command_string, char *topic)
+{
+   struct json_object *parsed_json = NULL;
+   int result = SUCCESS;
+
+   if (command_string == NULL || topic == NULL) {
+      LOG_ERROR("Invalid parameters: command_string or topic is NULL");
+      return FAILURE;
+   }
+
+   /* This function is getting too long. let's try something new. */
+   if (strcmp(topic, "stat") == 0) {
+      return parse_stat_command(command_string);
+   }
+
+   /* If not "stat" topic, continue. */
+
+   /* Check if command_string starts with '{' to validate it's JSON */
+   if (command_string[0] != '{') {
+      LOG_INFO("Non-JSON debug message received: %s", command_string);
+      return SUCCESS;  /* Exit gracefully for debug messages */
+   }
+
+   parsed_json = command_json_parse(command_string);
+   if (!parsed_json) {
+      LOG_ERROR("Failed to parse JSON command: %s", command_string);
+      return FAILURE;
    }
 
+   result = dispatch_json_command(parsed_json, topic);
+
+   /* Clean up */
+   json_object_put(parsed_json);
+
    return result;
 }
 
 /* Append a command we received into raw log buffer. */
 void log_command(char *command)
 {
-   strncpy(raw_log[next_log_row], command, LOG_LINE_LENGTH);
+   strncpy(raw_log[next_log_row], command, LOG_LINE_LENGTH - 1);
+   raw_log[next_log_row][LOG_LINE_LENGTH - 1] = '\0';
    next_log_row++;
    if (next_log_row >= LOG_ROWS) {
       next_log_row = 0;
@@ -935,6 +1073,128 @@ void log_command(char *command)
    log_generation++;
 }
 
+/* One text line from the serial link. Armor components put their own name in "device". */
+static void serial_dispatch_text(char *command)
+{
+   char topic[256] = "helmet";   // Default topic is "helmet"
+   struct json_object *parsed_json = NULL;
+
+   log_command(command);
+
+   // Parse JSON to extract device. The same object is dispatched below.
+   if (command[0] == '{') {
+      parsed_json = command_json_parse(command);
+   }
+   if (parsed_json != NULL) {
+      const char *device = msg_string(parsed_json, "device");
+      // If device matches an armor component, use it as the topic
+      if ((device != NULL) && (armor_find_component(device) != NULL)) {
+         strncpy(topic, device, sizeof(topic) - 1);
+         topic[sizeof(topic) - 1] = '\0';
+      }
+   }
+
+   // Use the determined topic
+   registerArmor(topic);
+   if (parsed_json != NULL) {
+      dispatch_json_command(parsed_json, topic);
+      json_object_put(parsed_json);  // Free the JSON object
+   } else {
+      parse_json_command(command, topic);
+   }
+}
+
+static float serial_le_float(const unsigned char *p)
+{
+   uint32_t bits = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) |
+                   ((uint32_t) p[3] << 24);
+   float value = 0.0f;
+
+   memcpy(&value, &bits, sizeof(value));
+
+   return value;
+}
+
+/* Binary telemetry goes straight into the sensor store, see serial_framer.h. */
+static void serial_dispatch_binary(const serial_frame *frame)
+{
+   const unsigned char *p = frame->data;
+
+   hud_mark_damaged();
+
+   if ((frame->type == SERIAL_PKT_ORIENTATION) && (frame->length >= 12)) {
+      motion *this_motion = sensor_store_write_begin(SENSOR_MOTION);
+      motion sample;
+
+      this_motion->heading = orientation_heading(serial_le_float(p));
+      this_motion->pitch = serial_le_float(p + 4);
+      this_motion->roll = serial_le_float(p + 8);
+      if (frame->length >= 28) {
+         this_motion->w = serial_le_float(p + 12);
+         this_motion->x = serial_le_float(p + 16);
+         this_motion->y = serial_le_float(p + 20);
+         this_motion->z = serial_le_float(p + 24);
+      }
+      sample = *this_motion;
+      sensor_store_write_end(SENSOR_MOTION);
+
+      pose_record_sample(&sample);
+   } else if ((frame->type == SERIAL_PKT_ENVIRO) && (frame->length >= 34)) {
+      enviro *this_enviro = sensor_store_write_begin(SENSOR_ENVIRO);
+
+      this_enviro->temp = serial_le_float(p);
+      this_enviro->humidity = serial_le_float(p + 4);
+      this_enviro->air_quality = serial_le_float(p + 8);
+      this_enviro->tvoc_ppb = serial_le_float(p + 12);
+      this_enviro->eco2_ppm = serial_le_float(p + 16);
+      this_enviro->co2_ppm = serial_le_float(p + 20);
+      this_enviro->heat_index_c = serial_le_float(p + 24);
+      this_enviro->dew_point = serial_le_float(p + 28);
+      this_enviro->co2_eco2_diff = (int16_t) ((uint16_t) p[32] | ((uint16_t) p[33] << 8));
+      sensor_store_write_end(SENSOR_ENVIRO);
+   } else {
+      LOG_WARNING("Unknown or short serial packet, type 0x%02x length %zu.", frame->type,
+                  frame->length);
+      return;
+   }
+
+   /* Binary telemetry keeps the helmet registered, same as its text lines. */
+   registerArmor("helmet");
+}
+
+void serial_dispatch_frame(const serial_frame *frame)
+{
+   if (frame->kind == SERIAL_FRAME_BINARY) {
+      serial_dispatch_binary(frame);
+   } else if (frame->length > 0) {
+      serial_dispatch_text((char *) frame->data);
+   }
+}
+
+/* Supported termios rates. */
+static speed_t serial_baud_to_speed(int baud)
+{
+   static const struct {
+      int baud;
+      speed_t speed;
+   } rates[] = {
+      { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+      { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 },
+      { 1000000, B1000000 }, { 1500000, B1500000 }, { 2000000, B2000000 },
+      { 3000000, B3000000 }, { 4000000, B4000000 },
+   };
+
+   for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+      if (rates[i].baud == baud) {
+         return rates[i].speed;
+      }
+   }
+
+   LOG_WARNING("Unsupported serial baud rate %d, using 115200.", baud);
+
+   return B115200;
+}
+
 /**
  * Opens and configures a serial port for communication
  *
@@ -1024,23 +1284,23 @@ int serial_port_connect(const char *port_name, speed_t baud_rate, int *fd) {
 void *serial_command_processing_thread(void *arg) {
     int sfd = -1;
     fd_set read_fds;
-    struct timeval timeout, read_timeout;
-    char sread_buf[MAX_SERIAL_BUFFER_LENGTH];
+    struct timeval timeout;
     char *usb_port = (char *)arg;
 
-    /* Command buffering */
-    char command_buffer[MAX_SERIAL_BUFFER_LENGTH];
-    int command_length = 0;
+    /* Frame extraction. Static, the ring is too big for a thread stack to carry lightly. */
+    static serial_ring ring;
+    serial_frame frame;
+    unsigned char *in_ptr = NULL;
+    size_t in_space = 0;
 
     /* Watchdog and reconnection settings */
     time_t last_successful_read = 0;
     int watchdog_timeout_sec = 10; // Consider device dead after 10 sec without data
     int reconnect_attempts = 0;
     int max_reconnect_delay = 30; // Max seconds between reconnection attempts
-    speed_t serial_speed = B115200;
+    speed_t serial_speed = serial_baud_to_speed(get_hud_display_settings()->serial_baud);
 
-    /* Initialize command buffer */
-    command_buffer[0] = '\0';
+    serial_ring_init(&ring);
     memset(raw_log, '\0', LOG_ROWS * LOG_LINE_LENGTH);
 
     /* Initial connection */
@@ -1058,9 +1318,8 @@ void *serial_command_processing_thread(void *arg) {
     }
 
     while (!checkShutdown()) {
-        int select_result, bytes_available = 0;
-        int read_result = 0;
-        int flags;
+        int select_result;
+        ssize_t read_result = 0;
 
         /* Check if we have a valid file descriptor */
         if (sfd < 0) {
@@ -1077,6 +1336,7 @@ void *serial_command_processing_thread(void *arg) {
 
                 if (serial_port_connect(usb_port, serial_speed, &sfd) == 0) {
                     LOG_INFO("Successfully reconnected to %s", usb_port);
+                    serial_ring_reset(&ring);
                     reconnect_attempts = 0;
                     last_successful_read = time(NULL);
                     serial_set_state(-1, NULL, sfd); // Update just the file descriptor
@@ -1140,82 +1400,20 @@ void *serial_command_processing_thread(void *arg) {
             continue;
         }
 
-        /* Check bytes available */
-        if (ioctl(sfd, FIONREAD, &bytes_available) == -1) {
-            LOG_ERROR("ioctl error: %s", strerror(errno));
-            if (strcmp(usb_port, "") != 0) {
-                close(sfd);
-                sfd = -1;
-                continue; // Will trigger reconnection on next iteration
-            } else {
-                LOG_ERROR("ioctl error on stdin, exiting thread");
-                break;
-            }
+        /* Read straight into the ring. select() said there's data, so this won't block. */
+        in_ptr = serial_ring_write_ptr(&ring, &in_space);
+        if (in_space == 0) {
+            /* Can't happen with sane framing, but a zero length read would look like EOF. */
+            LOG_WARNING("Serial ring full without a complete frame, dropping it.");
+            serial_ring_reset(&ring);
+            in_ptr = serial_ring_write_ptr(&ring, &in_space);
         }
-
-        if (bytes_available == 0) {
-            if (strcmp(usb_port, "") != 0) {
-                LOG_WARNING("Zero bytes available but select indicated ready - possible device issue");
-                /* Test the connection by doing a non-blocking zero-length write */
-                flags = fcntl(sfd, F_GETFL, 0);
-                fcntl(sfd, F_SETFL, flags | O_NONBLOCK);
-
-                if (write(sfd, NULL, 0) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-                    LOG_WARNING("Connection test failed: %s", strerror(errno));
-                    close(sfd);
-                    sfd = -1;
-                    continue; // Will trigger reconnection on next iteration
-                }
-
-                /* Restore original flags */
-                fcntl(sfd, F_SETFL, flags);
-            }
-            continue;
-        }
-
-        /* Set non-blocking mode for read */
-        flags = fcntl(sfd, F_GETFL, 0);
-        fcntl(sfd, F_SETFL, flags | O_NONBLOCK);
-
-        /* Read with select() timeout */
-        FD_ZERO(&read_fds);
-        FD_SET(sfd, &read_fds);
-        read_timeout.tv_sec = 2;  // 2 second timeout for read operation
-        read_timeout.tv_usec = 0;
-
-        select_result = select(sfd + 1, &read_fds, NULL, NULL, &read_timeout);
-
-        if (select_result <= 0) {
-            if (select_result < 0) {
-                LOG_ERROR("Read select error: %s", strerror(errno));
-            } else {
-                LOG_WARNING("Read operation timed out after 2 seconds");
-            }
-
-            /* Handle timeout or error */
-            if (strcmp(usb_port, "") != 0) {
-                LOG_WARNING("Possible device hang, attempting to recover connection");
-                /* Restore original flags before closing */
-                fcntl(sfd, F_SETFL, flags);
-                close(sfd);
-                sfd = -1;
-                continue; // Will trigger reconnection on next iteration
-            }
-
-            /* Restore original flags */
-            fcntl(sfd, F_SETFL, flags);
-            continue;
-        }
-
-        /* Actually read the data */
-        read_result = read(sfd, sread_buf,
-                          bytes_available < (MAX_SERIAL_BUFFER_LENGTH - 1) ?
-                          bytes_available : (MAX_SERIAL_BUFFER_LENGTH - 1));
-
-        /* Restore original flags */
-        fcntl(sfd, F_SETFL, flags);
+        read_result = read(sfd, in_ptr, in_space);
 
         if (read_result < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+                continue;
+            }
             LOG_ERROR("Read error: %s", strerror(errno));
 
             /* Handle serious I/O errors */
@@ -1232,71 +1430,29 @@ void *serial_command_processing_thread(void *arg) {
             }
             continue;
         } else if (read_result == 0) {
-            LOG_WARNING("Zero bytes read despite having bytes available - possible disconnection");
+            LOG_WARNING("Zero bytes read despite select indicating data - possible disconnection");
             if (strcmp(usb_port, "") != 0) {
                 close(sfd);
                 sfd = -1;
                 continue; // Will trigger reconnection on next iteration
             }
-            continue;
+            break; // EOF on stdin
         }
 
         /* Update watchdog timer and reset reconnection attempts on successful read */
         last_successful_read = time(NULL);
         reconnect_attempts = 0;
 
-        /* Process the received data */
-        sread_buf[read_result] = '\0';
-
-        for (int j = 0; j < read_result; j++) {
-           if (sread_buf[j] == '\n') {
-              command_buffer[command_length] = '\0';
-              if (command_length > 0) {
-                 log_command(command_buffer);
-
-                 // Default topic is "helmet"
-                 char topic[256] = "helmet";
-
-                 // Parse JSON to extract device
-                 struct json_object *parsed_json = json_tokener_parse(command_buffer);
-                 if (parsed_json != NULL) {
-                    struct json_object *device_obj = NULL;
-                    if (json_object_object_get_ex(parsed_json, "device", &device_obj)) {
-                       const char *device = json_object_get_string(device_obj);
-                       if (device != NULL) {
-                          // Check if device matches any armor component
-                          armor_settings *this_as = get_armor_settings();
-                          element *armor_element = this_as->armor_elements;
-
-                          while (armor_element != NULL) {
-                             if (strcmp(armor_element->mqtt_device, device) == 0) {
-                                // Found matching armor component, copy the device to topic
-                                strncpy(topic, device, sizeof(topic) - 1);
-                                topic[sizeof(topic) - 1] = '\0';
-                                break;
-                             }
-                             armor_element = armor_element->next;
-                          }
-                       }
-                    }
-                    json_object_put(parsed_json);  // Free the JSON object
-                 }
-
-                 // Use the determined topic
-                 registerArmor(topic);
-                 parse_json_command(command_buffer, topic);
-              }
-              command_buffer[0] = '\0';
-              command_length = 0;
-           } else if (sread_buf[j] == '\r') {
-              /* Ignore carriage returns */
-           } else if (command_length < MAX_SERIAL_BUFFER_LENGTH - 2) {
-              command_buffer[command_length++] = sread_buf[j];
-           } else {
-              LOG_WARNING("Command buffer overflow, discarding data");
-              command_buffer[0] = '\0';
-              command_length = 0;
-           }
+        /* Process every complete frame in what we have so far. */
+        serial_ring_commit(&ring, read_result);
+        while (serial_ring_next(&ring, &frame)) {
+            if (trace_is_recording() && ((frame.kind == SERIAL_FRAME_BINARY) || (frame.length > 0))) {
+                trace_record_message(frame.kind == SERIAL_FRAME_BINARY ?
+                                     TRACE_SOURCE_SERIAL_BINARY : TRACE_SOURCE_SERIAL_TEXT,
+                                     frame.type, NULL, frame.data, frame.length);
+            }
+            serial_dispatch_frame(&frame);
+            serial_ring_release(&ring, &frame);
         }
     }
 
@@ -1395,16 +1551,254 @@ int forward_helmet_command_to_serial(char *command_string) {
    return serial_port_send(command_string);
 }
 
+/* One helmet socket client. Bytes accumulate until they make complete frames. */
+typedef struct {
+   int fd;                                   /* -1 when the slot is free. */
+   char buffer[HELMET_CLIENT_BUFFER_LENGTH + 1];   /* One spare to terminate frames in place. */
+   size_t length;
+   char scan_quote;                          /* Scanner state for unframed JSON. */
+   int scan_escape;
+   int scan_depth;
+   size_t scan_pos;
+   time_t last_activity;
+} helmet_client;
+
+static helmet_client helmet_clients[HELMET_MAX_CLIENTS];
+
+static helmet_client *helmet_client_find(int fd)
+{
+   for (int i = 0; i < HELMET_MAX_CLIENTS; i++) {
+      if (helmet_clients[i].fd == fd) {
+         return &helmet_clients[i];
+      }
+   }
+
+   return NULL;
+}
+
+static void helmet_client_close(int epoll_fd, helmet_client *client, const char *reason)
+{
+   LOG_INFO("Closing helmet client %d: %s", client->fd, reason);
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+   close(client->fd);
+   client->fd = -1;
+   client->length = 0;
+}
+
+static void helmet_client_reset_scan(helmet_client *client)
+{
+   client->scan_quote = 0;
+   client->scan_escape = 0;
+   client->scan_depth = 0;
+   client->scan_pos = 0;
+}
+
+/* Finds the next frame in buf[0..len).
+ *
+ * A frame is one of:
+ *  - "<decimal length>:<payload>", for clients that length-prefix.
+ *  - A line ending in '\n', outside of any JSON object. Newlines inside an
+ *    object are just whitespace, so pretty-printed documents stay whole.
+ *  - A complete top-level JSON object. Older clients write one document per
+ *    send with no delimiter, so the object's closing brace ends the frame.
+ *
+ * Sets the payload offset and length and how many bytes the frame used.
+ * Returns 1 for a frame, 0 if it isn't complete yet, -1 for a bad length prefix.
+ */
+static int helmet_next_frame(helmet_client *client, const char *buf, size_t len,
+                             size_t *start, size_t *length, size_t *consumed)
+{
+   if ((buf[0] >= '0') && (buf[0] <= '9')) {
+      size_t frame_len = 0;
+      size_t i = 0;
+
+      for (i = 0; (i < len) && (buf[i] >= '0') && (buf[i] <= '9'); i++) {
+         frame_len = frame_len * 10 + (buf[i] - '0');
+         if (frame_len >= HELMET_CLIENT_BUFFER_LENGTH) {
+            return -1;
+         }
+      }
+      if (i == len) {
+         return 0;
+      }
+      if (buf[i] != ':') {
+         return -1;
+      }
+      if (len < i + 1 + frame_len) {
+         return 0;
+      }
+      *start = i + 1;
+      *length = frame_len;
+      *consumed = i + 1 + frame_len;
+      return 1;
+   }
+
+   /* Resume the scan where the last read left it. */
+   for (size_t i = client->scan_pos; i < len; i++) {
+      char c = buf[i];
+
+      if (client->scan_quote) {
+         if (client->scan_escape) {
+            client->scan_escape = 0;
+         } else if (c == '\\') {
+            client->scan_escape = 1;
+         } else if (c == '"') {
+            client->scan_quote = 0;
+         }
+         continue;
+      }
+
+      if ((c == '\n') && (client->scan_depth == 0)) {
+         *start = 0;
+         *length = i;
+         *consumed = i + 1;
+         return 1;
+      } else if (c == '"') {
+         client->scan_quote = 1;
+      } else if (c == '{') {
+         client->scan_depth++;
+      } else if ((c == '}') && (client->scan_depth > 0) && (--client->scan_depth == 0)) {
+         *start = 0;
+         *length = i + 1;
+         *consumed = i + 1;
+         return 1;
+      }
+   }
+   client->scan_pos = len;
+
+   return 0;
+}
+
+/* Dispatch every complete frame in the client's buffer, then keep the remainder. */
+static int helmet_client_dispatch(helmet_client *client)
+{
+   size_t offset = 0;     /* Start of the bytes not yet consumed. */
+   int frames = 0;
+   int result = 0;
+
+   while (offset < client->length) {
+      char *base = client->buffer + offset;
+      size_t start = 0, length = 0, consumed = 0;
+      char saved = '\0';
+
+      /* Whitespace between frames. A partial frame never starts with it. */
+      if ((client->scan_pos == 0) && isspace((unsigned char) *base)) {
+         offset++;
+         continue;
+      }
+
+      result = helmet_next_frame(client, base, client->length - offset, &start, &length,
+                                 &consumed);
+      if (result <= 0) {
+         break;
+      }
+      helmet_client_reset_scan(client);
+
+      /* Terminate in place. The buffer has a spare byte past the end for this. */
+      saved = base[start + length];
+      base[start + length] = '\0';
+      if (trace_is_recording()) {
+         trace_record_message(TRACE_SOURCE_SOCKET, 0, "helmet", base + start, length);
+      }
+      parse_json_command(base + start, "helmet");
+      base[start + length] = saved;
+
+      frames++;
+      offset += consumed;
+   }
+
+   if (offset > 0) {
+      client->length -= offset;
+      memmove(client->buffer, client->buffer + offset, client->length);
+   }
+
+   return (result < 0) ? -1 : frames;
+}
+
+static void helmet_client_accept(int epoll_fd, int server_fd)
+{
+   struct epoll_event event;
+   helmet_client *client = NULL;
+   int fd = -1;
+
+   /* Take every pending connection, the listener is non-blocking. */
+   while ((fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+      client = helmet_client_find(-1);
+      if (client == NULL) {
+         LOG_WARNING("Too many helmet clients, refusing connection.");
+         close(fd);
+         continue;
+      }
+
+      event.events = EPOLLIN | EPOLLRDHUP;
+      event.data.fd = fd;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+         LOG_ERROR("Unable to watch helmet client: %s", strerror(errno));
+         close(fd);
+         continue;
+      }
+
+      client->fd = fd;
+      client->length = 0;
+      client->last_activity = time(NULL);
+      helmet_client_reset_scan(client);
+      LOG_INFO("Accepted new connection.");
+   }
+
+   if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+      LOG_ERROR("Accept failed: %s", strerror(errno));
+   }
+}
+
+/* Drain everything the client has sent. Returns 0 if it should be closed. */
+static int helmet_client_read(helmet_client *client)
+{
+   ssize_t bytes_read = 0;
+
+   for (;;) {
+      if (client->length == HELMET_CLIENT_BUFFER_LENGTH) {
+         /* Make room by handing off what's complete. A frame this big is junk. */
+         if (helmet_client_dispatch(client) < 0) {
+            return 0;
+         }
+         if (client->length == HELMET_CLIENT_BUFFER_LENGTH) {
+            LOG_WARNING("Helmet client frame too long, discarding data");
+            client->length = 0;
+            helmet_client_reset_scan(client);
+         }
+      }
+
+      bytes_read = read(client->fd, client->buffer + client->length,
+                        HELMET_CLIENT_BUFFER_LENGTH - client->length);
+      if (bytes_read > 0) {
+         client->length += bytes_read;
+         client->last_activity = time(NULL);
+      } else if (bytes_read == 0) {
+         LOG_INFO("Client disconnected.");
+         return 0;
+      } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+         return 1;
+      } else if (errno != EINTR) {
+         LOG_ERROR("Socket read failed with error: %s", strerror(errno));
+         return 0;
+      }
+   }
+}
+
 void *socket_command_processing_thread(void *arg)
 {
-   int server_fd, new_socket;
+   int server_fd = -1, epoll_fd = -1;
    struct sockaddr_in address;
+   struct epoll_event event;
+   struct epoll_event events[HELMET_MAX_CLIENTS + 1];
    int opt = 1;
-   int addrlen = sizeof(address);
-   char buffer[MAX_SERIAL_BUFFER_LENGTH] = {0};
+
+   for (int i = 0; i < HELMET_MAX_CLIENTS; i++) {
+      helmet_clients[i].fd = -1;
+   }
 
    // Creating socket file descriptor
-   if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+   if ((server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
       LOG_ERROR("Socket creation failed.");
       return NULL;
    }
@@ -1428,78 +1822,94 @@ void *socket_command_processing_thread(void *arg)
    }
 
    // Start listening for incoming connections
-   if (listen(server_fd, 3) < 0) {
+   if (listen(server_fd, HELMET_MAX_CLIENTS) < 0) {
       LOG_ERROR("Listen failed.");
       close(server_fd);
       return NULL;
    }
 
-   LOG_INFO("Server is listening on port %d\n", HELMET_PORT);
-
-   while (!checkShutdown()) {
-      fd_set readfds;
-      struct timeval reconnect_timeout;
-      int activity;
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (epoll_fd < 0) {
+      LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+      close(server_fd);
+      return NULL;
+   }
 
-      FD_ZERO(&readfds);
-      FD_SET(server_fd, &readfds);
+   event.events = EPOLLIN;
+   event.data.fd = server_fd;
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
+      LOG_ERROR("Unable to watch the server socket: %s", strerror(errno));
+      close(epoll_fd);
+      close(server_fd);
+      return NULL;
+   }
 
-      // Set timeout
-      reconnect_timeout.tv_sec = SERVER_TIMEOUT;
-      reconnect_timeout.tv_usec = 0;
+   LOG_INFO("Server is listening on port %d\n", HELMET_PORT);
 
-      activity = select(server_fd + 1, &readfds, NULL, NULL, &reconnect_timeout);
+   while (!checkShutdown()) {
+      int ready = epoll_wait(epoll_fd, events, HELMET_MAX_CLIENTS + 1, HELMET_POLL_MS);
+      int armor_registered = 0;
+      time_t now = time(NULL);
 
-      if (activity < 0 && errno != EINTR) {
-         LOG_ERROR("Select error.");
+      if (ready < 0) {
+         if (errno != EINTR) {
+            LOG_ERROR("epoll_wait error: %s", strerror(errno));
+         }
          continue;
       }
 
-      if (activity > 0 && FD_ISSET(server_fd, &readfds)) {
-         struct timeval read_timeout;
+      for (int i = 0; i < ready; i++) {
+         helmet_client *client = NULL;
+         int keep = 1;
 
-         new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen);
-         if (new_socket < 0) {
-            LOG_ERROR("Accept failed.");
+         if (events[i].data.fd == server_fd) {
+            helmet_client_accept(epoll_fd, server_fd);
             continue;
          }
 
-         LOG_INFO("Accepted new connection.");
-
-         // Set timeout
-         read_timeout.tv_sec = SERVER_TIMEOUT;
-         read_timeout.tv_usec = 0;
-
-         // Set the receive timeout for the new socket
-         if (setsockopt(new_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&read_timeout, sizeof(read_timeout)) < 0) {
-            LOG_ERROR("Setting socket receive timeout failed.");
-            close(new_socket);
+         client = helmet_client_find(events[i].data.fd);
+         if (client == NULL) {
             continue;
          }
 
-         while (!checkShutdown()) {
-            int bytes_read = read(new_socket, buffer, sizeof(buffer) - 1);
-            if (bytes_read > 0) {
-               buffer[bytes_read] = '\0'; // Null-terminate the received string
+         if (events[i].events & EPOLLIN) {
+            keep = helmet_client_read(client);
+         } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            keep = 0;
+         }
+
+         /* Everything this client sent in this wakeup goes out as one batch. */
+         if (client->length > 0) {
+            if (!armor_registered) {
                registerArmor("helmet");
-               parse_json_command(buffer, "helmet");
-            } else if (bytes_read == 0) {
-               LOG_INFO("Client disconnected.");
-               break;
-            } else if (bytes_read < 0 && errno == EWOULDBLOCK) {
-               LOG_WARNING("Socket receive timed out.");
-               break; // Timeout occurred
-            } else if (bytes_read < 0) {
-               LOG_ERROR("Socket read failed with error: %s", strerror(errno));
-               break;
+               armor_registered = 1;
+            }
+            if (helmet_client_dispatch(client) < 0) {
+               LOG_WARNING("Helmet client sent a bad length prefix.");
+               keep = 0;
             }
          }
 
-         close(new_socket);
-         LOG_INFO("Closed connection socket, ready for new connections.");
+         if (!keep || (events[i].events & EPOLLRDHUP)) {
+            helmet_client_close(epoll_fd, client, keep ? "hung up" : "disconnected");
+         }
+      }
+
+      /* Same idle limit the single client server had. */
+      for (int i = 0; i < HELMET_MAX_CLIENTS; i++) {
+         if ((helmet_clients[i].fd >= 0) &&
+             (now - helmet_clients[i].last_activity > SERVER_TIMEOUT)) {
+            helmet_client_close(epoll_fd, &helmet_clients[i], "receive timed out");
+         }
       }
    }
 
+   for (int i = 0; i < HELMET_MAX_CLIENTS; i++) {
+      if (helmet_clients[i].fd >= 0) {
+         helmet_client_close(epoll_fd, &helmet_clients[i], "shutting down");
+      }
+   }
+   close(epoll_fd);
    close(server_fd);
    LOG_INFO("Server socket closed.");
 
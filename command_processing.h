@@ -23,12 +23,22 @@
 #define COMMAND_PROCESSING_H
 
 #include "defines.h"
+#include "serial_framer.h"
 
 char (*get_raw_log(void))[LOG_LINE_LENGTH];
 int get_next_log_row(void);
 unsigned int get_log_generation(void);
+/**
+ * @brief Registers the MQTT/serial command handlers. Call once before any input starts.
+ */
+void command_processing_init(void);
 int parse_json_command(char *command_string, char *topic);
 void *serial_command_processing_thread(void *arg);
+
+/**
+ * @brief Dispatches one serial frame, text or binary, as if it had just been read.
+ */
+void serial_dispatch_frame(const serial_frame *frame);
 void *socket_command_processing_thread(void *arg);
 
 // Serial state management
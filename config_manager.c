@@ -46,11 +46,45 @@ static hud_display_settings this_hds = {
 
    .cam_crop_width = DEFAULT_CAM_CROP_WIDTH,
    .cam_crop_x = DEFAULT_CAM_CROP_X,
+   .cam_crop_at_source = 1,
+   .cam_scale_at_source = 0,
+
+   .cam_frame_width = DEFAULT_CAM_INPUT_WIDTH,
+   .cam_frame_height = DEFAULT_CAM_INPUT_HEIGHT,
+   .cam_frame_crop_x = DEFAULT_CAM_CROP_X,
 
    .eye_output_width = DEFAULT_EYE_OUTPUT_WIDTH,
    .eye_output_height = DEFAULT_EYE_OUTPUT_HEIGHT,
 
-   .stereo_offset = 0
+   .stereo_offset = 0,
+
+   .detect_frame_divisor = DEFAULT_DETECT_FRAME_DIVISOR,
+   .detect_top_k = DEFAULT_DETECT_TOP_K,
+   .detect_min_confidence = DEFAULT_DETECT_MIN_CONFIDENCE,
+
+   .hud_eye_layer = 0,
+   .idle_refresh_ms = DEFAULT_IDLE_REFRESH_MS,
+   .texture_cache_mb = DEFAULT_TEXTURE_CACHE_MB,
+   .frame_pacing = 0,
+   .frame_pacing_margin_ms = DEFAULT_FRAME_PACING_MARGIN_MS,
+   .pose_prediction = 0,
+   .record_composite = 0,
+   .replay_seconds = DEFAULT_REPLAY_SECONDS,
+   .replay_max_mb = DEFAULT_REPLAY_MAX_MB,
+   .replay_post_seconds = DEFAULT_REPLAY_POST_SECONDS,
+   .cam_profile = "",
+   .governor = 0,
+   .governor_temp_high = DEFAULT_GOVERNOR_TEMP_HIGH,
+   .governor_temp_low = DEFAULT_GOVERNOR_TEMP_LOW,
+   .governor_battery_low = DEFAULT_GOVERNOR_BATTERY_LOW,
+   .serial_baud = DEFAULT_SERIAL_BAUD,
+   .sample_wifi_ms = DEFAULT_SAMPLE_WIFI_MS,
+   .sample_cpu_ms = DEFAULT_SAMPLE_CPU_MS,
+   .sample_memory_ms = DEFAULT_SAMPLE_MEMORY_MS,
+   .sample_thermal_ms = DEFAULT_SAMPLE_THERMAL_MS,
+   .sample_fan_ms = DEFAULT_SAMPLE_FAN_MS,
+   .map_cache_path = "",
+   .map_cache_mb = DEFAULT_MAP_CACHE_MB
 };
 
 static stream_settings this_ss = {
@@ -69,6 +103,52 @@ hud_display_settings *get_hud_display_settings(void)
    return &this_hds;
 }
 
+void update_cam_frame_geometry(void)
+{
+#ifdef ORIGINAL_RATIO
+   /* The whole frame is letterboxed, there is nothing to crop. */
+   this_hds.cam_crop_at_source = 0;
+   this_hds.cam_scale_at_source = 0;
+#endif
+
+   if (this_hds.cam_crop_at_source &&
+       ((this_hds.cam_crop_width <= 0) || (this_hds.cam_crop_x < 0) ||
+        (this_hds.cam_crop_x + this_hds.cam_crop_width > this_hds.cam_input_width))) {
+      LOG_WARNING("Camera crop (x: %d, width: %d) doesn't fit the input width (%d). "
+                  "Cropping at render time instead.",
+                  this_hds.cam_crop_x, this_hds.cam_crop_width, this_hds.cam_input_width);
+      this_hds.cam_crop_at_source = 0;
+   }
+
+   if (!this_hds.cam_crop_at_source) {
+      this_hds.cam_scale_at_source = 0;
+      this_hds.cam_frame_width = this_hds.cam_input_width;
+      this_hds.cam_frame_height = this_hds.cam_input_height;
+      this_hds.cam_frame_crop_x = this_hds.cam_crop_x;
+      return;
+   }
+
+   this_hds.cam_frame_width = this_hds.cam_crop_width;
+   this_hds.cam_frame_height = this_hds.cam_input_height;
+   this_hds.cam_frame_crop_x = 0;
+
+   /* Scaling only pays off if it reduces the pixel count. */
+   if (this_hds.cam_scale_at_source) {
+      if ((this_hds.eye_output_width < this_hds.cam_frame_width) &&
+          (this_hds.eye_output_height < this_hds.cam_frame_height)) {
+         this_hds.cam_frame_width = this_hds.eye_output_width;
+         this_hds.cam_frame_height = this_hds.eye_output_height;
+      } else {
+         LOG_INFO("Eye output is not smaller than the camera crop. Not scaling at source.");
+         this_hds.cam_scale_at_source = 0;
+      }
+   }
+
+   LOG_INFO("Camera frames cropped at source: %dx%d (from %dx%d).",
+            this_hds.cam_frame_width, this_hds.cam_frame_height,
+            this_hds.cam_input_width, this_hds.cam_input_height);
+}
+
 stream_settings *get_stream_settings(void)
 {
    return &this_ss;
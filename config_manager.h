@@ -33,6 +33,14 @@ typedef struct _hud_display_settings {
 
    int cam_crop_width;
    int cam_crop_x;
+   int cam_crop_at_source;    /* Crop in the capture pipeline so only visible pixels are delivered. */
+   int cam_scale_at_source;   /* Also scale (down) the cropped region to the eye output size. */
+
+   /* Geometry of the frames actually delivered by the camera pipeline.
+    * Filled in by update_cam_frame_geometry(). */
+   int cam_frame_width;
+   int cam_frame_height;
+   int cam_frame_crop_x;      /* Crop still to be applied at render time. */
 
    int eye_output_width;
    int eye_output_height;
@@ -42,10 +50,48 @@ typedef struct _hud_display_settings {
    double pitch_offset;       /* Often the helmet sensor isn't in line with the level of the
                                * helmet. This adjusts that. */
    int snapshot_overlay;      /* Whether to include UI overlay in AI snapshots */
+   int detect_frame_divisor;  /* Run detection on every Nth camera frame, tracking fills the rest. */
+   int detect_top_k;          /* Most confident detections kept per eye, up to MAX_DETECT. */
+   double detect_min_confidence;
+   int hud_eye_layer;         /* Draw the HUD once into an eye sized layer and composite it per eye. */
+   int idle_refresh_ms;       /* No camera mode: redraw at least this often when nothing changed.
+                               * 0 redraws every loop. */
+   int texture_cache_mb;      /* Evict unused cached textures to stay under this. 0 is unlimited. */
+   int frame_pacing;          /* Sleep before each frame so rendering finishes just before vsync. */
+   double frame_pacing_margin_ms; /* Slack kept between the expected end of rendering and vsync. */
+   int pose_prediction;       /* Extrapolate the IMU pose to when the frame will be on screen. */
+   int record_composite;      /* Compose cameras and HUD in the encoder instead of reading back
+                               * the whole window. Read once at startup. */
+   int replay_seconds;        /* Video kept in the instant replay ring. */
+   int replay_max_mb;         /* Memory cap for the replay ring. */
+   int replay_post_seconds;   /* Video after a replay trigger added to the clip. */
+   char cam_profile[CAMERA_PROFILE_NAME_LENGTH]; /* Startup camera profile. Empty for the mode above. */
+   int governor;              /* Step camera, detection and recording down when hot or low on battery. */
+   double governor_temp_high;
+   double governor_temp_low;
+   double governor_battery_low;
+   int serial_baud;           /* Helmet serial link rate. Read when the port is opened. */
+   int sample_wifi_ms;        /* Local system sampling intervals. 0 leaves a metric to STAT, */
+                              /* except wifi, which only the sampler provides. */
+   int sample_cpu_ms;
+   int sample_memory_ms;
+   int sample_thermal_ms;
+   int sample_fan_ms;
+   char map_cache_path[MAX_FILENAME_LENGTH]; /* Map image cache. Empty uses the per-user cache. */
+   int map_cache_mb;          /* Least recently used map images are evicted to stay under this. */
 } hud_display_settings;
 
 hud_display_settings *get_hud_display_settings(void);
 
+/**
+ * @brief Computes the size of the frames the camera pipeline will deliver.
+ *
+ * Uses the camera input, crop and eye output settings along with the
+ * crop/scale at source flags. Call once after the config is loaded and
+ * before the camera pipeline and textures are created.
+ */
+void update_cam_frame_geometry(void);
+
 /* Variables for streaming output */
 typedef struct _stream_settings {
    char stream_dest_ip[16];
@@ -20,16 +20,24 @@
  */
 
 #include <json-c/json.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <strings.h>
 #include <sys/stat.h>
 
 #include "SDL2/SDL_image.h"
 
 #include "mirage.h"
+#include "armor.h"
+#include "asset_bundle.h"
+#include "camera_governor.h"
 #include "config_manager.h"
 #include "config_parser.h"
 #include "hud_manager.h"
 #include "logging.h"
+#include "string_pool.h"
+#include "texture_cache.h"
 
 /* Map type string representations */
 const char* MAP_TYPE_STRINGS[] = {
@@ -39,33 +47,150 @@ const char* MAP_TYPE_STRINGS[] = {
    "terrain"
 };
 
+const char* TEXT_TOKEN_STRINGS[] = {
+   "",
+   "*FPS*",
+   "*DATETIME*",
+   "*GPSTIME*",
+   "*SYSTIME*",
+   "*AINAME*",
+   "*CPU*",
+   "*SYSTEM_TEMP*",
+   "*SYSTEM_TEMP_F*",
+   "*MEM*",
+   "*HELMTEMP*",
+   "*HELMTEMP_F*",
+   "*HELMHUM*",
+   "*AIRQUALITY*",
+   "*AIRQUALITYDESC*",
+   "*TVOC*",
+   "*ECO2*",
+   "*CO2*",
+   "*CO2QUALITY*",
+   "*CO2ECO2DIFF*",
+   "*CO2SOURCEANALYSIS*",
+   "*HEATINDEX_C*",
+   "*DEWPOINT*",
+   "*FAN*",
+   "*BATTERY_LEVEL*",
+   "*BATTERY_STATUS*",
+   "*BATTERY_STATUS_REASON*",
+   "*BATTERY_CELLS_CONFIG*",
+   "*BATTERY_FAULT_COUNT*",
+   "*BATTERY_CRITICAL_FAULTS*",
+   "*BATTERY_WARNING_FAULTS*",
+   "*BATTERY_INFO_FAULTS*",
+   "*BATTERY_ALL_FAULTS*",
+   "*BATTERY_TIME*",
+   "*BATTERY_TIME_MIN*",
+   "*BATTERY_VOLTAGE*",
+   "*BATTERY_CURRENT*",
+   "*BATTERY_POWER*",
+   "*BATTERY_TEMP*",
+   "*BATTERY_CHEMISTRY*",
+   "*BATTERY_CAPACITY*",
+   "*BATTERY_CELLS*",
+   "*LATLON*",
+   "*PITCH*",
+   "*COMPASS*",
+   "*LOG*",
+   "*ALERT*",
+   "*PERF_TOP*"
+};
+
+/* Map a text element string to its dynamic token, TEXT_TOKEN_NONE for plain text. */
+static text_token_t lookup_text_token(const char *text)
+{
+   if ((text == NULL) || (text[0] != '*')) {
+      return TEXT_TOKEN_NONE;
+   }
+
+   for (int i = TEXT_TOKEN_NONE + 1; i < TEXT_TOKEN_COUNT; i++) {
+      if (strcmp(text, TEXT_TOKEN_STRINGS[i]) == 0) {
+         return (text_token_t) i;
+      }
+   }
+
+   return TEXT_TOKEN_NONE;
+}
+
 static time_t config_last_modified = 0;   /* When was the config file last checked? */
+static uint64_t config_rest_hash = 0;     /* Hash of everything but the regular elements. */
 
 extern alert_t active_alerts;
 
-/**
- * @brief Validates that a JSON config file is parseable without applying changes.
- *
- * @param config_filename Path to the configuration file to validate
- * @return SUCCESS if config is valid, FAILURE if invalid or unreadable
- */
-static int validate_json_config(const char *config_filename) {
+#define CONFIG_HASH_SEED  14695981039346656037ULL   /* FNV-1a 64-bit offset basis. */
+#define CONFIG_HASH_PRIME 1099511628211ULL
+
+/* Background reload. The worker only reads the file and builds the json tree,
+ * anything that touches SDL or the element list is applied on the render thread. */
+typedef enum {
+   RELOAD_IDLE,
+   RELOAD_PARSING,
+   RELOAD_READY
+} reload_state_t;
+
+typedef struct {
+   char filename[MAX_FILENAME_LENGTH];
+   time_t mtime;
+   struct json_object *parsed_json;    /* NULL if the file was unreadable or invalid. */
+   uint64_t rest_hash;
+   uint64_t *element_hashes;           /* One per "Elements" entry, 0 for non-regular ones. */
+   size_t element_count;
+} reload_job;
+
+static pthread_mutex_t reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static reload_state_t reload_state = RELOAD_IDLE;
+static reload_job reload_result;
+
+static int apply_config_json(struct json_object *parsed_json);
+static element *parse_element_json(struct json_object *tmpobj2, const char *element_type);
+void insert_element_by_layer(element * this_element);
+
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+   while ((str != NULL) && (*str != '\0')) {
+      hash ^= (unsigned char) *str++;
+      hash *= CONFIG_HASH_PRIME;
+   }
+
+   return hash;
+}
+
+/* Content hash of a config object. Elements are matched across reloads by this,
+ * names aren't required to be unique. */
+static uint64_t config_object_hash(struct json_object *obj)
+{
+   return hash_string(CONFIG_HASH_SEED, json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+}
+
+/* The type of an "Elements" entry, or NULL if it has none. */
+static const char *element_entry_type(struct json_object *entry)
+{
+   struct json_object *tmpobj = NULL;
+
+   if (!json_object_object_get_ex(entry, "type", &tmpobj) || (tmpobj == NULL)) {
+      return NULL;
+   }
+
+   return json_object_get_string(tmpobj);
+}
+
+/* Read a whole file into a NUL terminated buffer. The caller frees it. */
+static char *read_config_file(const char *filename)
+{
    FILE *config_file = NULL;
-   struct json_object *parsed_json = NULL;
    char *config_string = NULL;
    int string_size = 0;
    int bytes_read = 0;
    char tmpstr[1024];
 
-   /* Try to open and read the file */
-   config_file = fopen(config_filename, "r");
+   config_file = fopen(filename, "r");
    if (config_file == NULL) {
-      LOG_ERROR("Cannot open config file for validation: %s", config_filename);
-      return FAILURE;
+      LOG_ERROR("Unable to open config file: %s", filename);
+      return NULL;
    }
 
-   /* Read entire file into memory */
-   string_size = 0;
    while ((bytes_read = fread(tmpstr, 1, 1024, config_file)) > 0) {
       string_size += bytes_read;
       config_string = realloc(config_string, string_size + 1);
@@ -78,73 +203,160 @@ static int validate_json_config(const char *config_filename) {
    }
    fclose(config_file);
 
-   /* Try to parse JSON */
-   parsed_json = json_tokener_parse(config_string);
-   if (parsed_json == NULL) {
-      LOG_ERROR("Invalid JSON in config file: %s", config_filename);
-      free(config_string);
-      return FAILURE;
-   }
+   return config_string;
+}
 
-   /* Basic structure validation - check for required sections */
+/**
+ * @brief Validates that a parsed JSON config has the required sections.
+ *
+ * @param parsed_json The parsed configuration
+ * @return SUCCESS if config is valid, FAILURE if a section is missing
+ */
+static int validate_json_config(struct json_object *parsed_json) {
    struct json_object *tmpobj = NULL;
 
    /* Validate HUDs section exists */
    if (!json_object_object_get_ex(parsed_json, "HUDs", &tmpobj)) {
       LOG_ERROR("Missing 'HUDs' section in config file");
-      json_object_put(parsed_json);
-      free(config_string);
       return FAILURE;
    }
 
    /* Validate Elements section exists */
    if (!json_object_object_get_ex(parsed_json, "Elements", &tmpobj)) {
       LOG_ERROR("Missing 'Elements' section in config file");
-      json_object_put(parsed_json);
-      free(config_string);
       return FAILURE;
    }
 
    /* Could add more validation here if needed */
 
-   json_object_put(parsed_json);
-   free(config_string);
    return SUCCESS;
 }
 
-int reload_config(const char *config_filename) {
-   // Save current HUD state for restoration
-   hud_manager *hud_mgr = get_hud_manager();
-   hud_screen *current_hud = hud_mgr->current_screen;
-   char current_hud_name[MAX_TEXT_LENGTH] = {0};
+/* Read, parse, validate and hash a config file. Safe off the render thread. */
+static void parse_config_job(reload_job *job)
+{
+   struct json_object_iterator it;
+   struct json_object_iterator itEnd;
+   char *config_string = read_config_file(job->filename);
 
-   if (current_hud != NULL) {
-      strncpy(current_hud_name, current_hud->name, MAX_TEXT_LENGTH - 1);
+   job->parsed_json = NULL;
+   job->rest_hash = CONFIG_HASH_SEED;
+   job->element_hashes = NULL;
+   job->element_count = 0;
+
+   if (config_string == NULL) {
+      return;
    }
 
-   /* Validate new config before touching existing state */
-   if (validate_json_config(config_filename) != SUCCESS) {
-      LOG_ERROR("New config file is invalid, keeping current configuration");
-      return FAILURE;
+   job->parsed_json = json_tokener_parse(config_string);
+   free(config_string);
+   if (job->parsed_json == NULL) {
+      LOG_ERROR("Invalid JSON in config file: %s", job->filename);
+      return;
+   }
+
+   if (validate_json_config(job->parsed_json) != SUCCESS) {
+      json_object_put(job->parsed_json);
+      job->parsed_json = NULL;
+      return;
    }
 
-   /* Config is valid, proceed with reload */
+   /* Regular elements get their own hashes so they can be diffed, everything
+    * else (including the intro element) goes into the rest hash. */
+   it = json_object_iter_begin(job->parsed_json);
+   itEnd = json_object_iter_end(job->parsed_json);
+   while (!json_object_iter_equal(&it, &itEnd)) {
+      const char *name = json_object_iter_peek_name(&it);
+      struct json_object *value = json_object_iter_peek_value(&it);
+
+      job->rest_hash = hash_string(job->rest_hash, name);
+      if ((strcmp(name, "Elements") == 0) && (json_object_get_type(value) == json_type_array)) {
+         job->element_count = json_object_array_length(value);
+         job->element_hashes = calloc(job->element_count ? job->element_count : 1, sizeof(uint64_t));
+         if (job->element_hashes == NULL) {
+            LOG_ERROR("Cannot allocate config element hashes.");
+            json_object_put(job->parsed_json);
+            job->parsed_json = NULL;
+            return;
+         }
 
-   // Free old elements
-   element *old_first_element = get_first_element();
-   armor_settings *this_as = get_armor_settings();
+         for (size_t i = 0; i < job->element_count; i++) {
+            struct json_object *entry = json_object_array_get_idx(value, i);
+            const char *type = element_entry_type(entry);
+
+            if (type == NULL) {
+               continue;
+            } else if (strcmp(type, "intro") == 0) {
+               job->rest_hash = hash_string(job->rest_hash,
+                                            json_object_to_json_string_ext(entry, JSON_C_TO_STRING_PLAIN));
+            } else {
+               job->element_hashes[i] = config_object_hash(entry);
+            }
+         }
+      } else {
+         job->rest_hash = hash_string(job->rest_hash,
+                                      json_object_to_json_string_ext(value, JSON_C_TO_STRING_PLAIN));
+      }
 
-   if (old_first_element != NULL) {
-      free_elements(old_first_element);
+      json_object_iter_next(&it);
+   }
+}
+
+static void *reload_worker(void *arg)
+{
+   reload_job *job = (reload_job *) arg;
+
+   parse_config_job(job);
+
+   pthread_mutex_lock(&reload_mutex);
+   reload_result = *job;
+   reload_state = RELOAD_READY;
+   pthread_mutex_unlock(&reload_mutex);
+
+   free(job);
+
+   return NULL;
+}
+
+/* Take an element out of the live list without freeing it. */
+static void unlink_element(element *this_element)
+{
+   invalidate_hud_draw_lists();
+
+   if (this_element->prev != NULL) {
+      this_element->prev->next = this_element->next;
+   } else {
+      set_first_element(this_element->next);
+   }
+
+   if (this_element->next != NULL) {
+      this_element->next->prev = this_element->prev;
    }
 
-   if (this_as->armor_elements != NULL) {
-      free_elements(this_as->armor_elements);
+   this_element->prev = NULL;
+   this_element->next = NULL;
+}
+
+/* Rebuild everything from a parsed config. The old elements are freed only
+ * after the new ones are built so shared textures and sheets stay loaded. */
+static int apply_full_reload(struct json_object *parsed_json)
+{
+   // Save current HUD state for restoration
+   hud_manager *hud_mgr = get_hud_manager();
+   hud_screen *current_hud = hud_mgr->current_screen;
+   char current_hud_name[MAX_TEXT_LENGTH] = {0};
+   element *old_first_element = get_first_element();
+   armor_settings *this_as = get_armor_settings();
+   element *old_armor_elements = this_as->armor_elements;
+
+   if (current_hud != NULL) {
+      strncpy(current_hud_name, current_hud->name, MAX_TEXT_LENGTH - 1);
    }
 
    // Clear pointers
    set_first_element(NULL);
    this_as->armor_elements = NULL;
+   invalidate_hud_draw_lists();
 
    // Clean up existing HUD registry
    cleanup_hud_manager();
@@ -152,13 +364,21 @@ int reload_config(const char *config_filename) {
    // Re-initialize HUD manager
    init_hud_manager();
 
-   /* Parse new config (should succeed since we validated) */
-   if (parse_json_config(config_filename) != SUCCESS) {
-      LOG_ERROR("Config parsing failed after validation - file may have changed during reload");
+   /* Apply new config (should succeed since we validated) */
+   if (apply_config_json(parsed_json) != SUCCESS) {
+      LOG_ERROR("Config parsing failed after validation - an asset may be missing");
       LOG_ERROR("Application restart required");
       exit(EXIT_FAILURE);  // Just exit - system is in inconsistent state
    }
 
+   if (old_first_element != NULL) {
+      free_elements(old_first_element);
+   }
+
+   if (old_armor_elements != NULL) {
+      free_elements(old_armor_elements);
+   }
+
    /* Success - restore HUD state if possible */
    if (current_hud_name[0] != '\0') {
       hud_screen *restored_hud = find_hud_by_name(current_hud_name);
@@ -169,33 +389,206 @@ int reload_config(const char *config_filename) {
       }
    }
 
-   // Trigger config reload notification alert
-   active_alerts |= ALERT_CONFIG_RELOADED;
+   return SUCCESS;
+}
+
+/* Only regular elements changed. Live elements whose config is unchanged are
+ * kept along with their textures and state, the rest are built or freed. */
+static int apply_element_diff(reload_job *job)
+{
+   struct json_object *elements = NULL;
+   element **old_elements = NULL;
+   element *added = NULL;
+   element *curr_element = NULL;
+   element *next_element = NULL;
+   int old_count = 0;
+   int kept = 0;
+   int added_count = 0;
+   int removed = 0;
+
+   json_object_object_get_ex(job->parsed_json, "Elements", &elements);
+
+   for (curr_element = get_first_element(); curr_element != NULL; curr_element = curr_element->next) {
+      old_count++;
+   }
+
+   old_elements = calloc(old_count ? old_count : 1, sizeof(element *));
+   if (old_elements == NULL) {
+      LOG_ERROR("Cannot allocate element diff table.");
+      return FAILURE;
+   }
+
+   old_count = 0;
+   for (curr_element = get_first_element(); curr_element != NULL; curr_element = curr_element->next) {
+      old_elements[old_count++] = curr_element;
+   }
+
+   /* Claim a live match for each entry, build the ones without one. Nothing
+    * in the live list changes until every new element has loaded. */
+   for (size_t i = 0; i < job->element_count; i++) {
+      struct json_object *entry = json_object_array_get_idx(elements, i);
+      int found = 0;
+
+      if (job->element_hashes[i] == 0) {
+         continue;
+      }
+
+      for (int j = 0; j < old_count; j++) {
+         if ((old_elements[j] != NULL) && (old_elements[j]->config_hash == job->element_hashes[i])) {
+            old_elements[j] = NULL;
+            found = 1;
+            kept++;
+            break;
+         }
+      }
+      if (found) {
+         continue;
+      }
+
+      curr_element = parse_element_json(entry, element_entry_type(entry));
+      if (curr_element == NULL) {
+         if (added != NULL) {
+            free_elements(added);
+         }
+         free(old_elements);
+         return FAILURE;
+      }
+      curr_element->config_hash = job->element_hashes[i];
+      curr_element->next = added;
+      added = curr_element;
+      added_count++;
+   }
+
+   for (int j = 0; j < old_count; j++) {
+      if (old_elements[j] != NULL) {
+         unlink_element(old_elements[j]);
+         free_elements(old_elements[j]);
+         removed++;
+      }
+   }
+   free(old_elements);
+
+   for (curr_element = added; curr_element != NULL; curr_element = next_element) {
+      next_element = curr_element->next;
+      curr_element->next = NULL;
+      insert_element_by_layer(curr_element);
+   }
+
+   LOG_INFO("Config elements: %d kept, %d added, %d removed.", kept, added_count, removed);
+
+   if ((added_count > 0) || (removed > 0)) {
+      update_hud_draw_lists();
+   }
+   if (added_count > 0) {
+      /* New assets may not be in the atlas yet. */
+      build_texture_atlas();
+   }
+   hud_mark_damaged();
+
+   /* armor_display may have been replaced, refresh the cached notice timeout. */
+   armor_registry_rebuild();
 
    return SUCCESS;
 }
 
+/* Apply a parsed job on the render thread and release its tree. */
+static int apply_reload_job(reload_job *job, int force_full)
+{
+   int rc = FAILURE;
+
+   if (job->parsed_json == NULL) {
+      return FAILURE;
+   }
+
+   if (!force_full && (job->rest_hash == config_rest_hash)) {
+      rc = apply_element_diff(job);
+   } else {
+      rc = apply_full_reload(job->parsed_json);
+   }
+
+   if (rc == SUCCESS) {
+      config_rest_hash = job->rest_hash;
+
+      // Trigger config reload notification alert
+      active_alerts |= ALERT_CONFIG_RELOADED;
+   }
+
+   json_object_put(job->parsed_json);
+   job->parsed_json = NULL;
+   free(job->element_hashes);
+   job->element_hashes = NULL;
+
+   return rc;
+}
+
+int reload_config(const char *config_filename) {
+   reload_job job;
+
+   memset(&job, 0, sizeof(job));
+   snprintf(job.filename, sizeof(job.filename), "%s", config_filename);
+
+   /* Validate new config before touching existing state */
+   parse_config_job(&job);
+   if (job.parsed_json == NULL) {
+      LOG_ERROR("New config file is invalid, keeping current configuration");
+      return FAILURE;
+   }
+
+   return apply_reload_job(&job, 1);
+}
+
+int apply_pending_config(void)
+{
+   reload_job job;
+   int ready = 0;
+   int rc = SUCCESS;
+
+   pthread_mutex_lock(&reload_mutex);
+   if (reload_state == RELOAD_READY) {
+      job = reload_result;
+      reload_state = RELOAD_IDLE;
+      ready = 1;
+   }
+   pthread_mutex_unlock(&reload_mutex);
+
+   if (!ready) {
+      return SUCCESS;
+   }
+
+   if (job.parsed_json == NULL) {
+      LOG_ERROR("New config file is invalid, keeping current configuration");
+      free(job.element_hashes);
+      return FAILURE;
+   }
+
+   rc = apply_reload_job(&job, 0);
+   if (rc == SUCCESS) {
+      config_last_modified = job.mtime;
+      LOG_INFO("Config successfully reloaded");
+   } else {
+      LOG_ERROR("Config reload failed, keeping current config");
+   }
+
+   return rc;
+}
+
 int check_and_reload_config(const char *config_filename) {
    struct stat file_stat;
+   reload_job *job = NULL;
+   pthread_t worker;
+   int busy = 0;
 
    if (stat(config_filename, &file_stat) != 0) {
       LOG_WARNING("Cannot stat config file: %s", config_filename);
       return FAILURE;
    }
 
-   // For initial load (config_last_modified == 0), always load
-   if (config_last_modified == 0 || file_stat.st_mtime > config_last_modified) {
-      if (config_last_modified == 0) {
-         LOG_INFO("Loading initial config file: %s", config_filename);
-      } else {
-         LOG_INFO("Config file changed, reloading...");
-      }
+   // For initial load (config_last_modified == 0), always load, and do it now
+   if (config_last_modified == 0) {
+      LOG_INFO("Loading initial config file: %s", config_filename);
 
       if (reload_config(config_filename) == SUCCESS) {
          config_last_modified = file_stat.st_mtime;
-         if (config_last_modified > 0) {
-            LOG_INFO("Config successfully reloaded");
-         }
          return SUCCESS;
       } else {
          LOG_ERROR("Config reload failed, keeping current config");
@@ -203,13 +596,68 @@ int check_and_reload_config(const char *config_filename) {
       }
    }
 
-   return SUCCESS; // No change needed
+   if (file_stat.st_mtime <= config_last_modified) {
+      return SUCCESS; // No change needed
+   }
+
+   pthread_mutex_lock(&reload_mutex);
+   busy = (reload_state != RELOAD_IDLE);
+   if (!busy) {
+      reload_state = RELOAD_PARSING;
+   }
+   pthread_mutex_unlock(&reload_mutex);
+
+   if (busy) {
+      return SUCCESS;   // A parse is in flight or waiting to be applied
+   }
+
+   LOG_INFO("Config file changed, reloading...");
+
+   job = calloc(1, sizeof(reload_job));
+   if (job != NULL) {
+      snprintf(job->filename, sizeof(job->filename), "%s", config_filename);
+      job->mtime = file_stat.st_mtime;
+
+      if (pthread_create(&worker, NULL, reload_worker, job) == 0) {
+         pthread_detach(worker);
+         return SUCCESS;
+      }
+      free(job);
+   }
+
+   /* No worker, parse here instead. */
+   LOG_WARNING("Unable to start config reload worker, parsing on the render thread.");
+   job = calloc(1, sizeof(reload_job));
+   if (job == NULL) {
+      pthread_mutex_lock(&reload_mutex);
+      reload_state = RELOAD_IDLE;
+      pthread_mutex_unlock(&reload_mutex);
+      return FAILURE;
+   }
+   snprintf(job->filename, sizeof(job->filename), "%s", config_filename);
+   job->mtime = file_stat.st_mtime;
+   reload_worker(job);
+
+   return apply_pending_config();
 }
 
-/* Parse json animation files. */
-int parse_animated_json(element * curr_element)
+/* Sprite sheets loaded so far. Elements hold references. */
+static sprite_sheet *sheet_list = NULL;
+
+static void attach_sheet(anim *this_anim, sprite_sheet *sheet)
+{
+   sheet->refcount++;
+
+   this_anim->sheet = sheet;
+   this_anim->frames = sheet->frames;
+   this_anim->frame_count = sheet->frame_count;
+   this_anim->cursor = 0;
+   this_anim->current_frame = &sheet->frames[0];
+}
+
+/* Parse an animation JSON into a new, unlisted sheet. */
+static sprite_sheet *parse_sheet_json(const char *filename)
 {
-   FILE *config_file = NULL;
    struct json_object *parsed_json = NULL;
    struct json_object *tmpobj, *tmpobj2, *tmpobj3, *tmpobj4;
 
@@ -217,325 +665,1061 @@ int parse_animated_json(element * curr_element)
    struct json_object_iterator itEnd;
 
    char *config_string = NULL;
-   int string_size = 0;
-   int bytes_read = 0;
 
+   sprite_sheet *sheet = NULL;
    frame *this_frame = NULL;
+   int count = 0;
 
-   char tmpstr[1024];
+   config_string = read_config_file(filename);
+   if (config_string == NULL) {
+      return NULL;
+   }
 
-   config_file = fopen(curr_element->filename, "r");
-   if (config_file == NULL) {
-      LOG_ERROR("Unable to open config file: %s", curr_element->filename);
-      return FAILURE;
+   parsed_json = json_tokener_parse(config_string);
+   free(config_string);
+   if (parsed_json == NULL) {
+      LOG_ERROR("Unable to parse animation file: %s", filename);
+      return NULL;
    }
 
-   string_size = 0;
-   while ((bytes_read = fread(tmpstr, 1, 1024, config_file)) > 0) {
-      string_size += bytes_read;
-      config_string = realloc(config_string, string_size + 1);
-      if (string_size <= 1024) {
-         strncpy(config_string, tmpstr, bytes_read);
-      } else {
-         strncat(config_string, tmpstr, bytes_read);
-      }
-      config_string[string_size] = '\0';
+   /* frames section */
+   if (!json_object_object_get_ex(parsed_json, "frames", &tmpobj) ||
+       (json_object_object_length(tmpobj) == 0)) {
+      LOG_ERROR("Animation file has no frames: %s", filename);
+      json_object_put(parsed_json);
+      return NULL;
    }
 
-   fclose(config_file);
+   sheet = calloc(1, sizeof(sprite_sheet));
+   if (sheet != NULL) {
+      sheet->frames = calloc(json_object_object_length(tmpobj), sizeof(frame));
+   }
+   if ((sheet == NULL) || (sheet->frames == NULL)) {
+      LOG_ERROR("Unable to malloc sprite sheet for: %s", filename);
+      free(sheet);
+      json_object_put(parsed_json);
+      return NULL;
+   }
 
-   //printf("Config String (%d): \"%s\"\n", string_size, config_string);
+   /* Main Loop */
+   it = json_object_iter_begin(tmpobj);
+   itEnd = json_object_iter_end(tmpobj);
 
-   parsed_json = json_tokener_parse(config_string);
-   if (parsed_json != NULL) {
-      /* frames section */
-      json_object_object_get_ex(parsed_json, "frames", &tmpobj);
+   while (!json_object_iter_equal(&it, &itEnd)) {
+      //printf("%s\n", json_object_iter_peek_name(&it));
+      tmpobj2 = json_object_iter_peek_value(&it);
+      this_frame = &sheet->frames[count++];
 
-      /* Main Loop */
-      it = json_object_iter_begin(tmpobj);
-      itEnd = json_object_iter_end(tmpobj);
+      json_object_object_get_ex(tmpobj2, "frame", &tmpobj3);
+
+      /* Frame Info */
+      json_object_object_get_ex(tmpobj3, "x", &tmpobj4);
+      this_frame->source_x = json_object_get_int(tmpobj4);
+
+      json_object_object_get_ex(tmpobj3, "y", &tmpobj4);
+      this_frame->source_y = json_object_get_int(tmpobj4);
+
+      json_object_object_get_ex(tmpobj3, "w", &tmpobj4);
+      this_frame->source_w = json_object_get_int(tmpobj4);
+
+      json_object_object_get_ex(tmpobj3, "h", &tmpobj4);
+      this_frame->source_h = json_object_get_int(tmpobj4);
+
+      /* Rotated */
+      json_object_object_get_ex(tmpobj2, "rotated", &tmpobj3);
+      this_frame->rotated = json_object_get_boolean(tmpobj3);
+
+      /* Trimmed */
+      json_object_object_get_ex(tmpobj2, "trimmed", &tmpobj3);
+      this_frame->trimmed = json_object_get_boolean(tmpobj3);
+
+      /* Sprite Info */
+      json_object_object_get_ex(tmpobj2, "spriteSourceSize", &tmpobj3);
+
+      json_object_object_get_ex(tmpobj3, "x", &tmpobj4);
+      this_frame->dest_x = json_object_get_int(tmpobj4);
+
+      json_object_object_get_ex(tmpobj3, "y", &tmpobj4);
+      this_frame->dest_y = json_object_get_int(tmpobj4);
+
+      /* Sprite Source Info */
+      json_object_object_get_ex(tmpobj2, "sourceSize", &tmpobj3);
+
+      json_object_object_get_ex(tmpobj3, "w", &tmpobj4);
+      this_frame->source_size_w = json_object_get_int(tmpobj4);
+
+      json_object_object_get_ex(tmpobj3, "h", &tmpobj4);
+      this_frame->source_size_h = json_object_get_int(tmpobj4);
+
+      json_object_iter_next(&it);
+   }
+   sheet->frame_count = count;
+
+   /* meta section */
+   json_object_object_get_ex(parsed_json, "meta", &tmpobj);
+
+   json_object_object_get_ex(tmpobj, "image", &tmpobj2);
+   sheet->image = intern_path(get_image_path(), json_object_get_string(tmpobj2));
+
+   json_object_object_get_ex(tmpobj, "format", &tmpobj2);
+   if (tmpobj2 != NULL) {
+      strncpy(sheet->format, json_object_get_string(tmpobj2), sizeof(sheet->format) - 1);
+   }
+
+   json_object_put(parsed_json);
+
+   return sheet;
+}
+
+/* Build a sheet from the asset bundle's frame table, NULL if it isn't baked. */
+static sprite_sheet *load_baked_sheet(const char *filename)
+{
+   const asset_bundle_frame *baked = NULL;
+   const char *image = NULL;
+   const char *format = NULL;
+   sprite_sheet *sheet = NULL;
+   int count = 0;
+
+   baked = asset_bundle_find_frames(filename, &count, &image, &format);
+   if ((baked == NULL) || (count == 0)) {
+      return NULL;
+   }
+
+   sheet = calloc(1, sizeof(sprite_sheet));
+   if (sheet != NULL) {
+      sheet->frames = calloc(count, sizeof(frame));
+   }
+   if ((sheet == NULL) || (sheet->frames == NULL)) {
+      LOG_ERROR("Unable to malloc sprite sheet for: %s", filename);
+      free(sheet);
+      return NULL;
+   }
+
+   for (int i = 0; i < count; i++) {
+      sheet->frames[i].source_x = baked[i].source_x;
+      sheet->frames[i].source_y = baked[i].source_y;
+      sheet->frames[i].source_w = baked[i].source_w;
+      sheet->frames[i].source_h = baked[i].source_h;
+      sheet->frames[i].dest_x = baked[i].dest_x;
+      sheet->frames[i].dest_y = baked[i].dest_y;
+      sheet->frames[i].source_size_w = baked[i].source_size_w;
+      sheet->frames[i].source_size_h = baked[i].source_size_h;
+      sheet->frames[i].rotated = baked[i].rotated;
+      sheet->frames[i].trimmed = baked[i].trimmed;
+   }
+   sheet->frame_count = count;
+   sheet->image = intern_path(get_image_path(), image);
+   strncpy(sheet->format, format, sizeof(sheet->format) - 1);
+
+   return sheet;
+}
+
+/* Find a loaded sheet, or load it from the bundle or its JSON. New sheets are
+ * listed with no references; release_animation() frees them once used and dropped. */
+static sprite_sheet *load_sprite_sheet(const char *filename)
+{
+   sprite_sheet *sheet = NULL;
+
+   for (sheet = sheet_list; sheet != NULL; sheet = sheet->next) {
+      if (sheet->filename == filename) {
+         return sheet;
+      }
+   }
+
+   sheet = load_baked_sheet(filename);
+   if (sheet == NULL) {
+      sheet = parse_sheet_json(filename);
+   }
+   if (sheet == NULL) {
+      return NULL;
+   }
+
+   sheet->filename = filename;
+   sheet->next = sheet_list;
+   sheet_list = sheet;
+
+   return sheet;
+}
+
+/* Parse json animation files. */
+int parse_animated_json(element * curr_element)
+{
+   sprite_sheet *sheet = NULL;
+
+   release_animation(&curr_element->this_anim);
+
+   sheet = load_sprite_sheet(curr_element->filename);
+   if (sheet == NULL) {
+      return FAILURE;
+   }
+
+   attach_sheet(&curr_element->this_anim, sheet);
+
+   return SUCCESS;
+}
+
+void release_animation(anim *this_anim)
+{
+   sprite_sheet **link = &sheet_list;
+   sprite_sheet *sheet = (sprite_sheet *) this_anim->sheet;
+
+   memset(this_anim, 0, sizeof(anim));
+
+   if ((sheet == NULL) || (--sheet->refcount > 0)) {
+      return;
+   }
+
+   while ((*link != NULL) && (*link != sheet)) {
+      link = &(*link)->next;
+   }
+   if (*link != NULL) {
+      *link = sheet->next;
+   }
+
+   free(sheet->frames);
+   free(sheet);
+}
+
+int advance_animation(anim *this_anim)
+{
+   if (this_anim->frame_count == 0) {
+      return 1;
+   }
+
+   if (++this_anim->cursor >= this_anim->frame_count) {
+      this_anim->cursor = 0;
+   }
+   this_anim->current_frame = &this_anim->frames[this_anim->cursor];
+
+   return this_anim->cursor == 0;
+}
+
+/* Parse a color string into its individual components. */
+int parse_color(char *string, unsigned char *r, unsigned char *g, unsigned char *b,
+                unsigned char *a)
+{
+   char *tmpptr0 = NULL;
+   char *tmpptr1 = NULL;
+   int tmpi0 = 0;
+   int tmpi1 = 0;
+   int tmpi2 = 0;
+   int tmpi3 = 0;
+   int base = 10;
+
+   tmpptr0 = strchr(string, ',');
+   tmpptr0[0] = '\0';
+   if (strchr(string, 'x') == NULL) {
+      base = 10;
+   } else {
+      base = 16;
+   }
+   tmpi0 = strtol(string, NULL, base);
+   tmpptr0++;
+
+   tmpptr1 = strchr(tmpptr0, ',');
+   tmpptr1[0] = '\0';
+   if (strchr(tmpptr0, 'x') == NULL) {
+      base = 10;
+   } else {
+      base = 16;
+   }
+   tmpi1 = strtol(tmpptr0, NULL, base);
+   tmpptr1++;
+
+   tmpptr0 = strchr(tmpptr1, ',');
+   tmpptr0[0] = '\0';
+   if (strchr(tmpptr1, 'x') == NULL) {
+      base = 10;
+   } else {
+      base = 16;
+   }
+   tmpi2 = strtol(tmpptr1, NULL, base);
+   tmpptr0++;
+
+   if (strchr(tmpptr0, 'x') == NULL) {
+      base = 10;
+   } else {
+      base = 16;
+   }
+   tmpi3 = strtol(tmpptr0, NULL, base);
+
+   //printf("Parsed Color: %d, %d, %d, %d\n", tmpi0, tmpi1, tmpi2, tmpi3);
+   *r = tmpi0;
+   *g = tmpi1;
+   *b = tmpi2;
+   *a = tmpi3;
+
+   return 0;
+}
+
+/* Add the new UI element based on which layer it's in.
+ * Fancy linked list processing.
+ */
+void insert_element_by_layer(element * this_element)
+{
+   element *first_element = get_first_element();
+   element *curr_element = first_element;
+
+   invalidate_hud_draw_lists();
+
+   if (first_element == NULL) {
+      set_first_element(this_element);
+
+      return;
+   }
+
+   while ((curr_element->next != NULL) && (curr_element->layer < this_element->layer)) {
+      curr_element = curr_element->next;
+   }
+
+   this_element->next = curr_element->next;
+
+   if (curr_element->next != NULL) {
+      this_element->next->prev = this_element;
+   }
+   curr_element->next = this_element;
+   this_element->prev = curr_element;
+   return;
+}
+
+/* Parse common properties shared by all element types */
+static int parse_common_element_properties(struct json_object *element_obj, element *curr_element) {
+   struct json_object *tmpobj = NULL;
+   const char *tmpstr_ptr = NULL;
+
+   /* Parse name if present */
+   json_object_object_get_ex(element_obj, "name", &tmpobj);
+   if (tmpobj != NULL) {
+      curr_element->name = intern_string(json_object_get_string(tmpobj));
+   }
+
+   /* Parse position */
+   json_object_object_get_ex(element_obj, "dest_x", &tmpobj);
+   if (tmpobj != NULL) {
+      curr_element->dest_x = curr_element->dst_rect.x = json_object_get_int(tmpobj);
+   }
+
+   json_object_object_get_ex(element_obj, "dest_y", &tmpobj);
+   if (tmpobj != NULL) {
+      curr_element->dest_y = curr_element->dst_rect.y = json_object_get_int(tmpobj);
+   }
+
+   /* Parse angle */
+   json_object_object_get_ex(element_obj, "angle", &tmpobj);
+   if (tmpobj != NULL) {
+      if (json_object_get_type(tmpobj) == json_type_string) {
+         const char *angle_str = json_object_get_string(tmpobj);
+         if (strcmp(angle_str, "roll") == 0) {
+            curr_element->angle = ANGLE_ROLL;
+         } else if (strcmp(angle_str, "opposite roll") == 0) {
+            curr_element->angle = ANGLE_OPPOSITE_ROLL;
+         } else {
+            LOG_WARNING("Error processing angle string: %s", angle_str);
+         }
+      } else {
+         curr_element->angle = json_object_get_double(tmpobj);
+      }
+   }
+
+   /* Parse fixed property if present */
+   if (json_object_object_get_ex(element_obj, "fixed", &tmpobj)) {
+      curr_element->fixed = json_object_get_int(tmpobj);
+   } else {
+      curr_element->fixed = FIXED_DEFAULT;
+   }
+
+   /* Parse layer */
+   json_object_object_get_ex(element_obj, "layer", &tmpobj);
+   if (tmpobj != NULL) {
+      curr_element->layer = json_object_get_int(tmpobj);
+   }
+
+   /* Parse enabled flag if present */
+   if (json_object_object_get_ex(element_obj, "enabled", &tmpobj)) {
+      curr_element->enabled = json_object_get_int(tmpobj);
+   }
+
+   /* Parse hotkey if present */
+   if (json_object_object_get_ex(element_obj, "hotkey", &tmpobj)) {
+      tmpstr_ptr = json_object_get_string(tmpobj);
+      if (tmpstr_ptr != NULL) {
+         strncpy(curr_element->hotkey, tmpstr_ptr, 2);
+      }
+   }
+
+   /* Parse HUD associations */
+   json_object_object_get_ex(element_obj, "huds", &tmpobj);
+   if (tmpobj != NULL && json_object_get_type(tmpobj) == json_type_array) {
+      /* Clear HUD flags first */
+      memset(curr_element->hud_flags, 0, MAX_HUDS);
+
+      int hud_count = json_object_array_length(tmpobj);
+      for (int h = 0; h < hud_count; h++) {
+         struct json_object *hud_name_obj = json_object_array_get_idx(tmpobj, h);
+         const char *hud_name = json_object_get_string(hud_name_obj);
+
+         hud_screen *screen = find_hud_by_name(hud_name);
+         if (screen != NULL) {
+            curr_element->hud_flags[screen->hud_id] = 1;
+         } else {
+            LOG_WARNING("Unknown HUD '%s' in element definition", hud_name);
+         }
+      }
+   } else {
+      /* If no HUDs specified, add to the default (first) HUD */
+      hud_screen *default_hud = get_hud_manager()->screens;
+      if (default_hud != NULL) {
+         curr_element->hud_flags[default_hud->hud_id] = 1;
+      }
+   }
+
+   return SUCCESS;
+}
+
+/* "Camera Profiles": [ { "Name": "720p60", "Width": 1280, "Height": 720, "FPS": 60 }, ... ] */
+static void parse_camera_profiles(struct json_object *list)
+{
+   struct json_object *profile = NULL, *name = NULL, *width = NULL, *height = NULL, *fps = NULL;
+
+   if (json_object_get_type(list) != json_type_array) {
+      LOG_WARNING("\"Camera Profiles\" should be a list.");
+      return;
+   }
+
+   camera_profiles_clear();
+   for (size_t i = 0; i < json_object_array_length(list); i++) {
+      profile = json_object_array_get_idx(list, i);
+      if (!json_object_object_get_ex(profile, "Name", &name) ||
+          !json_object_object_get_ex(profile, "Width", &width) ||
+          !json_object_object_get_ex(profile, "Height", &height) ||
+          !json_object_object_get_ex(profile, "FPS", &fps)) {
+         LOG_WARNING("Camera profile %zu needs Name, Width, Height and FPS.", i);
+         continue;
+      }
+
+      camera_profile_add(json_object_get_string(name), json_object_get_int(width),
+                         json_object_get_int(height), json_object_get_int(fps));
+   }
+}
+
+/* Build one regular element from its config object. The caller sets config_hash.
+ * Returns NULL if an asset couldn't be loaded. */
+static element *parse_element_json(struct json_object *tmpobj2, const char *element_type)
+{
+   struct json_object *tmpobj3 = NULL;
+   element *default_element = get_default_element();
+   element *curr_element = NULL;
+   const char *image_path = get_image_path();
+   char tmpstr[1024];
+   double ratio = 0.0;
+
+
+   curr_element = malloc(sizeof(element));
+   if (curr_element == NULL) {
+      LOG_ERROR("Cannot malloc new element!");
+      exit(1);
+   }
+   memcpy(curr_element, default_element, sizeof(element));
+   curr_element->enabled = 1;
+
+   /* STATIC */
+   if (strcmp("static", element_type) == 0) {
+      curr_element->type = STATIC;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse static-specific properties */
+      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
+      curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->width = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->height = json_object_get_int(tmpobj3);
+      }
+
+      /* Load texture */
+      curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_FILE);
+      if (!curr_element->texture) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      /* Set up destination rectangle */
+      if ((curr_element->width == 0) && (curr_element->height == 0)) {
+         SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                         &curr_element->dst_rect.w, &curr_element->dst_rect.h);
+      } else if ((curr_element->width == 0) && (curr_element->height != 0)) {
+         SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                         &curr_element->dst_rect.w, &curr_element->dst_rect.h);
+         ratio = (double) curr_element->height / (double) curr_element->dst_rect.h;
+         curr_element->dst_rect.w = curr_element->width =
+                                   curr_element->dst_rect.w * ratio;
+      } else if ((curr_element->width != 0) && (curr_element->height == 0)) {
+         SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                         &curr_element->dst_rect.w, &curr_element->dst_rect.h);
+         ratio = (double) curr_element->width / (double) curr_element->dst_rect.w;
+         curr_element->dst_rect.h = curr_element->height =
+                                   curr_element->dst_rect.h * ratio;
+      } else {
+         curr_element->dst_rect.w = curr_element->width;
+         curr_element->dst_rect.h = curr_element->height;
+      }
+   /* Record Graphic */
+   } else if (strcmp("record-ui", element_type) == 0) {
+      curr_element->type = STATIC;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse record-ui specific properties */
+      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
+      curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      json_object_object_get_ex(tmpobj2, "file_r", &tmpobj3);
+      curr_element->filename_r = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      json_object_object_get_ex(tmpobj2, "file_s", &tmpobj3);
+      curr_element->filename_s = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      json_object_object_get_ex(tmpobj2, "file_rs", &tmpobj3);
+      curr_element->filename_rs = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      /* Load textures */
+      curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_FILE);
+      if (!curr_element->texture) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_r = acquire_element_texture(curr_element, ELEMENT_TEXTURE_R);
+      if (!curr_element->texture_r) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_r,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_s = acquire_element_texture(curr_element, ELEMENT_TEXTURE_S);
+      if (!curr_element->texture_s) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_s,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_rs = acquire_element_texture(curr_element, ELEMENT_TEXTURE_RS);
+      if (!curr_element->texture_rs) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_rs,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                     &curr_element->dst_rect.w, &curr_element->dst_rect.h);
+   /* AI Status Graphic */
+   } else if (strcmp("ai-ui", element_type) == 0) {
+      curr_element->type = STATIC;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse ai-ui specific properties */
+      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
+      curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      /* AI Listening */
+      json_object_object_get_ex(tmpobj2, "file_l", &tmpobj3);
+      curr_element->filename_l = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      /* AI Heard Wakeword */
+      json_object_object_get_ex(tmpobj2, "file_w", &tmpobj3);
+      curr_element->filename_w = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      /* AI Processing */
+      json_object_object_get_ex(tmpobj2, "file_p", &tmpobj3);
+      curr_element->filename_p = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      /* Load textures */
+      curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_FILE);
+      if (!curr_element->texture) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_l = acquire_element_texture(curr_element, ELEMENT_TEXTURE_L);
+      if (!curr_element->texture_l) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_l,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_w = acquire_element_texture(curr_element, ELEMENT_TEXTURE_W);
+      if (!curr_element->texture_w) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_w,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      curr_element->texture_p = acquire_element_texture(curr_element, ELEMENT_TEXTURE_P);
+      if (!curr_element->texture_p) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->filename_p,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                     &curr_element->dst_rect.w, &curr_element->dst_rect.h);
+   /* ANIMATED */
+   } else if (strcmp("animated", element_type) == 0) {
+      curr_element->type = ANIMATED;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse animated-specific properties */
+      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
+      curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
+
+      json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->width = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->height = json_object_get_int(tmpobj3);
+      }
+
+      /* Parse animation data */
+      if (parse_animated_json(curr_element) != SUCCESS) {
+         free_elements(curr_element);
+         return NULL;
+      }
+
+      /* Load texture */
+      curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_SHEET);
+      if (!curr_element->texture) {
+         SDL_Log("Couldn't load %s: %s\n", curr_element->this_anim.sheet->image,
+                 SDL_GetError());
+         free_elements(curr_element);
+         return NULL;
+      }
+   /* TEXT */
+   } else if (strcmp("text", element_type) == 0) {
+      curr_element->type = TEXT;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse text-specific properties */
+      json_object_object_get_ex(tmpobj2, "string", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->text = intern_string(json_object_get_string(tmpobj3));
+      }
+      curr_element->text_token = lookup_text_token(curr_element->text);
+
+      json_object_object_get_ex(tmpobj2, "font", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->font = intern_path(get_font_path(), json_object_get_string(tmpobj3));
+      }
+
+      json_object_object_get_ex(tmpobj2, "color", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         strncpy(tmpstr, json_object_get_string(tmpobj3), 1024);
+         parse_color(tmpstr, &curr_element->font_color.r,
+                     &curr_element->font_color.g, &curr_element->font_color.b,
+                     &curr_element->font_color.a);
+      }
+
+      json_object_object_get_ex(tmpobj2, "size", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->font_size = json_object_get_int(tmpobj3);
+      }
+
+      if ((strcmp(curr_element->font, "") != 0) && (curr_element->font_size > 0)) {
+         curr_element->ttf_font =
+             get_local_font(curr_element->font, curr_element->font_size);
+      }
+
+      json_object_object_get_ex(tmpobj2, "halign", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         strncpy(curr_element->halign, json_object_get_string(tmpobj3), 7);
+      }
+
+      /* These are currently just for the *LOG* text. */
+      // Parse width if present
+      json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
+      if (tmpobj3 != NULL) {
+          curr_element->width = json_object_get_int(tmpobj3);
+      }
+
+      // Parse height if present
+      json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->height = json_object_get_int(tmpobj3);
+      }
+   /* SPECIAL */
+   } else if (strcmp("special", element_type) == 0) {
+      curr_element->type = SPECIAL;
+
+      /* Parse common properties */
+      parse_common_element_properties(tmpobj2, curr_element);
+
+      /* Parse special-specific properties */
+      json_object_object_get_ex(tmpobj2, "name", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->special_name = intern_string(json_object_get_string(tmpobj3));
+         curr_element->name = curr_element->special_name;
+
+         if (strncmp(curr_element->special_name, "detect", 6) == 0) {
+            set_detect_enabled(1);
+         }
+      }
+
+      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
+      }
+
+      json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->width = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->height = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "download_count", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->download_count = json_object_get_int(tmpobj3);
+      }
+
+      /* Font properties for special elements that need text rendering */
+      json_object_object_get_ex(tmpobj2, "font", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->font = intern_path(get_font_path(), json_object_get_string(tmpobj3));
+      }
+
+      json_object_object_get_ex(tmpobj2, "color", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         strncpy(tmpstr, json_object_get_string(tmpobj3), 1024);
+         parse_color(tmpstr, &curr_element->font_color.r,
+                     &curr_element->font_color.g, &curr_element->font_color.b,
+                     &curr_element->font_color.a);
+      }
+
+      json_object_object_get_ex(tmpobj2, "size", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->font_size = json_object_get_int(tmpobj3);
+      }
+
+      if ((strcmp(curr_element->font, "") != 0) && (curr_element->font_size > 0)) {
+         curr_element->ttf_font =
+             get_local_font(curr_element->font, curr_element->font_size);
+      }
+
+      /* Special offset properties */
+      json_object_object_get_ex(tmpobj2, "center_x_offset", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->center_x_offset = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "center_y_offset", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->center_y_offset = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "text_x_offset", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->text_x_offset = json_object_get_int(tmpobj3);
+      }
+
+      json_object_object_get_ex(tmpobj2, "text_y_offset", &tmpobj3);
+      if (tmpobj3 != NULL) {
+         curr_element->text_y_offset = json_object_get_int(tmpobj3);
+      }
+
+      /* Handle animations for special elements like heading, pitch, etc. */
+      if ((strcmp("heading", curr_element->special_name) == 0) ||
+          (strcmp("pitch", curr_element->special_name) == 0) ||
+          (strcmp("altitude", curr_element->special_name) == 0) ||
+          (strcmp("wifi", curr_element->special_name) == 0) ||
+          (strcmp("detect", curr_element->special_name) == 0)) {
 
-      while (!json_object_iter_equal(&it, &itEnd)) {
-         //printf("%s\n", json_object_iter_peek_name(&it));
-         tmpobj2 = json_object_iter_peek_value(&it);
+         if (parse_animated_json(curr_element) != SUCCESS) {
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         json_object_object_get_ex(tmpobj2, "frame", &tmpobj3);
+         if (strcmp("detect", curr_element->special_name) != 0) {
+            curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_SHEET);
+            if (!curr_element->texture) {
+               SDL_Log("Couldn't load %s: %s\n",
+                       curr_element->filename, SDL_GetError());
+               free_elements(curr_element);
+               return NULL;
+            }
+         }
+      }
 
-         /* Init new frame */
-         if (this_frame == NULL) {
-            this_frame = malloc(sizeof(frame));
-            if (curr_element->this_anim.first_frame == NULL) {
-               curr_element->this_anim.first_frame = curr_element->this_anim.current_frame =
-                   this_frame;
+      /* Map elements, parse map-specific properties */
+      if (strcmp("map", curr_element->special_name) == 0) {
+         // Parse maptype
+         json_object_object_get_ex(tmpobj2, "maptype", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            const char *maptype_str = json_object_get_string(tmpobj3);
+
+            // Convert string to enum
+            for (int i = 0; i < MAP_TYPE_COUNT; i++) {
+               if (strcmp(maptype_str, MAP_TYPE_STRINGS[i]) == 0) {
+                  curr_element->map_type = (map_type_t)i;
+                  break;
+               }
             }
-         } else {
-            this_frame->next = malloc(sizeof(frame));
-            this_frame = this_frame->next;
          }
-         this_frame->next = NULL;
-         if (curr_element->this_anim.frame_count < MAX_FRAMES) {
-            curr_element->this_anim.frame_lookup[curr_element->this_anim.frame_count] = this_frame;
-         } else {
-            LOG_WARNING("Max frame count reached: %d", MAX_FRAMES);
+
+         // Parse zoom_level
+         json_object_object_get_ex(tmpobj2, "zoom", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->map_zoom = json_object_get_int(tmpobj3);
          }
-         curr_element->this_anim.frame_count++;
 
-         /* Frame Info */
-         json_object_object_get_ex(tmpobj3, "x", &tmpobj4);
-         //printf("frame x: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_x = json_object_get_int(tmpobj4);
+         // Parse update_interval
+         json_object_object_get_ex(tmpobj2, "update_interval", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->update_interval_sec = json_object_get_int(tmpobj3);
+         }
 
-         json_object_object_get_ex(tmpobj3, "y", &tmpobj4);
-         //printf("frame y: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_y = json_object_get_int(tmpobj4);
+         /* If we're parsing a config file, we should immediately refesh. */
+         curr_element->force_refresh = 1;
+      }
 
-         json_object_object_get_ex(tmpobj3, "w", &tmpobj4);
-         //printf("frame w: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_w = json_object_get_int(tmpobj4);
+      /* Battery display elements */
+      if (strcmp("battery", curr_element->special_name) == 0) {
+         /* We're reusing filenames and textures here. No reason for new ones. */
+         json_object_object_get_ex(tmpobj2, "file_100", &tmpobj3);
+         curr_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
 
-         json_object_object_get_ex(tmpobj3, "h", &tmpobj4);
-         //printf("frame h: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_h = json_object_get_int(tmpobj4);
+         json_object_object_get_ex(tmpobj2, "file_75", &tmpobj3);
+         curr_element->filename_base = intern_path(image_path, json_object_get_string(tmpobj3));
 
-         /* Rotated */
-         json_object_object_get_ex(tmpobj2, "rotated", &tmpobj3);
-         //printf("rotated: %d\n", json_object_get_boolean(tmpobj3));
-         this_frame->rotated = json_object_get_boolean(tmpobj3);
+         json_object_object_get_ex(tmpobj2, "file_50", &tmpobj3);
+         curr_element->filename_online = intern_path(image_path, json_object_get_string(tmpobj3));
 
-         /* Trimmed */
-         json_object_object_get_ex(tmpobj2, "trimmed", &tmpobj3);
-         //printf("trimmed: %d\n", json_object_get_boolean(tmpobj3));
-         this_frame->trimmed = json_object_get_boolean(tmpobj3);
+         json_object_object_get_ex(tmpobj2, "file_25", &tmpobj3);
+         curr_element->filename_warning = intern_path(image_path, json_object_get_string(tmpobj3));
 
-         /* Sprite Info */
-         json_object_object_get_ex(tmpobj2, "spriteSourceSize", &tmpobj3);
+         json_object_object_get_ex(tmpobj2, "file_0", &tmpobj3);
+         curr_element->filename_offline = intern_path(image_path, json_object_get_string(tmpobj3));
 
-         json_object_object_get_ex(tmpobj3, "x", &tmpobj4);
-         //printf("spriteSourceSize x: %d\n", json_object_get_int(tmpobj4));
-         this_frame->dest_x = json_object_get_int(tmpobj4);
+         /* Load textures */
+         curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_FILE);
+         if (!curr_element->texture) {
+            SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
+                    SDL_GetError());
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         json_object_object_get_ex(tmpobj3, "y", &tmpobj4);
-         //printf("spriteSourceSize y: %d\n", json_object_get_int(tmpobj4));
-         this_frame->dest_y = json_object_get_int(tmpobj4);
+         curr_element->texture_base = acquire_element_texture(curr_element, ELEMENT_TEXTURE_BASE);
+         if (!curr_element->texture_base) {
+            SDL_Log("Couldn't load %s: %s\n", curr_element->filename_base,
+                    SDL_GetError());
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         /* Sprite Source Info */
-         json_object_object_get_ex(tmpobj2, "sourceSize", &tmpobj3);
+         curr_element->texture_online = acquire_element_texture(curr_element, ELEMENT_TEXTURE_ONLINE);
+         if (!curr_element->texture_online) {
+            SDL_Log("Couldn't load %s: %s\n", curr_element->filename_online,
+                    SDL_GetError());
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         json_object_object_get_ex(tmpobj3, "w", &tmpobj4);
-         //printf("spriteSourceSize x: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_size_w = json_object_get_int(tmpobj4);
+         curr_element->texture_warning = acquire_element_texture(curr_element, ELEMENT_TEXTURE_WARNING);
+         if (!curr_element->texture_warning) {
+            SDL_Log("Couldn't load %s: %s\n", curr_element->filename_warning,
+                    SDL_GetError());
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         json_object_object_get_ex(tmpobj3, "h", &tmpobj4);
-         //printf("spriteSourceSize y: %d\n", json_object_get_int(tmpobj4));
-         this_frame->source_size_h = json_object_get_int(tmpobj4);
+         curr_element->texture_offline = acquire_element_texture(curr_element, ELEMENT_TEXTURE_OFFLINE);
+         if (!curr_element->texture_offline) {
+            SDL_Log("Couldn't load %s: %s\n", curr_element->filename_offline,
+                    SDL_GetError());
+            free_elements(curr_element);
+            return NULL;
+         }
 
-         json_object_iter_next(&it);
+         SDL_QueryTexture(curr_element->texture, NULL, NULL,
+                          &curr_element->dst_rect.w, &curr_element->dst_rect.h);
       }
 
-      /* meta section */
-      json_object_object_get_ex(parsed_json, "meta", &tmpobj);
+      /* Check if this is an armor display element */
+      if (strcmp("armor_display", curr_element->special_name) == 0) {
+         json_object_object_get_ex(tmpobj2, "notice_x", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->notice_x = json_object_get_int(tmpobj3);
+         }
 
-      json_object_object_get_ex(tmpobj, "image", &tmpobj2);
-      snprintf(curr_element->this_anim.image, MAX_FILENAME_LENGTH * 2, "%s/%s",
-               get_image_path(), json_object_get_string(tmpobj2));
+         json_object_object_get_ex(tmpobj2, "notice_y", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->notice_y = json_object_get_int(tmpobj3);
+         }
 
-      json_object_object_get_ex(tmpobj, "format", &tmpobj2);
-      strncpy(curr_element->this_anim.format, json_object_get_string(tmpobj2), 12);
-   }
+         json_object_object_get_ex(tmpobj2, "notice_width", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->notice_width = json_object_get_int(tmpobj3);
+         }
 
-   json_object_put(parsed_json);
+         json_object_object_get_ex(tmpobj2, "notice_height", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->notice_height = json_object_get_int(tmpobj3);
+         }
 
-   free(config_string);
+         json_object_object_get_ex(tmpobj2, "notice_timeout", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->notice_timeout = json_object_get_int(tmpobj3);
+         }
 
-   return 0;
-}
+         json_object_object_get_ex(tmpobj2, "show_metrics", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->show_metrics = json_object_get_boolean(tmpobj3);
+         }
 
-/* Parse a color string into its individual components. */
-int parse_color(char *string, unsigned char *r, unsigned char *g, unsigned char *b,
-                unsigned char *a)
-{
-   char *tmpptr0 = NULL;
-   char *tmpptr1 = NULL;
-   int tmpi0 = 0;
-   int tmpi1 = 0;
-   int tmpi2 = 0;
-   int tmpi3 = 0;
-   int base = 10;
+         json_object_object_get_ex(tmpobj2, "metrics_font", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->metrics_font = intern_path(get_font_path(), json_object_get_string(tmpobj3));
+         }
 
-   tmpptr0 = strchr(string, ',');
-   tmpptr0[0] = '\0';
-   if (strchr(string, 'x') == NULL) {
-      base = 10;
-   } else {
-      base = 16;
+         json_object_object_get_ex(tmpobj2, "metrics_font_size", &tmpobj3);
+         if (tmpobj3 != NULL) {
+            curr_element->metrics_font_size = json_object_get_int(tmpobj3);
+         }
+      }
    }
-   tmpi0 = strtol(string, NULL, base);
-   tmpptr0++;
 
-   tmpptr1 = strchr(tmpptr0, ',');
-   tmpptr1[0] = '\0';
-   if (strchr(tmpptr0, 'x') == NULL) {
-      base = 10;
-   } else {
-      base = 16;
-   }
-   tmpi1 = strtol(tmpptr0, NULL, base);
-   tmpptr1++;
+   return curr_element;
+}
 
-   tmpptr0 = strchr(tmpptr1, ',');
-   tmpptr0[0] = '\0';
-   if (strchr(tmpptr1, 'x') == NULL) {
-      base = 10;
-   } else {
-      base = 16;
+typedef struct {
+   const char **paths;
+   int count;
+   int capacity;
+} asset_list;
+
+/* Paths are interned, so duplicates compare equal. */
+static void asset_list_add(asset_list *list, const char *path)
+{
+   const char **grown = NULL;
+
+   for (int i = 0; i < list->count; i++) {
+      if (list->paths[i] == path) {
+         return;
+      }
    }
-   tmpi2 = strtol(tmpptr1, NULL, base);
-   tmpptr0++;
 
-   if (strchr(tmpptr0, 'x') == NULL) {
-      base = 10;
-   } else {
-      base = 16;
+   if (list->count == list->capacity) {
+      grown = realloc(list->paths, sizeof(char *) * (list->capacity ? list->capacity * 2 : 64));
+      if (grown == NULL) {
+         return;
+      }
+      list->paths = grown;
+      list->capacity = list->capacity ? list->capacity * 2 : 64;
    }
-   tmpi3 = strtol(tmpptr0, NULL, base);
+   list->paths[list->count++] = path;
+}
 
-   //printf("Parsed Color: %d, %d, %d, %d\n", tmpi0, tmpi1, tmpi2, tmpi3);
-   *r = tmpi0;
-   *g = tmpi1;
-   *b = tmpi2;
-   *a = tmpi3;
+/* "file", "file_*" and "* file" keys name asset files. */
+static int is_asset_key(const char *key)
+{
+   size_t len = strlen(key);
 
-   return 0;
+   return (strcmp(key, "file") == 0) || (strncmp(key, "file_", 5) == 0) ||
+          ((len > 5) && (strcmp(key + len - 5, " file") == 0));
 }
 
-/* Add the new UI element based on which layer it's in.
- * Fancy linked list processing.
- */
-void insert_element_by_layer(element * this_element)
+static void collect_section_assets(struct json_object *section, asset_list *list)
 {
-   element *first_element = get_first_element();
-   element *curr_element = first_element;
-
-   if (first_element == NULL) {
-      set_first_element(this_element);
+   const char *image_path = get_image_path();
 
+   if (json_object_get_type(section) != json_type_array) {
       return;
    }
 
-   while ((curr_element->next != NULL) && (curr_element->layer < this_element->layer)) {
-      curr_element = curr_element->next;
-   }
-
-   this_element->next = curr_element->next;
-
-   if (curr_element->next != NULL) {
-      this_element->next->prev = this_element;
-   }
-   curr_element->next = this_element;
-   this_element->prev = curr_element;
-   return;
-}
-
-/* Parse common properties shared by all element types */
-static int parse_common_element_properties(struct json_object *element_obj, element *curr_element) {
-   struct json_object *tmpobj = NULL;
-   const char *tmpstr_ptr = NULL;
+   for (size_t i = 0; i < json_object_array_length(section); i++) {
+      struct json_object *entry = json_object_array_get_idx(section, i);
 
-   /* Parse name if present */
-   json_object_object_get_ex(element_obj, "name", &tmpobj);
-   if (tmpobj != NULL) {
-      strncpy(curr_element->name, json_object_get_string(tmpobj), MAX_TEXT_LENGTH - 1);
-      curr_element->name[MAX_TEXT_LENGTH - 1] = '\0';
-   }
+      if (json_object_get_type(entry) != json_type_object) {
+         continue;
+      }
 
-   /* Parse position */
-   json_object_object_get_ex(element_obj, "dest_x", &tmpobj);
-   if (tmpobj != NULL) {
-      curr_element->dest_x = curr_element->dst_rect.x = json_object_get_int(tmpobj);
-   }
+      json_object_object_foreach(entry, key, value) {
+         const char *path = NULL;
+         const char *ext = NULL;
 
-   json_object_object_get_ex(element_obj, "dest_y", &tmpobj);
-   if (tmpobj != NULL) {
-      curr_element->dest_y = curr_element->dst_rect.y = json_object_get_int(tmpobj);
-   }
+         if (!is_asset_key(key) || (json_object_get_type(value) != json_type_string)) {
+            continue;
+         }
 
-   /* Parse angle */
-   json_object_object_get_ex(element_obj, "angle", &tmpobj);
-   if (tmpobj != NULL) {
-      if (json_object_get_type(tmpobj) == json_type_string) {
-         const char *angle_str = json_object_get_string(tmpobj);
-         if (strcmp(angle_str, "roll") == 0) {
-            curr_element->angle = ANGLE_ROLL;
-         } else if (strcmp(angle_str, "opposite roll") == 0) {
-            curr_element->angle = ANGLE_OPPOSITE_ROLL;
+         path = intern_path(image_path, json_object_get_string(value));
+         ext = strrchr(path, '.');
+         if ((ext != NULL) && (strcasecmp(ext, ".json") == 0)) {
+            /* Animations: load the sheet now and preload its image. */
+            sprite_sheet *sheet = load_sprite_sheet(path);
+            if (sheet != NULL) {
+               asset_list_add(list, sheet->image);
+            }
          } else {
-            LOG_WARNING("Error processing angle string: %s", angle_str);
+            asset_list_add(list, path);
          }
-      } else {
-         curr_element->angle = json_object_get_double(tmpobj);
       }
    }
+}
 
-   /* Parse fixed property if present */
-   if (json_object_object_get_ex(element_obj, "fixed", &tmpobj)) {
-      curr_element->fixed = json_object_get_int(tmpobj);
-   } else {
-      curr_element->fixed = FIXED_DEFAULT;
-   }
-
-   /* Parse layer */
-   json_object_object_get_ex(element_obj, "layer", &tmpobj);
-   if (tmpobj != NULL) {
-      curr_element->layer = json_object_get_int(tmpobj);
-   }
+/* Load every image the config references before any element is built. The
+ * decodes run in parallel and nothing stalls on disk once the HUD is up. */
+static void preload_config_assets(struct json_object *parsed_json)
+{
+   asset_list list = { NULL, 0, 0 };
+   struct json_object *section = NULL;
 
-   /* Parse enabled flag if present */
-   if (json_object_object_get_ex(element_obj, "enabled", &tmpobj)) {
-      curr_element->enabled = json_object_get_int(tmpobj);
-   }
+   asset_bundle_open(get_image_path());
 
-   /* Parse hotkey if present */
-   if (json_object_object_get_ex(element_obj, "hotkey", &tmpobj)) {
-      tmpstr_ptr = json_object_get_string(tmpobj);
-      if (tmpstr_ptr != NULL) {
-         strncpy(curr_element->hotkey, tmpstr_ptr, 2);
-      }
+   if (json_object_object_get_ex(parsed_json, "Elements", &section)) {
+      collect_section_assets(section, &list);
    }
-
-   /* Parse HUD associations */
-   json_object_object_get_ex(element_obj, "huds", &tmpobj);
-   if (tmpobj != NULL && json_object_get_type(tmpobj) == json_type_array) {
-      /* Clear HUD flags first */
-      memset(curr_element->hud_flags, 0, MAX_HUDS);
-
-      int hud_count = json_object_array_length(tmpobj);
-      for (int h = 0; h < hud_count; h++) {
-         struct json_object *hud_name_obj = json_object_array_get_idx(tmpobj, h);
-         const char *hud_name = json_object_get_string(hud_name_obj);
-
-         hud_screen *screen = find_hud_by_name(hud_name);
-         if (screen != NULL) {
-            curr_element->hud_flags[screen->hud_id] = 1;
-         } else {
-            LOG_WARNING("Unknown HUD '%s' in element definition", hud_name);
-         }
-      }
-   } else {
-      /* If no HUDs specified, add to the default (first) HUD */
-      hud_screen *default_hud = get_hud_manager()->screens;
-      if (default_hud != NULL) {
-         curr_element->hud_flags[default_hud->hud_id] = 1;
-      }
+   if (json_object_object_get_ex(parsed_json, "Components", &section)) {
+      collect_section_assets(section, &list);
    }
 
-   return SUCCESS;
+   preload_textures(list.paths, list.count);
+   free(list.paths);
 }
 
-/* Parse the primary json config file to configure the UI. */
-int parse_json_config(const char *filename)
+/* Apply a parsed config: globals, HUDs, elements, components and transitions. */
+static int apply_config_json(struct json_object *parsed_json)
 {
-   FILE *config_file = NULL;
-   struct json_object *parsed_json = NULL;
    struct json_object *tmpobj, *tmpobj2, *tmpobj3;
    struct json_object_iterator it;
    struct json_object_iterator itEnd;
@@ -543,13 +1727,6 @@ int parse_json_config(const char *filename)
    struct json_object_iterator itSubEnd;
    int array_length = 0;
    int i = 0;
-   double ratio = 0.0;
-
-   char tmpstr[1024];
-
-   char *config_string = NULL;
-   int string_size = 0;
-   int bytes_read = 0;
 
    element *default_element = get_default_element();
    element *intro_element = get_intro_element();
@@ -562,27 +1739,6 @@ int parse_json_config(const char *filename)
 
    const char *image_path = get_image_path();
 
-   config_file = fopen(filename, "r");
-   if (config_file == NULL) {
-      LOG_ERROR("Unable to open config file: %s", filename);
-      return FAILURE;
-   }
-
-   string_size = 0;
-   while ((bytes_read = fread(tmpstr, 1, 1024, config_file)) > 0) {
-      string_size += bytes_read;
-      config_string = realloc(config_string, string_size + 1);
-      if (string_size <= 1024) {
-         strncpy(config_string, tmpstr, bytes_read);
-      } else {
-         strncat(config_string, tmpstr, bytes_read);
-      }
-      config_string[string_size] = '\0';
-   }
-
-   fclose(config_file);
-
-   parsed_json = json_tokener_parse(config_string);
    if (parsed_json != NULL) {
       /* Main Loop */
       it = json_object_iter_begin(parsed_json);
@@ -615,6 +1771,103 @@ int parse_json_config(const char *filename)
                   this_hds->cam_crop_x = json_object_get_int(json_object_iter_peek_value(&itSub));
                } else if (strcmp(json_object_iter_peek_name(&itSub), "Camera Crop Width") == 0) {
                   this_hds->cam_crop_width = json_object_get_int(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Camera Crop At Source") == 0) {
+                  this_hds->cam_crop_at_source = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Camera Scale At Source") == 0) {
+                  this_hds->cam_scale_at_source = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Detect Frame Divisor") == 0) {
+                  this_hds->detect_frame_divisor = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->detect_frame_divisor < 1) {
+                     this_hds->detect_frame_divisor = 1;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Detect Max Objects") == 0) {
+                  this_hds->detect_top_k = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if ((this_hds->detect_top_k < 1) || (this_hds->detect_top_k > MAX_DETECT)) {
+                     LOG_WARNING("Detect Max Objects must be 1 to %d.", MAX_DETECT);
+                     this_hds->detect_top_k = (this_hds->detect_top_k < 1) ? 1 : MAX_DETECT;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Detect Min Confidence") == 0) {
+                  this_hds->detect_min_confidence = json_object_get_double(json_object_iter_peek_value(&itSub));
+                  if ((this_hds->detect_min_confidence < 0.0) || (this_hds->detect_min_confidence > 1.0)) {
+                     LOG_WARNING("Detect Min Confidence must be 0.0 to 1.0.");
+                     this_hds->detect_min_confidence = (this_hds->detect_min_confidence < 0.0) ? 0.0 : 1.0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "HUD Eye Layer") == 0) {
+                  this_hds->hud_eye_layer = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Idle Refresh MS") == 0) {
+                  this_hds->idle_refresh_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->idle_refresh_ms < 0) {
+                     this_hds->idle_refresh_ms = 0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Texture Cache MB") == 0) {
+                  this_hds->texture_cache_mb = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->texture_cache_mb < 0) {
+                     this_hds->texture_cache_mb = 0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Frame Pacing") == 0) {
+                  this_hds->frame_pacing = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Frame Pacing Margin MS") == 0) {
+                  this_hds->frame_pacing_margin_ms = json_object_get_double(json_object_iter_peek_value(&itSub));
+                  if (this_hds->frame_pacing_margin_ms < 0.0) {
+                     this_hds->frame_pacing_margin_ms = 0.0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Pose Prediction") == 0) {
+                  this_hds->pose_prediction = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Record Composite") == 0) {
+                  this_hds->record_composite = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Replay Seconds") == 0) {
+                  this_hds->replay_seconds = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->replay_seconds < 1) {
+                     this_hds->replay_seconds = DEFAULT_REPLAY_SECONDS;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Replay Max MB") == 0) {
+                  this_hds->replay_max_mb = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->replay_max_mb < 1) {
+                     this_hds->replay_max_mb = DEFAULT_REPLAY_MAX_MB;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Replay Post Seconds") == 0) {
+                  this_hds->replay_post_seconds = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->replay_post_seconds < 0) {
+                     this_hds->replay_post_seconds = 0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Map Cache Path") == 0) {
+                  snprintf(this_hds->map_cache_path, sizeof(this_hds->map_cache_path), "%s",
+                           json_object_get_string(json_object_iter_peek_value(&itSub)));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Map Cache MB") == 0) {
+                  this_hds->map_cache_mb = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->map_cache_mb < 0) {
+                     this_hds->map_cache_mb = 0;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Camera Profiles") == 0) {
+                  parse_camera_profiles(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Camera Profile") == 0) {
+                  snprintf(this_hds->cam_profile, sizeof(this_hds->cam_profile), "%s",
+                           json_object_get_string(json_object_iter_peek_value(&itSub)));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Performance Governor") == 0) {
+                  this_hds->governor = json_object_get_boolean(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Governor Temp High") == 0) {
+                  this_hds->governor_temp_high = json_object_get_double(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Governor Temp Low") == 0) {
+                  this_hds->governor_temp_low = json_object_get_double(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Governor Battery Low") == 0) {
+                  this_hds->governor_battery_low = json_object_get_double(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Serial Baud") == 0) {
+                  this_hds->serial_baud = json_object_get_int(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Sample WiFi Ms") == 0) {
+                  this_hds->sample_wifi_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
+                  if (this_hds->sample_wifi_ms <= 0) {
+                     LOG_WARNING("Sample WiFi Ms must be above 0, STAT carries no wifi level. Using %d.",
+                                 DEFAULT_SAMPLE_WIFI_MS);
+                     this_hds->sample_wifi_ms = DEFAULT_SAMPLE_WIFI_MS;
+                  }
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Sample CPU Ms") == 0) {
+                  this_hds->sample_cpu_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Sample Memory Ms") == 0) {
+                  this_hds->sample_memory_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Sample Thermal Ms") == 0) {
+                  this_hds->sample_thermal_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
+               } else if (strcmp(json_object_iter_peek_name(&itSub), "Sample Fan Ms") == 0) {
+                  this_hds->sample_fan_ms = json_object_get_int(json_object_iter_peek_value(&itSub));
                } else if (strcmp(json_object_iter_peek_name(&itSub), "Stereo Offset") == 0) {
                   this_hds->stereo_offset = json_object_get_int(json_object_iter_peek_value(&itSub));
                } else if (strcmp(json_object_iter_peek_name(&itSub), "Pitch Offset") == 0) {
@@ -698,6 +1951,9 @@ int parse_json_config(const char *filename)
 
          /* Elements Section Loop */
          if (strcmp(json_object_iter_peek_name(&it), "Elements") == 0) {
+            /* Global is done by now, so the image path is final. */
+            preload_config_assets(parsed_json);
+
             tmpobj = json_object_iter_peek_value(&it);
             if (json_object_get_type(tmpobj) == json_type_array) {
                array_length = json_object_array_length(tmpobj);
@@ -707,12 +1963,12 @@ int parse_json_config(const char *filename)
 
                   /* Special case for intro type. */
                   if ((tmpobj3 != NULL) && (strcmp("intro", json_object_get_string(tmpobj3)) == 0)) {
+                     release_animation(&intro_element->this_anim);
                      memcpy(intro_element, default_element, sizeof(element));
                      intro_element->enabled = 1;
 
                      json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                     snprintf(intro_element->filename, MAX_FILENAME_LENGTH * 2,
-                              "%s/%s", image_path, json_object_get_string(tmpobj3));
+                     intro_element->filename = intern_path(image_path, json_object_get_string(tmpobj3));
 
                      json_object_object_get_ex(tmpobj2, "dest_x", &tmpobj3);
                      intro_element->dest_x = json_object_get_int(tmpobj3);
@@ -729,546 +1985,15 @@ int parse_json_config(const char *filename)
                         intro_element->angle = json_object_get_double(tmpobj3);
                      }
 
-                     parse_animated_json(intro_element);
+                     if (parse_animated_json(intro_element) != SUCCESS) {
+                        intro_element->enabled = 0;
+                     }
                   } else if (tmpobj3 != NULL) {
-                     const char *element_type = json_object_get_string(tmpobj3);
-
-                     curr_element = malloc(sizeof(element));
+                     curr_element = parse_element_json(tmpobj2, json_object_get_string(tmpobj3));
                      if (curr_element == NULL) {
-                        LOG_ERROR("Cannot malloc new element!");
-                        exit(1);
-                     }
-                     memcpy(curr_element, default_element, sizeof(element));
-                     curr_element->enabled = 1;
-
-                     /* STATIC */
-                     if (strcmp("static", element_type) == 0) {
-                        curr_element->type = STATIC;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse static-specific properties */
-                        json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                        snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->width = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->height = json_object_get_int(tmpobj3);
-                        }
-
-                        /* Load texture */
-                        curr_element->texture = get_cached_texture(curr_element->filename);
-                        if (!curr_element->texture) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        /* Set up destination rectangle */
-                        if ((curr_element->width == 0) && (curr_element->height == 0)) {
-                           SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                           &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                        } else if ((curr_element->width == 0) && (curr_element->height != 0)) {
-                           SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                           &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                           ratio = (double) curr_element->height / (double) curr_element->dst_rect.h;
-                           curr_element->dst_rect.w = curr_element->width =
-                                                     curr_element->dst_rect.w * ratio;
-                        } else if ((curr_element->width != 0) && (curr_element->height == 0)) {
-                           SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                           &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                           ratio = (double) curr_element->width / (double) curr_element->dst_rect.w;
-                           curr_element->dst_rect.h = curr_element->height =
-                                                     curr_element->dst_rect.h * ratio;
-                        } else {
-                           curr_element->dst_rect.w = curr_element->width;
-                           curr_element->dst_rect.h = curr_element->height;
-                        }
-                     /* Record Graphic */
-                     } else if (strcmp("record-ui", element_type) == 0) {
-                        curr_element->type = STATIC;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse record-ui specific properties */
-                        json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                        snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        json_object_object_get_ex(tmpobj2, "file_r", &tmpobj3);
-                        snprintf(curr_element->filename_r, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        json_object_object_get_ex(tmpobj2, "file_s", &tmpobj3);
-                        snprintf(curr_element->filename_s, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        json_object_object_get_ex(tmpobj2, "file_rs", &tmpobj3);
-                        snprintf(curr_element->filename_rs, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        /* Load textures */
-                        curr_element->texture = get_cached_texture(curr_element->filename);
-                        if (!curr_element->texture) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_r = get_cached_texture(curr_element->filename_r);
-                        if (!curr_element->texture_r) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_r,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_s = get_cached_texture(curr_element->filename_s);
-                        if (!curr_element->texture_s) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_s,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_rs = get_cached_texture(curr_element->filename_rs);
-                        if (!curr_element->texture_rs) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_rs,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                       &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                     /* AI Status Graphic */
-                     } else if (strcmp("ai-ui", element_type) == 0) {
-                        curr_element->type = STATIC;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse ai-ui specific properties */
-                        json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                        snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        /* AI Listening */
-                        json_object_object_get_ex(tmpobj2, "file_l", &tmpobj3);
-                        snprintf(curr_element->filename_l, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        /* AI Heard Wakeword */
-                        json_object_object_get_ex(tmpobj2, "file_w", &tmpobj3);
-                        snprintf(curr_element->filename_w, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        /* AI Processing */
-                        json_object_object_get_ex(tmpobj2, "file_p", &tmpobj3);
-                        snprintf(curr_element->filename_p, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        /* Load textures */
-                        curr_element->texture = get_cached_texture(curr_element->filename);
-                        if (!curr_element->texture) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_l = get_cached_texture(curr_element->filename_l);
-                        if (!curr_element->texture_l) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_l,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_w = get_cached_texture(curr_element->filename_w);
-                        if (!curr_element->texture_w) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_w,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        curr_element->texture_p = get_cached_texture(curr_element->filename_p);
-                        if (!curr_element->texture_p) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->filename_p,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-
-                        SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                       &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                     /* ANIMATED */
-                     } else if (strcmp("animated", element_type) == 0) {
-                        curr_element->type = ANIMATED;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse animated-specific properties */
-                        json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                        snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                 "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                        json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->width = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->height = json_object_get_int(tmpobj3);
-                        }
-
-                        /* Parse animation data */
-                        parse_animated_json(curr_element);
-
-                        /* Load texture */
-                        curr_element->texture = get_cached_texture(curr_element->this_anim.image);
-                        if (!curr_element->texture) {
-                           SDL_Log("Couldn't load %s: %s\n", curr_element->this_anim.image,
-                                   SDL_GetError());
-                           json_object_put(parsed_json);
-                           free(config_string);
-                           return FAILURE;
-                        }
-                     /* TEXT */
-                     } else if (strcmp("text", element_type) == 0) {
-                        curr_element->type = TEXT;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse text-specific properties */
-                        json_object_object_get_ex(tmpobj2, "string", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           strncpy(curr_element->text, json_object_get_string(tmpobj3),
-                                   MAX_TEXT_LENGTH);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "font", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           snprintf(curr_element->font, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", get_font_path(), json_object_get_string(tmpobj3));
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "color", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           strncpy(tmpstr, json_object_get_string(tmpobj3), 1024);
-                           parse_color(tmpstr, &curr_element->font_color.r,
-                                       &curr_element->font_color.g, &curr_element->font_color.b,
-                                       &curr_element->font_color.a);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "size", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->font_size = json_object_get_int(tmpobj3);
-                        }
-
-                        if ((strcmp(curr_element->font, "") != 0) && (curr_element->font_size > 0)) {
-                           curr_element->ttf_font =
-                               get_local_font(curr_element->font, curr_element->font_size);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "halign", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           strncpy(curr_element->halign, json_object_get_string(tmpobj3), 7);
-                        }
-
-                        /* These are currently just for the *LOG* text. */
-                        // Parse width if present
-                        json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                            curr_element->width = json_object_get_int(tmpobj3);
-                        }
-
-                        // Parse height if present
-                        json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->height = json_object_get_int(tmpobj3);
-                        }
-                     /* SPECIAL */
-                     } else if (strcmp("special", element_type) == 0) {
-                        curr_element->type = SPECIAL;
-
-                        /* Parse common properties */
-                        parse_common_element_properties(tmpobj2, curr_element);
-
-                        /* Parse special-specific properties */
-                        json_object_object_get_ex(tmpobj2, "name", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           strncpy(curr_element->special_name, json_object_get_string(tmpobj3),
-                                   MAX_TEXT_LENGTH - 1);
-                           curr_element->special_name[MAX_TEXT_LENGTH - 1] = '\0';
-                           strncpy(curr_element->name, json_object_get_string(tmpobj3), MAX_TEXT_LENGTH - 1);
-                           curr_element->name[MAX_TEXT_LENGTH - 1] = '\0';
-
-                           if (strncmp(curr_element->special_name, "detect", 6) == 0) {
-                              set_detect_enabled(1);
-                           }
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "file", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "width", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->width = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "height", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->height = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "download_count", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->download_count = json_object_get_int(tmpobj3);
-                        }
-
-                        /* Font properties for special elements that need text rendering */
-                        json_object_object_get_ex(tmpobj2, "font", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           snprintf(curr_element->font, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", get_font_path(), json_object_get_string(tmpobj3));
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "color", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           strncpy(tmpstr, json_object_get_string(tmpobj3), 1024);
-                           parse_color(tmpstr, &curr_element->font_color.r,
-                                       &curr_element->font_color.g, &curr_element->font_color.b,
-                                       &curr_element->font_color.a);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "size", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->font_size = json_object_get_int(tmpobj3);
-                        }
-
-                        if ((strcmp(curr_element->font, "") != 0) && (curr_element->font_size > 0)) {
-                           curr_element->ttf_font =
-                               get_local_font(curr_element->font, curr_element->font_size);
-                        }
-
-                        /* Special offset properties */
-                        json_object_object_get_ex(tmpobj2, "center_x_offset", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->center_x_offset = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "center_y_offset", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->center_y_offset = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "text_x_offset", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->text_x_offset = json_object_get_int(tmpobj3);
-                        }
-
-                        json_object_object_get_ex(tmpobj2, "text_y_offset", &tmpobj3);
-                        if (tmpobj3 != NULL) {
-                           curr_element->text_y_offset = json_object_get_int(tmpobj3);
-                        }
-
-                        /* Handle animations for special elements like heading, pitch, etc. */
-                        if ((strcmp("heading", curr_element->special_name) == 0) ||
-                            (strcmp("pitch", curr_element->special_name) == 0) ||
-                            (strcmp("altitude", curr_element->special_name) == 0) ||
-                            (strcmp("wifi", curr_element->special_name) == 0) ||
-                            (strcmp("detect", curr_element->special_name) == 0)) {
-
-                           parse_animated_json(curr_element);
-
-                           if (strcmp("detect", curr_element->special_name) != 0) {
-                              curr_element->texture = get_cached_texture(curr_element->this_anim.image);
-                              if (!curr_element->texture) {
-                                 SDL_Log("Couldn't load %s: %s\n",
-                                         curr_element->filename, SDL_GetError());
-                                 json_object_put(parsed_json);
-                                 free(config_string);
-                                 return FAILURE;
-                              }
-                           }
-                        }
-
-                        /* Map elements, parse map-specific properties */
-                        if (strcmp("map", curr_element->special_name) == 0) {
-                           // Parse maptype
-                           json_object_object_get_ex(tmpobj2, "maptype", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              const char *maptype_str = json_object_get_string(tmpobj3);
-
-                              // Convert string to enum
-                              for (int i = 0; i < MAP_TYPE_COUNT; i++) {
-                                 if (strcmp(maptype_str, MAP_TYPE_STRINGS[i]) == 0) {
-                                    curr_element->map_type = (map_type_t)i;
-                                    break;
-                                 }
-                              }
-                           }
-
-                           // Parse zoom_level
-                           json_object_object_get_ex(tmpobj2, "zoom", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->map_zoom = json_object_get_int(tmpobj3);
-                           }
-
-                           // Parse update_interval
-                           json_object_object_get_ex(tmpobj2, "update_interval", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->update_interval_sec = json_object_get_int(tmpobj3);
-                           }
-
-                           /* If we're parsing a config file, we should immediately refesh. */
-                           curr_element->force_refresh = 1;
-                        }
-
-                        /* Battery display elements */
-                        if (strcmp("battery", curr_element->special_name) == 0) {
-                           /* We're reusing filenames and textures here. No reason for new ones. */
-                           json_object_object_get_ex(tmpobj2, "file_100", &tmpobj3);
-                           snprintf(curr_element->filename, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                           json_object_object_get_ex(tmpobj2, "file_75", &tmpobj3);
-                           snprintf(curr_element->filename_base, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                           json_object_object_get_ex(tmpobj2, "file_50", &tmpobj3);
-                           snprintf(curr_element->filename_online, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                           json_object_object_get_ex(tmpobj2, "file_25", &tmpobj3);
-                           snprintf(curr_element->filename_warning, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                           json_object_object_get_ex(tmpobj2, "file_0", &tmpobj3);
-                           snprintf(curr_element->filename_offline, MAX_FILENAME_LENGTH * 2,
-                                    "%s/%s", image_path, json_object_get_string(tmpobj3));
-
-                           /* Load textures */
-                           curr_element->texture = get_cached_texture(curr_element->filename);
-                           if (!curr_element->texture) {
-                              SDL_Log("Couldn't load %s: %s\n", curr_element->filename,
-                                      SDL_GetError());
-                              json_object_put(parsed_json);
-                              free(config_string);
-                              return FAILURE;
-                           }
-
-                           curr_element->texture_base = get_cached_texture(curr_element->filename_base);
-                           if (!curr_element->texture_base) {
-                              SDL_Log("Couldn't load %s: %s\n", curr_element->filename_base,
-                                      SDL_GetError());
-                              json_object_put(parsed_json);
-                              free(config_string);
-                              return FAILURE;
-                           }
-
-                           curr_element->texture_online = get_cached_texture(curr_element->filename_online);
-                           if (!curr_element->texture_online) {
-                              SDL_Log("Couldn't load %s: %s\n", curr_element->filename_online,
-                                      SDL_GetError());
-                              json_object_put(parsed_json);
-                              free(config_string);
-                              return FAILURE;
-                           }
-
-                           curr_element->texture_warning = get_cached_texture(curr_element->filename_warning);
-                           if (!curr_element->texture_warning) {
-                              SDL_Log("Couldn't load %s: %s\n", curr_element->filename_warning,
-                                      SDL_GetError());
-                              json_object_put(parsed_json);
-                              free(config_string);
-                              return FAILURE;
-                           }
-
-                           curr_element->texture_offline = get_cached_texture(curr_element->filename_offline);
-                           if (!curr_element->texture_offline) {
-                              SDL_Log("Couldn't load %s: %s\n", curr_element->filename_offline,
-                                      SDL_GetError());
-                              json_object_put(parsed_json);
-                              free(config_string);
-                              return FAILURE;
-                           }
-
-                           SDL_QueryTexture(curr_element->texture, NULL, NULL,
-                                            &curr_element->dst_rect.w, &curr_element->dst_rect.h);
-                        }
-
-                        /* Check if this is an armor display element */
-                        if (strcmp("armor_display", curr_element->special_name) == 0) {
-                           json_object_object_get_ex(tmpobj2, "notice_x", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->notice_x = json_object_get_int(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "notice_y", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->notice_y = json_object_get_int(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "notice_width", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->notice_width = json_object_get_int(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "notice_height", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->notice_height = json_object_get_int(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "notice_timeout", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->notice_timeout = json_object_get_int(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "show_metrics", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->show_metrics = json_object_get_boolean(tmpobj3);
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "metrics_font", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              snprintf(curr_element->metrics_font, MAX_FILENAME_LENGTH * 2,
-                                       "%s/%s", get_font_path(), json_object_get_string(tmpobj3));
-                           }
-
-                           json_object_object_get_ex(tmpobj2, "metrics_font_size", &tmpobj3);
-                           if (tmpobj3 != NULL) {
-                              curr_element->metrics_font_size = json_object_get_int(tmpobj3);
-                           }
-                        }
+                        return FAILURE;
                      }
+                     curr_element->config_hash = config_object_hash(tmpobj2);
 
                      /* Add the element to the element list */
                      insert_element_by_layer(curr_element);
@@ -1303,29 +2028,23 @@ int parse_json_config(const char *filename)
                   tmpobj2 = json_object_array_get_idx(tmpobj, i);
 
                   json_object_object_get_ex(tmpobj2, "name", &tmpobj3);
-                  strncpy(curr_element->name, json_object_get_string(tmpobj3),
-                          MAX_TEXT_LENGTH);
+                  curr_element->name = intern_string(json_object_get_string(tmpobj3));
 
                   json_object_object_get_ex(tmpobj2, "device", &tmpobj3);
-                  strncpy(curr_element->mqtt_device, json_object_get_string(tmpobj3),
-                          MAX_TEXT_LENGTH);
+                  curr_element->mqtt_device = intern_string(json_object_get_string(tmpobj3));
 
 
                   json_object_object_get_ex(tmpobj2, "base file", &tmpobj3);
-                  snprintf(curr_element->filename_base, MAX_FILENAME_LENGTH * 2,
-                           "%s/%s", image_path, json_object_get_string(tmpobj3));
+                  curr_element->filename_base = intern_path(image_path, json_object_get_string(tmpobj3));
 
                   json_object_object_get_ex(tmpobj2, "online file", &tmpobj3);
-                  snprintf(curr_element->filename_online, MAX_FILENAME_LENGTH * 2,
-                           "%s/%s", image_path, json_object_get_string(tmpobj3));
+                  curr_element->filename_online = intern_path(image_path, json_object_get_string(tmpobj3));
 
                   json_object_object_get_ex(tmpobj2, "warning file", &tmpobj3);
-                  snprintf(curr_element->filename_warning, MAX_FILENAME_LENGTH * 2,
-                           "%s/%s", image_path, json_object_get_string(tmpobj3));
+                  curr_element->filename_warning = intern_path(image_path, json_object_get_string(tmpobj3));
 
                   json_object_object_get_ex(tmpobj2, "offline file", &tmpobj3);
-                  snprintf(curr_element->filename_offline, MAX_FILENAME_LENGTH * 2,
-                           "%s/%s", image_path, json_object_get_string(tmpobj3));
+                  curr_element->filename_offline = intern_path(image_path, json_object_get_string(tmpobj3));
 
                   if (json_object_object_get_ex(tmpobj2, "warning temp", &tmpobj3)) {
                      curr_element->warning_temp = json_object_get_double(tmpobj3);
@@ -1369,39 +2088,31 @@ int parse_json_config(const char *filename)
                      }
                   }
 
-                  curr_element->texture_base = get_cached_texture(curr_element->filename_base);
+                  curr_element->texture_base = acquire_element_texture(curr_element, ELEMENT_TEXTURE_BASE);
                   if (!curr_element->texture_base) {
                      LOG_ERROR("Couldn't load %s: %s\n",
                              curr_element->filename, SDL_GetError());
-                     json_object_put(parsed_json);
-                     free(config_string);
                      return FAILURE;
                   }
 
-                  curr_element->texture_online = get_cached_texture(curr_element->filename_online);
+                  curr_element->texture_online = acquire_element_texture(curr_element, ELEMENT_TEXTURE_ONLINE);
                   if (!curr_element->texture_online) {
                      LOG_ERROR("Couldn't load %s: %s\n",
                              curr_element->filename_online, SDL_GetError());
-                     json_object_put(parsed_json);
-                     free(config_string);
                      return FAILURE;
                   }
 
-                  curr_element->texture_warning = get_cached_texture(curr_element->filename_warning);
+                  curr_element->texture_warning = acquire_element_texture(curr_element, ELEMENT_TEXTURE_WARNING);
                   if (!curr_element->texture_warning) {
                      LOG_ERROR("Couldn't load %s: %s\n",
                              curr_element->filename_warning, SDL_GetError());
-                     json_object_put(parsed_json);
-                     free(config_string);
                      return FAILURE;
                   }
 
-                  curr_element->texture_offline = get_cached_texture(curr_element->filename_offline);
+                  curr_element->texture_offline = acquire_element_texture(curr_element, ELEMENT_TEXTURE_OFFLINE);
                   if (!curr_element->texture_offline) {
                      LOG_ERROR("Couldn't load %s: %s\n",
                              curr_element->filename_offline, SDL_GetError());
-                     json_object_put(parsed_json);
-                     free(config_string);
                      return FAILURE;
                   }
 
@@ -1444,9 +2155,35 @@ int parse_json_config(const char *filename)
       }
    }
 
-   json_object_put(parsed_json);
-   free(config_string);
+   /* Layout changed, precompute the per-HUD draw lists now rather than on the first frame. */
+   update_hud_draw_lists();
+
+   /* All assets are cached now, pack them so element draws can be batched. */
+   build_texture_atlas();
+   hud_mark_damaged();
+
+   /* Components and armor_display are final, index them by device. */
+   armor_registry_rebuild();
 
    return SUCCESS;
 }
 
+/* Parse the primary json config file to configure the UI. */
+int parse_json_config(const char *filename)
+{
+   struct json_object *parsed_json = NULL;
+   char *config_string = read_config_file(filename);
+   int rc = FAILURE;
+
+   if (config_string == NULL) {
+      return FAILURE;
+   }
+
+   parsed_json = json_tokener_parse(config_string);
+   free(config_string);
+
+   rc = apply_config_json(parsed_json);
+   json_object_put(parsed_json);
+
+   return rc;
+}
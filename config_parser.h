@@ -22,6 +22,8 @@
 #ifndef CONFIG_PARSER_H
 #define CONFIG_PARSER_H
 
+#include <stdint.h>
+
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
@@ -34,39 +36,47 @@ typedef enum {
    WARN_OVER_VOLT = 0x2
 } armor_warning_t;
 
-/* A single frame in an animaion. */
+/* A single frame in an animaion. Sheet coordinates fit easily in a short. */
 typedef struct _frame {
-   int source_x;
-   int source_y;
-   int source_w;
-   int source_h;
+   short source_x;
+   short source_y;
+   short source_w;
+   short source_h;
 
-   int rotated;
-   int trimmed;
+   short dest_x;
+   short dest_y;
 
-   int dest_x;
-   int dest_y;
+   short source_size_w;
+   short source_size_h;
 
-   int source_size_w;
-   int source_size_h;
-
-   struct _frame *next;
+   unsigned char rotated;
+   unsigned char trimmed;
 } frame;
 
-#define MAX_FRAMES 1024                /* Maximum number of animation frames per animation. */
+/* Frames of one sprite sheet. Parsed once per animation JSON and shared,
+ * read only, by every element that uses it. */
+typedef struct _sprite_sheet {
+   const char *filename;          /* The animation JSON, interned, the lookup key. */
+   const char *image;                        /* Interned path of the sheet image. */
+   char format[12];
 
-/* Animation Object */
-typedef struct _anim {
-   frame *first_frame;
-   frame *current_frame;
+   frame *frames;                            /* frame_count frames, in file order. */
    int frame_count;
+   int refcount;                             /* Elements using this sheet. */
 
-   unsigned int last_update;
+   struct _sprite_sheet *next;
+} sprite_sheet;
 
-   frame *frame_lookup[MAX_FRAMES];
+/* Animation Object. Per element playback state over a shared sheet. */
+typedef struct _anim {
+   const sprite_sheet *sheet;
+   const frame *frames;                      /* sheet->frames, or NULL if not loaded. */
+   int frame_count;
 
-   char image[MAX_FILENAME_LENGTH];
-   char format[12];
+   int cursor;                               /* Index of current_frame. */
+   const frame *current_frame;
+
+   unsigned int last_update;
 } anim;
 
 /* Types of UI Elements */
@@ -91,12 +101,89 @@ typedef enum {
 /* Map type string representations - declare as extern */
 extern const char* MAP_TYPE_STRINGS[];
 
-/* Parent data type for all UI elements. Not all fields are used for all types. */
+/* Dynamic text tokens. A text element's string is resolved to one of these
+ * once at parse time so rendering doesn't compare strings every frame. */
+typedef enum {
+   TEXT_TOKEN_NONE = 0,   /* Plain text, rendered as is. */
+   TEXT_TOKEN_FPS,
+   TEXT_TOKEN_DATETIME,
+   TEXT_TOKEN_GPSTIME,
+   TEXT_TOKEN_SYSTIME,
+   TEXT_TOKEN_AINAME,
+   TEXT_TOKEN_CPU,
+   TEXT_TOKEN_SYSTEM_TEMP,
+   TEXT_TOKEN_SYSTEM_TEMP_F,
+   TEXT_TOKEN_MEM,
+   TEXT_TOKEN_HELMTEMP,
+   TEXT_TOKEN_HELMTEMP_F,
+   TEXT_TOKEN_HELMHUM,
+   TEXT_TOKEN_AIRQUALITY,
+   TEXT_TOKEN_AIRQUALITYDESC,
+   TEXT_TOKEN_TVOC,
+   TEXT_TOKEN_ECO2,
+   TEXT_TOKEN_CO2,
+   TEXT_TOKEN_CO2QUALITY,
+   TEXT_TOKEN_CO2ECO2DIFF,
+   TEXT_TOKEN_CO2SOURCEANALYSIS,
+   TEXT_TOKEN_HEATINDEX_C,
+   TEXT_TOKEN_DEWPOINT,
+   TEXT_TOKEN_FAN,
+   TEXT_TOKEN_BATTERY_LEVEL,
+   TEXT_TOKEN_BATTERY_STATUS,
+   TEXT_TOKEN_BATTERY_STATUS_REASON,
+   TEXT_TOKEN_BATTERY_CELLS_CONFIG,
+   TEXT_TOKEN_BATTERY_FAULT_COUNT,
+   TEXT_TOKEN_BATTERY_CRITICAL_FAULTS,
+   TEXT_TOKEN_BATTERY_WARNING_FAULTS,
+   TEXT_TOKEN_BATTERY_INFO_FAULTS,
+   TEXT_TOKEN_BATTERY_ALL_FAULTS,
+   TEXT_TOKEN_BATTERY_TIME,
+   TEXT_TOKEN_BATTERY_TIME_MIN,
+   TEXT_TOKEN_BATTERY_VOLTAGE,
+   TEXT_TOKEN_BATTERY_CURRENT,
+   TEXT_TOKEN_BATTERY_POWER,
+   TEXT_TOKEN_BATTERY_TEMP,
+   TEXT_TOKEN_BATTERY_CHEMISTRY,
+   TEXT_TOKEN_BATTERY_CAPACITY,
+   TEXT_TOKEN_BATTERY_CELLS,
+   TEXT_TOKEN_LATLON,
+   TEXT_TOKEN_PITCH,
+   TEXT_TOKEN_COMPASS,
+   TEXT_TOKEN_LOG,
+   TEXT_TOKEN_ALERT,
+   TEXT_TOKEN_PERF_TOP,
+   TEXT_TOKEN_COUNT       /* Always keep last to get count */
+} text_token_t;
+
+/* Token strings indexed by text_token_t, TEXT_TOKEN_NONE is "". */
+extern const char* TEXT_TOKEN_STRINGS[];
+
+/* Files an element took a texture cache reference for, bits of
+ * element.cached_textures. The texture fields themselves get swapped and
+ * aliased at runtime, so references are given back by file. */
+typedef enum {
+   ELEMENT_TEXTURE_FILE     = 1 << 0,    /* filename */
+   ELEMENT_TEXTURE_R        = 1 << 1,    /* filename_r */
+   ELEMENT_TEXTURE_S        = 1 << 2,    /* filename_s */
+   ELEMENT_TEXTURE_RS       = 1 << 3,    /* filename_rs */
+   ELEMENT_TEXTURE_L        = 1 << 4,    /* filename_l */
+   ELEMENT_TEXTURE_W        = 1 << 5,    /* filename_w */
+   ELEMENT_TEXTURE_P        = 1 << 6,    /* filename_p */
+   ELEMENT_TEXTURE_BASE     = 1 << 7,    /* filename_base */
+   ELEMENT_TEXTURE_ONLINE   = 1 << 8,    /* filename_online */
+   ELEMENT_TEXTURE_WARNING  = 1 << 9,    /* filename_warning */
+   ELEMENT_TEXTURE_OFFLINE  = 1 << 10,   /* filename_offline */
+   ELEMENT_TEXTURE_SHEET    = 1 << 11,   /* this_anim.sheet->image */
+   ELEMENT_TEXTURE_ALL      = (1 << 12) - 1
+} element_texture_ref;
+
+/* Parent data type for all UI elements. Not all fields are used for all types.
+ * Config strings are interned and shared, so an element stays a few hundred bytes. */
 typedef struct _element {
    element_t type;
    int enabled;
 
-   char name[MAX_TEXT_LENGTH];
+   const char *name;                 /* Interned, like every config string here. */
    /**
     * Bitmap of HUD memberships.
     * Each bit in this array represents membership in a specific HUD.
@@ -108,23 +195,25 @@ typedef struct _element {
    char hotkey[2];   /* Hotkey to enable/disable element */
 
    /* Static and animated graphics */
-   char filename[MAX_FILENAME_LENGTH * 2];      /* Regular filename to graphic. */
-   char filename_r[MAX_FILENAME_LENGTH * 2];    /* Recording filename to graphic. */
-   char filename_s[MAX_FILENAME_LENGTH * 2];    /* Streaming filename to graphic. */
-   char filename_rs[MAX_FILENAME_LENGTH * 2];   /* Recording and streaming to graphic. */
-   char filename_l[MAX_FILENAME_LENGTH * 2];    /* AI listening filename graphic. */
-   char filename_w[MAX_FILENAME_LENGTH * 2];    /* AI wakework filename graphic. */
-   char filename_p[MAX_FILENAME_LENGTH * 2];    /* AI processing filename graphic. */
-
-   char filename_base[MAX_FILENAME_LENGTH * 2];      /* Filename of base armor graphic. */
-   char filename_online[MAX_FILENAME_LENGTH * 2];    /* Filename of online armor graphic. */
-   char filename_warning[MAX_FILENAME_LENGTH * 2];   /* Filename of warning armor graphic. */
-   char filename_offline[MAX_FILENAME_LENGTH * 2];   /* Filename of offline armor graphic. */
+   const char *filename;          /* Regular filename to graphic. */
+   const char *filename_r;        /* Recording filename to graphic. */
+   const char *filename_s;        /* Streaming filename to graphic. */
+   const char *filename_rs;       /* Recording and streaming to graphic. */
+   const char *filename_l;        /* AI listening filename graphic. */
+   const char *filename_w;        /* AI wakework filename graphic. */
+   const char *filename_p;        /* AI processing filename graphic. */
+
+   const char *filename_base;     /* Filename of base armor graphic. */
+   const char *filename_online;   /* Filename of online armor graphic. */
+   const char *filename_warning;  /* Filename of warning armor graphic. */
+   const char *filename_offline;  /* Filename of offline armor graphic. */
 
    /* Text elements */
-   char text[MAX_TEXT_LENGTH];
-   char last_rendered_text[MAX_TEXT_LENGTH];
-   char font[MAX_FILENAME_LENGTH * 2];
+   const char *text;
+   text_token_t text_token;      /* Resolved from text when the config is parsed. */
+   char *last_rendered_text;     /* MAX_TEXT_LENGTH buffer, allocated on first render. */
+   unsigned int log_generation;  /* *LOG* console: log generation it last drew. */
+   const char *font;
    SDL_Color font_color;
    TTF_Font *ttf_font;
    int font_size;
@@ -154,10 +243,12 @@ typedef struct _element {
    SDL_Texture *texture_warning;
    SDL_Texture *texture_offline;
 
+   unsigned int cached_textures;  /* element_texture_ref bits this element holds a reference for. */
+
    SDL_Rect dst_rect;
 
-   char special_name[MAX_TEXT_LENGTH];
-   char mqtt_device[MAX_TEXT_LENGTH];
+   const char *special_name;
+   const char *mqtt_device;
    int mqtt_registered;
    time_t mqtt_last_time;
 
@@ -198,7 +289,7 @@ typedef struct _element {
    int notice_height;
    int notice_timeout;
    int show_metrics;
-   char metrics_font[MAX_FILENAME_LENGTH * 2];
+   const char *metrics_font;
    int metrics_font_size;
 
    /* Metrics texture caching */
@@ -213,6 +304,13 @@ typedef struct _element {
    int in_transition;
    float scale;
 
+   uint64_t config_hash;            /* Hash of the element's config entry, for reload diffs. */
+
+   /* Render profiler counters for the current window, see render_profiler.h. */
+   unsigned long profile_ns;
+   unsigned long profile_max_ns;
+   unsigned int profile_calls;
+
    struct _element *prev;
    struct _element *next;
 } element;
@@ -222,12 +320,12 @@ typedef struct _element {
  *
  * This function monitors the configuration file's modification time and automatically
  * reloads the UI layout when changes are detected. The check is performed at regular
- * intervals defined by the config_check_interval. If the file has been modified since
- * the last check, it will attempt to reload the configuration while preserving the
- * current HUD state and providing appropriate user feedback via the alert system.
+ * intervals defined by the config_check_interval. The initial load happens right away;
+ * later changes are read and parsed on a worker thread and applied by
+ * apply_pending_config() so the render loop never waits on file I/O or JSON parsing.
  *
  * @param config_filename Path to the configuration file to monitor
- * @return SUCCESS if no reload was needed or reload was successful, FAILURE on error
+ * @return SUCCESS if no reload was needed or reload was started/successful, FAILURE on error
  */
 int check_and_reload_config(const char *config_filename);
 
@@ -245,8 +343,40 @@ int check_and_reload_config(const char *config_filename);
  */
 int reload_config(const char *config_filename);
 
+/**
+ * @brief Applies a config parsed in the background, if one is ready. Render thread only.
+ *
+ * When only regular elements changed, elements are matched to the new config by
+ * content hash: unchanged ones stay live with their textures and state, removed
+ * ones are freed and new ones are built. Any other change does a full reload.
+ * Call once per frame, it's cheap when nothing is pending.
+ *
+ * @return SUCCESS if nothing was pending or the reload applied, FAILURE otherwise
+ */
+int apply_pending_config(void);
+
 // Function prototypes for parsing functions
+
+/**
+ * @brief Attaches the element's animation JSON (curr_element->filename) to its anim.
+ *
+ * Sheets are cached by filename, so elements sharing an animation parse it once.
+ *
+ * @return SUCCESS, or FAILURE if the file couldn't be read or has no frames.
+ */
 int parse_animated_json(element * curr_element);
+
+/**
+ * @brief Detaches an anim from its sheet, freeing the sheet when nothing else uses it.
+ */
+void release_animation(anim *this_anim);
+
+/**
+ * @brief Steps an anim to its next frame, wrapping to the first.
+ *
+ * @return 1 if the step wrapped back to the first frame, 0 otherwise.
+ */
+int advance_animation(anim *this_anim);
 int parse_color(char *string, unsigned char *r, unsigned char *g, unsigned char *b,
                 unsigned char *a);
 int parse_json_config(const char *filename);
@@ -19,19 +19,54 @@
  * part of the project and are adopted by the project author(s).
  */
 
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <utime.h>
 
 #include <curl/curl.h>
 
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_image.h"
 
+#include "config_manager.h"
+#include "config_parser.h"
 #include "curl_download.h"
+#include "defines.h"
+#include "hud_manager.h"
 #include "logging.h"
 #include "mirage.h"
+#include "secrets.h"
+
+#define METERS_PER_DEGREE  111320.0
+#define METERS_PER_KNOT    0.514444
+
+/* One file in the disk cache, for eviction. */
+typedef struct {
+   char name[256];
+   off_t size;
+   time_t mtime;
+} map_cache_file;
+
+/* Set by the download thread when it starts. */
+static char map_cache_dir[MAX_FILENAME_LENGTH];
+
+/* One cell of the map grid. Identifies a cached map image. */
+typedef struct {
+   int valid;
+   long qlat;
+   long qlon;
+   int map_type;
+   int zoom;
+   int width;
+   int height;
+} map_tile;
 
 /**
  * Callback function for curl to write received data
@@ -47,8 +82,8 @@ static size_t write_data(void *contents, size_t size, size_t nmemb, void *userp)
    struct curl_data *mem = (struct curl_data *)userp;
    char *ptr;
 
-   /* No need for mutex here as this is called by curl_easy_perform
-    * which is already protected by mutex in the calling function */
+   /* No need for mutex here, the download buffer is only used by the
+    * download thread. */
 
    ptr = realloc(mem->data, mem->size + realsize + 1);
    if (!ptr) {
@@ -64,16 +99,324 @@ static size_t write_data(void *contents, size_t size, size_t nmemb, void *userp)
    return realsize;
 }
 
+/* World size in pixels at this zoom, the span both grid axes are cut from. */
+static double map_world_px(int zoom)
+{
+   return 256.0 * (double) (1L << zoom);
+}
+
+/* Mercator y in world pixels, 0 at the north edge. Latitude pixels stretch
+ * towards the poles, so the latitude grid is cut in this space rather than
+ * in degrees. */
+static double map_lat_to_px(double lat, int zoom)
+{
+   double rad;
+
+   /* Mercator stops short of the poles, clamp so the grid index stays finite. */
+   if (lat > MAP_MERCATOR_MAX_LAT) {
+      lat = MAP_MERCATOR_MAX_LAT;
+   } else if (lat < -MAP_MERCATOR_MAX_LAT) {
+      lat = -MAP_MERCATOR_MAX_LAT;
+   }
+   rad = lat * M_PI / 180.0;
+
+   return (1.0 - log(tan(rad) + 1.0 / cos(rad)) / M_PI) / 2.0 * map_world_px(zoom);
+}
+
+static double map_px_to_lat(double px, int zoom)
+{
+   return atan(sinh(M_PI * (1.0 - 2.0 * px / map_world_px(zoom)))) * 180.0 / M_PI;
+}
+
+/* Snaps a position to the grid for this zoom. A grid step is MAP_QUANT_PX
+ * pixels on each axis at this zoom, so the marker is never far from center. */
+static void map_tile_for(const struct curl_data *req, double lat, double lon, map_tile *tile)
+{
+   double lon_step = 360.0 * MAP_QUANT_PX / map_world_px(req->zoom);
+
+   tile->valid = 1;
+   tile->qlat = (long) floor(map_lat_to_px(lat, req->zoom) / MAP_QUANT_PX);
+   tile->qlon = (long) floor(lon / lon_step);
+   tile->map_type = req->map_type;
+   tile->zoom = req->zoom;
+   tile->width = req->width;
+   tile->height = req->height;
+}
+
+static int map_tile_equal(const map_tile *a, const map_tile *b)
+{
+   return a->valid && b->valid && (a->qlat == b->qlat) && (a->qlon == b->qlon) &&
+          (a->map_type == b->map_type) && (a->zoom == b->zoom) &&
+          (a->width == b->width) && (a->height == b->height);
+}
+
+static void map_tile_path(const map_tile *tile, char *path, size_t size)
+{
+   snprintf(path, size, "%s/%s_z%d_%dx%d_%ld_%ld.png", map_cache_dir,
+            MAP_TYPE_STRINGS[tile->map_type], tile->zoom, tile->width, tile->height,
+            tile->qlat, tile->qlon);
+}
+
+static void map_tile_url(const map_tile *tile, char *url, size_t size)
+{
+   double lon_step = 360.0 * MAP_QUANT_PX / map_world_px(tile->zoom);
+   double lat = map_px_to_lat((tile->qlat + 0.5) * MAP_QUANT_PX, tile->zoom);
+   double lon = (tile->qlon + 0.5) * lon_step;
+
+   snprintf(url, size, GOOGLE_MAPS_API, lat, lon, tile->width, tile->height,
+            MAP_TYPE_STRINGS[tile->map_type], tile->zoom, lat, lon, GOOGLE_API_KEY);
+}
+
+/* Picks the cache directory: the configured one, else the per-user cache. */
+static void map_cache_resolve(void)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   const char *xdg = getenv("XDG_CACHE_HOME");
+   const char *home = getenv("HOME");
+
+   if (this_hds->map_cache_path[0] != '\0') {
+      snprintf(map_cache_dir, sizeof(map_cache_dir), "%s", this_hds->map_cache_path);
+   } else if ((xdg != NULL) && (xdg[0] == '/')) {
+      snprintf(map_cache_dir, sizeof(map_cache_dir), "%s/%s", xdg, MAP_CACHE_SUBDIR);
+   } else if ((home != NULL) && (home[0] != '\0')) {
+      snprintf(map_cache_dir, sizeof(map_cache_dir), "%s/.cache/%s", home, MAP_CACHE_SUBDIR);
+   } else {
+      snprintf(map_cache_dir, sizeof(map_cache_dir), "%s", MAP_CACHE_DIR);
+   }
+
+   /* Trailing slashes would double up in the tile paths. */
+   for (size_t len = strlen(map_cache_dir); (len > 1) && (map_cache_dir[len - 1] == '/'); len--) {
+      map_cache_dir[len - 1] = '\0';
+   }
+}
+
+/* mkdir -p for the cache directory. */
+static int map_cache_mkdir(void)
+{
+   char path[MAX_FILENAME_LENGTH];
+
+   snprintf(path, sizeof(path), "%s", map_cache_dir);
+   for (char *p = path + 1; ; p++) {
+      if ((*p == '/') || (*p == '\0')) {
+         char saved = *p;
+
+         *p = '\0';
+         if ((mkdir(path, 0755) != 0) && (errno != EEXIST)) {
+            LOG_WARNING("Unable to create map cache directory %s: %s", path, strerror(errno));
+            return FAILURE;
+         }
+         *p = saved;
+         if (saved == '\0') {
+            break;
+         }
+      }
+   }
+
+   return SUCCESS;
+}
+
+static int compare_cache_age(const void *a, const void *b)
+{
+   const map_cache_file *fa = a;
+   const map_cache_file *fb = b;
+
+   return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+/* Evicts the least recently used images until the cache fits its budget.
+ * Using a cached image bumps its mtime, so mtime order is use order. */
+static void map_cache_trim(void)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   off_t budget = (off_t) this_hds->map_cache_mb * 1024 * 1024;
+   off_t total = 0;
+   map_cache_file *files = NULL;
+   size_t count = 0, capacity = 0;
+   struct dirent *entry = NULL;
+   DIR *dir = NULL;
+   int removed = 0;
+
+   if (budget <= 0) {
+      return;
+   }
+
+   dir = opendir(map_cache_dir);
+   if (dir == NULL) {
+      return;
+   }
+
+   while ((entry = readdir(dir)) != NULL) {
+      char path[MAX_FILENAME_LENGTH + 256];
+      size_t len = strlen(entry->d_name);
+      struct stat st;
+
+      if ((len < 5) || (strcmp(entry->d_name + len - 4, ".png") != 0)) {
+         continue;
+      }
+      snprintf(path, sizeof(path), "%s/%s", map_cache_dir, entry->d_name);
+      if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode)) {
+         continue;
+      }
+
+      if (count == capacity) {
+         map_cache_file *grown = NULL;
+
+         capacity = capacity ? capacity * 2 : 256;
+         grown = realloc(files, capacity * sizeof(map_cache_file));
+         if (grown == NULL) {
+            LOG_ERROR("Out of memory scanning the map cache.");
+            break;
+         }
+         files = grown;
+      }
+      snprintf(files[count].name, sizeof(files[count].name), "%s", entry->d_name);
+      files[count].size = st.st_size;
+      files[count].mtime = st.st_mtime;
+      count++;
+      total += st.st_size;
+   }
+   closedir(dir);
+
+   if (total > budget) {
+      qsort(files, count, sizeof(map_cache_file), compare_cache_age);
+      for (size_t i = 0; (i < count) && (total > budget); i++) {
+         char path[MAX_FILENAME_LENGTH + 256];
+
+         snprintf(path, sizeof(path), "%s/%s", map_cache_dir, files[i].name);
+         if (unlink(path) == 0) {
+            total -= files[i].size;
+            removed++;
+         }
+      }
+      LOG_INFO("Map cache trimmed: %d images evicted, %ld KB kept.", removed, (long) (total / 1024));
+   }
+
+   free(files);
+}
+
+/* Downloads a tile into this_data->data and writes it to the disk cache. */
+static int download_tile(CURL *curl_handle, struct curl_data *this_data, const map_tile *tile)
+{
+   char url[512];
+   char path[MAX_FILENAME_LENGTH];
+   char tmp_path[MAX_FILENAME_LENGTH + 8];
+   FILE *fp = NULL;
+   CURLcode res;
+
+   this_data->size = 0;
+   free(this_data->data);
+   this_data->data = NULL;
+
+   map_tile_url(tile, url, sizeof(url));
+
+   /* Set up curl options */
+   curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+   curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_data);
+   curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, this_data);
+   curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1L);
+   curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 30L);
+
+   /* Perform the request */
+   res = curl_easy_perform(curl_handle);
+   if ((res != CURLE_OK) || (this_data->data == NULL) || (this_data->size == 0)) {
+      LOG_WARNING("Map download failed: %s", curl_easy_strerror(res));
+      return FAILURE;
+   }
+
+   /* Write to a temp file and rename so a partial file is never cached. */
+   map_tile_path(tile, path, sizeof(path));
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+   fp = fopen(tmp_path, "wb");
+   if (fp != NULL) {
+      if ((fwrite(this_data->data, 1, this_data->size, fp) != this_data->size) ||
+          (fclose(fp) != 0) || (rename(tmp_path, path) != 0)) {
+         LOG_WARNING("Unable to write map cache file: %s", path);
+         unlink(tmp_path);
+      } else {
+         map_cache_trim();
+      }
+   }
+
+   return SUCCESS;
+}
+
+/* Decodes a map and hands it to the render thread. */
+static int deliver_surface(struct curl_data *this_data, SDL_Surface *decoded)
+{
+   SDL_Surface *surface = NULL;
+
+   if (decoded == NULL) {
+      LOG_ERROR("Unable to decode map image: %s", SDL_GetError());
+      return FAILURE;
+   }
+
+   /* Convert here so the upload on the render thread is a straight copy. */
+   surface = SDL_ConvertSurfaceFormat(decoded, SDL_PIXELFORMAT_ARGB8888, 0);
+   SDL_FreeSurface(decoded);
+   if (surface == NULL) {
+      LOG_ERROR("Unable to convert map image: %s", SDL_GetError());
+      return FAILURE;
+   }
+
+   pthread_mutex_lock(&this_data->mutex);
+   if (this_data->surface != NULL) {
+      SDL_FreeSurface(this_data->surface);
+   }
+   this_data->surface = surface;
+   this_data->updated = 1;
+   pthread_mutex_unlock(&this_data->mutex);
+
+   hud_mark_damaged();
+
+   return SUCCESS;
+}
+
+/* Picks the first uncached tile ahead of us along the GPS heading. */
+static int next_prefetch_tile(const struct curl_data *req, const map_tile *current,
+                              map_tile *tile)
+{
+   double meters = req->speed_knots * METERS_PER_KNOT * MAP_PREFETCH_SEC;
+   double heading = req->heading * M_PI / 180.0;
+   double cos_lat = cos(req->lat * M_PI / 180.0);
+   char path[MAX_FILENAME_LENGTH];
+
+   if ((req->speed_knots < MAP_PREFETCH_MIN_KNOTS) || (cos_lat < 0.01)) {
+      return 0;
+   }
+
+   for (int i = 1; i <= MAP_PREFETCH_STEPS; i++) {
+      double d = meters * i / MAP_PREFETCH_STEPS;
+      double lat = req->lat + (d * cos(heading)) / METERS_PER_DEGREE;
+      double lon = req->lon + (d * sin(heading)) / (METERS_PER_DEGREE * cos_lat);
+
+      map_tile_for(req, lat, lon, tile);
+      if (map_tile_equal(tile, current)) {
+         continue;
+      }
+
+      map_tile_path(tile, path, sizeof(path));
+      if (access(path, R_OK) != 0) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
 /**
- * Thread function for downloading map images at regular intervals
+ * Thread function for downloading map images
  */
 void *image_download_thread(void *arg) {
    struct curl_data *this_data = (struct curl_data *)arg;
+   struct curl_data req;
    CURL *curl_handle;
-   CURLcode res;
-   time_t last_update = 0;
+   time_t last_download = 0;
    time_t current_time;
    int downloads = 0;
+   map_tile shown = { 0 };
+   map_tile wanted = { 0 };
+   map_tile ahead = { 0 };
+   char path[MAX_FILENAME_LENGTH];
 
    /* Initialize curl */
    curl_handle = curl_easy_init();
@@ -82,65 +425,73 @@ void *image_download_thread(void *arg) {
       return NULL;
    }
 
-   while (!checkShutdown()) {
-      time(&current_time);
+   map_cache_resolve();
+   if (map_cache_mkdir() == SUCCESS) {
+      LOG_INFO("Map cache: %s", map_cache_dir);
+   }
 
-      int should_refresh = 0;
+   while (!checkShutdown()) {
+      int force = 0;
+      int can_download = 0;
 
-      /* Check if it's time for an update or if a refresh is forced */
+      /* Take a copy of the requested view */
       pthread_mutex_lock(&this_data->mutex);
-      should_refresh = (difftime(current_time, last_update) >= this_data->update_interval_sec) ||
-                       this_data->force_refresh;
-
-      if (this_data->force_refresh) {
-         this_data->force_refresh = 0;  // Reset the flag
-      }
+      req.lat = this_data->lat;
+      req.lon = this_data->lon;
+      req.heading = this_data->heading;
+      req.speed_knots = this_data->speed_knots;
+      req.width = this_data->width;
+      req.height = this_data->height;
+      req.map_type = this_data->map_type;
+      req.zoom = this_data->zoom;
+      force = this_data->force_refresh;
+      this_data->force_refresh = 0;
       pthread_mutex_unlock(&this_data->mutex);
 
-      /* Check if it's time for an update */
-      if (should_refresh) {
-         LOG_INFO("image_download_thread should_refresh received.");
-
-         /* Lock the mutex before modifying shared data */
-         pthread_mutex_lock(&this_data->mutex);
+      if ((req.width <= 0) || (req.height <= 0) || (req.zoom < 0) || (req.zoom > 30) ||
+          (req.map_type < 0) || (req.map_type >= MAP_TYPE_COUNT)) {
+         sleep(1);
+         continue;
+      }
 
-         /* Reset variables for new download */
-         this_data->size = 0;
-         if (this_data->data) {
-            free(this_data->data);
-            this_data->data = NULL;
-         }
+      time(&current_time);
+      can_download = ((this_data->download_count <= 0) || (downloads < this_data->download_count)) &&
+                     (force || (difftime(current_time, last_download) >= this_data->update_interval_sec));
 
-         pthread_mutex_unlock(&this_data->mutex);
+      map_tile_for(&req, req.lat, req.lon, &wanted);
 
-         if ((this_data->download_count > 0) && (this_data->download_count - downloads <= 0)) {
-            /* We've downloaded all we need to. This thread is being monitored though, so just sleep for a
-             * while and then continue.
-             */
-            LOG_INFO("Download limit reached.");
-            sleep(60);
-            continue;
+      if (force || !map_tile_equal(&wanted, &shown)) {
+         /* Moved to a new cell. Prefer the disk cache unless forced. */
+         map_tile_path(&wanted, path, sizeof(path));
+         if (!force && (access(path, R_OK) == 0) &&
+             (deliver_surface(this_data, IMG_Load(path)) == SUCCESS)) {
+            LOG_INFO("Map loaded from cache: %s", path);
+            utime(path, NULL);   /* Mark it recently used for eviction. */
+            shown = wanted;
+         } else if (can_download) {
+            LOG_INFO("Downloading map for new position.");
+            last_download = current_time;
+            if (download_tile(curl_handle, this_data, &wanted) == SUCCESS) {
+               LOG_INFO("Downloaded new map data, %zu bytes", this_data->size);
+               downloads++;
+               if (deliver_surface(this_data,
+                                   IMG_Load_RW(SDL_RWFromConstMem(this_data->data, this_data->size), 1))
+                   == SUCCESS) {
+                  shown = wanted;
+               }
+            }
+         } else if (force) {
+            /* Keep it pending until we're allowed to download. */
+            pthread_mutex_lock(&this_data->mutex);
+            this_data->force_refresh = 1;
+            pthread_mutex_unlock(&this_data->mutex);
          }
-
-         /* Set up curl options */
-         curl_easy_setopt(curl_handle, CURLOPT_URL, this_data->url);
-         curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_data);
-         curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, this_data);
-         curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1L);
-         curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 30L);
-
-         /* Perform the request */
-         res = curl_easy_perform(curl_handle);
-
-         /* Lock mutex again for post-download updates */
-         pthread_mutex_lock(&this_data->mutex);
-         if (res == CURLE_OK && this_data->data && this_data->size > 0) {
-            this_data->updated = 1;
-            time(&last_update);
-            LOG_INFO("Downloaded new map data, %zu bytes", this_data->size);
+      } else if (can_download && next_prefetch_tile(&req, &shown, &ahead)) {
+         LOG_INFO("Prefetching map ahead of heading %.0f.", req.heading);
+         last_download = current_time;
+         if (download_tile(curl_handle, this_data, &ahead) == SUCCESS) {
             downloads++;
          }
-         pthread_mutex_unlock(&this_data->mutex);
       }
 
       /* Sleep a bit to avoid CPU spin */
@@ -158,8 +509,12 @@ void *image_download_thread(void *arg) {
       this_data->data = NULL;
    }
    this_data->size = 0;
+   if (this_data->surface != NULL) {
+      SDL_FreeSurface(this_data->surface);
+      this_data->surface = NULL;
+   }
+   this_data->updated = 0;
    pthread_mutex_unlock(&this_data->mutex);
 
    return NULL;
 }
-
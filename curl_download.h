@@ -22,15 +22,36 @@
 #ifndef CURL_DOWNLOAD_H
 #define CURL_DOWNLOAD_H
 
-/* Curl Image Download Data */
+#include <pthread.h>
+
+#include "SDL2/SDL.h"
+
+/* Curl Image Download Data
+ *
+ * The render thread only fills in the requested view and picks up decoded
+ * surfaces. Building the URL, the disk cache, downloading and decoding all
+ * happen in image_download_thread().
+ */
 struct curl_data {
-   char url[512];
-   int update_interval_sec;
+   /* Requested view, written by the render thread */
+   double lat;
+   double lon;
+   double heading;      // Degrees true, used to pick tiles to prefetch
+   double speed_knots;
+   int width;
+   int height;
+   int map_type;        // Index into MAP_TYPE_STRINGS
+   int zoom;
+
+   int update_interval_sec;   // Minimum seconds between network downloads
    int download_count;  // Set to 0 for infinite
    int updated;         // Flag set when new data is available, cleared when consumed
-   int force_refresh;   // Flag to force an immediate refresh
+   int force_refresh;   // Flag to force an immediate refresh, bypassing the disk cache
+
+   /* Decoded map, owned by whoever holds it. Set with updated. */
+   SDL_Surface *surface;
 
-   /* curl download area */
+   /* curl download area, only touched by the download thread */
    size_t size;
    char *data;
 
@@ -39,13 +60,17 @@ struct curl_data {
 };
 
 /**
- * Thread function for downloading map images at regular intervals
+ * Thread function for downloading map images
  *
- * This function runs in a separate thread and periodically downloads
- * map images from the URL specified in the curl_data struct. It stores
- * the raw data and sets the 'updated' flag when new data is available.
+ * This function runs in a separate thread and follows the view requested in
+ * the curl_data struct. Positions are quantized to a grid so small moves reuse
+ * the same image. Each grid image is kept on disk in the map cache directory,
+ * so only images we've never seen are downloaded. The cache is held to
+ * "Map Cache MB" by evicting the least recently used images. When moving, images ahead along the
+ * GPS heading are prefetched into the disk cache. New images are decoded here
+ * and handed over in 'surface' with the 'updated' flag set.
  *
- * @param arg Pointer to a struct curl_data with URL and other parameters
+ * @param arg Pointer to a struct curl_data with the view and other parameters
  * @return NULL when thread exits
  */
 void *image_download_thread(void *arg);
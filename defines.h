@@ -27,6 +27,7 @@
 //#define ENCODE_TIMING
 //#define DISPLAY_TIMING
 //#define OD_PROPER_WAIT
+#define OD_STEREO_BATCH    /* One network for both eyes with async double buffered uploads. */
 //#define FPS_STATS
 #define REFRESH_SYNC
 //#define ORIGINAL_RATIO
@@ -172,14 +173,37 @@
 // Default port for TCP socket helmet communications
 #define HELMET_PORT  3000
 
+/* Latency instrumentation */
+#define MQTT_LATENCY_TOPIC          "latency"   /* Where the per-stage latency histograms go. */
+#define LATENCY_REPORT_INTERVAL_MS  10000       /* How often they're published. */
+#define LATENCY_REPORT_LENGTH       2048
+
+#define MQTT_STREAM_TOPIC           "stream"    /* Adaptive streaming decisions. */
+
 #define SUCCESS 0
 #define FAILURE 1
 
 #define MAX_HUDS 16  /* Maximum number of HUDs supported */
-#define MAX_DETECT 4 /* Max number of auto-detected objects on the screen. */
+#define MAX_DETECT 32 /* Capacity for auto-detected objects. The config picks how many are kept. */
+#define DEFAULT_DETECT_TOP_K 4              /* Most confident objects kept per eye. */
+#define DEFAULT_DETECT_MIN_CONFIDENCE 0.5   /* Detections below this are ignored. */
+#define DETECT_EPIPOLAR_TOL 0.15   /* Max vertical offset between eyes, as a fraction of box height. */
+#define DETECT_MAX_DISPARITY 0.25  /* Max horizontal offset between eyes, as a fraction of frame width. */
+#define DEFAULT_DETECT_FRAME_DIVISOR 3 /* Detect on every Nth camera frame, the tracker fills in between. */
+
+#define DEFAULT_IDLE_REFRESH_MS 250  /* No camera mode still redraws this often with no damage. */
+#define HUD_IDLE_WAIT_MS        10   /* An idle loop waits this long for input before checking again. */
+#define DEFAULT_TEXTURE_CACHE_MB 0   /* VRAM budget for cached textures. 0 never evicts. */
+#define DEFAULT_FRAME_PACING_MARGIN_MS 2.0  /* Headroom left before vsync when pacing frames. */
+
+#define CAMERA_PROFILE_NAME_LENGTH     32
+#define DEFAULT_GOVERNOR_TEMP_HIGH     80.0  /* Degrees C. Step down at or above this. */
+#define DEFAULT_GOVERNOR_TEMP_LOW      70.0  /* Degrees C. Step back up at or below this. */
+#define DEFAULT_GOVERNOR_BATTERY_LOW   20.0  /* Percent. Step down at or below this. */
 
 #define MAX_FILENAME_LENGTH      1024  /* Generic max filename supported. */
 #define MAX_SERIAL_BUFFER_LENGTH 4096  /* Size of the serial buffer. */
+#define DEFAULT_SERIAL_BAUD      115200 /* Helmet serial link rate. */
 #define MAX_WIFI_DEV_LENGTH      10    /* Max length for a wifi device name. */
 
 /* These setup local log buffering from USB input. */
@@ -191,6 +215,7 @@
 #define IMAGE_PATH_DEFAULT    "ui_assets/mk2/"
 #define FONT_PATH_DEFAULT     "ui_assets/fonts/"
 #define SOUND_PATH_DEFAULT    "sound_assets/"
+#define ASSET_BUNDLE_FILENAME "assets.bundle"  /* Optional prebaked assets, in the image path. */
 
 #define DEFAULT_WIFI_DEV_NAME "wlP1p1s0"
 
@@ -212,10 +237,18 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
 #define GOOGLE_MAPS_API       "https://maps.googleapis.com/maps/api/staticmap?center=%f,%f&size=%dx%d&format=png32&" \
                               "maptype=%s&zoom=%d&markers=size:mid%%7Ccolor:red%%7C%f,%f&key=%s"
 #define GOOGLE_APIKEY_FILE    "googleapi.key"      /* Where do we store our Google API key? */
-#define MAP_UPDATE_SEC        30                   /* Fixed map update interval. */
+#define MAP_UPDATE_SEC        30                   /* Minimum seconds between map downloads. */
                                                    /* TODO: Make these available in the config file. */
-
-#define NUM_AUDIO_THREADS     8                    /* Number of simul audio threads. */
+#define MAP_CACHE_SUBDIR      "mirage/maps"        /* Map image cache, under $XDG_CACHE_HOME or ~/.cache. */
+#define MAP_CACHE_DIR         "map_cache"          /* Fallback cache directory when $HOME isn't set. */
+#define DEFAULT_MAP_CACHE_MB  64                   /* Disk budget for the map cache. 0 never evicts. */
+#define MAP_QUANT_PX          32                   /* Map centers snap to a grid this many pixels apart. */
+#define MAP_MERCATOR_MAX_LAT  85.05112878          /* Web Mercator latitude limit, in degrees. */
+#define MAP_PREFETCH_MIN_KNOTS 3.0                 /* Only prefetch ahead when moving faster than this. */
+#define MAP_PREFETCH_SEC      60                   /* How far ahead to prefetch, in seconds of travel. */
+#define MAP_PREFETCH_STEPS    3                    /* Points sampled along that path. */
+
+#define AUDIO_MAX_VOICES      8                    /* Number of sounds mixed at once. */
 //#define STARTUP_SOUND         "jarvis_service.ogg"
 
 #define USB_PORT              "/dev/ttyACM0"       /* Default USB port. */
@@ -223,20 +256,30 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
 #define FAN_RPM_FILE          "/sys/class/hwmon/hwmon3/rpm"
 #define FAN_MAX_RPM           6000
 
-/* Defines for sound server. */
-#define SERVER_QUEUE_NAME   "/stark-sound-server"
-#define QUEUE_PERMISSIONS 0660
-#define MAX_MESSAGES 10
-#define MAX_MSG_SIZE sizeof(audio_msg)
-#define MSG_BUFFER_SIZE MAX_MSG_SIZE + 10
+/* Local sampling rates. 0 leaves the metric to STAT messages. */
+#define DEFAULT_SAMPLE_WIFI_MS     1000
+#define DEFAULT_SAMPLE_CPU_MS      1000
+#define DEFAULT_SAMPLE_MEMORY_MS   2000
+#define DEFAULT_SAMPLE_THERMAL_MS  2000
+#define DEFAULT_SAMPLE_FAN_MS      0      /* FAN_RPM_FILE is board specific. */
 
 /* ALSA */
 #define PCM_DEVICE "default"
+#define AUDIO_MIX_RATE      48000   /* Every sound is converted to this at load. */
+#define AUDIO_LATENCY_US    20000   /* Requested output buffer, about 4 periods. */
 
 /* The colorspace of the output display. */
 #define RGB_OUT_SIZE 4
 #define PIXEL_FORMAT_OUT SDL_PIXELFORMAT_RGBA32
 
+/* Scale and convert recorded/streamed frames to NV12 on the GPU before readback.
+ * Falls back to RGBA if the shader can't be built. */
+#define RECORD_GPU_NV12
+
+/* Encoder side composition only reads back the HUD overlay, at reduced size and rate. */
+#define RECORD_OVERLAY_SCALE        2     /* Overlay is read back at window size / this. */
+#define RECORD_OVERLAY_FPS          15
+
 /* All of the Gstreamer pipelines. These should be defined per platform.
  *
  * Right now only NVIDIA is supported.
@@ -244,12 +287,18 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
  * FIXME: These are getting a bit out of hand, so I think I need to break these up into their components.
  *        After my latest work getting YouTube streaming working... it's worse. Sorry.
  */
-#define GSTREAMER_PIPELINE_LENGTH   2048
+#define GSTREAMER_PIPELINE_LENGTH   4096
 #define DEFAULT_CSI_CAM1            0
 #define DEFAULT_CSI_CAM2            1
 #define DEFAULT_USB_CAM1            0
 #define DEFAULT_USB_CAM2            2
 
+/* Stereo capture and pairing */
+#define CAM_EYE_QUEUE_DEPTH         4     /* Frames buffered per eye before the oldest is dropped. */
+#define CAM_PAIR_TOLERANCE_DIV      2     /* L/R pair if PTS differ by <= frame duration / this. */
+#define CAM_HICCUP_FRAMES           3     /* Frame durations to wait on a stalled eye before
+                                           * reusing its last frame. */
+
 /*
  * GStreamer Pipeline Components
  * Organized by function for easier maintenance
@@ -257,40 +306,73 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
 
 /* === INPUT COMPONENTS === */
 // Common output pipeline portion
+#ifdef USE_NVMM_ZERO_COPY
+#ifndef PLATFORM_JETSON
+#error "USE_NVMM_ZERO_COPY is only supported on the Jetson platform."
+#endif
+// Frames stay in NVMM. The appsink hands us NvBufSurface handles, not pixels.
+// The %s after the caps is the record tee, or empty. See GST_CAM_PIPELINE_RECORD_TEE.
+#define GST_CAM_PIPELINE_OUTPUT \
+    "video/x-raw(memory:NVMM), width=(int)%d, height=(int)%d, format=(string)RGBA ! " \
+    "%s" \
+    "queue max-size-time=%lu leaky=2 ! " \
+    "appsink processing-deadline=0 name=sink%s " \
+    "caps=\"video/x-raw(memory:NVMM),format=RGBA,pixel-aspect-ratio=1/1\""
+#else
 #define GST_CAM_PIPELINE_OUTPUT \
-    "video/x-raw, format=(string)RGBA ! " \
+    "video/x-raw, width=(int)%d, height=(int)%d, format=(string)RGBA ! " \
+    "%s" \
     "queue max-size-time=%lu leaky=2 ! " \
     "appsink processing-deadline=0 name=sink%s " \
     "caps=\"video/x-raw,format=RGBA,pixel-aspect-ratio=1/1\""
+#endif
+
+/* Encoder side composition ("Record Composite"). Each camera is teed into an
+ * intervideosink the recording pipeline reads from, so camera pixels never go
+ * through the GL readback. The valve stays shut unless a composite recording
+ * is running. Args: suffix, suffix, conversion, suffix, suffix. The conversion
+ * crops to what's displayed and, for NVMM, copies out to system memory. */
+#define GST_CAM_RECORD_CHANNEL      "mirage_cam"
+#define GST_CAM_PIPELINE_RECORD_TEE \
+    "tee name=rectee%s ! valve name=recvalve%s drop=true ! " \
+    "queue max-size-buffers=2 leaky=2 ! %s" \
+    "intervideosink channel=" GST_CAM_RECORD_CHANNEL "%s sync=false rectee%s. ! "
+#define GST_CAM_RECORD_TO_SYSTEM    "video/x-raw, format=(string)RGBA ! "
 
 #ifdef PLATFORM_JETSON
 // Input pipeline portions for CSI cameras
 #define GST_CAM_PIPELINE_CSI_INPUT \
     "nvarguscamerasrc exposurecompensation=0 tnr-mode=0 sensor_id=%d ! " \
-    "video/x-raw(memory:NVMM), width=%d, height=%d, format=(string)NV12, framerate=(fraction)%d/1 ! " \
-    "nvvidconv flip-method=0 ! "
+    "video/x-raw(memory:NVMM), width=%d, height=%d, format=(string)NV12, framerate=(fraction)%d/1 ! "
 
 // Input pipeline portions for USB cameras
 #define GST_CAM_PIPELINE_USB_INPUT \
     "v4l2src device=/dev/video%d ! " \
     "image/jpeg, width=%d, height=%d, framerate=%d/1, format=MJPG ! " \
-    "jpegdec ! nvvidconv ! "
+    "jpegdec ! "
+
+// Conversion, crop and scale. nvvidconv takes the crop as a rectangle (coordinates).
+#define GST_CAM_PIPELINE_CONVERT \
+    "nvvidconv flip-method=0 left=%d right=%d top=%d bottom=%d ! "
 #else
 // Input pipeline for Raspberry Pi Camera Module (CSI)
 #define GST_CAM_PIPELINE_CSI_INPUT \
     "libcamerasrc name=cam%d ! " \
-    "video/x-raw, width=%d, height=%d, framerate=(fraction)%d/1 ! " \
-    "videoconvert ! "
+    "video/x-raw, width=%d, height=%d, framerate=(fraction)%d/1 ! "
 
 // Input pipeline for USB cameras
 #define GST_CAM_PIPELINE_USB_INPUT \
     "v4l2src device=/dev/video%d ! " \
     "image/jpeg, width=%d, height=%d, framerate=%d/1, format=MJPG ! " \
-    "jpegdec ! videoconvert ! "
+    "jpegdec ! "
+
+// Conversion, crop and scale. videocrop takes the crop as margins from each edge.
+#define GST_CAM_PIPELINE_CONVERT \
+    "videocrop left=%d right=%d top=%d bottom=%d ! videoconvert ! videoscale ! "
 #endif
 
 #define GST_PIPE_INPUT      "appsrc name=srcEncode ! " \
-                           "video/x-raw, width=(int)%d, height=(int)%d, format=(string)RGBA, framerate=(fraction)%d/1 ! queue max-size-buffers=30 ! clocksync ! "
+                           "video/x-raw, width=(int)%d, height=(int)%d, format=(string)%s, framerate=(fraction)%d/1 ! queue max-size-buffers=30 ! clocksync ! "
 
 /* === VIDEO PROCESSING COMPONENTS === */
 #ifdef PLATFORM_JETSON
@@ -305,8 +387,10 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
         #define GST_PIPE_VIDEO_HLS     "nvvidconv ! video/x-raw, format=I420 ! " \
                                       "x264enc bitrate=8000 tune=zerolatency ! "
 
-        #define GST_PIPE_VIDEO_YOUTUBE "videoconvert ! video/x-raw, width=(int)%d, height=(int)%d, format=I420 ! " \
-                                      "x264enc bitrate=%d tune=zerolatency speed-preset=veryfast key-int-max=60 ! "
+        #define GST_PIPE_VIDEO_YOUTUBE "videorate name=streamrate drop-only=true ! videoconvert ! videoscale ! " \
+                                      "capsfilter name=streamcaps caps=\"video/x-raw, width=(int)%d, height=(int)%d, format=I420\" ! " \
+                                      "x264enc name=streamenc bitrate=%d tune=zerolatency speed-preset=veryfast key-int-max=60 ! "
+        #define STREAM_ENC_BITRATE_UNIT 1000   /* x264enc takes kbit/s. */
     #else
         /* Jetson hardware encoding paths */
         #define GST_PIPE_VIDEO_MAIN    "nvvidconv ! video/x-raw(memory:NVMM), format=NV12 ! " \
@@ -318,9 +402,9 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
         #define GST_PIPE_VIDEO_HLS     "nvvidconv ! video/x-raw(memory:NVMM), format=NV12 ! " \
                                       "nvv4l2h264enc bitrate=8000000 profile=2 preset-level=3 ! "
 
-        #define GST_PIPE_VIDEO_YOUTUBE "nvvidconv ! " \
-                                      "video/x-raw(memory:NVMM), width=(int)%d, height=(int)%d, format=NV12 ! " \
-                                      "nvv4l2h264enc bitrate=%d " \
+        #define GST_PIPE_VIDEO_YOUTUBE "videorate name=streamrate drop-only=true ! nvvidconv ! " \
+                                      "capsfilter name=streamcaps caps=\"video/x-raw(memory:NVMM), width=(int)%d, height=(int)%d, format=NV12\" ! " \
+                                      "nvv4l2h264enc name=streamenc bitrate=%d " \
                                       "control-rate=1 " \
                                       "preset-level=4 " \
                                       "profile=4 " \
@@ -332,6 +416,7 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
                                       "iframeinterval=60 " \
                                       "idrinterval=60 " \
                                       "vbv-size=8000000 ! "
+        #define STREAM_ENC_BITRATE_UNIT 1
 #endif
 #elif defined(PLATFORM_RPI)
     #ifdef SOFTWARE_ENCODE
@@ -345,8 +430,10 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
                                       "avenc_h264_omx bitrate=8000000 profile=100 ! "
         #define GST_PIPE_VIDEO_HLS     "videoconvert ! video/x-raw, format=I420 ! " \
                                       "avenc_h264_omx bitrate=8000000 profile=100 ! "
-        #define GST_PIPE_VIDEO_YOUTUBE "videoconvert ! video/x-raw, width=(int)%d, height=(int)%d, format=I420 ! " \
-                                      "avenc_h264_omx bitrate=%d profile=100 ! "
+        #define GST_PIPE_VIDEO_YOUTUBE "videorate name=streamrate drop-only=true ! videoconvert ! videoscale ! " \
+                                      "capsfilter name=streamcaps caps=\"video/x-raw, width=(int)%d, height=(int)%d, format=I420\" ! " \
+                                      "avenc_h264_omx name=streamenc bitrate=%d profile=100 ! "
+        #define STREAM_ENC_BITRATE_UNIT 1
     #endif
 #else
     /* Default to software encoding for other platforms */
@@ -359,8 +446,10 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
     #define GST_PIPE_VIDEO_HLS     "videoconvert ! video/x-raw, format=I420 ! " \
                                   "x264enc bitrate=8000 tune=zerolatency ! "
 
-    #define GST_PIPE_VIDEO_YOUTUBE "videoconvert ! video/x-raw, width=(int)%d, height=(int)%d, format=I420 ! " \
-                                  "x264enc bitrate=%d tune=zerolatency ! "
+    #define GST_PIPE_VIDEO_YOUTUBE "videorate name=streamrate drop-only=true ! videoconvert ! videoscale ! " \
+                                  "capsfilter name=streamcaps caps=\"video/x-raw, width=(int)%d, height=(int)%d, format=I420\" ! " \
+                                  "x264enc name=streamenc bitrate=%d tune=zerolatency ! "
+    #define STREAM_ENC_BITRATE_UNIT 1000   /* x264enc takes kbit/s. */
 #endif
 
 /* === PARSER COMPONENTS === */
@@ -391,7 +480,7 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
                                "playlist-location=/var/www/html/hls/playlist.m3u8"
 #define GST_PIPE_RTMP_OUT       "flvmux name=mux streamable=true latency=100000000 ! " \
                                "queue name=mux_queue max-size-buffers=50 max-size-time=0 max-size-bytes=0 ! " \
-                               "rtmpsink location='rtmp://a.rtmp.youtube.com/live2/%s live=1' sync=false async=false"
+                               "rtmpsink name=streamsink location='rtmp://a.rtmp.youtube.com/live2/%s live=1' sync=false async=false"
 
 /* === UTILITY COMPONENTS === */
 #define GST_PIPE_QUEUE          "queue ! mux."
@@ -434,7 +523,7 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
                                "filesink location=%s " \
                                "flvmux name=streammux streamable=true latency=100000000 ! " \
                                "queue name=rtmp_queue max-size-buffers=50 max-size-time=0 max-size-bytes=0 ! " \
-                               "rtmpsink location='rtmp://a.rtmp.youtube.com/live2/%s live=1' sync=false async=false"
+                               "rtmpsink name=streamsink location='rtmp://a.rtmp.youtube.com/live2/%s live=1' sync=false async=false"
 
 /* Streaming-only pipeline */
 #define GST_STR_PIPELINE        GST_PIPE_INPUT \
@@ -445,5 +534,80 @@ enum { ANGLE_ROLL = 1000, ANGLE_OPPOSITE_ROLL = 1001 };  /* For the roll indicat
                                GST_PIPE_AUDIO_YOUTUBE \
                                GST_PIPE_RTMP_OUT
 
+
+/* Instant replay. The encoder runs as for recording but ends in an appsink
+ * that fills the replay ring. SPS/PPS go with every keyframe so a clip can
+ * start at any of them. Args: width, height, format, fps. */
+#define GST_REPLAY_PIPELINE     GST_PIPE_INPUT \
+                               GST_PIPE_VIDEO_MAIN \
+                               "h264parse config-interval=-1 ! " \
+                               "video/x-h264, stream-format=(string)byte-stream, alignment=(string)au ! " \
+                               "appsink name=replaySink sync=false"
+
+/* Writes one replay clip from the ring. Args: filename. */
+#define GST_REPLAY_WRITE_PIPELINE "appsrc name=replaySrc ! " \
+                               GST_PIPE_PARSE \
+                               GST_PIPE_MUXER \
+                               GST_PIPE_FILE_OUT
+
+#define DEFAULT_REPLAY_SECONDS      30    /* Video kept in the replay ring. */
+#define DEFAULT_REPLAY_MAX_MB       64    /* Memory cap for the replay ring. */
+#define DEFAULT_REPLAY_POST_SECONDS 10    /* Video after the trigger added to a clip. */
+
+/* === ENCODER SIDE COMPOSITION === */
+/* The mixer takes the cameras on sink_0/sink_1 and the overlay on sink_2, each
+ * scaled by its pad. Args: eye width, eye height, eye width, eye width, eye
+ * height, window width, window height. */
+#ifdef PLATFORM_JETSON
+    #define GST_PIPE_COMP_MIXER    "nvcompositor name=comp " \
+                                  "sink_0::xpos=0 sink_0::ypos=0 sink_0::width=%d sink_0::height=%d " \
+                                  "sink_1::xpos=%d sink_1::ypos=0 sink_1::width=%d sink_1::height=%d " \
+                                  "sink_2::xpos=0 sink_2::ypos=0 sink_2::width=%d sink_2::height=%d sink_2::zorder=2 ! "
+    #define GST_PIPE_COMP_UPLOAD   "nvvidconv ! video/x-raw(memory:NVMM), format=(string)RGBA ! "
+#else
+    #define GST_PIPE_COMP_MIXER    "compositor name=comp background=black " \
+                                  "sink_0::xpos=0 sink_0::ypos=0 sink_0::width=%d sink_0::height=%d " \
+                                  "sink_1::xpos=%d sink_1::ypos=0 sink_1::width=%d sink_1::height=%d " \
+                                  "sink_2::xpos=0 sink_2::ypos=0 sink_2::width=%d sink_2::height=%d sink_2::zorder=2 ! "
+    #define GST_PIPE_COMP_UPLOAD   "videoconvert ! "
+#endif
+
+/* Args: left channel, fps, right channel, fps. */
+#define GST_PIPE_COMP_CAMERAS   " intervideosrc channel=%s do-timestamp=true ! " \
+                                "video/x-raw, framerate=(fraction)%d/1 ! queue max-size-buffers=2 leaky=2 ! " \
+                                GST_PIPE_COMP_UPLOAD "comp.sink_0 " \
+                                "intervideosrc channel=%s do-timestamp=true ! " \
+                                "video/x-raw, framerate=(fraction)%d/1 ! queue max-size-buffers=2 leaky=2 ! " \
+                                GST_PIPE_COMP_UPLOAD "comp.sink_1 "
+
+/* The straight alpha overlay read back from the HUD. Args: width, height, fps. */
+#define GST_PIPE_COMP_OVERLAY   "appsrc name=srcEncode ! " \
+                                "video/x-raw, width=(int)%d, height=(int)%d, format=(string)RGBA, framerate=(fraction)%d/1 ! " \
+                                "queue max-size-buffers=4 leaky=2 ! " \
+                                GST_PIPE_COMP_UPLOAD "comp.sink_2"
+
+/* Composite recording pipeline. Args: mixer, audio device, filename, cameras, overlay. */
+#define GST_COMP_ENC_PIPELINE   GST_PIPE_COMP_MIXER \
+                               GST_PIPE_VIDEO_MAIN \
+                               GST_PIPE_PARSE \
+                               GST_PIPE_QUEUE " " \
+                               GST_PIPE_AUDIO " " \
+                               GST_PIPE_MUXER \
+                               GST_PIPE_FILE_OUT \
+                               GST_PIPE_COMP_CAMERAS \
+                               GST_PIPE_COMP_OVERLAY
+
+/* Composite streaming pipeline. Args: mixer, stream w/h/bitrate, audio device,
+ * stream key, cameras, overlay. */
+#define GST_COMP_STR_PIPELINE   GST_PIPE_COMP_MIXER \
+                               GST_PIPE_INPUT_QUEUE_LEAKY \
+                               GST_PIPE_VIDEO_YOUTUBE \
+                               GST_PIPE_PARSE \
+                               GST_PIPE_QUEUE_VIDEO \
+                               GST_PIPE_AUDIO_YOUTUBE \
+                               GST_PIPE_RTMP_OUT \
+                               GST_PIPE_COMP_CAMERAS \
+                               GST_PIPE_COMP_OVERLAY
+
 #endif // DEFINES_H
 
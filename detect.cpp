@@ -9,6 +9,19 @@
 #endif
 #include "detect.h"
 
+static char class_names[DETECT_MAX_CLASSES][DETECT_CLASS_NAME_LEN];
+static int class_count = 0;
+
+/* Class name for a detection. Valid once any detector has been initialized. */
+const char *detect_class_desc(int class_id)
+{
+   if ((class_id < 0) || (class_id >= class_count)) {
+      return "";
+   }
+
+   return class_names[class_id];
+}
+
 /* Initialize detection struct. */
 int init_detect(detect_net * new_detect, int argc, char **argv, int width, int height)
 {
@@ -24,6 +37,14 @@ int init_detect(detect_net * new_detect, int argc, char **argv, int width, int h
    }
    new_detect->detectNet_net = (void *)net;
 
+   /* Every eye loads the same model, so one copy of the class names does. */
+   if (class_count == 0) {
+      for (uint32_t c = 0; (c < net->GetNumClasses()) && (c < DETECT_MAX_CLASSES); c++) {
+         snprintf(class_names[c], sizeof(class_names[c]), "%s", net->GetClassDesc(c));
+         class_count++;
+      }
+   }
+
    /* Allocate CUDA memory for object detection. */
    if (new_detect->d_image == NULL) {
       if (CUDA_FAILED(cudaMalloc(&new_detect->d_image, width * height * sizeof(uchar4)))) {
@@ -44,16 +65,60 @@ int init_detect(detect_net * new_detect, int argc, char **argv, int width, int h
 #endif
 }
 
+#ifdef USE_JETSON_INFERENCE
+/* Keep the top max_detections by confidence, best first. Insertion into a short
+ * sorted list, so cost stays linear in the raw detection count. */
+static int copy_detections(detectNet::Detection *detections, int numDetections,
+                           detect *my_detects, int max_detections, float min_confidence)
+{
+   int kept = 0;
+
+   if (max_detections <= 0) {
+      return 0;
+   }
+
+   for (int n = 0; n < numDetections; n++) {
+      int pos = 0;
+
+      if (detections[n].Confidence < min_confidence) {
+         continue;
+      }
+      if ((kept == max_detections) && (detections[n].Confidence <= my_detects[kept - 1].confidence)) {
+         continue;
+      }
+
+      pos = (kept < max_detections) ? kept++ : kept - 1;
+      while ((pos > 0) && (my_detects[pos - 1].confidence < detections[n].Confidence)) {
+         my_detects[pos] = my_detects[pos - 1];
+         pos--;
+      }
+
+      my_detects[pos].active = 1;
+      my_detects[pos].class_id = (short) detections[n].ClassID;
+      my_detects[pos].track_id = 0;
+      my_detects[pos].confidence = detections[n].Confidence;
+      my_detects[pos].left = detections[n].Left;
+      my_detects[pos].top = detections[n].Top;
+      my_detects[pos].width = detections[n].Width();
+      my_detects[pos].height = detections[n].Height();
+   }
+
+   for (int i = kept; i < max_detections; i++) {
+      my_detects[i].active = 0;
+   }
+
+   return kept;
+}
+#endif
+
 /* Detect objects in the given image. */
-/* max_detections allows us to limit the amount of detections displayed.
- * At this time it just takes the first ones. I'd like to sort by confidence
- * in the future to pick the best ones.
+/* Keeps the max_detections most confident objects at or above min_confidence,
+ * sorted best first.
  */
-int detect_image(detect_net * new_detect, void *image, detect * my_detects, int max_detections)
+int detect_image(detect_net * new_detect, void *image, detect * my_detects, int max_detections,
+                 float min_confidence)
 {
 #ifdef USE_JETSON_INFERENCE
-   int n = 0;
-   int a = 0;
    detectNet *net = (detectNet *) new_detect->detectNet_net;
    detectNet::Detection * detections = (detectNet::Detection *) new_detect->detections;
    int numDetections = 0;
@@ -73,27 +138,8 @@ int detect_image(detect_net * new_detect, void *image, detect * my_detects, int
    numDetections =
        net->Detect((uchar4 *) new_detect->d_image, new_detect->l_width, new_detect->l_height,
                    &detections, overlayFlags);
-   if (numDetections > 0) {
-      for (n = 0; n < numDetections; n++) {
-         /*printf("%d, %s(%d), %f\n",
-            n, net->GetClassDesc(detections[n].ClassID), detections[n].ClassID,
-            detections[n].Confidence); */
-
-         if (detections[n].Confidence > 0.50) {
-            my_detects[a].active = 1;
-            strncpy(my_detects[a].description, net->GetClassDesc(detections[n].ClassID), 255);
-            my_detects[a].confidence = detections[n].Confidence;
-            my_detects[a].left = detections[n].Left;
-            my_detects[a].top = detections[n].Top;
-            my_detects[a].width = detections[n].Width();
-            my_detects[a].height = detections[n].Height();
-            a++;
-            if (a >= max_detections)
-            {
-               break;
-            }
-         }
-      }
+   if (numDetections >= 0) {
+      copy_detections(detections, numDetections, my_detects, max_detections, min_confidence);
    }
    //cudaMemcpy(image, new_detect->d_image, new_detect->l_width * new_detect->l_height * sizeof(uchar4), cudaMemcpyDeviceToHost);
 
@@ -118,3 +164,158 @@ void free_detect(detect_net * new_detect)
    SAFE_DELETE(net);
 #endif
 }
+
+/* Initialize the stereo detector. One network serves both eyes. */
+int init_detect_stereo(detect_stereo *stereo, int argc, char **argv, int width, int height)
+{
+#ifdef USE_JETSON_INFERENCE
+   size_t frame_size = (size_t) width * height * sizeof(uchar4);
+   cudaStream_t copy_stream = NULL, infer_stream = NULL;
+
+   memset(stereo, 0, sizeof(detect_stereo));
+
+   if (init_detect(&stereo->net, argc, argv, width, height)) {
+      return 1;
+   }
+
+   /* The stereo path manages its own device frames. */
+   cudaFree(stereo->net.d_image);
+   stereo->net.d_image = NULL;
+
+   if (CUDA_FAILED(cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking)) ||
+       CUDA_FAILED(cudaStreamCreateWithFlags(&infer_stream, cudaStreamNonBlocking))) {
+      printf("Failed cudaStreamCreate()\n");
+      free_detect_stereo(stereo);
+      return 1;
+   }
+   stereo->copy_stream = (void *) copy_stream;
+   stereo->infer_stream = (void *) infer_stream;
+   ((detectNet *) stereo->net.detectNet_net)->SetStream(infer_stream);
+
+   for (int s = 0; s < DETECT_STEREO_SLOTS; s++) {
+      cudaEvent_t event = NULL;
+
+      for (int eye = 0; eye < 2; eye++) {
+         if (CUDA_FAILED(cudaHostAlloc(&stereo->h_staging[s][eye], frame_size, cudaHostAllocDefault)) ||
+             CUDA_FAILED(cudaMalloc(&stereo->d_frames[s][eye], frame_size))) {
+            printf("Failed to allocate stereo detection buffers.\n");
+            free_detect_stereo(stereo);
+            return 1;
+         }
+      }
+
+      if (CUDA_FAILED(cudaEventCreateWithFlags(&event, cudaEventDisableTiming))) {
+         printf("Failed cudaEventCreate()\n");
+         free_detect_stereo(stereo);
+         return 1;
+      }
+      stereo->uploaded[s] = (void *) event;
+   }
+
+   return 0;
+#else
+   return 1;
+#endif
+}
+
+/* Stage a stereo pair and start its upload. The source frames can be released as soon
+ * as this returns. Returns the slot to pass to detect_stereo_process(), or -1.
+ */
+int detect_stereo_upload(detect_stereo *stereo, const void *left, const void *right)
+{
+#ifdef USE_JETSON_INFERENCE
+   int slot = stereo->next_slot;
+   size_t frame_size = (size_t) stereo->net.l_width * stereo->net.l_height * sizeof(uchar4);
+   cudaStream_t copy_stream = (cudaStream_t) stereo->copy_stream;
+   const void *frames[2] = { left, right };
+
+   /* The last upload from this slot has to be done before we overwrite its staging memory. */
+   cudaEventSynchronize((cudaEvent_t) stereo->uploaded[slot]);
+
+   for (int eye = 0; eye < 2; eye++) {
+      memcpy(stereo->h_staging[slot][eye], frames[eye], frame_size);
+      cudaMemcpyAsync(stereo->d_frames[slot][eye], stereo->h_staging[slot][eye], frame_size,
+                      cudaMemcpyHostToDevice, copy_stream);
+   }
+   cudaEventRecord((cudaEvent_t) stereo->uploaded[slot], copy_stream);
+
+   stereo->next_slot = (slot + 1) % DETECT_STEREO_SLOTS;
+
+   return slot;
+#else
+   return -1;
+#endif
+}
+
+/* Run both eyes of an uploaded slot through the network. Blocks until the results are in. */
+int detect_stereo_process(detect_stereo *stereo, int slot, detect *left_detects,
+                          detect *right_detects, int max_detections, float min_confidence)
+{
+#ifdef USE_JETSON_INFERENCE
+   detectNet *net = (detectNet *) stereo->net.detectNet_net;
+   detect *outputs[2] = { left_detects, right_detects };
+   int total = 0;
+
+   if ((slot < 0) || (slot >= DETECT_STEREO_SLOTS)) {
+      return 0;
+   }
+
+   /* Inference only waits on this slot's upload, the other slot can keep copying. */
+   cudaStreamWaitEvent((cudaStream_t) stereo->infer_stream, (cudaEvent_t) stereo->uploaded[slot], 0);
+
+   for (int eye = 0; eye < 2; eye++) {
+      detectNet::Detection *detections = NULL;
+      int numDetections = net->Detect((uchar4 *) stereo->d_frames[slot][eye],
+                                      stereo->net.l_width, stereo->net.l_height,
+                                      &detections, 0);
+      if (numDetections >= 0) {
+         total += copy_detections(detections, numDetections, outputs[eye], max_detections,
+                                  min_confidence);
+      }
+   }
+
+   return total;
+#else
+   return 0;
+#endif
+}
+
+/* Clean up the stereo detector. */
+void free_detect_stereo(detect_stereo *stereo)
+{
+#ifdef USE_JETSON_INFERENCE
+   if (stereo->copy_stream != NULL) {
+      cudaStreamSynchronize((cudaStream_t) stereo->copy_stream);
+   }
+
+   for (int s = 0; s < DETECT_STEREO_SLOTS; s++) {
+      for (int eye = 0; eye < 2; eye++) {
+         if (stereo->h_staging[s][eye] != NULL) {
+            cudaFreeHost(stereo->h_staging[s][eye]);
+            stereo->h_staging[s][eye] = NULL;
+         }
+         if (stereo->d_frames[s][eye] != NULL) {
+            cudaFree(stereo->d_frames[s][eye]);
+            stereo->d_frames[s][eye] = NULL;
+         }
+      }
+      if (stereo->uploaded[s] != NULL) {
+         cudaEventDestroy((cudaEvent_t) stereo->uploaded[s]);
+         stereo->uploaded[s] = NULL;
+      }
+   }
+
+   if (stereo->copy_stream != NULL) {
+      cudaStreamDestroy((cudaStream_t) stereo->copy_stream);
+      stereo->copy_stream = NULL;
+   }
+   if (stereo->infer_stream != NULL) {
+      cudaStreamDestroy((cudaStream_t) stereo->infer_stream);
+      stereo->infer_stream = NULL;
+   }
+
+   if (stereo->net.detectNet_net != NULL) {
+      free_detect(&stereo->net);
+   }
+#endif
+}
@@ -20,20 +20,29 @@
  */
 
 
+#ifndef DETECT_H
+#define DETECT_H
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include <semaphore.h>
 
+#define DETECT_MAX_CLASSES     128
+#define DETECT_CLASS_NAME_LEN  64
+
+/* Kept small so raising the detection cap doesn't grow the copies much.
+ * Names are looked up from class_id with detect_class_desc(). */
 typedef struct _detect {
-   int active;
-   char description[256];
-   double confidence;
-   double left;
-   double top;
-   double width;
-   double height;
+   short active;
+   short class_id;
+   int track_id;        /* Stable ID assigned by the tracker, 0 if untracked. */
+   float confidence;
+   float left;
+   float top;
+   float width;
+   float height;
 } detect;
 
 typedef struct _detect_net {
@@ -47,10 +56,37 @@ typedef struct _detect_net {
    sem_t *v_mutex;
 } detect_net;
 
+/* Both eyes through one network. Frames are staged in pinned memory and uploaded
+ * with cudaMemcpyAsync on a copy stream, double buffered so the upload of the
+ * next pair overlaps inference on the current one. */
+#define DETECT_STEREO_SLOTS 2
+
+typedef struct _detect_stereo {
+   detect_net net;
+
+   void *h_staging[DETECT_STEREO_SLOTS][2];  /* Pinned host copies, [slot][eye]. */
+   void *d_frames[DETECT_STEREO_SLOTS][2];   /* Device frames, [slot][eye]. */
+   void *uploaded[DETECT_STEREO_SLOTS];      /* cudaEvent_t, recorded after each slot's upload. */
+   void *copy_stream;                        /* cudaStream_t for uploads. */
+   void *infer_stream;                       /* cudaStream_t for inference. */
+
+   int next_slot;
+} detect_stereo;
+
 int init_detect(detect_net *new_detect, int argc, char **argv, int width, int height);
-int detect_image(detect_net *new_detect, void *image, detect *my_detects, int max_detections);
+int detect_image(detect_net *new_detect, void *image, detect *my_detects, int max_detections,
+                 float min_confidence);
 void free_detect(detect_net *new_detect);
+const char *detect_class_desc(int class_id);
+
+int init_detect_stereo(detect_stereo *stereo, int argc, char **argv, int width, int height);
+int detect_stereo_upload(detect_stereo *stereo, const void *left, const void *right);
+int detect_stereo_process(detect_stereo *stereo, int slot, detect *left_detects,
+                          detect *right_detects, int max_detections, float min_confidence);
+void free_detect_stereo(detect_stereo *stereo);
 
 #ifdef __cplusplus
 }
 #endif
+
+#endif /* DETECT_H */
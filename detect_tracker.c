@@ -0,0 +1,263 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "detect_tracker.h"
+#include "logging.h"
+
+/* Edges tracked per eye. */
+enum { AXIS_CX, AXIS_CY, AXIS_W, AXIS_H, AXIS_COUNT };
+
+/* One dimension of constant velocity state. */
+typedef struct {
+   double x;
+   double v;
+   double p00, p01, p11;         /* Covariance. */
+} track_axis;
+
+typedef struct {
+   int active;
+   int id;
+   int class_id;
+   double confidence;
+
+   track_axis axes[2][AXIS_COUNT];
+   unsigned long last_ns;        /* Time the filters are at. */
+   int misses;
+} track;
+
+static track tracks[TRACK_MAX];
+static int next_track_id = 1;
+
+static void axis_init(track_axis *a, double z)
+{
+   a->x = z;
+   a->v = 0.0;
+   a->p00 = TRACK_MEAS_NOISE;
+   a->p01 = 0.0;
+   a->p11 = TRACK_INIT_VEL_VAR;
+}
+
+static void axis_predict(track_axis *a, double dt)
+{
+   double q = TRACK_PROCESS_NOISE;
+
+   a->x += a->v * dt;
+   a->p00 += dt * (2.0 * a->p01 + dt * a->p11) + q * dt * dt * dt / 3.0;
+   a->p01 += dt * a->p11 + q * dt * dt / 2.0;
+   a->p11 += q * dt;
+}
+
+static void axis_update(track_axis *a, double z)
+{
+   double s = a->p00 + TRACK_MEAS_NOISE;
+   double k0 = a->p00 / s;
+   double k1 = a->p01 / s;
+   double y = z - a->x;
+
+   a->x += k0 * y;
+   a->v += k1 * y;
+
+   a->p11 -= k1 * a->p01;
+   a->p01 -= k0 * a->p01;
+   a->p00 -= k0 * a->p00;
+}
+
+static void meas_to_axes(const detect *d, double z[AXIS_COUNT])
+{
+   z[AXIS_CX] = d->left + d->width / 2.0;
+   z[AXIS_CY] = d->top + d->height / 2.0;
+   z[AXIS_W] = d->width;
+   z[AXIS_H] = d->height;
+}
+
+static double box_iou(const track *t, const detect *d)
+{
+   const track_axis *a = t->axes[0];
+   double tl = a[AXIS_CX].x - a[AXIS_W].x / 2.0, tr = tl + a[AXIS_W].x;
+   double tt = a[AXIS_CY].x - a[AXIS_H].x / 2.0, tb = tt + a[AXIS_H].x;
+   double dl = d->left, dr = d->left + d->width;
+   double dt = d->top, db = d->top + d->height;
+   double iw = (tr < dr ? tr : dr) - (tl > dl ? tl : dl);
+   double ih = (tb < db ? tb : db) - (tt > dt ? tt : dt);
+   double inter = 0.0, uni = 0.0;
+
+   if ((iw <= 0.0) || (ih <= 0.0)) {
+      return 0.0;
+   }
+
+   inter = iw * ih;
+   uni = a[AXIS_W].x * a[AXIS_H].x + d->width * d->height - inter;
+
+   return (uni > 0.0) ? inter / uni : 0.0;
+}
+
+void tracker_reset(void)
+{
+   memset(tracks, 0, sizeof(tracks));
+}
+
+void tracker_update(detect meas[2][MAX_DETECT], unsigned long meas_ns)
+{
+   int used[MAX_DETECT] = { 0 };
+   int matched[TRACK_MAX] = { 0 };
+   double z[AXIS_COUNT];
+
+   /* Bring every track up to the measurement time. */
+   for (int t = 0; t < TRACK_MAX; t++) {
+      if (tracks[t].active && (meas_ns > tracks[t].last_ns)) {
+         double dt = (double) (meas_ns - tracks[t].last_ns) / 1000000000.0;
+
+         for (int eye = 0; eye < 2; eye++) {
+            for (int i = 0; i < AXIS_COUNT; i++) {
+               axis_predict(&tracks[t].axes[eye][i], dt);
+            }
+         }
+         tracks[t].last_ns = meas_ns;
+      }
+   }
+
+   /* Greedy association, best overlap first. There are only a handful of boxes. */
+   while (1) {
+      double best = TRACK_IOU_MIN;
+      int best_t = -1, best_m = -1;
+
+      for (int t = 0; t < TRACK_MAX; t++) {
+         if (!tracks[t].active || matched[t]) {
+            continue;
+         }
+         for (int m = 0; m < MAX_DETECT; m++) {
+            if (used[m] || !meas[0][m].active || !meas[1][m].active ||
+                (tracks[t].class_id != meas[0][m].class_id)) {
+               continue;
+            }
+
+            double iou = box_iou(&tracks[t], &meas[0][m]);
+            if (iou >= best) {
+               best = iou;
+               best_t = t;
+               best_m = m;
+            }
+         }
+      }
+
+      if (best_t < 0) {
+         break;
+      }
+
+      for (int eye = 0; eye < 2; eye++) {
+         meas_to_axes(&meas[eye][best_m], z);
+         for (int i = 0; i < AXIS_COUNT; i++) {
+            axis_update(&tracks[best_t].axes[eye][i], z[i]);
+         }
+      }
+      tracks[best_t].confidence = meas[0][best_m].confidence;
+      tracks[best_t].misses = 0;
+      matched[best_t] = 1;
+      used[best_m] = 1;
+   }
+
+   /* Age out what wasn't seen. */
+   for (int t = 0; t < TRACK_MAX; t++) {
+      if (tracks[t].active && !matched[t] && (++tracks[t].misses > TRACK_MAX_MISSES)) {
+         tracks[t].active = 0;
+      }
+   }
+
+   /* Everything left starts a new track. */
+   for (int m = 0; m < MAX_DETECT; m++) {
+      if (used[m] || !meas[0][m].active || !meas[1][m].active) {
+         continue;
+      }
+
+      for (int t = 0; t < TRACK_MAX; t++) {
+         if (tracks[t].active) {
+            continue;
+         }
+
+         tracks[t].active = 1;
+         tracks[t].id = next_track_id++;
+         tracks[t].class_id = meas[0][m].class_id;
+         tracks[t].confidence = meas[0][m].confidence;
+         tracks[t].last_ns = meas_ns;
+         tracks[t].misses = 0;
+         for (int eye = 0; eye < 2; eye++) {
+            meas_to_axes(&meas[eye][m], z);
+            for (int i = 0; i < AXIS_COUNT; i++) {
+               axis_init(&tracks[t].axes[eye][i], z[i]);
+            }
+         }
+#ifdef DEBUG_TRACKER
+         LOG_INFO("New track %d: %s", tracks[t].id, detect_class_desc(tracks[t].class_id));
+#endif
+         break;
+      }
+   }
+}
+
+int tracker_predict(unsigned long now_ns, detect out[2][MAX_DETECT])
+{
+   int count = 0;
+
+   for (int j = 0; j < MAX_DETECT; j++) {
+      out[0][j].active = 0;
+      out[1][j].active = 0;
+   }
+
+   /* Tracks still being confirmed by the detector go first. */
+   for (int pass = 0; pass < 2; pass++) {
+      for (int t = 0; (t < TRACK_MAX) && (count < MAX_DETECT); t++) {
+         double dt = 0.0;
+
+         if (!tracks[t].active || ((pass == 0) != (tracks[t].misses == 0))) {
+            continue;
+         }
+
+         if (now_ns > tracks[t].last_ns) {
+            dt = (double) (now_ns - tracks[t].last_ns) / 1000000000.0;
+            if (dt > TRACK_MAX_PREDICT_S) {
+               dt = TRACK_MAX_PREDICT_S;
+            }
+         }
+
+         for (int eye = 0; eye < 2; eye++) {
+            const track_axis *a = tracks[t].axes[eye];
+            detect *d = &out[eye][count];
+            double w = a[AXIS_W].x + a[AXIS_W].v * dt;
+            double h = a[AXIS_H].x + a[AXIS_H].v * dt;
+
+            d->active = 1;
+            d->track_id = tracks[t].id;
+            d->class_id = (short) tracks[t].class_id;
+            d->confidence = tracks[t].confidence;
+            d->width = (w > 1.0) ? w : 1.0;
+            d->height = (h > 1.0) ? h : 1.0;
+            d->left = a[AXIS_CX].x + a[AXIS_CX].v * dt - d->width / 2.0;
+            d->top = a[AXIS_CY].x + a[AXIS_CY].v * dt - d->height / 2.0;
+         }
+         count++;
+      }
+   }
+
+   return count;
+}
@@ -0,0 +1,67 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef DETECT_TRACKER_H
+#define DETECT_TRACKER_H
+
+#include "defines.h"
+#include "detect.h"
+
+/* Lightweight multi-object tracker between detection and rendering.
+ *
+ * Inference runs at a fraction of the camera rate. Each validated stereo
+ * detection is associated with an existing track by IoU and label, then fed
+ * to a small constant velocity Kalman filter per box edge. At render time the
+ * filters are extrapolated to the displayed frame so boxes move every frame
+ * and keep a stable track ID. Only the render thread touches the tracker.
+ */
+
+#define TRACK_MAX              (MAX_DETECT * 2)  /* Tracks kept, including coasting ones. */
+#define TRACK_IOU_MIN          0.3      /* Minimum overlap to continue a track. */
+#define TRACK_MAX_MISSES       3        /* Detection runs a track can go unmatched. */
+#define TRACK_MAX_PREDICT_S    0.25     /* Never extrapolate further than this past a measurement. */
+#define TRACK_PROCESS_NOISE    4000.0   /* Acceleration variance, px^2/s^3. */
+#define TRACK_MEAS_NOISE       16.0     /* Detector box edge variance, px^2. */
+#define TRACK_INIT_VEL_VAR     10000.0  /* Initial velocity uncertainty, (px/s)^2. */
+
+/**
+ * @brief Clears all tracks.
+ */
+void tracker_reset(void);
+
+/**
+ * @brief Feeds a set of validated stereo detections into the tracker.
+ *
+ * @param meas    Detections from validate_detection(), paired by index across eyes.
+ * @param meas_ns Capture time of the frame they were detected on, latency_now_ns() clock.
+ */
+void tracker_update(detect meas[2][MAX_DETECT], unsigned long meas_ns);
+
+/**
+ * @brief Fills the boxes to draw at a given time.
+ *
+ * @param now_ns Time to predict for, normally the capture time of the displayed frame.
+ * @param out    Predicted boxes, paired by index across eyes. Unused entries are inactive.
+ * @return Number of boxes filled.
+ */
+int tracker_predict(unsigned long now_ns, detect out[2][MAX_DETECT]);
+
+#endif /* DETECT_TRACKER_H */
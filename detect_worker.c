@@ -0,0 +1,327 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include "config_manager.h"
+#include "detect_worker.h"
+#include "logging.h"
+
+typedef struct {
+   detect_net *net;
+   int eye;
+
+   GstBuffer *pending;           /* Newest job not yet picked up, or NULL. */
+   unsigned long pending_ns;     /* Capture time of the pending frame. */
+   pthread_t thread;
+   int running;
+
+   unsigned long submitted;
+   unsigned long replaced;       /* Jobs overwritten before a worker got to them. */
+} detect_worker;
+
+static detect_worker workers[2];
+static int worker_count = 0;
+static int stop_workers = 0;
+
+/* Stereo batch mode: one thread feeds both eyes through a shared network. */
+static detect_stereo *stereo_net = NULL;
+static pthread_t stereo_thread;
+
+/* Job slots. */
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+
+/* Published results. */
+static pthread_mutex_t result_mutex = PTHREAD_MUTEX_INITIALIZER;
+static detect results_latest[2][MAX_DETECT];
+static unsigned long result_seq[2] = { 0, 0 };
+static unsigned long fetched_seq[2] = { 0, 0 };
+static unsigned long result_ns[2] = { 0, 0 };
+
+static void *detect_worker_thread(void *arg)
+{
+   detect_worker *this_worker = (detect_worker *) arg;
+   hud_display_settings *this_hds = get_hud_display_settings();
+   detect local_results[MAX_DETECT];
+   GstBuffer *buffer = NULL;
+   unsigned long frame_ns = 0;
+   GstMapInfo map;
+
+   while (1) {
+      pthread_mutex_lock(&job_mutex);
+      while (!stop_workers && (this_worker->pending == NULL)) {
+         pthread_cond_wait(&job_cond, &job_mutex);
+      }
+      if (stop_workers) {
+         pthread_mutex_unlock(&job_mutex);
+         break;
+      }
+      buffer = this_worker->pending;
+      frame_ns = this_worker->pending_ns;
+      this_worker->pending = NULL;
+      pthread_mutex_unlock(&job_mutex);
+
+      /* The job holds its own reference so the capture side can recycle its frame freely. */
+      if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+         memset(local_results, 0, sizeof(local_results));
+#ifdef USE_CUDA
+         cudaMemcpy(this_worker->net->d_image, map.data,
+                    this_worker->net->l_width * this_worker->net->l_height * 4,
+                    cudaMemcpyHostToDevice);
+#endif
+         detect_image(this_worker->net, map.data, local_results, this_hds->detect_top_k,
+                      (float) this_hds->detect_min_confidence);
+         gst_buffer_unmap(buffer, &map);
+
+         detect_worker_publish(this_worker->eye, local_results, frame_ns);
+      } else {
+         LOG_ERROR("Unable to map buffer for detection.");
+      }
+      gst_buffer_unref(buffer);
+   }
+
+   return NULL;
+}
+
+/* Upload pair N+1 while pair N is in inference. When no pair is waiting behind
+ * the one just uploaded, run it straight away rather than hold it a frame. */
+static void *detect_stereo_thread(void *arg)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   detect local_results[2][MAX_DETECT];
+   GstBuffer *buffers[2] = { NULL, NULL };
+   GstMapInfo maps[2];
+   unsigned long frame_ns = 0, in_flight_ns = 0;
+   int in_flight = -1;
+   int slot = -1;
+   int more = 0;
+
+   while (1) {
+      pthread_mutex_lock(&job_mutex);
+      while (!stop_workers && ((workers[0].pending == NULL) || (workers[1].pending == NULL))) {
+         pthread_cond_wait(&job_cond, &job_mutex);
+      }
+      if (stop_workers) {
+         pthread_mutex_unlock(&job_mutex);
+         break;
+      }
+      for (int eye = 0; eye < 2; eye++) {
+         buffers[eye] = workers[eye].pending;
+         workers[eye].pending = NULL;
+      }
+      frame_ns = workers[0].pending_ns;
+      pthread_mutex_unlock(&job_mutex);
+
+      slot = -1;
+      if (gst_buffer_map(buffers[0], &maps[0], GST_MAP_READ)) {
+         if (gst_buffer_map(buffers[1], &maps[1], GST_MAP_READ)) {
+            /* Staged into pinned memory, so the camera buffers are free once this returns. */
+            slot = detect_stereo_upload(stereo_net, maps[0].data, maps[1].data);
+            gst_buffer_unmap(buffers[1], &maps[1]);
+         }
+         gst_buffer_unmap(buffers[0], &maps[0]);
+      }
+      if (slot < 0) {
+         LOG_ERROR("Unable to stage stereo pair for detection.");
+      }
+      gst_buffer_unref(buffers[0]);
+      gst_buffer_unref(buffers[1]);
+
+      if (in_flight >= 0) {
+         memset(local_results, 0, sizeof(local_results));
+         detect_stereo_process(stereo_net, in_flight, local_results[0], local_results[1],
+                               this_hds->detect_top_k, (float) this_hds->detect_min_confidence);
+         detect_worker_publish(0, local_results[0], in_flight_ns);
+         detect_worker_publish(1, local_results[1], in_flight_ns);
+         in_flight = -1;
+      }
+
+      pthread_mutex_lock(&job_mutex);
+      more = (workers[0].pending != NULL) && (workers[1].pending != NULL);
+      pthread_mutex_unlock(&job_mutex);
+
+      if (more) {
+         in_flight = slot;
+         in_flight_ns = frame_ns;
+      } else if (slot >= 0) {
+         memset(local_results, 0, sizeof(local_results));
+         detect_stereo_process(stereo_net, slot, local_results[0], local_results[1],
+                               this_hds->detect_top_k, (float) this_hds->detect_min_confidence);
+         detect_worker_publish(0, local_results[0], frame_ns);
+         detect_worker_publish(1, local_results[1], frame_ns);
+      }
+   }
+
+   return NULL;
+}
+
+int detect_worker_start_stereo(detect_stereo *stereo)
+{
+   if ((worker_count > 0) || (stereo == NULL)) {
+      return (worker_count > 0) ? SUCCESS : FAILURE;
+   }
+
+   stop_workers = 0;
+   stereo_net = stereo;
+   for (int i = 0; i < 2; i++) {
+      memset(&workers[i], 0, sizeof(detect_worker));
+      workers[i].net = &stereo->net;
+      workers[i].eye = i;
+   }
+
+   if (pthread_create(&stereo_thread, NULL, detect_stereo_thread, NULL) != 0) {
+      LOG_ERROR("Error creating stereo detection worker.");
+      stereo_net = NULL;
+      return FAILURE;
+   }
+   workers[0].running = workers[1].running = 1;
+   worker_count = 2;
+
+   return SUCCESS;
+}
+
+int detect_worker_start(detect_net *left, detect_net *right)
+{
+   detect_net *nets[2] = { left, right };
+
+   if (worker_count > 0) {
+      return SUCCESS;
+   }
+
+   stop_workers = 0;
+   for (int i = 0; i < 2; i++) {
+      if (nets[i] == NULL) {
+         continue;
+      }
+
+      memset(&workers[i], 0, sizeof(detect_worker));
+      workers[i].net = nets[i];
+      workers[i].eye = i;
+
+      if (pthread_create(&workers[i].thread, NULL, detect_worker_thread, &workers[i]) != 0) {
+         LOG_ERROR("Error creating detection worker %d.", i);
+         detect_worker_stop();
+         return FAILURE;
+      }
+      workers[i].running = 1;
+      worker_count++;
+   }
+
+   return (worker_count > 0) ? SUCCESS : FAILURE;
+}
+
+int detect_worker_submit(int eye, GstBuffer *buffer, unsigned long frame_ns)
+{
+   if ((eye < 0) || (eye > 1) || (buffer == NULL) || !workers[eye].running) {
+      return FAILURE;
+   }
+
+   pthread_mutex_lock(&job_mutex);
+   if (workers[eye].pending != NULL) {
+      gst_buffer_unref(workers[eye].pending);
+      workers[eye].replaced++;
+   }
+   workers[eye].pending = gst_buffer_ref(buffer);
+   workers[eye].pending_ns = frame_ns;
+   workers[eye].submitted++;
+   pthread_cond_broadcast(&job_cond);
+   pthread_mutex_unlock(&job_mutex);
+
+   return SUCCESS;
+}
+
+void detect_worker_publish(int eye, const detect *results, unsigned long frame_ns)
+{
+   if ((eye < 0) || (eye > 1)) {
+      return;
+   }
+
+   pthread_mutex_lock(&result_mutex);
+   memcpy(results_latest[eye], results, sizeof(detect) * MAX_DETECT);
+   result_ns[eye] = frame_ns;
+   result_seq[eye]++;
+   pthread_mutex_unlock(&result_mutex);
+}
+
+int detect_worker_fetch(detect results[2][MAX_DETECT], unsigned long *frame_ns)
+{
+   int stereo = 0;
+   int fresh = 0;
+
+   pthread_mutex_lock(&result_mutex);
+   /* Synchronous callers publish without starting workers, so also go by what has arrived. */
+   stereo = workers[1].running || (result_seq[1] != 0);
+   /* Keep the eyes together, a box is only drawn when both sides agree. */
+   if ((result_seq[0] != fetched_seq[0]) &&
+       (!stereo || (result_seq[1] != fetched_seq[1]))) {
+      memcpy(results[0], results_latest[0], sizeof(detect) * MAX_DETECT);
+      memcpy(results[1], results_latest[stereo ? 1 : 0], sizeof(detect) * MAX_DETECT);
+      fetched_seq[0] = result_seq[0];
+      fetched_seq[1] = result_seq[1];
+      if (frame_ns != NULL) {
+         *frame_ns = result_ns[0];
+      }
+      fresh = 1;
+   }
+   pthread_mutex_unlock(&result_mutex);
+
+   return fresh;
+}
+
+void detect_worker_stop(void)
+{
+   pthread_mutex_lock(&job_mutex);
+   stop_workers = 1;
+   pthread_cond_broadcast(&job_cond);
+   pthread_mutex_unlock(&job_mutex);
+
+   if (stereo_net != NULL) {
+      pthread_join(stereo_thread, NULL);
+   }
+
+   for (int i = 0; i < 2; i++) {
+      if (!workers[i].running) {
+         continue;
+      }
+
+      if (stereo_net == NULL) {
+         pthread_join(workers[i].thread, NULL);
+      }
+      workers[i].running = 0;
+
+      if (workers[i].pending != NULL) {
+         gst_buffer_unref(workers[i].pending);
+         workers[i].pending = NULL;
+      }
+
+      LOG_INFO("Detection worker %d: %lu jobs submitted, %lu replaced before running.",
+               i, workers[i].submitted, workers[i].replaced);
+   }
+   worker_count = 0;
+   stereo_net = NULL;
+}
@@ -0,0 +1,92 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef DETECT_WORKER_H
+#define DETECT_WORKER_H
+
+#include <gst/gst.h>
+
+#include "defines.h"
+#include "detect.h"
+
+/* Long-lived object detection workers, one per eye.
+ *
+ * The render loop submits camera buffers and never waits on inference. Each
+ * eye has a single pending job slot; submitting while a job is still waiting
+ * replaces it, so a slow network always works on the newest frame. Finished
+ * results are published under a mutex with a sequence number and the render
+ * path only ever copies out the latest complete set.
+ */
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param left  Initialized detector for the left eye.
+ * @param right Initialized detector for the right eye, or NULL for a single camera.
+ *              With one camera its results are used for both eyes.
+ * @return SUCCESS or FAILURE.
+ */
+int detect_worker_start(detect_net *left, detect_net *right);
+
+/**
+ * @brief Starts a single worker that runs both eyes through one stereo detector.
+ *
+ * Uploads of the next pair overlap inference on the current one.
+ *
+ * @param stereo Initialized stereo detector.
+ * @return SUCCESS or FAILURE.
+ */
+int detect_worker_start_stereo(detect_stereo *stereo);
+
+/**
+ * @brief Queues a camera buffer for detection. Never blocks on inference.
+ *
+ * Takes its own reference on the buffer, the caller keeps theirs.
+ *
+ * @param eye      0 for left, 1 for right.
+ * @param buffer   RGBA frame the size the detector was initialized with.
+ * @param frame_ns Capture time of the frame, carried through to the results.
+ * @return SUCCESS, or FAILURE if the workers aren't running.
+ */
+int detect_worker_submit(int eye, GstBuffer *buffer, unsigned long frame_ns);
+
+/**
+ * @brief Publishes a finished set of detections for one eye.
+ *
+ * Used by the workers, and by callers that run detection synchronously.
+ */
+void detect_worker_publish(int eye, const detect *results, unsigned long frame_ns);
+
+/**
+ * @brief Copies out the latest results once every eye has published since the last fetch.
+ *
+ * @param results  Destination, indexed by eye.
+ * @param frame_ns Optional. Set to the capture time of the frame the results came from.
+ * @return 1 if new results were copied, 0 if nothing changed.
+ */
+int detect_worker_fetch(detect results[2][MAX_DETECT], unsigned long *frame_ns);
+
+/**
+ * @brief Stops and joins the workers and drops any pending jobs.
+ */
+void detect_worker_stop(void);
+
+#endif /* DETECT_WORKER_H */
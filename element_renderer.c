@@ -39,20 +39,25 @@
 #include "config_manager.h"
 #include "curl_download.h"
 #include "defines.h"
+#include "detect_tracker.h"
+#include "detect_worker.h"
 #include "devices.h"
 #include "element_renderer.h"
+#include "frame_pacer.h"
+#include "glyph_atlas.h"
 #include "hud_manager.h"
+#include "latency_stats.h"
 #include "logging.h"
 #include "mirage.h"
 #include "recording.h"
+#include "render_profiler.h"
 #include "secrets.h"
+#include "sensor_store.h"
 #include "system_metrics.h"
+#include "texture_atlas.h"
+#include "texture_cache.h"
 
 /* Globals and external references */
-// video elements
-extern od_data oddataL, oddataR;
-extern pthread_t od_L_thread, od_R_thread;
-
 // detection elements
 extern int detect_enabled;
 extern detect this_detect[2][MAX_DETECT];
@@ -96,7 +101,7 @@ void render_static_element(element *curr_element) {
    SDL_Rect dst_rect_l, dst_rect_r;
    SDL_Texture *this_texture = NULL;
    hud_display_settings *this_hds = get_hud_display_settings();
-   motion *this_motion = get_motion_dev();
+   const motion *this_motion = get_latched_motion();
    const char *aiState = get_ai_state();
    SDL_Renderer *renderer = get_sdl_renderer();
 
@@ -167,7 +172,7 @@ void render_animated_element(element *curr_element) {
    SDL_Texture *this_texture = NULL;
    double ratio = 0.0;
    hud_display_settings *this_hds = get_hud_display_settings();
-   motion *this_motion = get_motion_dev();
+   const motion *this_motion = get_latched_motion();
    SDL_Renderer *renderer = get_sdl_renderer();
 
    /* Set up source rectangle from animation frame */
@@ -275,17 +280,179 @@ void render_animated_element(element *curr_element) {
    if (framesToUpdate > 0) {
       if ((currTime %
          (int)ceil((double)curr_fps / curr_element->this_anim.frame_count)) == 0) {
-         if (curr_element->this_anim.current_frame->next != NULL) {
-             curr_element->this_anim.current_frame =
-                curr_element->this_anim.current_frame->next;
-         } else {
-             curr_element->this_anim.current_frame = curr_element->this_anim.first_frame;
+         advance_animation(&curr_element->this_anim);
+
+         /* The displayed frame changed, so the next one has to be drawn. */
+         if (curr_element->this_anim.frame_count > 1) {
+            hud_mark_damaged();
          }
       }
       curr_element->this_anim.last_update = currTime;
    }
 }
 
+/* The *LOG* console keeps one texture per line, keyed by its text, font and
+ * color. A new entry rasterizes only that line; the rest are GPU copies at
+ * their new row. Twice the row count so a refresh never evicts a line it uses. */
+#define LOG_LINE_CACHE_SIZE (LOG_ROWS * 2)
+
+typedef struct {
+   char text[LOG_LINE_LENGTH];
+   TTF_Font *font;
+   SDL_Color color;
+   SDL_Texture *texture;
+   int w, h;
+   unsigned int used;            /* Console pass this line was last drawn in. */
+} log_line_texture;
+
+static log_line_texture log_lines[LOG_LINE_CACHE_SIZE];
+static unsigned int log_line_pass = 0;   /* Bumped by every render_log_console(). */
+
+static log_line_texture *log_line_get(TTF_Font *font, SDL_Color color, const char *text)
+{
+   log_line_texture *entry = NULL;
+   SDL_Surface *surface = NULL;
+
+   for (int i = 0; i < LOG_LINE_CACHE_SIZE; i++) {
+      log_line_texture *line = &log_lines[i];
+
+      if ((line->texture != NULL) && (line->font == font) &&
+          (memcmp(&line->color, &color, sizeof(color)) == 0) &&
+          (strncmp(line->text, text, LOG_LINE_LENGTH) == 0)) {
+         line->used = log_line_pass;
+         return line;
+      }
+
+      /* Least recently drawn, empty slots first. Lines this pass already handed
+       * out are still wanted, another *LOG* console may share the cache. */
+      if (line->used == log_line_pass) {
+         continue;
+      } else if (line->texture == NULL) {
+         if ((entry == NULL) || (entry->texture != NULL)) {
+            entry = line;
+         }
+      } else if ((entry == NULL) || ((entry->texture != NULL) && (line->used < entry->used))) {
+         entry = line;
+      }
+   }
+
+   if (entry == NULL) {
+      return NULL;
+   }
+
+   if (entry->texture != NULL) {
+      SDL_DestroyTexture(entry->texture);
+      entry->texture = NULL;
+   }
+
+   surface = TTF_RenderText_Blended(font, text, color);
+   if (surface == NULL) {
+      return NULL;
+   }
+   entry->texture = SDL_CreateTextureFromSurface(get_sdl_renderer(), surface);
+   entry->w = surface->w;
+   entry->h = surface->h;
+   SDL_FreeSurface(surface);
+
+   if (entry->texture == NULL) {
+      LOG_ERROR("Error creating log line texture: %s", SDL_GetError());
+      return NULL;
+   }
+
+   snprintf(entry->text, sizeof(entry->text), "%s", text);
+   entry->font = font;
+   entry->color = color;
+   entry->used = log_line_pass;
+
+   return entry;
+}
+
+/* Redraw the log console into the element's canvas from cached line textures. */
+static void render_log_console(element *curr_element)
+{
+   SDL_Renderer *renderer = get_sdl_renderer();
+   SDL_Texture *prev_target = NULL;
+   char (*raw_log)[LOG_LINE_LENGTH] = get_raw_log();
+   int log_width = curr_element->width > 0 ? curr_element->width : DEFAULT_LOG_WIDTH;
+   int log_height = curr_element->height > 0 ? curr_element->height : DEFAULT_LOG_HEIGHT;
+   int start_idx = get_next_log_row();   // Index of the oldest entry
+   int access = -1, canvas_w = 0, canvas_h = 0;
+   Uint8 r = 0, g = 0, b = 0, a = 0;
+
+   if (curr_element->surface != NULL) {
+      SDL_FreeSurface(curr_element->surface);
+      curr_element->surface = NULL;
+   }
+
+   if (curr_element->texture != NULL) {
+      SDL_QueryTexture(curr_element->texture, NULL, &access, &canvas_w, &canvas_h);
+   }
+   if ((curr_element->texture == NULL) || (access != SDL_TEXTUREACCESS_TARGET) ||
+       (canvas_w != log_width) || (canvas_h != log_height)) {
+      if (curr_element->texture != NULL) {
+         SDL_DestroyTexture(curr_element->texture);
+      }
+      curr_element->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                                SDL_TEXTUREACCESS_TARGET, log_width, log_height);
+      if (curr_element->texture == NULL) {
+         LOG_ERROR("Error creating log canvas: %s", SDL_GetError());
+         return;
+      }
+      SDL_SetTextureBlendMode(curr_element->texture, SDL_BLENDMODE_BLEND);
+   }
+
+   /* Rasterize and upload anything new before switching targets. */
+   log_line_texture *rows[LOG_ROWS] = { NULL };
+   log_line_pass++;
+   for (int ii = 0; ii < LOG_ROWS; ii++) {
+      int idx = (start_idx + ii) % LOG_ROWS;  // Wrap around when needed
+
+      if (raw_log[idx][0] != '\0') {
+         rows[ii] = log_line_get(curr_element->ttf_font, curr_element->font_color, raw_log[idx]);
+      }
+   }
+
+   /* Anything queued against the current target has to land first. */
+   texture_atlas_flush();
+   prev_target = SDL_GetRenderTarget(renderer);
+   if (SDL_SetRenderTarget(renderer, curr_element->texture) != 0) {
+      LOG_ERROR("Unable to target log canvas: %s", SDL_GetError());
+      return;
+   }
+
+   /* Clear to the font color at zero alpha so glyph edges don't blend toward black. */
+   SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+   SDL_SetRenderDrawColor(renderer, curr_element->font_color.r, curr_element->font_color.g,
+                          curr_element->font_color.b, 0);
+   SDL_RenderClear(renderer);
+   SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+   for (int ii = 0; ii < LOG_ROWS; ii++) {
+      if (rows[ii] != NULL) {
+         SDL_Rect line_rect = { 0, ii * curr_element->font_size, rows[ii]->w, rows[ii]->h };
+
+         SDL_SetTextureAlphaMod(rows[ii]->texture, 255);
+         SDL_RenderCopy(renderer, rows[ii]->texture, NULL, &line_rect);
+      }
+   }
+
+   SDL_SetRenderTarget(renderer, prev_target);
+
+   /* Update destination rectangle dimensions to match the canvas */
+   curr_element->dst_rect.w = log_width;
+   curr_element->dst_rect.h = log_height;
+}
+
+void log_console_cleanup(void)
+{
+   for (int i = 0; i < LOG_LINE_CACHE_SIZE; i++) {
+      if (log_lines[i].texture != NULL) {
+         SDL_DestroyTexture(log_lines[i].texture);
+      }
+      memset(&log_lines[i], 0, sizeof(log_lines[i]));
+   }
+}
+
 /* Render a text element */
 void render_text_element(element *curr_element) {
    SDL_Rect dst_rect_l, dst_rect_r;
@@ -294,10 +461,9 @@ void render_text_element(element *curr_element) {
    unsigned int currTime = SDL_GetTicks();
    float alpha_override = curr_element->transition_alpha;
    static unsigned int last_log = 0;
-   char (*raw_log)[LOG_LINE_LENGTH] = get_raw_log();
-   motion *this_motion = get_motion_dev();
-   enviro *this_enviro = get_enviro_dev();
-   gps *this_gps = get_gps_dev();
+   const motion *this_motion = get_latched_motion();
+   const enviro *this_enviro = get_latched_enviro();
+   const gps *this_gps = get_latched_gps();
    SDL_Renderer *renderer = get_sdl_renderer();
 
    // Initialize first pass.
@@ -306,95 +472,95 @@ void render_text_element(element *curr_element) {
    }
 
    /* Process dynamic text content */
-   if (strcmp("*FPS*", curr_element->text) == 0) {
+   if (curr_element->text_token == TEXT_TOKEN_FPS) {
       /* FPS display */
       snprintf(render_text, MAX_TEXT_LENGTH, "Current FPS: %d", (int)averageFrameRate);
-   } else if (strcmp("*DATETIME*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_DATETIME) {
       /* Date/time display */
       snprintf(render_text, MAX_TEXT_LENGTH, "%s %s", this_gps->date, this_gps->time);
-   } else if (strcmp("*GPSTIME*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_GPSTIME) {
       /* TODO: Use Google API to convert GPS location into correct local time. */
       /* https://maps.googleapis.com/maps/api/timezone/json?language=es&location=39.6034810%2C-119.6822510&timestamp=1331766000&key=GoogleAPIKey */
       snprintf(render_text, MAX_TEXT_LENGTH, "%s", this_gps->time);
-   } else if (strcmp("*SYSTIME*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_SYSTIME) {
       time_t stime;
       struct tm *ltime;
       stime = time(NULL);
       ltime = localtime(&stime);
       snprintf(render_text, MAX_TEXT_LENGTH, "%02d:%02d:%02d",
               ltime->tm_hour, ltime->tm_min, ltime->tm_sec);
-   } else if (strcmp("*AINAME*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_AINAME) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%s", get_ai_name());
-   } else if (strcmp("*CPU*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_CPU) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0Lf%%", get_loadavg());
-   } else if (strcmp("*SYSTEM_TEMP*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_SYSTEM_TEMP) {
       if (system_metrics.system_temp_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.0f C", system_metrics.system_temperature);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.- C");
       }
-   } else if (strcmp("*SYSTEM_TEMP_F*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_SYSTEM_TEMP_F) {
       if (system_metrics.system_temp_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.0f F",
                  system_metrics.system_temperature * 9/5 + 32.0);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.- F");
       }
-   } else if (strcmp("*MEM*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_MEM) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0Lf%%", get_mem_usage());
-   } else if (strcmp("*HELMTEMP*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_HELMTEMP) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%0.0f C", this_enviro->temp);
-   } else if (strcmp("*HELMTEMP_F*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_HELMTEMP_F) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0f F", this_enviro->temp * 9/5 + 32.0);
-   } else if (strcmp("*HELMHUM*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_HELMHUM) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%02.0f%%", this_enviro->humidity);
 
-   } else if (strcmp("*AIRQUALITY*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_AIRQUALITY) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0f", this_enviro->air_quality);
-   } else if (strcmp("*AIRQUALITYDESC*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_AIRQUALITYDESC) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%s", this_enviro->air_quality_description);
-   } else if (strcmp("*TVOC*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_TVOC) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0f", this_enviro->tvoc_ppb);
-   } else if (strcmp("*ECO2*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_ECO2) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0f", this_enviro->eco2_ppm);
-   } else if (strcmp("*CO2*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_CO2) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03.0f", this_enviro->co2_ppm);
-   } else if (strcmp("*CO2QUALITY*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_CO2QUALITY) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%s", this_enviro->co2_quality_description);
-   } else if (strcmp("*CO2ECO2DIFF*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_CO2ECO2DIFF) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%03d", this_enviro->co2_eco2_diff);
-   } else if (strcmp("*CO2SOURCEANALYSIS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_CO2SOURCEANALYSIS) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%s", this_enviro->co2_source_analysis);
-   } else if (strcmp("*HEATINDEX_C*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_HEATINDEX_C) {
       if (this_enviro->heat_index_c > 0) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.1f", this_enviro->heat_index_c);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "N/A");
       }
-   } else if (strcmp("*DEWPOINT*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_DEWPOINT) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%0.1f", this_enviro->dew_point);
-   } else if (strcmp("*FAN*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_FAN) {
       int fan_percent = get_fan_load_percent();
       snprintf(render_text, MAX_TEXT_LENGTH, "%03d%%", fan_percent);
-   } else if (strcmp("*BATTERY_LEVEL*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_LEVEL) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.1f%%", system_metrics.battery_level);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.-%%");
       }
-   } else if (strcmp("*BATTERY_STATUS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_STATUS) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%s", system_metrics.battery_status);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "UNKNOWN");
       }
-   } else if (strcmp("*BATTERY_STATUS_REASON*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_STATUS_REASON) {
       if (system_metrics.power_available && strlen(system_metrics.status_reason) > 0) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%s", system_metrics.status_reason);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "No status information");
       }
-   } else if (strcmp("*BATTERY_CELLS_CONFIG*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CELLS_CONFIG) {
       if (system_metrics.power_available && system_metrics.battery_cells_series > 0) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%dS%dP",
                  system_metrics.battery_cells_series,
@@ -404,7 +570,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--S--P");
       }
-   } else if (strcmp("*BATTERY_FAULT_COUNT*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_FAULT_COUNT) {
       if (system_metrics.power_available) {
          if (system_metrics.critical_fault_count > 0) {
             snprintf(render_text, MAX_TEXT_LENGTH, "CRIT:%d WARN:%d INFO:%d",
@@ -423,7 +589,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--");
       }
-   } else if (strcmp("*BATTERY_CRITICAL_FAULTS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CRITICAL_FAULTS) {
       if (system_metrics.power_available && system_metrics.critical_fault_count > 0) {
          /* Concatenate all critical fault messages */
          render_text[0] = '\0';
@@ -441,7 +607,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "No critical faults");
       }
-   } else if (strcmp("*BATTERY_WARNING_FAULTS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_WARNING_FAULTS) {
       if (system_metrics.power_available && system_metrics.warning_fault_count > 0) {
          /* Concatenate all warning fault messages */
          render_text[0] = '\0';
@@ -459,7 +625,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "No warning faults");
       }
-   } else if (strcmp("*BATTERY_INFO_FAULTS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_INFO_FAULTS) {
       if (system_metrics.power_available && system_metrics.info_fault_count > 0) {
          /* Concatenate all info fault messages */
          render_text[0] = '\0';
@@ -477,7 +643,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "No info faults");
       }
-   } else if (strcmp("*BATTERY_ALL_FAULTS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_ALL_FAULTS) {
       if (system_metrics.power_available) {
          /* Initialize with empty string */
          render_text[0] = '\0';
@@ -533,7 +699,7 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "Battery not available");
       }
-   } else if (strcmp("*BATTERY_TIME*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_TIME) {
       if (system_metrics.power_available) {
          if (system_metrics.charge_state == CHARGE_STATE_CHARGING) {
             snprintf(render_text, MAX_TEXT_LENGTH, "%s", "CHARGING");
@@ -545,55 +711,55 @@ void render_text_element(element *curr_element) {
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--:--");
       }
-   } else if (strcmp("*BATTERY_TIME_MIN*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_TIME_MIN) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.1f", system_metrics.time_remaining_min);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.-");
       }
-   } else if (strcmp("*BATTERY_VOLTAGE*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_VOLTAGE) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.2f V", system_metrics.battery_voltage);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.-- V");
       }
-   } else if (strcmp("*BATTERY_CURRENT*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CURRENT) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.2f A", system_metrics.battery_current);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.-- A");
       }
-   } else if (strcmp("*BATTERY_POWER*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_POWER) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.2f W", system_metrics.battery_consumption);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.-- W");
       }
-   } else if (strcmp("*BATTERY_TEMP*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_TEMP) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.1f C", system_metrics.battery_temperature);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--.- C");
       }
-   } else if (strcmp("*BATTERY_CHEMISTRY*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CHEMISTRY) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%s", system_metrics.battery_chemistry);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "UNKN");
       }
-   } else if (strcmp("*BATTERY_CAPACITY*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CAPACITY) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.0f mAh", system_metrics.battery_capacity_mah);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "---- mAh");
       }
-   } else if (strcmp("*BATTERY_CELLS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_BATTERY_CELLS) {
       if (system_metrics.power_available) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%dS", system_metrics.battery_cells);
       } else {
          snprintf(render_text, MAX_TEXT_LENGTH, "--S");
       }
-   } else if (strcmp("*LATLON*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_LATLON) {
       if (this_gps->latitudeDegrees != 0.0) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.02f, %0.02f",
                  this_gps->latitudeDegrees, this_gps->longitudeDegrees);
@@ -601,9 +767,9 @@ void render_text_element(element *curr_element) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%0.02f%s, %0.02f%s",
                  this_gps->latitude, this_gps->lat, this_gps->longitude, this_gps->lon);
       }
-   } else if (strcmp("*PITCH*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_PITCH) {
       snprintf(render_text, MAX_TEXT_LENGTH, "%d", (int)this_motion->pitch + (int)this_hds->pitch_offset);
-   } else if (strcmp("*COMPASS*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_COMPASS) {
       if ((this_motion->heading > 337.5) || (this_motion->heading <= 22.5)) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%s", "N");
       } else if ((this_motion->heading > 22.5) && (this_motion->heading <= 67.5)) {
@@ -621,80 +787,22 @@ void render_text_element(element *curr_element) {
       } else if ((this_motion->heading > 292.5) && (this_motion->heading <= 337.5)) {
          snprintf(render_text, MAX_TEXT_LENGTH, "%s", "NW");
       }
-   } else if (strcmp("*LOG*", curr_element->text) == 0) {
-      static unsigned int last_log_generation = 0;  // Track the last log generation we rendered
+   } else if (curr_element->text_token == TEXT_TOKEN_LOG) {
       unsigned int current_log_generation = get_log_generation();
 
-      // Only redraw if log has changed
-      if (last_log_generation != current_log_generation) {
-         last_log_generation = current_log_generation;
-
-         // Clear and recreate texture
-         if (curr_element->texture != NULL) {
-            SDL_DestroyTexture(curr_element->texture);
-            curr_element->texture = NULL;
-         }
-         if (curr_element->surface != NULL) {
-            SDL_FreeSurface(curr_element->surface);
-            curr_element->surface = NULL;
-         }
-
-         // Use configurable dimensions with defaults if not specified
-         int log_width = curr_element->width > 0 ? curr_element->width : DEFAULT_LOG_WIDTH;
-         int log_height = curr_element->height > 0 ? curr_element->height : DEFAULT_LOG_HEIGHT;
-
-         curr_element->surface = SDL_CreateRGBSurface(0, log_width, log_height, 32, 0, 0, 0, 0);
-         SDL_SetColorKey(curr_element->surface, SDL_TRUE,
-            SDL_MapRGB(curr_element->surface->format, 0, 0,
-            SDL_ALPHA_TRANSPARENT));
-
-         // Get the index of the oldest entry
-         int start_idx = get_next_log_row();
-
-         for (int ii = 0; ii < LOG_ROWS; ii++) {
-            int idx = (start_idx + ii) % LOG_ROWS;  // Wrap around when needed
+      // Only redraw if log has changed since this console last drew it
+      if (curr_element->log_generation != current_log_generation) {
+         curr_element->log_generation = current_log_generation;
+         hud_mark_damaged();
 
-            if (strcmp("", raw_log[idx]) != 0) {
-               SDL_Surface *tmpsfc = NULL;
-               SDL_Rect tmprect;
-
-               tmpsfc = TTF_RenderText_Blended(curr_element->ttf_font, raw_log[idx],
-                                              curr_element->font_color);
-               if (tmpsfc != NULL) {
-                  tmprect.x = 0;
-                  tmprect.y = ii * curr_element->font_size;
-                  tmprect.w = tmpsfc->w;
-                  tmprect.h = tmpsfc->h;
-
-                  SDL_BlitSurface(tmpsfc, NULL, curr_element->surface, &tmprect);
-                  SDL_FreeSurface(tmpsfc);
-               }
-            }
-         }
-
-         /* Create texture from the prepared surface */
-         curr_element->texture = SDL_CreateTextureFromSurface(renderer, curr_element->surface);
-         if (curr_element->texture == NULL) {
-            LOG_ERROR("Error creating texture from log surface: %s", SDL_GetError());
-         } else {
-            /* Update destination rectangle dimensions to match the surface */
-            curr_element->dst_rect.w = curr_element->surface->w;
-            curr_element->dst_rect.h = curr_element->surface->h;
-
-            /* Position calculations need to happen here as in the standard path */
-            if (strcmp("left", curr_element->halign) == 0) {
-               /* Left-aligned text - no change needed */
-            } else if (strcmp("center", curr_element->halign) == 0) {
-               curr_element->dst_rect.x = curr_element->dest_x - (curr_element->dst_rect.w / 2);
-            } else if (strcmp("right", curr_element->halign) == 0) {
-               curr_element->dst_rect.x = curr_element->dest_x - curr_element->dst_rect.w;
-            }
-         }
+         render_log_console(curr_element);
       }
 
       /* Set render_text to a space to prevent it from being recreated in the standard path */
       strcpy(render_text, " ");
-   } else if (strcmp("*ALERT*", curr_element->text) == 0) {
+   } else if (curr_element->text_token == TEXT_TOKEN_PERF_TOP) {
+      snprintf(render_text, MAX_TEXT_LENGTH, "%s", render_profiler_top_text());
+   } else if (curr_element->text_token == TEXT_TOKEN_ALERT) {
       char alert_text[MAX_TEXT_LENGTH] = "";
 
       for (int k = 0; k < ALERT_MAX; k++) {
@@ -716,24 +824,49 @@ void render_text_element(element *curr_element) {
       strcpy(render_text, " ");
    }
 
+   /* Only text elements need this buffer, so it's allocated on first render. */
+   if (curr_element->last_rendered_text == NULL) {
+      curr_element->last_rendered_text = calloc(1, MAX_TEXT_LENGTH);
+      if (curr_element->last_rendered_text == NULL) {
+         LOG_ERROR("Unable to malloc last rendered text buffer.");
+         return;
+      }
+   }
+
    /* Recreate texture if needed */
    if (((curr_element->texture == NULL) ||
          (strncmp(render_text, curr_element->last_rendered_text, MAX_TEXT_LENGTH) != 0)) &&
-         (strcmp("*LOG*", curr_element->text) != 0)) {
+         (curr_element->text_token != TEXT_TOKEN_LOG)) {
+      int text_w = 0, text_h = 0;
 
-      /* Clean up old texture and surface if they exist */
-      if (curr_element->texture != NULL) {
-         SDL_DestroyTexture(curr_element->texture);
-         curr_element->texture = NULL;
-      }
+      hud_mark_damaged();
 
       if (curr_element->surface != NULL) {
          SDL_FreeSurface(curr_element->surface);
          curr_element->surface = NULL;
       }
 
-      /* Check if text contains line break delimiters */
-      if (strchr(render_text, LINE_BREAK_DELIMITER) != NULL) {
+      /* Glyph atlas first, it redraws the existing canvas with no raster or upload. */
+      if (glyph_text_render(&curr_element->texture, curr_element->ttf_font, render_text,
+                            curr_element->font_color, &text_w, &text_h) == SUCCESS) {
+         curr_element->dst_rect.w = text_w;
+         curr_element->dst_rect.h = text_h;
+
+         if (alpha_override > 0.0f) {
+            curr_element->font_color.a = (Uint8)(alpha_override * 255);
+            SDL_SetTextureAlphaMod(curr_element->texture, (Uint8)(alpha_override * 255));
+         }
+
+         snprintf(curr_element->last_rendered_text, MAX_TEXT_LENGTH, "%s", render_text);
+      } else if (curr_element->texture != NULL) {
+         SDL_DestroyTexture(curr_element->texture);
+         curr_element->texture = NULL;
+      }
+
+      /* Otherwise SDL_ttf. Check if text contains line break delimiters */
+      if (curr_element->texture != NULL) {
+         /* Drawn from the glyph atlas */
+      } else if (strchr(render_text, LINE_BREAK_DELIMITER) != NULL) {
          /* Create wrapped text surface using newline handling */
          curr_element->surface = TTF_RenderText_Blended_Wrapped(
             curr_element->ttf_font, render_text, curr_element->font_color, 0);
@@ -812,16 +945,18 @@ void render_text_element(element *curr_element) {
    /* Set alpha on renderer (affects next render call only) */
    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-   /* Render the text */
+   /* Render the text. Glyph canvases can be bigger than the text, so only use its part. */
    if (curr_element->texture != NULL) {
+      SDL_Rect text_src = { 0, 0, curr_element->dst_rect.w, curr_element->dst_rect.h };
+
       SDL_SetTextureAlphaMod(curr_element->texture, render_alpha);
 
       if (curr_element->angle == ANGLE_OPPOSITE_ROLL) {
-         renderStereo(curr_element->texture, NULL, &dst_rect_l, &dst_rect_r, -1.0 * this_motion->roll);
+         renderStereo(curr_element->texture, &text_src, &dst_rect_l, &dst_rect_r, -1.0 * this_motion->roll);
       } else if (curr_element->angle == ANGLE_ROLL) {
-         renderStereo(curr_element->texture, NULL, &dst_rect_l, &dst_rect_r, this_motion->roll);
+         renderStereo(curr_element->texture, &text_src, &dst_rect_l, &dst_rect_r, this_motion->roll);
       } else {
-         renderStereo(curr_element->texture, NULL, &dst_rect_l, &dst_rect_r, curr_element->angle);
+         renderStereo(curr_element->texture, &text_src, &dst_rect_l, &dst_rect_r, curr_element->angle);
       }
 
       SDL_SetTextureAlphaMod(curr_element->texture, 255);
@@ -868,12 +1003,13 @@ void render_map_element(element *curr_element) {
 
    SDL_Rect dst_rect_l, dst_rect_r;
    SDL_Texture *this_texture = NULL;
+   SDL_Surface *new_surface = NULL;
    hud_display_settings *this_hds = get_hud_display_settings();
    double lat = 0, lon = 0;
 
    SDL_Renderer *renderer = get_sdl_renderer();
-   motion *this_motion = get_motion_dev();
-   gps *this_gps = get_gps_dev();
+   const motion *this_motion = get_latched_motion();
+   const gps *this_gps = get_latched_gps();
 
    /* Get GPS coordinates */
    if (this_gps->latitudeDegrees != 0.0) {
@@ -908,11 +1044,21 @@ void render_map_element(element *curr_element) {
       pthread_mutex_init(&map_data.mutex, NULL);
    }
 
-   snprintf(map_data.url, 512, GOOGLE_MAPS_API, lat, lon,
-         curr_element->width, curr_element->height,
-         MAP_TYPE_STRINGS[curr_element->map_type],
-         curr_element->map_zoom,
-         lat, lon, GOOGLE_API_KEY);
+   /* Hand the download thread our view. It builds the URL and does the rest. */
+   pthread_mutex_lock(&map_data.mutex);
+   map_data.lat = lat;
+   map_data.lon = lon;
+   map_data.heading = this_gps->angle;
+   map_data.speed_knots = this_gps->speed;
+   map_data.width = curr_element->width;
+   map_data.height = curr_element->height;
+   map_data.map_type = curr_element->map_type;
+   map_data.zoom = curr_element->map_zoom;
+   map_data.force_refresh |= curr_element->force_refresh;
+   pthread_mutex_unlock(&map_data.mutex);
+
+   // Reset element's flag after transferring to shared data
+   curr_element->force_refresh = 0;
 
    if (map_thread_started == 0) {
       map_data.update_interval_sec = curr_element->update_interval_sec > 0 ?
@@ -921,7 +1067,7 @@ void render_map_element(element *curr_element) {
       map_data.updated = 0;
       map_data.size = 0;
       map_data.data = NULL;
-      map_data.force_refresh = curr_element->force_refresh;
+      map_data.surface = NULL;
 
       if (pthread_create(&map_download_thread, NULL, image_download_thread, &map_data) != 0) {
          LOG_ERROR("Error creating map download thread.");
@@ -929,52 +1075,42 @@ void render_map_element(element *curr_element) {
       } else {
          map_thread_started = 1;
       }
-   } else {
-      // Update force_refresh flag in the shared data
-      pthread_mutex_lock(&map_data.mutex);
-      map_data.force_refresh |= curr_element->force_refresh;
-      pthread_mutex_unlock(&map_data.mutex);
-
-      // Reset element's flag after transferring to shared data
-      curr_element->force_refresh = 0;
    }
 
-   // Check for new map data with mutex protection
+   // Check for a new decoded map with mutex protection
    pthread_mutex_lock(&map_data.mutex);
+   if (map_data.updated && (map_data.surface != NULL)) {
+      new_surface = map_data.surface;
+      map_data.surface = NULL;
+   }
+   map_data.updated = 0;
+   pthread_mutex_unlock(&map_data.mutex);
 
-   /* Update texture if new map data available */
-   if (map_data.updated && map_data.data != NULL) {
-      // We have new map data, convert to surface and texture
-      //
-      SDL_RWops *rw = SDL_RWFromMem(map_data.data, map_data.size);
-      if (rw != NULL) {
-         // Create the surface in the main thread
-         SDL_Surface *new_surface = IMG_Load_RW(rw, 0);
-         SDL_RWclose(rw);
-
-         if (new_surface != NULL) {
-            // Update the element's texture
-            if (curr_element->texture != NULL) {
-               SDL_DestroyTexture(curr_element->texture);
-               curr_element->texture = NULL;
-            }
+   /* Only the upload happens here, decoding was done by the download thread. */
+   if (new_surface != NULL) {
+      int tex_w = 0, tex_h = 0;
 
-            curr_element->dst_rect.w = new_surface->w;
-            curr_element->dst_rect.h = new_surface->h;
-            curr_element->dst_rect.x = curr_element->dest_x;
-            curr_element->dst_rect.y = curr_element->dest_y;
-            curr_element->texture = SDL_CreateTextureFromSurface(renderer, new_surface);
+      if ((curr_element->texture != NULL) &&
+          ((SDL_QueryTexture(curr_element->texture, NULL, NULL, &tex_w, &tex_h) != 0) ||
+           (tex_w != new_surface->w) || (tex_h != new_surface->h) ||
+           (SDL_UpdateTexture(curr_element->texture, NULL, new_surface->pixels,
+                              new_surface->pitch) != 0))) {
+         SDL_DestroyTexture(curr_element->texture);
+         curr_element->texture = NULL;
+      }
 
-            // Clean up
-            SDL_FreeSurface(new_surface);
-         }
+      if (curr_element->texture == NULL) {
+         curr_element->texture = SDL_CreateTextureFromSurface(renderer, new_surface);
       }
 
-      // Mark as consumed
-      map_data.updated = 0;
-   }
+      curr_element->dst_rect.w = new_surface->w;
+      curr_element->dst_rect.h = new_surface->h;
+      curr_element->dst_rect.x = curr_element->dest_x;
+      curr_element->dst_rect.y = curr_element->dest_y;
 
-   pthread_mutex_unlock(&map_data.mutex);
+      // Clean up
+      SDL_FreeSurface(new_surface);
+   }
 
    /* Set up destination rectangles */
    dst_rect_l.x = dst_rect_r.x = curr_element->dst_rect.x;
@@ -1022,7 +1158,7 @@ void render_pitch_element(element *curr_element) {
     SDL_Rect dst_rect_l, dst_rect_r;
     SDL_Texture *this_texture = NULL;
     hud_display_settings *this_hds = get_hud_display_settings();
-    motion *this_motion = get_motion_dev();
+    const motion *this_motion = get_latched_motion();
    SDL_Renderer *renderer = get_sdl_renderer();
 
     /* Select animation frame based on pitch value */
@@ -1034,7 +1170,8 @@ void render_pitch_element(element *curr_element) {
         frame_index = curr_element->this_anim.frame_count - 1;
 
     /* Get the frame */
-    curr_element->this_anim.current_frame = curr_element->this_anim.frame_lookup[frame_index];
+    curr_element->this_anim.cursor = frame_index;
+    curr_element->this_anim.current_frame = &curr_element->this_anim.frames[frame_index];
 
     /* Set up source rectangle */
     src_rect.x = curr_element->this_anim.current_frame->source_x;
@@ -1090,7 +1227,7 @@ void render_heading_element(element *curr_element) {
     SDL_Rect dst_rect_l, dst_rect_r;
     SDL_Texture *this_texture = NULL;
     hud_display_settings *this_hds = get_hud_display_settings();
-    motion *this_motion = get_motion_dev();
+    const motion *this_motion = get_latched_motion();
     SDL_Renderer *renderer = get_sdl_renderer();
 
     /* Select animation frame based on heading value */
@@ -1103,7 +1240,8 @@ void render_heading_element(element *curr_element) {
         frame_index = curr_element->this_anim.frame_count - 1;
 
     /* Get the frame */
-    curr_element->this_anim.current_frame = curr_element->this_anim.frame_lookup[frame_index];
+    curr_element->this_anim.cursor = frame_index;
+    curr_element->this_anim.current_frame = &curr_element->this_anim.frames[frame_index];
 
     /* Set up source rectangle */
     src_rect.x = curr_element->this_anim.current_frame->source_x;
@@ -1159,8 +1297,8 @@ void render_altitude_element(element *curr_element) {
    SDL_Rect dst_rect_l, dst_rect_r;
    SDL_Texture *this_texture = NULL;
    hud_display_settings *this_hds = get_hud_display_settings();
-   motion *this_motion = get_motion_dev();
-   gps *this_gps = get_gps_dev();
+   const motion *this_motion = get_latched_motion();
+   const gps *this_gps = get_latched_gps();
    SDL_Renderer *renderer = get_sdl_renderer();
 
     /* Select animation frame based on altitude value (in multiples of 10) */
@@ -1175,7 +1313,8 @@ void render_altitude_element(element *curr_element) {
     int frame_index = altitude / 10;
 
     /* Get the frame */
-    curr_element->this_anim.current_frame = curr_element->this_anim.frame_lookup[frame_index];
+    curr_element->this_anim.cursor = frame_index;
+    curr_element->this_anim.current_frame = &curr_element->this_anim.frames[frame_index];
 
     /* Set up source rectangle */
     src_rect.x = curr_element->this_anim.current_frame->source_x;
@@ -1231,7 +1370,7 @@ void render_wifi_element(element *curr_element) {
    SDL_Rect dst_rect_l, dst_rect_r;
    SDL_Texture *this_texture = NULL;
    hud_display_settings *this_hds = get_hud_display_settings();
-   motion *this_motion = get_motion_dev();
+   const motion *this_motion = get_latched_motion();
    SDL_Renderer *renderer = get_sdl_renderer();
 
    /* Get wifi signal level (0-9) */
@@ -1243,7 +1382,8 @@ void render_wifi_element(element *curr_element) {
       signal_level = curr_element->this_anim.frame_count - 1;
 
    /* Get the frame */
-   curr_element->this_anim.current_frame = curr_element->this_anim.frame_lookup[signal_level];
+   curr_element->this_anim.cursor = signal_level;
+   curr_element->this_anim.current_frame = &curr_element->this_anim.frames[signal_level];
 
    /* Set up source rectangle */
    src_rect.x = curr_element->this_anim.current_frame->source_x;
@@ -1296,7 +1436,7 @@ void render_battery_element(element *curr_element) {
    SDL_Rect dst_rect_l, dst_rect_r;
    SDL_Texture *this_texture = NULL;
    hud_display_settings *this_hds = get_hud_display_settings();
-   motion *this_motion = get_motion_dev();
+   const motion *this_motion = get_latched_motion();
    SDL_Renderer *renderer = get_sdl_renderer();
 
    /* Get battery level (0-100) */
@@ -1367,10 +1507,9 @@ void render_armor_display_element(element *curr_element) {
    element *armor_element = this_as->armor_elements;
    time_t current_time = time(NULL);
    SDL_Renderer *renderer = get_sdl_renderer();
-   char text[2048] = "";
    hud_display_settings *this_hds = get_hud_display_settings();
 
-   /* Check for external timeout trigger from registerArmor */
+   /* Check for external timeout trigger from the armor registry */
    if (armor_timeout_trigger > 0) {
       armor_timeout = armor_timeout_trigger;
       armor_timeout_trigger = 0;  /* Clear the trigger */
@@ -1478,20 +1617,7 @@ void render_armor_display_element(element *curr_element) {
          }
       }
 
-      /* Complete deregistration logic with TTS */
-      if (armor_element->mqtt_registered && armor_element->mqtt_last_time > 0 &&
-          ((current_time - this_as->armor_deregister) > armor_element->mqtt_last_time)) {
-         armor_element->mqtt_registered = 0;
-         armor_element->last_temp = armor_element->last_voltage = -1.0;
-         armor_element->warn_state = WARN_NORMAL;
-         armor_element->texture = armor_element->texture_offline;
-
-         time(&armor_timeout);
-         armor_timeout += curr_element->notice_timeout > 0 ? curr_element->notice_timeout : 5;
-
-         snprintf(text, 2048, "%s disconnected.", armor_element->name);
-         mqttTextToSpeech(text);
-      }
+      /* Deregistration is done by armor_check_timeouts() on its own timer. */
 
       /* Select texture based on component status */
       if (armor_element->mqtt_last_time == 0) {
@@ -1499,18 +1625,13 @@ void render_armor_display_element(element *curr_element) {
          texture_to_use = armor_element->texture_base;
       } else if (armor_element->mqtt_registered) {
          /* Currently registered - check for warnings */
-         if ((current_time - armor_element->mqtt_last_time) < this_as->armor_deregister) {
-            if ((armor_element->warning_temp > 0 &&
-                 armor_element->last_temp >= armor_element->warning_temp) ||
-                (armor_element->warning_voltage > 0 &&
-                 armor_element->last_voltage <= armor_element->warning_voltage)) {
-               texture_to_use = armor_element->texture_warning;
-            } else {
-               texture_to_use = armor_element->texture_online;
-            }
+         if ((armor_element->warning_temp > 0 &&
+              armor_element->last_temp >= armor_element->warning_temp) ||
+             (armor_element->warning_voltage > 0 &&
+              armor_element->last_voltage <= armor_element->warning_voltage)) {
+            texture_to_use = armor_element->texture_warning;
          } else {
-            /* Registered but timed out - use offline */
-            texture_to_use = armor_element->texture_offline;
+            texture_to_use = armor_element->texture_online;
          }
       } else {
          /* Was registered but now disconnected - use offline (red) */
@@ -1535,7 +1656,6 @@ void render_armor_display_element(element *curr_element) {
       /* Render metrics if enabled and component is active */
       if (curr_element->show_metrics &&
           armor_element->mqtt_registered &&
-          (current_time - armor_element->mqtt_last_time) < this_as->armor_deregister &&
           component_index < curr_element->metrics_texture_count) {
 
          char metrics_text[64] = "";
@@ -1656,14 +1776,51 @@ void trigger_armor_notification_timeout(int timeout_seconds) {
    armor_timeout_trigger = current_time + timeout_seconds;
 }
 
+/* Order detections by class, most confident first within a class. */
+static int compare_detect_class(const void *a, const void *b)
+{
+   const detect *da = *(const detect * const *) a;
+   const detect *db = *(const detect * const *) b;
+
+   if (da->class_id != db->class_id) {
+      return da->class_id - db->class_id;
+   }
+
+   return (da->confidence < db->confidence) - (da->confidence > db->confidence);
+}
+
+/* Collect the active detections of one eye, sorted into class buckets. */
+static int bucket_detections(detect *eye_detects, detect **sorted)
+{
+   int count = 0;
+
+   for (int i = 0; i < MAX_DETECT; i++) {
+      if (eye_detects[i].active) {
+         sorted[count++] = &eye_detects[i];
+      }
+   }
+   qsort(sorted, count, sizeof(detect *), compare_detect_class);
+
+   return count;
+}
+
 /*
  * This function takes the arrays from the left and right eyes and validates the
  * detections to insure you get graphics in both eyes.
+ *
+ * Only detections of the same class are compared. The cameras are side by side,
+ * so a real match sits on nearly the same row in both eyes, is a similar size and
+ * is shifted horizontally by no more than the maximum disparity.
  */
 void validate_detection(void)
 {
-   int i = 0, j = 0;
+   hud_display_settings *this_hds = get_hud_display_settings();
+   detect *left[MAX_DETECT], *right[MAX_DETECT];
+   int right_used[MAX_DETECT] = { 0 };
+   int left_count = 0, right_count = 0;
    int next_valid = 0;
+   int i = 0, j = 0;
+   float max_disparity = this_hds->cam_frame_width * DETECT_MAX_DISPARITY;
 
    /* Clear the past sorted detecttions. */
    for (i = 0; i < MAX_DETECT; i++) {
@@ -1671,28 +1828,66 @@ void validate_detection(void)
       this_detect_sorted[1][i].active = 0;
    }
 
-   /* Sort through both arrays looking for similar detections on both eyes. */
-   for (i = 0; i < MAX_DETECT; i++) {
-      for (j = 0; j < MAX_DETECT; j++) {
-         if (this_detect[0][i].active && this_detect[1][j].active) {
-#if 1
-            if ((strcmp(this_detect[0][i].description, this_detect[1][j].description) == 0) &&
-                (this_detect[1][j].left > (this_detect[0][i].left * 0.4)) &&
-                (this_detect[1][j].left < (this_detect[0][i].left * 1.6)) &&
-                (this_detect[1][j].top > (this_detect[0][i].top * 0.4)) &&
-                (this_detect[1][j].top < (this_detect[0][i].top * 1.6))) {
-#else
-            if (strcmp(this_detect[0][i].description, this_detect[1][j].description) == 0) {
-#endif
-               memcpy(&this_detect_sorted[0][next_valid], &this_detect[0][i], sizeof(detect));
-               memcpy(&this_detect_sorted[1][next_valid], &this_detect[1][j], sizeof(detect));
-               this_detect[0][i].active = 0;
-               this_detect[1][j].active = 0;
-               next_valid++;
-               break;
+   left_count = bucket_detections(this_detect[0], left);
+   right_count = bucket_detections(this_detect[1], right);
+
+   /* Walk both lists one class bucket at a time. */
+   i = 0;
+   j = 0;
+   while ((i < left_count) && (j < right_count)) {
+      int class_id = left[i]->class_id;
+      int i_end = i, j_end = j;
+
+      if (class_id < right[j]->class_id) {
+         i++;
+         continue;
+      } else if (class_id > right[j]->class_id) {
+         j++;
+         continue;
+      }
+
+      while ((i_end < left_count) && (left[i_end]->class_id == class_id)) {
+         i_end++;
+      }
+      while ((j_end < right_count) && (right[j_end]->class_id == class_id)) {
+         j_end++;
+      }
+
+      /* Most confident left detections choose first. */
+      for (int l = i; l < i_end; l++) {
+         float l_cy = left[l]->top + left[l]->height / 2.0f;
+         float best_cost = 0.0f;
+         int best = -1;
+
+         for (int r = j; r < j_end; r++) {
+            float dy = fabsf(right[r]->top + right[r]->height / 2.0f - l_cy);
+            float disparity = left[l]->left - right[r]->left;
+            float size_ratio = right[r]->height / left[l]->height;
+            float cost = 0.0f;
+
+            if (right_used[r] || (dy > left[l]->height * DETECT_EPIPOLAR_TOL) ||
+                (fabsf(disparity) > max_disparity) ||
+                (size_ratio < 0.67f) || (size_ratio > 1.5f)) {
+               continue;
             }
+
+            cost = dy + fabsf(right[r]->width - left[l]->width);
+            if ((best < 0) || (cost < best_cost)) {
+               best_cost = cost;
+               best = r;
+            }
+         }
+
+         if (best >= 0) {
+            this_detect_sorted[0][next_valid] = *left[l];
+            this_detect_sorted[1][next_valid] = *right[best];
+            right_used[best] = 1;
+            next_valid++;
          }
       }
+
+      i = i_end;
+      j = j_end;
    }
 
    /* Clear the detections from the original arrays. */
@@ -1709,29 +1904,30 @@ void render_detect_element(element *curr_element) {
     int r_offset = 0, l_offset = 0;
     hud_display_settings *this_hds = get_hud_display_settings();
     SDL_Renderer *renderer = get_sdl_renderer();
+    detect tracked[2][MAX_DETECT];
+    unsigned long detect_ns = 0, display_ns = 0;
 
     if (curr_element->texture == NULL) {
-        LOG_INFO("Loading animation source: %s", curr_element->this_anim.image);
-        curr_element->texture = get_cached_texture(curr_element->this_anim.image);
+        if (curr_element->this_anim.sheet == NULL) {
+            return;
+        }
+        LOG_INFO("Loading animation source: %s", curr_element->this_anim.sheet->image);
+        curr_element->texture = acquire_element_texture(curr_element, ELEMENT_TEXTURE_SHEET);
         if (!curr_element->texture) {
-            SDL_Log("Couldn't load %s: %s\n", curr_element->this_anim.image, SDL_GetError());
+            SDL_Log("Couldn't load %s: %s\n", curr_element->this_anim.sheet->image, SDL_GetError());
             return;
         }
         SDL_SetTextureAlphaMod(curr_element->texture, 255);
     }
 
-    /* Check for valid detection data */
-    if (oddataL.complete != 1 || oddataL.pix_data == NULL ||
-        oddataR.complete != 1 || oddataR.pix_data == NULL) {
-        return;
+    /* Feed any newly finished detections to the tracker, then draw its
+     * prediction for the frame on screen. */
+    if (detect_worker_fetch(this_detect, &detect_ns)) {
+        validate_detection();
+        tracker_update(this_detect_sorted, detect_ns);
     }
-
-    /* Update detection data */
-    pthread_join(od_L_thread, NULL);
-    pthread_join(od_R_thread, NULL);
-    validate_detection();
-    oddataL.processed = 1;
-    oddataR.processed = 1;
+    display_ns = get_displayed_frame_ns();
+    tracker_predict(display_ns != 0 ? display_ns : latency_now_ns(), tracked);
 
     /* Render each detected object */
     for (int j = 0; j < MAX_DETECT; j++) {
@@ -1746,29 +1942,29 @@ void render_detect_element(element *curr_element) {
         detect_src_r.w = curr_element->this_anim.current_frame->source_w;
         detect_src_r.h = curr_element->this_anim.current_frame->source_h;
 
-        if (this_detect_sorted[0][j].active && this_detect_sorted[1][j].active) {
+        if (tracked[0][j].active && tracked[1][j].active) {
             /* Set up detection box positions */
             dst_rect_l.x =
-                this_detect_sorted[0][j].left + (this_detect_sorted[0][j].width / 2) -
+                tracked[0][j].left + (tracked[0][j].width / 2) -
                 (curr_element->this_anim.current_frame->source_size_w / 2) +
                 curr_element->this_anim.current_frame->dest_x -
-                this_hds->cam_crop_x + curr_element->center_x_offset;
+                this_hds->cam_frame_crop_x + curr_element->center_x_offset;
 
             dst_rect_l.y =
-                this_detect_sorted[0][j].top + (this_detect_sorted[0][j].height / 2) -
+                tracked[0][j].top + (tracked[0][j].height / 2) -
                 (curr_element->this_anim.current_frame->source_size_h / 2) +
                 curr_element->this_anim.current_frame->dest_y +
                 curr_element->center_y_offset;
 
             dst_rect_r.x =
                 this_hds->eye_output_width +
-                this_detect_sorted[1][j].left + (this_detect_sorted[1][j].width / 2) -
+                tracked[1][j].left + (tracked[1][j].width / 2) -
                 (curr_element->this_anim.current_frame->source_size_w / 2) +
                 curr_element->this_anim.current_frame->dest_x -
-                this_hds->cam_crop_x + curr_element->center_x_offset;
+                this_hds->cam_frame_crop_x + curr_element->center_x_offset;
 
             dst_rect_r.y =
-                this_detect_sorted[1][j].top + (this_detect_sorted[1][j].height / 2) -
+                tracked[1][j].top + (tracked[1][j].height / 2) -
                 (curr_element->this_anim.current_frame->source_size_h / 2) +
                 curr_element->this_anim.current_frame->dest_y +
                 curr_element->center_y_offset;
@@ -1795,14 +1991,21 @@ void render_detect_element(element *curr_element) {
                 r_offset = 0;
             }
 
-            /* Render detection boxes */
-            SDL_RenderCopy(renderer, curr_element->texture, &detect_src_l, &dst_rect_l);
-            SDL_RenderCopy(renderer, curr_element->texture, &detect_src_r, &dst_rect_r);
+            /* Render detection boxes, these place each eye themselves */
+            hud_eye_layer_pause();
+            if (texture_atlas_draw(curr_element->texture, &detect_src_l, &dst_rect_l) != SUCCESS) {
+                texture_atlas_flush();
+                SDL_RenderCopy(renderer, curr_element->texture, &detect_src_l, &dst_rect_l);
+            }
+            if (texture_atlas_draw(curr_element->texture, &detect_src_r, &dst_rect_r) != SUCCESS) {
+                texture_atlas_flush();
+                SDL_RenderCopy(renderer, curr_element->texture, &detect_src_r, &dst_rect_r);
+            }
 
             /* Render text labels for detections */
             curr_element->surface =
                 TTF_RenderText_Blended(curr_element->ttf_font,
-                                       this_detect_sorted[0][j].description,
+                                       detect_class_desc(tracked[0][j].class_id),
                                        curr_element->font_color);
             if (curr_element->surface != NULL) {
                 detect_text_texture = SDL_CreateTextureFromSurface(renderer, curr_element->surface);
@@ -1814,23 +2017,23 @@ void render_detect_element(element *curr_element) {
 
                 /* Position text labels */
                 dst_rect_l.x =
-                    this_detect_sorted[0][j].left + (this_detect_sorted[0][j].width / 2) -
+                    tracked[0][j].left + (tracked[0][j].width / 2) -
                     (curr_element->this_anim.current_frame->source_size_w / 2) -
-                    this_hds->cam_crop_x + curr_element->center_x_offset + curr_element->text_x_offset;
+                    this_hds->cam_frame_crop_x + curr_element->center_x_offset + curr_element->text_x_offset;
 
                 dst_rect_l.y =
-                    this_detect_sorted[0][j].top + (this_detect_sorted[0][j].height / 2) -
+                    tracked[0][j].top + (tracked[0][j].height / 2) -
                     (curr_element->this_anim.current_frame->source_size_h / 2) +
                     curr_element->center_y_offset + curr_element->text_y_offset;
 
                 dst_rect_r.x =
                     this_hds->eye_output_width +
-                    this_detect_sorted[1][j].left + (this_detect_sorted[1][j].width / 2) -
+                    tracked[1][j].left + (tracked[1][j].width / 2) -
                     (curr_element->this_anim.current_frame->source_size_w / 2) -
-                    this_hds->cam_crop_x + curr_element->center_x_offset + curr_element->text_x_offset;
+                    this_hds->cam_frame_crop_x + curr_element->center_x_offset + curr_element->text_x_offset;
 
                 dst_rect_r.y =
-                    this_detect_sorted[1][j].top + (this_detect_sorted[1][j].height / 2) -
+                    tracked[1][j].top + (tracked[1][j].height / 2) -
                     (curr_element->this_anim.current_frame->source_size_h / 2) +
                     curr_element->center_y_offset + curr_element->text_y_offset;
 
@@ -1845,6 +2048,7 @@ void render_detect_element(element *curr_element) {
                 }
 
                 /* Render detection text labels */
+                texture_atlas_flush();
                 SDL_RenderCopy(renderer, detect_text_texture, &detect_src_l, &dst_rect_l);
                 SDL_RenderCopy(renderer, detect_text_texture, &detect_src_r, &dst_rect_r);
 
@@ -1865,11 +2069,7 @@ void render_detect_element(element *curr_element) {
 
     if (framesToUpdate > 0) {
         if ((currTime % (int)ceil((double)curr_fps / curr_element->this_anim.frame_count)) == 0) {
-            if (curr_element->this_anim.current_frame->next != NULL) {
-                curr_element->this_anim.current_frame = curr_element->this_anim.current_frame->next;
-            } else {
-                curr_element->this_anim.current_frame = curr_element->this_anim.first_frame;
-            }
+            advance_animation(&curr_element->this_anim);
         }
         curr_element->this_anim.last_update = currTime;
     }
@@ -1877,10 +2077,16 @@ void render_detect_element(element *curr_element) {
 
 /* Main element rendering dispatcher */
 void render_element(element *curr_element) {
+   unsigned long profile_start_ns = 0;
+
    if (!curr_element->enabled) {
       return;
    }
 
+   if (render_profiler_active()) {
+      profile_start_ns = latency_now_ns();
+   }
+
    switch (curr_element->type) {
       case STATIC:
          render_static_element(curr_element);
@@ -1898,6 +2104,10 @@ void render_element(element *curr_element) {
          LOG_ERROR("Unknown element type: %d", curr_element->type);
          break;
    }
+
+   if (profile_start_ns != 0) {
+      render_profiler_record(curr_element, profile_start_ns);
+   }
 }
 
 /* The rest of the helper functions remain similar */
@@ -1997,19 +2207,122 @@ void render_element_with_scale(element *curr_element, float scale, float alpha)
    curr_element->scale = original_scale;
 }
 
+/* Draw every element of a list with one of the render functions. */
+static void render_draw_list(const hud_draw_list *list) {
+   for (int i = 0; i < list->count; i++) {
+      render_element(list->elements[i]);
+   }
+}
+
+static void render_draw_list_with_alpha(const hud_draw_list *list, float alpha) {
+   for (int i = 0; i < list->count; i++) {
+      render_element_with_alpha(list->elements[i], alpha);
+   }
+}
+
+static void render_draw_list_with_slide(const hud_draw_list *list, int offset_x, int offset_y) {
+   for (int i = 0; i < list->count; i++) {
+      render_element_with_slide(list->elements[i], offset_x, offset_y);
+   }
+}
+
+static void render_draw_list_with_scale(const hud_draw_list *list, float scale, float alpha) {
+   for (int i = 0; i < list->count; i++) {
+      render_element_with_scale(list->elements[i], scale, alpha);
+   }
+}
+
+/* Draw the outgoing and incoming elements into the transition layers once. */
+static int capture_transition_layers(const hud_transition_lists *lists) {
+   if (hud_layer_begin(HUD_LAYER_FROM) != SUCCESS) {
+      return FAILURE;
+   }
+   render_draw_list(&lists->from_only);
+   hud_layer_end();
+
+   if (hud_layer_begin(HUD_LAYER_TO) != SUCCESS) {
+      return FAILURE;
+   }
+   render_draw_list(&lists->to_only);
+   hud_layer_end();
+
+   return SUCCESS;
+}
+
+/* Animate a transition by drawing the captured layers as whole images. */
+static void render_transition_layers(hud_manager *hud_mgr, const hud_transition_lists *lists) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   float progress = hud_mgr->transition_progress;
+
+   switch (hud_mgr->transition_type) {
+      case TRANSITION_SLIDE_LEFT:
+         render_draw_list(&lists->shared);
+         hud_layer_draw(HUD_LAYER_FROM, 1.0f, (int)(-progress * this_hds->eye_output_width), 1.0f);
+         hud_layer_draw(HUD_LAYER_TO, 1.0f, (int)((1.0f - progress) * this_hds->eye_output_width), 1.0f);
+         break;
+
+      case TRANSITION_SLIDE_RIGHT:
+         render_draw_list(&lists->shared);
+         hud_layer_draw(HUD_LAYER_FROM, 1.0f, (int)(progress * this_hds->eye_output_width), 1.0f);
+         hud_layer_draw(HUD_LAYER_TO, 1.0f, (int)(-(1.0f - progress) * this_hds->eye_output_width), 1.0f);
+         break;
+
+      case TRANSITION_ZOOM:
+         hud_layer_draw(HUD_LAYER_FROM, 1.0f - progress, 0, 1.0f + progress);
+         hud_layer_draw(HUD_LAYER_TO, progress, 0, 2.0f - progress);
+         render_draw_list(&lists->shared);
+         break;
+
+      case TRANSITION_FADE:
+      default:
+         hud_layer_draw(HUD_LAYER_FROM, 1.0f - progress, 0, 1.0f);
+         hud_layer_draw(HUD_LAYER_TO, progress, 0, 1.0f);
+         render_draw_list(&lists->shared);
+         break;
+   }
+}
+
 /* Main HUD rendering function */
 void render_hud_elements(void) {
-   element *curr_element = NULL;
+   /* The transition the layers were captured for. */
+   static Uint32 layers_start_time = 0;
+   static int layers_from_id = -1;
+   static int layers_to_id = -1;
+   static int layers_ready = 0;
+
    hud_manager *hud_mgr = get_hud_manager();
    hud_display_settings *this_hds = get_hud_display_settings();
-   element *first_element = get_first_element();
+   const hud_transition_lists *lists = NULL;
+
+   /* No-op unless the layout changed. */
+   update_hud_draw_lists();
+   render_profiler_frame();
 
    if (hud_mgr->transition_from != NULL) {
-      /* We need to reset text elements on the beginning of the transition. */
-      curr_element = first_element;
-      while (curr_element != NULL) {
-         curr_element->last_rendered_text[0] = '\0';
-         curr_element = curr_element->next;
+      /* Every transition frame differs from the last. */
+      hud_mark_damaged();
+
+      lists = get_hud_transition_lists(hud_mgr->transition_from->hud_id,
+                                       hud_mgr->current_screen->hud_id);
+
+      /* Capture both HUDs once when a transition starts. */
+      if ((layers_start_time != hud_mgr->transition_start_time) ||
+          (layers_from_id != hud_mgr->transition_from->hud_id) ||
+          (layers_to_id != hud_mgr->current_screen->hud_id)) {
+         layers_start_time = hud_mgr->transition_start_time;
+         layers_from_id = hud_mgr->transition_from->hud_id;
+         layers_to_id = hud_mgr->current_screen->hud_id;
+         layers_ready = (capture_transition_layers(lists) == SUCCESS);
+      }
+
+      /* Without layers, every element is redrawn with the effect. */
+      if (!layers_ready) {
+         /* We need to reset text elements on the beginning of the transition. */
+         for (int i = 0; i < lists->all.count; i++) {
+            if (lists->all.elements[i]->last_rendered_text != NULL) {
+               lists->all.elements[i]->last_rendered_text[0] = '\0';
+            }
+         }
       }
 
       /* In transition between HUDs */
@@ -2027,13 +2340,9 @@ void render_hud_elements(void) {
          hud_mgr->transition_progress = 0.0;
 
          /* Render current HUD normally */
-         curr_element = first_element;
-         while (curr_element != NULL) {
-            if (curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-               render_element(curr_element);
-            }
-            curr_element = curr_element->next;
-         }
+         render_draw_list(get_hud_draw_list(hud_mgr->current_screen->hud_id));
+      } else if (layers_ready) {
+         render_transition_layers(hud_mgr, lists);
       } else {
          /* We're in the middle of a transition */
          float from_alpha = 1.0f - hud_mgr->transition_progress;
@@ -2048,34 +2357,13 @@ void render_hud_elements(void) {
 
             case TRANSITION_FADE: {
                /* Render elements from the previous HUD that aren't in the new HUD */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      !curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element_with_alpha(curr_element, from_alpha);
-                  }
-                  curr_element = curr_element->next;
-               }
+               render_draw_list_with_alpha(&lists->from_only, from_alpha);
 
                /* Render elements from the new HUD that aren't in the old HUD */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (!curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element_with_alpha(curr_element, to_alpha);
-                  }
-                  curr_element = curr_element->next;
-               }
+               render_draw_list_with_alpha(&lists->to_only, to_alpha);
 
                /* Render elements that are in both HUDs */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element(curr_element);
-                  }
-                  curr_element = curr_element->next;
-               }
+               render_draw_list(&lists->shared);
                break;
             }
 
@@ -2084,128 +2372,57 @@ void render_hud_elements(void) {
                int to_offset = (int)((1.0f - hud_mgr->transition_progress) * this_hds->eye_output_width);
 
                /* First, render the shared elements that appear in both HUDs normally */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element(curr_element);
-                  }
-                     curr_element = curr_element->next;
-               }
+               render_draw_list(&lists->shared);
 
                /* Then render "from" HUD sliding left (only elements not in new HUD) */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      !curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element_with_slide(curr_element, from_offset, 0);
-                  }
-                  curr_element = curr_element->next;
-               }
+               render_draw_list_with_slide(&lists->from_only, from_offset, 0);
 
                /* Finally render "to" HUD sliding in from right (only elements not in old HUD) */
-               curr_element = first_element;
-               while (curr_element != NULL) {
-                  if (!curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                      curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                     render_element_with_slide(curr_element, to_offset, 0);
-                  }
-                  curr_element = curr_element->next;
-                }
-                break;
-             }
-
-             case TRANSITION_SLIDE_RIGHT: {
-                int from_offset = (int)((hud_mgr->transition_progress) * this_hds->eye_output_width);
-                int to_offset = (int)(-(1.0f - hud_mgr->transition_progress) * this_hds->eye_output_width);
-
-                /* First, render the shared elements that appear in both HUDs normally */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element(curr_element);
-                   }
-                   curr_element = curr_element->next;
-                }
+               render_draw_list_with_slide(&lists->to_only, to_offset, 0);
+               break;
+            }
 
-                /* Then render "from" HUD sliding right (only elements not in new HUD) */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       !curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element_with_slide(curr_element, from_offset, 0);
-                   }
-                   curr_element = curr_element->next;
-                }
+            case TRANSITION_SLIDE_RIGHT: {
+               int from_offset = (int)((hud_mgr->transition_progress) * this_hds->eye_output_width);
+               int to_offset = (int)(-(1.0f - hud_mgr->transition_progress) * this_hds->eye_output_width);
 
-                /* Finally render "to" HUD sliding in from left (only elements not in old HUD) */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (!curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element_with_slide(curr_element, to_offset, 0);
-                   }
-                   curr_element = curr_element->next;
-                }
-                break;
-             }
-
-             case TRANSITION_ZOOM: {
-                float from_scale = 1.0f + hud_mgr->transition_progress;
-                float to_scale = 2.0f - hud_mgr->transition_progress;
-
-                /* Render elements from previous HUD zooming out */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       !curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element_with_scale(curr_element, from_scale, from_alpha);
-                   }
-                   curr_element = curr_element->next;
-                }
+               /* First, render the shared elements that appear in both HUDs normally */
+               render_draw_list(&lists->shared);
 
-                /* Render elements from new HUD zooming in */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (!curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element_with_scale(curr_element, to_scale, to_alpha);
-                   }
-                   curr_element = curr_element->next;
-                }
+               /* Then render "from" HUD sliding right (only elements not in new HUD) */
+               render_draw_list_with_slide(&lists->from_only, from_offset, 0);
 
-                /* Render elements that are in both HUDs normally */
-                curr_element = first_element;
-                while (curr_element != NULL) {
-                   if (curr_element->hud_flags[hud_mgr->transition_from->hud_id] &&
-                       curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                      render_element(curr_element);
-                   }
-                   curr_element = curr_element->next;
-                }
-                break;
-             }
-          }
-
-          /* Reset transition states in all elements */
-          /* Reset all texture alphas after transition rendering */
-          curr_element = first_element;
-          while (curr_element != NULL) {
-             curr_element->in_transition = 0;
-             curr_element->transition_alpha = 0.0f;
-             curr_element = curr_element->next;
-          }
-       }
-    } else {
-        /* Normal rendering - just the current HUD */
-        curr_element = first_element;
-        while (curr_element != NULL) {
-            if (curr_element->hud_flags[hud_mgr->current_screen->hud_id]) {
-                render_element(curr_element);
+               /* Finally render "to" HUD sliding in from left (only elements not in old HUD) */
+               render_draw_list_with_slide(&lists->to_only, to_offset, 0);
+               break;
             }
-            curr_element = curr_element->next;
-        }
-    }
+
+            case TRANSITION_ZOOM: {
+               float from_scale = 1.0f + hud_mgr->transition_progress;
+               float to_scale = 2.0f - hud_mgr->transition_progress;
+
+               /* Render elements from previous HUD zooming out */
+               render_draw_list_with_scale(&lists->from_only, from_scale, from_alpha);
+
+               /* Render elements from new HUD zooming in */
+               render_draw_list_with_scale(&lists->to_only, to_scale, to_alpha);
+
+               /* Render elements that are in both HUDs normally */
+               render_draw_list(&lists->shared);
+               break;
+            }
+         }
+
+         /* Reset transition states in all elements */
+         /* Reset all texture alphas after transition rendering */
+         for (int i = 0; i < lists->all.count; i++) {
+            lists->all.elements[i]->in_transition = 0;
+            lists->all.elements[i]->transition_alpha = 0.0f;
+         }
+      }
+   } else {
+      /* Normal rendering - just the current HUD */
+      render_draw_list(get_hud_draw_list(hud_mgr->current_screen->hud_id));
+   }
 }
 
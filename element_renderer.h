@@ -46,6 +46,9 @@ void render_battery_element(element *curr_element);
 void render_detect_element(element *curr_element);
 void render_armor_display_element(element *curr_element);
 
+/* Pairs this_detect across eyes into this_detect_sorted. */
+void validate_detection(void);
+
 void trigger_armor_notification_timeout(int timeout_seconds);
 
 /* Element rendering with effects */
@@ -60,4 +63,7 @@ void render_hud_elements(void);
 /* Extra Cleanups */
 void cleanup_fan_monitoring(void);
 
+/* Free the cached *LOG* console line textures. Call before destroying the renderer. */
+void log_console_cleanup(void);
+
 #endif /* ELEMENT_RENDERER_H */
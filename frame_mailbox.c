@@ -0,0 +1,100 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdio.h>
+
+#include "frame_mailbox.h"
+
+#define FRAME_MAILBOX_INDEX_MASK 0x3
+
+void frame_mailbox_init(frame_mailbox *mb)
+{
+   mb->back = 0;
+   mb->front = -1;
+   atomic_init(&mb->ready, 1);
+   atomic_init(&mb->published, 0);
+   atomic_init(&mb->dropped, 0);
+   atomic_init(&mb->consumed, 0);
+   atomic_init(&mb->reused, 0);
+}
+
+int frame_mailbox_back(frame_mailbox *mb)
+{
+   return mb->back;
+}
+
+int frame_mailbox_publish(frame_mailbox *mb)
+{
+   /* Release: the payload writes must be visible before the index is. */
+   int prev = atomic_exchange_explicit(&mb->ready, mb->back | FRAME_MAILBOX_FRESH,
+                                       memory_order_acq_rel);
+
+   if (prev & FRAME_MAILBOX_FRESH) {
+      atomic_fetch_add_explicit(&mb->dropped, 1, memory_order_relaxed);
+   }
+   atomic_fetch_add_explicit(&mb->published, 1, memory_order_relaxed);
+
+   mb->back = prev & FRAME_MAILBOX_INDEX_MASK;
+
+   return mb->back;
+}
+
+int frame_mailbox_acquire(frame_mailbox *mb, int *fresh)
+{
+   int prev = 0;
+
+   if (fresh != NULL) {
+      *fresh = 0;
+   }
+
+   if (!(atomic_load_explicit(&mb->ready, memory_order_acquire) & FRAME_MAILBOX_FRESH)) {
+      if (mb->front >= 0) {
+         atomic_fetch_add_explicit(&mb->reused, 1, memory_order_relaxed);
+      }
+      return mb->front;
+   }
+
+   /* Hand our old front back and take the ready slot. On the very first
+    * acquire we have no front yet, so give the producer's initial spare. */
+   prev = atomic_exchange_explicit(&mb->ready, mb->front >= 0 ? mb->front : 2,
+                                   memory_order_acq_rel);
+   mb->front = prev & FRAME_MAILBOX_INDEX_MASK;
+
+   atomic_fetch_add_explicit(&mb->consumed, 1, memory_order_relaxed);
+   if (fresh != NULL) {
+      *fresh = 1;
+   }
+
+   return mb->front;
+}
+
+int frame_mailbox_current(frame_mailbox *mb)
+{
+   return mb->front;
+}
+
+void frame_mailbox_get_stats(frame_mailbox *mb, frame_mailbox_stats *stats)
+{
+   stats->published = atomic_load_explicit(&mb->published, memory_order_relaxed);
+   stats->dropped = atomic_load_explicit(&mb->dropped, memory_order_relaxed);
+   stats->consumed = atomic_load_explicit(&mb->consumed, memory_order_relaxed);
+   stats->reused = atomic_load_explicit(&mb->reused, memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <stdatomic.h>
+
+/* Lock-free single producer, single consumer "latest value" mailbox.
+ *
+ * This is a classic triple buffer. The mailbox only hands out slot indices;
+ * the caller owns an array of FRAME_MAILBOX_SLOTS payloads. At any time one
+ * slot belongs to the producer (back), one to the consumer (front) and one
+ * is parked as the most recently published (ready). Publishing and acquiring
+ * are a single atomic exchange each, so neither side ever waits on the other.
+ */
+
+#define FRAME_MAILBOX_SLOTS 3
+#define FRAME_MAILBOX_FRESH 0x4     /* Set on the ready index when not yet consumed. */
+
+typedef struct {
+   atomic_int ready;                /* Ready slot index, OR'd with FRAME_MAILBOX_FRESH. */
+   int back;                        /* Producer owned slot. */
+   int front;                       /* Consumer owned slot. -1 until first acquire. */
+
+   atomic_ulong published;          /* Frames published by the producer. */
+   atomic_ulong dropped;            /* Frames overwritten before the consumer saw them. */
+   atomic_ulong consumed;           /* New frames picked up by the consumer. */
+   atomic_ulong reused;             /* Consumer asked and had to reuse the last frame. */
+} frame_mailbox;
+
+/* Snapshot of the mailbox counters. */
+typedef struct {
+   unsigned long published;
+   unsigned long dropped;
+   unsigned long consumed;
+   unsigned long reused;
+} frame_mailbox_stats;
+
+/**
+ * @brief Resets the mailbox. Not thread safe; call before starting the producer.
+ */
+void frame_mailbox_init(frame_mailbox *mb);
+
+/**
+ * @brief Returns the slot the producer should fill next.
+ */
+int frame_mailbox_back(frame_mailbox *mb);
+
+/**
+ * @brief Publishes the producer's back slot as the latest frame.
+ *
+ * @return The slot the producer now owns. Whatever it holds is stale and may
+ *         be released and refilled.
+ */
+int frame_mailbox_publish(frame_mailbox *mb);
+
+/**
+ * @brief Acquires the newest published slot for the consumer.
+ *
+ * @param mb    The mailbox.
+ * @param fresh Optional. Set to 1 if the slot is new since the last acquire.
+ * @return The slot index, or -1 if nothing has been published yet.
+ */
+int frame_mailbox_acquire(frame_mailbox *mb, int *fresh);
+
+/**
+ * @brief Returns the consumer's current slot without advancing. Consumer only.
+ *
+ * @return The slot index, or -1 if nothing has been acquired yet.
+ */
+int frame_mailbox_current(frame_mailbox *mb);
+
+/**
+ * @brief Copies the counters. Safe to call from any thread.
+ */
+void frame_mailbox_get_stats(frame_mailbox *mb, frame_mailbox_stats *stats);
+
+#endif /* FRAME_MAILBOX_H */
@@ -0,0 +1,245 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "frame_pacer.h"
+#include "latency_stats.h"
+#include "sensor_store.h"
+
+/* The pacer is only touched from the render thread. */
+static unsigned long period_ns = 1000000000UL / FRAME_PACER_DEFAULT_HZ;
+static unsigned long cost_ns = 0;
+static unsigned long last_vsync_ns = 0;
+static unsigned long target_vsync_ns = 0;
+static unsigned long frame_start_ns = 0;
+static unsigned long frames = 0;
+static unsigned long missed = 0;
+
+/* The two most recent IMU samples. Written by the command threads, read lock-free. */
+typedef struct {
+   motion pose;
+   unsigned long time_ns;
+} pose_sample;
+
+static pthread_mutex_t pose_mutex = PTHREAD_MUTEX_INITIALIZER;   /* Writers only. */
+static seqlock pose_lock;
+static pose_sample pose_samples[2];
+static int pose_newest = -1;
+static motion latched_pose;
+
+void frame_pacer_init(int refresh_hz)
+{
+   if (refresh_hz <= 0) {
+      refresh_hz = FRAME_PACER_DEFAULT_HZ;
+   }
+
+   period_ns = 1000000000UL / refresh_hz;
+   cost_ns = period_ns / 2;
+   last_vsync_ns = 0;
+}
+
+static void sleep_until_ns(unsigned long wake_ns)
+{
+   struct timespec ts;
+
+   ts.tv_sec = wake_ns / 1000000000UL;
+   ts.tv_nsec = wake_ns % 1000000000UL;
+   /* Retry only when a signal cut the sleep short, anything else won't get better. */
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+   }
+}
+
+unsigned long frame_pacer_wait(int enabled, unsigned long margin_ns)
+{
+   unsigned long now = latency_now_ns();
+   unsigned long target = 0;
+   unsigned long wake = 0;
+
+   if (last_vsync_ns == 0) {
+      /* Nothing presented yet, so we have no phase to work from. */
+      target_vsync_ns = now + period_ns;
+      frame_start_ns = now;
+      return target_vsync_ns;
+   }
+
+   /* First vsync we can still make given what a frame usually costs. */
+   target = last_vsync_ns + period_ns;
+   while (target < now + cost_ns + margin_ns) {
+      target += period_ns;
+   }
+   target_vsync_ns = target;
+
+   if (enabled) {
+      wake = target - cost_ns - margin_ns;
+      if (wake > now + FRAME_PACER_MIN_SLEEP_NS) {
+         sleep_until_ns(wake);
+      }
+   }
+
+   frame_start_ns = latency_now_ns();
+
+   return target_vsync_ns;
+}
+
+void frame_pacer_presented(unsigned long present_start_ns)
+{
+   unsigned long now = latency_now_ns();
+   unsigned long sample = 0;
+   unsigned long interval = 0;
+
+   /* With vsync, present returns just after the flip, which is as close to the
+    * vsync time as we can observe. */
+   if (last_vsync_ns != 0) {
+      interval = now - last_vsync_ns;
+      /* Only refine the period from back to back frames. */
+      if ((interval > period_ns / 2) && (interval < period_ns + period_ns / 2)) {
+         period_ns = period_ns - (period_ns >> FRAME_PACER_COST_SHIFT) +
+                     (interval >> FRAME_PACER_COST_SHIFT);
+      }
+   }
+
+   if ((frame_start_ns != 0) && (present_start_ns > frame_start_ns)) {
+      sample = present_start_ns - frame_start_ns;
+      /* Grow quickly on a slow frame, shrink slowly. Missing is worse than waking early. */
+      if (sample > cost_ns) {
+         cost_ns = sample;
+      } else {
+         cost_ns = cost_ns - (cost_ns >> FRAME_PACER_COST_SHIFT) +
+                   (sample >> FRAME_PACER_COST_SHIFT);
+      }
+   }
+
+   if ((target_vsync_ns != 0) && (now > target_vsync_ns + period_ns / 2)) {
+      missed++;
+   }
+   frames++;
+
+   last_vsync_ns = now;
+}
+
+void frame_pacer_get_stats(frame_pacer_stats *stats)
+{
+   stats->frames = frames;
+   stats->missed = missed;
+   stats->period_ms = (double) period_ns / 1000000.0;
+   stats->render_cost_ms = (double) cost_ns / 1000000.0;
+
+   missed = 0;
+   frames = 0;
+}
+
+void pose_record_sample(const motion *sample)
+{
+   unsigned long now = latency_now_ns();
+
+   pthread_mutex_lock(&pose_mutex);
+   seqlock_write_begin(&pose_lock);
+   /* Queued messages arrive back to back. Replace the newest sample rather than
+    * pair it with one microseconds older, their delta isn't a real rate. */
+   if ((pose_newest < 0) ||
+       (now - pose_samples[pose_newest].time_ns >= POSE_SAMPLE_MIN_MS * 1000000UL)) {
+      pose_newest = (pose_newest + 1) & 1;
+   }
+   pose_samples[pose_newest].pose = *sample;
+   pose_samples[pose_newest].time_ns = now;
+   seqlock_write_end(&pose_lock);
+   pthread_mutex_unlock(&pose_mutex);
+}
+
+/* Shortest signed difference between two angles in degrees. */
+static double angle_delta(double to, double from)
+{
+   double delta = fmod(to - from, 360.0);
+
+   if (delta > 180.0) {
+      delta -= 360.0;
+   } else if (delta < -180.0) {
+      delta += 360.0;
+   }
+
+   return delta;
+}
+
+void pose_latch(unsigned long target_ns, int predict)
+{
+   pose_sample newest, prev;
+   int have_prev = 0;
+   double dt = 0.0;
+   double ahead = 0.0;
+   unsigned int seq = 0;
+   int newest_index = -1;
+
+   do {
+      seq = seqlock_read_begin(&pose_lock);
+      newest_index = pose_newest;
+      if (newest_index >= 0) {
+         newest = pose_samples[newest_index];
+         prev = pose_samples[!newest_index];
+      }
+   } while (seqlock_read_retry(&pose_lock, seq));
+
+   if (newest_index < 0) {
+      return;
+   }
+   have_prev = (prev.time_ns != 0);
+
+   latched_pose = newest.pose;
+
+   if (!predict || !have_prev || (newest.time_ns <= prev.time_ns) || (target_ns <= newest.time_ns)) {
+      return;
+   }
+
+   dt = (double) (newest.time_ns - prev.time_ns) / 1000000.0;
+   ahead = (double) (target_ns - newest.time_ns) / 1000000.0;
+   if ((dt < POSE_SAMPLE_MIN_MS) || (dt > POSE_SAMPLE_STALE_MS) || (ahead > POSE_SAMPLE_STALE_MS)) {
+      return;
+   }
+   if (ahead > POSE_PREDICT_MAX_MS) {
+      ahead = POSE_PREDICT_MAX_MS;
+   }
+
+   latched_pose.heading += angle_delta(newest.pose.heading, prev.pose.heading) / dt * ahead;
+   latched_pose.heading = fmod(latched_pose.heading + 360.0, 360.0);
+
+   latched_pose.roll += angle_delta(newest.pose.roll, prev.pose.roll) / dt * ahead;
+   if (latched_pose.roll > 180.0) {
+      latched_pose.roll -= 360.0;
+   } else if (latched_pose.roll < -180.0) {
+      latched_pose.roll += 360.0;
+   }
+
+   latched_pose.pitch += (newest.pose.pitch - prev.pose.pitch) / dt * ahead;
+   if (latched_pose.pitch > 90.0) {
+      latched_pose.pitch = 90.0;
+   } else if (latched_pose.pitch < -90.0) {
+      latched_pose.pitch = -90.0;
+   }
+}
+
+const motion *get_latched_motion(void)
+{
+   return &latched_pose;
+}
@@ -0,0 +1,103 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "config_parser.h"
+#include "devices.h"
+
+/* Frame pacing and late latched pose.
+ *
+ * The pacer watches when presents return to predict the next vsync and keeps
+ * a running estimate of how long a frame takes to build. Before a frame it
+ * sleeps so rendering starts as late as it safely can, which keeps the camera
+ * frame and orientation as fresh as possible when the photons go out.
+ *
+ * Orientation is then latched once per frame, just before the HUD draws, so
+ * every rolled or pitch/heading driven element sees the same pose. The latch
+ * can optionally extrapolate the last two IMU samples to the predicted vsync.
+ */
+
+#define FRAME_PACER_DEFAULT_HZ     60
+#define FRAME_PACER_COST_SHIFT     3         /* Render cost EWMA weight, 1/8 per frame. */
+#define FRAME_PACER_MIN_SLEEP_NS   200000    /* Don't bother sleeping for less than this. */
+#define POSE_PREDICT_MAX_MS        50        /* Never extrapolate further ahead than this. */
+#define POSE_SAMPLE_STALE_MS       200       /* Older IMU samples aren't used for prediction. */
+#define POSE_SAMPLE_MIN_MS         2         /* Closer samples arrived queued, not measured apart. */
+
+typedef struct {
+   unsigned long frames;     /* Frames presented. */
+   unsigned long missed;     /* Presents that landed after the vsync they aimed for. */
+   double period_ms;         /* Measured refresh period. */
+   double render_cost_ms;    /* Estimated time from render start to present. */
+} frame_pacer_stats;
+
+/**
+ * @brief Sets the nominal refresh rate. Call once after the window exists.
+ *
+ * @param refresh_hz Display refresh rate. 0 or less uses FRAME_PACER_DEFAULT_HZ.
+ */
+void frame_pacer_init(int refresh_hz);
+
+/**
+ * @brief Predicts the next reachable vsync and optionally sleeps until it's time to render.
+ *
+ * Call once per frame, before any rendering.
+ *
+ * @param enabled   Sleep to start late. If 0 this only predicts.
+ * @param margin_ns Safety margin kept between the expected end of rendering and vsync.
+ * @return The predicted vsync time on the latency_now_ns() clock.
+ */
+unsigned long frame_pacer_wait(int enabled, unsigned long margin_ns);
+
+/**
+ * @brief Records a finished present.
+ *
+ * @param present_start_ns When SDL_RenderPresent() was called. Rendering cost is
+ *                         measured up to here so vsync blocking isn't counted.
+ */
+void frame_pacer_presented(unsigned long present_start_ns);
+
+/**
+ * @brief Copies the pacer counters and resets the missed count.
+ */
+void frame_pacer_get_stats(frame_pacer_stats *stats);
+
+/**
+ * @brief Stores a timestamped orientation sample. Called by the IMU writer.
+ */
+void pose_record_sample(const motion *sample);
+
+/**
+ * @brief Latches the pose the HUD draws with for this frame.
+ *
+ * @param target_ns When the frame is expected on screen, from frame_pacer_wait().
+ * @param predict   Extrapolate the latest samples to target_ns.
+ */
+void pose_latch(unsigned long target_ns, int predict);
+
+/**
+ * @brief Returns this frame's latched pose. Render thread only.
+ */
+const motion *get_latched_motion(void);
+
+#endif /* FRAME_PACER_H */
@@ -0,0 +1,315 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "glyph_atlas.h"
+#include "logging.h"
+#include "mirage.h"
+#include "texture_atlas.h"
+
+typedef struct {
+   SDL_Rect src;           /* Cell in the atlas texture. */
+   int offset_x;           /* Cell origin relative to the pen position. */
+   int advance;
+   int provided;           /* The font has this glyph. */
+} glyph_info;
+
+typedef struct {
+   TTF_Font *font;
+   SDL_Texture *texture;
+   int height;
+   int line_skip;
+   glyph_info glyphs[GLYPH_ATLAS_CHAR_COUNT];
+} glyph_atlas;
+
+static glyph_atlas atlases[GLYPH_ATLAS_MAX_FONTS];
+static int atlas_count = 0;
+static int glyph_disabled = 0;     /* Renderer can't do what we need, always fall back. */
+
+/* Glyphs are white, tinted by color mod. Every glyph of a string has the same
+ * color, so color is replaced and only alpha accumulates. That keeps the canvas
+ * non-premultiplied, which is what the normal blended draw of it expects. */
+static SDL_BlendMode glyph_blend_mode(void)
+{
+   return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ZERO,
+                                     SDL_BLENDOPERATION_ADD,
+                                     SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                     SDL_BLENDOPERATION_ADD);
+}
+
+static glyph_atlas *glyph_atlas_build(TTF_Font *font)
+{
+   SDL_Renderer *renderer = get_sdl_renderer();
+   SDL_Surface *cells[GLYPH_ATLAS_CHAR_COUNT];
+   SDL_Surface *sheet = NULL;
+   SDL_Color white = { 255, 255, 255, 255 };
+   glyph_atlas *atlas = NULL;
+   int row_x = 0, row_y = 0, row_h = 0;
+
+   if (atlas_count >= GLYPH_ATLAS_MAX_FONTS) {
+      return NULL;
+   }
+
+   atlas = &atlases[atlas_count];
+   memset(atlas, 0, sizeof(glyph_atlas));
+   memset(cells, 0, sizeof(cells));
+   atlas->font = font;
+   atlas->height = TTF_FontHeight(font);
+   atlas->line_skip = TTF_FontLineSkip(font);
+
+   for (int i = 0; i < GLYPH_ATLAS_CHAR_COUNT; i++) {
+      glyph_info *glyph = &atlas->glyphs[i];
+      Uint16 ch = (Uint16) (GLYPH_ATLAS_FIRST_CHAR + i);
+      char str[2] = { (char) ch, '\0' };
+      int minx = 0, maxx = 0, advance = 0;
+
+      if (!TTF_GlyphIsProvided(font, ch) ||
+          (TTF_GlyphMetrics(font, ch, &minx, &maxx, NULL, NULL, &advance) != 0)) {
+         continue;
+      }
+      glyph->provided = 1;
+      glyph->advance = advance;
+      /* SDL_ttf shifts a negative left bearing into the surface. */
+      glyph->offset_x = (minx < 0) ? minx : 0;
+
+      cells[i] = TTF_RenderText_Blended(font, str, white);
+      if (cells[i] == NULL) {
+         continue;
+      }
+
+      if (row_x + cells[i]->w + GLYPH_ATLAS_PADDING > GLYPH_ATLAS_ROW_WIDTH) {
+         row_y += row_h;
+         row_x = 0;
+         row_h = 0;
+      }
+      glyph->src.x = row_x;
+      glyph->src.y = row_y;
+      glyph->src.w = cells[i]->w;
+      glyph->src.h = cells[i]->h;
+
+      row_x += cells[i]->w + GLYPH_ATLAS_PADDING;
+      if (cells[i]->h + GLYPH_ATLAS_PADDING > row_h) {
+         row_h = cells[i]->h + GLYPH_ATLAS_PADDING;
+      }
+   }
+
+   sheet = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_ROW_WIDTH, row_y + row_h + 1, 32,
+                                          SDL_PIXELFORMAT_ARGB8888);
+   if (sheet != NULL) {
+      SDL_FillRect(sheet, NULL, SDL_MapRGBA(sheet->format, 255, 255, 255, 0));
+   }
+
+   for (int i = 0; i < GLYPH_ATLAS_CHAR_COUNT; i++) {
+      if (cells[i] == NULL) {
+         continue;
+      }
+      if (sheet != NULL) {
+         SDL_Rect dst = atlas->glyphs[i].src;
+
+         /* Straight copy, we want the coverage in alpha untouched. */
+         SDL_SetSurfaceBlendMode(cells[i], SDL_BLENDMODE_NONE);
+         SDL_BlitSurface(cells[i], NULL, sheet, &dst);
+      }
+      SDL_FreeSurface(cells[i]);
+   }
+
+   if (sheet == NULL) {
+      LOG_ERROR("Unable to create glyph atlas surface: %s", SDL_GetError());
+      return NULL;
+   }
+
+   atlas->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+   SDL_FreeSurface(sheet);
+   if (atlas->texture == NULL) {
+      LOG_ERROR("Unable to create glyph atlas texture: %s", SDL_GetError());
+      return NULL;
+   }
+
+   if (SDL_SetTextureBlendMode(atlas->texture, glyph_blend_mode()) != 0) {
+      LOG_WARNING("Renderer lacks custom blend modes, glyph atlas text disabled: %s",
+                  SDL_GetError());
+      SDL_DestroyTexture(atlas->texture);
+      atlas->texture = NULL;
+      glyph_disabled = 1;
+      return NULL;
+   }
+
+   atlas_count++;
+
+   return atlas;
+}
+
+static glyph_atlas *glyph_atlas_get(TTF_Font *font)
+{
+   for (int i = 0; i < atlas_count; i++) {
+      if (atlases[i].font == font) {
+         return &atlases[i];
+      }
+   }
+
+   return glyph_atlas_build(font);
+}
+
+static int glyph_kerning(TTF_Font *font, Uint16 prev, Uint16 ch)
+{
+#ifdef SDL_TTF_VERSION_ATLEAST
+#if SDL_TTF_VERSION_ATLEAST(2, 0, 14)
+   if ((prev != 0) && TTF_GetFontKerning(font)) {
+      return TTF_GetFontKerningSizeGlyphs(font, prev, ch);
+   }
+#endif
+#endif
+   return 0;
+}
+
+/* Lay out the text, drawing each glyph when a renderer is given, and measure it. */
+static int glyph_layout(glyph_atlas *atlas, const char *text, SDL_Renderer *renderer,
+                        int *width, int *height)
+{
+   int pen_x = 0, line = 0, max_w = 0;
+   Uint16 prev = 0;
+
+   for (const unsigned char *p = (const unsigned char *) text; *p != '\0'; p++) {
+      glyph_info *glyph = NULL;
+
+      if (*p == '\n') {
+         line++;
+         pen_x = 0;
+         prev = 0;
+         continue;
+      }
+      if ((*p < GLYPH_ATLAS_FIRST_CHAR) || (*p > GLYPH_ATLAS_LAST_CHAR)) {
+         return FAILURE;
+      }
+
+      glyph = &atlas->glyphs[*p - GLYPH_ATLAS_FIRST_CHAR];
+      if (!glyph->provided) {
+         return FAILURE;
+      }
+
+      pen_x += glyph_kerning(atlas->font, prev, *p);
+      prev = *p;
+
+      if ((renderer != NULL) && (glyph->src.w > 0)) {
+         SDL_Rect dst = { pen_x + glyph->offset_x, line * atlas->line_skip,
+                          glyph->src.w, glyph->src.h };
+         SDL_RenderCopy(renderer, atlas->texture, &glyph->src, &dst);
+      }
+
+      if (pen_x + glyph->offset_x + glyph->src.w > max_w) {
+         max_w = pen_x + glyph->offset_x + glyph->src.w;
+      }
+      pen_x += glyph->advance;
+      if (pen_x > max_w) {
+         max_w = pen_x;
+      }
+   }
+
+   *width = (max_w > 0) ? max_w : 1;
+   *height = line * atlas->line_skip + atlas->height;
+
+   return SUCCESS;
+}
+
+int glyph_text_render(SDL_Texture **canvas, TTF_Font *font, const char *text, SDL_Color color,
+                      int *width, int *height)
+{
+   SDL_Renderer *renderer = get_sdl_renderer();
+   SDL_Texture *prev_target = NULL;
+   glyph_atlas *atlas = NULL;
+   Uint32 format = 0;
+   int access = -1, canvas_w = 0, canvas_h = 0;
+   int text_w = 0, text_h = 0;
+   Uint8 r = 0, g = 0, b = 0, a = 0;
+
+   if (glyph_disabled || (renderer == NULL) || (canvas == NULL) || (font == NULL) ||
+       (text == NULL)) {
+      return FAILURE;
+   }
+
+   atlas = glyph_atlas_get(font);
+   if (atlas == NULL) {
+      return FAILURE;
+   }
+
+   if (glyph_layout(atlas, text, NULL, &text_w, &text_h) != SUCCESS) {
+      return FAILURE;
+   }
+
+   if (*canvas != NULL) {
+      SDL_QueryTexture(*canvas, &format, &access, &canvas_w, &canvas_h);
+   }
+   if ((*canvas == NULL) || (access != SDL_TEXTUREACCESS_TARGET) ||
+       (canvas_w < text_w) || (canvas_h < text_h)) {
+      if (*canvas != NULL) {
+         SDL_DestroyTexture(*canvas);
+      }
+
+      canvas_w = (text_w + GLYPH_CANVAS_ROUND - 1) / GLYPH_CANVAS_ROUND * GLYPH_CANVAS_ROUND;
+      canvas_h = (text_h + GLYPH_CANVAS_ROUND - 1) / GLYPH_CANVAS_ROUND * GLYPH_CANVAS_ROUND;
+      *canvas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                  canvas_w, canvas_h);
+      if (*canvas == NULL) {
+         LOG_ERROR("Unable to create %dx%d text canvas: %s", canvas_w, canvas_h, SDL_GetError());
+         return FAILURE;
+      }
+      SDL_SetTextureBlendMode(*canvas, SDL_BLENDMODE_BLEND);
+   }
+
+   /* Anything queued against the current target has to land first. */
+   texture_atlas_flush();
+   prev_target = SDL_GetRenderTarget(renderer);
+   if (SDL_SetRenderTarget(renderer, *canvas) != 0) {
+      LOG_ERROR("Unable to target text canvas: %s", SDL_GetError());
+      return FAILURE;
+   }
+
+   SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+   SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 0);
+   SDL_RenderClear(renderer);
+   SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+   SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+   SDL_SetTextureAlphaMod(atlas->texture, color.a);
+   glyph_layout(atlas, text, renderer, &text_w, &text_h);
+
+   SDL_SetRenderTarget(renderer, prev_target);
+
+   *width = text_w;
+   *height = text_h;
+
+   return SUCCESS;
+}
+
+void glyph_atlas_cleanup(void)
+{
+   for (int i = 0; i < atlas_count; i++) {
+      if (atlases[i].texture != NULL) {
+         SDL_DestroyTexture(atlases[i].texture);
+         atlases[i].texture = NULL;
+      }
+      atlases[i].font = NULL;
+   }
+   atlas_count = 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+/* Glyph atlas text rendering.
+ *
+ * Printable ASCII for each font/size is rasterized once into a single texture.
+ * Text is then drawn as one quad per glyph into a small per-element render
+ * target, so a changing value (FPS, heading, battery) costs a handful of quads
+ * instead of a TTF raster, a surface allocation and a texture upload.
+ */
+
+#define GLYPH_ATLAS_FIRST_CHAR   32
+#define GLYPH_ATLAS_LAST_CHAR    126
+#define GLYPH_ATLAS_CHAR_COUNT   (GLYPH_ATLAS_LAST_CHAR - GLYPH_ATLAS_FIRST_CHAR + 1)
+#define GLYPH_ATLAS_MAX_FONTS    32
+#define GLYPH_ATLAS_ROW_WIDTH    1024  /* Width of the atlas texture, rows are added as needed. */
+#define GLYPH_ATLAS_PADDING      1
+#define GLYPH_CANVAS_ROUND       64    /* Canvas sizes round up to absorb small width changes. */
+
+/**
+ * @brief Draws text into a render target canvas using the font's glyph atlas.
+ *
+ * The canvas is reused when it is a render target at least as big as the
+ * text, otherwise it is destroyed and recreated. Only the top left
+ * width x height of the canvas holds the text.
+ *
+ * Must be called from the render thread. The current render target is
+ * restored before returning.
+ *
+ * @param canvas Canvas texture, may point to NULL or to a non-target texture.
+ * @param font   Font to draw with.
+ * @param text   Text to draw. '\n' starts a new line.
+ * @param color  Text color including alpha.
+ * @param width  Set to the width of the drawn text.
+ * @param height Set to the height of the drawn text.
+ * @return SUCCESS if drawn. FAILURE if the text has characters outside the
+ *         atlas or the renderer can't do it, the caller should use SDL_ttf.
+ */
+int glyph_text_render(SDL_Texture **canvas, TTF_Font *font, const char *text, SDL_Color color,
+                      int *width, int *height);
+
+/**
+ * @brief Frees all glyph atlases. Call before the fonts are closed.
+ */
+void glyph_atlas_cleanup(void);
+
+#endif /* GLYPH_ATLAS_H */
@@ -0,0 +1,275 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdio.h>
+
+#include "defines.h"
+#include "gpu_convert.h"
+#include "logging.h"
+
+typedef struct {
+   GLuint program;
+   GLint size_loc;
+   GLuint fbo;
+   GLuint texture;
+   int width;
+   int height;
+} gpu_pass;
+
+static gpu_pass passes[GPU_CONVERT_COUNT];
+
+static const char *convert_vertex_src =
+   "#version 120\n"
+   "void main() {\n"
+   "   gl_Position = gl_Vertex;\n"
+   "}\n";
+
+/* Row y of the target is row y of memory. Luma rows sample one texel each,
+ * chroma rows sample the middle of a 2x2 block so linear filtering averages it. */
+static const char *nv12_fragment_src =
+   "#version 120\n"
+   "uniform sampler2D u_src;\n"
+   "uniform vec2 u_size;\n"
+   "void main() {\n"
+   "   vec2 p = floor(gl_FragCoord.xy);\n"
+   "   if (p.y < u_size.y) {\n"
+   "      vec3 c = texture2D(u_src, (p + 0.5) / u_size).rgb;\n"
+   "      gl_FragColor = vec4(0.0625 + dot(c, vec3(0.257, 0.504, 0.098)), 0.0, 0.0, 1.0);\n"
+   "   } else {\n"
+   "      vec2 block = vec2(floor(p.x * 0.5), p.y - u_size.y);\n"
+   "      vec3 c = texture2D(u_src, (block * 2.0 + 1.0) / u_size).rgb;\n"
+   "      float u = 0.5 + dot(c, vec3(-0.148, -0.291, 0.439));\n"
+   "      float v = 0.5 + dot(c, vec3(0.439, -0.368, -0.071));\n"
+   "      gl_FragColor = vec4(mod(p.x, 2.0) < 1.0 ? u : v, 0.0, 0.0, 1.0);\n"
+   "   }\n"
+   "}\n";
+
+static const char *unpremultiply_fragment_src =
+   "#version 120\n"
+   "uniform sampler2D u_src;\n"
+   "uniform vec2 u_size;\n"
+   "void main() {\n"
+   "   vec4 c = texture2D(u_src, gl_FragCoord.xy / u_size);\n"
+   "   gl_FragColor = (c.a > 0.0) ? vec4(c.rgb / c.a, c.a) : vec4(0.0);\n"
+   "}\n";
+
+static GLuint compile_shader(GLenum type, const char *src)
+{
+   GLuint shader = glCreateShader(type);
+   GLint ok = 0;
+   char log[512];
+
+   glShaderSource(shader, 1, &src, NULL);
+   glCompileShader(shader);
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+   if (!ok) {
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      LOG_ERROR("Conversion shader compile failed: %s", log);
+      glDeleteShader(shader);
+      return 0;
+   }
+
+   return shader;
+}
+
+static int build_program(gpu_pass *pass, const char *fragment_src)
+{
+   GLuint vs = compile_shader(GL_VERTEX_SHADER, convert_vertex_src);
+   GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_src);
+   GLint ok = 0;
+   char log[512];
+
+   if ((vs == 0) || (fs == 0)) {
+      glDeleteShader(vs);
+      glDeleteShader(fs);
+      return FAILURE;
+   }
+
+   pass->program = glCreateProgram();
+   glAttachShader(pass->program, vs);
+   glAttachShader(pass->program, fs);
+   glLinkProgram(pass->program);
+   glDeleteShader(vs);
+   glDeleteShader(fs);
+
+   glGetProgramiv(pass->program, GL_LINK_STATUS, &ok);
+   if (!ok) {
+      glGetProgramInfoLog(pass->program, sizeof(log), NULL, log);
+      LOG_ERROR("Conversion shader link failed: %s", log);
+      glDeleteProgram(pass->program);
+      pass->program = 0;
+      return FAILURE;
+   }
+
+   pass->size_loc = glGetUniformLocation(pass->program, "u_size");
+
+   return SUCCESS;
+}
+
+/* Size the pass's target for a width x height source. */
+static int ensure_target(gpu_convert_t conversion, int width, int height)
+{
+   gpu_pass *pass = &passes[conversion];
+   GLenum status = 0;
+
+   if ((pass->fbo != 0) && (pass->width == width) && (pass->height == height)) {
+      return SUCCESS;
+   }
+
+   if (pass->fbo == 0) {
+      glGenFramebuffers(1, &pass->fbo);
+      glGenTextures(1, &pass->texture);
+   }
+
+   glBindTexture(GL_TEXTURE_2D, pass->texture);
+   if (conversion == GPU_CONVERT_NV12) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height * 3 / 2, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+   } else {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   }
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+   glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pass->texture, 0);
+   status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   if (status != GL_FRAMEBUFFER_COMPLETE) {
+      LOG_ERROR("Conversion framebuffer incomplete: 0x%x", status);
+      return FAILURE;
+   }
+
+   pass->width = width;
+   pass->height = height;
+
+   return SUCCESS;
+}
+
+int gpu_convert_init(void)
+{
+   int result = SUCCESS;
+
+   if ((passes[GPU_CONVERT_NV12].program == 0) &&
+       (build_program(&passes[GPU_CONVERT_NV12], nv12_fragment_src) != SUCCESS)) {
+      LOG_WARNING("GPU NV12 conversion unavailable, recording will read back RGBA.");
+      result = FAILURE;
+   }
+
+   if ((passes[GPU_CONVERT_UNPREMULTIPLY].program == 0) &&
+       (build_program(&passes[GPU_CONVERT_UNPREMULTIPLY], unpremultiply_fragment_src) != SUCCESS)) {
+      LOG_WARNING("GPU unpremultiply unavailable, encoder side composition is disabled.");
+      result = FAILURE;
+   }
+
+   return result;
+}
+
+int gpu_convert_available(gpu_convert_t conversion)
+{
+   return (conversion < GPU_CONVERT_COUNT) && (passes[conversion].program != 0);
+}
+
+int gpu_convert(gpu_convert_t conversion, GLuint src_texture, int width, int height)
+{
+   gpu_pass *pass = NULL;
+   GLint prev_program = 0, prev_texture = 0, prev_active = 0;
+   GLint prev_viewport[4];
+   GLboolean prev_blend = GL_FALSE, prev_scissor = GL_FALSE;
+   int target_height = height;
+
+   if (!gpu_convert_available(conversion)) {
+      return FAILURE;
+   }
+   if ((conversion == GPU_CONVERT_NV12) && ((width & 1) || (height & 1))) {
+      return FAILURE;
+   }
+   if (conversion == GPU_CONVERT_NV12) {
+      target_height = height * 3 / 2;
+   }
+   pass = &passes[conversion];
+
+   /* SDL caches its own GL state, put back everything we change. */
+   glGetIntegerv(GL_CURRENT_PROGRAM, &prev_program);
+   glGetIntegerv(GL_ACTIVE_TEXTURE, &prev_active);
+   glActiveTexture(GL_TEXTURE0);
+   glGetIntegerv(GL_TEXTURE_BINDING_2D, &prev_texture);
+   glGetIntegerv(GL_VIEWPORT, prev_viewport);
+   prev_blend = glIsEnabled(GL_BLEND);
+   prev_scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+   if (ensure_target(conversion, width, height) != SUCCESS) {
+      glBindTexture(GL_TEXTURE_2D, prev_texture);
+      glActiveTexture(prev_active);
+      return FAILURE;
+   }
+
+   glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+   glViewport(0, 0, width, target_height);
+   glDisable(GL_BLEND);
+   glDisable(GL_SCISSOR_TEST);
+
+   glUseProgram(pass->program);
+   glUniform2f(pass->size_loc, (float) width, (float) height);
+   glBindTexture(GL_TEXTURE_2D, src_texture);
+
+   glBegin(GL_TRIANGLE_STRIP);
+   glVertex2f(-1.0f, -1.0f);
+   glVertex2f(1.0f, -1.0f);
+   glVertex2f(-1.0f, 1.0f);
+   glVertex2f(1.0f, 1.0f);
+   glEnd();
+
+   glUseProgram(prev_program);
+   glBindTexture(GL_TEXTURE_2D, prev_texture);
+   glActiveTexture(prev_active);
+   glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+   if (prev_blend) {
+      glEnable(GL_BLEND);
+   }
+   if (prev_scissor) {
+      glEnable(GL_SCISSOR_TEST);
+   }
+
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, pass->fbo);
+
+   return SUCCESS;
+}
+
+void gpu_convert_cleanup(void)
+{
+   for (int i = 0; i < GPU_CONVERT_COUNT; i++) {
+      gpu_pass *pass = &passes[i];
+
+      if (pass->program != 0) {
+         glDeleteProgram(pass->program);
+         pass->program = 0;
+      }
+      if (pass->fbo != 0) {
+         glDeleteFramebuffers(1, &pass->fbo);
+         glDeleteTextures(1, &pass->texture);
+         pass->fbo = 0;
+         pass->texture = 0;
+         pass->width = pass->height = 0;
+      }
+   }
+}
@@ -0,0 +1,88 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef GPU_CONVERT_H
+#define GPU_CONVERT_H
+
+#include <GL/glew.h>
+
+/* GPU pixel conversions for the recording readback.
+ *
+ * Each conversion draws a source texture with a small shader into an
+ * offscreen framebuffer sized for the result, so only the converted pixels
+ * are ever read back.
+ *
+ * NV12: a single channel target of width x (height * 3 / 2). The first height
+ * rows hold luma and the remaining rows interleaved U/V at quarter resolution,
+ * BT.601 limited range. Read back with GL_RED that is byte for byte an NV12
+ * image, 1.5 bytes per pixel instead of 4.
+ *
+ * Unpremultiply: HUD layers are premultiplied, GStreamer mixers expect
+ * straight alpha. This divides color by alpha into an RGBA target.
+ *
+ * All of this runs on the render thread between SDL draws, so it saves and
+ * restores the GL state it touches.
+ */
+
+/**
+ * @brief Bytes in an NV12 frame of the given size.
+ */
+#define NV12_FRAME_SIZE(w, h) ((size_t) (w) * (h) * 3 / 2)
+
+typedef enum {
+   GPU_CONVERT_NV12,
+   GPU_CONVERT_UNPREMULTIPLY,
+   GPU_CONVERT_COUNT
+} gpu_convert_t;
+
+/**
+ * @brief Builds the conversion shaders. Call on the render thread once GL is up.
+ *
+ * @return SUCCESS if every conversion can be used, FAILURE if any is missing.
+ */
+int gpu_convert_init(void);
+
+/**
+ * @brief Returns 1 if the conversion's shader was built.
+ */
+int gpu_convert_available(gpu_convert_t conversion);
+
+/**
+ * @brief Converts a top-down RGBA texture.
+ *
+ * On success the result framebuffer is left bound as GL_READ_FRAMEBUFFER so
+ * the caller can glReadPixels() from it: width x (height * 3 / 2) GL_RED for
+ * NV12, width x height GL_RGBA otherwise.
+ *
+ * @param conversion  Which conversion to run.
+ * @param src_texture RGBA texture of width x height, row 0 at the top of the image.
+ * @param width       Frame width. Must be even for NV12.
+ * @param height      Frame height. Must be even for NV12.
+ * @return SUCCESS or FAILURE.
+ */
+int gpu_convert(gpu_convert_t conversion, GLuint src_texture, int width, int height);
+
+/**
+ * @brief Frees the shaders and framebuffers. Render thread only.
+ */
+void gpu_convert_cleanup(void);
+
+#endif /* GPU_CONVERT_H */
@@ -20,6 +20,7 @@
  */
 
 #include <SDL2/SDL.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -40,6 +41,15 @@ static hud_manager hud_mgr = {
    .transition_start_time = 0
 };
 
+/* Precomputed draw lists. All arrays point into one allocation. */
+static element **draw_list_pool = NULL;
+static hud_draw_list hud_lists[MAX_HUDS];
+static hud_transition_lists transition_lists[MAX_HUDS][MAX_HUDS];
+static hud_draw_list empty_list = { NULL, 0 };
+static hud_transition_lists empty_transition = { { NULL, 0 }, { NULL, 0 }, { NULL, 0 }, { NULL, 0 } };
+static int draw_lists_dirty = 1;
+static atomic_int hud_damaged = 1;
+
 /* Transition names for user-friendly configuration */
 static const char* transition_names[TRANSITION_MAX] = {
    "fade",
@@ -56,6 +66,7 @@ void init_hud_manager(void) {
    hud_mgr.transition_progress = 0.0;
    hud_mgr.transition_type = TRANSITION_FADE;
    hud_mgr.transition_duration_ms = 500;
+   invalidate_hud_draw_lists();
 }
 
 /* Clean up HUD manager resources */
@@ -68,6 +79,12 @@ void cleanup_hud_manager(void) {
    }
    hud_mgr.screens = NULL;
    hud_mgr.current_screen = NULL;
+
+   free(draw_list_pool);
+   draw_list_pool = NULL;
+   memset(hud_lists, 0, sizeof(hud_lists));
+   memset(transition_lists, 0, sizeof(transition_lists));
+   invalidate_hud_draw_lists();
 }
 
 /* Find a HUD by name */
@@ -150,6 +167,8 @@ int register_hud(const char *name, const char *hotkey, const char *transition) {
       }
       current->next = new_screen;
    }
+
+   invalidate_hud_draw_lists();
    
    return new_screen->hud_id;
 }
@@ -174,6 +193,7 @@ void switch_to_hud(hud_screen *this_screen, transition_t transition_type) {
    }
 
    /* Start transition */
+   hud_mark_damaged();
    hud_mgr.transition_from = hud_mgr.current_screen;
    hud_mgr.current_screen = this_screen;
    hud_mgr.transition_progress = 0.0;
@@ -250,3 +270,149 @@ void switch_to_next_hud(void) {
    // Use the existing switch function with default transition settings
    switch_to_hud(next_screen, next_screen->transition_type);
 }
+
+/* Mark the draw lists for rebuilding. */
+void invalidate_hud_draw_lists(void) {
+   draw_lists_dirty = 1;
+}
+
+/* Append an element to a list being built in the pool. */
+static void draw_list_append(hud_draw_list *list, element *this_element) {
+   list->elements[list->count++] = this_element;
+}
+
+/* Rebuild the flat draw lists from the element linked list. */
+int update_hud_draw_lists(void) {
+   element *curr_element = NULL;
+   element **sorted = NULL;
+   element **next_free = NULL;
+   int total = 0;
+   int hud_count = 0;
+   int hud_sizes[MAX_HUDS] = { 0 };
+   size_t pool_size = 0;
+
+   if (!draw_lists_dirty) {
+      return SUCCESS;
+   }
+
+   free(draw_list_pool);
+   draw_list_pool = NULL;
+   memset(hud_lists, 0, sizeof(hud_lists));
+   memset(transition_lists, 0, sizeof(transition_lists));
+
+   for (hud_screen *screen = hud_mgr.screens; screen != NULL; screen = screen->next) {
+      if (screen->hud_id + 1 > hud_count) {
+         hud_count = screen->hud_id + 1;
+      }
+   }
+
+   for (curr_element = get_first_element(); curr_element != NULL; curr_element = curr_element->next) {
+      total++;
+      for (int h = 0; h < hud_count; h++) {
+         hud_sizes[h] += curr_element->hud_flags[h] ? 1 : 0;
+      }
+   }
+
+   /* Everything, each HUD, then for each pair the three sets plus their union. */
+   pool_size = total;
+   for (int h = 0; h < hud_count; h++) {
+      pool_size += hud_sizes[h];
+      for (int t = 0; t < hud_count; t++) {
+         pool_size += 3 * hud_sizes[h] + 2 * hud_sizes[t];
+      }
+   }
+
+   if (pool_size == 0) {
+      draw_lists_dirty = 0;
+      return SUCCESS;
+   }
+
+   draw_list_pool = malloc(pool_size * sizeof(element *));
+   if (draw_list_pool == NULL) {
+      LOG_ERROR("Failed to allocate HUD draw lists.");
+      return FAILURE;
+   }
+
+   /* Stable insertion sort by layer. The linked list is nearly sorted already. */
+   sorted = draw_list_pool;
+   total = 0;
+   for (curr_element = get_first_element(); curr_element != NULL; curr_element = curr_element->next) {
+      int pos = total++;
+
+      while ((pos > 0) && (sorted[pos - 1]->layer > curr_element->layer)) {
+         sorted[pos] = sorted[pos - 1];
+         pos--;
+      }
+      sorted[pos] = curr_element;
+   }
+   next_free = draw_list_pool + total;
+
+   for (int h = 0; h < hud_count; h++) {
+      hud_lists[h].elements = next_free;
+      next_free += hud_sizes[h];
+      for (int i = 0; i < total; i++) {
+         if (sorted[i]->hud_flags[h]) {
+            draw_list_append(&hud_lists[h], sorted[i]);
+         }
+      }
+   }
+
+   for (int f = 0; f < hud_count; f++) {
+      for (int t = 0; t < hud_count; t++) {
+         hud_transition_lists *lists = &transition_lists[f][t];
+
+         lists->from_only.elements = next_free;
+         lists->to_only.elements = lists->from_only.elements + hud_sizes[f];
+         lists->shared.elements = lists->to_only.elements + hud_sizes[t];
+         lists->all.elements = lists->shared.elements + hud_sizes[f];
+         next_free = lists->all.elements + hud_sizes[f] + hud_sizes[t];
+
+         for (int i = 0; i < total; i++) {
+            int in_from = sorted[i]->hud_flags[f];
+            int in_to = sorted[i]->hud_flags[t];
+
+            if (in_from && in_to) {
+               draw_list_append(&lists->shared, sorted[i]);
+            } else if (in_from) {
+               draw_list_append(&lists->from_only, sorted[i]);
+            } else if (in_to) {
+               draw_list_append(&lists->to_only, sorted[i]);
+            } else {
+               continue;
+            }
+            draw_list_append(&lists->all, sorted[i]);
+         }
+      }
+   }
+
+   draw_lists_dirty = 0;
+
+   return SUCCESS;
+}
+
+/* Get the draw list for a HUD. */
+const hud_draw_list *get_hud_draw_list(int hud_id) {
+   if ((hud_id < 0) || (hud_id >= MAX_HUDS) || (hud_lists[hud_id].elements == NULL)) {
+      return &empty_list;
+   }
+   return &hud_lists[hud_id];
+}
+
+/* Flag the HUD for redraw. */
+void hud_mark_damaged(void) {
+   atomic_store_explicit(&hud_damaged, 1, memory_order_relaxed);
+}
+
+/* Take and clear the damage flag. */
+int hud_take_damage(void) {
+   return atomic_exchange_explicit(&hud_damaged, 0, memory_order_relaxed);
+}
+
+/* Get the precomputed sets for a transition between two HUDs. */
+const hud_transition_lists *get_hud_transition_lists(int from_id, int to_id) {
+   if ((from_id < 0) || (from_id >= MAX_HUDS) || (to_id < 0) || (to_id >= MAX_HUDS) ||
+       (transition_lists[from_id][to_id].all.elements == NULL)) {
+      return &empty_transition;
+   }
+   return &transition_lists[from_id][to_id];
+}
@@ -42,6 +42,20 @@ typedef struct _hud_screen {
    struct _hud_screen *next;          /* Next HUD in chain */
 } hud_screen;
 
+/* Flat, layer sorted array of elements to draw. */
+typedef struct _hud_draw_list {
+   element **elements;
+   int count;
+} hud_draw_list;
+
+/* What to draw while transitioning from one HUD to another. */
+typedef struct _hud_transition_lists {
+   hud_draw_list from_only;           /* Only in the HUD being left */
+   hud_draw_list to_only;             /* Only in the HUD being entered */
+   hud_draw_list shared;              /* In both */
+   hud_draw_list all;                 /* Union of the above, in layer order */
+} hud_transition_lists;
+
 /* HUD management */
 typedef struct _hud_manager {
    hud_screen *screens;               /* List of available HUD screens */
@@ -174,4 +188,57 @@ const char* get_transition_name(transition_t transition_type);
  */
 int find_transition_by_name(const char* name);
 
+/* Draw lists */
+
+/**
+ * @brief Marks the precomputed draw lists as out of date.
+ *
+ * Called whenever HUDs are registered or removed, or the element list changes.
+ * The lists are rebuilt on next use.
+ */
+void invalidate_hud_draw_lists(void);
+
+/**
+ * @brief Rebuilds the per-HUD and per-transition draw lists if they are out of date.
+ *
+ * Each HUD gets a flat array of its elements sorted by layer, and every pair of
+ * HUDs gets its from-only, to-only and shared sets, so rendering never walks
+ * the element linked list.
+ *
+ * @return SUCCESS, or FAILURE if memory could not be allocated.
+ */
+int update_hud_draw_lists(void);
+
+/**
+ * @brief Gets the draw list for one HUD.
+ *
+ * @param hud_id The HUD ID (0-15)
+ * @return The draw list. Empty for unknown IDs.
+ */
+const hud_draw_list *get_hud_draw_list(int hud_id);
+
+/**
+ * @brief Gets the precomputed sets for a transition between two HUDs.
+ *
+ * @param from_id The HUD being left
+ * @param to_id The HUD being entered
+ * @return The transition lists. Empty for unknown IDs.
+ */
+const hud_transition_lists *get_hud_transition_lists(int from_id, int to_id);
+
+/* Damage tracking */
+
+/**
+ * @brief Flags that what's on screen may be out of date. Safe from any thread.
+ *
+ * Called for incoming commands/sensor data, input events and by elements
+ * whose content changed (new text, running animations, transitions).
+ */
+void hud_mark_damaged(void);
+
+/**
+ * @brief Returns whether anything was flagged since the last call, and clears it.
+ */
+int hud_take_damage(void);
+
 #endif /* HUD_MANAGER_H */
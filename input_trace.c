@@ -0,0 +1,618 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mosquitto.h>
+
+#include "armor.h"
+#include "command_processing.h"
+#include "defines.h"
+#include "input_trace.h"
+#include "latency_stats.h"
+#include "logging.h"
+#include "mosquitto_comms.h"
+
+typedef struct {
+   char magic[8];
+   uint32_t version;
+   uint32_t reserved;
+} trace_file_header;
+
+typedef struct {
+   char magic[8];
+   uint32_t version;
+   uint32_t width;
+   uint32_t height;
+   uint32_t eyes;
+} trace_frames_header;
+
+typedef struct {
+   uint64_t time_ns;
+   uint32_t length;
+   uint16_t topic_length;
+   uint8_t source;
+   uint8_t type;
+} trace_record_header;
+
+/* Recording */
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE *record_file = NULL;
+static FILE *record_frames_file = NULL;
+static atomic_int recording = 0;
+static atomic_int recording_frames = 0;
+static unsigned long record_start_ns = 0;
+static size_t record_eye_bytes = 0;
+static int record_eyes = 0;
+
+/* Replay */
+static FILE *replay_file = NULL;
+static FILE *replay_frames_file = NULL;
+static char replay_filename[MAX_FILENAME_LENGTH] = "";
+static double replay_speed = 1.0;
+static unsigned long replay_start_ns = 0;    /* Wall time of the first pump. */
+static unsigned long replay_clock_ns = 0;    /* Replay time reached so far. */
+
+static trace_record_header replay_record;
+static int replay_record_pending = 0;
+static char *replay_payload = NULL;
+static size_t replay_payload_size = 0;
+static char replay_topic[TRACE_MAX_TOPIC] = "";
+
+static trace_frames_header replay_frames_geometry;
+static uint64_t replay_frame_next_ns = 0;
+static int replay_frame_pending = 0;
+static unsigned char *replay_pixels = NULL;
+static size_t replay_eye_bytes = 0;
+
+/* Results */
+static unsigned long *frame_ns_samples = NULL;
+static unsigned long *interval_ns_samples = NULL;
+static size_t frame_samples = 0;
+static size_t frame_samples_size = 0;
+static unsigned long last_present_ns = 0;
+static unsigned long first_frame_ns = 0;
+static unsigned long messages_replayed = 0;
+static unsigned long camera_frames_replayed = 0;
+static unsigned long camera_frames_dropped = 0;
+
+int trace_record_start(const char *filename, const char *frames_filename, int width,
+                       int height, int eyes)
+{
+   trace_file_header header = { .magic = "MIRTRACE", .version = TRACE_VERSION };
+   trace_frames_header frames_header = { .magic = "MIRFRAME", .version = TRACE_VERSION };
+
+   record_file = fopen(filename, "wb");
+   if (record_file == NULL) {
+      LOG_ERROR("Unable to create trace file: %s", filename);
+      return FAILURE;
+   }
+
+   if (fwrite(&header, sizeof(header), 1, record_file) != 1) {
+      LOG_ERROR("Unable to write trace header: %s", filename);
+      fclose(record_file);
+      record_file = NULL;
+      return FAILURE;
+   }
+
+   if (frames_filename != NULL) {
+      record_frames_file = fopen(frames_filename, "wb");
+      if (record_frames_file == NULL) {
+         LOG_ERROR("Unable to create trace frames file: %s", frames_filename);
+         fclose(record_file);
+         record_file = NULL;
+         return FAILURE;
+      }
+
+      frames_header.width = width;
+      frames_header.height = height;
+      frames_header.eyes = eyes;
+      if (fwrite(&frames_header, sizeof(frames_header), 1, record_frames_file) != 1) {
+         LOG_ERROR("Unable to write trace frames header: %s", frames_filename);
+         fclose(record_frames_file);
+         record_frames_file = NULL;
+         fclose(record_file);
+         record_file = NULL;
+         return FAILURE;
+      }
+
+      record_eye_bytes = (size_t) width * height * 4;
+      record_eyes = eyes;
+      atomic_store(&recording_frames, 1);
+   }
+
+   record_start_ns = latency_now_ns();
+   atomic_store(&recording, 1);
+
+   LOG_INFO("Recording input trace to %s%s%s.", filename,
+            frames_filename != NULL ? " and camera frames to " : "",
+            frames_filename != NULL ? frames_filename : "");
+
+   return SUCCESS;
+}
+
+int trace_is_recording(void)
+{
+   return atomic_load_explicit(&recording, memory_order_relaxed);
+}
+
+void trace_record_message(trace_source_t source, unsigned char type, const char *topic,
+                          const void *payload, size_t length)
+{
+   trace_record_header record;
+   size_t topic_length = (topic != NULL) ? strlen(topic) : 0;
+   int cancel_state = 0;
+
+   if (!trace_is_recording() || (length > TRACE_MAX_PAYLOAD)) {
+      return;
+   }
+   if (topic_length >= TRACE_MAX_TOPIC) {
+      topic_length = TRACE_MAX_TOPIC - 1;
+   }
+
+   /* The command thread is cancelled at shutdown. Don't let that happen with the lock held. */
+   pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+   pthread_mutex_lock(&record_mutex);
+
+   if (record_file != NULL) {
+      /* Stamped under the lock so the file is always in time order. */
+      record.time_ns = latency_now_ns() - record_start_ns;
+      record.length = (uint32_t) length;
+      record.topic_length = (uint16_t) topic_length;
+      record.source = (uint8_t) source;
+      record.type = type;
+
+      if ((fwrite(&record, sizeof(record), 1, record_file) != 1) ||
+          (fwrite(topic, 1, topic_length, record_file) != topic_length) ||
+          (fwrite(payload, 1, length, record_file) != length)) {
+         LOG_ERROR("Trace write failed, recording stopped.");
+         atomic_store(&recording, 0);
+      }
+   }
+
+   pthread_mutex_unlock(&record_mutex);
+   pthread_setcancelstate(cancel_state, NULL);
+}
+
+int trace_is_recording_frames(void)
+{
+   return atomic_load_explicit(&recording_frames, memory_order_relaxed);
+}
+
+void trace_record_frame(const unsigned char *left, size_t left_size,
+                        const unsigned char *right, size_t right_size)
+{
+   static int warned_short = 0;
+   uint64_t time_ns = 0;
+
+   if (!trace_is_recording_frames() || (record_frames_file == NULL)) {
+      return;
+   }
+
+   if (right == NULL) {
+      right = left;
+      right_size = left_size;
+   }
+
+   /* Caps changed or a short buffer. Skip it rather than read past the end. */
+   if ((left_size < record_eye_bytes) || ((record_eyes > 1) && (right_size < record_eye_bytes))) {
+      if (!warned_short) {
+         LOG_WARNING("Camera frame smaller than the trace frame size (%zu < %zu), skipping.",
+                     (left_size < right_size) ? left_size : right_size, record_eye_bytes);
+         warned_short = 1;
+      }
+      return;
+   }
+
+   time_ns = latency_now_ns() - record_start_ns;
+   if ((fwrite(&time_ns, sizeof(time_ns), 1, record_frames_file) != 1) ||
+       (fwrite(left, 1, record_eye_bytes, record_frames_file) != record_eye_bytes) ||
+       ((record_eyes > 1) &&
+        (fwrite(right, 1, record_eye_bytes, record_frames_file) !=
+         record_eye_bytes))) {
+      LOG_ERROR("Trace frame write failed, frame recording stopped.");
+      atomic_store(&recording_frames, 0);
+   }
+}
+
+void trace_record_stop(void)
+{
+   atomic_store(&recording, 0);
+   atomic_store(&recording_frames, 0);
+
+   pthread_mutex_lock(&record_mutex);
+   if (record_file != NULL) {
+      fclose(record_file);
+      record_file = NULL;
+   }
+   pthread_mutex_unlock(&record_mutex);
+
+   if (record_frames_file != NULL) {
+      fclose(record_frames_file);
+      record_frames_file = NULL;
+   }
+}
+
+/* Read the next message header and its topic, leaving the payload in the file. */
+static void replay_read_record(void)
+{
+   replay_record_pending = 0;
+
+   if (fread(&replay_record, sizeof(replay_record), 1, replay_file) != 1) {
+      return;
+   }
+
+   if ((replay_record.length > TRACE_MAX_PAYLOAD) ||
+       (replay_record.topic_length >= TRACE_MAX_TOPIC)) {
+      LOG_ERROR("Corrupt trace record, stopping the replay here.");
+      return;
+   }
+
+   if (fread(replay_topic, 1, replay_record.topic_length, replay_file) !=
+       replay_record.topic_length) {
+      return;
+   }
+   replay_topic[replay_record.topic_length] = '\0';
+
+   replay_record_pending = 1;
+}
+
+/* Read the pending payload and hand it to the same path it originally took. */
+static void replay_dispatch_record(void)
+{
+   serial_frame frame;
+
+   if (replay_payload_size < (size_t) replay_record.length + 1) {
+      char *grown = realloc(replay_payload, replay_record.length + 1);
+      if (grown == NULL) {
+         LOG_ERROR("Unable to allocate a %u byte trace payload.", replay_record.length);
+         replay_record_pending = 0;
+         return;
+      }
+      replay_payload = grown;
+      replay_payload_size = replay_record.length + 1;
+   }
+
+   if (fread(replay_payload, 1, replay_record.length, replay_file) != replay_record.length) {
+      replay_record_pending = 0;
+      return;
+   }
+   replay_payload[replay_record.length] = '\0';
+
+   switch (replay_record.source) {
+   case TRACE_SOURCE_MQTT:
+      mqtt_dispatch_message(replay_topic, replay_payload);
+      break;
+   case TRACE_SOURCE_SERIAL_TEXT:
+   case TRACE_SOURCE_SERIAL_BINARY:
+      memset(&frame, 0, sizeof(frame));
+      frame.kind = (replay_record.source == TRACE_SOURCE_SERIAL_BINARY) ?
+                   SERIAL_FRAME_BINARY : SERIAL_FRAME_TEXT;
+      frame.type = replay_record.type;
+      frame.data = (unsigned char *) replay_payload;
+      frame.length = replay_record.length;
+      serial_dispatch_frame(&frame);
+      break;
+   case TRACE_SOURCE_SOCKET:
+      registerArmor(replay_topic);
+      parse_json_command(replay_payload, replay_topic);
+      break;
+   default:
+      LOG_WARNING("Unknown trace source %u, skipped.", replay_record.source);
+      break;
+   }
+   messages_replayed++;
+
+   replay_read_record();
+}
+
+static void replay_read_frame_time(void)
+{
+   replay_frame_pending = (fread(&replay_frame_next_ns, sizeof(replay_frame_next_ns), 1,
+                                 replay_frames_file) == 1);
+}
+
+static void replay_reset_results(void)
+{
+   free(frame_ns_samples);
+   free(interval_ns_samples);
+   frame_ns_samples = NULL;
+   interval_ns_samples = NULL;
+   frame_samples = 0;
+   frame_samples_size = 0;
+   last_present_ns = 0;
+   first_frame_ns = 0;
+   messages_replayed = 0;
+   camera_frames_replayed = 0;
+   camera_frames_dropped = 0;
+}
+
+int trace_replay_open(const char *filename, const char *frames_filename, double speed)
+{
+   trace_file_header header;
+
+   replay_file = fopen(filename, "rb");
+   if (replay_file == NULL) {
+      LOG_ERROR("Unable to open trace file: %s", filename);
+      return FAILURE;
+   }
+
+   if ((fread(&header, sizeof(header), 1, replay_file) != 1) ||
+       (memcmp(header.magic, "MIRTRACE", sizeof(header.magic)) != 0) ||
+       (header.version != TRACE_VERSION)) {
+      LOG_ERROR("Not a version %d trace file: %s", TRACE_VERSION, filename);
+      trace_replay_close();
+      return FAILURE;
+   }
+
+   if (frames_filename != NULL) {
+      replay_frames_file = fopen(frames_filename, "rb");
+      if (replay_frames_file == NULL) {
+         LOG_ERROR("Unable to open trace frames file: %s", frames_filename);
+         trace_replay_close();
+         return FAILURE;
+      }
+
+      if ((fread(&replay_frames_geometry, sizeof(replay_frames_geometry), 1,
+                 replay_frames_file) != 1) ||
+          (memcmp(replay_frames_geometry.magic, "MIRFRAME",
+                  sizeof(replay_frames_geometry.magic)) != 0) ||
+          (replay_frames_geometry.version != TRACE_VERSION) ||
+          (replay_frames_geometry.eyes < 1) || (replay_frames_geometry.eyes > 2)) {
+         LOG_ERROR("Not a version %d trace frames file: %s", TRACE_VERSION, frames_filename);
+         trace_replay_close();
+         return FAILURE;
+      }
+
+      replay_eye_bytes = (size_t) replay_frames_geometry.width * replay_frames_geometry.height * 4;
+      replay_pixels = malloc(replay_eye_bytes * replay_frames_geometry.eyes);
+      if (replay_pixels == NULL) {
+         LOG_ERROR("Unable to allocate trace frame buffer.");
+         trace_replay_close();
+         return FAILURE;
+      }
+      replay_read_frame_time();
+   }
+
+   snprintf(replay_filename, sizeof(replay_filename), "%s", filename);
+   replay_speed = (speed > 0.0) ? speed : 0.0;
+   replay_start_ns = 0;
+   replay_clock_ns = 0;
+   replay_reset_results();
+   replay_read_record();
+
+   LOG_INFO("Replaying input trace %s at %s.", filename,
+            replay_speed > 0.0 ? "the recorded rate" : "maximum speed");
+
+   return SUCCESS;
+}
+
+int trace_replay_active(void)
+{
+   return replay_file != NULL;
+}
+
+int trace_replay_frame_info(int *width, int *height, int *eyes)
+{
+   if (replay_frames_file == NULL) {
+      return FAILURE;
+   }
+
+   *width = replay_frames_geometry.width;
+   *height = replay_frames_geometry.height;
+   *eyes = replay_frames_geometry.eyes;
+
+   return SUCCESS;
+}
+
+int trace_replay_pump(unsigned long now_ns, const unsigned char **left,
+                      const unsigned char **right)
+{
+   int have_frame = 0;
+
+   *left = NULL;
+   *right = NULL;
+
+   if (replay_file == NULL) {
+      return -1;
+   }
+
+   if (!replay_record_pending && !replay_frame_pending) {
+      return -1;
+   }
+
+   if (replay_start_ns == 0) {
+      replay_start_ns = now_ns;
+   }
+
+   if (replay_speed > 0.0) {
+      replay_clock_ns = (unsigned long) ((double) (now_ns - replay_start_ns) * replay_speed);
+   } else if (replay_frame_pending) {
+      /* One camera frame per rendered frame, with whatever arrived before it. */
+      replay_clock_ns = replay_frame_next_ns;
+   } else {
+      replay_clock_ns += TRACE_REPLAY_STEP_NS;
+   }
+
+   while (replay_record_pending && (replay_record.time_ns <= replay_clock_ns)) {
+      replay_dispatch_record();
+   }
+
+   while (replay_frame_pending && (replay_frame_next_ns <= replay_clock_ns)) {
+      if (fread(replay_pixels, replay_eye_bytes, replay_frames_geometry.eyes,
+                replay_frames_file) != replay_frames_geometry.eyes) {
+         replay_frame_pending = 0;
+         break;
+      }
+      if (have_frame) {
+         camera_frames_dropped++;
+      }
+      have_frame = 1;
+      replay_read_frame_time();
+   }
+
+   if (have_frame) {
+      camera_frames_replayed++;
+      *left = replay_pixels;
+      if (replay_frames_geometry.eyes > 1) {
+         *right = replay_pixels + replay_eye_bytes;
+      }
+   }
+
+   return have_frame;
+}
+
+void trace_replay_frame_done(unsigned long start_ns, unsigned long present_ns)
+{
+   if (frame_samples == frame_samples_size) {
+      size_t size = frame_samples_size ? frame_samples_size * 2 : TRACE_REPLAY_INITIAL_FRAMES;
+      unsigned long *frame_grown = realloc(frame_ns_samples, size * sizeof(unsigned long));
+      unsigned long *interval_grown = NULL;
+
+      if (frame_grown == NULL) {
+         return;
+      }
+      frame_ns_samples = frame_grown;
+
+      interval_grown = realloc(interval_ns_samples, size * sizeof(unsigned long));
+      if (interval_grown == NULL) {
+         return;
+      }
+      interval_ns_samples = interval_grown;
+      frame_samples_size = size;
+   }
+
+   if (first_frame_ns == 0) {
+      first_frame_ns = start_ns;
+   }
+
+   frame_ns_samples[frame_samples] = present_ns - start_ns;
+   interval_ns_samples[frame_samples] = (last_present_ns != 0) ? present_ns - last_present_ns : 0;
+   last_present_ns = present_ns;
+   frame_samples++;
+}
+
+static int compare_ulong(const void *a, const void *b)
+{
+   unsigned long x = *(const unsigned long *) a;
+   unsigned long y = *(const unsigned long *) b;
+
+   return (x > y) - (x < y);
+}
+
+/* Nearest rank percentile of a sorted array, in milliseconds. */
+static double percentile_ms(const unsigned long *sorted, size_t count, int pct)
+{
+   size_t rank = (count * pct + 99) / 100;
+
+   if (count == 0) {
+      return 0.0;
+   }
+   if (rank > 0) {
+      rank--;
+   }
+
+   return (double) sorted[rank] / 1000000.0;
+}
+
+static void report_series(FILE *out, const char *name, unsigned long *samples, size_t count)
+{
+   double total = 0.0;
+
+   qsort(samples, count, sizeof(unsigned long), compare_ulong);
+   for (size_t i = 0; i < count; i++) {
+      total += (double) samples[i];
+   }
+
+   fprintf(out, "  \"%s\": { \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p95\": %.3f, "
+           "\"p99\": %.3f, \"max\": %.3f }", name,
+           count > 0 ? total / (double) count / 1000000.0 : 0.0,
+           percentile_ms(samples, count, 50), percentile_ms(samples, count, 90),
+           percentile_ms(samples, count, 95), percentile_ms(samples, count, 99),
+           count > 0 ? (double) samples[count - 1] / 1000000.0 : 0.0);
+}
+
+int trace_replay_report(const char *filename)
+{
+   FILE *out = stdout;
+   double elapsed_s = 0.0;
+
+   if (filename != NULL) {
+      out = fopen(filename, "w");
+      if (out == NULL) {
+         LOG_ERROR("Unable to create replay report: %s", filename);
+         return FAILURE;
+      }
+   }
+
+   if ((first_frame_ns != 0) && (last_present_ns > first_frame_ns)) {
+      elapsed_s = (double) (last_present_ns - first_frame_ns) / 1000000000.0;
+   }
+
+   fprintf(out, "{\n");
+   fprintf(out, "  \"trace\": \"%s\",\n", replay_filename);
+   fprintf(out, "  \"speed\": %.2f,\n", replay_speed);
+   fprintf(out, "  \"frames\": %zu,\n", frame_samples);
+   fprintf(out, "  \"elapsed_s\": %.3f,\n", elapsed_s);
+   fprintf(out, "  \"messages\": %lu,\n", messages_replayed);
+   fprintf(out, "  \"camera_frames\": %lu,\n", camera_frames_replayed);
+   fprintf(out, "  \"camera_frames_dropped\": %lu,\n", camera_frames_dropped);
+   report_series(out, "frame_ms", frame_ns_samples, frame_samples);
+   fprintf(out, ",\n");
+   /* The first frame has no previous present. */
+   report_series(out, "interval_ms", frame_samples > 1 ? interval_ns_samples + 1 : interval_ns_samples,
+                 frame_samples > 1 ? frame_samples - 1 : 0);
+   fprintf(out, "\n}\n");
+
+   if (out != stdout) {
+      fclose(out);
+      LOG_INFO("Replay report written to %s.", filename);
+   }
+
+   return SUCCESS;
+}
+
+void trace_replay_close(void)
+{
+   if (replay_file != NULL) {
+      fclose(replay_file);
+      replay_file = NULL;
+   }
+   if (replay_frames_file != NULL) {
+      fclose(replay_frames_file);
+      replay_frames_file = NULL;
+   }
+
+   free(replay_payload);
+   replay_payload = NULL;
+   replay_payload_size = 0;
+   free(replay_pixels);
+   replay_pixels = NULL;
+   replay_record_pending = 0;
+   replay_frame_pending = 0;
+
+   replay_reset_results();
+}
@@ -0,0 +1,176 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stddef.h>
+
+/* Recording and replay of everything that drives the HUD.
+ *
+ * A trace holds every inbound message from MQTT, the serial link and the
+ * helmet socket, stamped on the latency_now_ns() clock relative to the start
+ * of the recording. Camera frames can optionally be captured to a second,
+ * raw file on the same clock. Replaying the pair through the normal dispatch
+ * paths reproduces a field workload on the bench, so two builds or configs
+ * can be compared on the same input.
+ *
+ * Trace file, native byte order:
+ *    header:  "MIRTRACE", uint32 version, uint32 reserved
+ *    records: uint64 time_ns, uint32 length, uint16 topic_length,
+ *             uint8 source, uint8 type, then the topic and the payload
+ *
+ * Frames file:
+ *    header:  "MIRFRAME", uint32 version, uint32 width, uint32 height, uint32 eyes
+ *    frames:  uint64 time_ns, then width * height * 4 RGBA bytes per eye
+ *
+ * Frames are written from the camera pairing thread, so capturing them needs
+ * a disk that keeps up with the raw camera rate.
+ */
+
+#define TRACE_VERSION               1
+#define TRACE_MAX_PAYLOAD           (1024 * 1024)  /* Larger records are treated as corruption. */
+#define TRACE_MAX_TOPIC             256            /* Topics are truncated to fit. */
+#define TRACE_REPLAY_STEP_NS        16666667UL     /* Max speed clock step without camera frames. */
+#define TRACE_REPLAY_INITIAL_FRAMES 4096           /* Frame time samples allocated up front. */
+
+typedef enum {
+   TRACE_SOURCE_MQTT = 1,        /* on_message(). */
+   TRACE_SOURCE_SERIAL_TEXT,     /* A text line from the serial link. */
+   TRACE_SOURCE_SERIAL_BINARY,   /* A binary serial packet, type holds the packet type. */
+   TRACE_SOURCE_SOCKET           /* A frame from a helmet socket client. */
+} trace_source_t;
+
+/**
+ * @brief Starts recording inbound messages, and optionally camera frames.
+ *
+ * Call before any input thread starts.
+ *
+ * @param filename        Trace file to create.
+ * @param frames_filename Raw camera file to create, or NULL for messages only.
+ * @param width           Camera frame width.
+ * @param height          Camera frame height.
+ * @param eyes            1 in single camera mode, otherwise 2.
+ * @return SUCCESS or FAILURE.
+ */
+int trace_record_start(const char *filename, const char *frames_filename, int width,
+                       int height, int eyes);
+
+/**
+ * @brief Returns 1 while messages are being recorded. Cheap, callable from any thread.
+ */
+int trace_is_recording(void);
+
+/**
+ * @brief Appends one inbound message to the trace. Safe from any thread.
+ *
+ * @param source  Where the message came from.
+ * @param type    Binary serial packet type, otherwise 0.
+ * @param topic   MQTT topic or dispatch topic. May be NULL.
+ * @param payload Message bytes.
+ * @param length  Number of payload bytes.
+ */
+void trace_record_message(trace_source_t source, unsigned char type, const char *topic,
+                          const void *payload, size_t length);
+
+/**
+ * @brief Returns 1 while camera frames are being recorded.
+ */
+int trace_is_recording_frames(void);
+
+/**
+ * @brief Appends one camera frame. Camera pairing thread only.
+ *
+ * Frames smaller than the recorded geometry are skipped.
+ *
+ * @param left       Left eye RGBA pixels.
+ * @param left_size  Bytes available at left.
+ * @param right      Right eye RGBA pixels. Ignored in single camera mode.
+ * @param right_size Bytes available at right.
+ */
+void trace_record_frame(const unsigned char *left, size_t left_size,
+                        const unsigned char *right, size_t right_size);
+
+/**
+ * @brief Stops recording and closes the files.
+ */
+void trace_record_stop(void);
+
+/**
+ * @brief Opens a trace for replay.
+ *
+ * @param filename        Trace file to replay.
+ * @param frames_filename Raw camera file to replay, or NULL for messages only.
+ * @param speed           1.0 replays at the recorded rate. 0 runs as fast as frames
+ *                        render, advancing one camera frame per rendered frame.
+ * @return SUCCESS or FAILURE.
+ */
+int trace_replay_open(const char *filename, const char *frames_filename, double speed);
+
+/**
+ * @brief Returns 1 if a trace is open for replay.
+ */
+int trace_replay_active(void);
+
+/**
+ * @brief Returns the geometry of the replayed camera frames.
+ *
+ * @return SUCCESS, or FAILURE if the replay has no frames file.
+ */
+int trace_replay_frame_info(int *width, int *height, int *eyes);
+
+/**
+ * @brief Advances the replay clock by one rendered frame. Render thread only.
+ *
+ * Every message due by the new replay time is dispatched as if it had just
+ * arrived. If camera frames are due the newest is returned, any older ones
+ * are dropped like a slow render drops live frames.
+ *
+ * @param now_ns Current latency_now_ns() time.
+ * @param left   Set to the left eye pixels of a due frame. Valid until the next call.
+ * @param right  Set to the right eye pixels, or NULL in single camera mode.
+ * @return 1 if a camera frame is due, 0 if not, -1 once the whole trace is played.
+ */
+int trace_replay_pump(unsigned long now_ns, const unsigned char **left,
+                      const unsigned char **right);
+
+/**
+ * @brief Records the timing of one rendered replay frame.
+ *
+ * @param start_ns   When the frame started rendering.
+ * @param present_ns When SDL_RenderPresent() was called.
+ */
+void trace_replay_frame_done(unsigned long start_ns, unsigned long present_ns);
+
+/**
+ * @brief Writes the frame time report as JSON.
+ *
+ * @param filename Destination, or NULL for stdout.
+ * @return SUCCESS or FAILURE.
+ */
+int trace_replay_report(const char *filename);
+
+/**
+ * @brief Closes the replay files and frees the frame time samples.
+ */
+void trace_replay_close(void);
+
+#endif /* INPUT_TRACE_H */
@@ -0,0 +1,192 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "latency_stats.h"
+
+typedef struct {
+   atomic_ulong buckets[LATENCY_BUCKET_COUNT];
+   atomic_ulong count;
+   atomic_ulong max_ns;
+} latency_histogram;
+
+/* Two windows per stage. Writers fill the active one, reports read the other. */
+static latency_histogram histograms[2][LAT_STAGE_COUNT];
+static atomic_int active_window = 0;
+static unsigned long window_start_ns = 0;
+
+static const char *stage_names[LAT_STAGE_COUNT] = {
+   "sensor_to_pull",
+   "pull_to_display",
+   "texture_upload",
+   "hud_render",
+   "readback",
+   "present",
+   "motion_to_photon"
+};
+
+unsigned long latency_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (unsigned long) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+void latency_record(latency_stage_t stage, unsigned long start_ns, unsigned long end_ns)
+{
+   latency_histogram *hist = NULL;
+   unsigned long duration = 0;
+   unsigned long bucket = 0;
+   unsigned long prev_max = 0;
+
+   if ((stage >= LAT_STAGE_COUNT) || (start_ns == 0) || (end_ns < start_ns)) {
+      return;
+   }
+
+   duration = end_ns - start_ns;
+   bucket = duration / (LATENCY_BUCKET_US * 1000UL);
+   if (bucket >= LATENCY_BUCKET_COUNT) {
+      bucket = LATENCY_BUCKET_COUNT - 1;
+   }
+
+   hist = &histograms[atomic_load_explicit(&active_window, memory_order_relaxed)][stage];
+   atomic_fetch_add_explicit(&hist->buckets[bucket], 1, memory_order_relaxed);
+   atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+   prev_max = atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+   while ((duration > prev_max) &&
+          !atomic_compare_exchange_weak_explicit(&hist->max_ns, &prev_max, duration,
+                                                 memory_order_relaxed, memory_order_relaxed)) {
+   }
+}
+
+unsigned long latency_stats_rotate(void)
+{
+   unsigned long now = latency_now_ns();
+   unsigned long elapsed_ms = 0;
+   int closed = atomic_load(&active_window);
+   int next = !closed;
+
+   /* Clear the window we're about to reuse before writers switch to it. */
+   for (int s = 0; s < LAT_STAGE_COUNT; s++) {
+      latency_histogram *hist = &histograms[next][s];
+      for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+         atomic_store_explicit(&hist->buckets[b], 0, memory_order_relaxed);
+      }
+      atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+      atomic_store_explicit(&hist->max_ns, 0, memory_order_relaxed);
+   }
+   atomic_store(&active_window, next);
+
+   if (window_start_ns != 0) {
+      elapsed_ms = (now - window_start_ns) / 1000000UL;
+   }
+   window_start_ns = now;
+
+   return elapsed_ms;
+}
+
+void latency_get_summary(latency_stage_t stage, latency_summary *summary)
+{
+   latency_histogram *hist = NULL;
+   unsigned long total = 0;
+   unsigned long seen = 0;
+   unsigned long p50 = 0, p95 = 0, p99 = 0;
+   int have50 = 0, have95 = 0, have99 = 0;
+
+   memset(summary, 0, sizeof(*summary));
+   if (stage >= LAT_STAGE_COUNT) {
+      return;
+   }
+
+   /* The closed window is the one writers aren't using. */
+   hist = &histograms[!atomic_load(&active_window)][stage];
+   total = atomic_load_explicit(&hist->count, memory_order_relaxed);
+   if (total == 0) {
+      return;
+   }
+
+   p50 = (total * 50 + 99) / 100;
+   p95 = (total * 95 + 99) / 100;
+   p99 = (total * 99 + 99) / 100;
+
+   for (int b = 0; b < LATENCY_BUCKET_COUNT && !have99; b++) {
+      seen += atomic_load_explicit(&hist->buckets[b], memory_order_relaxed);
+      /* Report the upper edge of the bucket, it's the conservative choice. */
+      double edge_ms = (double) ((b + 1) * LATENCY_BUCKET_US) / 1000.0;
+
+      if (!have50 && (seen >= p50)) {
+         summary->p50_ms = edge_ms;
+         have50 = 1;
+      }
+      if (!have95 && (seen >= p95)) {
+         summary->p95_ms = edge_ms;
+         have95 = 1;
+      }
+      if (!have99 && (seen >= p99)) {
+         summary->p99_ms = edge_ms;
+         have99 = 1;
+      }
+   }
+
+   summary->count = total;
+   summary->max_ms = (double) atomic_load_explicit(&hist->max_ns, memory_order_relaxed) / 1000000.0;
+}
+
+const char *latency_stage_name(latency_stage_t stage)
+{
+   if (stage >= LAT_STAGE_COUNT) {
+      return "unknown";
+   }
+
+   return stage_names[stage];
+}
+
+int latency_stats_report_json(char *buffer, size_t size)
+{
+   latency_summary summary;
+   unsigned long window_ms = latency_stats_rotate();
+   int len = 0;
+
+   len = snprintf(buffer, size, "{ \"device\": \"latency\", \"window_ms\": %lu, \"stages\": {",
+                  window_ms);
+
+   for (int s = 0; (s < LAT_STAGE_COUNT) && (len < (int) size); s++) {
+      latency_get_summary(s, &summary);
+      len += snprintf(buffer + len, size - len,
+                      "%s \"%s\": { \"count\": %lu, \"p50_ms\": %.1f, \"p95_ms\": %.1f, "
+                      "\"p99_ms\": %.1f, \"max_ms\": %.1f }",
+                      s == 0 ? "" : ",", stage_names[s], summary.count,
+                      summary.p50_ms, summary.p95_ms, summary.p99_ms, summary.max_ms);
+   }
+
+   if (len < (int) size) {
+      len += snprintf(buffer + len, size - len, " } }");
+   }
+
+   return len;
+}
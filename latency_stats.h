@@ -0,0 +1,99 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stddef.h>
+
+/* Always-on pipeline latency histograms.
+ *
+ * Each stage records durations into a fixed bucket histogram using only
+ * relaxed atomic increments, so recording is safe and cheap from any thread.
+ * Histograms cover a rolling window; latency_stats_rotate() closes the current
+ * window and starts a fresh one.
+ */
+
+#define LATENCY_BUCKET_US        100    /* Width of each histogram bucket. */
+#define LATENCY_BUCKET_COUNT     1000   /* 100us * 1000 = 100ms. Longer goes in the last bucket. */
+
+typedef enum {
+   LAT_SENSOR_TO_PULL,       /* Sensor PTS until the appsink sample is pulled. */
+   LAT_PULL_TO_DISPLAY,      /* Sample pulled until the render loop picks the pair up. */
+   LAT_TEXTURE_UPLOAD,       /* Camera texture upload. */
+   LAT_HUD_RENDER,           /* All HUD element rendering. */
+   LAT_READBACK,             /* Frame readback for recording/streaming. */
+   LAT_PRESENT,              /* SDL_RenderPresent. */
+   LAT_MOTION_TO_PHOTON,     /* Sensor PTS until present returns. */
+   LAT_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+   unsigned long count;
+   double p50_ms;
+   double p95_ms;
+   double p99_ms;
+   double max_ms;
+} latency_summary;
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds. All stage timestamps use this clock.
+ */
+unsigned long latency_now_ns(void);
+
+/**
+ * @brief Records one duration for a stage. Lock-free, callable from any thread.
+ *
+ * @param stage    The pipeline stage.
+ * @param start_ns Start time from latency_now_ns(). Ignored if 0 or after end_ns.
+ * @param end_ns   End time from latency_now_ns().
+ */
+void latency_record(latency_stage_t stage, unsigned long start_ns, unsigned long end_ns);
+
+/**
+ * @brief Closes the current window and starts a new one.
+ *
+ * Only one thread should rotate. Summaries are then read from the closed window.
+ *
+ * @return The length of the closed window in milliseconds.
+ */
+unsigned long latency_stats_rotate(void);
+
+/**
+ * @brief Summarizes a stage from the last closed window.
+ */
+void latency_get_summary(latency_stage_t stage, latency_summary *summary);
+
+/**
+ * @brief Returns the short name used for a stage in reports.
+ */
+const char *latency_stage_name(latency_stage_t stage);
+
+/**
+ * @brief Rotates the window and formats the closed window as a JSON report.
+ *
+ * @param buffer Destination buffer.
+ * @param size   Size of the destination buffer.
+ * @return Number of characters written, excluding the terminator.
+ */
+int latency_stats_report_json(char *buffer, size_t size);
+
+#endif /* LATENCY_STATS_H */
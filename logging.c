@@ -19,20 +19,83 @@
  * part of the project and are adopted by the project author(s).
  */
 
+
 #include "logging.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // Global variable for the log file
 static FILE *log_file = NULL;
 
+// Descriptor behind log_file, -1 on the console. Read by the fatal signal handler.
+static atomic_int log_fd = -1;
+
 // ANSI color codes
 #define ANSI_COLOR_GREEN   "\x1b[32m"
 #define ANSI_COLOR_YELLOW  "\x1b[33m"
 #define ANSI_COLOR_RED     "\x1b[31m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+// Fixed width for the preamble
+#define PREAMBLE_WIDTH 35
+
+// Longest formatted message, not counting the preamble
+#define LOG_MESSAGE_LENGTH 1024
+
+// Preamble, message and room for the suppressed count note
+#define LOG_RECORD_LENGTH  (PREAMBLE_WIDTH + LOG_MESSAGE_LENGTH + 40)
+
+/* Records waiting for the writer thread. Must be a power of two. */
+#define LOG_RING_SLOTS     256
+#define LOG_RING_MASK      (LOG_RING_SLOTS - 1)
+
+/* Per call site rate limit: at most LOG_RATE_BURST records per second. */
+#define LOG_RATE_SITES     256
+#define LOG_RATE_BURST     20
+
+/* How often the writer reports records it had to drop. */
+#define LOG_DROP_REPORT_SEC 5
+
+/* One preformatted record. seq is the Vyukov bounded queue turn counter. */
+typedef struct {
+    atomic_ulong seq;
+    log_level_t level;
+    char text[LOG_RECORD_LENGTH];
+} log_record;
+
+typedef struct {
+    atomic_uintptr_t key;           // Call site, file pointer mixed with the line
+    atomic_long window;             // Second the count belongs to
+    atomic_int count;               // Records let through in this window
+    atomic_ulong suppressed;        // Records held back since the last one let through
+} log_rate_site;
+
+static log_record ring[LOG_RING_SLOTS];
+static atomic_ulong enqueue_pos = 0;
+static atomic_ulong dequeue_pos = 0;    // Written by the writer thread only
+
+static log_rate_site rate_sites[LOG_RATE_SITES];
+
+static atomic_ulong records_written = 0;
+static atomic_ulong dropped_full = 0;
+static atomic_ulong dropped_rate = 0;
+
+static pthread_t writer_thread;
+static sem_t writer_wake;
+static atomic_int writer_running = 0;
+static int exit_handler_registered = 0;
+
+/* Signals that end the process without running atexit() handlers. */
+static const int fatal_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
 // Utility function to get the filename from the path
 static const char *get_filename(const char *path) {
     const char *filename = strrchr(path, '/');
@@ -42,9 +105,6 @@ static const char *get_filename(const char *path) {
     return filename ? filename + 1 : path;
 }
 
-// Fixed width for the preamble
-#define PREAMBLE_WIDTH 35
-
 // Utility function to remove newlines from a string
 static void remove_newlines(char *str) {
     char *src = str, *dst = str;
@@ -57,34 +117,204 @@ static void remove_newlines(char *str) {
     *dst = '\0';
 }
 
+static long monotonic_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    return (long)ts.tv_sec;
+}
+
+/* Returns 0 if this call site is over its budget. Otherwise returns 1 and sets
+ * *suppressed to how many of its records were held back since the last one. */
+static int rate_allow(const char *file, int line, unsigned long *suppressed) {
+    uintptr_t key = (uintptr_t)file ^ ((uintptr_t)line << 1);
+    log_rate_site *site = &rate_sites[(key ^ (key >> 9)) % LOG_RATE_SITES];
+    long now = monotonic_seconds();
+    long window = atomic_load_explicit(&site->window, memory_order_relaxed);
+
+    *suppressed = 0;
+
+    // A colliding site takes the slot over. The two just share a budget for a moment.
+    if (atomic_load_explicit(&site->key, memory_order_relaxed) != key) {
+        atomic_store_explicit(&site->key, key, memory_order_relaxed);
+    }
+
+    if ((window != now) &&
+        atomic_compare_exchange_strong_explicit(&site->window, &window, now,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+        *suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    }
+
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) >= LOG_RATE_BURST) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&dropped_rate, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Writes one finished record. Called by the writer, or directly when it isn't running.
+static void write_record(log_level_t level, const char *text) {
+    FILE *output_stream = log_file ? log_file : stdout;
+    const char *color_code = ANSI_COLOR_GREEN;
+
+    if (level == LOG_WARNING) {
+        color_code = ANSI_COLOR_YELLOW;
+    } else if (level == LOG_ERROR) {
+        color_code = ANSI_COLOR_RED;
+        output_stream = log_file ? log_file : stderr;
+    }
+
+    if (log_file) {
+        // Log to file without colors
+        fprintf(output_stream, "%s\n", text);
+    } else {
+        // Log to console with colors
+        fprintf(output_stream, "%s%s%s\n", color_code, text, ANSI_COLOR_RESET);
+    }
+
+    atomic_fetch_add_explicit(&records_written, 1, memory_order_relaxed);
+}
+
+// Pops one record into the caller's buffer. Writer thread only.
+static int ring_pop(log_level_t *level, char *text, size_t size) {
+    unsigned long pos = atomic_load_explicit(&dequeue_pos, memory_order_relaxed);
+    log_record *rec = &ring[pos & LOG_RING_MASK];
+
+    if (atomic_load_explicit(&rec->seq, memory_order_acquire) != pos + 1) {
+        return 0;
+    }
+
+    *level = rec->level;
+    strncpy(text, rec->text, size - 1);
+    text[size - 1] = '\0';
+
+    // Hand the slot back to producers for the next lap.
+    atomic_store_explicit(&rec->seq, pos + LOG_RING_SLOTS, memory_order_release);
+    atomic_store_explicit(&dequeue_pos, pos + 1, memory_order_release);
+
+    return 1;
+}
+
+static void drain_ring(void) {
+    char text[LOG_RECORD_LENGTH];
+    log_level_t level;
+    int wrote = 0;
+
+    while (ring_pop(&level, text, sizeof(text))) {
+        write_record(level, text);
+        wrote = 1;
+
+        // Get an error and everything before it onto disk before going on.
+        if (level == LOG_ERROR) {
+            fflush(log_file ? log_file : stdout);
+        }
+    }
+
+    if (wrote) {
+        fflush(log_file ? log_file : stdout);
+    }
+}
+
+/* Writes whatever is still queued and re-raises the signal. Only write(2) is
+ * used, stdio isn't safe here. The ring isn't popped, so a record the writer
+ * was in the middle of may appear twice. That's better than losing the lines
+ * that led up to the crash. */
+static void fatal_signal_drain(int sig) {
+    int file_fd = atomic_load(&log_fd);
+    unsigned long pos = atomic_load_explicit(&dequeue_pos, memory_order_acquire);
+
+    for (unsigned long i = 0; i < LOG_RING_SLOTS; i++, pos++) {
+        log_record *rec = &ring[pos & LOG_RING_MASK];
+        int fd = file_fd;
+
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != pos + 1) {
+            break;
+        }
+
+        // Same streams as write_record(), errors go to stderr on the console.
+        if (fd < 0) {
+            fd = (rec->level == LOG_ERROR) ? STDERR_FILENO : STDOUT_FILENO;
+        }
+
+        if ((write(fd, rec->text, strnlen(rec->text, sizeof(rec->text))) < 0) ||
+            (write(fd, "\n", 1) < 0)) {
+            break;
+        }
+    }
+
+    // SA_RESETHAND already put the default action back.
+    raise(sig);
+}
+
+static void *log_writer_thread(void *arg) {
+    unsigned long reported_full = 0, reported_rate = 0;
+    long last_report = monotonic_seconds();
+    struct timespec deadline;
+
+    while (atomic_load(&writer_running)) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        sem_timedwait(&writer_wake, &deadline);
+
+        drain_ring();
+
+        if (monotonic_seconds() - last_report >= LOG_DROP_REPORT_SEC) {
+            unsigned long full = atomic_load_explicit(&dropped_full, memory_order_relaxed);
+            unsigned long rate = atomic_load_explicit(&dropped_rate, memory_order_relaxed);
+            char text[LOG_RECORD_LENGTH];
+
+            if ((full != reported_full) || (rate != reported_rate)) {
+                snprintf(text, sizeof(text), "%-*sLogging dropped %lu records (ring full), "
+                         "%lu rate limited.", PREAMBLE_WIDTH, "[WARN] logging.c: ",
+                         full - reported_full, rate - reported_rate);
+                write_record(LOG_WARNING, text);
+                reported_full = full;
+                reported_rate = rate;
+            }
+            last_report = monotonic_seconds();
+        }
+    }
+
+    return NULL;
+}
+
+static void format_record(char *dst, size_t size, const char *preamble, const char *message,
+                          unsigned long suppressed) {
+    if (suppressed > 0) {
+        snprintf(dst, size, "%s%s (%lu similar suppressed)", preamble, message, suppressed);
+    } else {
+        snprintf(dst, size, "%s%s", preamble, message);
+    }
+}
+
 // Logging function implementation
 void log_message(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...) {
     va_list args;
-    va_start(args, fmt);
-
     const char *level_str = NULL;
-    const char *color_code = NULL;
-    FILE *output_stream = log_file ? log_file : stdout;
+    unsigned long suppressed = 0;
 
     switch (level) {
         case LOG_INFO:
             level_str = "INFO";
-            color_code = ANSI_COLOR_GREEN;
             break;
         case LOG_WARNING:
             level_str = "WARN";
-            color_code = ANSI_COLOR_YELLOW;
             break;
         case LOG_ERROR:
             level_str = "ERR ";
-            color_code = ANSI_COLOR_RED;
-            output_stream = log_file ? log_file : stderr;
             break;
         default:
-            va_end(args);
             return;
     }
 
+    if (!rate_allow(file, line, &suppressed)) {
+        return;
+    }
+
     const char *filename = get_filename(file);
 
     // Create the preamble
@@ -101,33 +331,69 @@ void log_message(log_level_t level, const char *file, int line, const char *func
         preamble[PREAMBLE_WIDTH] = '\0';
     }
 
-    if (log_file) {
-        // Log to file without colors
-        fprintf(output_stream, "%s", preamble);
-    } else {
-        // Log to console with colors
-        fprintf(output_stream, "%s%s", color_code, preamble);
-    }
-
     // Prepare the log message
-    char log_message[1024];
+    char log_message[LOG_MESSAGE_LENGTH];
+    va_start(args, fmt);
     vsnprintf(log_message, sizeof(log_message), fmt, args);
+    va_end(args);
     remove_newlines(log_message);
 
-    // Print the log message
-    fprintf(output_stream, "%s", log_message);
-    if (!log_file) {
-        fprintf(output_stream, "%s", ANSI_COLOR_RESET);
+    // Before init_logging() or after close_logging(), write it ourselves.
+    if (!atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        char text[LOG_RECORD_LENGTH];
+        format_record(text, sizeof(text), preamble, log_message, suppressed);
+        write_record(level, text);
+        return;
     }
-    fprintf(output_stream, "\n");
 
-    va_end(args);
+    // Claim a slot. If the writer is that far behind, drop rather than block the caller.
+    unsigned long pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_record *rec = NULL;
+    for (;;) {
+        rec = &ring[pos & LOG_RING_MASK];
+        unsigned long seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped_full, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    rec->level = level;
+    format_record(rec->text, sizeof(rec->text), preamble, log_message, suppressed);
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+
+    sem_post(&writer_wake);
+}
+
+// Stops the writer and writes out whatever it left behind.
+static void stop_writer(void) {
+    if (!atomic_exchange(&writer_running, 0)) {
+        return;
+    }
+
+    sem_post(&writer_wake);
+    pthread_join(writer_thread, NULL);
+    sem_destroy(&writer_wake);
+
+    drain_ring();
 }
 
 // Initialization function implementation
 int init_logging(const char *filename, int to_file) {
+    stop_writer();
+
     // Close the previous log file if open
     if (log_file) {
+        atomic_store(&log_fd, -1);
         fclose(log_file);
         log_file = NULL;
     }
@@ -139,20 +405,66 @@ int init_logging(const char *filename, int to_file) {
                 fprintf(stderr, "Failed to open log file: %s\n", filename);
                 return -1;
             }
+            atomic_store(&log_fd, fileno(log_file));
         } else {
             fprintf(stderr, "Filename cannot be NULL when mode is LOG_TO_FILE\n");
             return -1;
         }
     }
 
+    // Reset the ring. Nothing can be queued while the writer is stopped.
+    for (unsigned long i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&enqueue_pos, 0);
+    atomic_store(&dequeue_pos, 0);
+
+    // Whatever is still queued when the process exits gets written out.
+    // A crash doesn't run atexit(), so drain from the fatal signals as well.
+    if (!exit_handler_registered) {
+        struct sigaction sa;
+
+        atexit(close_logging);
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = fatal_signal_drain;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESETHAND;
+        for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); i++) {
+            sigaction(fatal_signals[i], &sa, NULL);
+        }
+
+        exit_handler_registered = 1;
+    }
+
+    if (sem_init(&writer_wake, 0, 0) != 0) {
+        fprintf(stderr, "Failed to create log writer semaphore, logging synchronously.\n");
+        return 0;
+    }
+
+    atomic_store(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, log_writer_thread, NULL) != 0) {
+        atomic_store(&writer_running, 0);
+        sem_destroy(&writer_wake);
+        fprintf(stderr, "Failed to start log writer thread, logging synchronously.\n");
+    }
+
     return 0;
 }
 
 // Close logging function implementation
 void close_logging(void) {
+    stop_writer();
+
     if (log_file) {
+        atomic_store(&log_fd, -1);
         fclose(log_file);
         log_file = NULL;
     }
 }
 
+void log_get_stats(log_stats *stats) {
+    stats->written = atomic_load_explicit(&records_written, memory_order_relaxed);
+    stats->dropped_full = atomic_load_explicit(&dropped_full, memory_order_relaxed);
+    stats->dropped_rate = atomic_load_explicit(&dropped_rate, memory_order_relaxed);
+}
@@ -35,7 +35,10 @@ typedef enum {
 extern "C" {
 #endif
 
-// Logging function
+/* Logging function. Formats on the calling thread and queues the record for a
+ * background writer, so callers never wait on the console or log file. The
+ * writer flushes after every error. Each call site is limited to a burst of
+ * records per second; the rest are counted and dropped. */
 void log_message(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...);
 
 #ifdef __cplusplus
@@ -48,6 +51,16 @@ int init_logging(const char *filename, int to_file);
 // Close logging function
 void close_logging(void);
 
+/* Counters for the asynchronous writer. */
+typedef struct {
+    unsigned long written;          // Records written out
+    unsigned long dropped_full;     // Dropped because the writer fell behind
+    unsigned long dropped_rate;     // Dropped by the per call site rate limit
+} log_stats;
+
+// Copy the writer counters. Safe from any thread.
+void log_get_stats(log_stats *stats);
+
 // Logging modes
 #define LOG_TO_CONSOLE 0
 #define LOG_TO_FILE 1
@@ -21,13 +21,15 @@
 
 /* Threading Information */
 /* vid_out_thread    - Video output processing. Disk and/or streaming.
- * thread_handles[#] - NUM_AUDIO_THREADS number of audio threads.
- * video_proc_thread - Video input processing. Cameras to SDL.
+ * audio mixer       - One thread feeding a single ALSA stream, see audio.c.
+ * video_proc_thread - Video input processing. Pairs left/right camera frames
+ *                     and hands them to the render loop.
+ * capture_threads[#] - One per camera, draining each appsink at sensor rate.
  * command_proc_thread - USB/Serial input handling.
  * od_[LR]_thread    - If object detection is enabled. These will handle
  *                     object detection for each eye.
- * cpu_util_thread   - If a CPU utilization UI element is enabled, this
- *                     will keep that up-to-date.
+ * sampler_thread    - Reads wifi, CPU, memory, thermal and fan locally into
+ *                     system_metrics, see system_sampler.c.
  * map_download_thread - If a map UI element is enabled, this will keep
  *                       that up-to-date.
  * mosquitto loop    - There is a background process monitoring MQTT.
@@ -42,6 +44,7 @@
 #include <math.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -66,7 +69,6 @@
 
 /* POSIX Message Queue */
 #include <fcntl.h>
-#include <mqueue.h>
 #include <sys/stat.h>
 
 /* SDL2 */
@@ -102,38 +104,62 @@
 #include "defines.h" /* Out of order due to dependencies */
 #include "audio.h"
 #include "armor.h"
+#include "asset_bundle.h"
+#include "camera_governor.h"
 #include "command_processing.h"
 #include "config_manager.h"
 #include "config_parser.h"
 #include "curl_download.h"
+#include "detect_worker.h"
 #include "devices.h"
 #include "element_renderer.h"
+#include "frame_mailbox.h"
+#include "frame_pacer.h"
 #include "frame_rate_tracker.h"
+#include "glyph_atlas.h"
 #include "hud_manager.h"
 #include "image_utils.h"
+#include "input_trace.h"
+#include "latency_stats.h"
 #include "logging.h"
 #include "mirage.h"
 #include "mosquitto_comms.h"
+#include "nvmm_texture.h"
 #include "recording.h"
+#include "render_profiler.h"
 #include "screenshot.h"
 #include "secrets.h"
+#include "sensor_store.h"
 #include "system_metrics.h"
+#include "system_sampler.h"
+#include "texture_atlas.h"
+#include "texture_cache.h"
 #include "utils.h"
 #include "version.h"
 
-static pthread_mutex_t v_mutex = PTHREAD_MUTEX_INITIALIZER;  /* Mutex for video buffer access. */
-static GstMapInfo mapL[2], mapR[2];        /* Video memory maps. */
+/* A captured stereo pair. The right side is unused in single camera mode. */
+typedef struct {
+   GstSample *sampleL, *sampleR;
+   GstBuffer *bufferL, *bufferR;
+   GstMapInfo mapL, mapR;
+   int mappedL, mappedR;
 #ifdef DISPLAY_TIMING
-struct timespec ts_cap[2];          /* Store the display latency. */
+   struct timespec ts_cap;          /* Store the display latency. */
 #endif
-static int video_posted = 0;               /* Notify that the new video frames are ready. */
-static int buffer_num = 0;                 /* Video is double buffered. This swaps between them. */
+   unsigned long sensor_ns;         /* Estimated sensor capture time (latency_now_ns clock). */
+   unsigned long pull_ns;           /* When the appsink sample was pulled. */
+} stereo_frame;
+
+/* Camera frames are passed from video_processing_thread to the render loop through
+ * a lock-free triple buffer. Neither side ever waits on the other. */
+static stereo_frame video_frames[FRAME_MAILBOX_SLOTS];
+static frame_mailbox video_mailbox;
+static unsigned long displayed_frame_ns = 0;  /* Capture time of the frame on screen. */
 
 static int window_width = 0;
 static int window_height = 0;
 static pthread_mutex_t windowSizeMutex = PTHREAD_MUTEX_INITIALIZER;
 
-pthread_t od_L_thread = 0, od_R_thread = 0;  /* Object detection thread IDs */
 static int single_cam = 0;                   /* Single Camera Mode Enable */
 static int cam1_id = -1, cam2_id = -1;       /* Camera IDs for CSI or USB */
 
@@ -197,11 +223,6 @@ gps this_gps = {
 static char aiName[AI_NAME_MAX_LENGTH] = "";
 static char aiState[AI_STATE_MAX_LENGTH] = "";
 
-/* Audio */
-extern thread_info audio_threads[NUM_AUDIO_THREADS];
-mqd_t qd_server;
-extern mqd_t qd_clients[NUM_AUDIO_THREADS];
-
 const struct Alert alert_messages[ALERT_MAX] = {
    {ALERT_RECORDING, "ERROR: Recording failed!"},
    {ALERT_CONFIG_RELOADED, "Configuration reloaded successfully"}
@@ -224,6 +245,9 @@ element default_element =
    .filename_r = "",
    .filename_s = "",
    .filename_rs = "",
+   .filename_l = "",
+   .filename_w = "",
+   .filename_p = "",
 
    .filename_base = "",
    .filename_online = "",
@@ -231,7 +255,9 @@ element default_element =
    .filename_offline = "",
 
    .text = "",
-   .last_rendered_text = "",
+   .text_token = TEXT_TOKEN_NONE,
+   .last_rendered_text = NULL,
+   .log_generation = 0,
    .font = "",
    //SDL_Color font_color;
    .ttf_font = NULL,
@@ -258,6 +284,7 @@ element default_element =
    .texture_online = NULL,
    .texture_warning = NULL,
    .texture_offline = NULL,
+   .cached_textures = 0,
 
    .dst_rect = {0, 0, 0, 0},
 
@@ -281,7 +308,7 @@ element default_element =
    .text_x_offset = 0,
    .text_y_offset = 0,
 
-   .this_anim.first_frame = NULL,
+   .this_anim.sheet = NULL,
    .this_anim.frame_count = 0,
 
    .warning_temp = -1.0,
@@ -326,16 +353,6 @@ typedef struct _local_fonts {
 } local_font;
 local_font *font_list = NULL;
 
-/* Local texture cache to store each loaded texture */
-typedef struct _texture_cache {
-   SDL_Texture *texture;
-   char filename[MAX_FILENAME_LENGTH * 2];
-   time_t file_mtime;     /* File modification time for cache validation */
-
-   struct _texture_cache *next;
-} texture_cache;
-texture_cache *texture_list = NULL;
-
 /* Detected Objects */
 detect this_detect[2][MAX_DETECT];
 detect this_detect_sorted[2][MAX_DETECT];
@@ -344,6 +361,10 @@ static SDL_Renderer *renderer = NULL;               /* Global SDL Renderer */
 static SDL_threadID main_thread_id = 0;
 
 od_data oddataL, oddataR;
+#ifdef OD_STEREO_BATCH
+static detect_stereo stereo_detect;
+static int stereo_detect_active = 0;
+#endif
 
 /**
  * Returns a pointer to the global motion data structure.
@@ -423,11 +444,32 @@ SDL_Renderer *get_sdl_renderer(void)
    return renderer;
 }
 
+#ifdef MIRAGE_BENCH
+/**
+ * Hands the benchmark's renderer to the render helpers, from its main thread.
+ */
+void mirage_bench_set_renderer(SDL_Renderer *bench_renderer)
+{
+   renderer = bench_renderer;
+   main_thread_id = SDL_ThreadID();
+}
+
+/* mirage_bench links this file for its helpers and brings its own main(). */
+#define main mirage_main
+#endif
+
 /**
  * Enables or disables object detection.
  */
 int set_detect_enabled(int enable)
 {
+#ifdef USE_NVMM_ZERO_COPY
+   /* Camera frames never reach system memory in zero-copy mode. */
+   if (enable) {
+      LOG_WARNING("Object detection is not available with the NVMM zero-copy camera path.");
+      enable = 0;
+   }
+#endif
    detect_enabled = enable;
 
    return detect_enabled;
@@ -483,6 +525,98 @@ int get_curr_fps(void) {
    return curr_fps;
 }
 
+/* The file behind one element_texture_ref bit. */
+static const char *element_texture_filename(element *this_element, unsigned int ref)
+{
+   switch (ref) {
+   case ELEMENT_TEXTURE_FILE:
+      return this_element->filename;
+   case ELEMENT_TEXTURE_R:
+      return this_element->filename_r;
+   case ELEMENT_TEXTURE_S:
+      return this_element->filename_s;
+   case ELEMENT_TEXTURE_RS:
+      return this_element->filename_rs;
+   case ELEMENT_TEXTURE_L:
+      return this_element->filename_l;
+   case ELEMENT_TEXTURE_W:
+      return this_element->filename_w;
+   case ELEMENT_TEXTURE_P:
+      return this_element->filename_p;
+   case ELEMENT_TEXTURE_BASE:
+      return this_element->filename_base;
+   case ELEMENT_TEXTURE_ONLINE:
+      return this_element->filename_online;
+   case ELEMENT_TEXTURE_WARNING:
+      return this_element->filename_warning;
+   case ELEMENT_TEXTURE_OFFLINE:
+      return this_element->filename_offline;
+   case ELEMENT_TEXTURE_SHEET:
+      return (this_element->this_anim.sheet != NULL) ? this_element->this_anim.sheet->image : NULL;
+   default:
+      return NULL;
+   }
+}
+
+/*
+ * Takes a texture cache reference for one of the element's files.
+ */
+SDL_Texture *acquire_element_texture(element *this_element, element_texture_ref ref)
+{
+   const char *filename = element_texture_filename(this_element, ref);
+   SDL_Texture *texture = get_cached_texture(filename);
+
+   if (texture == NULL) {
+      return NULL;
+   }
+
+   /* One reference per file per element, that's all free_elements() gives back. */
+   if (this_element->cached_textures & ref) {
+      release_cached_texture(filename);
+   }
+   this_element->cached_textures |= ref;
+
+   return texture;
+}
+
+/* Swaps one texture for another in every element of a list. */
+static void retarget_element_list(element *start_element, SDL_Texture *from, SDL_Texture *to)
+{
+   for (element *this_element = start_element; this_element != NULL;
+        this_element = this_element->next) {
+      SDL_Texture **fields[] = {
+         &this_element->texture, &this_element->texture_r, &this_element->texture_s,
+         &this_element->texture_rs, &this_element->texture_l, &this_element->texture_w,
+         &this_element->texture_p, &this_element->texture_base, &this_element->texture_online,
+         &this_element->texture_warning, &this_element->texture_offline
+      };
+
+      /* Statics without a configured size were sized from the old image. */
+      if ((this_element->texture == from) && (this_element->type == STATIC) &&
+          (this_element->width == 0) && (this_element->height == 0)) {
+         SDL_QueryTexture(to, NULL, NULL, &this_element->dst_rect.w, &this_element->dst_rect.h);
+      }
+
+      for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+         if (*fields[i] == from) {
+            *fields[i] = to;
+         }
+      }
+   }
+}
+
+/*
+ * Points every element holding a texture at its replacement.
+ */
+void retarget_element_textures(SDL_Texture *from, SDL_Texture *to)
+{
+   armor_settings *this_as = get_armor_settings();
+
+   retarget_element_list(first_element, from, to);
+   retarget_element_list(this_as->armor_elements, from, to);
+   retarget_element_list(&intro_element, from, to);
+}
+
 /* Free the UI element list. */
 void free_elements(element *start_element)
 {
@@ -537,13 +671,17 @@ void free_elements(element *start_element)
          this_element->last_metrics_text = NULL;
       }
 
-      for (int i = 0; i < this_element->this_anim.frame_count; i++) {
-#ifdef DEBUG_SHUTDOWN
-         LOG_INFO("Freeing frame %d.", i);
-#endif
-         free(this_element->this_anim.frame_lookup[i]);
+      /* Give back our cache references. Go by what was acquired, the fields
+       * may have been swapped or alias each other since. */
+      for (unsigned int ref = 1; ref & ELEMENT_TEXTURE_ALL; ref <<= 1) {
+         if (this_element->cached_textures & ref) {
+            release_cached_texture(element_texture_filename(this_element, ref));
+         }
       }
 
+      release_animation(&this_element->this_anim);
+      free(this_element->last_rendered_text);
+
 #ifdef DEBUG_SHUTDOWN
       LOG_INFO("Freeing element.");
 #endif
@@ -629,6 +767,53 @@ void dump_element_list(void)
    }
 }
 
+/* HUD recording overlay, see hud_overlay_begin(). */
+static SDL_Texture *hud_overlay = NULL;
+static int hud_overlay_width = 0;
+static int hud_overlay_height = 0;
+static int hud_overlay_drawn = 0;      /* The overlay holds this frame's HUD. */
+
+/* Hands the oldest finished readback to the recorder and queues this frame's.
+ * Both halves are non-blocking, so recorded frames trail the display by a
+ * frame or two. Frames are dropped when the ring or the frame pool is full. */
+static void record_readback_frame(void)
+{
+   static unsigned long last_overlay_ns = 0;
+   record_frame *out_frame = NULL;
+   size_t ready_size = 0;
+   unsigned long rendered_ns = 0;
+   int out_w = 0, out_h = 0, nv12 = 0;
+   unsigned long now = latency_now_ns();
+
+   /* Collect first so this frame has a free slot. */
+   if (readback_ring_ready(&ready_size)) {
+      out_frame = record_frame_acquire(ready_size);
+      /* With no free frame the readback stays queued until the encoder catches up. */
+      if ((out_frame != NULL) &&
+          (readback_ring_collect(out_frame->pixels, out_frame->size, &rendered_ns) != 0)) {
+         record_frame_release(out_frame);
+         out_frame = NULL;
+      }
+   }
+
+   get_record_output_format(get_recording_state(), &out_w, &out_h, &nv12);
+   if (!record_composite_active()) {
+      readback_ring_submit(renderer, NULL, out_w, out_h, nv12, now);
+   } else if (hud_overlay_drawn && ((now - last_overlay_ns) >= 1000000000UL / RECORD_OVERLAY_FPS)) {
+      /* The encoder holds the last overlay, so drop to its rate. Frames
+       * without a fresh overlay (the intro) just keep the previous one. */
+      if (readback_ring_submit(renderer, hud_overlay, out_w, out_h, 0, now) == 0) {
+         last_overlay_ns = now;
+      }
+   }
+
+   if (out_frame != NULL) {
+      /* Stamped with when it was drawn, not when the readback landed. */
+      out_frame->timestamp_ns = rendered_ns;
+      record_publish_frame(out_frame);
+   }
+}
+
 /* This function plays the intro animation on power up. It is designed to minimize dead loading time.
  * I'd still like to find a better way to do this but due to the way SDL handles threads, it's not
  * that easy. */
@@ -638,15 +823,17 @@ int play_intro(int frames, int clear, int *finished)
    SDL_Rect dst_rect_l, dst_rect_r;
    int frame_count = 0;
 
-   video_out_data *this_vod = get_video_out_data();
-
 #ifdef ENCODE_TIMING
    int cur_time = 0, max_time = 0, min_time = 0, weight = 0;
    double avg_time = 0.0;
 #endif
 
+   if (intro_element.this_anim.sheet == NULL) {
+      return 1;
+   }
+
    if (intro_element.texture == NULL) {
-      intro_element.texture = get_cached_texture(intro_element.this_anim.image);
+      intro_element.texture = get_cached_texture(intro_element.this_anim.sheet->image);
       if (!intro_element.texture) {
          SDL_Log("Couldn't load %s: %s\n", intro_element.filename, SDL_GetError());
          return 1;
@@ -672,19 +859,17 @@ int play_intro(int frames, int clear, int *finished)
       dst_rect_l.w = dst_rect_r.w = intro_element.this_anim.current_frame->source_w;
       dst_rect_l.h = dst_rect_r.h = intro_element.this_anim.current_frame->source_h;
 
-      if (intro_element.this_anim.current_frame->next != NULL) {
-         if (finished != NULL) {
-            *finished = 0;
-         }
-         intro_element.this_anim.current_frame = intro_element.this_anim.current_frame->next;
-      } else {
+      /* The intro is done once it has shown its last frame. */
+      if (advance_animation(&intro_element.this_anim)) {
          if (finished != NULL) {
             *finished = 1;
          }
-         intro_element.this_anim.current_frame = intro_element.this_anim.first_frame;
+      } else if (finished != NULL) {
+         *finished = 0;
       }
 
       renderStereo(intro_element.texture, &src_rect, &dst_rect_l, &dst_rect_r, intro_element.angle);
+      texture_atlas_flush();
 
       SDL_RenderPresent(renderer);
 
@@ -693,43 +878,22 @@ int play_intro(int frames, int clear, int *finished)
          Uint32 start = 0, stop = 0;
 #endif
 
-         this_vod->rgb_out_pixels[this_vod->write_index] =
-             malloc(window_width * RGB_OUT_SIZE * window_height);
-         if (this_vod->rgb_out_pixels[this_vod->write_index] == NULL) {
-            LOG_ERROR("Unable to malloc rgb frame 0.");
-            return 2;
-         }
 #ifdef ENCODE_TIMING
          start = SDL_GetTicks();
 #endif
-         if (OpenGL_RenderReadPixelsAsync(renderer, NULL, PIXEL_FORMAT_OUT,
-                                  this_vod->rgb_out_pixels[this_vod->write_index],
-                                  window_width * RGB_OUT_SIZE) != 0) {
-            LOG_ERROR("OpenGL_RenderReadPixelsAsync() failed");
-            free(this_vod->rgb_out_pixels[this_vod->write_index]);
-            this_vod->rgb_out_pixels[this_vod->write_index] = NULL;
+         record_readback_frame();
 #ifdef ENCODE_TIMING
-         } else {
-            stop = SDL_GetTicks();
-            cur_time = stop - start;
-            avg_time = ((avg_time * weight) + cur_time) / (weight + 1);
-            weight++;
-            if (cur_time > max_time)
-               max_time = cur_time;
-            if ((cur_time < min_time) || (min_time == 0))
-               min_time = cur_time;
-            LOG_INFO("OpenGL_RenderReadPixelsAsync(): %0.2f ms, min: %d, max: %d. weight: %d",
-                   avg_time, min_time, max_time, weight);
+         stop = SDL_GetTicks();
+         cur_time = stop - start;
+         avg_time = ((avg_time * weight) + cur_time) / (weight + 1);
+         weight++;
+         if (cur_time > max_time)
+            max_time = cur_time;
+         if ((cur_time < min_time) || (min_time == 0))
+            min_time = cur_time;
+         LOG_INFO("record_readback_frame(): %0.2f ms, min: %d, max: %d. weight: %d",
+                avg_time, min_time, max_time, weight);
 #endif
-         }
-
-         pthread_mutex_lock(&this_vod->p_mutex);
-         if (this_vod->rgb_out_pixels[this_vod->buffer_num] != NULL) {
-            free(this_vod->rgb_out_pixels[this_vod->buffer_num]);
-            this_vod->rgb_out_pixels[this_vod->buffer_num] = NULL;
-         }
-         rotate_triple_buffer_indices(this_vod);
-         pthread_mutex_unlock(&this_vod->p_mutex);
 
          if (get_video_out_thread() == 0) {
             pthread_t thread_id;
@@ -748,19 +912,108 @@ int play_intro(int frames, int clear, int *finished)
    return 0;
 }
 
-/* Pthread function to background object detection. Runs to completion once per frame. */
-void *object_detection_thread(void *arg)
+/**
+ * Loads the detection networks and starts the workers.
+ */
+static int init_object_detection(int argc, char **argv)
 {
-   //int detects = 0;
-   od_data *my_data = (od_data *) arg;
+   hud_display_settings *this_hds = get_hud_display_settings();
 
-   detect_image(&my_data->detect_obj, my_data->pix_data, this_detect[my_data->eye], MAX_DETECT);
-   //detects = detect_image(&my_data->detect_obj, my_data->pix_data, this_detect[my_data->eye], MAX_DETECT);
-   //printf("Objects detected: %d\n", detects);
+#if defined(OD_STEREO_BATCH) && !defined(OD_PROPER_WAIT)
+   if (!single_cam) {
+      if (init_detect_stereo(&stereo_detect, argc, argv, this_hds->cam_frame_width,
+                             this_hds->cam_frame_height)) {
+         LOG_ERROR("Error initializing stereo detect!!!");
+         return FAILURE;
+      }
+      stereo_detect_active = 1;
 
-   my_data->complete = 1;
+      if (detect_worker_start_stereo(&stereo_detect) != SUCCESS) {
+         LOG_ERROR("Error starting stereo detection worker.");
+         return FAILURE;
+      }
 
-   return NULL;
+      return SUCCESS;
+   }
+#endif
+
+   if (init_detect(&oddataL.detect_obj, argc, argv, this_hds->cam_frame_width, this_hds->cam_frame_height))
+   {
+      LOG_ERROR("Error initializing detect!!!");
+      return FAILURE;
+   }
+
+   if (intro_element.enabled) {
+      play_intro(15, 1, NULL);
+   }
+   if (init_detect(&oddataR.detect_obj, argc, argv, this_hds->cam_frame_width, this_hds->cam_frame_height))
+   {
+      LOG_ERROR("Error initializing detect!!!");
+      return FAILURE;
+   }
+
+#ifndef OD_PROPER_WAIT
+   if (detect_worker_start(&oddataL.detect_obj, single_cam ? NULL : &oddataR.detect_obj) != SUCCESS) {
+      LOG_ERROR("Error starting detection workers.");
+      return FAILURE;
+   }
+#endif
+
+   return SUCCESS;
+}
+
+/**
+ * Stops the workers and frees the detection networks.
+ */
+static void cleanup_object_detection(void)
+{
+   detect_worker_stop();
+
+#ifdef OD_STEREO_BATCH
+   if (stereo_detect_active) {
+      free_detect_stereo(&stereo_detect);
+      stereo_detect_active = 0;
+      return;
+   }
+#endif
+
+   free_detect(&oddataL.detect_obj);
+   free_detect(&oddataR.detect_obj);
+}
+
+/* The record tee for one eye. The encoder should see what the window shows,
+ * so if the crop happens at render time the branch crops as well. */
+static void build_record_tee_string(char *tee, size_t tee_size, const char *suffix,
+                                    const hud_display_settings *this_hds) {
+   char convert[GSTREAMER_PIPELINE_LENGTH/16] = "";
+
+#ifndef ORIGINAL_RATIO
+   int crop = !this_hds->cam_crop_at_source && (this_hds->cam_crop_width > 0) &&
+              (this_hds->cam_frame_crop_x >= 0) &&
+              (this_hds->cam_frame_crop_x + this_hds->cam_crop_width <= this_hds->cam_frame_width) &&
+              (this_hds->cam_crop_width < this_hds->cam_frame_width);
+#else
+   int crop = 0;
+#endif
+
+   if (crop) {
+#ifdef PLATFORM_JETSON
+      g_snprintf(convert, sizeof(convert), GST_CAM_PIPELINE_CONVERT GST_CAM_RECORD_TO_SYSTEM,
+                 this_hds->cam_frame_crop_x, this_hds->cam_frame_crop_x + this_hds->cam_crop_width,
+                 0, this_hds->cam_frame_height);
+#else
+      g_snprintf(convert, sizeof(convert), GST_CAM_PIPELINE_CONVERT GST_CAM_RECORD_TO_SYSTEM,
+                 this_hds->cam_frame_crop_x,
+                 this_hds->cam_frame_width - this_hds->cam_frame_crop_x - this_hds->cam_crop_width,
+                 0, 0);
+#endif
+   } else {
+#ifdef USE_NVMM_ZERO_COPY
+      g_snprintf(convert, sizeof(convert), "nvvidconv ! " GST_CAM_RECORD_TO_SYSTEM);
+#endif
+   }
+
+   g_snprintf(tee, tee_size, GST_CAM_PIPELINE_RECORD_TEE, suffix, suffix, convert, suffix, suffix);
 }
 
 /**
@@ -774,43 +1027,71 @@ void *object_detection_thread(void *arg)
  * based on the camera type and combines them into a single pipeline string.
  * For CSI cameras, sensor_id 0 is used for left and 1 for right.
  * For USB cameras, /dev/video0 is used for left and /dev/video2 for right.
+ *
+ * When cropping at source is enabled the converter also crops (and optionally
+ * scales) the frame so the appsink only delivers the pixels we display.
+ *
+ * With "Record Composite" each eye also gets a record tee for the encoder.
  */
 static void build_pipeline_string(char* descr, size_t descr_size, const char* cam_type,
                                   const hud_display_settings* this_hds) {
    char left_pipeline[GSTREAMER_PIPELINE_LENGTH/2];
    char right_pipeline[GSTREAMER_PIPELINE_LENGTH/2];
+   char left_tee[GSTREAMER_PIPELINE_LENGTH/8] = "";
+   char right_tee[GSTREAMER_PIPELINE_LENGTH/8] = "";
    bool is_csi = (cam_type == NULL) || (strncmp(cam_type, "csi", 3) == 0);
+   const char *input_fmt = NULL;
+   int crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+
+   if (this_hds->record_composite) {
+      build_record_tee_string(left_tee, sizeof(left_tee), single_cam ? "" : "L", this_hds);
+      if (!single_cam) {
+         build_record_tee_string(right_tee, sizeof(right_tee), "R", this_hds);
+      }
+   }
+
+   if (this_hds->cam_crop_at_source) {
+#ifdef PLATFORM_JETSON
+      /* nvvidconv wants the crop rectangle. */
+      crop_left = this_hds->cam_crop_x;
+      crop_right = this_hds->cam_crop_x + this_hds->cam_crop_width;
+      crop_top = 0;
+      crop_bottom = this_hds->cam_input_height;
+#else
+      /* videocrop wants the margins. */
+      crop_left = this_hds->cam_crop_x;
+      crop_right = this_hds->cam_input_width - this_hds->cam_crop_x - this_hds->cam_crop_width;
+#endif
+   }
 
    if (is_csi) {
       if (cam1_id == -1) {
          cam1_id = DEFAULT_CSI_CAM1;
          cam2_id = DEFAULT_CSI_CAM2;
       }
-      g_snprintf(left_pipeline, sizeof(left_pipeline), GST_CAM_PIPELINE_CSI_INPUT GST_CAM_PIPELINE_OUTPUT,
-                 cam1_id, this_hds->cam_input_width, this_hds->cam_input_height,
-                 this_hds->cam_input_fps, this_hds->cam_frame_duration,
-                 single_cam ? "" : "L");
-
-      if (!single_cam) {
-         g_snprintf(right_pipeline, sizeof(right_pipeline), GST_CAM_PIPELINE_CSI_INPUT GST_CAM_PIPELINE_OUTPUT,
-                    cam2_id, this_hds->cam_input_width, this_hds->cam_input_height,
-                    this_hds->cam_input_fps, this_hds->cam_frame_duration, "R");
-      }
+      input_fmt = GST_CAM_PIPELINE_CSI_INPUT GST_CAM_PIPELINE_CONVERT GST_CAM_PIPELINE_OUTPUT;
    } else {
       if (cam1_id == -1) {
          cam1_id = DEFAULT_USB_CAM1;
          cam2_id = DEFAULT_USB_CAM2;
       }
-      g_snprintf(left_pipeline, sizeof(left_pipeline), GST_CAM_PIPELINE_USB_INPUT GST_CAM_PIPELINE_OUTPUT,
-                 cam1_id, this_hds->cam_input_width, this_hds->cam_input_height,
-                 this_hds->cam_input_fps, this_hds->cam_frame_duration,
-                 single_cam ? "" : "L");
+      input_fmt = GST_CAM_PIPELINE_USB_INPUT GST_CAM_PIPELINE_CONVERT GST_CAM_PIPELINE_OUTPUT;
+   }
 
-      if (!single_cam) {
-         g_snprintf(right_pipeline, sizeof(right_pipeline), GST_CAM_PIPELINE_USB_INPUT GST_CAM_PIPELINE_OUTPUT,
-                    cam2_id, this_hds->cam_input_width, this_hds->cam_input_height,
-                    this_hds->cam_input_fps, this_hds->cam_frame_duration, "R");
-      }
+   g_snprintf(left_pipeline, sizeof(left_pipeline), input_fmt,
+              cam1_id, this_hds->cam_input_width, this_hds->cam_input_height,
+              this_hds->cam_input_fps,
+              crop_left, crop_right, crop_top, crop_bottom,
+              this_hds->cam_frame_width, this_hds->cam_frame_height, left_tee,
+              this_hds->cam_frame_duration, single_cam ? "" : "L");
+
+   if (!single_cam) {
+      g_snprintf(right_pipeline, sizeof(right_pipeline), input_fmt,
+                 cam2_id, this_hds->cam_input_width, this_hds->cam_input_height,
+                 this_hds->cam_input_fps,
+                 crop_left, crop_right, crop_top, crop_bottom,
+                 this_hds->cam_frame_width, this_hds->cam_frame_height, right_tee,
+                 this_hds->cam_frame_duration, "R");
    }
 
    if (single_cam) {
@@ -820,179 +1101,503 @@ static void build_pipeline_string(char* descr, size_t descr_size, const char* ca
    }
 }
 
+/* Drop whatever a mailbox slot is holding so it can be refilled. */
+static void release_stereo_frame(stereo_frame *this_frame)
+{
+   if (this_frame->mappedL) {
+      gst_buffer_unmap(this_frame->bufferL, &this_frame->mapL);
+      this_frame->mappedL = 0;
+   }
+   if (this_frame->sampleL != NULL) {
+      gst_sample_unref(this_frame->sampleL);
+      this_frame->sampleL = NULL;
+   }
+   this_frame->bufferL = NULL;
+
+   if (this_frame->mappedR) {
+      gst_buffer_unmap(this_frame->bufferR, &this_frame->mapR);
+      this_frame->mappedR = 0;
+   }
+   if (this_frame->sampleR != NULL) {
+      gst_sample_unref(this_frame->sampleR);
+      this_frame->sampleR = NULL;
+   }
+   this_frame->bufferR = NULL;
+}
+
+void get_video_mailbox_stats(frame_mailbox_stats *stats)
+{
+   frame_mailbox_get_stats(&video_mailbox, stats);
+}
+
+unsigned long get_displayed_frame_ns(void)
+{
+   return displayed_frame_ns;
+}
+
+/* Per-eye capture queue. Filled by eye_capture_thread, drained by the pairing stage. */
+typedef struct {
+   GstElement *sink;
+   const char *name;
+   GstSample *samples[CAM_EYE_QUEUE_DEPTH];
+   GstClockTime pts[CAM_EYE_QUEUE_DEPTH];
+   unsigned long arrival_ns[CAM_EYE_QUEUE_DEPTH];  /* CLOCK_MONOTONIC when pulled. */
+   unsigned long sensor_ns[CAM_EYE_QUEUE_DEPTH];   /* Estimated capture time, same clock. */
+   int head;
+   int count;
+   int eos;
+   int stopping;                                   /* Pipeline is being torn down. */
+   unsigned long overflow;                         /* Dropped because the queue was full. */
+   unsigned long unmatched;                        /* Dropped by the pairing stage. */
+} eye_queue;
+
+static pthread_mutex_t eye_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t eye_cond = PTHREAD_COND_INITIALIZER;
+static eye_queue eye_queues[2];
+
+/* Stereo sync stats. Written by the pairing stage only. */
+static atomic_long stereo_skew_ns = 0;
+static atomic_long stereo_skew_max_ns = 0;
+static atomic_ulong stereo_pairs = 0;
+static atomic_ulong stereo_hiccups = 0;
+
+/* Work out when the sensor captured a sample, in latency_now_ns() time.
+ * The PTS is in pipeline running time so compare it against the pipeline clock now. */
+static unsigned long sample_sensor_ns(GstElement *sink, GstSample *sample, unsigned long now_ns)
+{
+   GstClock *clock = gst_element_get_clock(sink);
+   GstBuffer *buffer = gst_sample_get_buffer(sample);
+   GstClockTime running = 0;
+   unsigned long age = 0;
+
+   if ((clock == NULL) || (buffer == NULL) || !GST_BUFFER_PTS_IS_VALID(buffer)) {
+      if (clock != NULL) {
+         gst_object_unref(clock);
+      }
+      return 0;
+   }
+
+   running = gst_clock_get_time(clock) - gst_element_get_base_time(sink);
+   gst_object_unref(clock);
+
+   if (running > GST_BUFFER_PTS(buffer)) {
+      age = running - GST_BUFFER_PTS(buffer);
+   }
+
+   return (age < now_ns) ? now_ns - age : 0;
+}
+
+/* Pull samples from a single appsink as fast as the sensor delivers them. */
+static void *eye_capture_thread(void *arg)
+{
+   eye_queue *this_queue = (eye_queue *) arg;
+   GstSample *sample = NULL;
+
+   while (!quit) {
+      g_signal_emit_by_name(this_queue->sink, "pull-sample", &sample, NULL);
+      if (sample == NULL) {
+         int stopping = 0;
+
+         pthread_mutex_lock(&eye_mutex);
+         stopping = this_queue->stopping;
+         pthread_mutex_unlock(&eye_mutex);
+         if (quit || stopping) {
+            break;
+         }
+         if (gst_app_sink_is_eos(GST_APP_SINK(this_queue->sink))) {
+            LOG_ERROR("%s returned NULL. It is EOS.", this_queue->name);
+            pthread_mutex_lock(&eye_mutex);
+            this_queue->eos = 1;
+            pthread_cond_signal(&eye_cond);
+            pthread_mutex_unlock(&eye_mutex);
+            break;
+         }
+         LOG_ERROR("%s returned NULL. It is NOT EOS!?!?", this_queue->name);
+         continue;
+      }
+
+      pthread_mutex_lock(&eye_mutex);
+      if (this_queue->count == CAM_EYE_QUEUE_DEPTH) {
+         /* Bounded: the oldest frame goes so we never fall behind the sensor. */
+         gst_sample_unref(this_queue->samples[this_queue->head]);
+         this_queue->head = (this_queue->head + 1) % CAM_EYE_QUEUE_DEPTH;
+         this_queue->count--;
+         this_queue->overflow++;
+      }
+      int tail = (this_queue->head + this_queue->count) % CAM_EYE_QUEUE_DEPTH;
+      this_queue->samples[tail] = sample;
+      this_queue->pts[tail] = gst_sample_get_buffer(sample)->pts;
+      this_queue->arrival_ns[tail] = latency_now_ns();
+      this_queue->sensor_ns[tail] = sample_sensor_ns(this_queue->sink, sample,
+                                                     this_queue->arrival_ns[tail]);
+      latency_record(LAT_SENSOR_TO_PULL, this_queue->sensor_ns[tail], this_queue->arrival_ns[tail]);
+      this_queue->count++;
+      pthread_cond_signal(&eye_cond);
+      pthread_mutex_unlock(&eye_mutex);
+
+      sample = NULL;
+   }
+
+   return NULL;
+}
+
+/* Queue helpers. Caller holds eye_mutex. */
+static GstSample *eye_queue_pop(eye_queue *this_queue, unsigned long *sensor_ns,
+                                unsigned long *pull_ns)
+{
+   GstSample *sample = this_queue->samples[this_queue->head];
+
+   /* Keep the oldest of the pair, that's what the viewer is waiting on. */
+   if ((sensor_ns != NULL) && ((*sensor_ns == 0) || (this_queue->sensor_ns[this_queue->head] < *sensor_ns))) {
+      *sensor_ns = this_queue->sensor_ns[this_queue->head];
+   }
+   if ((pull_ns != NULL) && ((*pull_ns == 0) || (this_queue->arrival_ns[this_queue->head] < *pull_ns))) {
+      *pull_ns = this_queue->arrival_ns[this_queue->head];
+   }
+
+   this_queue->samples[this_queue->head] = NULL;
+   this_queue->head = (this_queue->head + 1) % CAM_EYE_QUEUE_DEPTH;
+   this_queue->count--;
+
+   return sample;
+}
+
+static GstClockTime eye_queue_pts(eye_queue *this_queue, int n)
+{
+   return this_queue->pts[(this_queue->head + n) % CAM_EYE_QUEUE_DEPTH];
+}
+
+static void eye_queue_drop(eye_queue *this_queue)
+{
+   gst_sample_unref(eye_queue_pop(this_queue, NULL, NULL));
+   this_queue->unmatched++;
+}
+
+static void eye_queue_flush(eye_queue *this_queue)
+{
+   while (this_queue->count > 0) {
+      gst_sample_unref(eye_queue_pop(this_queue, NULL, NULL));
+   }
+}
+
+static long pts_diff(GstClockTime a, GstClockTime b)
+{
+   return labs((long) a - (long) b);
+}
+
+/* Take ownership of the samples, map them and publish the pair. */
+static stereo_frame *publish_stereo_frame(stereo_frame *this_frame, GstSample *left,
+                                          GstSample *right, unsigned long sensor_ns,
+                                          unsigned long pull_ns)
+{
+   release_stereo_frame(this_frame);
+
+   this_frame->sensor_ns = sensor_ns;
+   this_frame->pull_ns = pull_ns;
+
+   this_frame->sampleL = left;
+   this_frame->bufferL = gst_sample_get_buffer(left);
+   this_frame->mappedL = gst_buffer_map(this_frame->bufferL, &this_frame->mapL, GST_MAP_READ);
+
+   if (right != NULL) {
+      this_frame->sampleR = right;
+      this_frame->bufferR = gst_sample_get_buffer(right);
+      this_frame->mappedR = gst_buffer_map(this_frame->bufferR, &this_frame->mapR, GST_MAP_READ);
+   }
+
+   if (!this_frame->mappedL || ((right != NULL) && !this_frame->mappedR)) {
+      LOG_ERROR("Unable to map camera buffers.");
+      return this_frame;
+   }
+
+#ifdef DISPLAY_TIMING
+   clock_gettime(CLOCK_REALTIME, &this_frame->ts_cap);
+#endif
+
+#ifndef USE_NVMM_ZERO_COPY
+   if (trace_is_recording_frames()) {
+      trace_record_frame(this_frame->mapL.data, this_frame->mapL.size,
+                         right != NULL ? this_frame->mapR.data : NULL,
+                         right != NULL ? this_frame->mapR.size : 0);
+   }
+#endif
+
+   return &video_frames[frame_mailbox_publish(&video_mailbox)];
+}
+
+/* Wrap replayed pixels in a sample so they take the same path as a capture. */
+static GstSample *trace_frame_sample(const unsigned char *pixels, size_t size)
+{
+   GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+   GstSample *sample = NULL;
+
+   if (buffer == NULL) {
+      return NULL;
+   }
+
+   gst_buffer_fill(buffer, 0, pixels, size);
+   sample = gst_sample_new(buffer, NULL, NULL, NULL);
+   gst_buffer_unref(buffer);
+
+   return sample;
+}
+
+/* Publish a replayed camera frame from the render thread. It's the only producer
+ * during a replay, the capture threads aren't started. */
+static void publish_trace_frame(const unsigned char *left, const unsigned char *right)
+{
+   static stereo_frame *this_frame = NULL;
+   hud_display_settings *this_hds = get_hud_display_settings();
+   size_t size = (size_t) this_hds->cam_frame_width * this_hds->cam_frame_height * 4;
+   unsigned long now = latency_now_ns();
+   GstSample *sample_l = NULL, *sample_r = NULL;
+
+   if (this_frame == NULL) {
+      this_frame = &video_frames[frame_mailbox_back(&video_mailbox)];
+   }
+
+   sample_l = trace_frame_sample(left, size);
+   if (right != NULL) {
+      sample_r = trace_frame_sample(right, size);
+   }
+   if ((sample_l == NULL) || ((right != NULL) && (sample_r == NULL))) {
+      LOG_ERROR("Unable to allocate a replay camera frame.");
+      if (sample_l != NULL) {
+         gst_sample_unref(sample_l);
+      }
+      if (sample_r != NULL) {
+         gst_sample_unref(sample_r);
+      }
+      return;
+   }
+
+   this_frame = publish_stereo_frame(this_frame, sample_l, sample_r, now, now);
+}
+
+void get_stereo_sync_stats(stereo_sync_stats *stats)
+{
+   stats->skew_ns = atomic_load(&stereo_skew_ns);
+   stats->skew_max_ns = atomic_load(&stereo_skew_max_ns);
+   stats->pairs = atomic_load(&stereo_pairs);
+   stats->hiccups = atomic_load(&stereo_hiccups);
+
+   pthread_mutex_lock(&eye_mutex);
+   stats->overflow_l = eye_queues[0].overflow;
+   stats->overflow_r = eye_queues[1].overflow;
+   stats->unmatched_l = eye_queues[0].unmatched;
+   stats->unmatched_r = eye_queues[1].unmatched;
+   pthread_mutex_unlock(&eye_mutex);
+}
+
 /* Video input handling thread.
- * This thread handles input from the cameras and camera sync using timestamps.
+ * Each appsink is drained by its own eye_capture_thread into a small bounded
+ * queue. This thread is the pairing stage: it matches the closest left/right
+ * PTS within the tolerance and publishes pairs to video_mailbox, so it never
+ * waits on rendering and a slow sensor can't stall the other eye.
  */
 void *video_processing_thread(void *arg)
 {
-   GstElement *pipeline = NULL, *sinkL = NULL, *sinkR = NULL;
-   GstSample *sampleL[2] = { NULL }, *sampleR[2] = { NULL };
-   GstBuffer *bufferL[2] = { NULL }, *bufferR[2] = { NULL };
+   GstElement *pipeline = NULL;
    gchar descr[GSTREAMER_PIPELINE_LENGTH] = "";
    GError *error = NULL;
-   gboolean eosL = false, eosR = false;
    const char *cam_type = (const char *) arg;
-
-#ifdef DEBUG_BUFFERS
-   int sync_comp = 0;
-#endif
+   stereo_frame *this_frame = NULL;
+   pthread_t capture_threads[2] = { 0, 0 };
+   GstSample *last_sample[2] = { NULL, NULL };   /* Last published per eye, for hiccups. */
+   int eyes = single_cam ? 1 : 2;
+   long tolerance = 0;
+   unsigned long hiccup_ns = 0;
+   struct timespec wait_until;
 
    hud_display_settings *this_hds = get_hud_display_settings();
 
-   /* build and start pipeline */
-   build_pipeline_string(descr, sizeof(descr), cam_type, this_hds);
+   this_frame = &video_frames[frame_mailbox_back(&video_mailbox)];
 
-   pipeline = gst_parse_launch(descr, &error);
-   if (error != NULL) {
-      SDL_Log("could not construct pipeline: %s\n", error->message);
-      g_error_free(error);
-      return NULL;
-   }
+   /* Each pass runs one pipeline. A profile switch tears it down and builds the next. */
+   while (!quit) {
+      camera_profile_wait_applied();
 
-   /* get sink */
-   if (single_cam) {
-      sinkL = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
-   } else {
-      sinkL = gst_bin_get_by_name(GST_BIN(pipeline), "sinkL");
-      sinkR = gst_bin_get_by_name(GST_BIN(pipeline), "sinkR");
-   }
-   // From here on out, we'll check sinkR to see if we need to process it.
+      tolerance = this_hds->cam_frame_duration / CAM_PAIR_TOLERANCE_DIV;
+      hiccup_ns = (unsigned long) this_hds->cam_frame_duration * CAM_HICCUP_FRAMES;
 
-   gst_element_set_state(pipeline, GST_STATE_PLAYING);
+      /* build and start pipeline */
+      build_pipeline_string(descr, sizeof(descr), cam_type, this_hds);
 
-   while (!quit) {
-      // Unmap buffers and unref the samples
-      if (bufferL[!buffer_num] != NULL) {
-         gst_buffer_unmap(bufferL[!buffer_num], &mapL[!buffer_num]);
-      }
-      if (sampleL[!buffer_num] != NULL) {
-         gst_sample_unref(sampleL[!buffer_num]);
+      pipeline = gst_parse_launch(descr, &error);
+      if (error != NULL) {
+         SDL_Log("could not construct pipeline: %s\n", error->message);
+         g_error_free(error);
+         quit = 1;
+         break;
       }
-      if (sinkR) {
-         if (bufferR[!buffer_num] != NULL) {
-            gst_buffer_unmap(bufferR[!buffer_num], &mapR[!buffer_num]);
-         }
-         if (sampleR[!buffer_num] != NULL) {
-            gst_sample_unref(sampleR[!buffer_num]);
-         }
+
+      /* get sink */
+      memset(eye_queues, 0, sizeof(eye_queues));
+      if (single_cam) {
+         eye_queues[0].sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+         eye_queues[0].name = "sink";
+      } else {
+         eye_queues[0].sink = gst_bin_get_by_name(GST_BIN(pipeline), "sinkL");
+         eye_queues[0].name = "sinkL";
+         eye_queues[1].sink = gst_bin_get_by_name(GST_BIN(pipeline), "sinkR");
+         eye_queues[1].name = "sinkR";
       }
 
-      /* get the preroll buffer from appsink */
-      g_signal_emit_by_name(sinkL, "pull-sample", &sampleL[!buffer_num], NULL);
-      if (sinkR) {
-         g_signal_emit_by_name(sinkR, "pull-sample", &sampleR[!buffer_num], NULL);
+      if (this_hds->record_composite) {
+         record_set_camera_pipeline(pipeline, eyes);
       }
 
-      if (sampleL[!buffer_num] == NULL) {
-         eosL = gst_app_sink_is_eos(GST_APP_SINK(sinkL));
-         if (eosL) {
-            LOG_ERROR("sinkL returned NULL. It is EOS.");
+      gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+      for (int i = 0; i < eyes; i++) {
+         if (eye_queues[i].sink == NULL) {
+            LOG_ERROR("Unable to find %s in the camera pipeline.", eye_queues[i].name);
             quit = 1;
-            return NULL;
-         } else {
-            LOG_ERROR("sinkL returned NULL. It is NOT EOS!?!?");
             continue;
          }
+         if (pthread_create(&capture_threads[i], NULL, eye_capture_thread, &eye_queues[i]) != 0) {
+            LOG_ERROR("Error creating %s capture thread.", eye_queues[i].name);
+            quit = 1;
+         }
       }
 
-      if (sinkR) {
-         if (sampleR[!buffer_num] == NULL) {
-            eosR = gst_app_sink_is_eos(GST_APP_SINK(sinkR));
-            if (eosR) {
-               LOG_ERROR("sinkR returned NULL. It is EOS.");
-               quit = 1;
-               return NULL;
-            } else {
-               LOG_ERROR("sinkR returned NULL. It is NOT EOS!?!?");
-               continue;
-            }
+      pthread_mutex_lock(&eye_mutex);
+      while (!quit) {
+         eye_queue *ql = &eye_queues[0];
+         eye_queue *qr = &eye_queues[1];
+         GstSample *left = NULL, *right = NULL;
+         unsigned long sensor_ns = 0, pull_ns = 0;
+
+         if (ql->eos || (!single_cam && qr->eos)) {
+            quit = 1;
+            break;
          }
-      }
 
-#ifdef DISPLAY_TIMING
-      clock_gettime(CLOCK_REALTIME, &ts_cap[!buffer_num]);
-#endif
-
-      /* if we have a buffer now, convert it to a pixbuf */
-      /* We only need to sync left and right if they're from different cameras. */
-      if (sinkR) {
-         if (sampleL[!buffer_num] && sampleR[!buffer_num]) {
-            /* get the pixbuf */
-            bufferL[!buffer_num] = gst_sample_get_buffer(sampleL[!buffer_num]);
-            bufferR[!buffer_num] = gst_sample_get_buffer(sampleR[!buffer_num]);
-
-            /* handle sync */
-            while (((long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts) >
-                  this_hds->cam_frame_duration) {
-               gst_sample_unref(sampleR[!buffer_num]);
-               g_signal_emit_by_name(sinkR, "pull-sample", &sampleR[!buffer_num], NULL);
-               bufferR[!buffer_num] = gst_sample_get_buffer(sampleR[!buffer_num]);
+         if (camera_profile_pending()) {
+            break;
+         }
+
+         if (single_cam) {
+            if (ql->count > 0) {
+               left = eye_queue_pop(ql, &sensor_ns, &pull_ns);
+            }
+         } else if ((ql->count > 0) && (qr->count > 0)) {
+            /* Both eyes have frames. Move the side that's behind forward while its next frame
+             * is a closer match, then either pair the heads or drop the stale one. */
+            eye_queue *older = (eye_queue_pts(ql, 0) <= eye_queue_pts(qr, 0)) ? ql : qr;
+            eye_queue *newer = (older == ql) ? qr : ql;
+            GstClockTime target = eye_queue_pts(newer, 0);
+
+            while ((older->count > 1) &&
+                   (pts_diff(eye_queue_pts(older, 1), target) <= pts_diff(eye_queue_pts(older, 0), target))) {
+               eye_queue_drop(older);
+            }
+
+            long skew = (long) eye_queue_pts(ql, 0) - (long) eye_queue_pts(qr, 0);
+            if (labs(skew) <= tolerance) {
+               left = eye_queue_pop(ql, &sensor_ns, &pull_ns);
+               right = eye_queue_pop(qr, &sensor_ns, &pull_ns);
+
+               atomic_store(&stereo_skew_ns, skew);
+               if (labs(skew) > atomic_load(&stereo_skew_max_ns)) {
+                  atomic_store(&stereo_skew_max_ns, labs(skew));
+               }
+               atomic_fetch_add(&stereo_pairs, 1);
 #ifdef DEBUG_BUFFERS
-               LOG_WARNING("Catching up R buffer.");
-               LOG_WARNING("bufferL PTS: %lu, bufferR PTS: %lu, %10ld: %d, sync_comp: %d",
-                     bufferL[!buffer_num]->pts, bufferR[!buffer_num]->pts,
-                     (long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts,
-                     (this_hds->cam_frame_duration) >
-                     abs((long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts),
-                     sync_comp);
-               sync_comp++;
+               LOG_INFO("Paired L/R, skew: %ld ns", skew);
 #endif
-            }
-            while (((long)bufferR[!buffer_num]->pts - (long)bufferL[!buffer_num]->pts) >
-                  this_hds->cam_frame_duration) {
-               gst_sample_unref(sampleL[!buffer_num]);
-               g_signal_emit_by_name(sinkL, "pull-sample", &sampleL[!buffer_num], NULL);
-               bufferL[!buffer_num] = gst_sample_get_buffer(sampleL[!buffer_num]);
+            } else {
+               /* Nothing newer on the other side can match the older head. */
+               eye_queue_drop(older);
 #ifdef DEBUG_BUFFERS
-               LOG_WARNING("Catching up L buffer.");
-               LOG_WARNING("bufferL PTS: %lu, bufferR PTS: %lu, %10ld: %d, sync_comp: %d",
-                     bufferL[!buffer_num]->pts, bufferR[!buffer_num]->pts,
-                     (long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts,
-                     (this_hds->cam_frame_duration) >
-                     abs((long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts),
-                     sync_comp);
-               sync_comp++;
+               LOG_WARNING("Dropping unmatched %s frame, skew: %ld ns", older->name, skew);
 #endif
+               continue;
+            }
+         } else if ((ql->count > 0) || (qr->count > 0)) {
+            /* One eye is waiting on the other. If the other camera has hiccuped for too long,
+             * keep going at sensor rate by reusing its last frame. */
+            eye_queue *ready = (ql->count > 0) ? ql : qr;
+            int other = (ready == ql) ? 1 : 0;
+
+            if ((last_sample[other] != NULL) &&
+                (latency_now_ns() - ready->arrival_ns[ready->head] > hiccup_ns)) {
+               if (ready == ql) {
+                  left = eye_queue_pop(ql, &sensor_ns, &pull_ns);
+                  right = gst_sample_ref(last_sample[1]);
+               } else {
+                  left = gst_sample_ref(last_sample[0]);
+                  right = eye_queue_pop(qr, &sensor_ns, &pull_ns);
+               }
+               atomic_fetch_add(&stereo_hiccups, 1);
             }
+         }
 
-#ifdef DEBUG_BUFFERS
-            LOG_INFO("bufferL PTS: %lu, bufferR PTS: %lu, %10ld: %d, sync_comp: %d",
-                  bufferL[!buffer_num]->pts, bufferR[!buffer_num]->pts,
-                  (long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts,
-                  (this_hds->cam_frame_duration) >
-                  abs((long)bufferL[!buffer_num]->pts - (long)bufferR[!buffer_num]->pts), sync_comp);
-#endif
+         if (left == NULL) {
+            clock_gettime(CLOCK_REALTIME, &wait_until);
+            wait_until.tv_nsec += this_hds->cam_frame_duration;
+            if (wait_until.tv_nsec >= 1000000000L) {
+               wait_until.tv_sec++;
+               wait_until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&eye_cond, &eye_mutex, &wait_until);
+            continue;
+         }
 
-            gst_buffer_map(bufferL[!buffer_num], &mapL[!buffer_num], GST_MAP_READ);
-            gst_buffer_map(bufferR[!buffer_num], &mapR[!buffer_num], GST_MAP_READ);
+         /* Publish outside the lock so the capture threads never wait on mapping. */
+         pthread_mutex_unlock(&eye_mutex);
 
-            pthread_mutex_lock(&v_mutex);
-            video_posted = 1;
-            buffer_num = !buffer_num;
-            pthread_mutex_unlock(&v_mutex);
-         } else {
-            g_print("could not make snapshot\n");
+         if (last_sample[0] != NULL) {
+            gst_sample_unref(last_sample[0]);
+         }
+         last_sample[0] = gst_sample_ref(left);
+         if (right != NULL) {
+            if (last_sample[1] != NULL) {
+               gst_sample_unref(last_sample[1]);
+            }
+            last_sample[1] = gst_sample_ref(right);
          }
-      } else {
-         if (sampleL[!buffer_num]) {
-            /* get the pixbuf */
-            bufferL[!buffer_num] = gst_sample_get_buffer(sampleL[!buffer_num]);
 
-            gst_buffer_map(bufferL[!buffer_num], &mapL[!buffer_num], GST_MAP_READ);
+         this_frame = publish_stereo_frame(this_frame, left, right, sensor_ns, pull_ns);
 
-            pthread_mutex_lock(&v_mutex);
-            video_posted = 1;
-            buffer_num = !buffer_num;
-            pthread_mutex_unlock(&v_mutex);
-         } else {
-            g_print("could not make snapshot\n");
+         pthread_mutex_lock(&eye_mutex);
+      }
+      pthread_mutex_unlock(&eye_mutex);
+
+      record_set_camera_pipeline(NULL, 0);
+
+      pthread_mutex_lock(&eye_mutex);
+      for (int i = 0; i < eyes; i++) {
+         eye_queues[i].stopping = 1;
+      }
+      pthread_mutex_unlock(&eye_mutex);
+
+      /* Stopping the pipeline unblocks any pull-sample still waiting in the capture threads. */
+      gst_element_set_state(pipeline, GST_STATE_NULL);
+      for (int i = 0; i < eyes; i++) {
+         if (capture_threads[i] != 0) {
+            pthread_join(capture_threads[i], NULL);
          }
       }
-   }
 
-   /* Video */
-   gst_element_set_state(pipeline, GST_STATE_NULL);
-   gst_object_unref(pipeline);
+      pthread_mutex_lock(&eye_mutex);
+      for (int i = 0; i < eyes; i++) {
+         eye_queue_flush(&eye_queues[i]);
+         if (last_sample[i] != NULL) {
+            gst_sample_unref(last_sample[i]);
+            last_sample[i] = NULL;
+         }
+         if (eye_queues[i].sink != NULL) {
+            gst_object_unref(eye_queues[i].sink);
+         }
+      }
+      pthread_mutex_unlock(&eye_mutex);
+
+      /* Video. The mailbox slots are released by the main thread once rendering stops. */
+      gst_object_unref(pipeline);
+      pipeline = NULL;
+      memset(capture_threads, 0, sizeof(capture_threads));
+   }
 
    return NULL;
 }
@@ -1000,7 +1605,7 @@ void *video_processing_thread(void *arg)
 /*
  * Retrieves a font from the font cache or loads it if not present.
  */
-TTF_Font *get_local_font(char *font_name, int font_size)
+TTF_Font *get_local_font(const char *font_name, int font_size)
 {
    local_font *this_font = NULL;
 
@@ -1041,150 +1646,390 @@ TTF_Font *get_local_font(char *font_name, int font_size)
       this_font = this_font->next;
    }
 
-   this_font->ttf_font = TTF_OpenFont(font_name, font_size);
-   if (!this_font->ttf_font) {
-      SDL_Log("Error loading font: %s\n", TTF_GetError());
-      free(this_font);
-      this_font = NULL;
-      return NULL;
+   this_font->ttf_font = TTF_OpenFont(font_name, font_size);
+   if (!this_font->ttf_font) {
+      SDL_Log("Error loading font: %s\n", TTF_GetError());
+      free(this_font);
+      this_font = NULL;
+      return NULL;
+   }
+
+   strncpy(this_font->font, font_name, MAX_FILENAME_LENGTH * 2 - 1);
+   font_list->font[MAX_FILENAME_LENGTH * 2 - 1] = '\0';
+   this_font->font_size = font_size;
+   this_font->next = NULL;
+
+   return this_font->ttf_font;
+}
+
+/*
+ * Copies the latest camera frame from the left camera into the provided buffer.
+ */
+void *grab_latest_camera_frame(void *temp_buffer) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+
+   /* Use the frame the render loop currently holds. It can't change under us. */
+   int slot = frame_mailbox_current(&video_mailbox);
+
+   if ((slot >= 0) && video_frames[slot].mappedL) {
+      stereo_frame *this_frame = &video_frames[slot];
+
+      /* Allocate temporary buffer for the screenshot */
+      temp_buffer = malloc(this_hds->cam_frame_width * this_hds->cam_frame_height * 4);
+      if (temp_buffer != NULL) {
+         /* Copy camera data */
+#ifdef USE_NVMM_ZERO_COPY
+         if (nvmm_copy_to_host(&this_frame->mapL, temp_buffer, this_hds->cam_frame_width,
+                               this_hds->cam_frame_height) != SUCCESS) {
+            free(temp_buffer);
+            temp_buffer = NULL;
+         }
+#else
+         memcpy(temp_buffer, this_frame->mapL.data,
+               this_hds->cam_frame_width * this_hds->cam_frame_height * 4);
+#endif
+      }
+   }
+
+   return temp_buffer;
+}
+
+/* HUD eye layer state, see hud_eye_layer_begin(). */
+typedef enum {
+   EYE_LAYER_OFF,          /* Drawing straight to the window. */
+   EYE_LAYER_DRAWING,      /* The render target is the layer. */
+   EYE_LAYER_PAUSED        /* In a layer pass, but an eye specific draw took the window back. */
+} eye_layer_state_t;
+
+static SDL_Texture *eye_layer = NULL;
+static int eye_layer_width = 0;
+static int eye_layer_height = 0;
+static int eye_layer_margin = 0;       /* Extra columns each side so the offset never clips. */
+static int eye_layer_used = 0;         /* Anything drawn since the layer was last cleared. */
+static eye_layer_state_t eye_layer_state = EYE_LAYER_OFF;
+
+/* Where HUD drawing returns to after a layer. The window, or the recording overlay. */
+static SDL_Texture *hud_base_target = NULL;
+
+/* Blending into a cleared target leaves premultiplied color. Layers drawn that
+ * way are composited with this. */
+static SDL_BlendMode premultiplied_blend_mode(void) {
+   return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                     SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE,
+                                     SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+}
+
+/* (Re)create the layer to match the eye size and current stereo offset. */
+static int eye_layer_prepare(void) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   int margin = abs(this_hds->stereo_offset);
+   int width = this_hds->eye_output_width + 2 * margin;
+   int height = this_hds->eye_output_height;
+
+   if ((eye_layer != NULL) && (eye_layer_width == width) && (eye_layer_height == height)) {
+      eye_layer_margin = margin;
+      return SUCCESS;
+   }
+
+   if (eye_layer != NULL) {
+      SDL_DestroyTexture(eye_layer);
+   }
+
+   eye_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                 width, height);
+   if (eye_layer == NULL) {
+      LOG_ERROR("Unable to create HUD eye layer: %s", SDL_GetError());
+      return FAILURE;
+   }
+
+   if (SDL_SetTextureBlendMode(eye_layer, premultiplied_blend_mode()) != 0) {
+      LOG_ERROR("Renderer can't composite the HUD eye layer: %s", SDL_GetError());
+      SDL_DestroyTexture(eye_layer);
+      eye_layer = NULL;
+      return FAILURE;
+   }
+
+   eye_layer_width = width;
+   eye_layer_height = height;
+   eye_layer_margin = margin;
+
+   return SUCCESS;
+}
+
+static void eye_layer_clear(void) {
+   Uint8 r = 0, g = 0, b = 0, a = 0;
+
+   texture_atlas_flush();
+   SDL_SetRenderTarget(renderer, eye_layer);
+
+   SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+   SDL_RenderClear(renderer);
+   SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+   eye_layer_used = 0;
+   eye_layer_state = EYE_LAYER_DRAWING;
+}
+
+/* Composite the layer into both eyes with the stereo offset and return to the window. */
+static void eye_layer_composite(void) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   SDL_Rect dst_l = { -this_hds->stereo_offset - eye_layer_margin, 0,
+                      eye_layer_width, eye_layer_height };
+   SDL_Rect dst_r = { this_hds->stereo_offset - eye_layer_margin, 0,
+                      eye_layer_width, eye_layer_height };
+
+   texture_atlas_flush();
+   SDL_SetRenderTarget(renderer, hud_base_target);
+
+   if (eye_layer_used) {
+      eye_layer_state = EYE_LAYER_OFF;
+      renderStereo(eye_layer, NULL, &dst_l, &dst_r, 0);
+   }
+   eye_layer_state = EYE_LAYER_PAUSED;
+}
+
+/* Draw into the layer if dest/dest2 differ only by the stereo offset. */
+static int eye_layer_draw(SDL_Texture *tex, SDL_Rect *src, SDL_Rect *dest, SDL_Rect *dest2,
+                          double angle) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   SDL_Rect *right = (dest2 != NULL) ? dest2 : dest;
+   SDL_Rect layer_src, layer_dst;
+
+   if ((right->x - dest->x != 2 * this_hds->stereo_offset) || (right->y != dest->y) ||
+       (right->w != dest->w) || (right->h != dest->h)) {
+      return FAILURE;
+   }
+
+   if (eye_layer_state == EYE_LAYER_PAUSED) {
+      eye_layer_clear();
+   }
+
+   if (src == NULL) {
+      layer_src.x = layer_src.y = 0;
+      SDL_QueryTexture(tex, NULL, NULL, &layer_src.w, &layer_src.h);
+   } else {
+      memcpy(&layer_src, src, sizeof(SDL_Rect));
+   }
+
+   memcpy(&layer_dst, dest, sizeof(SDL_Rect));
+   layer_dst.x += this_hds->stereo_offset + eye_layer_margin;
+
+   /* The target clips for us, no per eye math needed, and rotation is done once. */
+   if (!angle && (texture_atlas_draw(tex, &layer_src, &layer_dst) == SUCCESS)) {
+      /* Queued */
+   } else if (!angle) {
+      texture_atlas_flush();
+      SDL_RenderCopy(renderer, tex, &layer_src, &layer_dst);
+   } else {
+      texture_atlas_flush();
+      SDL_RenderCopyEx(renderer, tex, &layer_src, &layer_dst, angle, NULL, SDL_FLIP_NONE);
+   }
+   eye_layer_used = 1;
+
+   return SUCCESS;
+}
+
+/*
+ * Starts drawing stereo consistent HUD elements into the shared eye layer.
+ */
+int hud_eye_layer_begin(void) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+
+   if (!this_hds->hud_eye_layer) {
+      return FAILURE;
+   }
+
+   if (eye_layer_prepare() != SUCCESS) {
+      LOG_WARNING("Disabling the HUD eye layer, drawing each eye directly.");
+      this_hds->hud_eye_layer = 0;
+      return FAILURE;
    }
 
-   strncpy(this_font->font, font_name, MAX_FILENAME_LENGTH * 2 - 1);
-   font_list->font[MAX_FILENAME_LENGTH * 2 - 1] = '\0';
-   this_font->font_size = font_size;
-   this_font->next = NULL;
+   eye_layer_clear();
 
-   return this_font->ttf_font;
+   return SUCCESS;
 }
 
-/**
- * Retrieves a texture from the texture cache or loads it if not present.
+/*
+ * Returns the window to direct drawing, compositing anything pending in the layer.
  */
-SDL_Texture *get_cached_texture(const char *filename) {
-   texture_cache *this_texture = NULL;
-   struct stat file_stat;
-   SDL_Renderer *renderer = get_sdl_renderer();
-
-   if (filename == NULL || filename[0] == '\0') {
-      LOG_WARNING("Invalid texture filename: NULL or empty");
-      return NULL;
+void hud_eye_layer_pause(void) {
+   if (eye_layer_state == EYE_LAYER_DRAWING) {
+      eye_layer_composite();
    }
+}
 
-   if (renderer == NULL) {
-      LOG_ERROR("No SDL renderer available for texture loading");
-      return NULL;
-   }
+/*
+ * Finishes the layer pass.
+ */
+void hud_eye_layer_end(void) {
+   hud_eye_layer_pause();
+   eye_layer_state = EYE_LAYER_OFF;
+}
+
+static SDL_Texture *hud_layers[HUD_LAYER_COUNT] = { NULL };
+static int hud_layer_width = 0;
+static int hud_layer_height = 0;
+static eye_layer_state_t hud_layer_saved_state = EYE_LAYER_OFF;
+
+/* (Re)create the transition layers to match the output size. */
+static int hud_layers_prepare(void) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   int width = this_hds->eye_output_width * 2;
+   int height = this_hds->eye_output_height;
 
-   /* Get file modification time for cache validation */
-   if (stat(filename, &file_stat) != 0) {
-      LOG_WARNING("Cannot stat texture file: %s", filename);
-      /* Continue anyway - file might be accessible for reading */
-      file_stat.st_mtime = 0;
+   if ((hud_layers[0] != NULL) && (hud_layer_width == width) && (hud_layer_height == height)) {
+      return SUCCESS;
    }
 
-   /* Initialize texture list if this is the first texture request */
-   if (texture_list == NULL) {
-      texture_list = malloc(sizeof(texture_cache));
-      if (texture_list == NULL) {
-         LOG_ERROR("Unable to malloc initial texture cache entry");
-         return NULL;
+   for (int i = 0; i < HUD_LAYER_COUNT; i++) {
+      if (hud_layers[i] != NULL) {
+         SDL_DestroyTexture(hud_layers[i]);
       }
-
-      texture_list->texture = IMG_LoadTexture(renderer, filename);
-      if (!texture_list->texture) {
-         LOG_ERROR("Error loading texture: %s - %s", filename, SDL_GetError());
-         free(texture_list);
-         texture_list = NULL;
-         return NULL;
+      hud_layers[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                        SDL_TEXTUREACCESS_TARGET, width, height);
+      if ((hud_layers[i] == NULL) ||
+          (SDL_SetTextureBlendMode(hud_layers[i], premultiplied_blend_mode()) != 0)) {
+         LOG_WARNING("Unable to create HUD transition layers: %s", SDL_GetError());
+         for (int j = 0; j <= i; j++) {
+            if (hud_layers[j] != NULL) {
+               SDL_DestroyTexture(hud_layers[j]);
+               hud_layers[j] = NULL;
+            }
+         }
+         return FAILURE;
       }
+   }
+
+   hud_layer_width = width;
+   hud_layer_height = height;
 
-      strncpy(texture_list->filename, filename, MAX_FILENAME_LENGTH * 2 - 1);
-      texture_list->filename[MAX_FILENAME_LENGTH * 2 - 1] = '\0';
-      texture_list->file_mtime = file_stat.st_mtime;
-      texture_list->next = NULL;
+   return SUCCESS;
+}
+
+/*
+ * Redirects HUD drawing into a transition layer.
+ */
+int hud_layer_begin(hud_layer_t layer) {
+   Uint8 r = 0, g = 0, b = 0, a = 0;
 
-      return texture_list->texture;
+   if ((layer >= HUD_LAYER_COUNT) || (hud_layers_prepare() != SUCCESS)) {
+      return FAILURE;
    }
 
-   /* Search for existing texture in cache */
-   this_texture = texture_list;
-   while (this_texture != NULL) {
-      if (strcmp(filename, this_texture->filename) == 0) {
-         /* Found in cache - check if file has been modified */
-         if (file_stat.st_mtime > this_texture->file_mtime) {
-            LOG_INFO("Texture file modified, reloading: %s", filename);
+   /* Elements go straight into the layer, not through the eye layer. */
+   hud_eye_layer_pause();
+   hud_layer_saved_state = eye_layer_state;
+   eye_layer_state = EYE_LAYER_OFF;
 
-            /* Destroy old texture and reload */
-            SDL_DestroyTexture(this_texture->texture);
-            this_texture->texture = IMG_LoadTexture(renderer, filename);
+   texture_atlas_flush();
+   SDL_SetRenderTarget(renderer, hud_layers[layer]);
 
-            if (!this_texture->texture) {
-               LOG_ERROR("Error reloading modified texture: %s - %s", filename, SDL_GetError());
-               return NULL;
-            }
+   SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+   SDL_RenderClear(renderer);
+   SDL_SetRenderDrawColor(renderer, r, g, b, a);
 
-            this_texture->file_mtime = file_stat.st_mtime;
-         }
+   return SUCCESS;
+}
 
-         return this_texture->texture;
-      }
+/*
+ * Returns drawing to the window after hud_layer_begin().
+ */
+void hud_layer_end(void) {
+   texture_atlas_flush();
+   SDL_SetRenderTarget(renderer, hud_base_target);
+   eye_layer_state = hud_layer_saved_state;
+}
 
-      if (this_texture->next == NULL) {
-         break;
-      } else {
-         this_texture = this_texture->next;
-      }
-   }
+/*
+ * Draws a captured transition layer to both eyes.
+ */
+void hud_layer_draw(hud_layer_t layer, float alpha, int offset_x, float scale) {
+   hud_display_settings *this_hds = get_hud_display_settings();
+   int eye_w = this_hds->eye_output_width;
+   int eye_h = this_hds->eye_output_height;
+   Uint8 mod = 0;
 
-   /* Texture not found in cache, create new cache entry */
-   this_texture->next = malloc(sizeof(texture_cache));
-   if (this_texture->next == NULL) {
-      LOG_ERROR("Unable to malloc texture cache entry");
-      return NULL;
+   if ((layer >= HUD_LAYER_COUNT) || (hud_layers[layer] == NULL) || (alpha <= 0.0f)) {
+      return;
    }
-
-   this_texture = this_texture->next;
-   this_texture->texture = IMG_LoadTexture(renderer, filename);
-   if (!this_texture->texture) {
-      LOG_ERROR("Error loading texture: %s - %s", filename, SDL_GetError());
-      free(this_texture);
-      /* Fix the linked list - find previous node */
-      texture_cache *prev = texture_list;
-      while (prev && prev->next != this_texture) {
-         prev = prev->next;
-      }
-      if (prev) prev->next = NULL;
-      return NULL;
+   if (alpha > 1.0f) {
+      alpha = 1.0f;
    }
 
-   strncpy(this_texture->filename, filename, MAX_FILENAME_LENGTH * 2 - 1);
-   this_texture->filename[MAX_FILENAME_LENGTH * 2 - 1] = '\0';
-   this_texture->file_mtime = file_stat.st_mtime;
-   this_texture->next = NULL;
+   hud_eye_layer_pause();
+   texture_atlas_flush();
+
+   /* Premultiplied, so color has to fade with alpha. */
+   mod = (Uint8) (alpha * 255);
+   SDL_SetTextureColorMod(hud_layers[layer], mod, mod, mod);
+   SDL_SetTextureAlphaMod(hud_layers[layer], mod);
+
+   for (int eye = 0; eye < 2; eye++) {
+      SDL_Rect clip = { eye * eye_w, 0, eye_w, eye_h };
+      SDL_Rect src = { eye * eye_w, 0, eye_w, eye_h };
+      SDL_Rect dst;
 
-   return this_texture->texture;
+      dst.w = (int) round(eye_w * scale);
+      dst.h = (int) round(eye_h * scale);
+      dst.x = eye * eye_w + offset_x + (eye_w - dst.w) / 2;
+      dst.y = (eye_h - dst.h) / 2;
+
+      SDL_RenderSetClipRect(renderer, &clip);
+      SDL_RenderCopy(renderer, hud_layers[layer], &src, &dst);
+   }
+   SDL_RenderSetClipRect(renderer, NULL);
 }
 
-/*
- * Copies the latest camera frame from the left camera into the provided buffer.
- */
-void *grab_latest_camera_frame(void *temp_buffer) {
-   hud_display_settings *this_hds = get_hud_display_settings();
+/* Redirect the HUD into a window sized, transparent overlay. Composite
+ * recordings read back just this, the encoder puts it over the cameras. */
+static int hud_overlay_begin(void) {
+   Uint8 r = 0, g = 0, b = 0, a = 0;
+   int width = 0, height = 0;
 
-   /* Use camera frame buffer if available */
-   pthread_mutex_lock(&v_mutex); // Lock the video mutex to safely access mapL
-   if (video_posted && mapL[buffer_num].data != NULL) {
-      /* Allocate temporary buffer for the screenshot */
-      temp_buffer = malloc(this_hds->cam_input_width * this_hds->cam_input_height * 4);
-      if (temp_buffer != NULL) {
-         /* Copy camera data */
-         memcpy(temp_buffer, mapL[buffer_num].data,
-               this_hds->cam_input_width * this_hds->cam_input_height * 4);
+   hud_overlay_drawn = 0;
+   SDL_GetRendererOutputSize(renderer, &width, &height);
+
+   if ((hud_overlay == NULL) || (hud_overlay_width != width) || (hud_overlay_height != height)) {
+      if (hud_overlay != NULL) {
+         SDL_DestroyTexture(hud_overlay);
+      }
+      hud_overlay = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888,
+                                      SDL_TEXTUREACCESS_TARGET, width, height);
+      if ((hud_overlay == NULL) ||
+          (SDL_SetTextureBlendMode(hud_overlay, premultiplied_blend_mode()) != 0)) {
+         LOG_WARNING("Unable to create the HUD recording overlay: %s", SDL_GetError());
+         if (hud_overlay != NULL) {
+            SDL_DestroyTexture(hud_overlay);
+            hud_overlay = NULL;
+         }
+         return FAILURE;
       }
+      hud_overlay_width = width;
+      hud_overlay_height = height;
    }
-   pthread_mutex_unlock(&v_mutex);
 
-   return temp_buffer;
+   texture_atlas_flush();
+   hud_base_target = hud_overlay;
+   SDL_SetRenderTarget(renderer, hud_overlay);
+
+   SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+   SDL_RenderClear(renderer);
+   SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+   return SUCCESS;
+}
+
+/* Put the overlay on the window and go back to drawing there. */
+static void hud_overlay_end(void) {
+   texture_atlas_flush();
+   hud_base_target = NULL;
+   SDL_SetRenderTarget(renderer, NULL);
+   SDL_RenderCopy(renderer, hud_overlay, NULL, NULL);
+   hud_overlay_drawn = 1;
 }
 
 /*
@@ -1206,6 +2051,15 @@ void renderStereo(SDL_Texture *tex, SDL_Rect *src, SDL_Rect *dest,
       return;
    }
 
+   if (eye_layer_state != EYE_LAYER_OFF) {
+      if (eye_layer_draw(tex, src, dest, dest2, angle) == SUCCESS) {
+         return;
+      }
+
+      /* Eye specific placement (e.g. fixed elements), keep order by drawing it directly. */
+      hud_eye_layer_pause();
+   }
+
    if (src == NULL) {
       SDL_QueryTexture(tex, NULL, NULL, &src_rect_l.w, &src_rect_l.h);
       src_rect_l.x = src_rect_l.y = 0;
@@ -1324,21 +2178,30 @@ void renderStereo(SDL_Texture *tex, SDL_Rect *src, SDL_Rect *dest,
       src_rect_r.h = src_rect_r.h - (scale * overage);
    }
 
-   /* Render each eye independently */
+   /* Render each eye independently. Unrotated atlas textures are queued for a
+    * batched submit; anything else flushes the batch first to keep draw order. */
    /* Left eye */
    if (dest_rect_l.w > 0 && dest_rect_l.h > 0 && src_rect_l.w > 0 && src_rect_l.h > 0) {
-      if (!angle) {
+      if (!angle && (texture_atlas_draw(tex, &src_rect_l, &dest_rect_l) == SUCCESS)) {
+         /* Queued */
+      } else if (!angle) {
+         texture_atlas_flush();
          SDL_RenderCopy(renderer, tex, &src_rect_l, &dest_rect_l);
       } else {
+         texture_atlas_flush();
          SDL_RenderCopyEx(renderer, tex, &src_rect_l, &dest_rect_l, angle, NULL, SDL_FLIP_NONE);
       }
    }
 
    /* Right eye */
    if (dest_rect_r.w > 0 && dest_rect_r.h > 0 && src_rect_r.w > 0 && src_rect_r.h > 0) {
-      if (!angle) {
+      if (!angle && (texture_atlas_draw(tex, &src_rect_r, &dest_rect_r) == SUCCESS)) {
+         /* Queued */
+      } else if (!angle) {
+         texture_atlas_flush();
          SDL_RenderCopy(renderer, tex, &src_rect_r, &dest_rect_r);
       } else {
+         texture_atlas_flush();
          SDL_RenderCopyEx(renderer, tex, &src_rect_r, &dest_rect_r, angle, NULL, SDL_FLIP_NONE);
       }
    }
@@ -1406,6 +2269,14 @@ void display_help(int argc, char *argv[]) {
    printf("  -c, --camera TYPE      Specify the camera type, csi or usb.\n");
    printf("  -n, --camcount [1/2]   Specify the number of cameras for display, 1 or 2.\n");
    printf("  -b, --black-background  Disable cameras and use black background (for UI design/transparency).\n");
+   printf("  -C, --config FILE       Use FILE instead of config.json.\n");
+   printf("\n");
+   printf("  -T, --trace FILE        Record every inbound message to FILE.\n");
+   printf("  -F, --trace-frames FILE Also record camera frames to FILE, or replay them from it.\n");
+   printf("  -P, --replay FILE       Replay a trace instead of live input, then exit.\n");
+   printf("  -x, --replay-speed X    Replay at X times the recorded rate. 0 is as fast as possible.\n");
+   printf("  -o, --replay-report FILE Write the replay frame time report to FILE instead of stdout.\n");
+   printf("  -H, --headless          Render to a hidden window.\n");
    printf("\n");
 }
 
@@ -1435,8 +2306,6 @@ int main(int argc, char **argv)
    DestinationType initial_recording_state = DISABLED;
 
    /* Threads */
-   pthread_t thread_handles[NUM_AUDIO_THREADS];
-   int current_thread = 0;
    pthread_t video_proc_thread = 0;
 
    /* Serial Port */
@@ -1449,6 +2318,13 @@ int main(int argc, char **argv)
 
    /* Video */
    SDL_Texture *textureL = NULL, *textureR = NULL;
+   int video_slot = -1, video_fresh = 0;
+   int overlay = 0;              /* The HUD went to the recording overlay this frame. */
+   unsigned int detect_frame_count = 0;
+   unsigned long frame_sensor_ns = 0;        /* Capture time of a newly shown frame, else 0. */
+   unsigned long predicted_vsync_ns = 0;     /* When the frame being built should be on screen. */
+   frame_pacer_stats pacer_stats;
+   unsigned long stage_ns = 0;
 
 #ifdef DISPLAY_TIMING
    unsigned long last_ts_cap = 0, present_time = 0, ts_total = 0;
@@ -1463,6 +2339,11 @@ int main(int argc, char **argv)
    unsigned int totalFrames = 0;
    unsigned int currTime = SDL_GetTicks();
    unsigned int last_file_check = 0;         /* when was the recording last checked */
+   unsigned int last_latency_report = 0;     /* when latency stats were last published */
+   unsigned int last_profile_report = 0;     /* when the render profiler window last closed */
+   unsigned int last_armor_check = 0;        /* when armor components were last checked for timeouts */
+   char profile_report[RENDER_PROFILE_REPORT_LENGTH];   /* Profiler window, when not published. */
+   unsigned int last_present_time = 0;       /* when a frame was last presented */
 
    Uint64 thisPTime, lastPTime;
    double elapsed = 0.0;
@@ -1475,7 +2356,19 @@ int main(int argc, char **argv)
    FrameRateTracker tracker;
    initializeFrameRateTracker(&tracker);
 
-   const char config_file[] = "config.json";
+   const char *config_file = "config.json";
+
+   /* Input traces */
+   const char *trace_filename = NULL;
+   const char *trace_frames_filename = NULL;
+   const char *replay_filename = NULL;
+   const char *replay_report_filename = NULL;
+   double replay_speed = 1.0;
+   int headless = 0;
+   int replaying = 0;            /* Input comes from a trace, not the live links. */
+   int replay_result = 0;
+   const unsigned char *replay_left = NULL, *replay_right = NULL;
+   unsigned long frame_start_ns = 0;
 
    int intro_finished = 0;
 
@@ -1487,30 +2380,45 @@ int main(int argc, char **argv)
 
    /*
     * Process Command Line
+    * b  - black background, no cameras
+    * C: - config file
     * c: - camera type, usb/csi
+    * F: - camera frames file for trace record/replay
     * f  - fullscreen
+    * H  - headless, hidden window
     * h  - help text
     * l  - log filename
     * n: - number of cameras
+    * o: - replay report file
+    * P: - replay trace
     * p: - path for recordings
     * r  - record on startup
     * s  - stream on startup
+    * T: - record trace
     * t  - record and stream on startup
     * u: - USB/serial with port
+    * x: - replay speed
     */
    static struct option long_options[] = {
       {"black-background", no_argument, NULL, 'b'},
+      {"config", required_argument, NULL, 'C'},
       {"camera", required_argument, NULL, 'c'},
       {"device", required_argument, NULL, 'd'},
+      {"trace-frames", required_argument, NULL, 'F'},
       {"fullscreen", no_argument, NULL, 'f'},
+      {"headless", no_argument, NULL, 'H'},
       {"help", no_argument, NULL, 'h'},
       {"logfile", required_argument, NULL, 'l'},
       {"camcount", required_argument, NULL, 'n'},
+      {"replay-report", required_argument, NULL, 'o'},
+      {"replay", required_argument, NULL, 'P'},
       {"record_path", required_argument, NULL, 'p'},
       {"record", no_argument, NULL, 'r'},
       {"stream", no_argument, NULL, 's'},
+      {"trace", required_argument, NULL, 'T'},
       {"record_stream", no_argument, NULL, 't'},
       {"usb", no_argument, NULL, 'u'},
+      {"replay-speed", required_argument, NULL, 'x'},
       {0, 0, 0, 0}
    };
    int option_index = 0;
@@ -1535,7 +2443,7 @@ int main(int argc, char **argv)
    }
 
    while (1) {
-      opt = getopt_long(argc, argv, "bc:d:fhl:n:p:rstu", long_options, &option_index);
+      opt = getopt_long(argc, argv, "bC:c:d:F:fHhl:n:o:P:p:rsT:tux:", long_options, &option_index);
 
       if (opt == -1) {
          break;
@@ -1546,6 +2454,9 @@ int main(int argc, char **argv)
          no_camera_mode = 1;
          printf("No camera mode enabled - cameras disabled\n");
          break;
+      case 'C':
+         config_file = optarg;
+         break;
       case 'c':
          if ((strncmp(optarg, "usb", 3) != 0) && (strncmp(optarg, "csi", 3) != 0)) {
             fprintf(stderr, "Camera type must be \"usb\" or \"csi\".\n");
@@ -1554,9 +2465,15 @@ int main(int argc, char **argv)
 
          cam_type = optarg;
          break;
+      case 'F':
+         trace_frames_filename = optarg;
+         break;
       case 'f':
          fullscreen = 1;
 
+         break;
+      case 'H':
+         headless = 1;
          break;
       case 'h':
          display_help(argc, argv);
@@ -1607,6 +2524,12 @@ int main(int argc, char **argv)
 
          free(optarg_copy);
          break;
+      case 'o':
+         replay_report_filename = optarg;
+         break;
+      case 'P':
+         replay_filename = optarg;
+         break;
       case 'p':
          snprintf(record_path, 256, "%s", optarg);
          break;
@@ -1616,6 +2539,9 @@ int main(int argc, char **argv)
       case 's':
          initial_recording_state = STREAM;
          break;
+      case 'T':
+         trace_filename = optarg;
+         break;
       case 't':
          initial_recording_state = RECORD_STREAM;
          break;
@@ -1627,12 +2553,34 @@ int main(int argc, char **argv)
          strncpy(usb_port, optarg, 24);
          serial_set_state(-1, usb_port, -1);
          break;
+      case 'x':
+         replay_speed = atof(optarg);
+         if (replay_speed < 0.0) {
+            fprintf(stderr, "Replay speed can't be negative.\n");
+            return EXIT_FAILURE;
+         }
+         break;
       default:
          display_help(argc, argv);
          return EXIT_FAILURE;
       }
    }
 
+   if ((trace_filename != NULL) && (replay_filename != NULL)) {
+      fprintf(stderr, "A trace can't be recorded and replayed at the same time.\n");
+      return EXIT_FAILURE;
+   }
+   if ((trace_frames_filename != NULL) && (trace_filename == NULL) && (replay_filename == NULL)) {
+      fprintf(stderr, "--trace-frames needs --trace or --replay.\n");
+      return EXIT_FAILURE;
+   }
+   replaying = (replay_filename != NULL);
+
+   if (headless) {
+      sdl_flags |= SDL_WINDOW_HIDDEN;
+      fullscreen = 0;
+   }
+
    // Initialize logging
    if (log_filename) {
       if (init_logging(log_filename, LOG_TO_FILE) != 0) {
@@ -1648,63 +2596,14 @@ int main(int argc, char **argv)
 
    curl_global_init(CURL_GLOBAL_DEFAULT);
 
-   /* Create server message queue */
-   struct mq_attr attr;
-
-   attr.mq_flags = 0;
-   attr.mq_maxmsg = MAX_MESSAGES;
-   attr.mq_msgsize = MAX_MSG_SIZE;
-   attr.mq_curmsgs = 0;
-
-   if (mq_unlink(SERVER_QUEUE_NAME) == -1) {
-      // Checking but failure isn't important.
-      //perror("Server: mq_unlink");
-   }
-
-   if ((qd_server = mq_open(SERVER_QUEUE_NAME, O_RDONLY | O_CREAT, QUEUE_PERMISSIONS, &attr)) == -1) {
-      perror("Server: mq_open (server)");
-      return EXIT_FAILURE;
-   }
-
    /* If we don't get an argument, read from stdin. */
    if (!usb_enable) {
       LOG_WARNING("No serial port reading from stdin.");
    }
 
-   for (current_thread = 0; current_thread < NUM_AUDIO_THREADS; current_thread++) {
-      /* Setup Output Device */
-      snprintf(audio_threads[current_thread].client_queue_name,
-               MAX_FILENAME_LENGTH, "/stark-sound-client-%d", current_thread);
-      if (mq_unlink(audio_threads[current_thread].client_queue_name) == -1) {
-         // Checking but failure isn't important.
-         //perror("Client: mq_unlink");
-      }
-      /* Create client message queue/read */
-      if ((audio_threads[current_thread].qd_client =
-           mq_open(audio_threads[current_thread].client_queue_name,
-                   O_RDONLY | O_CREAT, QUEUE_PERMISSIONS, &attr)) == -1) {
-         perror("Client: mq_open (client)");
-      }
-      /* server side */
-      if ((qd_clients[current_thread] =
-           mq_open(audio_threads[current_thread].client_queue_name, O_WRONLY)) == 1) {
-         perror("Server: Not able to open client queue");
-      }
-      if ((audio_threads[current_thread].qd_server = mq_open(SERVER_QUEUE_NAME, O_WRONLY)) == -1) {
-         perror("Client: mq_open (server)");
-      }
-
-      /* Create Thread */
-      audio_threads[current_thread].thread_id = current_thread;
-      //strncpy( audio_threads[current_thread].filename, file, MAX_FILENAME_LENGTH );
-      //audio_threads[current_thread].start_percent = start_percent;
-      audio_threads[current_thread].stop = 1;
-
-      if (pthread_create
-          (&thread_handles[current_thread], NULL, audio_thread, &audio_threads[current_thread])) {
-         LOG_ERROR("Error creating thread [%d]", current_thread);
-         return EXIT_FAILURE;
-      }
+   /* Start the mixer. Sounds are decoded once the config has set their path. */
+   if (audio_init() != SUCCESS) {
+      return EXIT_FAILURE;
    }
 
    /* Send test messages */
@@ -1723,6 +2622,10 @@ int main(int argc, char **argv)
    }
 
    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+#ifdef USE_NVMM_ZERO_COPY
+   /* EGLImage import needs an EGL context, not GLX. */
+   SDL_SetHint(SDL_HINT_VIDEO_X11_FORCE_EGL, "1");
+#endif
 
    // Create window with native dimensions
    if ((window =
@@ -1771,11 +2674,30 @@ int main(int argc, char **argv)
       return EXIT_FAILURE;
    }
 
+   SDL_DisplayMode display_mode;
+   if (SDL_GetWindowDisplayMode(window, &display_mode) == 0) {
+      frame_pacer_init(display_mode.refresh_rate);
+   } else {
+      frame_pacer_init(0);
+   }
+
    // Set the logical size to your native resolution
+   /* A max speed replay measures rendering, not the display's refresh. */
+   if (replaying && (replay_speed == 0.0)) {
+      SDL_GL_SetSwapInterval(0);
+   }
+
    if (SDL_RenderSetLogicalSize(renderer, native_width, native_height) != 0) {
       SDL_Log("Could not set logical size: %s", SDL_GetError());
    }
 
+#ifdef USE_NVMM_ZERO_COPY
+   if (!no_camera_mode && (nvmm_texture_init() != SUCCESS)) {
+      LOG_ERROR("Unable to initialize zero-copy camera textures.");
+      return EXIT_FAILURE;
+   }
+#endif
+
    init_pbo_system();
    set_screenshot_recording_path(record_path);
    set_video_recording_path(record_path);
@@ -1799,8 +2721,54 @@ int main(int argc, char **argv)
    LOG_INFO("Initial configuration loaded successfully");
    last_file_check = currTime;
 
+   audio_preload();
+
+   /* The camera pipeline and textures are sized once from the initial config. */
+   camera_governor_init(this_hds);
+   update_cam_frame_geometry();
+
+   if (replaying) {
+      int trace_width = 0, trace_height = 0, trace_eyes = 0;
+
+      if (trace_replay_open(replay_filename, trace_frames_filename, replay_speed) != SUCCESS) {
+         return EXIT_FAILURE;
+      }
+
+      if (trace_replay_frame_info(&trace_width, &trace_height, &trace_eyes) != SUCCESS) {
+         no_camera_mode = 1;
+      } else if ((trace_width != this_hds->cam_frame_width) ||
+                 (trace_height != this_hds->cam_frame_height)) {
+         LOG_ERROR("Trace frames are %dx%d but the config expects %dx%d camera frames.",
+                   trace_width, trace_height, this_hds->cam_frame_width,
+                   this_hds->cam_frame_height);
+         return EXIT_FAILURE;
+      } else {
+#ifdef USE_NVMM_ZERO_COPY
+         LOG_WARNING("Trace frames can't be shown on the zero-copy camera path, using a black background.");
+         no_camera_mode = 1;
+#else
+         no_camera_mode = 0;
+         single_cam = (trace_eyes == 1);
+#endif
+      }
+   } else if (trace_filename != NULL) {
+#ifdef USE_NVMM_ZERO_COPY
+      if (trace_frames_filename != NULL) {
+         LOG_WARNING("Camera frames can't be traced on the zero-copy camera path, recording messages only.");
+         trace_frames_filename = NULL;
+      }
+#endif
+      if (trace_record_start(trace_filename, no_camera_mode ? NULL : trace_frames_filename,
+                             this_hds->cam_frame_width, this_hds->cam_frame_height,
+                             single_cam ? 1 : 2) != SUCCESS) {
+         return EXIT_FAILURE;
+      }
+   }
+
 #ifndef ORIGINAL_RATIO
-   SDL_Rect v_src_rect = { this_hds->cam_crop_x, 0, this_hds->cam_crop_width, this_hds->cam_input_height };
+   SDL_Rect v_src_rect = { this_hds->cam_frame_crop_x, 0,
+                           this_hds->cam_crop_at_source ? this_hds->cam_frame_width : this_hds->cam_crop_width,
+                           this_hds->cam_frame_height };
    SDL_Rect v_dst_rectL = { 0, 0, this_hds->eye_output_width, this_hds->eye_output_height };
    SDL_Rect v_dst_rectR = { this_hds->eye_output_width, 0, this_hds->eye_output_width, this_hds->eye_output_height };
 #else
@@ -1816,14 +2784,14 @@ int main(int argc, char **argv)
 
    textureL =
        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
-                         this_hds->cam_input_width, this_hds->cam_input_height);
+                         this_hds->cam_frame_width, this_hds->cam_frame_height);
    if (textureL == NULL) {
       SDL_Log("SDL_CreateTexture() failed on textureL: %s\n", SDL_GetError());
       return EXIT_FAILURE;
    }
    textureR =
        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
-                         this_hds->cam_input_width, this_hds->cam_input_height);
+                         this_hds->cam_frame_width, this_hds->cam_frame_height);
    if (textureR == NULL) {
       SDL_Log("SDL_CreateTexture() failed on textureR: %s\n", SDL_GetError());
       return EXIT_FAILURE;
@@ -1839,6 +2807,11 @@ int main(int argc, char **argv)
       play_intro(30, 1, NULL);
    }
 
+   sensor_store_init(SENSOR_MOTION, &this_motion, sizeof(this_motion));
+   sensor_store_init(SENSOR_ENVIRO, &this_enviro, sizeof(this_enviro));
+   sensor_store_init(SENSOR_GPS, &this_gps, sizeof(this_gps));
+   command_processing_init();
+
    mosquitto_lib_init();
 
    mosq = mosquitto_new(NULL, true, NULL);
@@ -1852,17 +2825,20 @@ int main(int argc, char **argv)
    mosquitto_subscribe_callback_set(mosq, on_subscribe);
    mosquitto_message_callback_set(mosq, on_message);
 
-   /* Connect to local MQTT server. */
-   //rc = mosquitto_connect(mosq, "192.168.10.1", 1883, 60);
-   rc = mosquitto_connect(mosq, "127.0.0.1", 1883, 60);
-   if(rc != MOSQ_ERR_SUCCESS){
-      mosquitto_destroy(mosq);
-      LOG_ERROR("Error: %s", mosquitto_strerror(rc));
-      return EXIT_FAILURE;
-   }
+   /* A replay stays off the broker so live traffic can't mix with the trace. */
+   if (!replaying) {
+      /* Connect to local MQTT server. */
+      //rc = mosquitto_connect(mosq, "192.168.10.1", 1883, 60);
+      rc = mosquitto_connect(mosq, "127.0.0.1", 1883, 60);
+      if(rc != MOSQ_ERR_SUCCESS){
+         mosquitto_destroy(mosq);
+         LOG_ERROR("Error: %s", mosquitto_strerror(rc));
+         return EXIT_FAILURE;
+      }
 
-   /* Start processing MQTT events. */
-   mosquitto_loop_start(mosq);
+      /* Start processing MQTT events. */
+      mosquitto_loop_start(mosq);
+   }
    /* End Setup */
 
    if (initial_recording_state != DISABLED) {
@@ -1875,36 +2851,23 @@ int main(int argc, char **argv)
 
    // Init the metrics after the intro so they aren't reported as stale.
    init_system_metrics();
+   system_sampler_start();
 
    //od_data oddataL, oddataR;
-   oddataL.complete = 1;
-   oddataL.processed = 1;
    oddataL.pix_data = NULL;
-   oddataR.complete = 1;
-   oddataR.processed = 1;
    oddataR.pix_data = NULL;
    detect_enabled = 0;     /* Disabling due to bug. */
    if (detect_enabled) {
-      if (init_detect(&oddataL.detect_obj, argc, argv, this_hds->cam_input_width, this_hds->cam_input_height))
-      {
-         LOG_ERROR("Error initializing detect!!!");
+      if (init_object_detection(argc, argv) != SUCCESS) {
          detect_enabled = 0;
-      } else {
-         if (intro_element.enabled) {
-            play_intro(15, 1, NULL);
-         }
-         if (init_detect(&oddataR.detect_obj, argc, argv, this_hds->cam_input_width, this_hds->cam_input_height))
-         {
-            LOG_ERROR("Error initializing detect!!!");
-            detect_enabled = 0;
-         } else {
-            //oddataL.detect_obj.v_mutex = &v_mutex;
-            //oddataR.detect_obj.v_mutex = &v_mutex;
-         }
       }
    }
 
-   if (!no_camera_mode) {
+   if (!no_camera_mode && replaying) {
+      /* The render loop publishes the trace's frames itself. */
+      frame_mailbox_init(&video_mailbox);
+   } else if (!no_camera_mode) {
+      frame_mailbox_init(&video_mailbox);
       if (pthread_create(&video_proc_thread, NULL, video_processing_thread, (void *) cam_type) != 0) {
          LOG_ERROR("Error creating video processing thread.");
          return EXIT_FAILURE;
@@ -1920,7 +2883,9 @@ int main(int argc, char **argv)
       play_intro(15, 1, NULL);
    }
 
-   if (!usb_enable) {
+   if (replaying) {
+      LOG_INFO("Replaying a trace, serial and socket input not started.");
+   } else if (!usb_enable) {
       strcpy(usb_port, "");
 
       if (pthread_create(&command_proc_thread, NULL, socket_command_processing_thread, NULL) != 0) {
@@ -1934,7 +2899,9 @@ int main(int argc, char **argv)
       }
    }
 
-   mqttTextToSpeech("Your hud is now online boss.");
+   if (!replaying) {
+      mqttTextToSpeech("Your hud is now online boss.");
+   }
 
    while (!quit) {
       totalFrames++;
@@ -1954,8 +2921,42 @@ int main(int argc, char **argv)
          check_and_reload_config(config_file);
          last_file_check = currTime;
       }
+      apply_pending_config();
+
+      camera_governor_update();
+      camera_profile_apply_pending(this_hds);
+
+      if (currTime - last_latency_report > LATENCY_REPORT_INTERVAL_MS) {
+         if (!replaying) {
+            publish_latency_stats(mosq);
+         }
+         last_latency_report = currTime;
+
+         frame_pacer_get_stats(&pacer_stats);
+         if (pacer_stats.missed > 0) {
+            LOG_WARNING("Frame pacing: %lu of %lu frames missed vsync (period %.2f ms, render %.2f ms).",
+                        pacer_stats.missed, pacer_stats.frames, pacer_stats.period_ms,
+                        pacer_stats.render_cost_ms);
+         }
+      }
+
+      if (currTime - last_armor_check > ARMOR_CHECK_INTERVAL_MS) {
+         armor_check_timeouts();
+         last_armor_check = currTime;
+      }
+
+      if (render_profiler_active() && (currTime - last_profile_report > RENDER_PROFILE_INTERVAL_MS)) {
+         if (!replaying) {
+            publish_render_profile(mosq);
+         } else {
+            render_profiler_report_json(profile_report, sizeof(profile_report));
+         }
+         last_profile_report = currTime;
+      }
 
       while (SDL_PollEvent(&event)) {
+         hud_mark_damaged();
+
          switch (event.type) {
          case SDL_KEYUP:
             /* Check for hotkeys. */
@@ -1968,7 +2969,7 @@ int main(int argc, char **argv)
                      curr_element->enabled = !curr_element->enabled;
                      if (strncmp(curr_element->special_name, "detect", 6) == 0) {
                         LOG_INFO("Changing detect status.");
-                        detect_enabled = !detect_enabled;
+                        set_detect_enabled(!detect_enabled);
                      }
                      LOG_INFO("Changing status.");
                   }
@@ -2056,6 +3057,20 @@ int main(int argc, char **argv)
                }
                break;
 
+            case SDLK_y:
+               if (get_recording_state() == DISABLED) {
+                  set_recording_state(REPLAY);
+                  LOG_INFO("Starting replay buffer.");
+               } else if (get_recording_state() == REPLAY) {
+                  set_recording_state(DISABLED);
+                  LOG_INFO("Stopping replay buffer.");
+               }
+               break;
+
+            case SDLK_c:  // 'C' to clip the replay buffer
+               save_replay();
+               break;
+
             case SDLK_LEFT:
                this_hds->stereo_offset -= 10;
                LOG_INFO("Stereo Offset: %d", this_hds->stereo_offset);
@@ -2115,6 +3130,39 @@ int main(int argc, char **argv)
          }
       }
 
+      /* Pick up any asset files the watcher saw change. */
+      refresh_stale_textures();
+
+      /* With a black background nothing changes unless something flagged damage,
+       * so skip the whole redraw and present. Values that change without an
+       * event (clock, metrics) are still picked up by the periodic refresh. */
+      if (no_camera_mode && !replaying && (this_hds->idle_refresh_ms > 0) &&
+          (get_recording_state() == DISABLED) && (!intro_element.enabled || intro_finished)) {
+         if (!hud_take_damage() && ((currTime - last_present_time) < (unsigned int) this_hds->idle_refresh_ms)) {
+            SDL_WaitEventTimeout(NULL, HUD_IDLE_WAIT_MS);
+            continue;
+         }
+      }
+
+      /* Start as late as the last few frames say is safe, so the camera frame
+       * and pose we draw with are as fresh as possible at vsync. */
+      predicted_vsync_ns = frame_pacer_wait(this_hds->frame_pacing && !(replaying && (replay_speed == 0.0)),
+                                            (unsigned long) (this_hds->frame_pacing_margin_ms * 1000000.0));
+      frame_start_ns = latency_now_ns();
+
+      /* Feed in whatever the trace has up to this frame. */
+      if (replaying) {
+         replay_result = trace_replay_pump(frame_start_ns, &replay_left, &replay_right);
+         if (replay_result < 0) {
+            LOG_INFO("Trace replay finished.");
+            quit = 1;
+            break;
+         }
+         if ((replay_result > 0) && !no_camera_mode) {
+            publish_trace_frame(replay_left, replay_right);
+         }
+      }
+
       SDL_RenderClear(renderer);
 
       thisPTime = SDL_GetPerformanceCounter();
@@ -2131,6 +3179,15 @@ int main(int argc, char **argv)
       if (tracker.elapsedTime > 1.0) {
          averageFrameRate = calculateAverageFrameRate(&tracker);
          tracker.elapsedTime = 0.0;
+#ifdef DEBUG_BUFFERS
+         if (!no_camera_mode) {
+            frame_mailbox_stats fps_mb_stats;
+            get_video_mailbox_stats(&fps_mb_stats);
+            LOG_INFO("Camera mailbox: published %lu, consumed %lu, dropped %lu, reused %lu",
+                     fps_mb_stats.published, fps_mb_stats.consumed, fps_mb_stats.dropped,
+                     fps_mb_stats.reused);
+         }
+#endif
       }
 
 #ifdef FPS_STATS
@@ -2139,66 +3196,81 @@ int main(int argc, char **argv)
 #endif
 
       /* Video Processing */
+      frame_sensor_ns = 0;
       if (!no_camera_mode) {
-      pthread_mutex_lock(&v_mutex);
-      if (video_posted) {
-         if (detect_enabled) {
+         video_slot = frame_mailbox_acquire(&video_mailbox, &video_fresh);
+         if (video_slot >= 0) {
+            stereo_frame *this_frame = &video_frames[video_slot];
+
+            if (video_fresh) {
+               stage_ns = latency_now_ns();
+               latency_record(LAT_PULL_TO_DISPLAY, this_frame->pull_ns, stage_ns);
+               frame_sensor_ns = this_frame->sensor_ns;
+               displayed_frame_ns = (this_frame->sensor_ns != 0) ? this_frame->sensor_ns : this_frame->pull_ns;
+            }
+
+            /* Inference only runs on every Nth frame, the tracker interpolates between. */
+            if (detect_enabled && video_fresh &&
+                ((detect_frame_count++ %
+                  camera_governor_detect_divisor(this_hds->detect_frame_divisor)) == 0)) {
 #if defined(OD_PROPER_WAIT) && defined(USE_CUDA)
-            oddataL.pix_data = mapL[buffer_num].data;
-            oddataL.eye = 0;
-            cudaMemcpy(oddataL.detect_obj.d_image, oddataL.pix_data,
-                       oddataL.detect_obj.l_width * oddataL.detect_obj.l_height * sizeof(uchar4), cudaMemcpyHostToDevice);
-            detect_image(&oddataL.detect_obj, oddataL.pix_data, this_detect[oddataL.eye], MAX_DETECT);
-
-            if (!single_cam) {
-               oddataR.pix_data = mapR[buffer_num].data;
-               oddataR.eye = 1;
-               cudaMemcpy(oddataR.detect_obj.d_image, oddataR.pix_data,
-                          oddataR.detect_obj.l_width * oddataR.detect_obj.l_height * sizeof(uchar4), cudaMemcpyHostToDevice);
-               detect_image(&oddataR.detect_obj, oddataR.pix_data, this_detect[oddataR.eye], MAX_DETECT);
+               oddataL.pix_data = this_frame->mapL.data;
+               oddataL.eye = 0;
+               cudaMemcpy(oddataL.detect_obj.d_image, oddataL.pix_data,
+                          oddataL.detect_obj.l_width * oddataL.detect_obj.l_height * sizeof(uchar4), cudaMemcpyHostToDevice);
+               detect_image(&oddataL.detect_obj, oddataL.pix_data, this_detect[oddataL.eye],
+                            this_hds->detect_top_k, (float) this_hds->detect_min_confidence);
+               detect_worker_publish(oddataL.eye, this_detect[oddataL.eye], displayed_frame_ns);
+
+               if (!single_cam) {
+                  oddataR.pix_data = this_frame->mapR.data;
+                  oddataR.eye = 1;
+                  cudaMemcpy(oddataR.detect_obj.d_image, oddataR.pix_data,
+                             oddataR.detect_obj.l_width * oddataR.detect_obj.l_height * sizeof(uchar4), cudaMemcpyHostToDevice);
+                  detect_image(&oddataR.detect_obj, oddataR.pix_data, this_detect[oddataR.eye],
+                               this_hds->detect_top_k, (float) this_hds->detect_min_confidence);
+                  detect_worker_publish(oddataR.eye, this_detect[oddataR.eye], displayed_frame_ns);
+               }
+#else
+               /* Hand the frames to the workers. They hold their own buffer refs. */
+               detect_worker_submit(0, this_frame->bufferL, displayed_frame_ns);
+               if (!single_cam) {
+                  detect_worker_submit(1, this_frame->bufferR, displayed_frame_ns);
+               }
+#endif
             }
+
+            /* Only upload when there is a new capture, otherwise the textures already hold it. */
+            stage_ns = latency_now_ns();
+            if (video_fresh) {
+#ifdef USE_NVMM_ZERO_COPY
+               nvmm_texture_update(textureL, 0, &this_frame->mapL);
 #else
+               SDL_UpdateTexture(textureL, NULL, this_frame->mapL.data, this_hds->cam_frame_width * 4);
+#endif
+            }
+            SDL_RenderCopy(renderer, textureL, &v_src_rect, &v_dst_rectL);
+
             if (single_cam) {
-               if (oddataL.processed == 1) {
-                  oddataL.pix_data = mapL[buffer_num].data;
-                  oddataL.eye = 0;
-                  oddataL.complete = 0;
-                  oddataL.processed = 0;
-                  pthread_create(&od_L_thread, NULL, object_detection_thread, &oddataL);
-               }
+               SDL_RenderCopy(renderer, textureL, &v_src_rect, &v_dst_rectR);
             } else {
-               if ((oddataL.processed == 1) && (oddataR.processed == 1)) {
-                  oddataL.pix_data = mapL[buffer_num].data;
-                  oddataL.eye = 0;
-                  oddataL.complete = 0;
-                  oddataL.processed = 0;
-                  pthread_create(&od_L_thread, NULL, object_detection_thread, &oddataL);
-
-                  oddataR.pix_data = mapR[buffer_num].data;
-                  oddataR.eye = 1;
-                  oddataR.complete = 0;
-                  oddataR.processed = 0;
-                  pthread_create(&od_R_thread, NULL, object_detection_thread, &oddataR);
+               if (video_fresh) {
+#ifdef USE_NVMM_ZERO_COPY
+                  nvmm_texture_update(textureR, 1, &this_frame->mapR);
+#else
+                  SDL_UpdateTexture(textureR, NULL, this_frame->mapR.data, this_hds->cam_frame_width * 4);
+#endif
                }
+               SDL_RenderCopy(renderer, textureR, &v_src_rect, &v_dst_rectR);
+            }
+            if (video_fresh) {
+               latency_record(LAT_TEXTURE_UPLOAD, stage_ns, latency_now_ns());
             }
-#endif
-         }
-
-         SDL_UpdateTexture(textureL, NULL, mapL[buffer_num].data, this_hds->cam_input_width * 4);
-         SDL_RenderCopy(renderer, textureL, &v_src_rect, &v_dst_rectL);
-
-         if (single_cam) {
-            SDL_RenderCopy(renderer, textureL, &v_src_rect, &v_dst_rectR);
-         } else {
-            SDL_UpdateTexture(textureR, NULL, mapR[buffer_num].data, this_hds->cam_input_width * 4);
-            SDL_RenderCopy(renderer, textureR, &v_src_rect, &v_dst_rectR);
-         }
 
 #ifdef DISPLAY_TIMING
-         last_ts_cap = (unsigned long) ts_cap[buffer_num].tv_sec * 1000000000 + ts_cap[buffer_num].tv_nsec;
+            last_ts_cap = (unsigned long) this_frame->ts_cap.tv_sec * 1000000000 + this_frame->ts_cap.tv_nsec;
 #endif
-      }
-      pthread_mutex_unlock(&v_mutex);
+         }
       } else {
          /* When in black background mode, simply render black rectangles as backgrounds */
          SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -2210,7 +3282,22 @@ int main(int argc, char **argv)
       if (intro_element.enabled && !intro_finished) {
          play_intro(1, 0, &intro_finished);
       } else {
+         /* One pose and sensor snapshot for every element this frame, taken as late as possible. */
+         pose_latch(predicted_vsync_ns, this_hds->pose_prediction);
+         sensor_store_latch();
+
+         stage_ns = latency_now_ns();
+         overlay = record_composite_active() && (hud_overlay_begin() == SUCCESS);
+         hud_eye_layer_begin();
          render_hud_elements();
+         hud_eye_layer_end();
+         if (overlay) {
+            hud_overlay_end();
+         } else {
+            hud_overlay_drawn = 0;
+         }
+         texture_atlas_flush();
+         latency_record(LAT_HUD_RENDER, stage_ns, latency_now_ns());
 
 #ifdef DISPLAY_TIMING
          clock_gettime(CLOCK_REALTIME, &display_time);
@@ -2246,55 +3333,24 @@ int main(int argc, char **argv)
                last_file_check = currTime;
             }
 
-            this_vod->rgb_out_pixels[this_vod->write_index] =
-                malloc(window_width * RGB_OUT_SIZE * window_height);
-            if (this_vod->rgb_out_pixels[this_vod->write_index] == NULL) {
-               LOG_ERROR("Unable to malloc rgb frame 0.");
-               return (2);
-            }
-
 #ifdef ENCODE_TIMING
             start = SDL_GetTicks();
 #endif
-
-            /* CRITICAL FIX: Ensure GPU has finished rendering before reading pixels
-             * Without this sync, we read partially rendered frames causing corruption.
-             * glFlush() just sends commands, glFinish() waits for completion.
-             */
-            glFinish();
-
-            if (OpenGL_RenderReadPixelsSync(renderer, NULL, PIXEL_FORMAT_OUT,
-                                     this_vod->rgb_out_pixels[this_vod->write_index],
-                                     window_width * RGB_OUT_SIZE) != 0 ) {
-               LOG_ERROR("OpenGL_RenderReadPixelsAsync() failed");
-               /* Free the buffer on failure */
-               free(this_vod->rgb_out_pixels[this_vod->write_index]);
-               this_vod->rgb_out_pixels[this_vod->write_index] = NULL;
+            stage_ns = latency_now_ns();
+            record_readback_frame();
+            latency_record(LAT_READBACK, stage_ns, latency_now_ns());
 #ifdef ENCODE_TIMING
-            } else {
-               stop = SDL_GetTicks();
-               cur_time = stop - start;
-               avg_time = ((avg_time * weight) + cur_time) / (weight + 1);
-               weight++;
-               if (cur_time > max_time)
-                  max_time = cur_time;
-               if ((cur_time < min_time) || (min_time == 0))
-                  min_time = cur_time;
-               printf("OpenGL_RenderReadPixelsAsync(): %0.2f ms, min: %d, max: %d. weight: %d\r",
-                      avg_time, min_time, max_time, weight);
+            stop = SDL_GetTicks();
+            cur_time = stop - start;
+            avg_time = ((avg_time * weight) + cur_time) / (weight + 1);
+            weight++;
+            if (cur_time > max_time)
+               max_time = cur_time;
+            if ((cur_time < min_time) || (min_time == 0))
+               min_time = cur_time;
+            printf("record_readback_frame(): %0.2f ms, min: %d, max: %d. weight: %d\r",
+                   avg_time, min_time, max_time, weight);
 #endif
-            }
-
-            pthread_mutex_lock(&this_vod->p_mutex);
-            if (this_vod->rgb_out_pixels[this_vod->buffer_num] != NULL) {
-               free(this_vod->rgb_out_pixels[this_vod->buffer_num]);
-               this_vod->rgb_out_pixels[this_vod->buffer_num] = NULL;
-            }
-
-            /* Rotate indices */
-            rotate_triple_buffer_indices(this_vod);
-
-            pthread_mutex_unlock(&this_vod->p_mutex);
 
             if (get_recording_state() != DISABLED && get_video_out_thread() == 0) {
                pthread_t thread_id;
@@ -2309,36 +3365,51 @@ int main(int argc, char **argv)
             if (active_alerts & ALERT_RECORDING) {
                active_alerts &= ~ALERT_RECORDING;
             }
+
+            /* Don't let the next recording start with frames from this one. */
+            readback_ring_reset();
          }
 
          // Process any pending screenshot requests
          process_screenshot_requests(no_camera_mode);
 
+         stage_ns = latency_now_ns();
          SDL_RenderPresent(renderer);
+         latency_record(LAT_PRESENT, stage_ns, latency_now_ns());
+         frame_pacer_presented(stage_ns);
+         if (replaying) {
+            trace_replay_frame_done(frame_start_ns, stage_ns);
+         }
+         last_present_time = currTime;
+         latency_record(LAT_MOTION_TO_PHOTON, frame_sensor_ns, latency_now_ns());
       }
    }
 
-   mqttTextToSpeech("Your hud is shutting down.");
+   if (!replaying) {
+      mqttTextToSpeech("Your hud is shutting down.");
+   }
 
    set_recording_state(DISABLED);
+   screenshot_encoder_stop();
    cleanup_video_out_data();
-   pthread_mutex_destroy(&v_mutex);
    pthread_mutex_destroy(&windowSizeMutex);
 
-   /* Close audio threads. */
+   system_sampler_stop();
+
+   /* Stop the audio mixer. */
 #ifdef DEBUG_SHUTDOWN
-   LOG_INFO("Waiting on audio threads to stop.");
+   LOG_INFO("Waiting on audio mixer to stop.");
 #endif
-   for (int i = 0; i < NUM_AUDIO_THREADS; i++) {
-      pthread_join(thread_handles[i], NULL);
-   }
+   audio_cleanup();
 #ifdef DEBUG_SHUTDOWN
    LOG_INFO("Done.");
 
    LOG_INFO("Waiting on command processing thread to stop.");
 #endif
    //pthread_join(command_proc_thread, NULL); // TODO: This is hanging.
-   pthread_cancel(command_proc_thread);
+   if (command_proc_thread != 0) {
+      pthread_cancel(command_proc_thread);
+   }
 #ifdef DEBUG_SHUTDOWN
    LOG_INFO("Done.");
 
@@ -2353,6 +3424,8 @@ int main(int argc, char **argv)
    LOG_INFO("Freeing fonts.");
 #endif
    /* Free fonts. */
+   glyph_atlas_cleanup();
+   log_console_cleanup();
    this_font = font_list;
    while (this_font != NULL) {
       local_font *next_font = this_font->next;
@@ -2368,16 +3441,19 @@ int main(int argc, char **argv)
    LOG_INFO("Freeing texture cache.");
 #endif
    /* Free texture cache */
-   texture_cache *this_tex = texture_list;
-   while (this_tex != NULL) {
-      texture_cache *next_tex = this_tex->next;
-      if (this_tex->texture) {
-         SDL_DestroyTexture(this_tex->texture);
+   texture_atlas_cleanup();
+   if (eye_layer != NULL) {
+      SDL_DestroyTexture(eye_layer);
+      eye_layer = NULL;
+   }
+   for (int i = 0; i < HUD_LAYER_COUNT; i++) {
+      if (hud_layers[i] != NULL) {
+         SDL_DestroyTexture(hud_layers[i]);
+         hud_layers[i] = NULL;
       }
-      free(this_tex);
-      this_tex = next_tex;
    }
-   texture_list = NULL;
+   texture_cache_cleanup();
+   asset_bundle_close();
 #ifdef DEBUG_SHUTDOWN
    LOG_INFO("Done.");
 #endif
@@ -2402,12 +3478,40 @@ int main(int argc, char **argv)
 #ifdef DEBUG_SHUTDOWN
       LOG_INFO("Wainting on video processing to stop.");
 #endif
-      pthread_join(video_proc_thread, NULL);
+      if (video_proc_thread != 0) {
+         pthread_join(video_proc_thread, NULL);
+      }
+
+      for (int i = 0; i < FRAME_MAILBOX_SLOTS; i++) {
+         release_stereo_frame(&video_frames[i]);
+      }
+
+      frame_mailbox_stats mb_stats;
+      get_video_mailbox_stats(&mb_stats);
+      LOG_INFO("Camera frames: %lu captured, %lu displayed, %lu dropped, %lu render passes reused a frame.",
+               mb_stats.published, mb_stats.consumed, mb_stats.dropped, mb_stats.reused);
+
+      if (!single_cam) {
+         stereo_sync_stats sync_stats;
+         get_stereo_sync_stats(&sync_stats);
+         LOG_INFO("Stereo sync: %lu pairs, %lu hiccups, max skew %ld us, "
+                  "dropped L/R: %lu/%lu overflow, %lu/%lu unmatched.",
+                  sync_stats.pairs, sync_stats.hiccups, sync_stats.skew_max_ns / 1000,
+                  sync_stats.overflow_l, sync_stats.overflow_r,
+                  sync_stats.unmatched_l, sync_stats.unmatched_r);
+      }
 #ifdef DEBUG_SHUTDOWN
       LOG_INFO("Done.");
 #endif
    }
 
+   /* Every input thread is gone by now. */
+   trace_record_stop();
+   if (replaying) {
+      trace_replay_report(replay_report_filename);
+      trace_replay_close();
+   }
+
    pthread_t vid_out_thread = get_video_out_thread();
    if (vid_out_thread != 0) {
 #ifdef DEBUG_SHUTDOWN
@@ -2425,6 +3529,7 @@ int main(int argc, char **argv)
 #ifdef DEBUG_SHUTDOWN
    LOG_INFO("Destroy primary textures.");
 #endif
+   nvmm_texture_cleanup();
    if (textureL != NULL) {
       SDL_DestroyTexture(textureL);
       textureL = NULL;
@@ -2463,13 +3568,13 @@ int main(int argc, char **argv)
    LOG_INFO("Done.");
 #endif
 
+   detect_worker_stop();
    if (detect_enabled)
    {
 #ifdef DEBUG_SHUTDOWN
       LOG_INFO("Waiting for detection to clean up.");
 #endif
-      free_detect(&oddataL.detect_obj);
-      free_detect(&oddataR.detect_obj);
+      cleanup_object_detection();
 #ifdef DEBUG_SHUTDOWN
       LOG_INFO("Done.");
 #endif
@@ -30,6 +30,7 @@
 #include "config_parser.h"
 #include "detect.h"
 #include "devices.h"
+#include "frame_mailbox.h"
 #include "recording.h"
 
 // DATA Structures and Defines
@@ -40,9 +41,6 @@ typedef struct _od_data {
    void *pix_data;
 
    int eye;
-
-   int complete;
-   int processed;
 } od_data;
 
 /* ALERTS */
@@ -66,6 +64,9 @@ struct Alert {
  * This function provides access to the motion sensor data including
  * heading, pitch, roll and quaternion values.
  *
+ * This is the writers' working copy. Update it between sensor_store_write_begin()
+ * and sensor_store_write_end(); readers use the published snapshot instead.
+ *
  * @return Pointer to the global motion data structure.
  */
 motion *get_motion_dev(void);
@@ -76,6 +77,9 @@ motion *get_motion_dev(void);
  * This function provides access to environmental sensor data including
  * temperature, humidity, air quality, CO2 levels, and related metrics.
  *
+ * This is the writers' working copy. Update it between sensor_store_write_begin()
+ * and sensor_store_write_end(); readers use the published snapshot instead.
+ *
  * @return Pointer to the global environmental data structure.
  */
 enviro *get_enviro_dev(void);
@@ -86,6 +90,9 @@ enviro *get_enviro_dev(void);
  * This function provides access to GPS data including position coordinates,
  * time, date, speed, altitude, and satellite information.
  *
+ * This is the writers' working copy. Update it between sensor_store_write_begin()
+ * and sensor_store_write_end(); readers use the published snapshot instead.
+ *
  * @return Pointer to the global GPS data structure.
  */
 gps *get_gps_dev(void);
@@ -216,21 +223,7 @@ int get_window_size(int *width, int *height);
  * @param font_size Size of the font in points.
  * @return Pointer to the loaded TTF_Font, or NULL if loading failed.
  */
-TTF_Font *get_local_font(char *font_name, int font_size);
-
-/**
- * @brief Retrieves a texture from the texture cache or loads it if not present.
- *
- * This function manages a cache of loaded SDL textures to avoid repeatedly loading
- * the same texture resources. If the requested texture is already in the cache and
- * the file hasn't been modified, it is returned; otherwise, it is loaded from disk,
- * added to the cache, and returned. This dramatically improves performance during
- * configuration reloads.
- *
- * @param filename Path to the image file.
- * @return Pointer to the loaded SDL_Texture, or NULL if loading failed.
- */
-SDL_Texture *get_cached_texture(const char *filename);
+TTF_Font *get_local_font(const char *font_name, int font_size);
 
 /**
  * @brief Checks if the application is in the process of shutting down.
@@ -248,12 +241,49 @@ int checkShutdown(void);
  * This function copies the latest camera frame, without any overlay, to the provided buffer.
  * For now this uses a simple memcpy because this isn't currently a frequent operation.
  * There is a better frame copy available if we're recording/streaming at the time.
+ * It reads the frame the render loop currently holds, so call it from the render thread.
  *
  * @param temp_buffer pointer to uninitialized memory location. This will be malloced and need to be freed.
  * @return memory location of allocated frame, should match temp_buffer for easy checking.
  */
 void *grab_latest_camera_frame(void *temp_buffer);
 
+/**
+ * @brief Copies the camera frame mailbox counters.
+ *
+ * Dropped frames were captured but replaced before the renderer saw them. Reused
+ * frames are render passes that found no new capture and drew the previous one.
+ *
+ * @param stats Destination for the counters.
+ */
+void get_video_mailbox_stats(frame_mailbox_stats *stats);
+
+/**
+ * @brief Returns the capture time of the camera frame currently on screen.
+ *
+ * Uses the latency_now_ns() clock. 0 until the first frame is shown.
+ */
+unsigned long get_displayed_frame_ns(void);
+
+/* Stereo camera pairing statistics. */
+typedef struct {
+   long skew_ns;                 /* Left minus right PTS of the last published pair. */
+   long skew_max_ns;             /* Largest absolute skew seen. */
+   unsigned long pairs;          /* Pairs matched within tolerance. */
+   unsigned long hiccups;        /* Frames published reusing the other eye's last frame. */
+   unsigned long overflow_l;     /* Frames dropped because an eye queue was full. */
+   unsigned long overflow_r;
+   unsigned long unmatched_l;    /* Frames dropped by the pairing stage. */
+   unsigned long unmatched_r;
+} stereo_sync_stats;
+
+/**
+ * @brief Copies the stereo camera pairing statistics, including inter-eye skew.
+ *
+ * @param stats Destination for the statistics.
+ */
+void get_stereo_sync_stats(stereo_sync_stats *stats);
+
 /**
  * @brief Renders a texture to both eyes in a stereo display.
  *
@@ -270,6 +300,72 @@ void *grab_latest_camera_frame(void *temp_buffer);
 void renderStereo(SDL_Texture * tex, SDL_Rect * src, SDL_Rect * dest, SDL_Rect * dest2,
                   double angle);
 
+#ifdef MIRAGE_BENCH
+/**
+ * @brief Sets the renderer returned by get_sdl_renderer(). mirage_bench only.
+ *
+ * The calling thread becomes the render thread.
+ */
+void mirage_bench_set_renderer(SDL_Renderer *bench_renderer);
+#endif
+
+/**
+ * @brief Starts a HUD eye layer pass if enabled by "HUD Eye Layer".
+ *
+ * While the pass is active renderStereo() draws elements whose eye positions
+ * differ only by the stereo offset once into an eye sized target instead of
+ * twice to the window. Anything eye specific composites the layer so far,
+ * draws directly and the layer resumes on the next stereo draw, so the final
+ * draw order is unchanged.
+ *
+ * @return SUCCESS if the pass started, FAILURE if elements draw directly.
+ */
+int hud_eye_layer_begin(void);
+
+/**
+ * @brief Composites any pending layer content and returns to the window.
+ *
+ * Elements that draw to the window themselves must call this first.
+ */
+void hud_eye_layer_pause(void);
+
+/**
+ * @brief Composites the layer into both eyes and ends the pass.
+ */
+void hud_eye_layer_end(void);
+
+/* Offscreen HUD layers used to animate transitions as whole images. */
+typedef enum {
+   HUD_LAYER_FROM,      /* The HUD being left. */
+   HUD_LAYER_TO,        /* The HUD being switched to. */
+   HUD_LAYER_COUNT
+} hud_layer_t;
+
+/**
+ * @brief Redirects HUD drawing into a transition layer.
+ *
+ * The layer covers both eyes and is cleared first. Every draw until
+ * hud_layer_end() lands in it instead of the window.
+ *
+ * @return SUCCESS, or FAILURE if the renderer can't provide the layer.
+ */
+int hud_layer_begin(hud_layer_t layer);
+
+/**
+ * @brief Returns drawing to the window after hud_layer_begin().
+ */
+void hud_layer_end(void);
+
+/**
+ * @brief Draws a captured transition layer to both eyes.
+ *
+ * @param layer    The layer to draw.
+ * @param alpha    Opacity, 0.0 - 1.0.
+ * @param offset_x Horizontal offset in pixels. Each eye clips to its own half.
+ * @param scale    Scale around the eye center, 1.0 is unscaled.
+ */
+void hud_layer_draw(hud_layer_t layer, float alpha, int offset_x, float scale);
+
 /**
  * @brief Sends a text message to be spoken via text-to-speech over MQTT.
  *
@@ -290,6 +386,29 @@ void mqttTextToSpeech(const char *text);
  */
 void mqttSendMessage(const char *topic, const char *text);
 
+/**
+ * @brief Loads one of an element's textures through the texture cache.
+ *
+ * Records the reference on the element so free_elements() gives it back,
+ * whatever the element's texture fields point at by then.
+ *
+ * @param this_element The element the texture is for.
+ * @param ref          Which of the element's files to load.
+ * @return The texture, or NULL if it couldn't be loaded.
+ */
+SDL_Texture *acquire_element_texture(element *this_element, element_texture_ref ref);
+
+/**
+ * @brief Replaces a texture in every element that holds it.
+ *
+ * Used by the texture cache when a reload has to create a new texture, so
+ * the old one can be destroyed. Must be called from the render thread.
+ *
+ * @param from The texture being replaced.
+ * @param to   Its replacement.
+ */
+void retarget_element_textures(SDL_Texture *from, SDL_Texture *to);
+
 /**
  * @brief Frees all elements in a UI element linked list and their associated resources.
  *
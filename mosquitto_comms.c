@@ -27,7 +27,10 @@
 #include "command_processing.h"
 #include "config_parser.h"
 #include "config_manager.h"
+#include "input_trace.h"
+#include "latency_stats.h"
 #include "logging.h"
+#include "render_profiler.h"
 
 /* Mosquitto STUFF */
 /* Callback called when the client receives a CONNACK message from the broker. */
@@ -96,6 +99,28 @@ void on_subscribe(struct mosquitto *mosq, void *obj, int mid, int qos_count, con
 	}
 }
 
+/* Handle one inbound message. Live messages and trace replay both come through here. */
+void mqtt_dispatch_message(const char *topic, char *payload)
+{
+   //LOG_INFO("%s %s", topic, payload);
+
+   // Check if this is a helmet command that needs to be forwarded to serial
+   if (strcmp(topic, "helmet") == 0) {
+      // Forward the message to serial if connected
+      LOG_INFO("Received 'helmet' message to forward.");
+      forward_helmet_command_to_serial(payload);
+   }
+
+   if (strcmp(topic, "hud") != 0) {
+      /* FIXME: Right now if it's not for "hud," I'm assuming it's from an armor component.
+       * I probably need a better way. ;-)
+       */
+      registerArmor(topic);
+   }
+
+   parse_json_command(payload, (char *) topic);
+}
+
 /* Callback called when the client receives a message. */
 void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg)
 {
@@ -109,25 +134,61 @@ void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_messag
    memcpy(payload, msg->payload, msg->payloadlen);
    payload[msg->payloadlen] = '\0';
 
-   //LOG_INFO("%s %d %s", msg->topic, msg->qos, (char *)msg->payload);
+   if (trace_is_recording()) {
+      trace_record_message(TRACE_SOURCE_MQTT, 0, msg->topic, payload, msg->payloadlen);
+   }
 
-   // Check if this is a helmet command that needs to be forwarded to serial
-   if (strcmp(msg->topic, "helmet") == 0) {
-      // Forward the message to serial if connected
-      LOG_INFO("Received 'helmet' message to forward.");
-      forward_helmet_command_to_serial((char *)msg->payload);
+   mqtt_dispatch_message(msg->topic, payload);
+
+   free(payload);
+}
+/* Publish the latency histograms for the window since the last call. */
+void publish_latency_stats(struct mosquitto *mosq)
+{
+   char report[LATENCY_REPORT_LENGTH];
+   int rc = 0;
+   int len = 0;
+
+   len = latency_stats_report_json(report, sizeof(report));
+   if (len >= (int) sizeof(report)) {
+      LOG_WARNING("Latency report truncated.");
+      return;
    }
 
-   if (strcmp(msg->topic, "hud") != 0) {
-      /* FIXME: Right now if it's not for "hud," I'm assuming it's from an armor component.
-       * I probably need a better way. ;-)
-       */
-      registerArmor(msg->topic);
+   if (mosq == NULL) {
+      return;
    }
 
-   parse_json_command((char *)msg->payload, (char *)msg->topic);
+   rc = mosquitto_publish(mosq, NULL, MQTT_LATENCY_TOPIC, len, report, 0, false);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      LOG_ERROR("Error publishing latency stats: %s", mosquitto_strerror(rc));
+   }
+}
 
-   free(payload);
+/* Publish the costliest elements of the profiler window that just closed. */
+void publish_render_profile(struct mosquitto *mosq)
+{
+   char report[RENDER_PROFILE_REPORT_LENGTH];
+   int rc = 0;
+   int len = 0;
+
+   len = render_profiler_report_json(report, sizeof(report));
+   if (len == 0) {
+      return;
+   }
+   if (len >= (int) sizeof(report)) {
+      LOG_WARNING("Render profile report truncated.");
+      return;
+   }
+
+   if (mosq == NULL) {
+      return;
+   }
+
+   rc = mosquitto_publish(mosq, NULL, MQTT_PERF_TOPIC, len, report, 0, false);
+   if (rc != MOSQ_ERR_SUCCESS) {
+      LOG_ERROR("Error publishing render profile: %s", mosquitto_strerror(rc));
+   }
 }
 /* End Mosquitto Stuff */
 
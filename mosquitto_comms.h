@@ -26,5 +26,14 @@ void on_connect(struct mosquitto *mosq, void *obj, int reason_code);
 void on_subscribe(struct mosquitto *mosq, void *obj, int mid, int qos_count, const int *granted_qos);
 void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg);
 
+/* Route one inbound message by topic. payload must be NUL terminated and writable. */
+void mqtt_dispatch_message(const char *topic, char *payload);
+
+/* Rotate the latency window and publish it on MQTT_LATENCY_TOPIC. */
+void publish_latency_stats(struct mosquitto *mosq);
+
+/* Close the render profiler window and publish it on MQTT_PERF_TOPIC. */
+void publish_render_profile(struct mosquitto *mosq);
+
 #endif // MOSQUITTO_COMMS_H
 
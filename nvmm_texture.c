@@ -0,0 +1,230 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "logging.h"
+#include "mirage.h"
+#include "nvmm_texture.h"
+
+#ifdef USE_NVMM_ZERO_COPY
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "nvbufsurface.h"
+
+/* DRM_FORMAT_ABGR8888 is byte order R, G, B, A which is what RGBA in NVMM is. */
+#define NVMM_DRM_FORMAT_ABGR8888 0x34324241
+
+typedef void (*egl_image_target_texture_fn)(GLenum target, void *image);
+
+typedef struct {
+   int fd;
+   EGLImageKHR image;
+} nvmm_egl_entry;
+
+static PFNEGLCREATEIMAGEKHRPROC egl_create_image = NULL;
+static PFNEGLDESTROYIMAGEKHRPROC egl_destroy_image = NULL;
+static egl_image_target_texture_fn gl_image_target_texture = NULL;
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+
+static nvmm_egl_entry egl_cache[2][NVMM_EGL_CACHE_SIZE];
+static int egl_cache_next[2] = { 0, 0 };
+
+int nvmm_texture_init(void)
+{
+   egl_display = eglGetCurrentDisplay();
+   if (egl_display == EGL_NO_DISPLAY) {
+      LOG_ERROR("No current EGL display. Zero-copy requires an EGL backed GL context.");
+      return FAILURE;
+   }
+
+   egl_create_image = (PFNEGLCREATEIMAGEKHRPROC) eglGetProcAddress("eglCreateImageKHR");
+   egl_destroy_image = (PFNEGLDESTROYIMAGEKHRPROC) eglGetProcAddress("eglDestroyImageKHR");
+   gl_image_target_texture =
+       (egl_image_target_texture_fn) eglGetProcAddress("glEGLImageTargetTexture2DOES");
+
+   if ((egl_create_image == NULL) || (egl_destroy_image == NULL) ||
+       (gl_image_target_texture == NULL)) {
+      LOG_ERROR("Required EGLImage extensions are not available.");
+      return FAILURE;
+   }
+
+   for (int eye = 0; eye < 2; eye++) {
+      for (int i = 0; i < NVMM_EGL_CACHE_SIZE; i++) {
+         egl_cache[eye][i].fd = -1;
+         egl_cache[eye][i].image = EGL_NO_IMAGE_KHR;
+      }
+   }
+
+   LOG_INFO("NVMM zero-copy camera path enabled.");
+
+   return SUCCESS;
+}
+
+/* Find or create the EGLImage for this surface's dmabuf. */
+static EGLImageKHR nvmm_get_egl_image(int eye, NvBufSurfaceParams *params)
+{
+   int fd = (int) params->bufferDesc;
+   nvmm_egl_entry *entry = NULL;
+
+   for (int i = 0; i < NVMM_EGL_CACHE_SIZE; i++) {
+      if (egl_cache[eye][i].fd == fd) {
+         return egl_cache[eye][i].image;
+      }
+   }
+
+   /* Cache miss. Evict in round robin order, the pool is recycled in order anyway. */
+   entry = &egl_cache[eye][egl_cache_next[eye]];
+   egl_cache_next[eye] = (egl_cache_next[eye] + 1) % NVMM_EGL_CACHE_SIZE;
+
+   if (entry->image != EGL_NO_IMAGE_KHR) {
+      egl_destroy_image(egl_display, entry->image);
+      entry->image = EGL_NO_IMAGE_KHR;
+      entry->fd = -1;
+   }
+
+   EGLint attribs[] = {
+      EGL_WIDTH, (EGLint) params->width,
+      EGL_HEIGHT, (EGLint) params->height,
+      EGL_LINUX_DRM_FOURCC_EXT, NVMM_DRM_FORMAT_ABGR8888,
+      EGL_DMA_BUF_PLANE0_FD_EXT, fd,
+      EGL_DMA_BUF_PLANE0_OFFSET_EXT, (EGLint) params->planeParams.offset[0],
+      EGL_DMA_BUF_PLANE0_PITCH_EXT, (EGLint) params->planeParams.pitch[0],
+      EGL_NONE
+   };
+
+   entry->image = egl_create_image(egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
+                                   NULL, attribs);
+   if (entry->image == EGL_NO_IMAGE_KHR) {
+      LOG_ERROR("eglCreateImageKHR failed for fd %d: 0x%x", fd, eglGetError());
+      return EGL_NO_IMAGE_KHR;
+   }
+   entry->fd = fd;
+
+   return entry->image;
+}
+
+int nvmm_texture_update(SDL_Texture *texture, int eye, GstMapInfo *map)
+{
+   NvBufSurface *surf = NULL;
+   EGLImageKHR image = EGL_NO_IMAGE_KHR;
+
+   if ((texture == NULL) || (map == NULL) || (map->data == NULL) || (eye < 0) || (eye > 1)) {
+      return FAILURE;
+   }
+
+   surf = (NvBufSurface *) map->data;
+   if (surf->numFilled < 1) {
+      return FAILURE;
+   }
+
+   if (surf->surfaceList[0].layout != NVBUF_LAYOUT_PITCH) {
+      LOG_ERROR("NVMM camera buffers must be pitch linear for EGL import.");
+      return FAILURE;
+   }
+
+   image = nvmm_get_egl_image(eye, &surf->surfaceList[0]);
+   if (image == EGL_NO_IMAGE_KHR) {
+      return FAILURE;
+   }
+
+   /* Anything SDL has queued against this texture must run before we swap its storage. */
+   SDL_RenderFlush(get_sdl_renderer());
+
+   if (SDL_GL_BindTexture(texture, NULL, NULL) != 0) {
+      LOG_ERROR("SDL_GL_BindTexture failed: %s", SDL_GetError());
+      return FAILURE;
+   }
+   gl_image_target_texture(GL_TEXTURE_2D, image);
+   SDL_GL_UnbindTexture(texture);
+
+   return SUCCESS;
+}
+
+int nvmm_copy_to_host(GstMapInfo *map, unsigned char *out, int width, int height)
+{
+   NvBufSurface *surf = NULL;
+   unsigned char *src = NULL;
+   int pitch = 0;
+
+   if ((map == NULL) || (map->data == NULL) || (out == NULL)) {
+      return FAILURE;
+   }
+
+   surf = (NvBufSurface *) map->data;
+   if (NvBufSurfaceMap(surf, 0, 0, NVBUF_MAP_READ) != 0) {
+      LOG_ERROR("NvBufSurfaceMap failed.");
+      return FAILURE;
+   }
+   NvBufSurfaceSyncForCpu(surf, 0, 0);
+
+   src = (unsigned char *) surf->surfaceList[0].mappedAddr.addr[0];
+   pitch = surf->surfaceList[0].planeParams.pitch[0];
+   for (int y = 0; y < height; y++) {
+      memcpy(out + y * width * 4, src + y * pitch, width * 4);
+   }
+
+   NvBufSurfaceUnMap(surf, 0, 0);
+
+   return SUCCESS;
+}
+
+void nvmm_texture_cleanup(void)
+{
+   if (egl_destroy_image == NULL) {
+      return;
+   }
+
+   for (int eye = 0; eye < 2; eye++) {
+      for (int i = 0; i < NVMM_EGL_CACHE_SIZE; i++) {
+         if (egl_cache[eye][i].image != EGL_NO_IMAGE_KHR) {
+            egl_destroy_image(egl_display, egl_cache[eye][i].image);
+            egl_cache[eye][i].image = EGL_NO_IMAGE_KHR;
+            egl_cache[eye][i].fd = -1;
+         }
+      }
+   }
+}
+#else
+int nvmm_texture_init(void)
+{
+   return FAILURE;
+}
+
+int nvmm_texture_update(SDL_Texture *texture, int eye, GstMapInfo *map)
+{
+   return FAILURE;
+}
+
+int nvmm_copy_to_host(GstMapInfo *map, unsigned char *out, int width, int height)
+{
+   return FAILURE;
+}
+
+void nvmm_texture_cleanup(void)
+{
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef NVMM_TEXTURE_H
+#define NVMM_TEXTURE_H
+
+#include <SDL2/SDL.h>
+#include <gst/gst.h>
+
+/* Zero-copy camera path (Jetson only).
+ *
+ * When built with USE_NVMM_ZERO_COPY the camera appsinks deliver buffers that
+ * stay in memory:NVMM. The mapped GstBuffer data is then an NvBufSurface
+ * descriptor rather than pixels. The functions below import the underlying
+ * dmabuf into GL as an EGLImage and attach it to the SDL camera texture, so
+ * the renderer samples the capture buffer directly with no CPU copy or upload.
+ */
+
+/* EGLImages are cached per dmabuf fd. The camera buffer pools are small so
+ * this only needs to cover the pool depth for each eye.
+ */
+#define NVMM_EGL_CACHE_SIZE 8
+
+/**
+ * @brief Prepares the EGL/GL entry points used for zero-copy import.
+ *
+ * Must be called on the render thread after the GL context is current.
+ *
+ * @return SUCCESS if the required extensions are available, FAILURE otherwise.
+ */
+int nvmm_texture_init(void);
+
+/**
+ * @brief Binds the NVMM buffer in the given map to an SDL texture.
+ *
+ * The SDL texture must be RGBA and match the camera input dimensions. The
+ * EGLImage for the buffer is created on first use and reused afterwards.
+ *
+ * @param texture SDL texture to attach the buffer storage to.
+ * @param eye     0 for left, 1 for right. Selects the EGLImage cache.
+ * @param map     Mapped GstBuffer from the NVMM appsink.
+ * @return SUCCESS on success, FAILURE on error.
+ */
+int nvmm_texture_update(SDL_Texture *texture, int eye, GstMapInfo *map);
+
+/**
+ * @brief Copies an NVMM buffer into packed RGBA system memory.
+ *
+ * This is the slow path, used only where the CPU genuinely needs the pixels
+ * (snapshots and screenshots without overlay).
+ *
+ * @param map    Mapped GstBuffer from the NVMM appsink.
+ * @param out    Destination buffer of at least width * height * 4 bytes.
+ * @param width  Frame width in pixels.
+ * @param height Frame height in pixels.
+ * @return SUCCESS on success, FAILURE on error.
+ */
+int nvmm_copy_to_host(GstMapInfo *map, unsigned char *out, int width, int height);
+
+/**
+ * @brief Destroys all cached EGLImages. Call on the render thread at shutdown.
+ */
+void nvmm_texture_cleanup(void);
+
+#endif /* NVMM_TEXTURE_H */
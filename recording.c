@@ -35,10 +35,15 @@
 #include <SDL2/SDL.h>
 #include <unistd.h>
 
+#include "camera_governor.h"
 #include "config_manager.h"
 #include "defines.h"
+#include "gpu_convert.h"
+#include "latency_stats.h"
 #include "logging.h"
 #include "recording.h"
+#include "replay_buffer.h"
+#include "stream_control.h"
 #include "secrets.h"
 #include "utils.h"
 
@@ -48,6 +53,57 @@ static pthread_t vid_out_thread = 0; /* Thread ID for video output */
 static char record_path[PATH_MAX] = "."; /* Path for saving recordings */
 #define NSEC_PER_SEC 1000000000L
 
+static record_frame frame_pool[RECORD_POOL_SIZE];
+static int pool_exhausted_logged = 0;
+
+record_frame *record_frame_acquire(size_t size)
+{
+   for (int i = 0; i < RECORD_POOL_SIZE; i++) {
+      record_frame *frame = &frame_pool[i];
+      int expected = 0;
+
+      if (!atomic_compare_exchange_strong(&frame->refs, &expected, 1)) {
+         continue;
+      }
+
+      /* Nobody else can see a free frame, so it's safe to resize. */
+      if (frame->size != size) {
+         free(frame->pixels);
+         frame->pixels = malloc(size);
+         if (frame->pixels == NULL) {
+            LOG_ERROR("Unable to allocate recording frame.");
+            frame->size = 0;
+            atomic_store(&frame->refs, 0);
+            return NULL;
+         }
+         frame->size = size;
+      }
+
+      pool_exhausted_logged = 0;
+      return frame;
+   }
+
+   if (!pool_exhausted_logged) {
+      LOG_WARNING("Recording frame pool exhausted, dropping frames until the encoder catches up.");
+      pool_exhausted_logged = 1;
+   }
+
+   return NULL;
+}
+
+void record_frame_release(record_frame *frame)
+{
+   if (frame != NULL) {
+      atomic_fetch_sub(&frame->refs, 1);
+   }
+}
+
+/* GstMemory destroy notify. The encoder is done with its view of the frame. */
+static void release_pushed_frame(gpointer data)
+{
+   record_frame_release((record_frame *) data);
+}
+
 /* Rotate triple buffer indices in a circular pattern */
 void rotate_triple_buffer_indices(video_out_data *vod) {
    int temp = vod->buffer_num;
@@ -63,37 +119,184 @@ static video_out_data this_vod = {
    .read_index = 2,
    .write_index = 1,
    .pipeline = NULL,
-   .rgb_out_pixels = {NULL, NULL, NULL},
+   .out_frames = {NULL, NULL, NULL},
    .filename = "",
    .started = 0,
+   .composite = 0,
+   .scale_div = 1,
    .outfile = NULL
 };
 
+void record_publish_frame(record_frame *frame)
+{
+   pthread_mutex_lock(&this_vod.p_mutex);
+   this_vod.out_frames[this_vod.write_index] = frame;
+   record_frame_release(this_vod.out_frames[this_vod.buffer_num]);
+   this_vod.out_frames[this_vod.buffer_num] = NULL;
+   rotate_triple_buffer_indices(&this_vod);
+   this_vod.frame_seq++;
+   pthread_cond_signal(&this_vod.frame_cond);
+   pthread_mutex_unlock(&this_vod.p_mutex);
+}
+
+/* The camera pipeline's record tees, see GST_CAM_PIPELINE_RECORD_TEE. */
+static GstElement *camera_pipeline = NULL;
+static int camera_eyes = 0;
+static pthread_mutex_t camera_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Let camera frames through to the intervideosinks, or stop them. */
+static void record_open_camera_tees(int open)
+{
+   char name[16];
+
+   pthread_mutex_lock(&camera_mutex);
+   for (int i = 0; (camera_pipeline != NULL) && (i < camera_eyes); i++) {
+      snprintf(name, sizeof(name), "recvalve%s", (camera_eyes == 1) ? "" : (i == 0 ? "L" : "R"));
+
+      GstElement *valve = gst_bin_get_by_name(GST_BIN(camera_pipeline), name);
+      if (valve == NULL) {
+         LOG_WARNING("Camera record tee %s not found.", name);
+         continue;
+      }
+      g_object_set(G_OBJECT(valve), "drop", open ? FALSE : TRUE, NULL);
+      gst_object_unref(valve);
+   }
+   pthread_mutex_unlock(&camera_mutex);
+}
+
+void record_set_camera_pipeline(GstElement *pipeline, int eyes)
+{
+   pthread_mutex_lock(&camera_mutex);
+   camera_pipeline = pipeline;
+   camera_eyes = (pipeline != NULL) ? eyes : 0;
+   pthread_mutex_unlock(&camera_mutex);
+
+   /* A rebuilt camera pipeline starts with its valves shut. */
+   if ((pipeline != NULL) && this_vod.started && this_vod.composite) {
+      record_open_camera_tees(1);
+   }
+}
+
+/* Can this output be composed in the encoder? */
+static int record_composite_supported(DestinationType output)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   int have_cameras = 0;
+
+   if (!this_hds->record_composite) {
+      return 0;
+   }
+
+   pthread_mutex_lock(&camera_mutex);
+   have_cameras = (camera_pipeline != NULL);
+   pthread_mutex_unlock(&camera_mutex);
+
+   /* The record + stream pipeline tees raw video already. Keep it on the framebuffer. */
+   if ((output != RECORD) && (output != STREAM)) {
+      return 0;
+   }
+
+   if (!have_cameras || !gpu_convert_available(GPU_CONVERT_UNPREMULTIPLY)) {
+      LOG_WARNING("Encoder side composition unavailable, recording the framebuffer instead.");
+      return 0;
+   }
+
+   return 1;
+}
+
+int record_composite_active(void)
+{
+   return this_vod.composite && (this_vod.output != DISABLED);
+}
+
+void get_record_output_format(DestinationType output, int *width, int *height, int *nv12)
+{
+   /* Composition happens in the encoder, only the overlay is read back. Its
+    * alpha matters, so it stays RGBA. */
+   if (this_vod.composite) {
+      get_window_size(width, height);
+      *width /= RECORD_OVERLAY_SCALE;
+      *height /= RECORD_OVERLAY_SCALE;
+      *nv12 = 0;
+      return;
+   }
+
+   /* A stream only pipeline never needs more than the stream size, so scale
+    * before readback. Anything that records keeps the full window. */
+   if (output == STREAM) {
+      *width = STREAM_WIDTH;
+      *height = STREAM_HEIGHT;
+   } else {
+      get_window_size(width, height);
+      /* The governor's size is latched per recording, like composition. Keep it even. */
+      if (this_vod.scale_div > 1) {
+         *width = (*width / this_vod.scale_div) & ~1;
+         *height = (*height / this_vod.scale_div) & ~1;
+      }
+   }
+
+#ifdef RECORD_GPU_NV12
+   *nv12 = gpu_convert_available(GPU_CONVERT_NV12) && !(*width & 1) && !(*height & 1);
+#else
+   *nv12 = 0;
+#endif
+}
+
+size_t get_record_frame_size(int width, int height, int nv12)
+{
+   return nv12 ? NV12_FRAME_SIZE(width, height) : (size_t) width * RGB_OUT_SIZE * height;
+}
+
+
 /* Initialize the p_mutex in video_out_data at program start */
 void init_video_out_data(void) {
+   pthread_condattr_t cond_attr;
+
    pthread_mutex_init(&this_vod.p_mutex, NULL);
 
+   /* The encoder's timed wait is against CLOCK_MONOTONIC, like the frame timestamps. */
+   pthread_condattr_init(&cond_attr);
+   pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&this_vod.frame_cond, &cond_attr);
+   pthread_condattr_destroy(&cond_attr);
+   this_vod.frame_seq = 0;
+
    /* Initialize triple buffer indices */
    this_vod.buffer_num = 0;
    this_vod.read_index = 2;
    this_vod.write_index = 1;
 
    /* Initialize buffers to NULL */
-   this_vod.rgb_out_pixels[0] = NULL;
-   this_vod.rgb_out_pixels[1] = NULL;
-   this_vod.rgb_out_pixels[2] = NULL;
+   this_vod.out_frames[0] = NULL;
+   this_vod.out_frames[1] = NULL;
+   this_vod.out_frames[2] = NULL;
+
+   for (int i = 0; i < RECORD_POOL_SIZE; i++) {
+      frame_pool[i].pixels = NULL;
+      frame_pool[i].size = 0;
+      atomic_init(&frame_pool[i].refs, 0);
+   }
 }
 
 /* Cleanup the p_mutex in video_out_data at program exit */
 void cleanup_video_out_data(void) {
-   /* Free all buffers */
+   /* Return our frames, then free the pool. The pipeline is gone by now. */
    for (int i = 0; i < 3; i++) {
-      if (this_vod.rgb_out_pixels[i] != NULL) {
-         free(this_vod.rgb_out_pixels[i]);
-         this_vod.rgb_out_pixels[i] = NULL;
+      record_frame_release(this_vod.out_frames[i]);
+      this_vod.out_frames[i] = NULL;
+   }
+
+   for (int i = 0; i < RECORD_POOL_SIZE; i++) {
+      if (atomic_load(&frame_pool[i].refs) != 0) {
+         LOG_WARNING("Recording frame %d still in use at exit.", i);
+         continue;
       }
+      free(frame_pool[i].pixels);
+      frame_pool[i].pixels = NULL;
+      frame_pool[i].size = 0;
    }
 
+   pthread_cond_destroy(&this_vod.frame_cond);
    pthread_mutex_destroy(&this_vod.p_mutex);
 }
 
@@ -175,14 +378,17 @@ void set_recording_state(DestinationType state)
       LOG_INFO("Stopping recording/streaming...");
 
       /* Signal thread to stop */
+      pthread_mutex_lock(&this_vod->p_mutex);
       this_vod->output = DISABLED;
+      pthread_cond_broadcast(&this_vod->frame_cond);
+      pthread_mutex_unlock(&this_vod->p_mutex);
 
       /* Give thread time to exit cleanly */
       pthread_t thread = get_video_out_thread();
       if (thread != 0) {
          struct timespec timeout;
          clock_gettime(CLOCK_REALTIME, &timeout);
-         timeout.tv_sec += 5;  /* 5 second timeout */
+         timeout.tv_sec += RECORD_STOP_TIMEOUT_S;
 
          int result = pthread_timedjoin_np(thread, NULL, &timeout);
          if (result == ETIMEDOUT) {
@@ -197,17 +403,46 @@ void set_recording_state(DestinationType state)
       /* Clear buffers */
       pthread_mutex_lock(&this_vod->p_mutex);
       for (int i = 0; i < 3; i++) {
-         if (this_vod->rgb_out_pixels[i] != NULL) {
-            free(this_vod->rgb_out_pixels[i]);
-            this_vod->rgb_out_pixels[i] = NULL;
-         }
+         record_frame_release(this_vod->out_frames[i]);
+         this_vod->out_frames[i] = NULL;
       }
       pthread_mutex_unlock(&this_vod->p_mutex);
    } else {
+      /* The mode is fixed for the life of a recording so caps and readback agree. */
+      if ((state != DISABLED) && (this_vod->output == DISABLED)) {
+         this_vod->composite = record_composite_supported(state);
+         this_vod->scale_div = camera_governor_record_divisor();
+      }
       this_vod->output = state;
    }
 }
 
+int save_replay(void)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   char filename[PATH_MAX+64];
+   char datetime[16];
+   time_t r_time;
+
+   if ((this_vod.output != REPLAY) || !this_vod.started) {
+      LOG_WARNING("Replay isn't running, nothing to save.");
+      return FAILURE;
+   }
+
+   time(&r_time);
+   strftime(datetime, sizeof(datetime), "%Y%m%d_%H%M%S", localtime(&r_time));
+
+#ifdef MKV_OUT
+   snprintf(filename, sizeof(filename), "%s/ironman-replay-%s.mkv", record_path, datetime);
+#else
+   snprintf(filename, sizeof(filename), "%s/ironman-replay-%s.mp4", record_path, datetime);
+#endif
+
+   LOG_INFO("Saving replay: %s", filename);
+
+   return replay_buffer_save(filename, this_hds->replay_post_seconds);
+}
+
 /**
  * Gets the recording state.
  *
@@ -344,17 +579,28 @@ void *video_next_thread(void *arg) {
    volatile GstClockTime base_time;
    volatile guint64 count = 0;
 
-   struct timespec start_time, end_time;
-   struct timespec ts_delay;
-   long processing_time_ns = 0L, delay_time_ns = 0L;
+   struct timespec ts_wait;
+   unsigned long seen_seq = 0;
+   gint64 clock_offset = 0;         /* Pipeline clock minus CLOCK_MONOTONIC. */
+   guint64 frame_interval = 0;
+   guint64 next_due_ns = 0;         /* Render time the next pushed frame should have. */
+   GstClockTime last_pts = GST_CLOCK_TIME_NONE;
+   int frames_decimated = 0, frames_dropped = 0;
 
    int window_width = 0, window_height = 0;
+   int nv12 = 0;
+   const char *raw_format = NULL;
+   int push_fps = TARGET_RECORDING_FPS;
+   int composite = this_vod.composite;
+   int replaying = 0;
+   int streaming = 0;
 
    time_t last_successful_push = time(NULL);
    int frames_pushed = 0;
 
-   /* Get window dimensions */
-   get_window_size(&window_width, &window_height);
+   /* Get the size and format the render loop reads back at */
+   get_record_output_format(this_vod.output, &window_width, &window_height, &nv12);
+   raw_format = nv12 ? "NV12" : "RGBA";
 
    /* We date code our recordings */
    time(&r_time);
@@ -368,23 +614,52 @@ void *video_next_thread(void *arg) {
 #endif
 
    /* Build pipeline description based on output type */
-   if (this_vod.output == RECORD_STREAM) {
+   if (composite) {
+      hud_display_settings *this_hds = get_hud_display_settings();
+      int eye_w = this_hds->eye_output_width, eye_h = this_hds->eye_output_height;
+      int full_w = 0, full_h = 0;
+      const char *left = (camera_eyes == 1) ? GST_CAM_RECORD_CHANNEL : GST_CAM_RECORD_CHANNEL "L";
+      const char *right = (camera_eyes == 1) ? GST_CAM_RECORD_CHANNEL : GST_CAM_RECORD_CHANNEL "R";
+
+      get_window_size(&full_w, &full_h);
+      push_fps = RECORD_OVERLAY_FPS;
+
+      if (this_vod.output == RECORD) {
+         LOG_INFO("New recording (encoder composition): %s", this_vod.filename);
+         g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_COMP_ENC_PIPELINE,
+                    eye_w, eye_h, eye_w, eye_w, eye_h, full_w, full_h,
+                    RECORD_PULSE_AUDIO_DEVICE, this_vod.filename,
+                    left, TARGET_RECORDING_FPS, right, TARGET_RECORDING_FPS,
+                    window_width, window_height, push_fps);
+      } else {
+         g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_COMP_STR_PIPELINE,
+                    eye_w, eye_h, eye_w, eye_w, eye_h, full_w, full_h,
+                    STREAM_WIDTH, STREAM_HEIGHT, STREAM_BITRATE / STREAM_ENC_BITRATE_UNIT,
+                    RECORD_PULSE_AUDIO_DEVICE, YOUTUBE_STREAM_KEY,
+                    left, TARGET_RECORDING_FPS, right, TARGET_RECORDING_FPS,
+                    window_width, window_height, push_fps);
+      }
+   } else if (this_vod.output == RECORD_STREAM) {
       LOG_INFO("New recording: %s", this_vod.filename);
       g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_ENCSTR_PIPELINE,
-                 window_width, window_height, TARGET_RECORDING_FPS,
-                 STREAM_WIDTH, STREAM_HEIGHT, STREAM_BITRATE,
+                 window_width, window_height, raw_format, TARGET_RECORDING_FPS,
+                 STREAM_WIDTH, STREAM_HEIGHT, STREAM_BITRATE / STREAM_ENC_BITRATE_UNIT,
                  RECORD_PULSE_AUDIO_DEVICE,
                  this_vod.filename,
                  YOUTUBE_STREAM_KEY);
    } else if (this_vod.output == RECORD) {
       LOG_INFO("New recording: %s", this_vod.filename);
       g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_ENC_PIPELINE, window_width, window_height,
-                 TARGET_RECORDING_FPS, RECORD_PULSE_AUDIO_DEVICE, this_vod.filename);
+                 raw_format, TARGET_RECORDING_FPS, RECORD_PULSE_AUDIO_DEVICE, this_vod.filename);
       LOG_INFO("descr: %s", descr);
+   } else if (this_vod.output == REPLAY) {
+      LOG_INFO("Replay buffer running.");
+      g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_REPLAY_PIPELINE, window_width, window_height,
+                 raw_format, TARGET_RECORDING_FPS);
    } else if (this_vod.output == STREAM) {
       g_snprintf(descr, GSTREAMER_PIPELINE_LENGTH, GST_STR_PIPELINE,
-                 window_width, window_height, TARGET_RECORDING_FPS,
-                 STREAM_WIDTH, STREAM_HEIGHT, STREAM_BITRATE,
+                 window_width, window_height, raw_format, TARGET_RECORDING_FPS,
+                 STREAM_WIDTH, STREAM_HEIGHT, STREAM_BITRATE / STREAM_ENC_BITRATE_UNIT,
                  RECORD_PULSE_AUDIO_DEVICE,
                  YOUTUBE_STREAM_KEY);
    } else {
@@ -439,6 +714,23 @@ void *video_next_thread(void *arg) {
       return NULL;
    }
 
+   if (this_vod.output == REPLAY) {
+      hud_display_settings *this_hds = get_hud_display_settings();
+      GstAppSinkCallbacks replay_callbacks = { .new_sample = replay_buffer_on_sample };
+      GstElement *replaySink = gst_bin_get_by_name(GST_BIN(pipeline), "replaySink");
+
+      if (!replaySink) {
+         LOG_ERROR("Failed to find 'replaySink' element in the pipeline.");
+         cleanup_pipeline(pipeline, srcEncode, bus);
+         return NULL;
+      }
+
+      replay_buffer_start((size_t) this_hds->replay_max_mb * 1024 * 1024, this_hds->replay_seconds);
+      gst_app_sink_set_callbacks(GST_APP_SINK(replaySink), &replay_callbacks, NULL, NULL);
+      gst_object_unref(replaySink);
+      replaying = 1;
+   }
+
    need_data_signal_id = g_signal_connect(srcEncode, "need-data", G_CALLBACK(start_feed), NULL);
    enough_data_signal_id = g_signal_connect(srcEncode, "enough-data", G_CALLBACK(stop_feed), NULL);
 
@@ -450,8 +742,7 @@ void *video_next_thread(void *arg) {
 
    /* Set the caps on the source */
    caps = gst_caps_new_simple("video/x-raw",
-      "bpp", G_TYPE_INT, 32,
-      "depth", G_TYPE_INT, 32,
+      "format", G_TYPE_STRING, raw_format,
       "width", G_TYPE_INT, window_width,
       "height", G_TYPE_INT, window_height,
       NULL);
@@ -464,7 +755,7 @@ void *video_next_thread(void *arg) {
       // Basic properties
       "is-live", TRUE,                  // Mark as a live source
       "format", GST_FORMAT_TIME,        // Use time format for buffers
-      "do-timestamp", TRUE,             // Add timestamps to buffers
+      "do-timestamp", FALSE,            // We stamp buffers with their render time
 
       // Stream configuration
       "stream-type", GST_APP_STREAM_TYPE_STREAM, // Continuous stream of buffers
@@ -491,63 +782,114 @@ void *video_next_thread(void *arg) {
       return NULL;
    }
 
+   if (composite) {
+      record_open_camera_tees(1);
+   }
+
+   if ((this_vod.output == STREAM) || (this_vod.output == RECORD_STREAM)) {
+      streaming = (stream_control_start(pipeline, STREAM_WIDTH, STREAM_HEIGHT, TARGET_RECORDING_FPS,
+                                        STREAM_BITRATE) == SUCCESS);
+   }
+
    this_vod.started = 1;
    base_time = gst_element_get_base_time(pipeline);
+   /* The system clock is normally monotonic already, but don't rely on it. */
+   clock_offset = (gint64) gst_clock_get_time(pipeline_clock) - (gint64) latency_now_ns();
+   frame_interval = gst_util_uint64_scale(1, GST_SECOND, push_fps);
    LOG_INFO("Pipeline successfully started");
 
-   while (this_vod.output) {
-      if (feed_me) {
-         clock_gettime(CLOCK_MONOTONIC, &start_time);
+   /* Frames published before the pipeline was up aren't wanted. */
+   pthread_mutex_lock(&this_vod.p_mutex);
+   seen_seq = this_vod.frame_seq;
+   pthread_mutex_unlock(&this_vod.p_mutex);
 
-         pthread_mutex_lock(&this_vod.p_mutex);
+   while (this_vod.output) {
+      record_frame *out_frame = NULL;
+      size_t buffer_size = get_record_frame_size(window_width, window_height, nv12);
+
+      /* Sleep until the render loop publishes. The newest frame is read_index. */
+      pthread_mutex_lock(&this_vod.p_mutex);
+      if ((this_vod.frame_seq == seen_seq) && this_vod.output) {
+         clock_gettime(CLOCK_MONOTONIC, &ts_wait);
+         ts_wait.tv_nsec += RECORD_FRAME_WAIT_MS * 1000000L;
+         if (ts_wait.tv_nsec >= NSEC_PER_SEC) {
+            ts_wait.tv_sec++;
+            ts_wait.tv_nsec -= NSEC_PER_SEC;
+         }
+         pthread_cond_timedwait(&this_vod.frame_cond, &this_vod.p_mutex, &ts_wait);
+      }
+      if (this_vod.frame_seq != seen_seq) {
+         seen_seq = this_vod.frame_seq;
+         out_frame = this_vod.out_frames[this_vod.read_index];
+
+         /* A frame read back after a resize doesn't match our caps, skip it. */
+         if ((out_frame != NULL) && (out_frame->size == buffer_size)) {
+            atomic_fetch_add(&out_frame->refs, 1);
+         } else {
+            out_frame = NULL;
+         }
+      }
+      pthread_mutex_unlock(&this_vod.p_mutex);
 
-         /* Use buffer_num - that's what your triple buffer system provides */
-         if (this_vod.rgb_out_pixels[this_vod.buffer_num] != NULL) {
-            /* CRITICAL FIX: Make a copy for GStreamer so no ownership conflict */
-            size_t buffer_size = window_width * RGB_OUT_SIZE * window_height;
-            void *buffer_copy = malloc(buffer_size);
+      if (out_frame != NULL) {
+         guint64 render_ns = out_frame->timestamp_ns;
+         gint64 clock_ns = (gint64) render_ns + clock_offset;
+         GstClockTime pts = GST_CLOCK_TIME_NONE;
 
-            if (buffer_copy) {
-               memcpy(buffer_copy, this_vod.rgb_out_pixels[this_vod.buffer_num], buffer_size);
+         if (clock_ns > (gint64) base_time) {
+            pts = (GstClockTime) clock_ns - base_time;
+         }
 
-               /* Give the copy to GStreamer - it will free it */
-               buffer = gst_buffer_new_wrapped(buffer_copy, buffer_size);
+         /* Decimate by render time: a frame more than half an interval early
+          * for its slot is skipped. After a long gap, restart the schedule
+          * rather than push a burst to catch up. */
+         if ((next_due_ns != 0) && (render_ns + frame_interval / 2 < next_due_ns)) {
+            frames_decimated++;
+            record_frame_release(out_frame);
+            out_frame = NULL;
+         } else if (!feed_me || !GST_CLOCK_TIME_IS_VALID(pts) ||
+                    (GST_CLOCK_TIME_IS_VALID(last_pts) && (pts <= last_pts))) {
+            frames_dropped++;
+            record_frame_release(out_frame);
+            out_frame = NULL;
+         } else {
+            next_due_ns = (render_ns > next_due_ns + frame_interval) ? render_ns + frame_interval
+                                                                     : next_due_ns + frame_interval;
+         }
 
-               /* Set timestamps */
-               GstClockTime pts = gst_clock_get_time(pipeline_clock) - base_time;
+         if (out_frame != NULL) {
+            /* Wrap the pooled frame instead of copying it. The reference we
+             * took goes to GStreamer and the frame is read only to it, so the
+             * render thread won't reuse it while it's in flight. */
+            buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, out_frame->pixels,
+                                                 buffer_size, 0, buffer_size, out_frame,
+                                                 release_pushed_frame);
 
+            if (buffer) {
                GST_BUFFER_PTS(buffer) = pts;
                GST_BUFFER_DTS(buffer) = pts;  /* Set DTS same as PTS */
-               GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(1, GST_SECOND, TARGET_RECORDING_FPS);
+               GST_BUFFER_DURATION(buffer) = frame_interval;
                GST_BUFFER_OFFSET(buffer) = count++;
+               last_pts = pts;
 
                /* Push buffer */
                ret = gst_app_src_push_buffer(GST_APP_SRC(srcEncode), buffer);
 
                if (ret != GST_FLOW_OK) {
                   LOG_ERROR("GST_FLOW error while pushing buffer: %d", ret);
-                  pthread_mutex_unlock(&this_vod.p_mutex);
                   break;
                }
 
                frames_pushed++;
                last_successful_push = time(NULL);
+            } else {
+               record_frame_release(out_frame);
             }
          }
-
-         pthread_mutex_unlock(&this_vod.p_mutex);
       }
 
-      /* Keep your existing timing code */
-      clock_gettime(CLOCK_MONOTONIC, &end_time);
-      processing_time_ns = (end_time.tv_sec - start_time.tv_sec) * NSEC_PER_SEC +
-                          (end_time.tv_nsec - start_time.tv_nsec);
-      delay_time_ns = TARGET_RECORDING_FRAME_DURATION_US * 1000L - processing_time_ns;
-
-      if (delay_time_ns > 0) {
-         ts_delay.tv_sec = delay_time_ns / NSEC_PER_SEC;
-         ts_delay.tv_nsec = delay_time_ns % NSEC_PER_SEC;
-         clock_nanosleep(CLOCK_MONOTONIC, 0, &ts_delay, NULL);
+      if (streaming) {
+         stream_control_update();
       }
 
       if (time(NULL) - last_successful_push > 30) {
@@ -571,8 +913,14 @@ void *video_next_thread(void *arg) {
       }
    }
 
+   LOG_INFO("Frames pushed: %d, decimated: %d, dropped: %d", frames_pushed, frames_decimated,
+            frames_dropped);
+
    LOG_INFO("Shutting down pipeline");
    this_vod.started = 0;
+   if (composite) {
+      record_open_camera_tees(0);
+   }
    
    // Send EOS and wait for it to propagate
    LOG_INFO("Sending EOS to pipeline");
@@ -588,8 +936,17 @@ void *video_next_thread(void *arg) {
       g_source_remove(bus_watch_id);
    }
 
+   if (streaming) {
+      stream_control_stop();
+   }
+
    cleanup_pipeline(pipeline, srcEncode, bus);
 
+   /* After the pipeline so no more samples arrive. A clip in progress is finished first. */
+   if (replaying) {
+      replay_buffer_stop();
+   }
+
    LOG_INFO("Pipeline shutdown complete");
 
    reset_video_out_thread();
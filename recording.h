@@ -22,6 +22,7 @@
 #ifndef RECORDING_H
 #define RECORDING_H
 
+#include <stdatomic.h>
 #include <glib-2.0/glib.h>
 #include <gst/gst.h>
 #include "defines.h"
@@ -32,24 +33,50 @@ typedef enum {
    DISABLED=0,
    RECORD=1,
    STREAM=2,
-   RECORD_STREAM=4
+   RECORD_STREAM=4,
+   REPLAY=8          /* Encode into the replay ring, see replay_buffer.h. */
 } DestinationType;
 
+/* Readback frames come from a fixed pool so recording doesn't allocate per frame.
+ * A frame is shared by the triple buffer and any GstBuffers wrapping it, and
+ * goes back to the pool when the last of them lets go. The encoder can hold a
+ * few frames at once, so the pool is larger than the triple buffer. */
+#define RECORD_POOL_SIZE 8
+
+/* The encoder thread sleeps until a frame is published. It wakes at least
+ * this often to notice state changes and stalls. */
+#define RECORD_FRAME_WAIT_MS 100
+
+/* How long stopping waits for the encoder thread before cancelling it. This
+ * covers finishing a replay clip, so it must exceed REPLAY_EOS_TIMEOUT_S. */
+#define RECORD_STOP_TIMEOUT_S 10
+
+typedef struct {
+   void *pixels;
+   size_t size;
+   atomic_int refs;     /* 0 means free in the pool. */
+   unsigned long timestamp_ns;   /* Render time, CLOCK_MONOTONIC. Becomes the buffer PTS. */
+} record_frame;
+
 typedef struct _video_out_data {
    DestinationType output;
    pthread_mutex_t p_mutex;
+   pthread_cond_t frame_cond;   /* Signalled under p_mutex when a frame is published. */
+   unsigned long frame_seq;     /* Frames published, so the encoder never pushes one twice. */
 
    /* Triple buffer indices */
    int buffer_num;      /* Index for the buffer currently being used */
    int read_index;      /* Index for the buffer being read from */
    int write_index;     /* Index for the buffer being written to */
 
-   void *rgb_out_pixels[3];
+   record_frame *out_frames[3];
 
    GstElement *pipeline;
 
    char filename[PATH_MAX+64];
    int started;   /* Flag indicating whether the video output pipeline is active and ready. */
+   int composite; /* Cameras are composed in the encoder, only the HUD overlay is read back. */
+   int scale_div; /* Recording size divisor from the governor, fixed per recording. */
    FILE *outfile;
 } video_out_data;
 
@@ -64,6 +91,15 @@ typedef struct _video_out_data {
  */
 void set_recording_state(DestinationType state);
 
+/**
+ * @brief Saves the instant replay ring to a new file in the recording path.
+ *
+ * The clip holds what's in the ring plus the next "Replay Post Seconds" of video.
+ *
+ * @return SUCCESS if a clip was started, FAILURE if replay isn't running.
+ */
+int save_replay(void);
+
 /* Function to get the recording state */
 DestinationType get_recording_state(void);
 
@@ -107,4 +143,64 @@ void cleanup_video_out_data(void);
  
 void rotate_triple_buffer_indices(video_out_data *vod);
 
+/**
+ * @brief Size and pixel format frames are read back at for an output mode.
+ *
+ * The render loop and the pipeline both use this, so the appsrc caps always
+ * match what's read back.
+ *
+ * @param output Recording/streaming mode.
+ * @param width  Set to the frame width.
+ * @param height Set to the frame height.
+ * @param nv12   Set to 1 for NV12, 0 for RGBA.
+ */
+void get_record_output_format(DestinationType output, int *width, int *height, int *nv12);
+
+/**
+ * @brief Registers the camera pipeline so composite recordings can open its record tees.
+ *
+ * Only pass a pipeline built with record tees. Pass NULL before the pipeline is freed.
+ *
+ * @param pipeline The camera pipeline, or NULL.
+ * @param eyes     Number of cameras in it.
+ */
+void record_set_camera_pipeline(GstElement *pipeline, int eyes);
+
+/**
+ * @brief Returns 1 if the current recording composes the cameras in the encoder.
+ *
+ * The render loop then only needs to read back the HUD overlay, at
+ * RECORD_OVERLAY_FPS and 1 / RECORD_OVERLAY_SCALE of the window size.
+ */
+int record_composite_active(void);
+
+/**
+ * @brief Bytes in a read back frame of the given size and format.
+ */
+size_t get_record_frame_size(int width, int height, int nv12);
+
+/**
+ * @brief Takes a free frame from the recording pool for the next readback.
+ *
+ * Render thread only. Free frames of the wrong size are reallocated, so a
+ * window resize costs one allocation per pool frame rather than one per frame.
+ *
+ * @param size Bytes needed for the frame.
+ * @return A frame holding one reference, or NULL if every frame is in use.
+ */
+record_frame *record_frame_acquire(size_t size);
+
+/**
+ * @brief Hands a finished frame to the encoder thread and wakes it.
+ *
+ * Render thread only. Takes over the caller's reference; the frame it
+ * replaces is released.
+ */
+void record_publish_frame(record_frame *frame);
+
+/**
+ * @brief Drops one reference to a pooled frame. Safe from any thread and with NULL.
+ */
+void record_frame_release(record_frame *frame);
+
 #endif /* RECORDING_H */
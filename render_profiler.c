@@ -0,0 +1,251 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "latency_stats.h"
+#include "mirage.h"
+#include "render_profiler.h"
+
+static atomic_int profiling = 0;
+static atomic_uint enable_generation = 0;   /* Bumped on every enable. */
+
+/* Render thread only from here down. */
+static unsigned int window_generation = 0;
+static unsigned long window_start_ns = 0;
+static unsigned long window_frames = 0;
+static char top_text[MAX_TEXT_LENGTH] = "Profiler off";
+
+void render_profiler_set_enabled(int enabled)
+{
+   if (enabled && !atomic_exchange(&profiling, 1)) {
+      atomic_fetch_add(&enable_generation, 1);
+   } else if (!enabled) {
+      atomic_store(&profiling, 0);
+   }
+}
+
+int render_profiler_active(void)
+{
+   return atomic_load_explicit(&profiling, memory_order_relaxed);
+}
+
+void render_profiler_frame(void)
+{
+   if (render_profiler_active()) {
+      window_frames++;
+   }
+}
+
+void render_profiler_record(element *curr_element, unsigned long start_ns)
+{
+   unsigned long duration = latency_now_ns() - start_ns;
+
+   curr_element->profile_ns += duration;
+   curr_element->profile_calls++;
+   if (duration > curr_element->profile_max_ns) {
+      curr_element->profile_max_ns = duration;
+   }
+}
+
+/* Specials are grouped by what they draw, everything else by type. */
+static const char *element_kind(const element *curr_element)
+{
+   switch (curr_element->type) {
+   case STATIC:
+      return "static";
+   case ANIMATED:
+   case ANIMATED_DYNAMIC:
+      return "animated";
+   case TEXT:
+      return "text";
+   case SPECIAL:
+      return ((curr_element->special_name != NULL) && (curr_element->special_name[0] != '\0')) ?
+             curr_element->special_name : "special";
+   default:
+      return "other";
+   }
+}
+
+/* Names come from the config, so quote them for JSON. Truncates on a
+ * character boundary if the escaped name doesn't fit. */
+static const char *json_escape(const char *in, char *out, size_t size)
+{
+   size_t o = 0;
+
+   for (; *in != '\0'; in++) {
+      unsigned char c = (unsigned char) *in;
+      char seq[7];
+      size_t n = 0;
+
+      if ((c == '"') || (c == '\\')) {
+         seq[0] = '\\';
+         seq[1] = (char) c;
+         n = 2;
+      } else if (c < 0x20) {
+         n = (size_t) snprintf(seq, sizeof(seq), "\\u%04x", c);
+      } else {
+         seq[0] = (char) c;
+         n = 1;
+      }
+
+      if (o + n >= size) {
+         break;
+      }
+      memcpy(out + o, seq, n);
+      o += n;
+   }
+   out[o] = '\0';
+
+   return out;
+}
+
+static void reset_counters(void)
+{
+   for (element *curr_element = get_first_element(); curr_element != NULL;
+        curr_element = curr_element->next) {
+      curr_element->profile_ns = 0;
+      curr_element->profile_max_ns = 0;
+      curr_element->profile_calls = 0;
+   }
+   window_frames = 0;
+   window_start_ns = latency_now_ns();
+}
+
+int render_profiler_report_json(char *buffer, size_t size)
+{
+   element *top[RENDER_PROFILE_TOP] = { NULL };
+   const char *kind_names[RENDER_PROFILE_KINDS];
+   unsigned long kind_ns[RENDER_PROFILE_KINDS];
+   int kinds = 0;
+   unsigned int generation = atomic_load(&enable_generation);
+   unsigned long window_ms = 0;
+   unsigned long frames = 0;
+   int len = 0, top_len = 0;
+
+   if (!render_profiler_active()) {
+      snprintf(top_text, sizeof(top_text), "Profiler off");
+      return 0;
+   }
+
+   if ((generation != window_generation) || (window_start_ns == 0)) {
+      window_generation = generation;
+      reset_counters();
+      snprintf(top_text, sizeof(top_text), "Profiling...");
+      return 0;
+   }
+
+   window_ms = (latency_now_ns() - window_start_ns) / 1000000UL;
+   frames = window_frames > 0 ? window_frames : 1;
+
+   /* Keep the costliest few in order, and total up each kind. */
+   for (element *curr_element = get_first_element(); curr_element != NULL;
+        curr_element = curr_element->next) {
+      const char *kind = NULL;
+      int k = 0;
+
+      if (curr_element->profile_calls == 0) {
+         continue;
+      }
+
+      for (int i = 0; i < RENDER_PROFILE_TOP; i++) {
+         if ((top[i] == NULL) || (curr_element->profile_ns > top[i]->profile_ns)) {
+            memmove(&top[i + 1], &top[i], (RENDER_PROFILE_TOP - i - 1) * sizeof(top[0]));
+            top[i] = curr_element;
+            break;
+         }
+      }
+
+      kind = element_kind(curr_element);
+      for (k = 0; k < kinds; k++) {
+         if (strcmp(kind_names[k], kind) == 0) {
+            break;
+         }
+      }
+      if (k == kinds) {
+         if (kinds == RENDER_PROFILE_KINDS) {
+            continue;
+         }
+         kind_names[k] = kind;
+         kind_ns[k] = 0;
+         kinds++;
+      }
+      kind_ns[k] += curr_element->profile_ns;
+   }
+
+   len = snprintf(buffer, size, "{ \"device\": \"perf\", \"window_ms\": %lu, \"frames\": %lu, "
+                  "\"elements\": [", window_ms, window_frames);
+
+   for (int i = 0; (i < RENDER_PROFILE_TOP) && (top[i] != NULL); i++) {
+      element *e = top[i];
+      double per_frame_us = (double) e->profile_ns / frames / 1000.0;
+      char name[RENDER_PROFILE_NAME_LENGTH];
+      char kind[RENDER_PROFILE_NAME_LENGTH];
+
+      if (len < (int) size) {
+         len += snprintf(buffer + len, size - len,
+                         "%s { \"name\": \"%s\", \"kind\": \"%s\", \"calls\": %u, "
+                         "\"per_frame_us\": %.1f, \"avg_us\": %.1f, \"max_us\": %.1f }",
+                         i == 0 ? "" : ",", json_escape(e->name, name, sizeof(name)),
+                         json_escape(element_kind(e), kind, sizeof(kind)), e->profile_calls,
+                         per_frame_us, (double) e->profile_ns / e->profile_calls / 1000.0,
+                         (double) e->profile_max_ns / 1000.0);
+      }
+
+      if (top_len < (int) sizeof(top_text)) {
+         top_len += snprintf(top_text + top_len, sizeof(top_text) - top_len, "%s%s %.0f us",
+                             i == 0 ? "" : "\n", e->name, per_frame_us);
+      }
+   }
+   if (top[0] == NULL) {
+      snprintf(top_text, sizeof(top_text), "Nothing drawn");
+   }
+
+   if (len < (int) size) {
+      len += snprintf(buffer + len, size - len, " ], \"kinds_per_frame_us\": {");
+   }
+   for (int k = 0; (k < kinds) && (len < (int) size); k++) {
+      char kind[RENDER_PROFILE_NAME_LENGTH];
+
+      len += snprintf(buffer + len, size - len, "%s \"%s\": %.1f", k == 0 ? "" : ",",
+                      json_escape(kind_names[k], kind, sizeof(kind)),
+                      (double) kind_ns[k] / frames / 1000.0);
+   }
+   if (len < (int) size) {
+      len += snprintf(buffer + len, size - len, " } }");
+   }
+
+   reset_counters();
+
+   return len;
+}
+
+const char *render_profiler_top_text(void)
+{
+   if (!render_profiler_active()) {
+      return "Profiler off";
+   }
+
+   return top_text;
+}
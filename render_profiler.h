@@ -0,0 +1,89 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef RENDER_PROFILER_H
+#define RENDER_PROFILER_H
+
+#include <stddef.h>
+
+#include "config_parser.h"
+
+/* Per-element render timing.
+ *
+ * While enabled, render_element() times every element it draws and adds the
+ * result to counters kept on the element itself, so there is no lookup or
+ * locking on the render path. Once per window the main loop closes the
+ * window, picks the costliest elements, publishes them on MQTT_PERF_TOPIC
+ * and refreshes the text for the *PERF_TOP* token. Disabled, the cost is one
+ * relaxed atomic load per element.
+ *
+ * Toggle at runtime with { "device": "perf", "action": "enable" } or "disable".
+ * That also shows or hides elements named "perf".
+ */
+
+#define MQTT_PERF_TOPIC             "perf"
+#define RENDER_PROFILE_INTERVAL_MS  1000   /* Length of a profiling window. */
+#define RENDER_PROFILE_TOP          5      /* Elements listed in reports and *PERF_TOP*. */
+#define RENDER_PROFILE_KINDS        16     /* Element kinds summed separately in reports. */
+#define RENDER_PROFILE_REPORT_LENGTH 2048
+#define RENDER_PROFILE_NAME_LENGTH  128    /* Escaped element or kind name in a report. */
+
+/**
+ * @brief Turns profiling on or off. Safe from any thread.
+ */
+void render_profiler_set_enabled(int enabled);
+
+/**
+ * @brief Returns 1 while profiling is on.
+ */
+int render_profiler_active(void);
+
+/**
+ * @brief Counts a rendered HUD frame. Render thread only.
+ */
+void render_profiler_frame(void);
+
+/**
+ * @brief Adds one render of an element to its counters. Render thread only.
+ *
+ * @param curr_element The element that was drawn.
+ * @param start_ns     latency_now_ns() from before it was drawn.
+ */
+void render_profiler_record(element *curr_element, unsigned long start_ns);
+
+/**
+ * @brief Closes the window, refreshes the *PERF_TOP* text and formats a JSON report.
+ *
+ * Render thread only. The first window after profiling is enabled is
+ * discarded, since it may hold counts from before it was last disabled.
+ *
+ * @param buffer Destination buffer.
+ * @param size   Size of the destination buffer.
+ * @return Number of characters written, or 0 if there's nothing to report.
+ */
+int render_profiler_report_json(char *buffer, size_t size);
+
+/**
+ * @brief Returns the text for the *PERF_TOP* token. Render thread only.
+ */
+const char *render_profiler_top_text(void);
+
+#endif /* RENDER_PROFILER_H */
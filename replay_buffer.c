@@ -0,0 +1,390 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#define _GNU_SOURCE
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <gst/app/gstappsrc.h>
+
+#include "defines.h"
+#include "logging.h"
+#include "replay_buffer.h"
+
+typedef struct {
+   GstBuffer *buffer;
+   unsigned long seq;         /* Never reused, lets the writer spot what it's missed. */
+} replay_unit;
+
+typedef struct {
+   replay_unit units[REPLAY_MAX_UNITS];
+   int head;                  /* Oldest unit. */
+   int count;
+   unsigned long next_seq;
+   size_t bytes;
+
+   size_t max_bytes;
+   GstClockTime max_duration;
+   int open;
+
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;       /* Signalled on new units and on close. */
+} replay_ring;
+
+typedef struct {
+   char filename[PATH_MAX+64];
+   GstClockTime end_pts;      /* Trigger plus the post roll. NONE if the ring had no PTS. */
+   unsigned long end_seq;     /* Last unit to write when there's no end_pts. */
+} replay_clip;
+
+static replay_ring ring = {
+   .mutex = PTHREAD_MUTEX_INITIALIZER,
+   .cond = PTHREAD_COND_INITIALIZER
+};
+
+static pthread_t writer_thread;
+static int writer_running = 0;      /* Under ring.mutex. */
+static replay_clip clip;
+
+static replay_unit *ring_unit(int i)
+{
+   return &ring.units[(ring.head + i) % REPLAY_MAX_UNITS];
+}
+
+static int unit_is_keyframe(const replay_unit *unit)
+{
+   return !GST_BUFFER_FLAG_IS_SET(unit->buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+}
+
+/* Caller holds the mutex. */
+static void ring_drop_oldest(void)
+{
+   replay_unit *unit = ring_unit(0);
+
+   ring.bytes -= gst_buffer_get_size(unit->buffer);
+   gst_buffer_unref(unit->buffer);
+   unit->buffer = NULL;
+   ring.head = (ring.head + 1) % REPLAY_MAX_UNITS;
+   ring.count--;
+}
+
+/* Caller holds the mutex. */
+static void ring_clear(void)
+{
+   while (ring.count > 0) {
+      ring_drop_oldest();
+   }
+   ring.head = 0;
+   ring.bytes = 0;
+}
+
+/* Caller holds the mutex. Trims to the caps, then on to the next keyframe. */
+static void ring_trim(void)
+{
+   GstClockTime newest = GST_CLOCK_TIME_NONE;
+   int over = 0;
+
+   if (ring.count == 0) {
+      return;
+   }
+   newest = GST_BUFFER_PTS(ring_unit(ring.count - 1)->buffer);
+
+   do {
+      GstClockTime oldest = GST_BUFFER_PTS(ring_unit(0)->buffer);
+
+      over = (ring.bytes > ring.max_bytes) || (ring.count >= REPLAY_MAX_UNITS) ||
+             (GST_CLOCK_TIME_IS_VALID(newest) && GST_CLOCK_TIME_IS_VALID(oldest) &&
+              (newest - oldest > ring.max_duration));
+      if (!over) {
+         break;
+      }
+
+      /* Drop a whole GOP so what's left still decodes from the start. */
+      ring_drop_oldest();
+      while ((ring.count > 0) && !unit_is_keyframe(ring_unit(0))) {
+         ring_drop_oldest();
+      }
+   } while (ring.count > 0);
+}
+
+void replay_buffer_start(size_t max_bytes, unsigned int max_seconds)
+{
+   pthread_mutex_lock(&ring.mutex);
+   ring_clear();
+   ring.max_bytes = max_bytes;
+   ring.max_duration = (GstClockTime) max_seconds * GST_SECOND;
+   ring.open = 1;
+   pthread_mutex_unlock(&ring.mutex);
+
+   LOG_INFO("Replay buffer started: %u seconds, %zu MB max.", max_seconds,
+            max_bytes / (1024 * 1024));
+}
+
+void replay_buffer_stop(void)
+{
+   int join = 0;
+
+   pthread_mutex_lock(&ring.mutex);
+   ring.open = 0;
+   pthread_cond_broadcast(&ring.cond);
+   /* Claim the join here so replay_buffer_save() can't also try. */
+   join = writer_running;
+   writer_running = 0;
+   pthread_mutex_unlock(&ring.mutex);
+
+   /* The writer drains what it still needs from the ring, so clear it after. */
+   if (join) {
+      pthread_join(writer_thread, NULL);
+   }
+
+   pthread_mutex_lock(&ring.mutex);
+   ring_clear();
+   pthread_mutex_unlock(&ring.mutex);
+}
+
+GstFlowReturn replay_buffer_on_sample(GstAppSink *sink, gpointer data)
+{
+   GstSample *sample = gst_app_sink_pull_sample(sink);
+   GstBuffer *buffer = NULL;
+
+   if (sample == NULL) {
+      return GST_FLOW_EOS;
+   }
+
+   buffer = gst_sample_get_buffer(sample);
+
+   pthread_mutex_lock(&ring.mutex);
+   /* An empty ring only takes a keyframe, anything else couldn't be decoded. */
+   if (ring.open && (buffer != NULL) &&
+       ((ring.count > 0) || !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))) {
+      replay_unit *unit = NULL;
+
+      if (ring.count == REPLAY_MAX_UNITS) {
+         ring_drop_oldest();
+      }
+      unit = ring_unit(ring.count);
+      unit->buffer = gst_buffer_ref(buffer);
+      unit->seq = ring.next_seq++;
+      ring.count++;
+      ring.bytes += gst_buffer_get_size(buffer);
+
+      ring_trim();
+      pthread_cond_broadcast(&ring.cond);
+   }
+   pthread_mutex_unlock(&ring.mutex);
+
+   gst_sample_unref(sample);
+
+   return GST_FLOW_OK;
+}
+
+/* Push one unit to the clip, rebased so the clip starts at 0. */
+static GstFlowReturn writer_push(GstElement *src, GstBuffer *buffer, GstClockTime base)
+{
+   GstBuffer *out = gst_buffer_copy(buffer);   /* Metadata only, the data is shared. */
+
+   gst_buffer_unref(buffer);
+   if (out == NULL) {
+      return GST_FLOW_ERROR;
+   }
+
+   if (GST_BUFFER_PTS_IS_VALID(out)) {
+      GST_BUFFER_PTS(out) = (GST_BUFFER_PTS(out) >= base) ? GST_BUFFER_PTS(out) - base : 0;
+   }
+   if (GST_BUFFER_DTS_IS_VALID(out)) {
+      GST_BUFFER_DTS(out) = (GST_BUFFER_DTS(out) >= base) ? GST_BUFFER_DTS(out) - base
+                                                          : GST_CLOCK_TIME_NONE;
+   }
+
+   return gst_app_src_push_buffer(GST_APP_SRC(src), out);
+}
+
+static void *replay_writer(void *arg)
+{
+   gchar descr[GSTREAMER_PIPELINE_LENGTH];
+   GstElement *pipeline = NULL, *src = NULL;
+   GstBus *bus = NULL;
+   GstMessage *msg = NULL;
+   GError *error = NULL;
+   GstCaps *caps = NULL;
+   GstClockTime base = GST_CLOCK_TIME_NONE;
+   unsigned long next_seq = 0;
+   unsigned long written = 0;
+   int done = 0;
+
+   g_snprintf(descr, sizeof(descr), GST_REPLAY_WRITE_PIPELINE, clip.filename);
+   pipeline = gst_parse_launch(descr, &error);
+   if (error != NULL) {
+      LOG_ERROR("Failed to create replay writer: %s", error->message);
+      g_error_free(error);
+      if (pipeline != NULL) {
+         gst_object_unref(pipeline);
+      }
+      return NULL;
+   }
+
+   src = gst_bin_get_by_name(GST_BIN(pipeline), "replaySrc");
+   if (src == NULL) {
+      LOG_ERROR("Failed to find 'replaySrc' in the replay writer.");
+      gst_object_unref(pipeline);
+      return NULL;
+   }
+
+   caps = gst_caps_new_simple("video/x-h264",
+      "stream-format", G_TYPE_STRING, "byte-stream",
+      "alignment", G_TYPE_STRING, "au",
+      NULL);
+   gst_app_src_set_caps(GST_APP_SRC(src), caps);
+   gst_caps_unref(caps);
+
+   /* Not live: the whole ring goes in as fast as the muxer takes it. */
+   g_object_set(G_OBJECT(src),
+      "format", GST_FORMAT_TIME,
+      "is-live", FALSE,
+      "block", TRUE,
+      NULL);
+
+   gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+   pthread_mutex_lock(&ring.mutex);
+   if (ring.count > 0) {
+      next_seq = ring_unit(0)->seq;
+      base = GST_BUFFER_PTS(ring_unit(0)->buffer);
+   } else {
+      done = 1;
+   }
+
+   while (!done) {
+      GstBuffer *batch[64];
+      int batch_len = 0;
+      int first = 0;
+
+      while (ring.open && ((ring.count == 0) || (ring_unit(ring.count - 1)->seq < next_seq))) {
+         pthread_cond_wait(&ring.cond, &ring.mutex);
+      }
+      /* Once closed the ring won't grow, so finish with whatever is left of it. */
+      if ((ring.count == 0) || (ring_unit(ring.count - 1)->seq < next_seq)) {
+         break;
+      }
+
+      /* Fell behind the eviction. Not expected, the ring holds far more than a clip needs. */
+      if (ring_unit(0)->seq > next_seq) {
+         LOG_WARNING("Replay writer lost %lu access units.", ring_unit(0)->seq - next_seq);
+         next_seq = ring_unit(0)->seq;
+      }
+      first = (int) (next_seq - ring_unit(0)->seq);
+
+      for (int i = first; (i < ring.count) && (batch_len < 64); i++) {
+         replay_unit *unit = ring_unit(i);
+
+         if ((unit->seq > clip.end_seq) ||
+             (GST_CLOCK_TIME_IS_VALID(clip.end_pts) && GST_BUFFER_PTS_IS_VALID(unit->buffer) &&
+              (GST_BUFFER_PTS(unit->buffer) > clip.end_pts))) {
+            done = 1;
+            break;
+         }
+         batch[batch_len++] = gst_buffer_ref(unit->buffer);
+         next_seq = unit->seq + 1;
+      }
+
+      /* Push without the lock, the encoder shouldn't wait on the muxer. */
+      pthread_mutex_unlock(&ring.mutex);
+      for (int i = 0; i < batch_len; i++) {
+         if (writer_push(src, batch[i], base) != GST_FLOW_OK) {
+            for (int j = i + 1; j < batch_len; j++) {
+               gst_buffer_unref(batch[j]);
+            }
+            done = 1;
+            break;
+         }
+         written++;
+      }
+      pthread_mutex_lock(&ring.mutex);
+   }
+   pthread_mutex_unlock(&ring.mutex);
+
+   gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+   bus = gst_element_get_bus(pipeline);
+   msg = gst_bus_timed_pop_filtered(bus, REPLAY_EOS_TIMEOUT_S * GST_SECOND,
+                                    GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+   if ((msg == NULL) || (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS)) {
+      LOG_ERROR("Replay clip %s didn't finalize cleanly.", clip.filename);
+   } else {
+      LOG_INFO("Replay saved: %s (%lu access units)", clip.filename, written);
+   }
+   if (msg != NULL) {
+      gst_message_unref(msg);
+   }
+   gst_object_unref(bus);
+
+   gst_element_set_state(pipeline, GST_STATE_NULL);
+   gst_object_unref(src);
+   gst_object_unref(pipeline);
+
+   return NULL;
+}
+
+int replay_buffer_save(const char *filename, unsigned int post_seconds)
+{
+   int result = FAILURE;
+
+   pthread_mutex_lock(&ring.mutex);
+
+   /* A finished writer still has to be joined before the next one. */
+   if (writer_running && (pthread_tryjoin_np(writer_thread, NULL) == 0)) {
+      writer_running = 0;
+   }
+
+   if (!ring.open || (ring.count == 0)) {
+      LOG_WARNING("Nothing in the replay buffer to save.");
+   } else if (writer_running) {
+      LOG_WARNING("A replay clip is already being written.");
+   } else {
+      snprintf(clip.filename, sizeof(clip.filename), "%s", filename);
+
+      /* The post roll counts from the newest unit now, not from when the
+       * writer gets going. Without a timestamp, stop at that unit. */
+      clip.end_pts = GST_CLOCK_TIME_NONE;
+      clip.end_seq = ring_unit(ring.count - 1)->seq;
+      for (int i = ring.count - 1; i >= 0; i--) {
+         GstBuffer *buffer = ring_unit(i)->buffer;
+
+         if (GST_BUFFER_PTS_IS_VALID(buffer)) {
+            clip.end_pts = GST_BUFFER_PTS(buffer) + (GstClockTime) post_seconds * GST_SECOND;
+            clip.end_seq = ULONG_MAX;
+            break;
+         }
+      }
+
+      if (pthread_create(&writer_thread, NULL, replay_writer, NULL) != 0) {
+         LOG_ERROR("Unable to start the replay writer.");
+      } else {
+         writer_running = 1;
+         result = SUCCESS;
+      }
+   }
+
+   pthread_mutex_unlock(&ring.mutex);
+
+   return result;
+}
@@ -0,0 +1,75 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+/* Instant replay.
+ *
+ * In REPLAY mode the recording pipeline encodes as usual but ends in an
+ * appsink instead of a muxer. Every H.264 access unit lands in a ring held in
+ * memory, capped by bytes and by duration. Eviction drops whole GOPs, so the
+ * ring always starts at a keyframe. Saving starts a writer thread with its own
+ * small mux pipeline. It writes the ring, follows new access units for a few
+ * more seconds, then finalizes the file. The encoder is never rebuilt per clip.
+ */
+
+#define REPLAY_MAX_UNITS        8192   /* Access units kept at most, whatever the byte cap. */
+#define REPLAY_EOS_TIMEOUT_S    3      /* How long a clip gets to finalize. Keep well under
+                                        * RECORD_STOP_TIMEOUT_S, stopping waits for it. */
+
+/**
+ * @brief Empties the ring and opens it for a new encoder session.
+ *
+ * @param max_bytes   Byte cap for the encoded data held.
+ * @param max_seconds Duration cap.
+ */
+void replay_buffer_start(size_t max_bytes, unsigned int max_seconds);
+
+/**
+ * @brief Closes the ring and drops what it holds.
+ *
+ * A clip being written is finished with what the ring still holds up to its
+ * end, and this waits for it, so the file is always complete.
+ */
+void replay_buffer_stop(void);
+
+/**
+ * @brief appsink new-sample callback. Adds the access unit to the ring.
+ */
+GstFlowReturn replay_buffer_on_sample(GstAppSink *sink, gpointer data);
+
+/**
+ * @brief Saves the ring plus the next post_seconds of video to a file.
+ *
+ * Safe from any thread. Returns immediately, the clip is written in the background.
+ *
+ * @param filename     Output file. With MKV_OUT this should be .mkv.
+ * @param post_seconds Seconds of video after the trigger to include.
+ * @return SUCCESS if the clip was started, FAILURE if the ring is empty, closed,
+ *         or a clip is already being written.
+ */
+int replay_buffer_save(const char *filename, unsigned int post_seconds);
+
+#endif /* REPLAY_BUFFER_H */
@@ -31,6 +31,8 @@
 
 #include "screenshot.h"
 #include "config_manager.h"
+#include "gpu_convert.h"
+#include "hud_manager.h"
 #include "logging.h"
 #include "image_utils.h"
 #include "mirage.h"
@@ -48,12 +50,58 @@ static bool g_pboInitialized = false;
 static int g_lastSuccessfulPboIndex = -1;
 static bool g_hasValidLastFrame = false;
 
-/* Screenshot request handling */
+/* Row flip scratch for synchronous reads, reused across frames. */
+static GLubyte *g_readScratch = NULL;
+static size_t g_readScratchSize = 0;
+
+/* Fenced readback ring for recording. */
+typedef struct {
+   GLuint pbo;
+   GLsizeiptr size;    /* Allocated PBO storage. */
+   GLsync fence;       /* Non-zero while a readback is in flight. */
+   size_t bytes;       /* Size of the frame in flight. */
+   unsigned long timestamp_ns;   /* When the frame was rendered. */
+} readback_slot;
+
+static readback_slot g_ring[READBACK_RING_DEPTH];
+static int g_ringHead = 0;        /* Next slot to submit into. */
+static int g_ringTail = 0;        /* Oldest in-flight slot. */
+static int g_ringPending = 0;
+static bool g_ringInitialized = false;
+static GLuint g_flipFbo = 0;
+static GLuint g_flipTexture = 0;
+static int g_flipWidth = 0;
+static int g_flipHeight = 0;
+
+/* Screenshot request handling. Any thread queues a request, the render thread
+ * captures the pixels and the encoder thread compresses and saves them. */
+typedef struct {
+   int with_overlay;
+   int full_resolution;
+   char path[PATH_MAX+31];    /* Empty for an auto-generated filename. */
+   screenshot_t source;
+} screenshot_request;
+
+typedef struct {
+   unsigned char *pixels;     /* Owned by the job. */
+   ImageProcessParams params;
+   char filename[PATH_MAX+31];
+   screenshot_t source;
+} screenshot_job;
+
 static pthread_mutex_t g_screenshot_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int g_screenshot_requested = 0;
-static char g_screenshot_path[PATH_MAX+29] = "";
-static int g_screenshot_with_overlay = 0;
-static screenshot_t g_screenshot_source = SCREENSHOT_MANUAL;
+static screenshot_request g_requests[SCREENSHOT_QUEUE_DEPTH];
+static int g_requestHead = 0;
+static int g_requestCount = 0;
+
+static pthread_mutex_t g_jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_jobCond = PTHREAD_COND_INITIALIZER;
+static screenshot_job g_jobs[SCREENSHOT_QUEUE_DEPTH];
+static int g_jobHead = 0;
+static int g_jobCount = 0;
+static pthread_t g_encoderThread;
+static bool g_encoderRunning = false;
+static bool g_encoderQuit = false;
 
 /* Recording path where screenshots are saved */
 static char record_path[PATH_MAX] = ".";
@@ -75,6 +123,9 @@ void init_pbo_system(void) {
       cleanup_pbo_system();
    }
 
+   /* NV12 is still gated on RECORD_GPU_NV12, the unpremultiply pass is always wanted. */
+   gpu_convert_init();
+
    glGenBuffers(3, g_pboIds);
 
    int window_width = 0, window_height = 0;
@@ -118,6 +169,27 @@ void cleanup_pbo_system(void) {
     }
     g_lastSuccessfulPboIndex = -1;
     g_hasValidLastFrame = false;
+
+    if (g_ringInitialized) {
+        readback_ring_reset();
+        for (int i = 0; i < READBACK_RING_DEPTH; i++) {
+            glDeleteBuffers(1, &g_ring[i].pbo);
+            g_ring[i].pbo = 0;
+            g_ring[i].size = 0;
+        }
+        if (g_flipFbo != 0) {
+            glDeleteFramebuffers(1, &g_flipFbo);
+            glDeleteTextures(1, &g_flipTexture);
+            g_flipFbo = g_flipTexture = 0;
+            g_flipWidth = g_flipHeight = 0;
+        }
+        g_ringInitialized = false;
+    }
+    gpu_convert_cleanup();
+
+    free(g_readScratch);
+    g_readScratch = NULL;
+    g_readScratchSize = 0;
 }
  
 /**
@@ -129,29 +201,28 @@ int request_screenshot(int with_overlay, int full_resolution,
 
     pthread_mutex_lock(&g_screenshot_mutex);
 
-    g_screenshot_source = source;
-
-    /* If there's already a pending request, don't overwrite it */
-    if (g_screenshot_requested) {
-        LOG_WARNING("Screenshot already requested, ignoring new request");
+    if (g_requestCount == SCREENSHOT_QUEUE_DEPTH) {
+        LOG_WARNING("Screenshot queue full, ignoring new request");
         result = FAILURE;
     } else {
-        /* Set the request flag */
-        g_screenshot_requested = 1;
-        g_screenshot_with_overlay = with_overlay;
+        screenshot_request *req =
+            &g_requests[(g_requestHead + g_requestCount) % SCREENSHOT_QUEUE_DEPTH];
 
-        /* Store the full resolution flag as bit 1 in the request flag */
-        if (full_resolution) {
-            g_screenshot_requested |= 2;
-        }
+        req->with_overlay = with_overlay;
+        req->full_resolution = full_resolution;
+        req->source = source;
 
         /* Store the filename if provided */
         if (output_filename != NULL) {
-            strncpy(g_screenshot_path, output_filename, sizeof(g_screenshot_path) - 1);
-            g_screenshot_path[sizeof(g_screenshot_path) - 1] = '\0';
+            strncpy(req->path, output_filename, sizeof(req->path) - 1);
+            req->path[sizeof(req->path) - 1] = '\0';
         } else {
-            g_screenshot_path[0] = '\0';  /* Empty string indicates auto-generated filename */
+            req->path[0] = '\0';  /* Empty string indicates auto-generated filename */
         }
+        g_requestCount++;
+
+        /* Screenshots are taken from a rendered frame, make sure there is one. */
+        hud_mark_damaged();
 
         LOG_INFO("Screenshot requested: overlay=%d, full_res=%d, path=%s",
                 with_overlay, full_resolution,
@@ -286,6 +357,238 @@ int OpenGL_RenderReadPixelsAsync(SDL_Renderer *renderer,
    return (mappedBuffer != NULL) ? 0 : 1;
 }
 
+/* Make sure the flip target matches the output size. It's a texture so the
+ * NV12 pass can sample it. */
+static int ensure_flip_target(int width, int height)
+{
+   if ((g_flipFbo != 0) && (g_flipWidth == width) && (g_flipHeight == height)) {
+      return SUCCESS;
+   }
+
+   if (g_flipFbo == 0) {
+      glGenFramebuffers(1, &g_flipFbo);
+      glGenTextures(1, &g_flipTexture);
+   }
+
+   GLint prev_texture = 0;
+   glGetIntegerv(GL_TEXTURE_BINDING_2D, &prev_texture);
+   glBindTexture(GL_TEXTURE_2D, g_flipTexture);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glBindTexture(GL_TEXTURE_2D, prev_texture);
+
+   glBindFramebuffer(GL_FRAMEBUFFER, g_flipFbo);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_flipTexture, 0);
+   GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   if (status != GL_FRAMEBUFFER_COMPLETE) {
+      LOG_ERROR("Readback framebuffer incomplete: 0x%x", status);
+      return FAILURE;
+   }
+
+   g_flipWidth = width;
+   g_flipHeight = height;
+
+   return SUCCESS;
+}
+
+int readback_ring_submit(SDL_Renderer *renderer, SDL_Texture *source, int out_width,
+                         int out_height, int nv12, unsigned long timestamp_ns)
+{
+   readback_slot *slot = NULL;
+   int width = 0, height = 0;
+   GLint source_fbo = 0;
+   size_t bytes = 0;
+
+   if (!renderer || (out_width <= 0) || (out_height <= 0)) {
+      return 1;
+   }
+
+   if (!g_ringInitialized) {
+      for (int i = 0; i < READBACK_RING_DEPTH; i++) {
+         glGenBuffers(1, &g_ring[i].pbo);
+         g_ring[i].size = 0;
+         g_ring[i].fence = 0;
+      }
+      g_ringHead = g_ringTail = g_ringPending = 0;
+      g_ringInitialized = true;
+   }
+
+   /* Every slot is still waiting on the GPU. Drop this frame rather than wait. */
+   if (g_ringPending == READBACK_RING_DEPTH) {
+      return 1;
+   }
+
+   if (source != NULL) {
+      if (!gpu_convert_available(GPU_CONVERT_UNPREMULTIPLY)) {
+         return 1;
+      }
+      nv12 = 0;
+   }
+
+   if (ensure_flip_target(out_width, out_height) != SUCCESS) {
+      return 1;
+   }
+
+   /* Anything SDL still has batched has to land first. */
+   SDL_RenderFlush(renderer);
+
+   if (source != NULL) {
+      /* SDL only exposes a target's framebuffer by binding it. */
+      SDL_QueryTexture(source, NULL, NULL, &width, &height);
+      if (SDL_SetRenderTarget(renderer, source) != 0) {
+         return 1;
+      }
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &source_fbo);
+      SDL_SetRenderTarget(renderer, NULL);
+   } else {
+      SDL_GetRendererOutputSize(renderer, &width, &height);
+   }
+
+   /* GL's origin is bottom left. The window is bottom-up, so blitting with
+    * the destination rows swapped turns it top-down. SDL already stores
+    * target textures top-down. Scaling here means only encode sized pixels
+    * ever leave the GPU. */
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, source_fbo);
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_flipFbo);
+   glBlitFramebuffer(0, 0, width, height,
+                     0, (source != NULL) ? 0 : out_height,
+                     out_width, (source != NULL) ? out_height : 0, GL_COLOR_BUFFER_BIT,
+                     ((width == out_width) && (height == out_height)) ? GL_NEAREST : GL_LINEAR);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   slot = &g_ring[g_ringHead];
+
+   if (source != NULL) {
+      if (gpu_convert(GPU_CONVERT_UNPREMULTIPLY, g_flipTexture, out_width, out_height) != SUCCESS) {
+         return 1;
+      }
+      bytes = (size_t) out_width * out_height * 4;
+   } else if (nv12) {
+      if (gpu_convert(GPU_CONVERT_NV12, g_flipTexture, out_width, out_height) != SUCCESS) {
+         return 1;
+      }
+      bytes = NV12_FRAME_SIZE(out_width, out_height);
+   } else {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, g_flipFbo);
+      bytes = (size_t) out_width * out_height * 4;
+   }
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+   if (slot->size != (GLsizeiptr) bytes) {
+      glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+      slot->size = bytes;
+   }
+   if (nv12) {
+      /* NV12 rows are tightly packed bytes. */
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      glReadPixels(0, 0, out_width, out_height * 3 / 2, GL_RED, GL_UNSIGNED_BYTE, 0);
+      glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   } else {
+      glReadPixels(0, 0, out_width, out_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+   }
+   slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   if (slot->fence == 0) {
+      LOG_ERROR("glFenceSync failed.");
+      return 1;
+   }
+
+   slot->bytes = bytes;
+   slot->timestamp_ns = timestamp_ns;
+   g_ringHead = (g_ringHead + 1) % READBACK_RING_DEPTH;
+   g_ringPending++;
+
+   return 0;
+}
+
+/* Free the oldest slot. */
+static void readback_ring_pop(void)
+{
+   readback_slot *slot = &g_ring[g_ringTail];
+
+   if (slot->fence != 0) {
+      glDeleteSync(slot->fence);
+      slot->fence = 0;
+   }
+   g_ringTail = (g_ringTail + 1) % READBACK_RING_DEPTH;
+   g_ringPending--;
+}
+
+int readback_ring_ready(size_t *size)
+{
+   readback_slot *slot = NULL;
+   GLenum status = 0;
+
+   if (g_ringPending == 0) {
+      return 0;
+   }
+
+   slot = &g_ring[g_ringTail];
+
+   /* Zero timeout: just ask. The flush bit makes sure the fence gets to the GPU. */
+   status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+   if (status == GL_WAIT_FAILED) {
+      LOG_ERROR("glClientWaitSync failed, dropping readback.");
+      readback_ring_pop();
+      return 0;
+   }
+   if (status == GL_TIMEOUT_EXPIRED) {
+      return 0;
+   }
+
+   *size = slot->bytes;
+
+   return 1;
+}
+
+int readback_ring_collect(void *pixels, size_t size, unsigned long *timestamp_ns)
+{
+   readback_slot *slot = NULL;
+   void *mapped = NULL;
+   int result = 1;
+
+   if ((g_ringPending == 0) || (pixels == NULL)) {
+      return 1;
+   }
+
+   slot = &g_ring[g_ringTail];
+   if (size >= slot->bytes) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+      mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) slot->bytes, GL_MAP_READ_BIT);
+      if (mapped) {
+         memcpy(pixels, mapped, slot->bytes);
+         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+         if (timestamp_ns != NULL) {
+            *timestamp_ns = slot->timestamp_ns;
+         }
+         result = 0;
+      } else {
+         LOG_ERROR("Unable to map readback buffer.");
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   }
+
+   readback_ring_pop();
+
+   return result;
+}
+
+void readback_ring_reset(void)
+{
+   while (g_ringPending > 0) {
+      readback_ring_pop();
+   }
+   g_ringHead = g_ringTail = 0;
+}
+
 /**
  * Synchronously reads pixels from the current OpenGL framebuffer into a user buffer.
  */
@@ -312,13 +615,20 @@ int OpenGL_RenderReadPixelsSync(SDL_Renderer *renderer,
       SDL_GetRendererOutputSize(renderer, &readW, &readH);
    }
 
-   /* We'll need a temporary buffer to perform the Y-flip */
+   /* We'll need a temporary buffer to perform the Y-flip. Recording reads
+    * back every frame, so keep it around and only grow it. */
    const int bytesPerPixel = 4;  /* RGBA */
-   GLubyte* tempBuffer = (GLubyte*)malloc(readW * readH * bytesPerPixel);
-   if (!tempBuffer) {
-      LOG_ERROR("Failed to allocate temporary buffer for pixel read");
-      return 1;
+   size_t needed = (size_t) readW * readH * bytesPerPixel;
+   if (needed > g_readScratchSize) {
+      GLubyte *grown = (GLubyte*)realloc(g_readScratch, needed);
+      if (!grown) {
+         LOG_ERROR("Failed to allocate temporary buffer for pixel read");
+         return 1;
+      }
+      g_readScratch = grown;
+      g_readScratchSize = needed;
    }
+   GLubyte* tempBuffer = g_readScratch;
 
    /* Read pixels into our temporary buffer */
    glReadPixels(readX, readY, readW, readH, GL_RGBA, GL_UNSIGNED_BYTE, tempBuffer);
@@ -334,24 +644,105 @@ int OpenGL_RenderReadPixelsSync(SDL_Renderer *renderer,
       memcpy(dstRow, srcRow, readW * bytesPerPixel);
    }
 
-   /* Clean up */
-   free(tempBuffer);
-
    return 0;
 }
 
-/**
- * Takes a screenshot with specified options for overlay and resolution.
- */
-int take_screenshot(int with_overlay, int no_camera_mode, int full_resolution, const char *output_filename) {
+/* Encodes queued captures off the render thread. */
+static void *screenshot_encoder_thread(void *arg) {
+   screenshot_job job;
+   int result = 0;
+
+   pthread_mutex_lock(&g_jobMutex);
+   while (true) {
+      /* Drain what's queued before quitting so no requested screenshot is lost. */
+      while ((g_jobCount == 0) && !g_encoderQuit) {
+         pthread_cond_wait(&g_jobCond, &g_jobMutex);
+      }
+      if (g_jobCount == 0) {
+         break;
+      }
+
+      job = g_jobs[g_jobHead];
+      job.params.filename = job.filename;
+      g_jobs[g_jobHead].pixels = NULL;
+      g_jobHead = (g_jobHead + 1) % SCREENSHOT_QUEUE_DEPTH;
+      g_jobCount--;
+      pthread_mutex_unlock(&g_jobMutex);
+
+      result = process_and_save_image(&job.params);
+      free(job.pixels);
+
+      if (result != 0) {
+         LOG_ERROR("Image processing failed with error code: %d", result);
+      } else {
+         LOG_INFO("Screenshot saved to: %s", job.filename);
+
+         /* Send notification if it was an MQTT request */
+         if (job.source == SCREENSHOT_MQTT) {
+            LOG_INFO("Screenshot for MQTT. Sending...");
+            mqttViewingSnapshot(job.filename);
+         }
+      }
+
+      pthread_mutex_lock(&g_jobMutex);
+   }
+   pthread_mutex_unlock(&g_jobMutex);
+
+   return NULL;
+}
+
+/* Hands a capture to the encoder thread, which then owns the pixels. */
+static int queue_screenshot_job(unsigned char *pixels, const ImageProcessParams *params,
+                                const char *filename, screenshot_t source) {
+   screenshot_job *job = NULL;
+
+   pthread_mutex_lock(&g_jobMutex);
+
+   if (!g_encoderRunning) {
+      g_encoderQuit = false;
+      if (pthread_create(&g_encoderThread, NULL, screenshot_encoder_thread, NULL) != 0) {
+         pthread_mutex_unlock(&g_jobMutex);
+         LOG_ERROR("Unable to start the screenshot encoder thread.");
+         free(pixels);
+         return FAILURE;
+      }
+      g_encoderRunning = true;
+   }
+
+   if (g_jobCount == SCREENSHOT_QUEUE_DEPTH) {
+      pthread_mutex_unlock(&g_jobMutex);
+      LOG_WARNING("Screenshot encoder is behind, dropping %s", filename);
+      free(pixels);
+      return FAILURE;
+   }
+
+   job = &g_jobs[(g_jobHead + g_jobCount) % SCREENSHOT_QUEUE_DEPTH];
+   job->pixels = pixels;
+   job->params = *params;
+   job->source = source;
+   strncpy(job->filename, filename, sizeof(job->filename) - 1);
+   job->filename[sizeof(job->filename) - 1] = '\0';
+   job->params.rgba_buffer = pixels;
+   job->params.filename = job->filename;
+   g_jobCount++;
+
+   pthread_cond_signal(&g_jobCond);
+   pthread_mutex_unlock(&g_jobMutex);
+
+   return SUCCESS;
+}
+
+/* Captures the pixels for a screenshot and queues them for encoding. */
+static int capture_screenshot(int with_overlay, int no_camera_mode, int full_resolution,
+                              const char *output_filename, screenshot_t source) {
    hud_display_settings *this_hds = get_hud_display_settings();
    SDL_Renderer *renderer = get_sdl_renderer();
-   video_out_data *this_vod = get_video_out_data();
    time_t r_time;
    struct tm *l_time = NULL;
    char datetime[16];
    char filename[PATH_MAX+31];
-   int result = 0;
+   unsigned char *pixels = NULL;
+   ImageProcessParams params;
 
    /* Generate timestamp for the filename if needed */
    if (output_filename == NULL) {
@@ -369,149 +760,80 @@ int take_screenshot(int with_overlay, int no_camera_mode, int full_resolution, c
    LOG_INFO("Taking screenshot: %s, overlay: %d, full res: %d",
             filename, with_overlay, full_resolution);
 
+   memset(&params, 0, sizeof(params));
+   params.format_params.quality = full_resolution ? 95 : SNAPSHOT_QUALITY; /* Higher quality for full-res */
+
    if (with_overlay) {
-      /* With overlay - capture what's currently on screen */
-      void *screenshot_buffer =
-          malloc(this_hds->eye_output_width * 2 * RGB_OUT_SIZE * this_hds->eye_output_height);
-      if (screenshot_buffer == NULL) {
+      /* With overlay - capture what's currently on screen. Only the left eye is
+       * saved, so only the left eye is read. */
+      SDL_Rect left_eye = { 0, 0, this_hds->eye_output_width, this_hds->eye_output_height };
+
+      pixels = malloc(this_hds->eye_output_width * RGB_OUT_SIZE * this_hds->eye_output_height);
+      if (pixels == NULL) {
          LOG_ERROR("Unable to allocate memory for screenshot buffer");
          return FAILURE;
       }
 
-      /* Use the PBO-based sync read */
-      result = OpenGL_RenderReadPixelsSync(
-         renderer,
-         NULL,
-         PIXEL_FORMAT_OUT,
-         screenshot_buffer,
-         this_hds->eye_output_width * 2 * RGB_OUT_SIZE
-      );
+      int result = OpenGL_RenderReadPixelsSync(renderer, &left_eye, PIXEL_FORMAT_OUT, pixels,
+                                               this_hds->eye_output_width * RGB_OUT_SIZE);
       if (result != 0) {
          LOG_ERROR("Failed to read pixels: %d", result);
-         free(screenshot_buffer);
+         free(pixels);
          return FAILURE;
       }
 
-      /* Calculate dimensions based on resolution preference */
-      int new_width, new_height;
-      if (full_resolution) {
-         new_width = this_hds->eye_output_width;
-         new_height = this_hds->eye_output_height;
-      } else {
-         new_width = SNAPSHOT_WIDTH;
-         new_height = SNAPSHOT_HEIGHT;
-      }
-
-      /* Process and save the image */
-      ImageProcessParams params = {
-         .rgba_buffer = (unsigned char *)screenshot_buffer,
-         .orig_width = this_hds->eye_output_width * 2,
-         .orig_height = this_hds->eye_output_height,
-         .filename = filename,
-         .left_crop = 0,
-         .top_crop = 0,
-         .right_crop = this_hds->eye_output_width, /* Capture just the left eye */
-         .bottom_crop = 0,
-         .new_width = new_width,
-         .new_height = new_height,
-         .format_params.quality = full_resolution ? 95 : SNAPSHOT_QUALITY /* Higher quality for full-res */
-      };
-
-      result = process_and_save_image(&params);
-      free(screenshot_buffer);
-
+      params.orig_width = this_hds->eye_output_width;
+      params.orig_height = this_hds->eye_output_height;
+      params.new_width = full_resolution ? this_hds->eye_output_width : SNAPSHOT_WIDTH;
+      params.new_height = full_resolution ? this_hds->eye_output_height : SNAPSHOT_HEIGHT;
    } else {
-      /* Without overlay - capture raw camera feed */
-      void *snapshot_pixel = NULL;
-      void *temp_buffer = NULL;
-      int orig_width, orig_height;
-      int is_recording_buffer = 0;
-
-      /* Use a mutex lock before accessing shared buffers */
-      pthread_mutex_lock(&this_vod->p_mutex);
-
+      /* Without overlay - capture raw camera feed. The copy is ours. */
       if (!no_camera_mode) {
-         /* Allocate buffer for camera frame - use the more efficient OpenGL method if possible */
-         temp_buffer = malloc(this_hds->cam_input_width * this_hds->cam_input_height * 4);
-         if (temp_buffer == NULL) {
-            pthread_mutex_unlock(&this_vod->p_mutex);
-            LOG_ERROR("Unable to allocate memory for camera frame buffer");
-            return FAILURE;
-         }
-
-         /* Get frame data from camera */
-         snapshot_pixel = grab_latest_camera_frame(temp_buffer);
-         orig_width = this_hds->cam_input_width;
-         orig_height = this_hds->cam_input_height;
+         pixels = grab_latest_camera_frame(NULL);
       }
-
-      if (snapshot_pixel == NULL) {
-         if (temp_buffer != NULL) {
-            free(temp_buffer);
-         }
-         pthread_mutex_unlock(&this_vod->p_mutex);
+      if (pixels == NULL) {
          LOG_ERROR("No valid pixel data available for screenshot");
          return FAILURE;
       }
 
-      /* Calculate dimensions based on resolution preference */
-      int new_width, new_height;
-      if (full_resolution) {
-         if (is_recording_buffer) {
-            new_width = this_hds->eye_output_width;
-            new_height = this_hds->eye_output_height;
-         } else {
-            new_width = this_hds->cam_input_width - (2 * this_hds->cam_crop_x);
-            new_height = this_hds->cam_input_height;
-         }
-      } else {
-         new_width = SNAPSHOT_WIDTH;
-         new_height = SNAPSHOT_HEIGHT;
-      }
+      params.orig_width = this_hds->cam_frame_width;
+      params.orig_height = this_hds->cam_frame_height;
+      params.left_crop = this_hds->cam_frame_crop_x;
+      params.right_crop = this_hds->cam_frame_crop_x;
+      params.new_width = full_resolution ?
+                         this_hds->cam_frame_width - (2 * this_hds->cam_frame_crop_x) : SNAPSHOT_WIDTH;
+      params.new_height = full_resolution ? this_hds->cam_frame_height : SNAPSHOT_HEIGHT;
+   }
 
-      /* Adjust cropping based on buffer type */
-      int left_crop, right_crop;
-      if (is_recording_buffer) {
-         /* For recording buffer (stereo), grab just the left eye */
-         left_crop = 0;
-         right_crop = this_hds->eye_output_width;
-      } else {
-         /* For camera buffer, use standard camera crop */
-         left_crop = this_hds->cam_crop_x;
-         right_crop = this_hds->cam_crop_x;
-      }
+   return queue_screenshot_job(pixels, &params, filename, source);
+}
 
-      ImageProcessParams params = {
-         .rgba_buffer = (unsigned char *)snapshot_pixel,
-         .orig_width = orig_width,
-         .orig_height = orig_height,
-         .filename = filename,
-         .left_crop = left_crop,
-         .top_crop = 0,
-         .right_crop = right_crop,
-         .bottom_crop = 0,
-         .new_width = new_width,
-         .new_height = new_height,
-         .format_params.quality = full_resolution ? 95 : SNAPSHOT_QUALITY /* Higher quality for full-res */
-      };
-
-      result = process_and_save_image(&params);
-
-      /* Free the temporary buffer if we allocated one */
-      if (temp_buffer != NULL) {
-         free(temp_buffer);
-      }
+/**
+ * Takes a screenshot with specified options for overlay and resolution.
+ */
+int take_screenshot(int with_overlay, int no_camera_mode, int full_resolution, const char *output_filename) {
+   return capture_screenshot(with_overlay, no_camera_mode, full_resolution, output_filename,
+                             SCREENSHOT_MANUAL);
+}
 
-      pthread_mutex_unlock(&this_vod->p_mutex);
+/**
+ * Stops the screenshot encoder thread once everything queued has been saved.
+ */
+void screenshot_encoder_stop(void) {
+   pthread_mutex_lock(&g_jobMutex);
+   if (!g_encoderRunning) {
+      pthread_mutex_unlock(&g_jobMutex);
+      return;
    }
+   g_encoderQuit = true;
+   pthread_cond_signal(&g_jobCond);
+   pthread_mutex_unlock(&g_jobMutex);
 
-   if (result != 0) {
-      LOG_ERROR("Image processing failed with error code: %d", result);
-      return 3;
-   } else {
-      LOG_INFO("Screenshot saved to: %s", filename);
-      return 0;
-   }
+   pthread_join(g_encoderThread, NULL);
+
+   pthread_mutex_lock(&g_jobMutex);
+   g_encoderRunning = false;
+   pthread_mutex_unlock(&g_jobMutex);
 }
 
 /**
@@ -559,26 +881,31 @@ void mqttViewingSnapshot(const char *filename) {
 
 /**
  * Process any pending screenshot requests in the main thread.
- * Checks if a screenshot has been requested and if so, takes the screenshot with the
- * requested parameters and clears the request flag.
+ * Captures the pixels for each queued request and hands them to the encoder
+ * thread, so the render thread only pays for the readback or copy.
  */
 void process_screenshot_requests(int no_camera_mode) {
+    screenshot_request req;
+
     pthread_mutex_lock(&g_screenshot_mutex);
 
-    if (g_screenshot_requested) {
-        int with_overlay = g_screenshot_with_overlay;
-        int full_resolution = (g_screenshot_requested & 2) ? 1 : 0;
-        screenshot_t source = g_screenshot_source;
+    while (g_requestCount > 0) {
         char output_path[PATH_MAX+31];
 
+        req = g_requests[g_requestHead];
+        g_requestHead = (g_requestHead + 1) % SCREENSHOT_QUEUE_DEPTH;
+        g_requestCount--;
+
+        pthread_mutex_unlock(&g_screenshot_mutex);
+
         /* Copy the path to a local variable */
-        if (g_screenshot_path[0] != '\0') {
-            strncpy(output_path, g_screenshot_path, sizeof(output_path) - 1);
+        if (req.path[0] != '\0') {
+            strncpy(output_path, req.path, sizeof(output_path) - 1);
             output_path[sizeof(output_path) - 1] = '\0';
 
             /* For MQTT requests, ensure the timestamp is current by updating
                the filename if it starts with "snapshot-" */
-            if (source == SCREENSHOT_MQTT && strstr(output_path, "/snapshot-") != NULL) {
+            if (req.source == SCREENSHOT_MQTT && strstr(output_path, "/snapshot-") != NULL) {
                 char *base_path = strdup(output_path);
                 char *timestamp_part = strstr(base_path, "/snapshot-");
                 if (timestamp_part) {
@@ -613,22 +940,12 @@ void process_screenshot_requests(int no_camera_mode) {
                     record_path, datetime);
         }
 
-        /* Clear the request flag before taking the screenshot */
-        g_screenshot_requested = 0;
-        g_screenshot_path[0] = '\0';
-        g_screenshot_source = SCREENSHOT_MANUAL;
-
-        pthread_mutex_unlock(&g_screenshot_mutex);
-
-        /* Now take the screenshot from the main thread where OpenGL context is valid */
-        int result = take_screenshot(with_overlay, no_camera_mode, full_resolution, output_path);
+        /* Capture from the main thread where the OpenGL context is valid */
+        capture_screenshot(req.with_overlay, no_camera_mode, req.full_resolution, output_path,
+                           req.source);
 
-        /* Send notification if it was an MQTT request */
-        if (source == SCREENSHOT_MQTT && result == 0) {
-           LOG_INFO("Screenshot for MQTT. Sending...");
-           mqttViewingSnapshot(output_path);
-        }
-    } else {
-        pthread_mutex_unlock(&g_screenshot_mutex);
+        pthread_mutex_lock(&g_screenshot_mutex);
     }
+
+    pthread_mutex_unlock(&g_screenshot_mutex);
 }
@@ -71,6 +71,62 @@ int OpenGL_RenderReadPixelsAsync(SDL_Renderer *renderer,
                                 void *pixels,
                                 int pitch);
 
+/* Recording readback ring.
+ *
+ * Each frame is blitted upside down into an offscreen framebuffer at the
+ * encode size, which puts the rows in top-down order and does any downscale
+ * on the GPU. Optionally a shader then converts it to NV12. The result is read
+ * into the next of READBACK_RING_DEPTH PBOs with a fence behind it. The fences
+ * are only ever polled with a zero timeout, so a frame comes back one or two
+ * frames after it was drawn and the render thread never waits for the GPU.
+ */
+#define READBACK_RING_DEPTH 4
+
+/**
+ * @brief Queues a readback of the frame just rendered.
+ *
+ * @param renderer   The SDL renderer (OpenGL backend), rendering to the window.
+ * @param source     NULL for the window. Otherwise a premultiplied render target
+ *                   texture, read back as straight alpha RGBA.
+ * @param out_width  Width to read back at. The source is scaled to fit.
+ * @param out_height Height to read back at.
+ * @param nv12       Convert to NV12 on the GPU. Width and height must be even.
+ *                   Ignored for a texture source.
+ * @param timestamp_ns When the frame was rendered, from latency_now_ns(). Handed
+ *                   back with the pixels.
+ * @return 0 on success, 1 if the ring is full or GL failed. The frame is dropped.
+ */
+int readback_ring_submit(SDL_Renderer *renderer, SDL_Texture *source, int out_width,
+                         int out_height, int nv12, unsigned long timestamp_ns);
+
+/**
+ * @brief Checks whether the oldest queued readback has completed. Never blocks.
+ *
+ * @param size Set to the size in bytes of the ready frame.
+ * @return 1 if a frame is ready to collect, 0 otherwise.
+ */
+int readback_ring_ready(size_t *size);
+
+/**
+ * @brief Copies the oldest completed readback out of the ring, rows top-down.
+ *
+ * Call only after readback_ring_ready() returned 1.
+ *
+ * @param pixels       Destination buffer.
+ * @param size         Size of the destination in bytes.
+ * @param timestamp_ns Optional. Set to the render time given at submit.
+ * @return 0 on success, 1 on failure. The slot is freed either way.
+ */
+int readback_ring_collect(void *pixels, size_t size, unsigned long *timestamp_ns);
+
+/**
+ * @brief Drops any queued readbacks, e.g. when recording stops.
+ */
+void readback_ring_reset(void);
+
+/* Screenshot requests waiting for a frame, and captures waiting for the encoder. */
+#define SCREENSHOT_QUEUE_DEPTH 8
+
 /**
  * Requests a screenshot to be taken by the main thread
  *
@@ -86,14 +142,22 @@ int request_screenshot(int with_overlay, int full_resolution,
 /**
  * Takes a screenshot with specified options
  *
+ * Captures on the calling (render) thread, then crops, scales, encodes and
+ * saves on the screenshot encoder thread.
+ *
  * @param with_overlay If true, captures with UI overlay
  * @param no_camera_mode is no_camera_mode enabled
  * @param full_resolution If true, maintains original resolution
  * @param output_filename Optional custom filename
- * @return 0 on success, non-zero on failure
+ * @return 0 if the capture was queued for encoding, non-zero on failure
  */
 int take_screenshot(int with_overlay, int no_camera_mode, int full_resolution, const char *output_filename);
 
+/**
+ * Stops the screenshot encoder thread after it saves everything queued.
+ */
+void screenshot_encoder_stop(void);
+
 /**
  * Takes a snapshot for AI processing and saves it to disk.
  * This function queues the request to be processed by the main thread.
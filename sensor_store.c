@@ -0,0 +1,174 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "logging.h"
+#include "sensor_store.h"
+
+#define SENSOR_SNAPSHOT_SIZE 256   /* Big enough for any of the device structs. */
+
+typedef struct {
+   pthread_mutex_t writer;                        /* Serializes writers only. */
+   void *working;                                 /* Writers' copy, updated in place. */
+   size_t size;
+   seqlock lock;
+   unsigned char snapshot[SENSOR_SNAPSHOT_SIZE];  /* Published copy, read under the seqlock. */
+} sensor_slot;
+
+static sensor_slot sensor_slots[SENSOR_COUNT] = {
+   [SENSOR_MOTION] = { .writer = PTHREAD_MUTEX_INITIALIZER },
+   [SENSOR_ENVIRO] = { .writer = PTHREAD_MUTEX_INITIALIZER },
+   [SENSOR_GPS] = { .writer = PTHREAD_MUTEX_INITIALIZER },
+};
+
+_Static_assert(sizeof(motion) <= SENSOR_SNAPSHOT_SIZE, "motion snapshot too large");
+_Static_assert(sizeof(enviro) <= SENSOR_SNAPSHOT_SIZE, "enviro snapshot too large");
+_Static_assert(sizeof(gps) <= SENSOR_SNAPSHOT_SIZE, "gps snapshot too large");
+
+/* Render thread only. */
+static enviro latched_enviro;
+static gps latched_gps;
+static unsigned long latched_version[SENSOR_COUNT];
+
+void seqlock_write_begin(seqlock *lock)
+{
+   unsigned int seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+
+   atomic_store_explicit(&lock->seq, seq + 1, memory_order_relaxed);
+   /* The odd count must be visible before any of the data changes. */
+   atomic_thread_fence(memory_order_release);
+}
+
+void seqlock_write_end(seqlock *lock)
+{
+   unsigned int seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+
+   atomic_store_explicit(&lock->seq, seq + 1, memory_order_release);
+}
+
+unsigned int seqlock_read_begin(seqlock *lock)
+{
+   unsigned int seq = 0;
+
+   while ((seq = atomic_load_explicit(&lock->seq, memory_order_acquire)) & 1) {
+   }
+
+   return seq;
+}
+
+int seqlock_read_retry(seqlock *lock, unsigned int start)
+{
+   /* The data reads must complete before we look at the count again. */
+   atomic_thread_fence(memory_order_acquire);
+
+   return atomic_load_explicit(&lock->seq, memory_order_relaxed) != start;
+}
+
+static void sensor_publish(sensor_slot *slot)
+{
+   seqlock_write_begin(&slot->lock);
+   memcpy(slot->snapshot, slot->working, slot->size);
+   seqlock_write_end(&slot->lock);
+}
+
+void sensor_store_init(sensor_id_t id, void *working, size_t size)
+{
+   sensor_slot *slot = NULL;
+
+   if ((id >= SENSOR_COUNT) || (working == NULL) || (size > SENSOR_SNAPSHOT_SIZE)) {
+      LOG_ERROR("Invalid sensor store registration for sensor %d.", id);
+      return;
+   }
+
+   slot = &sensor_slots[id];
+   pthread_mutex_lock(&slot->writer);
+   slot->working = working;
+   slot->size = size;
+   sensor_publish(slot);
+   pthread_mutex_unlock(&slot->writer);
+
+   /* Seed the frame copies so the first frame has something to draw. */
+   if (id == SENSOR_ENVIRO) {
+      latched_version[id] = sensor_store_read(id, &latched_enviro);
+   } else if (id == SENSOR_GPS) {
+      latched_version[id] = sensor_store_read(id, &latched_gps);
+   }
+}
+
+void *sensor_store_write_begin(sensor_id_t id)
+{
+   pthread_mutex_lock(&sensor_slots[id].writer);
+
+   return sensor_slots[id].working;
+}
+
+void sensor_store_write_end(sensor_id_t id)
+{
+   sensor_slot *slot = &sensor_slots[id];
+
+   if (slot->working != NULL) {
+      sensor_publish(slot);
+   }
+   pthread_mutex_unlock(&slot->writer);
+}
+
+unsigned long sensor_store_read(sensor_id_t id, void *dst)
+{
+   sensor_slot *slot = &sensor_slots[id];
+   unsigned int seq = 0;
+
+   do {
+      seq = seqlock_read_begin(&slot->lock);
+      memcpy(dst, slot->snapshot, slot->size);
+   } while (seqlock_read_retry(&slot->lock, seq));
+
+   return seq / 2;
+}
+
+/* Copy a snapshot only if it changed since the last frame. */
+static void sensor_latch_one(sensor_id_t id, void *dst)
+{
+   unsigned int seq = atomic_load_explicit(&sensor_slots[id].lock.seq, memory_order_acquire);
+
+   if ((seq / 2) != latched_version[id]) {
+      latched_version[id] = sensor_store_read(id, dst);
+   }
+}
+
+void sensor_store_latch(void)
+{
+   sensor_latch_one(SENSOR_ENVIRO, &latched_enviro);
+   sensor_latch_one(SENSOR_GPS, &latched_gps);
+}
+
+const enviro *get_latched_enviro(void)
+{
+   return &latched_enviro;
+}
+
+const gps *get_latched_gps(void)
+{
+   return &latched_gps;
+}
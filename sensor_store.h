@@ -0,0 +1,126 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef SENSOR_STORE_H
+#define SENSOR_STORE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "config_parser.h"
+#include "devices.h"
+
+/* Seqlock published sensor state.
+ *
+ * Writers (the MQTT, serial and socket threads) take turns on a per-sensor
+ * mutex, update the sensor's working copy in place and publish it as one
+ * versioned snapshot. Readers never lock: they copy the snapshot and retry if
+ * a publish overlapped the copy. Updates that arrive between two reads
+ * coalesce, the reader only ever sees the latest.
+ *
+ * The render thread latches one snapshot of each sensor per frame with
+ * sensor_store_latch(), so every element in a frame draws the same values.
+ */
+
+/* Sequence counter. Odd while a write is in progress. */
+typedef struct {
+   atomic_uint seq;
+} seqlock;
+
+typedef enum {
+   SENSOR_MOTION,
+   SENSOR_ENVIRO,
+   SENSOR_GPS,
+   SENSOR_COUNT
+} sensor_id_t;
+
+/**
+ * @brief Starts a write. Writers must already be serialized with each other.
+ */
+void seqlock_write_begin(seqlock *lock);
+
+/**
+ * @brief Finishes a write and makes it visible to readers.
+ */
+void seqlock_write_end(seqlock *lock);
+
+/**
+ * @brief Starts a read. Spins while a write is in progress.
+ *
+ * @return The sequence to pass to seqlock_read_retry().
+ */
+unsigned int seqlock_read_begin(seqlock *lock);
+
+/**
+ * @brief Returns 1 if a write overlapped the read and it must be repeated.
+ */
+int seqlock_read_retry(seqlock *lock, unsigned int start);
+
+/**
+ * @brief Registers a sensor's working copy and publishes its initial value.
+ *
+ * Call once per sensor at startup, before any writer runs.
+ *
+ * @param id      The sensor.
+ * @param working The writers' copy, e.g. get_gps_dev(). Must outlive the store.
+ * @param size    Size of the sensor struct.
+ */
+void sensor_store_init(sensor_id_t id, void *working, size_t size);
+
+/**
+ * @brief Locks the sensor for writing and returns its working copy.
+ *
+ * Update the fields in place, then call sensor_store_write_end().
+ */
+void *sensor_store_write_begin(sensor_id_t id);
+
+/**
+ * @brief Publishes the working copy and unlocks the sensor.
+ */
+void sensor_store_write_end(sensor_id_t id);
+
+/**
+ * @brief Copies the latest published snapshot. Lock-free, callable from any thread.
+ *
+ * @param id   The sensor.
+ * @param dst  Destination. At least the size given to sensor_store_init().
+ * @return The snapshot's version, which grows by one per publish. 0 if never published.
+ */
+unsigned long sensor_store_read(sensor_id_t id, void *dst);
+
+/**
+ * @brief Latches this frame's environmental and GPS snapshots. Render thread only.
+ *
+ * A snapshot is only copied when its version has changed since the last frame.
+ */
+void sensor_store_latch(void);
+
+/**
+ * @brief Returns this frame's latched environmental data. Render thread only.
+ */
+const enviro *get_latched_enviro(void);
+
+/**
+ * @brief Returns this frame's latched GPS data. Render thread only.
+ */
+const gps *get_latched_gps(void);
+
+#endif /* SENSOR_STORE_H */
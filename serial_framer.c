@@ -0,0 +1,197 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "logging.h"
+#include "serial_framer.h"
+
+#define RING_MASK (SERIAL_RING_SIZE - 1)
+
+static inline unsigned char ring_at(const serial_ring *ring, size_t pos)
+{
+   return ring->data[pos & RING_MASK];
+}
+
+void serial_ring_init(serial_ring *ring)
+{
+   memset(ring, 0, sizeof(*ring));
+}
+
+void serial_ring_reset(serial_ring *ring)
+{
+   ring->head = 0;
+   ring->tail = 0;
+   ring->scan = 0;
+}
+
+unsigned char *serial_ring_write_ptr(serial_ring *ring, size_t *space)
+{
+   size_t used = ring->head - ring->tail;
+   size_t to_end = SERIAL_RING_SIZE - (ring->head & RING_MASK);
+   size_t free_space = SERIAL_RING_SIZE - used;
+
+   *space = (free_space < to_end) ? free_space : to_end;
+
+   return &ring->data[ring->head & RING_MASK];
+}
+
+void serial_ring_commit(serial_ring *ring, size_t bytes)
+{
+   ring->head += bytes;
+}
+
+/* CRC-16/CCITT-FALSE over ring bytes [start, start + length). */
+static uint16_t ring_crc16(const serial_ring *ring, size_t start, size_t length)
+{
+   uint16_t crc = 0xFFFF;
+
+   for (size_t i = 0; i < length; i++) {
+      crc ^= (uint16_t) ring_at(ring, start + i) << 8;
+      for (int bit = 0; bit < 8; bit++) {
+         crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+      }
+   }
+
+   return crc;
+}
+
+/* Point at length ring bytes from start, copying them out only if they wrap. */
+static unsigned char *ring_span(serial_ring *ring, size_t start, size_t length)
+{
+   size_t offset = start & RING_MASK;
+   size_t first = SERIAL_RING_SIZE - offset;
+
+   if (length <= first) {
+      return &ring->data[offset];
+   }
+
+   memcpy(ring->linear, &ring->data[offset], first);
+   memcpy(ring->linear + first, ring->data, length - first);
+
+   return ring->linear;
+}
+
+/* Try a binary frame at tail. 1 found, 0 incomplete, -1 not a valid frame. */
+static int ring_next_binary(serial_ring *ring, serial_frame *frame)
+{
+   size_t used = ring->head - ring->tail;
+   size_t payload = 0;
+   uint16_t crc = 0;
+
+   if (used < SERIAL_BIN_HEADER) {
+      return 0;
+   }
+
+   payload = ring_at(ring, ring->tail + 3);
+   if (used < SERIAL_BIN_HEADER + payload + SERIAL_BIN_CRC) {
+      return 0;
+   }
+
+   crc = (uint16_t) ring_at(ring, ring->tail + SERIAL_BIN_HEADER + payload) |
+         ((uint16_t) ring_at(ring, ring->tail + SERIAL_BIN_HEADER + payload + 1) << 8);
+   if (ring_crc16(ring, ring->tail + 2, payload + 2) != crc) {
+      return -1;
+   }
+
+   frame->kind = SERIAL_FRAME_BINARY;
+   frame->type = ring_at(ring, ring->tail + 2);
+   frame->data = ring_span(ring, ring->tail + SERIAL_BIN_HEADER, payload);
+   frame->length = payload;
+   frame->consumed = SERIAL_BIN_HEADER + payload + SERIAL_BIN_CRC;
+   ring->binary_frames++;
+
+   return 1;
+}
+
+int serial_ring_next(serial_ring *ring, serial_frame *frame)
+{
+   while (ring->head != ring->tail) {
+      size_t used = ring->head - ring->tail;
+      size_t line = 0, span = 0;
+      unsigned char *text = NULL;
+
+      if ((ring->scan == 0) && (ring_at(ring, ring->tail) == SERIAL_SYNC_0)) {
+         if (used < 2) {
+            return 0;
+         }
+         if (ring_at(ring, ring->tail + 1) == SERIAL_SYNC_1) {
+            int result = ring_next_binary(ring, frame);
+
+            if (result >= 0) {
+               return result;
+            }
+            /* Not a frame after all. Skip the sync byte and look again. */
+            ring->crc_errors++;
+            ring->tail++;
+            continue;
+         }
+      }
+
+      /* Text. Pick up the newline search where the last call stopped. */
+      while ((ring->scan < used) && (ring_at(ring, ring->tail + ring->scan) != '\n')) {
+         ring->scan++;
+      }
+
+      if (ring->scan == used) {
+         if (used > SERIAL_FRAME_MAX) {
+            LOG_WARNING("Command buffer overflow, discarding data");
+            ring->overflows++;
+            ring->tail = ring->head;
+            ring->scan = 0;
+         }
+         return 0;
+      }
+
+      line = ring->scan;
+      span = line + 1;
+      ring->scan = 0;
+      if (line > SERIAL_FRAME_MAX) {
+         ring->overflows++;
+         ring->tail += span;
+         continue;
+      }
+
+      /* The newline becomes the terminator, or the copy gets one. */
+      text = ring_span(ring, ring->tail, span);
+      text[line] = '\0';
+      while ((line > 0) && (text[line - 1] == '\r')) {
+         text[--line] = '\0';
+      }
+
+      frame->kind = SERIAL_FRAME_TEXT;
+      frame->type = 0;
+      frame->data = text;
+      frame->length = line;
+      frame->consumed = span;
+      ring->text_frames++;
+      return 1;
+   }
+
+   return 0;
+}
+
+void serial_ring_release(serial_ring *ring, const serial_frame *frame)
+{
+   ring->tail += frame->consumed;
+   ring->scan = 0;
+}
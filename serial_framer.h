@@ -0,0 +1,120 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef SERIAL_FRAMER_H
+#define SERIAL_FRAMER_H
+
+#include <stddef.h>
+
+#include "defines.h"
+
+/* Ring buffer frame extraction for the serial link.
+ *
+ * read() lands directly in the ring and frames are handed out in place
+ * whenever they are contiguous; only a frame that wraps the end of the ring
+ * is copied. Two kinds of frame share the link:
+ *
+ *  - Text: a line ending in '\n', normally a JSON command. '\r' is dropped.
+ *  - Binary: SERIAL_SYNC_0 SERIAL_SYNC_1 <type> <length> <payload> <crc16>.
+ *    The CRC is CRC-16/CCITT-FALSE over type, length and payload, sent little
+ *    endian. Values in the payload are little endian as well.
+ *
+ * A bad CRC costs one byte and the framer resyncs on the next sync pair.
+ */
+
+#define SERIAL_RING_SIZE        8192   /* Power of two, at least twice the largest frame. */
+#define SERIAL_FRAME_MAX        MAX_SERIAL_BUFFER_LENGTH
+
+#define SERIAL_SYNC_0           0xA5
+#define SERIAL_SYNC_1           0x5A
+#define SERIAL_BIN_HEADER       4      /* Sync pair, type and length. */
+#define SERIAL_BIN_CRC          2
+
+/* Binary packet types and their payloads. All floats are IEEE 754 single precision. */
+#define SERIAL_PKT_ORIENTATION  0x01   /* heading, pitch, roll (degrees), then optional w, x, y, z. */
+#define SERIAL_PKT_ENVIRO       0x02   /* temp, humidity, air_quality, tvoc_ppb, eco2_ppm, co2_ppm,
+                                        * heat_index_c, dew_point, then int16 co2_eco2_diff. */
+
+typedef enum {
+   SERIAL_FRAME_TEXT,
+   SERIAL_FRAME_BINARY
+} serial_frame_kind;
+
+typedef struct {
+   serial_frame_kind kind;
+   unsigned char type;            /* Binary packet type. */
+   unsigned char *data;           /* Text is NUL terminated. Binary points at the payload. */
+   size_t length;                 /* Text or payload length. */
+   size_t consumed;               /* Ring bytes the frame occupies. */
+} serial_frame;
+
+typedef struct {
+   unsigned char data[SERIAL_RING_SIZE];
+   size_t head;                   /* Bytes written. Free running, masked on use. */
+   size_t tail;                   /* Bytes consumed. */
+   size_t scan;                   /* Bytes past tail already searched for a newline. */
+   unsigned char linear[SERIAL_FRAME_MAX + 1];  /* Frames that wrap are copied here. */
+
+   unsigned long text_frames;
+   unsigned long binary_frames;
+   unsigned long crc_errors;
+   unsigned long overflows;       /* Text lines too long to ever complete. */
+} serial_ring;
+
+/**
+ * @brief Empties the ring and clears its counters.
+ */
+void serial_ring_init(serial_ring *ring);
+
+/**
+ * @brief Drops any buffered bytes, keeping the counters.
+ *
+ * Used when the port is reopened, so a partial frame from the old link is
+ * never joined to bytes from the new one.
+ */
+void serial_ring_reset(serial_ring *ring);
+
+/**
+ * @brief Returns where the next read() should write, and how much fits contiguously.
+ */
+unsigned char *serial_ring_write_ptr(serial_ring *ring, size_t *space);
+
+/**
+ * @brief Accounts for bytes read into the space from serial_ring_write_ptr().
+ */
+void serial_ring_commit(serial_ring *ring, size_t bytes);
+
+/**
+ * @brief Finds the next complete frame.
+ *
+ * The frame stays valid until serial_ring_release(). Text in the ring is
+ * terminated in place, so the data may be handed to the JSON parser as is.
+ *
+ * @return 1 if a frame was found, 0 if more data is needed.
+ */
+int serial_ring_next(serial_ring *ring, serial_frame *frame);
+
+/**
+ * @brief Consumes a frame returned by serial_ring_next().
+ */
+void serial_ring_release(serial_ring *ring, const serial_frame *frame);
+
+#endif /* SERIAL_FRAMER_H */
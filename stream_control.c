@@ -0,0 +1,304 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "latency_stats.h"
+#include "logging.h"
+#include "mirage.h"
+#include "stream_control.h"
+
+typedef struct {
+   int scale;           /* Resolution in quarters of the full size. */
+   int fps_divisor;
+   int bitrate_pct;
+} stream_rung;
+
+/* Bitrate goes first since it's the cheapest to give up. Resolution and
+ * frame rate follow so what's left of the bitrate still looks reasonable. */
+static const stream_rung ladder[] = {
+   { 4, 1, 100 },
+   { 4, 1, 70 },
+   { 3, 1, 50 },
+   { 3, 2, 35 },
+   { 2, 2, 20 }
+};
+#define LADDER_LENGTH ((int) (sizeof(ladder) / sizeof(ladder[0])))
+
+typedef struct {
+   GstElement *encoder;
+   GstElement *caps;
+   GstElement *rate;
+   GstElement *input_queue;   /* Leaky queue ahead of the encoder. */
+   GstElement *sink_queue;    /* Queue ahead of rtmpsink. */
+   GstElement *appsrc;
+   GstPad *sink_pad;
+   gulong probe_id;
+
+   int width, height, fps, bitrate;
+   int rung;
+   int congested_count, clear_count;
+   unsigned long last_sample_ns;
+
+   atomic_ulong sink_bytes;   /* Bytes into rtmpsink, from the streaming thread. */
+} stream_controller;
+
+static stream_controller ctl = { .rung = -1 };
+
+static GstPadProbeReturn count_sink_bytes(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+   gsize bytes = 0;
+
+   if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+      bytes = gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+   } else if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+      bytes = gst_buffer_list_calculate_size(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+   }
+   atomic_fetch_add_explicit(&ctl.sink_bytes, bytes, memory_order_relaxed);
+
+   return GST_PAD_PROBE_OK;
+}
+
+/* Encoders disagree on the integer type of "bitrate", let GValue convert. */
+static void set_numeric_property(GstElement *element, const char *name, gint64 value)
+{
+   GParamSpec *pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(element), name);
+   GValue from = G_VALUE_INIT, to = G_VALUE_INIT;
+
+   if (pspec == NULL) {
+      return;
+   }
+
+   g_value_init(&from, G_TYPE_INT64);
+   g_value_set_int64(&from, value);
+   g_value_init(&to, pspec->value_type);
+   if (g_value_transform(&from, &to)) {
+      g_object_set_property(G_OBJECT(element), name, &to);
+   }
+   g_value_unset(&from);
+   g_value_unset(&to);
+}
+
+/* Fill of a queue, 0 to 100. */
+static int queue_fill_pct(GstElement *queue)
+{
+   guint level = 0, max = 0;
+
+   if (queue == NULL) {
+      return 0;
+   }
+
+   g_object_get(G_OBJECT(queue), "current-level-buffers", &level, "max-size-buffers", &max, NULL);
+
+   return (max > 0) ? (int) (level * 100 / max) : 0;
+}
+
+static int appsrc_fill_pct(GstElement *appsrc)
+{
+   guint64 level = 0, max = 0;
+
+   if (appsrc == NULL) {
+      return 0;
+   }
+
+   g_object_get(G_OBJECT(appsrc), "current-level-bytes", &level, "max-bytes", &max, NULL);
+
+   return (max > 0) ? (int) (level * 100 / max) : 0;
+}
+
+static void rung_format(int rung, int *width, int *height, int *fps, int *bitrate)
+{
+   /* Multiples of 8 keep every encoder happy. */
+   *width = (ctl.width * ladder[rung].scale / 4) & ~7;
+   *height = (ctl.height * ladder[rung].scale / 4) & ~7;
+   *fps = ctl.fps / ladder[rung].fps_divisor;
+   *bitrate = (int) ((gint64) ctl.bitrate * ladder[rung].bitrate_pct / 100);
+}
+
+static void apply_rung(int rung, const char *reason, int fill_pct, unsigned long kbps)
+{
+   char report[STREAM_REPORT_LENGTH];
+   int width = 0, height = 0, fps = 0, bitrate = 0;
+   int old_width = 0, old_height = 0, old_fps = 0, old_bitrate = 0;
+
+   rung_format(rung, &width, &height, &fps, &bitrate);
+   if (ctl.rung >= 0) {
+      rung_format(ctl.rung, &old_width, &old_height, &old_fps, &old_bitrate);
+   }
+
+   if (bitrate != old_bitrate) {
+      set_numeric_property(ctl.encoder, "bitrate", bitrate / STREAM_ENC_BITRATE_UNIT);
+   }
+
+   if ((ctl.caps != NULL) && ((width != old_width) || (height != old_height))) {
+      GstCaps *current = NULL, *caps = NULL;
+
+      /* Keep the format and memory type, only the size changes. */
+      g_object_get(G_OBJECT(ctl.caps), "caps", &current, NULL);
+      if (current != NULL) {
+         caps = gst_caps_copy(current);
+         gst_caps_set_simple(caps, "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, NULL);
+         g_object_set(G_OBJECT(ctl.caps), "caps", caps, NULL);
+         gst_caps_unref(caps);
+         gst_caps_unref(current);
+      }
+   }
+
+   if ((ctl.rate != NULL) && (fps != old_fps)) {
+      g_object_set(G_OBJECT(ctl.rate), "max-rate", fps, NULL);
+   }
+
+   ctl.rung = rung;
+
+   snprintf(report, sizeof(report),
+            "{ \"device\": \"stream\", \"reason\": \"%s\", \"level\": %d, \"width\": %d, "
+            "\"height\": %d, \"fps\": %d, \"bitrate\": %d, \"queue_pct\": %d, "
+            "\"throughput_kbps\": %lu }",
+            reason, rung, width, height, fps, bitrate, fill_pct, kbps);
+   LOG_INFO("Stream %s: %dx%d at %d fps, %d kbit/s.", reason, width, height, fps, bitrate / 1000);
+   mqttSendMessage(MQTT_STREAM_TOPIC, report);
+}
+
+int stream_control_start(GstElement *pipeline, int width, int height, int fps, int bitrate)
+{
+   GstElement *sink = NULL;
+
+   stream_control_stop();
+
+   ctl.encoder = gst_bin_get_by_name(GST_BIN(pipeline), "streamenc");
+   sink = gst_bin_get_by_name(GST_BIN(pipeline), "streamsink");
+   if ((ctl.encoder == NULL) || (sink == NULL)) {
+      LOG_WARNING("Adaptive streaming unavailable: stream encoder or sink not found.");
+      if (sink != NULL) {
+         gst_object_unref(sink);
+      }
+      stream_control_stop();
+      return FAILURE;
+   }
+
+   ctl.caps = gst_bin_get_by_name(GST_BIN(pipeline), "streamcaps");
+   ctl.rate = gst_bin_get_by_name(GST_BIN(pipeline), "streamrate");
+   ctl.appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "srcEncode");
+
+   /* Stream only pipelines and record + stream name their queues differently. */
+   ctl.input_queue = gst_bin_get_by_name(GST_BIN(pipeline), "input_queue");
+   if (ctl.input_queue == NULL) {
+      ctl.input_queue = gst_bin_get_by_name(GST_BIN(pipeline), "stream_queue");
+   }
+   ctl.sink_queue = gst_bin_get_by_name(GST_BIN(pipeline), "mux_queue");
+   if (ctl.sink_queue == NULL) {
+      ctl.sink_queue = gst_bin_get_by_name(GST_BIN(pipeline), "rtmp_queue");
+   }
+
+   atomic_store(&ctl.sink_bytes, 0);
+   ctl.sink_pad = gst_element_get_static_pad(sink, "sink");
+   if (ctl.sink_pad != NULL) {
+      ctl.probe_id = gst_pad_add_probe(ctl.sink_pad,
+                                       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                                       count_sink_bytes, NULL, NULL);
+   }
+   gst_object_unref(sink);
+
+   ctl.width = width;
+   ctl.height = height;
+   ctl.fps = fps;
+   ctl.bitrate = bitrate;
+   ctl.rung = 0;
+   ctl.congested_count = ctl.clear_count = 0;
+   ctl.last_sample_ns = latency_now_ns();
+
+   LOG_INFO("Adaptive streaming started at %dx%d, %d fps, %d kbit/s.", width, height, fps,
+            bitrate / 1000);
+
+   return SUCCESS;
+}
+
+void stream_control_update(void)
+{
+   unsigned long now = 0, elapsed_ms = 0, kbps = 0;
+   int fill = 0;
+
+   if (ctl.rung < 0) {
+      return;
+   }
+
+   now = latency_now_ns();
+   elapsed_ms = (now - ctl.last_sample_ns) / 1000000UL;
+   if (elapsed_ms < STREAM_CONTROL_INTERVAL_MS) {
+      return;
+   }
+   ctl.last_sample_ns = now;
+
+   kbps = atomic_exchange(&ctl.sink_bytes, 0) * 8 / elapsed_ms;
+
+   /* A full sink queue means the uplink can't keep up, a full input queue
+    * means the encoder can't. Either way less data helps. */
+   fill = queue_fill_pct(ctl.sink_queue);
+   if (queue_fill_pct(ctl.input_queue) > fill) {
+      fill = queue_fill_pct(ctl.input_queue);
+   }
+   if (appsrc_fill_pct(ctl.appsrc) > fill) {
+      fill = appsrc_fill_pct(ctl.appsrc);
+   }
+
+   if (fill >= STREAM_CONGESTED_PCT) {
+      ctl.clear_count = 0;
+      if ((++ctl.congested_count >= STREAM_DOWN_INTERVALS) && (ctl.rung < LADDER_LENGTH - 1)) {
+         apply_rung(ctl.rung + 1, "congested", fill, kbps);
+         ctl.congested_count = 0;
+      }
+   } else if (fill <= STREAM_CLEAR_PCT) {
+      ctl.congested_count = 0;
+      if ((++ctl.clear_count >= STREAM_UP_INTERVALS) && (ctl.rung > 0)) {
+         apply_rung(ctl.rung - 1, "recovered", fill, kbps);
+         ctl.clear_count = 0;
+      }
+   } else {
+      /* In between: hold where we are. */
+      ctl.congested_count = ctl.clear_count = 0;
+   }
+}
+
+void stream_control_stop(void)
+{
+   if ((ctl.sink_pad != NULL) && (ctl.probe_id != 0)) {
+      gst_pad_remove_probe(ctl.sink_pad, ctl.probe_id);
+   }
+   ctl.probe_id = 0;
+
+   GstElement **elements[] = { &ctl.encoder, &ctl.caps, &ctl.rate, &ctl.input_queue,
+                               &ctl.sink_queue, &ctl.appsrc };
+   for (int i = 0; i < (int) (sizeof(elements) / sizeof(elements[0])); i++) {
+      if (*elements[i] != NULL) {
+         gst_object_unref(*elements[i]);
+         *elements[i] = NULL;
+      }
+   }
+   if (ctl.sink_pad != NULL) {
+      gst_object_unref(ctl.sink_pad);
+      ctl.sink_pad = NULL;
+   }
+
+   ctl.rung = -1;
+}
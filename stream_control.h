@@ -0,0 +1,72 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef STREAM_CONTROL_H
+#define STREAM_CONTROL_H
+
+#include <gst/gst.h>
+
+/* Adaptive streaming.
+ *
+ * Watches how full the queues ahead of the encoder and the RTMP sink are, and
+ * what actually reaches the sink. On congestion it steps down a ladder of
+ * bitrate, resolution and frame rate. Once things stay clear for a while it
+ * steps back up. Every change is made on the running pipeline: the encoder's
+ * bitrate, the stream capsfilter and videorate's max-rate are all live
+ * properties. Each decision is published on MQTT_STREAM_TOPIC.
+ */
+
+#define STREAM_CONTROL_INTERVAL_MS  1000   /* How often the queues are sampled. */
+#define STREAM_CONGESTED_PCT        50     /* Queue fill that counts as congestion. */
+#define STREAM_CLEAR_PCT            10     /* Queue fill that counts as clear. */
+#define STREAM_DOWN_INTERVALS       2      /* Congested samples in a row before stepping down. */
+#define STREAM_UP_INTERVALS         15     /* Clear samples in a row before stepping up. */
+#define STREAM_REPORT_LENGTH        512
+
+/**
+ * @brief Starts controlling a streaming pipeline that has just gone to PLAYING.
+ *
+ * The pipeline must use GST_PIPE_VIDEO_YOUTUBE and name its RTMP sink "streamsink".
+ * Pipelines without them are left alone.
+ *
+ * @param pipeline The pipeline.
+ * @param width    Stream width at the top of the ladder.
+ * @param height   Stream height at the top of the ladder.
+ * @param fps      Stream frame rate at the top of the ladder.
+ * @param bitrate  Video bitrate at the top of the ladder, in bit/s.
+ * @return SUCCESS if the controller is running, FAILURE otherwise.
+ */
+int stream_control_start(GstElement *pipeline, int width, int height, int fps, int bitrate);
+
+/**
+ * @brief Samples the pipeline and adjusts it if needed.
+ *
+ * Call often from the thread that owns the pipeline. It only does work once
+ * every STREAM_CONTROL_INTERVAL_MS.
+ */
+void stream_control_update(void);
+
+/**
+ * @brief Stops the controller. Call before the pipeline is freed.
+ */
+void stream_control_stop(void);
+
+#endif /* STREAM_CONTROL_H */
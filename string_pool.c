@@ -0,0 +1,168 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "logging.h"
+#include "string_pool.h"
+
+typedef struct _pool_chunk {
+   size_t used;
+   size_t size;
+   struct _pool_chunk *next;
+   char data[];
+} pool_chunk;
+
+static pool_chunk *chunks = NULL;
+static const char **slots = NULL;     /* Open addressed, NULL is empty. */
+static uint32_t *slot_hashes = NULL;
+static size_t slot_count = 0;
+static size_t string_count = 0;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a. */
+static uint32_t string_hash(const char *str)
+{
+   uint32_t hash = 2166136261u;
+
+   while (*str != '\0') {
+      hash ^= (unsigned char) *str++;
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+static int pool_grow(void)
+{
+   size_t new_count = slot_count ? slot_count * 2 : STRING_POOL_INITIAL_SLOTS;
+   const char **new_slots = calloc(new_count, sizeof(*new_slots));
+   uint32_t *new_hashes = calloc(new_count, sizeof(*new_hashes));
+
+   if ((new_slots == NULL) || (new_hashes == NULL)) {
+      LOG_ERROR("Unable to grow string pool.");
+      free(new_slots);
+      free(new_hashes);
+      return FAILURE;
+   }
+
+   for (size_t i = 0; i < slot_count; i++) {
+      if (slots[i] != NULL) {
+         size_t j = slot_hashes[i] & (new_count - 1);
+
+         while (new_slots[j] != NULL) {
+            j = (j + 1) & (new_count - 1);
+         }
+         new_slots[j] = slots[i];
+         new_hashes[j] = slot_hashes[i];
+      }
+   }
+
+   free(slots);
+   free(slot_hashes);
+   slots = new_slots;
+   slot_hashes = new_hashes;
+   slot_count = new_count;
+
+   return SUCCESS;
+}
+
+static char *pool_store(const char *str, size_t len)
+{
+   pool_chunk *chunk = chunks;
+   char *copy = NULL;
+
+   if ((chunk == NULL) || (chunk->size - chunk->used < len + 1)) {
+      size_t size = (len + 1 > STRING_POOL_CHUNK_SIZE) ? len + 1 : STRING_POOL_CHUNK_SIZE;
+
+      chunk = malloc(sizeof(pool_chunk) + size);
+      if (chunk == NULL) {
+         LOG_ERROR("Unable to malloc string pool chunk.");
+         return NULL;
+      }
+      chunk->used = 0;
+      chunk->size = size;
+      chunk->next = chunks;
+      chunks = chunk;
+   }
+
+   copy = chunk->data + chunk->used;
+   memcpy(copy, str, len + 1);
+   chunk->used += len + 1;
+
+   return copy;
+}
+
+const char *intern_string(const char *str)
+{
+   const char *result = "";
+   uint32_t hash = 0;
+   size_t i = 0;
+
+   if (str == NULL) {
+      str = "";
+   }
+   hash = string_hash(str);
+
+   pthread_mutex_lock(&pool_mutex);
+
+   /* Keep the table at most half full. */
+   if (((string_count + 1) * 2 > slot_count) && (pool_grow() != SUCCESS)) {
+      pthread_mutex_unlock(&pool_mutex);
+      return result;
+   }
+
+   for (i = hash & (slot_count - 1); slots[i] != NULL; i = (i + 1) & (slot_count - 1)) {
+      if ((slot_hashes[i] == hash) && (strcmp(slots[i], str) == 0)) {
+         result = slots[i];
+         pthread_mutex_unlock(&pool_mutex);
+         return result;
+      }
+   }
+
+   result = pool_store(str, strlen(str));
+   if (result == NULL) {
+      result = "";
+   } else {
+      slots[i] = result;
+      slot_hashes[i] = hash;
+      string_count++;
+   }
+
+   pthread_mutex_unlock(&pool_mutex);
+
+   return result;
+}
+
+const char *intern_path(const char *dir, const char *file)
+{
+   char path[MAX_FILENAME_LENGTH * 2];
+
+   snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+   return intern_string(path);
+}
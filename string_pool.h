@@ -0,0 +1,48 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+/* Interned, immutable strings for config data such as element names and paths.
+ *
+ * Each distinct string is stored once. Equal strings always intern to the same
+ * pointer, so interned strings may be compared with ==. Storage lives for the
+ * life of the process; config reloads reuse the strings they already have.
+ */
+
+#define STRING_POOL_CHUNK_SIZE      65536   /* Bytes of string storage allocated at a time. */
+#define STRING_POOL_INITIAL_SLOTS   1024    /* Hash slots to start with, doubles as it fills. */
+
+/**
+ * @brief Returns the interned copy of a string.
+ *
+ * @param str The string to intern. NULL interns as "".
+ * @return The pooled string. Never NULL; "" if memory runs out.
+ */
+const char *intern_string(const char *str);
+
+/**
+ * @brief Interns "dir/file", the form every asset path in the config takes.
+ */
+const char *intern_path(const char *dir, const char *file);
+
+#endif /* STRING_POOL_H */
@@ -34,6 +34,7 @@ system_metrics_t system_metrics = {
    .system_temperature = 0.0f,
    .fan_rpm = -1,
    .fan_load = -1,
+   .wifi_level = 0,
    .battery_voltage = 0.0f,
    .battery_current = 0.0f,
    .battery_consumption = 0.0f,
@@ -61,12 +62,14 @@ system_metrics_t system_metrics = {
    .system_temp_update_time = 0,
    .fan_update_time = 0,
    .power_update_time = 0,
+   .wifi_update_time = 0,
 
    .cpu_available = false,
    .memory_available = false,
    .system_temp_available = false,
    .fan_available = false,
-   .power_available = false
+   .power_available = false,
+   .wifi_available = false
 };
 
 /**
@@ -80,6 +83,7 @@ void init_system_metrics(void)
    system_metrics.system_temperature = 0.0f;
    system_metrics.fan_rpm = -1;
    system_metrics.fan_load = -1;
+   system_metrics.wifi_level = 0;
    system_metrics.battery_voltage = 0.0f;
    system_metrics.battery_current = 0.0f;
    system_metrics.battery_consumption = 0.0f;
@@ -117,6 +121,7 @@ void init_system_metrics(void)
    system_metrics.system_temp_update_time = current_time;
    system_metrics.fan_update_time = current_time;
    system_metrics.power_update_time = current_time;
+   system_metrics.wifi_update_time = current_time;
 
    /* Set all metrics as unavailable initially */
    system_metrics.cpu_available = false;
@@ -124,6 +129,7 @@ void init_system_metrics(void)
    system_metrics.system_temp_available = false;
    system_metrics.fan_available = false;
    system_metrics.power_available = false;
+   system_metrics.wifi_available = false;
 
    LOG_INFO("System metrics initialized");
 }
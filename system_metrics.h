@@ -39,6 +39,7 @@ typedef struct {
    float system_temperature;   /* System junction temperature in Celsius */
    int fan_rpm;                /* Fan speed in RPM */
    int fan_load;               /* Fan load percentage (0-100) */
+   int wifi_level;             /* Wireless signal level (0-9) */
    float battery_voltage;      /* Bus voltage in volts */
    float battery_current;      /* Current in amps */
    float battery_consumption;  /* Power in watts */
@@ -70,6 +71,7 @@ typedef struct {
    time_t system_temp_update_time;
    time_t fan_update_time;
    time_t power_update_time;
+   time_t wifi_update_time;
 
    /* Status flags for each metric (true if valid/available) */
    bool cpu_available;
@@ -77,6 +79,7 @@ typedef struct {
    bool system_temp_available;
    bool fan_available;
    bool power_available;
+   bool wifi_available;
 } system_metrics_t;
 
 /* Declaration of global metrics structure */
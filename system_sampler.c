@@ -0,0 +1,353 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <glob.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config_manager.h"
+#include "defines.h"
+#include "logging.h"
+#include "system_metrics.h"
+#include "system_sampler.h"
+
+#define SAMPLER_READ_LENGTH   4096    /* Enough for /proc/net/dev, /proc/meminfo and /proc/stat's head. */
+#define SAMPLER_MAX_ZONES     16
+#define SAMPLER_MAX_SLEEP_MS  250     /* So stopping never waits long. */
+
+typedef struct {
+   int interval_ms;                   /* 0 when not sampled here. */
+   unsigned long next_ms;
+} sample_schedule;
+
+static sample_schedule schedule[SAMPLE_COUNT];
+
+static int wifi_fd = -1;
+static int stat_fd = -1;
+static int meminfo_fd = -1;
+static int fan_fd = -1;
+static int zone_fds[SAMPLER_MAX_ZONES];
+static int zone_count = 0;
+
+/* Previous /proc/stat totals for the CPU delta. */
+static unsigned long long cpu_prev_total = 0;
+static unsigned long long cpu_prev_idle = 0;
+
+static pthread_t sampler_thread;
+static volatile int sampler_running = 0;
+
+static unsigned long sampler_now_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (unsigned long) ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
+}
+
+/* Re-read a whole pseudo file from the start. Returns bytes read or -1. */
+static ssize_t sampler_read(int fd, char *buf, size_t size)
+{
+   ssize_t len = pread(fd, buf, size - 1, 0);
+
+   if (len < 0) {
+      return -1;
+   }
+   buf[len] = '\0';
+
+   return len;
+}
+
+static void sample_wifi(void)
+{
+   char buf[SAMPLER_READ_LENGTH];
+   char s_signal[7];
+   char *found = NULL;
+   int signal = -1;
+   int level = 0;               /* 0-9 based on -30 to -90 dBm) */
+
+   if (sampler_read(wifi_fd, buf, sizeof(buf)) < 0) {
+      return;
+   }
+
+   /* Same line and column as the old per-draw scan. */
+   for (char *line = strtok(buf, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+      if ((found = strstr(line, get_wifi_dev_name())) != NULL) {
+         break;
+      }
+   }
+
+   if ((found != NULL) && (strlen(found) > 19)) {
+      memset((void *)s_signal, '\0', 7);
+      strncpy(s_signal, &found[19], 6);
+      signal = atoi(s_signal);
+
+      // Map from 0-9. Arduino map equation.
+      if (signal == 0) {
+         level = 0;
+      } else if (signal > 0) {
+         level = round((double)signal / 10.0);
+      } else {
+         level = (signal - -90) * (9 - 0) / (-30 - -90) + 0;
+      }
+   }
+   if (level > 9)
+      level = 9;
+   if (level < 0)
+      level = 0;
+
+   system_metrics.wifi_level = level;
+   system_metrics.wifi_update_time = time(NULL);
+   system_metrics.wifi_available = (found != NULL);
+}
+
+static void sample_cpu(void)
+{
+   char buf[SAMPLER_READ_LENGTH];
+   unsigned long long user = 0, nice = 0, sys = 0, idle = 0, iowait = 0;
+   unsigned long long irq = 0, softirq = 0, steal = 0;
+   unsigned long long total = 0, idle_all = 0;
+
+   if ((sampler_read(stat_fd, buf, sizeof(buf)) < 0) ||
+       (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &sys, &idle,
+               &iowait, &irq, &softirq, &steal) < 4)) {
+      return;
+   }
+
+   total = user + nice + sys + idle + iowait + irq + softirq + steal;
+   idle_all = idle + iowait;
+
+   /* The first read only primes the totals. */
+   if ((cpu_prev_total != 0) && (total > cpu_prev_total)) {
+      unsigned long long d_total = total - cpu_prev_total;
+      unsigned long long d_idle = idle_all - cpu_prev_idle;
+
+      system_metrics.cpu_usage = 100.0f * (float) (d_total - d_idle) / (float) d_total;
+      system_metrics.cpu_update_time = time(NULL);
+      system_metrics.cpu_available = true;
+   }
+
+   cpu_prev_total = total;
+   cpu_prev_idle = idle_all;
+}
+
+static void sample_memory(void)
+{
+   char buf[SAMPLER_READ_LENGTH];
+   char *field = NULL;
+   unsigned long total_kb = 0, available_kb = 0;
+
+   if (sampler_read(meminfo_fd, buf, sizeof(buf)) < 0) {
+      return;
+   }
+
+   if ((field = strstr(buf, "MemTotal:")) != NULL) {
+      total_kb = strtoul(field + strlen("MemTotal:"), NULL, 10);
+   }
+   if ((field = strstr(buf, "MemAvailable:")) != NULL) {
+      available_kb = strtoul(field + strlen("MemAvailable:"), NULL, 10);
+   }
+
+   if ((total_kb > 0) && (available_kb <= total_kb)) {
+      system_metrics.memory_usage = 100.0f * (float) (total_kb - available_kb) / (float) total_kb;
+      system_metrics.memory_update_time = time(NULL);
+      system_metrics.memory_available = true;
+   }
+}
+
+/* Hottest thermal zone, which is what the governor and the gauge care about. */
+static void sample_thermal(void)
+{
+   char buf[32];
+   long hottest = -1000000;
+
+   for (int i = 0; i < zone_count; i++) {
+      if (sampler_read(zone_fds[i], buf, sizeof(buf)) > 0) {
+         long milli_c = strtol(buf, NULL, 10);
+
+         if (milli_c > hottest) {
+            hottest = milli_c;
+         }
+      }
+   }
+
+   if (hottest > -1000000) {
+      system_metrics.system_temperature = (float) hottest / 1000.0f;
+      system_metrics.system_temp_update_time = time(NULL);
+      system_metrics.system_temp_available = true;
+   }
+}
+
+static void sample_fan(void)
+{
+   char buf[32];
+   int rpm = 0;
+
+   if (sampler_read(fan_fd, buf, sizeof(buf)) <= 0) {
+      return;
+   }
+
+   rpm = atoi(buf);
+   system_metrics.fan_rpm = rpm;
+   system_metrics.fan_load = rpm >= FAN_MAX_RPM ? 100 : (rpm * 100) / FAN_MAX_RPM;
+   system_metrics.fan_update_time = time(NULL);
+   system_metrics.fan_available = true;
+}
+
+static void (*const samplers[SAMPLE_COUNT])(void) = {
+   sample_wifi,
+   sample_cpu,
+   sample_memory,
+   sample_thermal,
+   sample_fan
+};
+
+static void *system_sampler_thread(void *arg)
+{
+   while (sampler_running) {
+      unsigned long now = sampler_now_ms();
+      unsigned long sleep_ms = SAMPLER_MAX_SLEEP_MS;
+      struct timespec delay;
+
+      for (int m = 0; m < SAMPLE_COUNT; m++) {
+         if (schedule[m].interval_ms <= 0) {
+            continue;
+         }
+
+         if (now >= schedule[m].next_ms) {
+            samplers[m]();
+            schedule[m].next_ms = now + schedule[m].interval_ms;
+         }
+         if (schedule[m].next_ms - now < sleep_ms) {
+            sleep_ms = schedule[m].next_ms - now;
+         }
+      }
+
+      delay.tv_sec = sleep_ms / 1000;
+      delay.tv_nsec = (sleep_ms % 1000) * 1000000L;
+      nanosleep(&delay, NULL);
+   }
+
+   return NULL;
+}
+
+/* Opens a source or turns its metric off. */
+static int sampler_open(sample_metric_t metric, const char *path)
+{
+   int fd = -1;
+
+   if (schedule[metric].interval_ms <= 0) {
+      return -1;
+   }
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      LOG_WARNING("Unable to open %s, not sampling it.", path);
+      schedule[metric].interval_ms = 0;
+   }
+
+   return fd;
+}
+
+int system_sampler_start(void)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   glob_t zones;
+
+   schedule[SAMPLE_WIFI].interval_ms = this_hds->sample_wifi_ms;
+   schedule[SAMPLE_CPU].interval_ms = this_hds->sample_cpu_ms;
+   schedule[SAMPLE_MEMORY].interval_ms = this_hds->sample_memory_ms;
+   schedule[SAMPLE_THERMAL].interval_ms = this_hds->sample_thermal_ms;
+   schedule[SAMPLE_FAN].interval_ms = this_hds->sample_fan_ms;
+   for (int m = 0; m < SAMPLE_COUNT; m++) {
+      schedule[m].next_ms = 0;
+   }
+
+   wifi_fd = sampler_open(SAMPLE_WIFI, "/proc/net/dev");
+   stat_fd = sampler_open(SAMPLE_CPU, "/proc/stat");
+   meminfo_fd = sampler_open(SAMPLE_MEMORY, "/proc/meminfo");
+   fan_fd = sampler_open(SAMPLE_FAN, FAN_RPM_FILE);
+
+   zone_count = 0;
+   if ((schedule[SAMPLE_THERMAL].interval_ms > 0) &&
+       (glob("/sys/class/thermal/thermal_zone*/temp", 0, NULL, &zones) == 0)) {
+      for (size_t i = 0; (i < zones.gl_pathc) && (zone_count < SAMPLER_MAX_ZONES); i++) {
+         int fd = open(zones.gl_pathv[i], O_RDONLY | O_CLOEXEC);
+         if (fd >= 0) {
+            zone_fds[zone_count++] = fd;
+         }
+      }
+      globfree(&zones);
+   }
+   if (zone_count == 0) {
+      schedule[SAMPLE_THERMAL].interval_ms = 0;
+   }
+
+   sampler_running = 1;
+   if (pthread_create(&sampler_thread, NULL, system_sampler_thread, NULL) != 0) {
+      LOG_ERROR("Error creating system sampler thread.");
+      sampler_running = 0;
+      system_sampler_stop();
+      return FAILURE;
+   }
+
+   LOG_INFO("System sampler: wifi %d ms, cpu %d ms, memory %d ms, thermal %d ms (%d zones), "
+            "fan %d ms.", schedule[SAMPLE_WIFI].interval_ms, schedule[SAMPLE_CPU].interval_ms,
+            schedule[SAMPLE_MEMORY].interval_ms, schedule[SAMPLE_THERMAL].interval_ms, zone_count,
+            schedule[SAMPLE_FAN].interval_ms);
+
+   return SUCCESS;
+}
+
+void system_sampler_stop(void)
+{
+   if (sampler_running) {
+      sampler_running = 0;
+      pthread_join(sampler_thread, NULL);
+   }
+
+   if (wifi_fd >= 0) close(wifi_fd);
+   if (stat_fd >= 0) close(stat_fd);
+   if (meminfo_fd >= 0) close(meminfo_fd);
+   if (fan_fd >= 0) close(fan_fd);
+   wifi_fd = stat_fd = meminfo_fd = fan_fd = -1;
+
+   for (int i = 0; i < zone_count; i++) {
+      close(zone_fds[i]);
+   }
+   zone_count = 0;
+
+   for (int m = 0; m < SAMPLE_COUNT; m++) {
+      schedule[m].interval_ms = 0;
+   }
+}
+
+int system_sampler_owns(sample_metric_t metric)
+{
+   return (metric < SAMPLE_COUNT) && (schedule[metric].interval_ms > 0);
+}
@@ -0,0 +1,65 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef SYSTEM_SAMPLER_H
+#define SYSTEM_SAMPLER_H
+
+/* Local system sampling.
+ *
+ * One background thread reads /proc and sysfs at a configurable rate per
+ * metric and publishes the results into system_metrics, so drawing a gauge
+ * never costs a syscall. Files are opened once and re-read with pread().
+ *
+ * A metric sampled here is owned by the sampler: STAT messages for it are
+ * ignored so the two sources don't fight. A rate of 0 leaves it to STAT.
+ * STAT has no wifi level, so the config doesn't accept 0 for "Sample WiFi Ms".
+ */
+
+typedef enum {
+   SAMPLE_WIFI,
+   SAMPLE_CPU,
+   SAMPLE_MEMORY,
+   SAMPLE_THERMAL,
+   SAMPLE_FAN,
+   SAMPLE_COUNT
+} sample_metric_t;
+
+/**
+ * @brief Opens the sources and starts the sampler thread.
+ *
+ * Reads the per-metric rates from the display settings. Metrics whose source
+ * can't be opened are logged and skipped.
+ *
+ * @return SUCCESS, or FAILURE if the thread couldn't be started.
+ */
+int system_sampler_start(void);
+
+/**
+ * @brief Stops the sampler thread and closes its sources.
+ */
+void system_sampler_stop(void);
+
+/**
+ * @brief Returns non-zero if the sampler is the source for this metric.
+ */
+int system_sampler_owns(sample_metric_t metric);
+
+#endif /* SYSTEM_SAMPLER_H */
@@ -0,0 +1,465 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "logging.h"
+#include "mirage.h"
+#include "texture_atlas.h"
+
+#define TEXTURE_ATLAS_HASH_SIZE    (TEXTURE_ATLAS_MAX_ENTRIES * 2)
+#define TEXTURE_ATLAS_BATCH_GROW   256   /* Quads to grow the batch by. */
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+typedef struct {
+   SDL_Texture *tex;       /* Original texture, the lookup key. NULL if free. */
+   int page;
+   int x, y;               /* Position in the page. */
+   int w, h;
+} atlas_entry;
+
+typedef struct {
+   SDL_Texture *texture;
+   int width, height;
+} atlas_page;
+
+static atlas_entry entries[TEXTURE_ATLAS_HASH_SIZE];
+static atlas_page pages[TEXTURE_ATLAS_MAX_PAGES];
+static int page_count = 0;
+
+/* The pending batch. All queued quads belong to batch_page. */
+static SDL_Vertex *batch_vertices = NULL;
+static int *batch_indices = NULL;
+static int batch_quads = 0;
+static int batch_capacity = 0;
+static int batch_page = -1;
+
+static unsigned int atlas_hash(SDL_Texture *tex)
+{
+   uintptr_t key = (uintptr_t) tex;
+
+   key ^= key >> 16;
+   key *= 0x45d9f3b;
+   key ^= key >> 16;
+
+   return (unsigned int) (key % TEXTURE_ATLAS_HASH_SIZE);
+}
+
+static atlas_entry *atlas_find(SDL_Texture *tex)
+{
+   unsigned int slot = atlas_hash(tex);
+
+   for (int i = 0; i < TEXTURE_ATLAS_HASH_SIZE; i++) {
+      atlas_entry *entry = &entries[(slot + i) % TEXTURE_ATLAS_HASH_SIZE];
+
+      if (entry->tex == tex) {
+         return entry;
+      }
+      if ((entry->tex == NULL) && (entry->page >= 0)) {
+         /* Never used, so the key isn't further along the probe chain. */
+         return NULL;
+      }
+   }
+
+   return NULL;
+}
+
+static atlas_entry *atlas_insert(SDL_Texture *tex)
+{
+   unsigned int slot = atlas_hash(tex);
+
+   for (int i = 0; i < TEXTURE_ATLAS_HASH_SIZE; i++) {
+      atlas_entry *entry = &entries[(slot + i) % TEXTURE_ATLAS_HASH_SIZE];
+
+      if (entry->tex == NULL) {
+         entry->tex = tex;
+         return entry;
+      }
+   }
+
+   return NULL;
+}
+
+static void atlas_reset(void)
+{
+   texture_atlas_flush();
+
+   for (int i = 0; i < page_count; i++) {
+      SDL_DestroyTexture(pages[i].texture);
+      pages[i].texture = NULL;
+   }
+   page_count = 0;
+
+   /* page 0 with no texture marks a never used slot, -1 a forgotten one. */
+   memset(entries, 0, sizeof(entries));
+}
+
+static int atlas_new_page(SDL_Renderer *renderer, int width, int height)
+{
+   atlas_page *page = NULL;
+
+   if (page_count >= TEXTURE_ATLAS_MAX_PAGES) {
+      return FAILURE;
+   }
+
+   page = &pages[page_count];
+   page->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                     SDL_TEXTUREACCESS_TARGET, width, height);
+   if (page->texture == NULL) {
+      LOG_ERROR("Unable to create %dx%d atlas page: %s", width, height, SDL_GetError());
+      return FAILURE;
+   }
+   SDL_SetTextureBlendMode(page->texture, SDL_BLENDMODE_BLEND);
+   page->width = width;
+   page->height = height;
+
+   SDL_SetRenderTarget(renderer, page->texture);
+   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+   SDL_RenderClear(renderer);
+
+   page_count++;
+
+   return SUCCESS;
+}
+
+/* Copy a texture into its slot without blending so alpha lands unchanged. */
+static void atlas_blit(SDL_Renderer *renderer, atlas_entry *entry)
+{
+   SDL_BlendMode blend = SDL_BLENDMODE_BLEND;
+   Uint8 r = 255, g = 255, b = 255, a = 255;
+   SDL_Rect dst = { entry->x, entry->y, entry->w, entry->h };
+
+   SDL_GetTextureBlendMode(entry->tex, &blend);
+   SDL_GetTextureColorMod(entry->tex, &r, &g, &b);
+   SDL_GetTextureAlphaMod(entry->tex, &a);
+
+   SDL_SetTextureBlendMode(entry->tex, SDL_BLENDMODE_NONE);
+   SDL_SetTextureColorMod(entry->tex, 255, 255, 255);
+   SDL_SetTextureAlphaMod(entry->tex, 255);
+
+   SDL_RenderCopy(renderer, entry->tex, NULL, &dst);
+
+   SDL_SetTextureBlendMode(entry->tex, blend);
+   SDL_SetTextureColorMod(entry->tex, r, g, b);
+   SDL_SetTextureAlphaMod(entry->tex, a);
+}
+
+typedef struct {
+   SDL_Texture *tex;
+   int w, h;
+} atlas_item;
+
+static int atlas_item_compare(const void *a, const void *b)
+{
+   const atlas_item *ia = (const atlas_item *) a;
+   const atlas_item *ib = (const atlas_item *) b;
+
+   /* Tallest first packs shelves tighter. */
+   if (ia->h != ib->h) {
+      return ib->h - ia->h;
+   }
+
+   return ib->w - ia->w;
+}
+
+int texture_atlas_build(SDL_Texture **textures, int count)
+{
+   SDL_Renderer *renderer = get_sdl_renderer();
+   SDL_RendererInfo info;
+   SDL_Texture *prev_target = NULL;
+   atlas_item *items = NULL;
+   int item_count = 0;
+   int page_size = TEXTURE_ATLAS_PAGE_SIZE;
+   int shelf_x = 0, shelf_y = 0, shelf_h = 0;
+   int packed = 0;
+
+   atlas_reset();
+
+   if ((renderer == NULL) || (textures == NULL) || (count <= 0)) {
+      return FAILURE;
+   }
+
+   if ((SDL_GetRendererInfo(renderer, &info) != 0) ||
+       !(info.flags & SDL_RENDERER_TARGETTEXTURE)) {
+      LOG_WARNING("Renderer has no render target support, HUD batching disabled.");
+      return FAILURE;
+   }
+   if ((info.max_texture_width > 0) && (info.max_texture_width < page_size)) {
+      page_size = info.max_texture_width;
+   }
+   if ((info.max_texture_height > 0) && (info.max_texture_height < page_size)) {
+      page_size = info.max_texture_height;
+   }
+
+   items = malloc(sizeof(atlas_item) * count);
+   if (items == NULL) {
+      LOG_ERROR("Unable to malloc atlas item list.");
+      return FAILURE;
+   }
+
+   for (int i = 0; i < count; i++) {
+      SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+      int w = 0, h = 0;
+
+      if ((textures[i] == NULL) ||
+          (SDL_QueryTexture(textures[i], NULL, NULL, &w, &h) != 0)) {
+         continue;
+      }
+
+      /* Only blended assets are batched, anything else keeps its own draw. */
+      SDL_GetTextureBlendMode(textures[i], &blend);
+      if ((blend != SDL_BLENDMODE_BLEND) || (w + TEXTURE_ATLAS_PADDING > page_size) ||
+          (h + TEXTURE_ATLAS_PADDING > page_size) || (item_count >= TEXTURE_ATLAS_MAX_ENTRIES)) {
+         continue;
+      }
+
+      items[item_count].tex = textures[i];
+      items[item_count].w = w;
+      items[item_count].h = h;
+      item_count++;
+   }
+
+   if (item_count == 0) {
+      free(items);
+      return FAILURE;
+   }
+
+   qsort(items, item_count, sizeof(atlas_item), atlas_item_compare);
+
+   prev_target = SDL_GetRenderTarget(renderer);
+   if (atlas_new_page(renderer, page_size, page_size) != SUCCESS) {
+      free(items);
+      SDL_SetRenderTarget(renderer, prev_target);
+      return FAILURE;
+   }
+
+   /* Simple shelf packing: fill rows left to right, open a new row when the
+    * item doesn't fit and a new page when the row doesn't. */
+   for (int i = 0; i < item_count; i++) {
+      int w = items[i].w + TEXTURE_ATLAS_PADDING;
+      int h = items[i].h + TEXTURE_ATLAS_PADDING;
+      atlas_entry *entry = NULL;
+
+      if (shelf_x + w > page_size) {
+         shelf_y += shelf_h;
+         shelf_x = 0;
+         shelf_h = 0;
+      }
+      if (shelf_y + h > page_size) {
+         if (atlas_new_page(renderer, page_size, page_size) != SUCCESS) {
+            break;
+         }
+         shelf_x = shelf_y = shelf_h = 0;
+      }
+
+      entry = atlas_insert(items[i].tex);
+      if (entry == NULL) {
+         break;
+      }
+      entry->page = page_count - 1;
+      entry->x = shelf_x;
+      entry->y = shelf_y;
+      entry->w = items[i].w;
+      entry->h = items[i].h;
+
+      atlas_blit(renderer, entry);
+      packed++;
+
+      shelf_x += w;
+      if (h > shelf_h) {
+         shelf_h = h;
+      }
+   }
+
+   SDL_SetRenderTarget(renderer, prev_target);
+   free(items);
+
+   LOG_INFO("Texture atlas: packed %d of %d textures into %d page(s) of %dx%d.",
+            packed, count, page_count, page_size, page_size);
+
+   return SUCCESS;
+}
+
+void texture_atlas_forget(SDL_Texture *tex)
+{
+   atlas_entry *entry = NULL;
+
+   if (tex == NULL) {
+      return;
+   }
+
+   entry = atlas_find(tex);
+   if (entry != NULL) {
+      if (batch_page == entry->page) {
+         texture_atlas_flush();
+      }
+      /* Tombstone so later probes keep walking. The page space stays unused until rebuild. */
+      entry->tex = NULL;
+      entry->page = -1;
+   }
+}
+
+static int batch_reserve(int quads)
+{
+   SDL_Vertex *vertices = NULL;
+   int *indices = NULL;
+   int capacity = 0;
+
+   if (quads <= batch_capacity) {
+      return SUCCESS;
+   }
+
+   capacity = batch_capacity + TEXTURE_ATLAS_BATCH_GROW;
+   vertices = realloc(batch_vertices, sizeof(SDL_Vertex) * 4 * capacity);
+   if (vertices == NULL) {
+      return FAILURE;
+   }
+   batch_vertices = vertices;
+
+   indices = realloc(batch_indices, sizeof(int) * 6 * capacity);
+   if (indices == NULL) {
+      return FAILURE;
+   }
+   batch_indices = indices;
+
+   /* Index pattern never changes, fill it once per growth. */
+   for (int q = batch_capacity; q < capacity; q++) {
+      batch_indices[q * 6 + 0] = q * 4 + 0;
+      batch_indices[q * 6 + 1] = q * 4 + 1;
+      batch_indices[q * 6 + 2] = q * 4 + 2;
+      batch_indices[q * 6 + 3] = q * 4 + 2;
+      batch_indices[q * 6 + 4] = q * 4 + 3;
+      batch_indices[q * 6 + 5] = q * 4 + 0;
+   }
+   batch_capacity = capacity;
+
+   return SUCCESS;
+}
+
+int texture_atlas_draw(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst)
+{
+   atlas_entry *entry = NULL;
+   atlas_page *page = NULL;
+   SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+   SDL_Color color = { 255, 255, 255, 255 };
+   SDL_Vertex *v = NULL;
+   float u0, v0, u1, v1;
+   float x0, y0, x1, y1;
+
+   if ((page_count == 0) || (tex == NULL) || (src == NULL) || (dst == NULL)) {
+      return FAILURE;
+   }
+
+   entry = atlas_find(tex);
+   if (entry == NULL) {
+      return FAILURE;
+   }
+
+   SDL_GetTextureBlendMode(tex, &blend);
+   if (blend != SDL_BLENDMODE_BLEND) {
+      return FAILURE;
+   }
+
+   if (entry->page != batch_page) {
+      texture_atlas_flush();
+      batch_page = entry->page;
+   }
+   if (batch_reserve(batch_quads + 1) != SUCCESS) {
+      return FAILURE;
+   }
+
+   SDL_GetTextureColorMod(tex, &color.r, &color.g, &color.b);
+   SDL_GetTextureAlphaMod(tex, &color.a);
+
+   page = &pages[entry->page];
+   u0 = (float) (entry->x + src->x) / page->width;
+   v0 = (float) (entry->y + src->y) / page->height;
+   u1 = (float) (entry->x + src->x + src->w) / page->width;
+   v1 = (float) (entry->y + src->y + src->h) / page->height;
+
+   x0 = (float) dst->x;
+   y0 = (float) dst->y;
+   x1 = (float) (dst->x + dst->w);
+   y1 = (float) (dst->y + dst->h);
+
+   v = &batch_vertices[batch_quads * 4];
+   v[0] = (SDL_Vertex) { { x0, y0 }, color, { u0, v0 } };
+   v[1] = (SDL_Vertex) { { x1, y0 }, color, { u1, v0 } };
+   v[2] = (SDL_Vertex) { { x1, y1 }, color, { u1, v1 } };
+   v[3] = (SDL_Vertex) { { x0, y1 }, color, { u0, v1 } };
+   batch_quads++;
+
+   return SUCCESS;
+}
+
+void texture_atlas_flush(void)
+{
+   if ((batch_quads > 0) && (batch_page >= 0) && (batch_page < page_count)) {
+      if (SDL_RenderGeometry(get_sdl_renderer(), pages[batch_page].texture,
+                             batch_vertices, batch_quads * 4,
+                             batch_indices, batch_quads * 6) != 0) {
+         LOG_ERROR("SDL_RenderGeometry failed: %s", SDL_GetError());
+      }
+   }
+
+   batch_quads = 0;
+   batch_page = -1;
+}
+
+void texture_atlas_cleanup(void)
+{
+   atlas_reset();
+
+   free(batch_vertices);
+   free(batch_indices);
+   batch_vertices = NULL;
+   batch_indices = NULL;
+   batch_capacity = 0;
+}
+#else
+int texture_atlas_build(SDL_Texture **textures, int count)
+{
+   LOG_WARNING("SDL older than 2.0.18 has no SDL_RenderGeometry, HUD batching disabled.");
+
+   return FAILURE;
+}
+
+void texture_atlas_forget(SDL_Texture *tex)
+{
+}
+
+int texture_atlas_draw(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst)
+{
+   return FAILURE;
+}
+
+void texture_atlas_flush(void)
+{
+}
+
+void texture_atlas_cleanup(void)
+{
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <SDL2/SDL.h>
+
+/* Texture atlas and batched quad submission for HUD assets.
+ *
+ * At config load every cached asset texture is packed into a few large
+ * render target pages. Draws of packed textures are then queued as vertex
+ * quads and submitted with one SDL_RenderGeometry call per run of quads on
+ * the same page instead of one SDL_RenderCopy per eye per element.
+ *
+ * The original textures are kept. Elements still hold and query them, and
+ * anything that isn't packed, is rotated or uses a non-blended mode simply
+ * flushes the batch and draws directly, so draw order is always preserved.
+ */
+
+#define TEXTURE_ATLAS_PAGE_SIZE    4096  /* Preferred page width/height, clamped to the renderer max. */
+#define TEXTURE_ATLAS_MAX_PAGES    4
+#define TEXTURE_ATLAS_MAX_ENTRIES  512
+#define TEXTURE_ATLAS_PADDING      2     /* Transparent gutter to keep filtering from bleeding. */
+
+/**
+ * @brief Packs the given textures into atlas pages, replacing any previous atlas.
+ *
+ * Must be called from the render thread. Textures that don't fit are left out
+ * and keep drawing directly.
+ *
+ * @param textures Array of textures to pack. NULL entries are skipped.
+ * @param count    Number of entries in the array.
+ * @return SUCCESS if an atlas was built, FAILURE if batching is unavailable.
+ */
+int texture_atlas_build(SDL_Texture **textures, int count);
+
+/**
+ * @brief Drops a texture from the atlas, e.g. before it is destroyed on reload.
+ */
+void texture_atlas_forget(SDL_Texture *tex);
+
+/**
+ * @brief Queues a draw of a packed texture.
+ *
+ * The texture's current color and alpha mod are captured into the vertices.
+ *
+ * @param tex The original texture.
+ * @param src Source rectangle within the original texture.
+ * @param dst Destination rectangle.
+ * @return SUCCESS if queued. FAILURE if the caller must flush and draw directly.
+ */
+int texture_atlas_draw(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst);
+
+/**
+ * @brief Submits any queued quads. Call before any direct draw and at frame end.
+ */
+void texture_atlas_flush(void);
+
+/**
+ * @brief Frees the atlas pages and batch buffers.
+ */
+void texture_atlas_cleanup(void);
+
+#endif /* TEXTURE_ATLAS_H */
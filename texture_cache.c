@@ -0,0 +1,688 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "SDL2/SDL_image.h"
+
+#include "asset_bundle.h"
+#include "config_manager.h"
+#include "defines.h"
+#include "hud_manager.h"
+#include "logging.h"
+#include "mirage.h"
+#include "texture_atlas.h"
+#include "texture_cache.h"
+
+#define TEXTURE_CACHE_EVENT_BUFFER  4096
+
+typedef struct _texture_cache {
+   SDL_Texture *texture;
+   char *filename;            /* Owned copy of the path, the hash key. */
+   const char *basename;      /* Points into filename, matched against inotify events. */
+   uint32_t hash;
+   int watch_dir;             /* Index into watch_dirs, -1 if not watched. */
+
+   int refcount;
+   int preloaded;             /* Loaded ahead of use, not evicted before the first get. */
+   size_t bytes;              /* Approximate VRAM used by the texture. */
+   unsigned long last_used;   /* lookup_tick at the last get. */
+   atomic_int stale;          /* Set by the watcher, cleared on reload. */
+
+   struct _texture_cache *hash_next;
+   struct _texture_cache *next;        /* Every entry, in load order. */
+} texture_cache;
+
+typedef struct {
+   int wd;
+   char path[MAX_FILENAME_LENGTH * 2];
+} watch_dir;
+
+static texture_cache *buckets[TEXTURE_CACHE_BUCKETS];
+static texture_cache *texture_list = NULL;
+static texture_cache *texture_list_tail = NULL;
+static size_t total_bytes = 0;
+static unsigned long lookup_tick = 0;
+
+/* Guards the entries and watch list against the watcher thread. */
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int stale_count = 0;
+
+static watch_dir watch_dirs[TEXTURE_CACHE_MAX_WATCH_DIRS];
+static int watch_dir_count = 0;
+static int inotify_fd = -1;
+static pthread_t watcher_thread;
+static int watcher_running = 0;
+static atomic_int watcher_stop = 0;
+
+/* FNV-1a. */
+static uint32_t path_hash(const char *path)
+{
+   uint32_t hash = 2166136261u;
+
+   while (*path != '\0') {
+      hash ^= (unsigned char) *path++;
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+static size_t texture_bytes(SDL_Texture *texture)
+{
+   Uint32 format = 0;
+   int w = 0, h = 0;
+
+   if (SDL_QueryTexture(texture, &format, NULL, &w, &h) != 0) {
+      return 0;
+   }
+
+   return (size_t) w * h * SDL_BYTESPERPIXEL(format);
+}
+
+/* Marks every entry in the changed directory with a matching name. */
+static void mark_stale(int wd, const char *name)
+{
+   int dir = -1;
+
+   pthread_mutex_lock(&cache_mutex);
+   for (int i = 0; i < watch_dir_count; i++) {
+      if (watch_dirs[i].wd == wd) {
+         dir = i;
+         break;
+      }
+   }
+
+   for (texture_cache *entry = texture_list; (dir >= 0) && (entry != NULL); entry = entry->next) {
+      if ((entry->watch_dir == dir) && (strcmp(entry->basename, name) == 0) &&
+          !atomic_exchange(&entry->stale, 1)) {
+         atomic_fetch_add(&stale_count, 1);
+      }
+   }
+   pthread_mutex_unlock(&cache_mutex);
+}
+
+static void *texture_watcher_thread(void *arg)
+{
+   char buffer[TEXTURE_CACHE_EVENT_BUFFER]
+       __attribute__ ((aligned(__alignof__(struct inotify_event))));
+   struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+
+   while (!checkShutdown() && !atomic_load(&watcher_stop)) {
+      int ready = poll(&pfd, 1, TEXTURE_CACHE_POLL_MS);
+      ssize_t len = 0;
+
+      if (ready <= 0) {
+         if ((ready < 0) && (errno != EINTR)) {
+            LOG_ERROR("Texture watcher poll failed: %s", strerror(errno));
+            break;
+         }
+         continue;
+      }
+
+      len = read(inotify_fd, buffer, sizeof(buffer));
+      for (char *ptr = buffer; ptr < buffer + len; ) {
+         struct inotify_event *event = (struct inotify_event *) ptr;
+
+         if (event->len > 0) {
+            mark_stale(event->wd, event->name);
+         }
+         ptr += sizeof(struct inotify_event) + event->len;
+      }
+
+      if (atomic_load(&stale_count) > 0) {
+         hud_mark_damaged();
+      }
+   }
+
+   return NULL;
+}
+
+/* Adds a watch on the entry's directory, starting the watcher if needed.
+ * Called with cache_mutex held. */
+static void watch_entry(texture_cache *entry)
+{
+   char dir[MAX_FILENAME_LENGTH * 2];
+   size_t dir_len = entry->basename - entry->filename;
+   int wd = -1;
+
+   if (dir_len == 0) {
+      strcpy(dir, ".");
+   } else {
+      if (dir_len >= sizeof(dir)) {
+         return;
+      }
+      memcpy(dir, entry->filename, dir_len);
+      dir[dir_len] = '\0';
+   }
+
+   for (int i = 0; i < watch_dir_count; i++) {
+      if (strcmp(watch_dirs[i].path, dir) == 0) {
+         entry->watch_dir = i;
+         return;
+      }
+   }
+
+   if (inotify_fd < 0) {
+      inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (inotify_fd < 0) {
+         LOG_WARNING("inotify unavailable, texture hot reload disabled: %s", strerror(errno));
+         return;
+      }
+   }
+
+   if (!watcher_running) {
+      atomic_store(&watcher_stop, 0);
+      if (pthread_create(&watcher_thread, NULL, texture_watcher_thread, NULL) != 0) {
+         LOG_WARNING("Unable to start texture watcher, hot reload disabled.");
+         close(inotify_fd);
+         inotify_fd = -1;
+         return;
+      }
+      watcher_running = 1;
+   }
+
+   if (watch_dir_count >= TEXTURE_CACHE_MAX_WATCH_DIRS) {
+      LOG_WARNING("Too many texture directories to watch, not watching: %s", dir);
+      return;
+   }
+
+   /* Editors either rewrite the file or rename a temp file over it. */
+   wd = inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+   if (wd < 0) {
+      LOG_WARNING("Unable to watch texture directory %s: %s", dir, strerror(errno));
+      return;
+   }
+
+   watch_dirs[watch_dir_count].wd = wd;
+   strncpy(watch_dirs[watch_dir_count].path, dir, sizeof(watch_dirs[0].path) - 1);
+   watch_dirs[watch_dir_count].path[sizeof(watch_dirs[0].path) - 1] = '\0';
+   entry->watch_dir = watch_dir_count++;
+}
+
+/* Removes an entry from both lists. Called with cache_mutex held. */
+static void unlink_entry(texture_cache *entry)
+{
+   texture_cache **link = &buckets[entry->hash & (TEXTURE_CACHE_BUCKETS - 1)];
+   texture_cache *prev = NULL;
+
+   while (*link != entry) {
+      link = &(*link)->hash_next;
+   }
+   *link = entry->hash_next;
+
+   for (texture_cache *this = texture_list; this != entry; this = this->next) {
+      prev = this;
+   }
+   if (prev == NULL) {
+      texture_list = entry->next;
+   } else {
+      prev->next = entry->next;
+   }
+   if (texture_list_tail == entry) {
+      texture_list_tail = prev;
+   }
+
+   if (atomic_load(&entry->stale)) {
+      atomic_fetch_sub(&stale_count, 1);
+   }
+   total_bytes -= entry->bytes;
+}
+
+/* Evicts unreferenced entries, oldest first, until we're under budget. */
+static void enforce_budget(texture_cache *keep)
+{
+   hud_display_settings *this_hds = get_hud_display_settings();
+   size_t budget = (size_t) this_hds->texture_cache_mb * 1024 * 1024;
+
+   if (budget == 0) {
+      return;
+   }
+
+   while (total_bytes > budget) {
+      texture_cache *oldest = NULL;
+
+      for (texture_cache *entry = texture_list; entry != NULL; entry = entry->next) {
+         if ((entry != keep) && (entry->refcount <= 0) && !entry->preloaded &&
+             ((oldest == NULL) || (entry->last_used < oldest->last_used))) {
+            oldest = entry;
+         }
+      }
+      if (oldest == NULL) {
+         break;
+      }
+
+      LOG_INFO("Evicting unused texture: %s", oldest->filename);
+      pthread_mutex_lock(&cache_mutex);
+      unlink_entry(oldest);
+      pthread_mutex_unlock(&cache_mutex);
+
+      texture_atlas_forget(oldest->texture);
+      SDL_DestroyTexture(oldest->texture);
+      free(oldest->filename);
+      free(oldest);
+   }
+}
+
+/* Reloads a stale entry. Same sized images are uploaded into the existing
+ * texture, otherwise the entry's texture is replaced in every element. */
+static void reload_entry(texture_cache *entry)
+{
+   SDL_Renderer *renderer = get_sdl_renderer();
+   SDL_Surface *surface = NULL;
+   SDL_Surface *converted = NULL;
+   SDL_Texture *replacement = NULL;
+   SDL_BlendMode blend = SDL_BLENDMODE_BLEND;
+   Uint32 format = 0;
+   int w = 0, h = 0;
+
+   if (atomic_exchange(&entry->stale, 0)) {
+      atomic_fetch_sub(&stale_count, 1);
+   }
+
+   LOG_INFO("Texture file modified, reloading: %s", entry->filename);
+
+   surface = IMG_Load(entry->filename);
+   if (surface == NULL) {
+      /* Probably caught mid write. The next close will mark it again. */
+      LOG_WARNING("Error reloading modified texture: %s - %s", entry->filename, SDL_GetError());
+      return;
+   }
+
+   SDL_QueryTexture(entry->texture, &format, NULL, &w, &h);
+   if ((surface->w == w) && (surface->h == h)) {
+      converted = SDL_ConvertSurfaceFormat(surface, format, 0);
+      if ((converted != NULL) &&
+          (SDL_UpdateTexture(entry->texture, NULL, converted->pixels, converted->pitch) == 0)) {
+         texture_atlas_forget(entry->texture);
+         SDL_FreeSurface(converted);
+         SDL_FreeSurface(surface);
+         hud_mark_damaged();
+         return;
+      }
+      SDL_FreeSurface(converted);
+   }
+
+   /* The size changed, so we need a new texture. Elements hold the pointer
+    * from parse time, hand them the new one before the old one goes. */
+   replacement = SDL_CreateTextureFromSurface(renderer, surface);
+   SDL_FreeSurface(surface);
+   if (replacement == NULL) {
+      LOG_ERROR("Error reloading modified texture: %s - %s", entry->filename, SDL_GetError());
+      return;
+   }
+
+   if (SDL_GetTextureBlendMode(entry->texture, &blend) == 0) {
+      SDL_SetTextureBlendMode(replacement, blend);
+   }
+
+   texture_atlas_forget(entry->texture);
+   retarget_element_textures(entry->texture, replacement);
+   SDL_DestroyTexture(entry->texture);
+
+   total_bytes -= entry->bytes;
+   entry->texture = replacement;
+   entry->bytes = texture_bytes(replacement);
+   total_bytes += entry->bytes;
+   hud_mark_damaged();
+}
+
+/* Decode an image file. Images baked into the asset bundle are wrapped
+ * straight out of the mapping. Safe to call from any thread. */
+static SDL_Surface *load_surface(const char *filename)
+{
+   int w = 0, h = 0;
+   const void *pixels = asset_bundle_find_image(filename, &w, &h);
+
+   if (pixels != NULL) {
+      /* SDL only reads these pixels, the mapping is read-only. */
+      return SDL_CreateRGBSurfaceWithFormatFrom((void *) pixels, w, h, 32, w * 4,
+                                                SDL_PIXELFORMAT_RGBA32);
+   }
+
+   return IMG_Load(filename);
+}
+
+static texture_cache *find_entry(const char *filename, uint32_t hash)
+{
+   texture_cache *this_texture = NULL;
+
+   for (this_texture = buckets[hash & (TEXTURE_CACHE_BUCKETS - 1)]; this_texture != NULL;
+        this_texture = this_texture->hash_next) {
+      if ((this_texture->hash == hash) && (strcmp(filename, this_texture->filename) == 0)) {
+         return this_texture;
+      }
+   }
+
+   return NULL;
+}
+
+/* Upload a decoded surface and add it to the cache. The surface is freed. */
+static texture_cache *add_entry(const char *filename, uint32_t hash, SDL_Surface *surface,
+                                int refcount)
+{
+   texture_cache *this_texture = NULL;
+   const char *slash = NULL;
+
+   this_texture = calloc(1, sizeof(texture_cache));
+   if (this_texture == NULL) {
+      LOG_ERROR("Unable to malloc texture cache entry");
+      SDL_FreeSurface(surface);
+      return NULL;
+   }
+
+   this_texture->filename = strdup(filename);
+   if (this_texture->filename == NULL) {
+      LOG_ERROR("Unable to malloc texture cache filename");
+      free(this_texture);
+      SDL_FreeSurface(surface);
+      return NULL;
+   }
+
+   this_texture->texture = SDL_CreateTextureFromSurface(get_sdl_renderer(), surface);
+   SDL_FreeSurface(surface);
+   if (!this_texture->texture) {
+      LOG_ERROR("Error loading texture: %s - %s", filename, SDL_GetError());
+      free(this_texture->filename);
+      free(this_texture);
+      return NULL;
+   }
+
+   slash = strrchr(this_texture->filename, '/');
+   this_texture->basename = (slash != NULL) ? slash + 1 : this_texture->filename;
+   this_texture->hash = hash;
+   this_texture->watch_dir = -1;
+   this_texture->refcount = refcount;
+   this_texture->preloaded = (refcount == 0);
+   this_texture->bytes = texture_bytes(this_texture->texture);
+   this_texture->last_used = ++lookup_tick;
+
+   pthread_mutex_lock(&cache_mutex);
+   this_texture->hash_next = buckets[hash & (TEXTURE_CACHE_BUCKETS - 1)];
+   buckets[hash & (TEXTURE_CACHE_BUCKETS - 1)] = this_texture;
+   if (texture_list_tail == NULL) {
+      texture_list = this_texture;
+   } else {
+      texture_list_tail->next = this_texture;
+   }
+   texture_list_tail = this_texture;
+   total_bytes += this_texture->bytes;
+   watch_entry(this_texture);
+   pthread_mutex_unlock(&cache_mutex);
+
+   enforce_budget(this_texture);
+
+   return this_texture;
+}
+
+/**
+ * Retrieves a texture from the texture cache or loads it if not present.
+ */
+SDL_Texture *get_cached_texture(const char *filename) {
+   texture_cache *this_texture = NULL;
+   SDL_Surface *surface = NULL;
+   uint32_t hash = 0;
+
+   if (filename == NULL || filename[0] == '\0') {
+      LOG_WARNING("Invalid texture filename: NULL or empty");
+      return NULL;
+   }
+
+   if (get_sdl_renderer() == NULL) {
+      LOG_ERROR("No SDL renderer available for texture loading");
+      return NULL;
+   }
+
+   hash = path_hash(filename);
+   this_texture = find_entry(filename, hash);
+   if (this_texture != NULL) {
+      if (atomic_load_explicit(&this_texture->stale, memory_order_relaxed)) {
+         reload_entry(this_texture);
+      }
+      this_texture->refcount++;
+      this_texture->preloaded = 0;
+      this_texture->last_used = ++lookup_tick;
+
+      return this_texture->texture;
+   }
+
+   /* Texture not found in cache, create new cache entry */
+   surface = load_surface(filename);
+   if (surface == NULL) {
+      LOG_ERROR("Error loading texture: %s - %s", filename, SDL_GetError());
+      return NULL;
+   }
+
+   this_texture = add_entry(filename, hash, surface, 1);
+
+   return (this_texture != NULL) ? this_texture->texture : NULL;
+}
+
+typedef struct {
+   const char *filename;
+   uint32_t hash;
+   SDL_Surface *surface;
+} preload_job;
+
+typedef struct {
+   preload_job *jobs;
+   int count;
+   atomic_int next;
+} preload_queue;
+
+static void *preload_worker(void *arg)
+{
+   preload_queue *queue = (preload_queue *) arg;
+   int i = 0;
+
+   while ((i = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+      queue->jobs[i].surface = load_surface(queue->jobs[i].filename);
+   }
+
+   return NULL;
+}
+
+/**
+ * Decodes the uncached files in parallel, then uploads them here.
+ */
+int preload_textures(const char * const *filenames, int count)
+{
+   pthread_t threads[TEXTURE_PRELOAD_THREADS];
+   int thread_count = 0;
+   preload_queue queue;
+   Uint32 start = SDL_GetTicks();
+   int loaded = 0;
+
+   if ((count <= 0) || (get_sdl_renderer() == NULL)) {
+      return 0;
+   }
+
+   queue.jobs = calloc(count, sizeof(preload_job));
+   if (queue.jobs == NULL) {
+      LOG_ERROR("Unable to malloc texture preload jobs.");
+      return 0;
+   }
+   queue.count = 0;
+   atomic_init(&queue.next, 0);
+
+   for (int i = 0; i < count; i++) {
+      uint32_t hash = 0;
+
+      if ((filenames[i] == NULL) || (filenames[i][0] == '\0')) {
+         continue;
+      }
+      hash = path_hash(filenames[i]);
+      if (find_entry(filenames[i], hash) != NULL) {
+         continue;
+      }
+      queue.jobs[queue.count].filename = filenames[i];
+      queue.jobs[queue.count].hash = hash;
+      queue.count++;
+   }
+
+   if (queue.count == 0) {
+      free(queue.jobs);
+      return 0;
+   }
+
+   /* This thread decodes too, so one job needs no helpers. */
+   while ((thread_count < TEXTURE_PRELOAD_THREADS) && (thread_count < queue.count - 1)) {
+      if (pthread_create(&threads[thread_count], NULL, preload_worker, &queue) != 0) {
+         break;
+      }
+      thread_count++;
+   }
+   preload_worker(&queue);
+   for (int i = 0; i < thread_count; i++) {
+      pthread_join(threads[i], NULL);
+   }
+
+   /* Uploads have to happen on the render thread. */
+   for (int i = 0; i < queue.count; i++) {
+      if (queue.jobs[i].surface == NULL) {
+         LOG_WARNING("Unable to preload texture: %s - %s", queue.jobs[i].filename, SDL_GetError());
+         continue;
+      }
+      if (add_entry(queue.jobs[i].filename, queue.jobs[i].hash, queue.jobs[i].surface, 0) != NULL) {
+         loaded++;
+      }
+   }
+   free(queue.jobs);
+
+   LOG_INFO("Preloaded %d textures in %u ms.", loaded, SDL_GetTicks() - start);
+
+   return loaded;
+}
+
+/**
+ * Gives back a reference taken by get_cached_texture().
+ */
+void release_cached_texture(const char *filename)
+{
+   texture_cache *entry = NULL;
+
+   if ((filename == NULL) || (filename[0] == '\0')) {
+      return;
+   }
+
+   entry = find_entry(filename, path_hash(filename));
+   if ((entry != NULL) && (entry->refcount > 0)) {
+      entry->refcount--;
+   }
+}
+
+/**
+ * Reloads any cached textures the watcher has marked as changed.
+ */
+int refresh_stale_textures(void)
+{
+   int reloaded = 0;
+
+   if (atomic_load_explicit(&stale_count, memory_order_relaxed) == 0) {
+      return 0;
+   }
+
+   for (texture_cache *entry = texture_list; entry != NULL; entry = entry->next) {
+      if (atomic_load(&entry->stale)) {
+         reload_entry(entry);
+         reloaded++;
+      }
+   }
+
+   return reloaded;
+}
+
+/*
+ * Packs every cached texture into the HUD texture atlas.
+ */
+int build_texture_atlas(void) {
+   texture_cache *this_texture = texture_list;
+   SDL_Texture **textures = NULL;
+   int count = 0;
+   int rc = FAILURE;
+
+   for (; this_texture != NULL; this_texture = this_texture->next) {
+      count++;
+   }
+   if (count == 0) {
+      return FAILURE;
+   }
+
+   textures = malloc(sizeof(SDL_Texture *) * count);
+   if (textures == NULL) {
+      LOG_ERROR("Unable to malloc texture atlas list.");
+      return FAILURE;
+   }
+
+   count = 0;
+   for (this_texture = texture_list; this_texture != NULL; this_texture = this_texture->next) {
+      textures[count++] = this_texture->texture;
+   }
+
+   rc = texture_atlas_build(textures, count);
+   free(textures);
+
+   return rc;
+}
+
+/**
+ * Stops the watcher and destroys every cached texture.
+ */
+void texture_cache_cleanup(void)
+{
+   texture_cache *this_tex = NULL;
+
+   if (watcher_running) {
+      atomic_store(&watcher_stop, 1);
+      pthread_join(watcher_thread, NULL);
+      watcher_running = 0;
+   }
+   if (inotify_fd >= 0) {
+      close(inotify_fd);
+      inotify_fd = -1;
+   }
+   watch_dir_count = 0;
+
+   this_tex = texture_list;
+   while (this_tex != NULL) {
+      texture_cache *next_tex = this_tex->next;
+      if (this_tex->texture) {
+         SDL_DestroyTexture(this_tex->texture);
+      }
+      free(this_tex->filename);
+      free(this_tex);
+      this_tex = next_tex;
+   }
+   texture_list = NULL;
+   texture_list_tail = NULL;
+   memset(buckets, 0, sizeof(buckets));
+   total_bytes = 0;
+   atomic_store(&stale_count, 0);
+}
@@ -0,0 +1,112 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * By contributing to this project, you agree to license your contributions
+ * under the GPLv3 (or any later version) or any future licenses chosen by
+ * the project author(s). Contributions include any modifications,
+ * enhancements, or additions to the project. These contributions become
+ * part of the project and are adopted by the project author(s).
+ */
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <SDL2/SDL.h>
+
+/* Cache of textures loaded from image files.
+ *
+ * Entries live in a hash table keyed by path, so a lookup is one hash and
+ * usually one string compare. Each get takes a reference that the element
+ * gives back when it is freed. If a VRAM budget is set, the least recently
+ * used entries nobody references are evicted to stay under it.
+ *
+ * Lookups never touch the filesystem. An inotify thread watches the
+ * directories of cached files and marks entries stale when they're rewritten;
+ * the render thread reloads them in place from refresh_stale_textures().
+ */
+
+#define TEXTURE_CACHE_BUCKETS          256   /* Hash buckets, must be a power of two. */
+#define TEXTURE_CACHE_MAX_WATCH_DIRS   64    /* Distinct asset directories watched for changes. */
+#define TEXTURE_CACHE_POLL_MS          250   /* Watcher wakes this often to check for shutdown. */
+#define TEXTURE_PRELOAD_THREADS        4     /* Decode helpers used by preload_textures(). */
+
+/**
+ * @brief Retrieves a texture from the texture cache or loads it if not present.
+ *
+ * This function manages a cache of loaded SDL textures to avoid repeatedly loading
+ * the same texture resources. If the requested texture is already in the cache it
+ * is returned, reloading it first if the watcher saw the file change; otherwise,
+ * it is loaded from disk, added to the cache, and returned. This dramatically
+ * improves performance during configuration reloads.
+ *
+ * Every successful call takes a reference, see release_cached_texture().
+ * Must be called from the render thread.
+ *
+ * @param filename Path to the image file.
+ * @return Pointer to the loaded SDL_Texture, or NULL if loading failed.
+ */
+SDL_Texture *get_cached_texture(const char *filename);
+
+/**
+ * @brief Loads a batch of textures into the cache ahead of their first use.
+ *
+ * Files that aren't cached yet are decoded in parallel on a small pool of
+ * threads, or taken from the asset bundle if it has them, then uploaded on
+ * the calling thread. Preloaded entries hold no reference, the first
+ * get_cached_texture() takes one. Until then they're exempt from the VRAM
+ * budget. Must be called from the render thread.
+ *
+ * @param filenames Paths to the image files. Duplicates should already be removed.
+ * @param count     Number of paths.
+ * @return The number of textures loaded.
+ */
+int preload_textures(const char * const *filenames, int count);
+
+/**
+ * @brief Gives back a reference taken by get_cached_texture().
+ *
+ * Textures with no references stay cached and are only destroyed if the
+ * cache needs room. Files that aren't cached are ignored.
+ *
+ * @param filename Path the reference was taken for. NULL is ignored.
+ */
+void release_cached_texture(const char *filename);
+
+/**
+ * @brief Reloads any cached textures the watcher has marked as changed.
+ *
+ * Cheap when nothing changed. Call once per frame from the render thread.
+ * Same sized images are updated in place. If the size changed, elements are
+ * pointed at the new texture and the old one is destroyed.
+ *
+ * @return The number of textures reloaded.
+ */
+int refresh_stale_textures(void);
+
+/**
+ * @brief Packs every texture currently in the texture cache into the HUD atlas.
+ *
+ * Called once the config has loaded all of its assets so unrotated element
+ * draws can be batched. Safe to call again after a reload; the atlas is rebuilt.
+ *
+ * @return SUCCESS if an atlas was built, FAILURE otherwise (rendering falls back to direct draws).
+ */
+int build_texture_atlas(void);
+
+/**
+ * @brief Stops the watcher and destroys every cached texture.
+ */
+void texture_cache_cleanup(void);
+
+#endif /* TEXTURE_CACHE_H */
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Bake the assets a config references into one mmap-able bundle.
+
+Every image is decoded to raw RGBA and every animation JSON is parsed into a
+frame table, so mirage can map the bundle at startup instead of inflating
+PNGs and parsing JSON. The layout is documented in asset_bundle.h.
+
+Entries remember the source file's mtime and size. mirage ignores an entry
+once its source changes, so rebake after editing assets to keep startup fast.
+
+Requires Pillow.
+"""
+import argparse
+import json
+import os
+import struct
+import sys
+
+from PIL import Image
+
+BUNDLE_MAGIC = b"MIRBUNDL"
+BUNDLE_VERSION = 1
+BUNDLE_ALIGN = 16
+BUNDLE_FILENAME = "assets.bundle"
+IMAGE_PATH_DEFAULT = "ui_assets/mk2/"
+
+TYPE_IMAGE = 1
+TYPE_FRAMES = 2
+
+HEADER = struct.Struct("<8sIIQQQ")
+ENTRY = struct.Struct("<IIqQQQIIII")
+FRAME = struct.Struct("<8hBBH")
+
+
+def is_asset_key(key):
+    """Same rule as the loader: "file", "file_*" and "* file"."""
+    return key == "file" or key.startswith("file_") or key.endswith(" file")
+
+
+def clamp16(value):
+    return max(-32768, min(32767, int(value)))
+
+
+def frame_table(path):
+    """Frames in file order plus the sheet's meta image and format."""
+    with open(path, "r") as f:
+        data = json.load(f)
+
+    frames = []
+    for frame in data.get("frames", {}).values():
+        rect = frame.get("frame", {})
+        sprite = frame.get("spriteSourceSize", {})
+        source = frame.get("sourceSize", {})
+        frames.append(FRAME.pack(
+            clamp16(rect.get("x", 0)), clamp16(rect.get("y", 0)),
+            clamp16(rect.get("w", 0)), clamp16(rect.get("h", 0)),
+            clamp16(sprite.get("x", 0)), clamp16(sprite.get("y", 0)),
+            clamp16(source.get("w", 0)), clamp16(source.get("h", 0)),
+            1 if frame.get("rotated") else 0, 1 if frame.get("trimmed") else 0, 0))
+
+    meta = data.get("meta", {})
+    return frames, meta.get("image", ""), meta.get("format", "") or ""
+
+
+def collect(config, image_dir):
+    """Map bundle key -> (type, payload, width, height, image, format)."""
+    assets = {}
+
+    def add_image(key):
+        if key in assets:
+            return
+        path = os.path.join(image_dir, key)
+        try:
+            with Image.open(path) as img:
+                rgba = img.convert("RGBA")
+                assets[key] = (TYPE_IMAGE, rgba.tobytes(), rgba.width, rgba.height, "", "")
+        except OSError as e:
+            print("Skipping %s: %s" % (path, e), file=sys.stderr)
+
+    for section in ("Elements", "Components"):
+        for entry in config.get(section, []):
+            if not isinstance(entry, dict):
+                continue
+            for key, value in entry.items():
+                if not is_asset_key(key) or not isinstance(value, str):
+                    continue
+                name = value.lstrip("/")
+                if name.lower().endswith(".json"):
+                    if name in assets:
+                        continue
+                    try:
+                        frames, image, fmt = frame_table(os.path.join(image_dir, name))
+                    except (OSError, ValueError) as e:
+                        print("Skipping %s: %s" % (name, e), file=sys.stderr)
+                        continue
+                    if not frames:
+                        continue
+                    image = image.lstrip("/")
+                    assets[name] = (TYPE_FRAMES, b"".join(frames), len(frames), 0, image, fmt)
+                    add_image(image)
+                else:
+                    add_image(name)
+
+    return assets
+
+
+def align(offset):
+    return (offset + BUNDLE_ALIGN - 1) & ~(BUNDLE_ALIGN - 1)
+
+
+def write_bundle(assets, image_dir, output):
+    # The loader binary searches with strcmp, so sort by the encoded bytes.
+    keys = sorted(assets, key=lambda k: k.encode("utf-8"))
+
+    strings = bytearray(b"\0")
+    string_offsets = {"": 0}
+
+    def string(value):
+        if value not in string_offsets:
+            string_offsets[value] = len(strings)
+            strings.extend(value.encode("utf-8") + b"\0")
+        return string_offsets[value]
+
+    for key in keys:
+        string(key)
+        string(assets[key][4])
+        string(assets[key][5])
+
+    entries_offset = HEADER.size
+    strings_offset = entries_offset + len(keys) * ENTRY.size
+    data_offset = align(strings_offset + len(strings))
+
+    entries = bytearray()
+    payloads = []
+    for key in keys:
+        kind, payload, width, height, image, fmt = assets[key]
+        st = os.stat(os.path.join(image_dir, key))
+        entries.extend(ENTRY.pack(kind, string(key), int(st.st_mtime), st.st_size,
+                                  data_offset, len(payload), width, height,
+                                  string(image), string(fmt)))
+        payloads.append((data_offset, payload))
+        data_offset = align(data_offset + len(payload))
+
+    # A running mirage may have the old bundle mapped. Truncating it in place
+    # would fault its next lookup, so write a new file and rename it over.
+    tmp = output + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(HEADER.pack(BUNDLE_MAGIC, BUNDLE_VERSION, len(keys),
+                            entries_offset, strings_offset, len(strings)))
+        f.write(entries)
+        f.write(strings)
+        for offset, payload in payloads:
+            f.write(b"\0" * (offset - f.tell()))
+            f.write(payload)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(tmp, output)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Bake a config's assets into " + BUNDLE_FILENAME)
+    parser.add_argument("config", help="HUD config, e.g. config.json")
+    parser.add_argument("--image-dir",
+                        help="Image path, defaults to the config's \"Image Path\" or " +
+                             IMAGE_PATH_DEFAULT)
+    parser.add_argument("--output", help="Defaults to " + BUNDLE_FILENAME + " in the image path")
+    args = parser.parse_args()
+
+    with open(args.config, "r") as f:
+        config = json.load(f)
+
+    image_dir = args.image_dir or config.get("Global", {}).get("Image Path", IMAGE_PATH_DEFAULT)
+    output = args.output or os.path.join(image_dir, BUNDLE_FILENAME)
+
+    assets = collect(config, image_dir)
+    write_bundle(assets, image_dir, output)
+
+    images = sum(1 for a in assets.values() if a[0] == TYPE_IMAGE)
+    print("Done. Baked %d images and %d frame tables into %s (%d MB)." %
+          (images, len(assets) - images, output, os.path.getsize(output) // (1024 * 1024)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Round-trip check for bake_assets.py.
+
+Bakes a small generated config into a scratch directory, then reads the
+bundle back following the layout in asset_bundle.h and compares every entry
+with what went in. Bakes twice, so replacing an existing bundle is covered
+too. Exits non-zero on the first mismatch.
+
+Requires Pillow, like bake_assets.py.
+"""
+import json
+import os
+import struct
+import sys
+import tempfile
+
+from PIL import Image
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import bake_assets  # noqa: E402
+
+SHEET = "sheet.png"
+ICON = "icons/icon.png"
+ANIMATION = "anim.json"
+
+
+def check(cond, what):
+    if not cond:
+        print("FAIL: " + what, file=sys.stderr)
+        sys.exit(1)
+
+
+def make_fixture(image_dir):
+    """Writes the source assets and returns the config and expected frames."""
+    os.makedirs(os.path.join(image_dir, "icons"))
+
+    sheet = Image.new("RGBA", (4, 3))
+    sheet.putdata([(i * 20, 255 - i * 20, i, 128 + i) for i in range(12)])
+    sheet.save(os.path.join(image_dir, SHEET))
+
+    icon = Image.new("RGBA", (2, 2), (10, 20, 30, 40))
+    icon.save(os.path.join(image_dir, ICON))
+
+    frames = [
+        {"frame": {"x": 0, "y": 0, "w": 2, "h": 3}, "rotated": False, "trimmed": True,
+         "spriteSourceSize": {"x": 1, "y": -1, "w": 2, "h": 3},
+         "sourceSize": {"w": 4, "h": 3}},
+        {"frame": {"x": 2, "y": 0, "w": 2, "h": 3}, "rotated": True, "trimmed": False,
+         "spriteSourceSize": {"x": 0, "y": 0, "w": 2, "h": 3},
+         "sourceSize": {"w": 40000, "h": -40000}},
+    ]
+    with open(os.path.join(image_dir, ANIMATION), "w") as f:
+        json.dump({"frames": {"a": frames[0], "b": frames[1]},
+                   "meta": {"image": "/" + SHEET, "format": "RGBA8888"}}, f)
+
+    config = {
+        "Elements": [
+            {"type": "animated", "file": ANIMATION},
+            {"type": "static", "file": "/" + ICON},
+            {"type": "static", "file": "missing.png"},
+        ],
+        "Components": [{"name": "x", "icon file": ICON}],
+    }
+
+    return config, frames
+
+
+def expected_frame(frame):
+    rect, sprite, source = frame["frame"], frame["spriteSourceSize"], frame["sourceSize"]
+    c = bake_assets.clamp16
+    return (c(rect["x"]), c(rect["y"]), c(rect["w"]), c(rect["h"]),
+            c(sprite["x"]), c(sprite["y"]), c(source["w"]), c(source["h"]),
+            1 if frame["rotated"] else 0, 1 if frame["trimmed"] else 0, 0)
+
+
+def read_bundle(path):
+    """Parses a bundle into key -> (entry fields, payload, image, format)."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, count, entries_offset, strings_offset, strings_size = \
+        bake_assets.HEADER.unpack_from(data, 0)
+    check(magic == bake_assets.BUNDLE_MAGIC, "bad magic")
+    check(version == bake_assets.BUNDLE_VERSION, "bad version")
+    check(strings_offset + strings_size <= len(data), "string table past end of file")
+    strings = data[strings_offset:strings_offset + strings_size]
+
+    def string(offset):
+        check(offset < len(strings), "string offset out of range")
+        end = strings.index(b"\0", offset)
+        return strings[offset:end].decode("utf-8")
+
+    entries = {}
+    keys = []
+    for i in range(count):
+        fields = bake_assets.ENTRY.unpack_from(data, entries_offset + i * bake_assets.ENTRY.size)
+        kind, key, mtime, size, offset, length, width, height, image, fmt = fields
+        check(offset % bake_assets.BUNDLE_ALIGN == 0, "payload not aligned")
+        check(offset + length <= len(data), "payload past end of file")
+        keys.append(string(key).encode("utf-8"))
+        entries[string(key)] = (fields, data[offset:offset + length], string(image), string(fmt))
+
+    check(keys == sorted(keys), "entries not in strcmp order")
+
+    return entries
+
+
+def verify(image_dir, output, frames):
+    entries = read_bundle(output)
+    check(sorted(entries) == sorted([ANIMATION, SHEET, ICON]),
+          "unexpected keys %s" % sorted(entries))
+
+    for key in (SHEET, ICON):
+        fields, payload, _, _ = entries[key]
+        st = os.stat(os.path.join(image_dir, key))
+        with Image.open(os.path.join(image_dir, key)) as img:
+            rgba = img.convert("RGBA")
+        check(fields[0] == bake_assets.TYPE_IMAGE, key + " is not an image")
+        check((fields[2], fields[3]) == (int(st.st_mtime), st.st_size), key + " source stamp")
+        check((fields[6], fields[7]) == rgba.size, key + " size")
+        check(payload == rgba.tobytes(), key + " pixels")
+
+    fields, payload, image, fmt = entries[ANIMATION]
+    check(fields[0] == bake_assets.TYPE_FRAMES, "animation is not a frame table")
+    check(fields[6] == len(frames), "frame count")
+    check((image, fmt) == (SHEET, "RGBA8888"), "frame table meta")
+    got = [bake_assets.FRAME.unpack_from(payload, i * bake_assets.FRAME.size)
+           for i in range(len(frames))]
+    check(got == [expected_frame(f) for f in frames], "frame table contents")
+
+    check(not os.path.exists(output + ".tmp"), "temporary bundle left behind")
+
+
+def main():
+    with tempfile.TemporaryDirectory() as image_dir:
+        config, frames = make_fixture(image_dir)
+        output = os.path.join(image_dir, bake_assets.BUNDLE_FILENAME)
+
+        for _ in range(2):
+            bake_assets.write_bundle(bake_assets.collect(config, image_dir), image_dir, output)
+            verify(image_dir, output, frames)
+
+    print("Bundle round-trip OK.")
+
+
+if __name__ == '__main__':
+    main()